@@ -211,6 +211,86 @@ static int ctrls_config_dispatch_cmd(pr_ctrls_t *ctrl, cmd_rec *cmd) {
   return 0;
 }
 
+static int ctrls_handle_authcache(pr_ctrls_t *ctrl, int reqargc,
+    char **reqargv) {
+  pr_auth_shared_cache_stats_t stats;
+
+  /* Check the authcache ACL. */
+  if (!pr_ctrls_check_acl(ctrl, ctrls_admin_acttab, "authcache")) {
+
+    /* Access denied. */
+    pr_ctrls_add_response(ctrl, "access denied");
+    return -1;
+  }
+
+  if (reqargc >= 1 &&
+      strcmp(reqargv[0], "clear") == 0) {
+    register int i;
+    int count;
+
+    if (reqargc == 1) {
+      count = pr_auth_shared_cache_remove(NULL);
+      if (count < 0) {
+        pr_ctrls_add_response(ctrl, "authcache: error clearing: %s",
+          strerror(errno));
+        return -1;
+      }
+
+      pr_ctrls_log(MOD_CTRLS_ADMIN_VERSION, "authcache: cleared auth cache");
+      pr_ctrls_add_response(ctrl, "authcache: cleared");
+      return 0;
+    }
+
+    for (i = 1; i < reqargc; i++) {
+      count = pr_auth_shared_cache_remove(reqargv[i]);
+      if (count < 0) {
+        pr_ctrls_add_response(ctrl, "authcache: error clearing user '%s': %s",
+          reqargv[i], strerror(errno));
+        return -1;
+      }
+
+      pr_ctrls_log(MOD_CTRLS_ADMIN_VERSION,
+        "authcache: cleared user '%s' from auth cache", reqargv[i]);
+      pr_ctrls_add_response(ctrl, "authcache: cleared user '%s' (%d %s)",
+        reqargv[i], count, count != 1 ? "entries" : "entry");
+    }
+
+    return 0;
+  }
+
+  if (reqargc > 1 ||
+      (reqargc == 1 && strcmp(reqargv[0], "stats") != 0)) {
+    pr_ctrls_add_response(ctrl, "authcache: unknown authcache action: '%s'",
+      reqargv[0]);
+    return -1;
+  }
+
+  if (pr_auth_shared_cache_get_stats(&stats) < 0) {
+    if (errno == EPERM) {
+      pr_ctrls_add_response(ctrl, "authcache: AuthSharedCache not enabled");
+
+    } else {
+      pr_ctrls_add_response(ctrl, "authcache: unavailable: %s",
+        strerror(errno));
+    }
+
+    return -1;
+  }
+
+  pr_ctrls_add_response(ctrl,
+    "authcache: %u/%u entries used, ttl %d secs, negative-ttl %d secs",
+    stats.used, stats.nentries, stats.ttl, stats.negative_ttl);
+  pr_ctrls_add_response(ctrl, "authcache: hits %" PR_LU
+    ", negative hits %" PR_LU ", misses %" PR_LU,
+    (pr_off_t) stats.hits, (pr_off_t) stats.negative_hits,
+    (pr_off_t) stats.misses);
+  pr_ctrls_add_response(ctrl, "authcache: stores %" PR_LU
+    ", evictions %" PR_LU, (pr_off_t) stats.stores,
+    (pr_off_t) stats.evictions);
+
+  return 0;
+}
+
 static int ctrls_handle_config_set(pr_ctrls_t *ctrl, int reqargc,
     char **reqargv) {
   register int i;
@@ -1226,6 +1306,126 @@ static int admin_addr_status(pr_ctrls_t *ctrl, const pr_netaddr_t *addr,
   return 0;
 }
 
+static const char *admin_fmt_usecs(pool *p, uint64_t usecs) {
+  char buf[64];
+
+  if (usecs < 1000) {
+    pr_snprintf(buf, sizeof(buf)-1, "%" PR_LU "us", (pr_off_t) usecs);
+
+  } else if (usecs < 1000000) {
+    pr_snprintf(buf, sizeof(buf)-1, "%.2fms", (double) usecs / 1000.0);
+
+  } else {
+    pr_snprintf(buf, sizeof(buf)-1, "%.2fs", (double) usecs / 1000000.0);
+  }
+
+  return pstrdup(p, buf);
+}
+
+static int admin_stats_cmd(pr_ctrls_t *ctrl, pool *tmp_pool,
+    const char *cmd_name) {
+  register unsigned int i;
+  int count = 0;
+  static const struct {
+    int phase;
+    const char *name;
+  } phases[] = {
+    { PRE_CMD,	"PRE_CMD" },
+    { CMD,	"CMD" },
+    { POST_CMD,	"POST_CMD" },
+    { LOG_CMD,	"LOG_CMD" },
+    { 0, NULL }
+  };
+
+  for (i = 0; phases[i].name != NULL; i++) {
+    pr_cmd_stats_t stats;
+
+    if (pr_cmd_stats_get(cmd_name, phases[i].phase, &stats) < 0 ||
+        stats.count == 0) {
+      continue;
+    }
+
+    pr_ctrls_add_response(ctrl,
+      "stats: %-10s %-8s count %" PR_LU ", p50 %s, p99 %s, p999 %s, max %s",
+      cmd_name, phases[i].name, (pr_off_t) stats.count,
+      admin_fmt_usecs(tmp_pool, stats.p50_usecs),
+      admin_fmt_usecs(tmp_pool, stats.p99_usecs),
+      admin_fmt_usecs(tmp_pool, stats.p999_usecs),
+      admin_fmt_usecs(tmp_pool, stats.max_usecs));
+    count++;
+  }
+
+  return count;
+}
+
+static int ctrls_handle_stats(pr_ctrls_t *ctrl, int reqargc,
+    char **reqargv) {
+  register int i;
+  pool *tmp_pool;
+  array_header *cmds;
+  char **elts;
+  int count = 0;
+
+  /* Check the stats ACL. */
+  if (!pr_ctrls_check_acl(ctrl, ctrls_admin_acttab, "stats")) {
+
+    /* Access denied. */
+    pr_ctrls_add_response(ctrl, "access denied");
+    return -1;
+  }
+
+  if (reqargc == 1 &&
+      strcmp(reqargv[0], "reset") == 0) {
+    if (pr_cmd_stats_reset() < 0) {
+      pr_ctrls_add_response(ctrl, "stats: error resetting: %s",
+        strerror(errno));
+      return -1;
+    }
+
+    pr_ctrls_log(MOD_CTRLS_ADMIN_VERSION, "stats: reset command statistics");
+    pr_ctrls_add_response(ctrl, "stats: reset");
+    return 0;
+  }
+
+  tmp_pool = make_sub_pool(ctrls_admin_pool);
+  pr_pool_tag(tmp_pool, "ctrls stats pool");
+
+  if (reqargc == 0) {
+    cmds = pr_cmd_stats_get_cmds(tmp_pool);
+    if (cmds == NULL) {
+      pr_ctrls_add_response(ctrl, "stats: unavailable: %s", strerror(errno));
+      destroy_pool(tmp_pool);
+      return -1;
+    }
+
+  } else {
+    cmds = make_array(tmp_pool, reqargc, sizeof(char *));
+
+    for (i = 0; i < reqargc; i++) {
+      char *cmd_name, *ptr;
+
+      cmd_name = pstrdup(tmp_pool, reqargv[i]);
+      for (ptr = cmd_name; *ptr; ptr++) {
+        *ptr = toupper((int) *ptr);
+      }
+
+      *((char **) push_array(cmds)) = cmd_name;
+    }
+  }
+
+  elts = cmds->elts;
+  for (i = 0; i < cmds->nelts; i++) {
+    count += admin_stats_cmd(ctrl, tmp_pool, elts[i]);
+  }
+
+  if (count == 0) {
+    pr_ctrls_add_response(ctrl, "stats: no commands recorded");
+  }
+
+  destroy_pool(tmp_pool);
+  return 0;
+}
+
 static int ctrls_handle_status(pr_ctrls_t *ctrl, int reqargc,
     char **reqargv) {
   register int i = 0;
@@ -1699,6 +1899,8 @@ static int ctrls_admin_init(void) {
 }
 
 static ctrls_acttab_t ctrls_admin_acttab[] = {
+  { "authcache", "display or clear the shared auth cache",	NULL,
+    ctrls_handle_authcache },
   { "config",	"set config directives",	NULL,
     ctrls_handle_config },
   { "debug",    "set debugging level",		NULL,
@@ -1717,6 +1919,8 @@ static ctrls_acttab_t ctrls_admin_acttab[] = {
     ctrls_handle_scoreboard },
   { "shutdown", "shutdown the daemon",	NULL,
     ctrls_handle_shutdown },
+  { "stats",	"display command latency statistics",	NULL,
+    ctrls_handle_stats },
   { "status",	"display status of servers",		NULL,
     ctrls_handle_status },
   { "trace",	"set trace levels",		NULL,
@@ -0,0 +1,1178 @@
+/*
+ * ProFTPD: mod_iouring -- a module for performing file I/O via io_uring
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ *
+ * This is mod_iouring, contrib software for proftpd 1.3.x.
+ */
+
+#include "conf.h"
+
+#if defined(HAVE_LINUX_IO_URING_H)
+# include <linux/io_uring.h>
+# include <sys/syscall.h>
+#endif /* HAVE_LINUX_IO_URING_H */
+
+#if HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+#if HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
+
+#define MOD_IOURING_VERSION			"mod_iouring/0.1"
+
+/* Make sure the version of proftpd is as necessary. */
+#if PROFTPD_VERSION_NUMBER < 0x0001030805
+# error "ProFTPD 1.3.8 or later required"
+#endif
+
+#ifndef MAP_FAILED
+# define MAP_FAILED     ((void *) -1)
+#endif
+
+/* Number of I/O buffers, i.e. how many reads (or writes) can be in flight
+ * for a file at the same time.
+ */
+#define IOURING_DEFAULT_BUFFER_COUNT	8
+
+module iouring_module;
+
+static int iouring_engine = FALSE;
+static unsigned int iouring_nbufs = IOURING_DEFAULT_BUFFER_COUNT;
+static pool *iouring_pool = NULL;
+
+static const char *trace_channel = "iouring";
+
+static int iouring_sess_init(void);
+
+#if defined(HAVE_LINUX_IO_URING_H) && \
+    defined(__NR_io_uring_setup) && \
+    defined(__NR_io_uring_enter) && \
+    defined(__NR_io_uring_register)
+# define PR_USE_IOURING	1
+
+/* The submission and completion queues shared with the kernel. */
+struct iouring_ring {
+  int fd;
+
+  void *sq_ptr;
+  size_t sq_ptrsz;
+  unsigned int *sq_head, *sq_tail, *sq_mask, *sq_entries, *sq_array;
+  struct io_uring_sqe *sqes;
+  size_t sqesz;
+
+  void *cq_ptr;
+  size_t cq_ptrsz;
+  unsigned int *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  /* Number of SQEs queued, but not yet submitted to the kernel. */
+  unsigned int nqueued;
+
+  /* Use IORING_OP_{READ,WRITE}_FIXED, on registered buffers? */
+  int use_fixed;
+};
+
+#define IOURING_SLOT_FREE	0
+#define IOURING_SLOT_READ	1
+#define IOURING_SLOT_WRITE	2
+
+struct iouring_slot {
+  int state;
+
+  /* TRUE while the kernel still owns the buffer. */
+  int pending;
+
+  off_t offset;
+  size_t len;
+  ssize_t res;
+
+  /* For reads: how much of the completed data has been handed out. */
+  size_t consumed;
+
+  char *buf;
+};
+
+/* The file currently being read (or written) through the ring.  Only one
+ * file per direction is handled at a time; any other file uses the
+ * synchronous path.
+ */
+struct iouring_file {
+  pr_fh_t *fh;
+  int fd;
+
+  /* The logical file position; the kernel's file offset is only brought
+   * up to date when we stop tracking the file.
+   */
+  off_t pos;
+
+  /* Reads: the offset of the next read-ahead, and whether EOF was seen. */
+  off_t next_offset;
+  int eof;
+
+  /* Writes: a deferred error from an earlier asynchronous write. */
+  int xerrno;
+};
+
+static struct iouring_ring ring;
+static struct iouring_slot *iouring_slots = NULL;
+static size_t iouring_bufsz = 0;
+static struct iouring_file reader, writer;
+static pr_fs_t *iouring_fs = NULL;
+
+static int iouring_setup(unsigned int entries) {
+  struct io_uring_params params;
+  int fd, xerrno;
+
+  memset(&params, 0, sizeof(params));
+  fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+  if (fd < 0) {
+    return -1;
+  }
+
+  ring.fd = fd;
+  ring.sq_ptrsz = params.sq_off.array +
+    (params.sq_entries * sizeof(unsigned int));
+  ring.cq_ptrsz = params.cq_off.cqes +
+    (params.cq_entries * sizeof(struct io_uring_cqe));
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring.cq_ptrsz > ring.sq_ptrsz) {
+      ring.sq_ptrsz = ring.cq_ptrsz;
+    }
+    ring.cq_ptrsz = ring.sq_ptrsz;
+  }
+
+  ring.sq_ptr = mmap(NULL, ring.sq_ptrsz, PROT_READ|PROT_WRITE,
+    MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (ring.sq_ptr == MAP_FAILED) {
+    xerrno = errno;
+    (void) close(fd);
+    errno = xerrno;
+    return -1;
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring.cq_ptr = ring.sq_ptr;
+
+  } else {
+    ring.cq_ptr = mmap(NULL, ring.cq_ptrsz, PROT_READ|PROT_WRITE,
+      MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (ring.cq_ptr == MAP_FAILED) {
+      xerrno = errno;
+      (void) munmap(ring.sq_ptr, ring.sq_ptrsz);
+      (void) close(fd);
+      errno = xerrno;
+      return -1;
+    }
+  }
+
+  ring.sqesz = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring.sqes = mmap(NULL, ring.sqesz, PROT_READ|PROT_WRITE,
+    MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (ring.sqes == MAP_FAILED) {
+    xerrno = errno;
+    if (ring.cq_ptr != ring.sq_ptr) {
+      (void) munmap(ring.cq_ptr, ring.cq_ptrsz);
+    }
+    (void) munmap(ring.sq_ptr, ring.sq_ptrsz);
+    (void) close(fd);
+    errno = xerrno;
+    return -1;
+  }
+
+  ring.sq_head = (unsigned int *) ((char *) ring.sq_ptr + params.sq_off.head);
+  ring.sq_tail = (unsigned int *) ((char *) ring.sq_ptr + params.sq_off.tail);
+  ring.sq_mask = (unsigned int *) ((char *) ring.sq_ptr +
+    params.sq_off.ring_mask);
+  ring.sq_entries = (unsigned int *) ((char *) ring.sq_ptr +
+    params.sq_off.ring_entries);
+  ring.sq_array = (unsigned int *) ((char *) ring.sq_ptr +
+    params.sq_off.array);
+
+  ring.cq_head = (unsigned int *) ((char *) ring.cq_ptr + params.cq_off.head);
+  ring.cq_tail = (unsigned int *) ((char *) ring.cq_ptr + params.cq_off.tail);
+  ring.cq_mask = (unsigned int *) ((char *) ring.cq_ptr +
+    params.cq_off.ring_mask);
+  ring.cqes = (struct io_uring_cqe *) ((char *) ring.cq_ptr +
+    params.cq_off.cqes);
+
+  ring.nqueued = 0;
+
+  pr_trace_msg(trace_channel, 9, "created io_uring (fd %d) with %u SQ, "
+    "%u CQ entries", fd, params.sq_entries, params.cq_entries);
+  return 0;
+}
+
+static void iouring_teardown(void) {
+  if (ring.fd < 0) {
+    return;
+  }
+
+  (void) munmap(ring.sqes, ring.sqesz);
+  if (ring.cq_ptr != ring.sq_ptr) {
+    (void) munmap(ring.cq_ptr, ring.cq_ptrsz);
+  }
+  (void) munmap(ring.sq_ptr, ring.sq_ptrsz);
+  (void) close(ring.fd);
+  ring.fd = -1;
+}
+
+/* Returns TRUE if the kernel supports the given opcode.  Kernels
+ * which predate IORING_REGISTER_PROBE only support the original opcodes,
+ * including the fixed-buffer reads/writes.
+ */
+static int iouring_have_op(int op) {
+  struct io_uring_probe *probe;
+  size_t probesz;
+  int res, supported = FALSE;
+
+  probesz = sizeof(struct io_uring_probe) +
+    (256 * sizeof(struct io_uring_probe_op));
+  probe = pcalloc(iouring_pool, probesz);
+
+  res = (int) syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PROBE,
+    probe, 256);
+  if (res < 0) {
+    return (op == IORING_OP_READ_FIXED || op == IORING_OP_WRITE_FIXED);
+  }
+
+  if (op <= probe->last_op &&
+      (probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+    supported = TRUE;
+  }
+
+  return supported;
+}
+
+static int iouring_enter(unsigned int to_submit, unsigned int min_complete) {
+  int res;
+  unsigned int flags = 0;
+
+  if (min_complete > 0) {
+    flags |= IORING_ENTER_GETEVENTS;
+  }
+
+  res = (int) syscall(__NR_io_uring_enter, ring.fd, to_submit, min_complete,
+    flags, NULL, 0);
+  while (res < 0 &&
+         errno == EINTR) {
+    pr_signals_handle();
+
+    res = (int) syscall(__NR_io_uring_enter, ring.fd, to_submit, min_complete,
+      flags, NULL, 0);
+  }
+
+  if (res > 0) {
+    ring.nqueued -= ((unsigned int) res > ring.nqueued ? ring.nqueued :
+      (unsigned int) res);
+  }
+
+  return res;
+}
+
+static void iouring_queue(int slot_idx, int op, int fd) {
+  struct iouring_slot *slot;
+  struct io_uring_sqe *sqe;
+  unsigned int tail, idx;
+
+  slot = &(iouring_slots[slot_idx]);
+
+  /* The ring has at least twice as many entries as we have buffers, so
+   * there is always room for another SQE.
+   */
+  tail = *ring.sq_tail;
+  idx = tail & *ring.sq_mask;
+  sqe = &(ring.sqes[idx]);
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+  if (ring.use_fixed) {
+    sqe->opcode = (op == IOURING_SLOT_READ) ? IORING_OP_READ_FIXED :
+      IORING_OP_WRITE_FIXED;
+    sqe->buf_index = slot_idx;
+
+  } else {
+    sqe->opcode = (op == IOURING_SLOT_READ) ? IORING_OP_READ :
+      IORING_OP_WRITE;
+  }
+
+  sqe->fd = fd;
+  sqe->off = (uint64_t) slot->offset;
+  sqe->addr = (uint64_t) (uintptr_t) slot->buf;
+  sqe->len = (uint32_t) slot->len;
+  sqe->user_data = (uint64_t) slot_idx;
+
+  ring.sq_array[idx] = idx;
+  __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ring.nqueued++;
+
+  slot->state = op;
+  slot->pending = TRUE;
+  slot->res = 0;
+  slot->consumed = 0;
+}
+
+static void iouring_write_done(struct iouring_slot *slot) {
+  if (slot->res < 0) {
+    pr_trace_msg(trace_channel, 3, "error writing %lu bytes at offset %"
+      PR_LU " of fd %d: %s", (unsigned long) slot->len,
+      (pr_off_t) slot->offset, writer.fd, strerror((int) -slot->res));
+    if (writer.xerrno == 0) {
+      writer.xerrno = (int) -slot->res;
+    }
+
+  } else if ((size_t) slot->res < slot->len) {
+    size_t written;
+
+    /* Finish a short write synchronously. */
+    written = (size_t) slot->res;
+    while (written < slot->len) {
+      ssize_t res;
+
+      res = pwrite(writer.fd, slot->buf + written, slot->len - written,
+        slot->offset + written);
+      if (res < 0) {
+        if (errno == EINTR) {
+          pr_signals_handle();
+          continue;
+        }
+
+        if (writer.xerrno == 0) {
+          writer.xerrno = errno;
+        }
+        break;
+      }
+
+      written += res;
+    }
+  }
+
+  slot->state = IOURING_SLOT_FREE;
+}
+
+/* Collect all available completions. */
+static void iouring_reap(void) {
+  unsigned int head;
+
+  head = *ring.cq_head;
+  while (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe *cqe;
+    struct iouring_slot *slot;
+
+    cqe = &(ring.cqes[head & *ring.cq_mask]);
+    slot = &(iouring_slots[cqe->user_data]);
+    slot->pending = FALSE;
+    slot->res = cqe->res;
+    head++;
+
+    if (slot->state == IOURING_SLOT_WRITE) {
+      iouring_write_done(slot);
+
+    } else if (slot->state == IOURING_SLOT_READ) {
+      if (slot->res >= 0 &&
+          (size_t) slot->res < slot->len) {
+        reader.eof = TRUE;
+      }
+    }
+  }
+
+  __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* Submit anything queued, and wait until no slot in the given state is
+ * still owned by the kernel.
+ */
+static int iouring_wait(int state) {
+  while (TRUE) {
+    register unsigned int i;
+    int pending = FALSE;
+
+    iouring_reap();
+
+    for (i = 0; i < iouring_nbufs; i++) {
+      if (iouring_slots[i].state == state &&
+          iouring_slots[i].pending == TRUE) {
+        pending = TRUE;
+        break;
+      }
+    }
+
+    if (pending == FALSE) {
+      break;
+    }
+
+    if (iouring_enter(ring.nqueued, 1) < 0) {
+      pr_trace_msg(trace_channel, 1, "error waiting for io_uring "
+        "completions: %s", strerror(errno));
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int iouring_wait_slot(struct iouring_slot *slot) {
+  while (slot->pending == TRUE) {
+    iouring_reap();
+    if (slot->pending == FALSE) {
+      break;
+    }
+
+    if (iouring_enter(ring.nqueued, 1) < 0) {
+      pr_trace_msg(trace_channel, 1, "error waiting for io_uring "
+        "completion: %s", strerror(errno));
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int iouring_get_free_slot(void) {
+  register unsigned int i;
+
+  for (i = 0; i < iouring_nbufs; i++) {
+    if (iouring_slots[i].state == IOURING_SLOT_FREE) {
+      return (int) i;
+    }
+  }
+
+  return -1;
+}
+
+static unsigned int iouring_count_slots(int state) {
+  register unsigned int i;
+  unsigned int count = 0;
+
+  for (i = 0; i < iouring_nbufs; i++) {
+    if (iouring_slots[i].state == state) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+/* Release all of the buffers used by the given state, once the kernel is
+ * done with them.
+ */
+static void iouring_release_slots(int state) {
+  register unsigned int i;
+
+  (void) iouring_wait(state);
+
+  for (i = 0; i < iouring_nbufs; i++) {
+    if (iouring_slots[i].state == state) {
+      iouring_slots[i].state = IOURING_SLOT_FREE;
+    }
+  }
+}
+
+/* Stop tracking the given file, optionally bringing the kernel's file
+ * offset up to date with our logical position.
+ */
+static void iouring_untrack(struct iouring_file *file, int sync_pos) {
+  if (file->fh == NULL) {
+    return;
+  }
+
+  iouring_release_slots(file == &reader ? IOURING_SLOT_READ :
+    IOURING_SLOT_WRITE);
+
+  if (sync_pos == TRUE) {
+    if (lseek(file->fd, file->pos, SEEK_SET) == (off_t) -1) {
+      pr_trace_msg(trace_channel, 3, "error seeking fd %d to offset %" PR_LU
+        ": %s", file->fd, (pr_off_t) file->pos, strerror(errno));
+    }
+  }
+
+  pr_trace_msg(trace_channel, 15, "no longer handling %s of '%s' (fd %d)",
+    file == &reader ? "reads" : "writes", file->fh->fh_path, file->fd);
+  file->fh = NULL;
+  file->fd = -1;
+}
+
+/* Returns TRUE if the given file is, or can now be, handled through the
+ * ring; FALSE if the synchronous path should be used.
+ */
+static int iouring_track(struct iouring_file *file, pr_fh_t *fh, int fd) {
+  struct iouring_file *other;
+  struct stat st;
+  off_t pos;
+
+  if (file->fh == fh &&
+      file->fd == fd) {
+    return TRUE;
+  }
+
+  if (file->fh != NULL) {
+    /* Already busy with another file. */
+    return FALSE;
+  }
+
+  other = (file == &reader) ? &writer : &reader;
+  if (other->fh == fh &&
+      other->fd == fd) {
+    /* Switching between reading and writing the same file. */
+    iouring_untrack(other, TRUE);
+  }
+
+  if (fstat(fd, &st) < 0 ||
+      !S_ISREG(st.st_mode)) {
+    return FALSE;
+  }
+
+  if (file == &writer) {
+    int flags;
+
+    /* Out-of-order completions would scramble appended data. */
+    flags = fcntl(fd, F_GETFL);
+    if (flags < 0 ||
+        (flags & O_APPEND)) {
+      return FALSE;
+    }
+  }
+
+  pos = lseek(fd, 0, SEEK_CUR);
+  if (pos == (off_t) -1) {
+    return FALSE;
+  }
+
+  file->fh = fh;
+  file->fd = fd;
+  file->pos = file->next_offset = pos;
+  file->eof = FALSE;
+  file->xerrno = 0;
+
+  pr_trace_msg(trace_channel, 15, "handling %s of '%s' (fd %d) from offset %"
+    PR_LU, file == &reader ? "reads" : "writes", fh->fh_path, fd,
+    (pr_off_t) pos);
+  return TRUE;
+}
+
+/* Queue read-ahead into every free buffer, and submit them as one batch. */
+static void iouring_read_ahead(void) {
+  int slot_idx;
+
+  while (reader.eof == FALSE &&
+         (slot_idx = iouring_get_free_slot()) >= 0) {
+    struct iouring_slot *slot;
+
+    slot = &(iouring_slots[slot_idx]);
+    slot->offset = reader.next_offset;
+    slot->len = iouring_bufsz;
+    iouring_queue(slot_idx, IOURING_SLOT_READ, reader.fd);
+
+    reader.next_offset += iouring_bufsz;
+  }
+
+  if (ring.nqueued > 0) {
+    pr_trace_msg(trace_channel, 19, "submitting %u reads for fd %d",
+      ring.nqueued, reader.fd);
+    if (iouring_enter(ring.nqueued, 0) < 0) {
+      pr_trace_msg(trace_channel, 1, "error submitting reads: %s",
+        strerror(errno));
+    }
+  }
+}
+
+static struct iouring_slot *iouring_find_read_slot(off_t pos) {
+  register unsigned int i;
+
+  for (i = 0; i < iouring_nbufs; i++) {
+    struct iouring_slot *slot;
+
+    slot = &(iouring_slots[i]);
+    if (slot->state == IOURING_SLOT_READ &&
+        (slot->offset + (off_t) slot->consumed) == pos) {
+      return slot;
+    }
+  }
+
+  return NULL;
+}
+
+/* Find the next FS in the stack which implements the given callback. */
+#define IOURING_NEXT_FS(fs, cb) \
+  for ((fs) = iouring_fs->fs_next; \
+       (fs) != NULL && (fs)->fs_next != NULL && (fs)->cb == NULL; \
+       (fs) = (fs)->fs_next)
+
+/* FSIO callbacks
+ */
+
+static int iouring_fsio_read(pr_fh_t *fh, int fd, char *buf, size_t size) {
+  struct iouring_slot *slot;
+  size_t avail, len;
+  pr_fs_t *next_fs;
+
+  if (iouring_track(&reader, fh, fd) == FALSE) {
+    IOURING_NEXT_FS(next_fs, read);
+    return (next_fs->read)(fh, fd, buf, size);
+  }
+
+  slot = iouring_find_read_slot(reader.pos);
+  if (slot == NULL) {
+    /* Nothing read ahead for this position (e.g. the first read); discard
+     * any stale read-ahead, and start anew from here.
+     */
+    iouring_release_slots(IOURING_SLOT_READ);
+    reader.next_offset = reader.pos;
+    reader.eof = FALSE;
+
+    iouring_read_ahead();
+    slot = iouring_find_read_slot(reader.pos);
+    if (slot == NULL) {
+      ssize_t res;
+
+      res = pread(fd, buf, size, reader.pos);
+      if (res > 0) {
+        reader.pos += res;
+      }
+
+      return (int) res;
+    }
+  }
+
+  if (iouring_wait_slot(slot) < 0) {
+    return -1;
+  }
+
+  if (slot->res < 0) {
+    int xerrno;
+
+    xerrno = (int) -slot->res;
+    slot->state = IOURING_SLOT_FREE;
+
+    pr_trace_msg(trace_channel, 3, "error reading %lu bytes at offset %"
+      PR_LU " of '%s': %s", (unsigned long) slot->len,
+      (pr_off_t) slot->offset, fh->fh_path, strerror(xerrno));
+    errno = xerrno;
+    return -1;
+  }
+
+  avail = (size_t) slot->res - slot->consumed;
+  if (avail == 0) {
+    /* EOF. */
+    slot->state = IOURING_SLOT_FREE;
+    return 0;
+  }
+
+  len = size < avail ? size : avail;
+  memcpy(buf, slot->buf + slot->consumed, len);
+  slot->consumed += len;
+  reader.pos += len;
+
+  if (slot->consumed == (size_t) slot->res) {
+    slot->state = IOURING_SLOT_FREE;
+  }
+
+  /* Refill in batches, once half of the buffers have been consumed. */
+  if (iouring_count_slots(IOURING_SLOT_FREE) >= (iouring_nbufs / 2)) {
+    iouring_read_ahead();
+  }
+
+  return (int) len;
+}
+
+static int iouring_fsio_write(pr_fh_t *fh, int fd, const char *buf,
+    size_t size) {
+  size_t written = 0;
+  pr_fs_t *next_fs;
+
+  if (iouring_track(&writer, fh, fd) == FALSE) {
+    IOURING_NEXT_FS(next_fs, write);
+    return (next_fs->write)(fh, fd, buf, size);
+  }
+
+  iouring_reap();
+
+  while (written < size &&
+         writer.xerrno == 0) {
+    struct iouring_slot *slot;
+    int slot_idx;
+    size_t len;
+
+    slot_idx = iouring_get_free_slot();
+    if (slot_idx < 0) {
+      if (iouring_count_slots(IOURING_SLOT_WRITE) == 0) {
+        /* The buffers are all holding read-ahead data. */
+        iouring_untrack(&reader, TRUE);
+        continue;
+      }
+
+      /* All buffers are in flight; wait for one of them. */
+      if (iouring_enter(ring.nqueued, 1) < 0) {
+        return -1;
+      }
+
+      iouring_reap();
+      continue;
+    }
+
+    len = size - written;
+    if (len > iouring_bufsz) {
+      len = iouring_bufsz;
+    }
+
+    slot = &(iouring_slots[slot_idx]);
+    memcpy(slot->buf, buf + written, len);
+    slot->offset = writer.pos;
+    slot->len = len;
+    iouring_queue(slot_idx, IOURING_SLOT_WRITE, fd);
+
+    writer.pos += len;
+    written += len;
+  }
+
+  if (writer.xerrno != 0) {
+    errno = writer.xerrno;
+    return -1;
+  }
+
+  /* Submit writes in batches, once half of the buffers are queued. */
+  if (ring.nqueued >= (iouring_nbufs / 2)) {
+    pr_trace_msg(trace_channel, 19, "submitting %u writes for fd %d",
+      ring.nqueued, fd);
+    if (iouring_enter(ring.nqueued, 0) < 0) {
+      return -1;
+    }
+  }
+
+  return (int) size;
+}
+
+/* Make sure that all writes have reached the kernel, returning -1 if any
+ * of them failed.
+ */
+static int iouring_flush(pr_fh_t *fh, int fd) {
+  if (writer.fh == fh &&
+      writer.fd == fd) {
+    if (iouring_wait(IOURING_SLOT_WRITE) < 0) {
+      return -1;
+    }
+
+    if (writer.xerrno != 0) {
+      errno = writer.xerrno;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int iouring_fsio_close(pr_fh_t *fh, int fd) {
+  int res, xerrno = 0;
+  pr_fs_t *next_fs;
+
+  if (iouring_flush(fh, fd) < 0) {
+    xerrno = errno;
+  }
+
+  if (reader.fh == fh &&
+      reader.fd == fd) {
+    iouring_untrack(&reader, FALSE);
+  }
+
+  if (writer.fh == fh &&
+      writer.fd == fd) {
+    iouring_untrack(&writer, FALSE);
+  }
+
+  IOURING_NEXT_FS(next_fs, close);
+  res = (next_fs->close)(fh, fd);
+  if (res == 0 &&
+      xerrno != 0) {
+    /* Report the deferred write error. */
+    res = -1;
+
+  } else {
+    xerrno = errno;
+  }
+
+  errno = xerrno;
+  return res;
+}
+
+static off_t iouring_fsio_lseek(pr_fh_t *fh, int fd, off_t offset,
+    int whence) {
+  pr_fs_t *next_fs;
+
+  if (reader.fh == fh &&
+      reader.fd == fd) {
+    iouring_untrack(&reader, TRUE);
+  }
+
+  if (writer.fh == fh &&
+      writer.fd == fd) {
+    iouring_untrack(&writer, TRUE);
+  }
+
+  IOURING_NEXT_FS(next_fs, lseek);
+  return (next_fs->lseek)(fh, fd, offset, whence);
+}
+
+static int iouring_fsio_fstat(pr_fh_t *fh, int fd, struct stat *st) {
+  pr_fs_t *next_fs;
+
+  if (iouring_flush(fh, fd) < 0) {
+    return -1;
+  }
+
+  IOURING_NEXT_FS(next_fs, fstat);
+  return (next_fs->fstat)(fh, fd, st);
+}
+
+static int iouring_fsio_fsync(pr_fh_t *fh, int fd) {
+  pr_fs_t *next_fs;
+
+  if (iouring_flush(fh, fd) < 0) {
+    return -1;
+  }
+
+  IOURING_NEXT_FS(next_fs, fsync);
+  return (next_fs->fsync)(fh, fd);
+}
+
+static int iouring_fsio_ftruncate(pr_fh_t *fh, int fd, off_t len) {
+  pr_fs_t *next_fs;
+
+  if (reader.fh == fh &&
+      reader.fd == fd) {
+    iouring_untrack(&reader, TRUE);
+  }
+
+  if (writer.fh == fh &&
+      writer.fd == fd) {
+    if (iouring_flush(fh, fd) < 0) {
+      return -1;
+    }
+
+    iouring_untrack(&writer, TRUE);
+  }
+
+  IOURING_NEXT_FS(next_fs, ftruncate);
+  return (next_fs->ftruncate)(fh, fd, len);
+}
+
+static ssize_t iouring_fsio_pread(pr_fh_t *fh, int fd, void *buf, size_t sz,
+    off_t offset) {
+  pr_fs_t *next_fs;
+
+  if (iouring_flush(fh, fd) < 0) {
+    return -1;
+  }
+
+  IOURING_NEXT_FS(next_fs, pread);
+  return (next_fs->pread)(fh, fd, buf, sz, offset);
+}
+
+static ssize_t iouring_fsio_pwrite(pr_fh_t *fh, int fd, const void *buf,
+    size_t sz, off_t offset) {
+  pr_fs_t *next_fs;
+
+  if (iouring_flush(fh, fd) < 0) {
+    return -1;
+  }
+
+  IOURING_NEXT_FS(next_fs, pwrite);
+  return (next_fs->pwrite)(fh, fd, buf, sz, offset);
+}
+
+static int iouring_init_ring(void) {
+  struct iovec *iov;
+  register unsigned int i;
+  int res, xerrno;
+
+  ring.fd = -1;
+  if (iouring_setup(iouring_nbufs * 2) < 0) {
+    xerrno = errno;
+
+    pr_log_debug(DEBUG2, MOD_IOURING_VERSION
+      ": unable to create io_uring, using synchronous I/O: %s",
+      strerror(xerrno));
+    errno = xerrno;
+    return -1;
+  }
+
+  iouring_bufsz = pr_config_get_server_xfer_bufsz(PR_NETIO_IO_RD);
+  if ((size_t) pr_config_get_server_xfer_bufsz(PR_NETIO_IO_WR) >
+      iouring_bufsz) {
+    iouring_bufsz = pr_config_get_server_xfer_bufsz(PR_NETIO_IO_WR);
+  }
+
+  iouring_slots = pcalloc(iouring_pool,
+    iouring_nbufs * sizeof(struct iouring_slot));
+  iov = pcalloc(iouring_pool, iouring_nbufs * sizeof(struct iovec));
+
+  for (i = 0; i < iouring_nbufs; i++) {
+    iouring_slots[i].state = IOURING_SLOT_FREE;
+    iouring_slots[i].buf = palloc(iouring_pool, iouring_bufsz);
+
+    iov[i].iov_base = iouring_slots[i].buf;
+    iov[i].iov_len = iouring_bufsz;
+  }
+
+  /* Registering the buffers spares the kernel from mapping them on every
+   * request; it can fail e.g. due to RLIMIT_MEMLOCK, in which case we
+   * use the plain read/write opcodes, if available.
+   */
+  res = (int) syscall(__NR_io_uring_register, ring.fd,
+    IORING_REGISTER_BUFFERS, iov, iouring_nbufs);
+  if (res == 0) {
+    ring.use_fixed = TRUE;
+
+  } else {
+    pr_trace_msg(trace_channel, 3, "error registering %u buffers: %s",
+      iouring_nbufs, strerror(errno));
+
+    if (iouring_have_op(IORING_OP_READ) == FALSE ||
+        iouring_have_op(IORING_OP_WRITE) == FALSE) {
+      pr_log_debug(DEBUG2, MOD_IOURING_VERSION
+        ": io_uring lacks necessary support, using synchronous I/O");
+      iouring_teardown();
+      errno = ENOSYS;
+      return -1;
+    }
+
+    ring.use_fixed = FALSE;
+  }
+
+  reader.fh = writer.fh = NULL;
+  reader.fd = writer.fd = -1;
+
+  pr_trace_msg(trace_channel, 9, "using %u %s buffers of %lu bytes",
+    iouring_nbufs, ring.use_fixed ? "registered" : "unregistered",
+    (unsigned long) iouring_bufsz);
+  return 0;
+}
+#endif /* PR_USE_IOURING */
+
+/* Configuration handlers
+ */
+
+/* usage: IOUringBuffers count */
+MODRET set_iouringbuffers(cmd_rec *cmd) {
+  int count;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  count = atoi(cmd->argv[1]);
+  if (count < 2 ||
+      count > 64) {
+    CONF_ERROR(cmd, "count must be between 2 and 64");
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[0]) = (unsigned int) count;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: IOUringEngine on|off */
+MODRET set_iouringengine(cmd_rec *cmd) {
+  int engine = -1;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  engine = get_boolean(cmd, 1);
+  if (engine == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = engine;
+
+  return PR_HANDLED(cmd);
+}
+
+/* Command handlers
+ */
+
+MODRET iouring_post_pass(cmd_rec *cmd) {
+#if defined(PR_USE_IOURING)
+  pr_fs_t *fs;
+
+  if (iouring_engine == FALSE) {
+    return PR_DECLINED(cmd);
+  }
+
+  if (iouring_init_ring() < 0) {
+    iouring_engine = FALSE;
+    return PR_DECLINED(cmd);
+  }
+
+  /* Our FS is pushed on top of whatever FS is already mounted at "/", and
+   * defers to it for everything other than the file I/O.
+   */
+  fs = pr_register_fs(iouring_pool, "iouring", "/");
+  if (fs == NULL) {
+    pr_log_debug(DEBUG3, MOD_IOURING_VERSION
+      ": error registering 'iouring' fs: %s", strerror(errno));
+    iouring_teardown();
+    iouring_engine = FALSE;
+    return PR_DECLINED(cmd);
+  }
+
+  fs->read = iouring_fsio_read;
+  fs->write = iouring_fsio_write;
+  fs->close = iouring_fsio_close;
+  fs->lseek = iouring_fsio_lseek;
+  fs->fstat = iouring_fsio_fstat;
+  fs->fsync = iouring_fsio_fsync;
+  fs->ftruncate = iouring_fsio_ftruncate;
+  fs->pread = iouring_fsio_pread;
+  fs->pwrite = iouring_fsio_pwrite;
+  iouring_fs = fs;
+
+  pr_fs_setcwd(pr_fs_getvwd());
+  pr_fs_clear_cache();
+#endif /* PR_USE_IOURING */
+
+  return PR_DECLINED(cmd);
+}
+
+/* Event handlers
+ */
+
+#if defined(PR_SHARED_MODULE)
+static void iouring_mod_unload_ev(const void *event_data, void *user_data) {
+  if (strcmp("mod_iouring.c", (const char *) event_data) == 0) {
+    pr_event_unregister(&iouring_module, NULL, NULL);
+
+    if (iouring_pool != NULL) {
+      destroy_pool(iouring_pool);
+      iouring_pool = NULL;
+    }
+  }
+}
+#endif /* PR_SHARED_MODULE */
+
+static void iouring_sess_reinit_ev(const void *event_data, void *user_data) {
+  int res;
+
+  /* A HOST command changed the main_server pointer; reinitialize ourselves. */
+  pr_event_unregister(&iouring_module, "core.session-reinit",
+    iouring_sess_reinit_ev);
+
+  iouring_engine = FALSE;
+  iouring_nbufs = IOURING_DEFAULT_BUFFER_COUNT;
+
+  res = iouring_sess_init();
+  if (res < 0) {
+    pr_session_disconnect(&iouring_module,
+      PR_SESS_DISCONNECT_SESSION_INIT_FAILED, NULL);
+  }
+}
+
+/* Initialization routines
+ */
+
+static int iouring_init(void) {
+  iouring_pool = make_sub_pool(permanent_pool);
+  pr_pool_tag(iouring_pool, MOD_IOURING_VERSION);
+
+#if defined(PR_SHARED_MODULE)
+  pr_event_register(&iouring_module, "core.module-unload",
+    iouring_mod_unload_ev, NULL);
+#endif /* PR_SHARED_MODULE */
+
+  return 0;
+}
+
+static int iouring_sess_init(void) {
+  config_rec *c;
+
+  pr_event_register(&iouring_module, "core.session-reinit",
+    iouring_sess_reinit_ev, NULL);
+
+  c = find_config(main_server->conf, CONF_PARAM, "IOUringEngine", FALSE);
+  if (c != NULL) {
+    iouring_engine = *((int *) c->argv[0]);
+  }
+
+  if (iouring_engine == FALSE) {
+    return 0;
+  }
+
+#if !defined(PR_USE_IOURING)
+  pr_log_debug(DEBUG2, MOD_IOURING_VERSION
+    ": io_uring not supported on this system, using synchronous I/O");
+  iouring_engine = FALSE;
+#endif /* PR_USE_IOURING */
+
+  c = find_config(main_server->conf, CONF_PARAM, "IOUringBuffers", FALSE);
+  if (c != NULL) {
+    iouring_nbufs = *((unsigned int *) c->argv[0]);
+  }
+
+  return 0;
+}
+
+/* Module API tables
+ */
+
+static conftable iouring_conftab[] = {
+  { "IOUringBuffers",	set_iouringbuffers,	NULL },
+  { "IOUringEngine",	set_iouringengine,	NULL },
+  { NULL }
+};
+
+static cmdtable iouring_cmdtab[] = {
+  { POST_CMD,	C_PASS,	G_NONE,	iouring_post_pass,	FALSE,	FALSE },
+  { 0, NULL }
+};
+
+module iouring_module = {
+  NULL, NULL,
+
+  /* Module API version 2.0 */
+  0x20,
+
+  /* Module name */
+  "iouring",
+
+  /* Module configuration handler table */
+  iouring_conftab,
+
+  /* Module command handler table */
+  iouring_cmdtab,
+
+  /* Module authentication handler table */
+  NULL,
+
+  /* Module initialization function */
+  iouring_init,
+
+  /* Session initialization function */
+  iouring_sess_init,
+
+  /* Module version */
+  MOD_IOURING_VERSION
+};
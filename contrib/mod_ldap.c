@@ -98,6 +98,11 @@ static int ldap_port = LDAP_PORT;
 # define LDAP_SEARCH(ld, base, scope, filter, attrs, timeout, sizelimit, res) \
    ldap_search_ext_s(ld, base, scope, filter, attrs, 0, NULL, NULL, \
                      timeout, sizelimit, res)
+# define LDAP_SEARCH_ASYNC(ld, base, scope, filter, attrs, timeout, sizelimit, \
+    msgid) \
+   ldap_search_ext(ld, base, scope, filter, attrs, 0, NULL, NULL, \
+                   timeout, sizelimit, msgid)
+# define LDAP_ABANDON(ld, msgid) (ldap_abandon_ext(ld, msgid, NULL, NULL))
 #else /* LDAP_API_VERSION >= 2000 */
 # define LDAP_VALUE_T char
 # define LDAP_GET_VALUES(ld, entry, attr) ldap_get_values(ld, entry, attr)
@@ -134,6 +139,19 @@ LDAP_SEARCH(LDAP *ld, char *base, int scope, char *filter, char *attrs[],
   pr_ldap_set_sizelimit(ld, sizelimit);
   return ldap_search_st(ld, base, scope, filter, attrs, 0, timeout, res);
 }
+
+static int
+LDAP_SEARCH_ASYNC(LDAP *ld, char *base, int scope, char *filter, char *attrs[],
+                  struct timeval *timeout, int sizelimit, int *msgid) {
+  pr_ldap_set_sizelimit(ld, sizelimit);
+  *msgid = ldap_search(ld, base, scope, filter, attrs, 0);
+  if (*msgid < 0) {
+    return LDAP_OPERATIONS_ERROR;
+  }
+
+  return LDAP_SUCCESS;
+}
+# define LDAP_ABANDON(ld, msgid) (ldap_abandon(ld, msgid))
 #endif /* LDAP_API_VERSION >= 2000 */
 
 /* Thanks, Sun. */
@@ -212,7 +230,8 @@ static int ldap_do_users = FALSE, ldap_do_groups = FALSE,
            ldap_forcedefaultuid = FALSE, ldap_forcedefaultgid = FALSE,
            ldap_forcegenhdir = FALSE, ldap_protocol_version = 3,
            ldap_dereference = LDAP_DEREF_NEVER,
-           ldap_search_scope = LDAP_SCOPE_SUBTREE;
+           ldap_search_scope = LDAP_SCOPE_SUBTREE,
+           ldap_persistent_conn = FALSE;
 
 static size_t ldap_dnpasslen = 0;
 
@@ -227,8 +246,26 @@ static LDAP *ld = NULL;
 static array_header *cached_quota = NULL;
 static array_header *cached_ssh_pubkeys = NULL;
 
+/* Searches sent ahead of time during login, without waiting for each one's
+ * results, so that their round trips to the server overlap.  See
+ * ldap_prefetch_user().
+ */
+struct ldap_prefetch {
+  const char *basedn;
+  const char *filter;
+  char **attrs;
+  int scope;
+  int sizelimit;
+  int msgid;
+};
+
+static pool *ldap_prefetch_pool = NULL;
+static array_header *ldap_prefetches = NULL;
+static const char *ldap_prefetch_name = NULL;
+
 /* Necessary prototypes */
 static int ldap_sess_init(void);
+static void ldap_prefetch_clear(int abandon);
 static struct sasl_info *sasl_info_create(pool *, LDAP *);
 static void sasl_info_get_authcid_from_dn(struct sasl_info *, const char *);
 
@@ -239,6 +276,9 @@ static void pr_ldap_unbind(void) {
     return;
   }
 
+  /* Unbinding discards any outstanding searches as well. */
+  ldap_prefetch_clear(FALSE);
+
   res = LDAP_UNBIND(ld);
   if (res != LDAP_SUCCESS) {
     (void) pr_log_writefile(ldap_logfd, MOD_LDAP_VERSION,
@@ -742,6 +782,271 @@ static const char *pr_ldap_interpolate_filter(pool *p, char *template,
   return filter;
 }
 
+/* The attributes requested by the user, group membership, quota, and SSH
+ * public key lookups.  The prefetched searches have to request exactly the
+ * same attributes as the lookups which later use their results.
+ */
+static char **ldap_user_name_attrs(void) {
+  static char *attrs[7];
+
+  attrs[0] = ldap_attr_userpassword;
+  attrs[1] = ldap_attr_uid;
+  attrs[2] = ldap_attr_uidnumber;
+  attrs[3] = ldap_attr_gidnumber;
+  attrs[4] = ldap_attr_homedirectory;
+  attrs[5] = ldap_attr_loginshell;
+  attrs[6] = NULL;
+
+  /* See pr_ldap_getpwnam() for why userPassword is omitted for auth binds. */
+  return ldap_authbinds ? attrs + 1 : attrs;
+}
+
+static char **ldap_group_member_attrs(void) {
+  static char *attrs[3];
+
+  attrs[0] = ldap_attr_gidnumber;
+  attrs[1] = ldap_attr_cn;
+  attrs[2] = NULL;
+
+  return attrs;
+}
+
+static char **ldap_quota_attrs(void) {
+  static char *attrs[3];
+
+  attrs[0] = ldap_attr_ftpquota;
+  attrs[1] = ldap_attr_ftpquota_profiledn;
+  attrs[2] = NULL;
+
+  return attrs;
+}
+
+static char **ldap_ssh_pubkey_attrs(void) {
+  static char *attrs[2];
+
+  attrs[0] = ldap_attr_ssh_pubkey;
+  attrs[1] = NULL;
+
+  return attrs;
+}
+
+static int ldap_attrs_match(char **attrs1, char **attrs2) {
+  register unsigned int i;
+
+  for (i = 0; attrs1[i] != NULL && attrs2[i] != NULL; i++) {
+    if (strcmp(attrs1[i], attrs2[i]) != 0) {
+      return FALSE;
+    }
+  }
+
+  return (attrs1[i] == NULL && attrs2[i] == NULL);
+}
+
+static void ldap_prefetch_clear(int abandon) {
+  register unsigned int i;
+  struct ldap_prefetch *prefetches;
+
+  if (ldap_prefetches == NULL) {
+    return;
+  }
+
+  prefetches = ldap_prefetches->elts;
+  for (i = 0; i < ldap_prefetches->nelts; i++) {
+    if (prefetches[i].msgid < 0) {
+      continue;
+    }
+
+    pr_trace_msg(trace_channel, 9,
+      "discarding unused prefetched search (msgid %d) for filter %s",
+      prefetches[i].msgid, prefetches[i].filter);
+
+    if (abandon == TRUE &&
+        ld != NULL) {
+      (void) LDAP_ABANDON(ld, prefetches[i].msgid);
+    }
+  }
+
+  destroy_pool(ldap_prefetch_pool);
+  ldap_prefetch_pool = NULL;
+  ldap_prefetches = NULL;
+  ldap_prefetch_name = NULL;
+}
+
+/* Sends the search, without waiting for its results. */
+static void ldap_prefetch_search(const char *basedn, const char *filter,
+    char *attrs[], int sizelimit) {
+  register int i;
+  int msgid = -1, nattrs = 0, res;
+  struct ldap_prefetch *prefetch;
+
+  if (basedn == NULL ||
+      filter == NULL) {
+    return;
+  }
+
+  res = LDAP_SEARCH_ASYNC(ld, basedn, ldap_search_scope, filter, attrs,
+    &ldap_querytimeout_tv, sizelimit, &msgid);
+  if (res != LDAP_SUCCESS) {
+    (void) pr_log_writefile(ldap_logfd, MOD_LDAP_VERSION,
+      "error sending prefetch search using DN '%s', filter '%s': %s", basedn,
+      filter, ldap_err2string(res));
+    return;
+  }
+
+  prefetch = push_array(ldap_prefetches);
+  prefetch->basedn = pstrdup(ldap_prefetch_pool, basedn);
+  prefetch->filter = pstrdup(ldap_prefetch_pool, filter);
+  prefetch->scope = ldap_search_scope;
+  prefetch->sizelimit = sizelimit;
+  prefetch->msgid = msgid;
+
+  while (attrs[nattrs] != NULL) {
+    nattrs++;
+  }
+
+  prefetch->attrs = pcalloc(ldap_prefetch_pool, sizeof(char *) * (nattrs + 1));
+  for (i = 0; i < nattrs; i++) {
+    prefetch->attrs[i] = pstrdup(ldap_prefetch_pool, attrs[i]);
+  }
+
+  pr_trace_msg(trace_channel, 9,
+    "sent prefetch search (msgid %d) under base DN %s using filter %s", msgid,
+    basedn, filter);
+}
+
+/* The lookups done for a user logging in are independent of each other, so
+ * send them all at once, rather than waiting a full round trip for each in
+ * turn.  pr_ldap_search() then collects the results as the lookups happen.
+ */
+static void ldap_prefetch_user(pool *p, const char *user) {
+  const char *basedn, *filter;
+
+  /* Only the login lookups are worth prefetching; lookups of other names,
+   * e.g. for directory listings, do not need the rest of the set.
+   */
+  if (session.pool == NULL ||
+      session.user != NULL ||
+      ldap_user_name_filter == NULL) {
+    return;
+  }
+
+  if (ldap_prefetch_name != NULL &&
+      strcmp(ldap_prefetch_name, user) == 0) {
+    return;
+  }
+
+  ldap_prefetch_clear(TRUE);
+
+  if (ld == NULL) {
+    if (pr_ldap_connect(&ld, TRUE) < 0) {
+      return;
+    }
+  }
+
+  ldap_prefetch_pool = make_sub_pool(session.pool);
+  pr_pool_tag(ldap_prefetch_pool, MOD_LDAP_VERSION " prefetch pool");
+
+  ldap_prefetches = make_array(ldap_prefetch_pool, 4,
+    sizeof(struct ldap_prefetch));
+  ldap_prefetch_name = pstrdup(ldap_prefetch_pool, user);
+
+  filter = pr_ldap_interpolate_filter(p, ldap_user_name_filter, user);
+
+  if (ldap_do_users == TRUE) {
+    basedn = pr_ldap_interpolate_filter(p, ldap_user_basedn, user);
+    ldap_prefetch_search(basedn, filter, ldap_user_name_attrs(), 2);
+
+    /* SSH public key lookups (e.g. by mod_sftp_ldap) happen for SFTP
+     * logins.
+     */
+    if (strcmp(pr_session_get_protocol(0), "ssh2") == 0) {
+      ldap_prefetch_search(ldap_user_basedn, filter, ldap_ssh_pubkey_attrs(),
+        2);
+    }
+  }
+
+  if (ldap_do_groups == TRUE &&
+      ldap_gid_basedn != NULL) {
+    ldap_prefetch_search(ldap_gid_basedn,
+      pr_ldap_interpolate_filter(p, ldap_group_member_filter, user),
+      ldap_group_member_attrs(), 0);
+  }
+
+  /* Quota lookups by mod_quotatab_ldap happen after the login is complete;
+   * the prefetched results only survive that if the connection does.
+   */
+  if (ldap_persistent_conn == TRUE &&
+      pr_module_exists("mod_quotatab_ldap.c") == TRUE) {
+    basedn = pr_ldap_interpolate_filter(p, ldap_user_basedn, user);
+    ldap_prefetch_search(basedn, filter, ldap_quota_attrs(), 2);
+  }
+}
+
+/* Returns the results of a matching prefetched search, if any, waiting for
+ * them to arrive if necessary.  Returns NULL if there is no such search, or
+ * if it failed; the caller then searches as usual.
+ */
+static LDAPMessage *ldap_prefetch_get(const char *basedn, const char *filter,
+    char *attrs[], int sizelimit) {
+  register unsigned int i;
+  struct ldap_prefetch *prefetches;
+
+  if (ldap_prefetches == NULL ||
+      filter == NULL) {
+    return NULL;
+  }
+
+  prefetches = ldap_prefetches->elts;
+  for (i = 0; i < ldap_prefetches->nelts; i++) {
+    int msgid, res;
+    LDAPMessage *result = NULL;
+
+    if (prefetches[i].msgid < 0 ||
+        prefetches[i].scope != ldap_search_scope ||
+        prefetches[i].sizelimit != sizelimit ||
+        strcmp(prefetches[i].basedn, basedn) != 0 ||
+        strcmp(prefetches[i].filter, filter) != 0 ||
+        ldap_attrs_match(prefetches[i].attrs, attrs) == FALSE) {
+      continue;
+    }
+
+    /* Each prefetched result is only used once. */
+    msgid = prefetches[i].msgid;
+    prefetches[i].msgid = -1;
+
+    res = ldap_result(ld, msgid, LDAP_MSG_ALL, &ldap_querytimeout_tv,
+      &result);
+    if (res <= 0) {
+      if (res == 0) {
+        (void) LDAP_ABANDON(ld, msgid);
+      }
+
+      if (result != NULL) {
+        ldap_msgfree(result);
+      }
+
+      (void) pr_log_writefile(ldap_logfd, MOD_LDAP_VERSION,
+        "prefetched search using DN '%s', filter '%s' %s", basedn, filter,
+        res == 0 ? "timed out" : "failed");
+      return NULL;
+    }
+
+    /* Leave any error handling, e.g. reconnecting, to the usual search. */
+    res = ldap_result2error(ld, result, 0);
+    if (res != LDAP_SUCCESS) {
+      ldap_msgfree(result);
+      return NULL;
+    }
+
+    (void) pr_log_writefile(ldap_logfd, MOD_LDAP_VERSION,
+      "using prefetched search results for base DN %s, filter %s", basedn,
+      filter);
+    return result;
+  }
+
+  return NULL;
+}
+
 static LDAPMessage *pr_ldap_search(const char *basedn, const char *filter,
     char *attrs[], int sizelimit, int retry) {
   int res;
@@ -764,6 +1069,11 @@ static LDAPMessage *pr_ldap_search(const char *basedn, const char *filter,
     }
   }
 
+  result = ldap_prefetch_get(basedn, filter, attrs, sizelimit);
+  if (result != NULL) {
+    return result;
+  }
+
   res = LDAP_SEARCH(ld, basedn, ldap_search_scope, filter, attrs,
     &ldap_querytimeout_tv, sizelimit, &result);
   if (res != LDAP_SUCCESS) {
@@ -1190,9 +1500,7 @@ static void parse_quota(pool *p, const char *replace, char *str) {
 static unsigned char pr_ldap_quota_lookup(pool *p, char *filter_template,
     const char *replace, const char *basedn) {
   const char *filter = NULL;
-  char *attrs[] = {
-         ldap_attr_ftpquota, ldap_attr_ftpquota_profiledn, NULL,
-       };
+  char **attrs;
   int orig_scope, res;
   LDAPMessage *result, *e;
   LDAP_VALUE_T **values;
@@ -1203,6 +1511,8 @@ static unsigned char pr_ldap_quota_lookup(pool *p, char *filter_template,
     return FALSE;
   }
 
+  attrs = ldap_quota_attrs();
+
   if (filter_template != NULL) {
     filter = pr_ldap_interpolate_filter(p, filter_template, replace);
     if (filter == NULL) {
@@ -1316,9 +1626,7 @@ static unsigned char pr_ldap_quota_lookup(pool *p, char *filter_template,
 static unsigned char pr_ldap_ssh_pubkey_lookup(pool *p, char *filter_template,
     const char *replace, char *basedn) {
   const char *filter;
-  char *attrs[] = {
-    ldap_attr_ssh_pubkey, NULL,
-  };
+  char **attrs;
   int num_keys, i;
   LDAPMessage *result, *e;
   LDAP_VALUE_T **values;
@@ -1330,6 +1638,8 @@ static unsigned char pr_ldap_ssh_pubkey_lookup(pool *p, char *filter_template,
     return FALSE;
   }
 
+  attrs = ldap_ssh_pubkey_attrs();
+
   filter = pr_ldap_interpolate_filter(p, filter_template, replace);
   if (filter == NULL) {
     return FALSE;
@@ -1395,11 +1705,8 @@ static struct group *pr_ldap_getgrgid(pool *p, gid_t gid) {
 
 static struct passwd *pr_ldap_getpwnam(pool *p, const char *username) {
   const char *filter;
-  char *name_attrs[] = {
-         ldap_attr_userpassword, ldap_attr_uid, ldap_attr_uidnumber,
-         ldap_attr_gidnumber, ldap_attr_homedirectory,
-         ldap_attr_loginshell, NULL,
-       };
+
+  ldap_prefetch_user(p, username);
 
   filter = pr_ldap_interpolate_filter(p, ldap_user_basedn, username);
   if (filter == NULL) {
@@ -1427,8 +1734,7 @@ static struct passwd *pr_ldap_getpwnam(pool *p, const char *username) {
    * ldap_auth_check() would always get a crypted password.
    */
   return pr_ldap_user_lookup(p, ldap_user_name_filter, username, filter,
-    ldap_authbinds ? name_attrs + 1 : name_attrs,
-    ldap_authbinds ? &ldap_authbind_dn : NULL);
+    ldap_user_name_attrs(), ldap_authbinds ? &ldap_authbind_dn : NULL);
 }
 
 static struct passwd *pr_ldap_getpwuid(pool *p, uid_t uid) {
@@ -1454,6 +1760,7 @@ MODRET handle_ldap_quota_lookup(cmd_rec *cmd) {
 
   if (cached_quota == NULL ||
       strcasecmp(((char **) cached_quota->elts)[0], cmd->argv[0]) != 0) {
+    ldap_prefetch_user(cmd->tmp_pool, cmd->argv[0]);
 
     if (pr_ldap_quota_lookup(cmd->tmp_pool, ldap_user_name_filter,
         cmd->argv[0], basedn) == FALSE) {
@@ -1486,6 +1793,8 @@ MODRET handle_ldap_ssh_pubkey_lookup(cmd_rec *cmd) {
     return mod_create_data(cmd, cached_ssh_pubkeys);
   }
 
+  ldap_prefetch_user(cmd->tmp_pool, user);
+
   if (pr_ldap_ssh_pubkey_lookup(cmd->tmp_pool, ldap_user_name_filter,
       user, ldap_user_basedn) == FALSE) {
     return PR_DECLINED(cmd);
@@ -1514,6 +1823,14 @@ MODRET ldap_auth_endpwent(cmd_rec *cmd) {
     return PR_DECLINED(cmd);
   }
 
+  /* Keep the bound connection for the later lookups (e.g. for directory
+   * listings, quotas) in this session, rather than connecting and binding
+   * again for them.  It is unbound when the session ends.
+   */
+  if (ldap_persistent_conn == TRUE) {
+    return PR_HANDLED(cmd);
+  }
+
   pr_ldap_unbind();
   return PR_HANDLED(cmd);
 }
@@ -1580,9 +1897,7 @@ MODRET ldap_auth_getgrgid(cmd_rec *cmd) {
 
 MODRET ldap_auth_getgroups(cmd_rec *cmd) {
   const char *filter;
-  char *w[] = {
-    ldap_attr_gidnumber, ldap_attr_cn, NULL,
-  };
+  char **w;
   struct passwd *pw;
   struct group *gr;
   LDAPMessage *result = NULL, *e;
@@ -1599,6 +1914,11 @@ MODRET ldap_auth_getgroups(cmd_rec *cmd) {
     return PR_DECLINED(cmd);
   }
 
+  w = ldap_group_member_attrs();
+
+  /* Send the membership search along with the user lookup, rather than
+   * after it.
+   */
   pw = pr_ldap_getpwnam(cmd->tmp_pool, cmd->argv[0]);
   if (pw != NULL) {
     gr = pr_ldap_getgrgid(cmd->tmp_pool, pw->pw_gid);
@@ -2279,6 +2599,26 @@ MODRET set_ldaplog(cmd_rec *cmd) {
   return PR_HANDLED(cmd);
 }
 
+/* usage: LDAPPersistentConnection on|off */
+MODRET set_ldappersistentconnection(cmd_rec *cmd) {
+  int b;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  b = get_boolean(cmd, 1);
+  if (b == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = pcalloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = b;
+
+  return PR_HANDLED(cmd);
+}
+
 MODRET set_ldapprotoversion(cmd_rec *cmd) {
   int i = 0;
   config_rec *c;
@@ -3170,13 +3510,20 @@ static void ldap_postparse_ev(const void *event_data, void *user_data) {
   }
 }
 
+static void ldap_exit_ev(const void *event_data, void *user_data) {
+  pr_ldap_unbind();
+}
+
 static void ldap_sess_reinit_ev(const void *event_data, void *user_data) {
   int res;
 
   /* A HOST command changed the main_server pointer; reinitialize ourselves. */
 
+  pr_event_unregister(&ldap_module, "core.exit", ldap_exit_ev);
   pr_event_unregister(&ldap_module, "core.session-reinit", ldap_sess_reinit_ev);
 
+  ldap_prefetch_clear(TRUE);
+
   /* Restore defaults. */
   (void) close(ldap_logfd);
   ldap_logfd = -1;
@@ -3191,6 +3538,7 @@ static void ldap_sess_reinit_ev(const void *event_data, void *user_data) {
   ldap_querytimeout = 0;
   ldap_dereference = LDAP_DEREF_NEVER;
   ldap_authbinds = TRUE;
+  ldap_persistent_conn = FALSE;
   ldap_defaultauthscheme = "crypt";
   ldap_attr_uid = "uid";
   ldap_attr_uidnumber = "uidNumber";
@@ -3316,6 +3664,7 @@ static int ldap_sess_init(void) {
   config_rec *c;
   void *ptr;
 
+  pr_event_register(&ldap_module, "core.exit", ldap_exit_ev, NULL);
   pr_event_register(&ldap_module, "core.session-reinit", ldap_sess_reinit_ev,
     NULL);
 
@@ -3419,6 +3768,11 @@ static int ldap_sess_init(void) {
     ldap_authbinds = *((int *) ptr);
   }
 
+  ptr = get_param_ptr(main_server->conf, "LDAPPersistentConnection", FALSE);
+  if (ptr != NULL) {
+    ldap_persistent_conn = *((int *) ptr);
+  }
+
   ptr = get_param_ptr(main_server->conf, "LDAPDefaultAuthScheme", FALSE);
   if (ptr != NULL) {
     ldap_defaultauthscheme = (char *) ptr;
@@ -3630,6 +3984,7 @@ static conftable ldap_conftab[] = {
 				set_ldapgenhdirprefixnouname,	NULL },
   { "LDAPGroups",		set_ldapgrouplookups,		NULL },
   { "LDAPLog",			set_ldaplog,			NULL },
+  { "LDAPPersistentConnection",	set_ldappersistentconnection,	NULL },
   { "LDAPProtocolVersion",	set_ldapprotoversion,		NULL },
   { "LDAPQueryTimeout",		set_ldapquerytimeout,		NULL },
   { "LDAPSearchScope",		set_ldapsearchscope,		NULL },
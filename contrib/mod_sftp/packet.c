@@ -1845,10 +1845,10 @@ static int handle_ssh2_packet(void *data) {
 
     case SFTP_SSH2_MSG_KEXINIT: {
       uint64_t start_ms = 0;
+      int initial_kex;
 
-      if (pr_trace_get_level(timing_channel) > 0) {
-        pr_gettimeofday_millis(&start_ms);
-      }
+      pr_gettimeofday_millis(&start_ms);
+      initial_kex = !(sftp_sess_state & SFTP_SESS_STATE_HAVE_KEX);
 
       /* The client might be initiating a rekey; watch for this. */
       if (!(sftp_sess_state & SFTP_SESS_STATE_HAVE_KEX)) {
@@ -1874,6 +1874,17 @@ static int handle_ssh2_packet(void *data) {
         SFTP_DISCONNECT_CONN(SFTP_SSH2_DISCONNECT_BY_APPLICATION, NULL);
       }
 
+      if (initial_kex) {
+        uint64_t finish_ms;
+
+        /* Only the first key exchange counts as the session handshake. */
+        pr_gettimeofday_millis(&finish_ms);
+        session.handshake_ms = (unsigned long) (finish_ms - start_ms);
+        pr_scoreboard_entry_update(session.pid,
+          PR_SCORE_HANDSHAKE_MS, session.handshake_ms,
+          NULL);
+      }
+
       if (pr_trace_get_level(timing_channel)) {
         unsigned long elapsed_ms;
         uint64_t finish_ms;
@@ -147,11 +147,31 @@ static const char *trace_channel = "sql";
  * cache typedefs
  */
 
-#define CACHE_SIZE         13
+/* Initial number of hash buckets per cache index; the tables double in size
+ * as the caches grow.
+ */
+#define CACHE_INITIAL_NBUCKETS		32
+
+/* Each cache is indexed by both name and ID. */
+#define CACHE_IDX_NAME			0
+#define CACHE_IDX_ID			1
+#define CACHE_NINDEXES			2
 
 typedef struct cache_entry {
+  /* All entries, newest first, for getpwent/getgrent. */
   struct cache_entry *list_next;
-  struct cache_entry *bucket_next;
+  struct cache_entry *list_prev;
+
+  /* All entries, most recently used first, for eviction. */
+  struct cache_entry *lru_next;
+  struct cache_entry *lru_prev;
+
+  struct cache_entry *bucket_next[CACHE_NINDEXES];
+  unsigned int hashval[CACHE_NINDEXES];
+
+  pool *pool;
+  size_t datasz;
+  time_t expires;
   void *data;
 } cache_entry_t;
 
@@ -350,38 +370,82 @@ typedef struct {
   /* memory pool for this object */
   pool *pool;
 
-  /* cache buckets */
-  cache_entry_t *buckets[ CACHE_SIZE ];
+  /* cache buckets, one table per index */
+  pool *bucket_pool;
+  cache_entry_t **buckets[CACHE_NINDEXES];
+  unsigned int nbuckets;
 
   /* cache functions */
-  val_func hash_val;
+  val_func hash_val[CACHE_NINDEXES];
   cmp_func cmp;
 
   /* list pointers */
   cache_entry_t *head;
+  cache_entry_t *lru_head;
+  cache_entry_t *lru_tail;
+
+  /* Entries removed from the cache, whose memory is not yet released. */
+  cache_entry_t *removed;
 
   /* list size */
   unsigned int nelts;
+
+  /* Limits; zero means unlimited. */
+  size_t datasz;
+  size_t max_datasz;
+  int ttl;
+
+  /* Set when the cache is filled via setpwent/setgrent; cleared whenever an
+   * entry is removed, since the cache may then no longer hold every entry.
+   */
+  int complete;
+
+  /* Statistics; misses are counted by the callers which then query the
+   * database.
+   */
+  const char *name;
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+  unsigned long expirations;
 } cache_t;
 
-static cache_t *group_name_cache = NULL;
-static cache_t *group_gid_cache = NULL;
-static cache_t *passwd_name_cache = NULL;
-static cache_t *passwd_uid_cache = NULL;
+static cache_t *group_cache = NULL;
+static cache_t *passwd_cache = NULL;
 
-static cache_t *make_cache(pool *p, val_func hash_val, cmp_func cmp) {
+static cache_t *make_cache(pool *p, const char *name, val_func name_val,
+    val_func id_val, cmp_func cmp, size_t max_datasz, int ttl) {
+  register unsigned int i;
   cache_t *res;
+  pool *cache_pool;
 
   if (p == NULL ||
-      hash_val == NULL || 
+      name_val == NULL ||
+      id_val == NULL ||
       cmp == NULL)
     return NULL;
 
-  res = (cache_t *) pcalloc(p, sizeof(cache_t));
+  cache_pool = make_sub_pool(p);
+  pr_pool_tag(cache_pool, "SQL cache pool");
+
+  res = (cache_t *) pcalloc(cache_pool, sizeof(cache_t));
 
-  res->pool = p;
-  res->hash_val = hash_val;
+  res->pool = cache_pool;
+  res->name = name;
+  res->hash_val[CACHE_IDX_NAME] = name_val;
+  res->hash_val[CACHE_IDX_ID] = id_val;
   res->cmp = cmp;
+  res->max_datasz = max_datasz;
+  res->ttl = ttl;
+
+  res->bucket_pool = make_sub_pool(cache_pool);
+  pr_pool_tag(res->bucket_pool, "SQL cache buckets pool");
+
+  res->nbuckets = CACHE_INITIAL_NBUCKETS;
+  for (i = 0; i < CACHE_NINDEXES; i++) {
+    res->buckets[i] = pcalloc(res->bucket_pool,
+      res->nbuckets * sizeof(cache_entry_t *));
+  }
 
   res->head = NULL;
 
@@ -390,46 +454,260 @@ static cache_t *make_cache(pool *p, val_func hash_val, cmp_func cmp) {
   return res;
 }
 
-static cache_entry_t *cache_addentry(cache_t *cache, void *data) {
+/* Returns the pool from which the data for a new cache entry should be
+ * allocated.  Entries which may later be evicted or expire get their own
+ * pools, so that their memory can be released.
+ */
+static pool *cache_entry_pool(cache_t *cache) {
+  pool *entry_pool;
+
+  if (cache->max_datasz == 0 &&
+      cache->ttl == 0) {
+    return cache->pool;
+  }
+
+  entry_pool = make_sub_pool(cache->pool);
+  pr_pool_tag(entry_pool, "SQL cache entry pool");
+
+  return entry_pool;
+}
+
+static void cache_resize(cache_t *cache) {
+  register unsigned int i;
+  pool *bucket_pool;
+  cache_entry_t **buckets[CACHE_NINDEXES], *entry;
+  unsigned int nbuckets;
+
+  nbuckets = cache->nbuckets * 2;
+
+  bucket_pool = make_sub_pool(cache->pool);
+  pr_pool_tag(bucket_pool, "SQL cache buckets pool");
+
+  for (i = 0; i < CACHE_NINDEXES; i++) {
+    buckets[i] = pcalloc(bucket_pool, nbuckets * sizeof(cache_entry_t *));
+  }
+
+  for (entry = cache->head; entry != NULL; entry = entry->list_next) {
+    for (i = 0; i < CACHE_NINDEXES; i++) {
+      unsigned int idx;
+
+      idx = entry->hashval[i] & (nbuckets - 1);
+      entry->bucket_next[i] = buckets[i][idx];
+      buckets[i][idx] = entry;
+    }
+  }
+
+  destroy_pool(cache->bucket_pool);
+  cache->bucket_pool = bucket_pool;
+  cache->nbuckets = nbuckets;
+  for (i = 0; i < CACHE_NINDEXES; i++) {
+    cache->buckets[i] = buckets[i];
+  }
+
+  pr_trace_msg(trace_channel, 15, "resized %s cache to %u buckets (%u entries)",
+    cache->name, nbuckets, cache->nelts);
+}
+
+static void cache_lru_unlink(cache_t *cache, cache_entry_t *entry) {
+  if (entry->lru_prev != NULL) {
+    entry->lru_prev->lru_next = entry->lru_next;
+
+  } else {
+    cache->lru_head = entry->lru_next;
+  }
+
+  if (entry->lru_next != NULL) {
+    entry->lru_next->lru_prev = entry->lru_prev;
+
+  } else {
+    cache->lru_tail = entry->lru_prev;
+  }
+
+  entry->lru_next = entry->lru_prev = NULL;
+}
+
+static void cache_lru_push(cache_t *cache, cache_entry_t *entry) {
+  entry->lru_prev = NULL;
+  entry->lru_next = cache->lru_head;
+
+  if (cache->lru_head != NULL) {
+    cache->lru_head->lru_prev = entry;
+  }
+
+  cache->lru_head = entry;
+
+  if (cache->lru_tail == NULL) {
+    cache->lru_tail = entry;
+  }
+}
+
+/* Unlinks the entry from the cache.  Its memory is not released until
+ * cache_release(), as callers may still be using the data returned by an
+ * earlier lookup.
+ */
+static void cache_removeentry(cache_t *cache, cache_entry_t *entry) {
+  register unsigned int i;
+
+  for (i = 0; i < CACHE_NINDEXES; i++) {
+    cache_entry_t **ptr;
+
+    ptr = &(cache->buckets[i][entry->hashval[i] & (cache->nbuckets - 1)]);
+    while (*ptr != NULL) {
+      if (*ptr == entry) {
+        *ptr = entry->bucket_next[i];
+        break;
+      }
+
+      ptr = &((*ptr)->bucket_next[i]);
+    }
+  }
+
+  cache_lru_unlink(cache, entry);
+
+  /* Keep any getpwent/getgrent iteration going past this entry. */
+  if (cmap.curr_passwd == entry) {
+    cmap.curr_passwd = entry->list_next;
+  }
+
+  if (cmap.curr_group == entry) {
+    cmap.curr_group = entry->list_next;
+  }
+
+  if (entry->list_prev != NULL) {
+    entry->list_prev->list_next = entry->list_next;
+
+  } else {
+    cache->head = entry->list_next;
+  }
+
+  if (entry->list_next != NULL) {
+    entry->list_next->list_prev = entry->list_prev;
+  }
+
+  entry->list_prev = NULL;
+  entry->list_next = cache->removed;
+  cache->removed = entry;
+
+  cache->nelts--;
+  cache->datasz -= entry->datasz;
+  cache->complete = FALSE;
+}
+
+static void cache_release(cache_t *cache) {
+  cache_entry_t *entry;
+
+  if (cache == NULL) {
+    return;
+  }
+
+  entry = cache->removed;
+  while (entry != NULL) {
+    cache_entry_t *next;
+
+    next = entry->list_next;
+    if (entry->pool != cache->pool) {
+      destroy_pool(entry->pool);
+    }
+
+    entry = next;
+  }
+
+  cache->removed = NULL;
+}
+
+/* Removes all expired entries; returns the number removed. */
+static unsigned int cache_expire(cache_t *cache) {
+  cache_entry_t *entry;
+  unsigned int count = 0;
+  time_t now;
+
+  if (cache->ttl == 0) {
+    return 0;
+  }
+
+  now = time(NULL);
+
+  entry = cache->head;
+  while (entry != NULL) {
+    cache_entry_t *next;
+
+    next = entry->list_next;
+    if (entry->expires <= now) {
+      cache_removeentry(cache, entry);
+      cache->expirations++;
+      count++;
+    }
+
+    entry = next;
+  }
+
+  return count;
+}
+
+static cache_entry_t *cache_addentry(cache_t *cache, pool *entry_pool,
+    void *data, size_t datasz) {
+  register unsigned int i;
   cache_entry_t *entry;
-  int hashval;
 
   if (cache == NULL ||
+      entry_pool == NULL ||
       data == NULL)
     return NULL;
 
   /* create the entry */
-  entry = (cache_entry_t *) pcalloc(cache->pool, sizeof(cache_entry_t));
+  entry = (cache_entry_t *) pcalloc(entry_pool, sizeof(cache_entry_t));
+  entry->pool = entry_pool;
   entry->data = data;
+  entry->datasz = sizeof(cache_entry_t) + datasz;
 
-  /* deal with the list */
-
-  if (cache->head == NULL) {
-    cache->head = entry;
+  if (cache->ttl > 0) {
+    entry->expires = time(NULL) + cache->ttl;
+  }
 
-  } else {
-    entry->list_next = cache->head;
-    cache->head = entry;
+  /* deal with the lists */
+  entry->list_next = cache->head;
+  if (cache->head != NULL) {
+    cache->head->list_prev = entry;
   }
+  cache->head = entry;
+
+  cache_lru_push(cache, entry);
 
   /* deal with the buckets */
-  hashval = cache->hash_val(data) % CACHE_SIZE;
-  if (cache->buckets[hashval] == NULL) {
-    cache->buckets[hashval] = entry;
+  for (i = 0; i < CACHE_NINDEXES; i++) {
+    unsigned int idx;
 
-  } else {
-    entry->bucket_next = cache->buckets[hashval];
-    cache->buckets[hashval] = entry;
+    entry->hashval[i] = cache->hash_val[i](data);
+    idx = entry->hashval[i] & (cache->nbuckets - 1);
+
+    entry->bucket_next[i] = cache->buckets[i][idx];
+    cache->buckets[i][idx] = entry;
   }
-  
+
   cache->nelts++;
+  cache->datasz += entry->datasz;
+
+  if (cache->nelts > cache->nbuckets) {
+    cache_resize(cache);
+  }
+
+  /* Evict the least recently used entries, if over our limit. */
+  while (cache->max_datasz > 0 &&
+         cache->datasz > cache->max_datasz &&
+         cache->lru_tail != entry) {
+    pr_trace_msg(trace_channel, 17, "evicting entry from %s cache "
+      "(%lu bytes used, limit %lu bytes)", cache->name,
+      (unsigned long) cache->datasz, (unsigned long) cache->max_datasz);
+    cache_removeentry(cache, cache->lru_tail);
+    cache->evictions++;
+  }
 
   return entry;
 }
 
-static void *cache_findvalue(cache_t *cache, void *data) {
+static void *cache_findvalue(cache_t *cache, int idx, void *data) {
   cache_entry_t *entry;
-  int hashval;
+  unsigned int hashval;
 
   if (cache == NULL ||
       data == NULL) {
@@ -437,20 +715,61 @@ static void *cache_findvalue(cache_t *cache, void *data) {
     return NULL;
   }
 
-  hashval = cache->hash_val(data) % CACHE_SIZE;
+  hashval = cache->hash_val[idx](data);
 
-  entry = cache->buckets[hashval];
+  entry = cache->buckets[idx][hashval & (cache->nbuckets - 1)];
   while (entry != NULL) {
     pr_signals_handle();
 
-    if (cache->cmp(data, entry->data)) {
+    if (entry->hashval[idx] == hashval &&
+        cache->cmp(data, entry->data)) {
       break;
     }
 
-    entry = entry->bucket_next;
+    entry = entry->bucket_next[idx];
+  }
+
+  if (entry == NULL) {
+    return NULL;
   }
 
-  return (entry == NULL ? NULL : entry->data);
+  if (cache->ttl > 0 &&
+      entry->expires <= time(NULL)) {
+    cache_removeentry(cache, entry);
+    cache->expirations++;
+    return NULL;
+  }
+
+  if (cache->lru_head != entry) {
+    cache_lru_unlink(cache, entry);
+    cache_lru_push(cache, entry);
+  }
+
+  cache->hits++;
+  return entry->data;
+}
+
+static void cache_log_stats(cache_t *cache) {
+  if (cache == NULL) {
+    return;
+  }
+
+  pr_trace_msg(trace_channel, 8, "%s cache: %u entries, %lu bytes, "
+    "%u buckets, %lu hits, %lu misses, %lu evictions, %lu expirations",
+    cache->name, cache->nelts, (unsigned long) cache->datasz, cache->nbuckets,
+    cache->hits, cache->misses, cache->evictions, cache->expirations);
+}
+
+/* Session notes may outlive the cache entries from which they are set, so
+ * the notes get their own copies of the values.
+ */
+static int sql_add_note(const char *key, const char *value) {
+  if (pr_table_get(session.notes, key, NULL) != NULL) {
+    errno = EEXIST;
+    return -1;
+  }
+
+  return pr_table_add(session.notes, key, pstrdup(session.pool, value), 0);
 }
 
 cmd_rec *sql_make_cmd(pool *p, int argc, ...) {
@@ -517,6 +836,19 @@ static int check_response(modret_t *mr, int flags) {
   return -1;
 }
 
+/* Whether the backend failed to prepare a statement for sql_execute, or to
+ * bind its parameters, rather than to run it.
+ */
+static int sql_is_prepare_error(modret_t *mr) {
+  if (MODRET_ISERROR(mr) &&
+      mr->mr_numeric != NULL &&
+      strcmp(mr->mr_numeric, MOD_SQL_PREPARE_ERROR) == 0) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
 static modret_t *sql_dispatch(cmd_rec *cmd, char *cmdname) {
   modret_t *mr = NULL;
   register unsigned int i = 0;
@@ -536,6 +868,75 @@ static modret_t *sql_dispatch(cmd_rec *cmd, char *cmdname) {
   return PR_ERROR(cmd);
 }
 
+/* Returns TRUE if the current backend implements the given command. */
+static int sql_backend_has_cmd(const char *cmdname) {
+  register unsigned int i;
+
+  for (i = 0; sql_cmdtable[i].command; i++) {
+    if (strcmp(cmdname, sql_cmdtable[i].command) == 0) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static unsigned int sql_get_conn_policy(const char *conn_name) {
+  struct sql_named_conn *snc;
+
+  for (snc = sql_named_conns; snc; snc = snc->next) {
+    if (strcmp(snc->conn_name, conn_name) == 0) {
+      return snc->conn_policy;
+    }
+  }
+
+  return pr_sql_conn_policy;
+}
+
+/* Set if the SQLUserInfo/SQLGroupInfo lookups failed as prepared statements,
+ * so that the text queries are used instead.
+ */
+static int sql_userinfo_unbindable = FALSE;
+static int sql_groupinfo_unbindable = FALSE;
+
+static int sql_use_prepared_stmts(const char *conn_name) {
+  if (!(pr_sql_opts & SQL_OPT_USE_PREPARED_STATEMENTS)) {
+    return FALSE;
+  }
+
+  /* A PERCALL connection is closed after each query, taking its prepared
+   * statements with it; preparing them would only cost another round trip.
+   */
+  if (sql_get_conn_policy(conn_name) == SQL_CONN_POLICY_PERCALL) {
+    return FALSE;
+  }
+
+  return sql_backend_has_cmd("sql_execute");
+}
+
+/* Build the "sql_execute" cmd_rec: connection name, statement, then the
+ * parameter values.
+ */
+static cmd_rec *sql_make_execute_cmd(pool *p, const char *conn_name,
+    const char *query, array_header *params) {
+  register unsigned int i;
+  cmd_rec *cmd;
+
+  cmd = sql_make_cmd(p, 2, conn_name, query);
+  cmd->argv = pcalloc(cmd->pool, sizeof(void *) * (params->nelts + 3));
+  cmd->argv[0] = (void *) conn_name;
+  cmd->argv[1] = (void *) query;
+
+  for (i = 0; i < params->nelts; i++) {
+    cmd->argv[i+2] = ((char **) params->elts)[i];
+  }
+
+  cmd->argc = params->nelts + 2;
+  cmd->argv[cmd->argc] = NULL;
+
+  return cmd;
+}
+
 static struct sql_backend *sql_get_backend(const char *backend) {
   struct sql_backend *sb;
 
@@ -735,8 +1136,18 @@ struct sql_resolved {
   /* Used for escaping the resolved values per the database rules. */
   const char *conn_name;
   int conn_flags;
+
+  /* When non-NULL, quoted values are replaced with $N placeholders, and the
+   * values themselves collected here, for use with prepared statements.
+   */
+  array_header *params;
+  int param_flags;
 };
 
+#define SQL_RESOLVED_FL_PENDING_QUOTE		0x001
+#define SQL_RESOLVED_FL_UNBINDABLE		0x002
+#define SQL_RESOLVED_FL_ESCAPED_VALUE		0x004
+
 static int is_escaped_text(const char *text, size_t text_len) {
   register unsigned int i;
 
@@ -757,11 +1168,69 @@ static int is_escaped_text(const char *text, size_t text_len) {
   return TRUE;
 }
 
+/* Only values which are the entire contents of a single-quoted literal,
+ * e.g. '%U', can be replaced by a placeholder; anything else means the
+ * query has to be handled as plain text.
+ */
+static int sql_resolved_append_param(pool *p, struct sql_resolved *resolved,
+    const char *text, size_t text_len) {
+  char placeholder[32];
+  size_t placeholder_len, used;
+
+  if ((resolved->param_flags & SQL_RESOLVED_FL_UNBINDABLE) ||
+      (resolved->param_flags & SQL_RESOLVED_FL_ESCAPED_VALUE)) {
+    return 0;
+  }
+
+  used = resolved->bufsz - resolved->buflen;
+  if ((resolved->param_flags & SQL_RESOLVED_FL_PENDING_QUOTE) ||
+      used == 0 ||
+      resolved->buf[-1] != '\'' ||
+      (used > 1 && resolved->buf[-2] == '\'')) {
+    resolved->param_flags |= SQL_RESOLVED_FL_UNBINDABLE;
+    return 0;
+  }
+
+  if (text != NULL &&
+      text_len > 0 &&
+      is_escaped_text(text, text_len) == TRUE) {
+    resolved->param_flags |= SQL_RESOLVED_FL_ESCAPED_VALUE;
+    return 0;
+  }
+
+  placeholder_len = pr_snprintf(placeholder, sizeof(placeholder)-1, "$%d",
+    resolved->params->nelts + 1);
+  if (placeholder_len > resolved->buflen + 1) {
+    resolved->param_flags |= SQL_RESOLVED_FL_UNBINDABLE;
+    return 0;
+  }
+
+  /* Overwrite the opening quote with the placeholder. */
+  resolved->buf--;
+  resolved->buflen++;
+
+  memcpy(resolved->buf, placeholder, placeholder_len);
+  resolved->buf += placeholder_len;
+  resolved->buflen -= placeholder_len;
+
+  *((char **) push_array(resolved->params)) = text != NULL ?
+    pstrndup(p, text, text_len) : pstrdup(p, "");
+  resolved->param_flags |= SQL_RESOLVED_FL_PENDING_QUOTE;
+
+  pr_trace_msg(trace_channel, 19, "appending parameter %s to buffer",
+    placeholder);
+  return 0;
+}
+
 static int sql_resolved_append_text(pool *p, struct sql_resolved *resolved,
     const char *text, size_t text_len) {
   char *new_text;
   size_t new_textlen;
 
+  if (resolved->params != NULL) {
+    return sql_resolved_append_param(p, resolved, text, text_len);
+  }
+
   if (text == NULL ||
       text_len == 0) {
     return 0;
@@ -1083,7 +1552,25 @@ static int sql_resolve_on_other(pool *p, pr_jot_ctx_t *jot_ctx,
   struct sql_resolved *resolved;
 
   resolved = jot_ctx->log;
-  if (resolved->buflen > 0) {
+
+  if (resolved->params != NULL &&
+      (resolved->param_flags & SQL_RESOLVED_FL_PENDING_QUOTE)) {
+    /* Consume the closing quote of the literal we replaced. */
+    resolved->param_flags &= ~SQL_RESOLVED_FL_PENDING_QUOTE;
+
+    if (text_len == 0 ||
+        text[0] != '\'' ||
+        (text_len > 1 && text[1] == '\'')) {
+      resolved->param_flags |= SQL_RESOLVED_FL_UNBINDABLE;
+
+    } else {
+      text++;
+      text_len--;
+    }
+  }
+
+  if (resolved->buflen > 0 &&
+      text_len > 0) {
     pr_trace_msg(trace_channel, 19, "appending text '%.*s' (%lu) to buffer",
       (int) text_len, text, (unsigned long) text_len);
     memcpy(resolved->buf, text, text_len);
@@ -1506,7 +1993,7 @@ static unsigned int _group_name(const void *val) {
 
   namelen = strlen(name);
   for (i = 0; i < namelen; i++) {
-    nameval += name[i];
+    nameval = (nameval * 33) + (unsigned char) name[i];
   }
 
   return nameval;
@@ -1556,7 +2043,7 @@ static unsigned int _passwd_name(const void *val) {
 
   namelen = strlen(name);
   for (i = 0; i < namelen; i++) {
-    nameval += name[i];
+    nameval = (nameval * 33) + (unsigned char) name[i];
   }
 
   return nameval;
@@ -1636,33 +2123,43 @@ static struct passwd *_sql_addpasswd(cmd_rec *cmd, char *username,
     char *password, uid_t uid, gid_t gid, char *shell, char *dir) {
   struct passwd *cached = NULL;
   struct passwd *pwd = NULL;
+  pool *entry_pool;
+  size_t datasz;
 
   pwd = pcalloc(cmd->tmp_pool, sizeof(struct passwd));
   pwd->pw_uid = uid;
   pwd->pw_name = username;
 
   /* check to make sure the entry doesn't exist in the cache */
-  cached = (struct passwd *) cache_findvalue(passwd_name_cache, pwd);
+  cached = (struct passwd *) cache_findvalue(passwd_cache, CACHE_IDX_NAME,
+    pwd);
   if (cached != NULL) {
     pwd = cached;
     sql_log(DEBUG_INFO, "cache hit for user '%s'", pwd->pw_name);
 
   } else {
-    pwd = pcalloc(sql_pool, sizeof(struct passwd));
+    entry_pool = cache_entry_pool(passwd_cache);
+    pwd = pcalloc(entry_pool, sizeof(struct passwd));
+    datasz = sizeof(struct passwd);
 
-    if (username)
-      pwd->pw_name = pstrdup(sql_pool, username);
+    if (username) {
+      pwd->pw_name = pstrdup(entry_pool, username);
+      datasz += strlen(username) + 1;
+    }
 
-    if (password)
-      pwd->pw_passwd = pstrdup(sql_pool, password);
+    if (password) {
+      pwd->pw_passwd = pstrdup(entry_pool, password);
+      datasz += strlen(password) + 1;
+    }
     
     pwd->pw_uid = uid;
     pwd->pw_gid = gid;
    
     if (shell) {
-      pwd->pw_shell = pstrdup(sql_pool, shell);
+      pwd->pw_shell = pstrdup(entry_pool, shell);
+      datasz += strlen(shell) + 1;
 
-      if (pr_table_add(session.notes, "shell", pwd->pw_shell, 0) < 0) {
+      if (sql_add_note("shell", pwd->pw_shell) < 0) {
         int xerrno = errno;
 
         if (xerrno != EEXIST) {
@@ -1673,9 +2170,10 @@ static struct passwd *_sql_addpasswd(cmd_rec *cmd, char *username,
     }
 
     if (dir) {
-      pwd->pw_dir = pstrdup(sql_pool, dir);
+      pwd->pw_dir = pstrdup(entry_pool, dir);
+      datasz += strlen(dir) + 1;
 
-      if (pr_table_add(session.notes, "home", pwd->pw_dir, 0) < 0) {
+      if (sql_add_note("home", pwd->pw_dir) < 0) {
         int xerrno = errno;
 
         if (xerrno != EEXIST) {
@@ -1685,8 +2183,7 @@ static struct passwd *_sql_addpasswd(cmd_rec *cmd, char *username,
       }
     }
     
-    cache_addentry(passwd_name_cache, pwd);
-    cache_addentry(passwd_uid_cache, pwd);
+    cache_addentry(passwd_cache, entry_pool, pwd, datasz);
 
     sql_log(DEBUG_INFO, "cache miss for user '%s'", pwd->pw_name);
     sql_log(DEBUG_INFO, "user '%s' cached", pwd->pw_name);
@@ -1911,10 +2408,10 @@ static struct passwd *sql_getpasswd(cmd_rec *cmd, struct passwd *p) {
    * Give preference to name-based lookups, as opposed to UID-based lookups.
    */
   if (p->pw_name != NULL) {
-    pwd = (struct passwd *) cache_findvalue(passwd_name_cache, p);
+    pwd = (struct passwd *) cache_findvalue(passwd_cache, CACHE_IDX_NAME, p);
 
   } else {
-    pwd = (struct passwd *) cache_findvalue(passwd_uid_cache, p);
+    pwd = (struct passwd *) cache_findvalue(passwd_cache, CACHE_IDX_ID, p);
   }
 
   if (pwd != NULL) {
@@ -1933,6 +2430,8 @@ static struct passwd *sql_getpasswd(cmd_rec *cmd, struct passwd *p) {
     return pwd;
   }
 
+  passwd_cache->misses++;
+
   if (p->pw_name != NULL) {
     realname = p->pw_name;
 
@@ -1957,11 +2456,45 @@ static struct passwd *sql_getpasswd(cmd_rec *cmd, struct passwd *p) {
        * string as-is, lest we corrupt/change the user name.
        */
 
-      where = sql_prepare_where(SQL_PREPARE_WHERE_FL_NO_TAGS, cmd, 2, usrwhere,
-        sql_prepare_where(0, cmd, 1, cmap.userwhere, NULL), NULL);
+      mr = NULL;
+
+      if (sql_use_prepared_stmts(MOD_SQL_DEF_CONN_NAME) == TRUE &&
+          sql_userinfo_unbindable == FALSE) {
+        array_header *params;
+        char *query, *bindwhere;
+
+        /* Bind the user name as a parameter, so that the statement text
+         * is the same for every user, and can be prepared once.
+         */
+        bindwhere = pstrcat(cmd->tmp_pool, cmap.usrfield, " = $1", NULL);
+        where = sql_prepare_where(SQL_PREPARE_WHERE_FL_NO_TAGS, cmd, 2,
+          bindwhere, sql_prepare_where(0, cmd, 1, cmap.userwhere, NULL), NULL);
+
+        query = pstrcat(cmd->tmp_pool, "SELECT ", cmap.usrfields, " FROM ",
+          cmap.usrtable, " WHERE ", where, " LIMIT 1", NULL);
+
+        params = make_array(cmd->tmp_pool, 1, sizeof(char *));
+        *((char **) push_array(params)) = realname;
+
+        mr = sql_dispatch(sql_make_execute_cmd(cmd->tmp_pool,
+          MOD_SQL_DEF_CONN_NAME, query, params), "sql_execute");
+        if (sql_is_prepare_error(mr)) {
+          sql_log(DEBUG_WARN, "SQLUserInfo query cannot be prepared "
+            "(%s), using text query instead",
+            mr->mr_message ? mr->mr_message : "unknown error");
+          sql_userinfo_unbindable = TRUE;
+          mr = NULL;
+        }
+      }
+
+      if (mr == NULL) {
+        where = sql_prepare_where(SQL_PREPARE_WHERE_FL_NO_TAGS, cmd, 2,
+          usrwhere, sql_prepare_where(0, cmd, 1, cmap.userwhere, NULL), NULL);
+
+        mr = sql_dispatch(sql_make_cmd(cmd->tmp_pool, 5, MOD_SQL_DEF_CONN_NAME,
+          cmap.usrtable, cmap.usrfields, where, "1"), "sql_select");
+      }
 
-      mr = sql_dispatch(sql_make_cmd(cmd->tmp_pool, 5, MOD_SQL_DEF_CONN_NAME,
-        cmap.usrtable, cmap.usrfields, where, "1"), "sql_select");
       if (check_response(mr, 0) < 0) {
         return NULL;
       }
@@ -2165,23 +2698,29 @@ static struct group *_sql_addgroup(cmd_rec *cmd, char *groupname, gid_t gid,
     array_header *ah) {
   struct group *cached = NULL;
   struct group *grp = NULL;
+  pool *entry_pool;
+  size_t datasz;
 
   grp = pcalloc(cmd->tmp_pool, sizeof(struct group));
   grp->gr_gid = gid;
   grp->gr_name = groupname;
 
   /* check to make sure the entry doesn't exist in the cache */
-  if ((cached = (struct group *) cache_findvalue(group_name_cache, grp)) != NULL) {
+  cached = (struct group *) cache_findvalue(group_cache, CACHE_IDX_NAME, grp);
+  if (cached != NULL) {
     grp = cached;
     sql_log(DEBUG_INFO, "cache hit for group '%s'", grp->gr_name);
 
   } else {
-    grp = pcalloc(sql_pool, sizeof(struct group));
+    entry_pool = cache_entry_pool(group_cache);
+    grp = pcalloc(entry_pool, sizeof(struct group));
+    datasz = sizeof(struct group);
 
     if (groupname) {
-      grp->gr_name = pstrdup(sql_pool, groupname);
+      grp->gr_name = pstrdup(entry_pool, groupname);
+      datasz += strlen(groupname) + 1;
 
-      if (pr_table_add(session.notes, "primary-group", grp->gr_name, 0) < 0) {
+      if (sql_add_note("primary-group", grp->gr_name) < 0) {
         int xerrno = errno;
 
         if (xerrno != EEXIST) {
@@ -2197,18 +2736,19 @@ static struct group *_sql_addgroup(cmd_rec *cmd, char *groupname, gid_t gid,
       register unsigned int i;
 
       /* finish filling in the group */
-      grp->gr_mem = (char **) pcalloc(sql_pool,
+      grp->gr_mem = (char **) pcalloc(entry_pool,
         sizeof(char *) * (ah->nelts + 1));
+      datasz += sizeof(char *) * (ah->nelts + 1);
 
       for (i = 0; i < ah->nelts; i++) {
-        grp->gr_mem[i] = pstrdup(sql_pool, ((char **) ah->elts)[i]);
+        grp->gr_mem[i] = pstrdup(entry_pool, ((char **) ah->elts)[i]);
+        datasz += strlen(grp->gr_mem[i]) + 1;
       }
 
       grp->gr_mem[i] = NULL;
     }
 
-    cache_addentry(group_name_cache, grp);
-    cache_addentry(group_gid_cache, grp);
+    cache_addentry(group_cache, entry_pool, grp, datasz);
 
     sql_log(DEBUG_INFO, "cache miss for group '%s'", grp->gr_name);
     sql_log(DEBUG_INFO, "group '%s' cached", grp->gr_name);
@@ -2218,6 +2758,61 @@ static struct group *_sql_addgroup(cmd_rec *cmd, char *groupname, gid_t gid,
   return grp;
 }
 
+/* Cache entries may be evicted, or expire, and have their memory released;
+ * anything handed out beyond the current command is thus a copy.
+ */
+static struct passwd *sql_dup_passwd(pool *p, struct passwd *pw) {
+  struct passwd *res;
+
+  res = pcalloc(p, sizeof(struct passwd));
+  memcpy(res, pw, sizeof(struct passwd));
+
+  if (pw->pw_name != NULL) {
+    res->pw_name = pstrdup(p, pw->pw_name);
+  }
+
+  if (pw->pw_passwd != NULL) {
+    res->pw_passwd = pstrdup(p, pw->pw_passwd);
+  }
+
+  if (pw->pw_dir != NULL) {
+    res->pw_dir = pstrdup(p, pw->pw_dir);
+  }
+
+  if (pw->pw_shell != NULL) {
+    res->pw_shell = pstrdup(p, pw->pw_shell);
+  }
+
+  return res;
+}
+
+static struct group *sql_dup_group(pool *p, struct group *gr) {
+  struct group *res;
+
+  res = pcalloc(p, sizeof(struct group));
+  memcpy(res, gr, sizeof(struct group));
+
+  if (gr->gr_name != NULL) {
+    res->gr_name = pstrdup(p, gr->gr_name);
+  }
+
+  if (gr->gr_mem != NULL) {
+    register unsigned int i;
+    unsigned int nmem = 0;
+
+    while (gr->gr_mem[nmem] != NULL) {
+      nmem++;
+    }
+
+    res->gr_mem = pcalloc(p, sizeof(char *) * (nmem + 1));
+    for (i = 0; i < nmem; i++) {
+      res->gr_mem[i] = pstrdup(p, gr->gr_mem[i]);
+    }
+  }
+
+  return res;
+}
+
 static struct group *sql_getgroup(cmd_rec *cmd, struct group *g) {
   struct group *grp = NULL;
   modret_t *mr = NULL;
@@ -2242,8 +2837,10 @@ static struct group *sql_getgroup(cmd_rec *cmd, struct group *g) {
   }
 
   /* check to see if the group already exists in one of the group caches */
-  if (((grp = (struct group *) cache_findvalue(group_name_cache, g)) != NULL) ||
-      ((grp = (struct group *) cache_findvalue(group_gid_cache, g)) != NULL)) {
+  if (((grp = (struct group *) cache_findvalue(group_cache, CACHE_IDX_NAME,
+        g)) != NULL) ||
+      ((grp = (struct group *) cache_findvalue(group_cache, CACHE_IDX_ID,
+        g)) != NULL)) {
     sql_log(DEBUG_AUTH, "cache hit for group '%s'", grp->gr_name);
 
     /* Check for negatively cached groups, which will have NULL gr_mem. */
@@ -2255,6 +2852,8 @@ static struct group *sql_getgroup(cmd_rec *cmd, struct group *g) {
     return grp;
   }
 
+  group_cache->misses++;
+
   if (g->gr_name != NULL) {
     groupname = g->gr_name;
     sql_log(DEBUG_WARN, "cache miss for group '%s'", groupname);
@@ -2324,14 +2923,44 @@ static struct group *sql_getgroup(cmd_rec *cmd, struct group *g) {
   }
 
   if (!cmap.groupcustombyname) {
-    grpwhere = pstrcat(cmd->tmp_pool, cmap.grpfield, " = '", groupname, "'",
-      NULL);
+    mr = NULL;
 
-    where = sql_prepare_where(SQL_PREPARE_WHERE_FL_NO_TAGS, cmd, 2, grpwhere,
-      sql_prepare_where(0, cmd, 1, cmap.groupwhere, NULL), NULL);
+    if (sql_use_prepared_stmts(MOD_SQL_DEF_CONN_NAME) == TRUE &&
+        sql_groupinfo_unbindable == FALSE) {
+      array_header *params;
+      char *query;
+
+      grpwhere = pstrcat(cmd->tmp_pool, cmap.grpfield, " = $1", NULL);
+      where = sql_prepare_where(SQL_PREPARE_WHERE_FL_NO_TAGS, cmd, 2, grpwhere,
+        sql_prepare_where(0, cmd, 1, cmap.groupwhere, NULL), NULL);
+
+      query = pstrcat(cmd->tmp_pool, "SELECT ", cmap.grpfields, " FROM ",
+        cmap.grptable, " WHERE ", where, NULL);
+
+      params = make_array(cmd->tmp_pool, 1, sizeof(char *));
+      *((char **) push_array(params)) = groupname;
+
+      mr = sql_dispatch(sql_make_execute_cmd(cmd->tmp_pool,
+        MOD_SQL_DEF_CONN_NAME, query, params), "sql_execute");
+      if (sql_is_prepare_error(mr)) {
+        sql_log(DEBUG_WARN, "SQLGroupInfo query cannot be prepared "
+          "(%s), using text query instead",
+          mr->mr_message ? mr->mr_message : "unknown error");
+        sql_groupinfo_unbindable = TRUE;
+        mr = NULL;
+      }
+    }
+
+    if (mr == NULL) {
+      grpwhere = pstrcat(cmd->tmp_pool, cmap.grpfield, " = '", groupname, "'",
+        NULL);
+      where = sql_prepare_where(SQL_PREPARE_WHERE_FL_NO_TAGS, cmd, 2, grpwhere,
+        sql_prepare_where(0, cmd, 1, cmap.groupwhere, NULL), NULL);
+
+      mr = sql_dispatch(sql_make_cmd(cmd->tmp_pool, 4, MOD_SQL_DEF_CONN_NAME,
+        cmap.grptable, cmap.grpfields, where), "sql_select");
+    }
 
-    mr = sql_dispatch(sql_make_cmd(cmd->tmp_pool, 4, MOD_SQL_DEF_CONN_NAME,
-      cmap.grptable, cmap.grpfields, where), "sql_select");
     if (check_response(mr, 0) < 0) {
       return NULL;
     }
@@ -2448,6 +3077,7 @@ static int sql_getgroups(cmd_rec *cmd) {
   char *name = cmd->argv[0], *username = NULL;
   int argc, numrows = 0, res = -1;
   register int i = 0;
+  pool *groups_pool;
 
   /* Check for NULL values */
   if (cmd->argv[1]) {
@@ -2458,6 +3088,9 @@ static int sql_getgroups(cmd_rec *cmd) {
     groups = (array_header *) cmd->argv[2];
   }
 
+  /* The group names returned are kept by mod_auth for the session. */
+  groups_pool = session.pool != NULL ? session.pool : permanent_pool;
+
   lpw.pw_uid = -1;
   lpw.pw_gid = -1;
   lpw.pw_name = name;
@@ -2487,7 +3120,7 @@ static int sql_getgroups(cmd_rec *cmd) {
 
   if (groups &&
       (grp = sql_getgroup(cmd, &lgr)) != NULL) {
-    *((char **) push_array(groups)) = pstrdup(permanent_pool, grp->gr_name);
+    *((char **) push_array(groups)) = pstrdup(groups_pool, grp->gr_name);
   }
 
   mr = sql_dispatch(sql_make_cmd(cmd->tmp_pool, 2, MOD_SQL_DEF_CONN_NAME,
@@ -2586,7 +3219,7 @@ static int sql_getgroups(cmd_rec *cmd) {
     }
 
     *((gid_t *) push_array(gids)) = gid;
-    *((char **) push_array(groups)) = pstrdup(permanent_pool, groupname);
+    *((char **) push_array(groups)) = pstrdup(groups_pool, groupname);
 
     /* For each member in the list, toss 'em into the array.  no
      * need to copy the string -- _sql_addgroup will do it for us
@@ -2774,6 +3407,154 @@ static char *named_query_type(cmd_rec *cmd, char *name) {
   return NULL;
 }
 
+static void trace_named_query_results(const char *name, modret_t *mr) {
+  register unsigned long i, idx;
+  sql_data_t *sd;
+
+  if (!MODRET_ISHANDLED(mr) ||
+      !MODRET_HASDATA(mr) ||
+      pr_trace_get_level(trace_channel) < 9) {
+    return;
+  }
+
+  sd = mr->data;
+
+  pr_trace_msg(trace_channel, 9, "SQLNamedQuery %s results:", name);
+  pr_trace_msg(trace_channel, 9, "  row count: %lu", sd->rnum);
+  pr_trace_msg(trace_channel, 9, "  col count: %lu", sd->fnum);
+
+  for (i = 0, idx = 0; i < sd->rnum; i++) {
+    register unsigned long j;
+
+    pr_trace_msg(trace_channel, 9, "    row #%lu:", i+1);
+    for (j = 0; j < sd->fnum; j++) {
+      pr_trace_msg(trace_channel, 9, "      col #%lu: '%s'", j+1,
+        sd->data[idx++]);
+    }
+  }
+}
+
+/* Named queries whose structure prevents the use of placeholders, or which
+ * failed as prepared statements; these are remembered so that they are not
+ * resolved twice on every use.
+ */
+static pr_table_t *unbindable_queries = NULL;
+
+static void sql_set_unbindable_query(const char *name) {
+  if (unbindable_queries == NULL) {
+    unbindable_queries = pr_table_alloc(session.pool, 0);
+  }
+
+  (void) pr_table_add_dup(unbindable_queries, pstrdup(session.pool, name),
+    "true", 0);
+}
+
+/* Attempts to run the named query as a prepared statement, with each quoted
+ * tag passed as a bound parameter.  Returns NULL if the query cannot be
+ * handled this way, in which case the caller falls back to the escaped text
+ * query.
+ */
+static modret_t *execute_named_query(cmd_rec *cmd, config_rec *c,
+    const char *name, const char *conn_name, int flags) {
+  char stmt[SQL_MAX_STMT_LEN+1];
+  char *query = NULL;
+  size_t stmt_len;
+  int res;
+  pool *tmp_pool;
+  pr_jot_ctx_t *jot_ctx;
+  struct sql_resolved *resolved;
+  modret_t *mr;
+
+  if (sql_use_prepared_stmts(conn_name) == FALSE) {
+    return NULL;
+  }
+
+  if (unbindable_queries != NULL &&
+      pr_table_exists(unbindable_queries, name) > 0) {
+    return NULL;
+  }
+
+  tmp_pool = make_sub_pool(cmd->tmp_pool);
+  jot_ctx = pcalloc(tmp_pool, sizeof(pr_jot_ctx_t));
+  resolved = pcalloc(tmp_pool, sizeof(struct sql_resolved));
+  resolved->bufsz = resolved->buflen = sizeof(stmt)-1;
+  resolved->ptr = resolved->buf = stmt;
+  resolved->conn_name = conn_name;
+  resolved->conn_flags = flags;
+  resolved->params = make_array(tmp_pool, 4, sizeof(char *));
+
+  jot_ctx->log = resolved;
+  jot_ctx->user_data = cmd;
+
+  res = pr_jot_resolve_logfmt(tmp_pool, cmd, NULL, c->argv[1], jot_ctx,
+    sql_resolve_on_meta, sql_resolve_on_default, sql_resolve_on_other);
+  if (res < 0) {
+    /* Let the text handling report the error. */
+    destroy_pool(tmp_pool);
+    return NULL;
+  }
+
+  if (resolved->param_flags & SQL_RESOLVED_FL_PENDING_QUOTE) {
+    resolved->param_flags |= SQL_RESOLVED_FL_UNBINDABLE;
+  }
+
+  if (resolved->param_flags & SQL_RESOLVED_FL_UNBINDABLE) {
+    pr_trace_msg(trace_channel, 12, "SQLNamedQuery %s has unquoted tags, "
+      "not using prepared statement", name);
+
+    sql_set_unbindable_query(name);
+    destroy_pool(tmp_pool);
+    return NULL;
+  }
+
+  if (resolved->param_flags & SQL_RESOLVED_FL_ESCAPED_VALUE) {
+    destroy_pool(tmp_pool);
+    return NULL;
+  }
+
+  stmt_len = resolved->bufsz - resolved->buflen;
+  stmt[stmt_len] = '\0';
+
+  if (strcasecmp(c->argv[0], SQL_UPDATE_C) == 0) {
+    query = pstrcat(tmp_pool, "UPDATE ", c->argv[2], " SET ", stmt, NULL);
+
+  } else if (strcasecmp(c->argv[0], SQL_INSERT_C) == 0) {
+    query = pstrcat(tmp_pool, "INSERT INTO ", c->argv[2], " VALUES (", stmt,
+      ")", NULL);
+
+  } else if (strcasecmp(c->argv[0], SQL_FREEFORM_C) == 0) {
+    query = pstrdup(tmp_pool, stmt);
+
+  } else if (strcasecmp(c->argv[0], SQL_SELECT_C) == 0) {
+    query = pstrcat(tmp_pool, "SELECT ", stmt, NULL);
+
+  } else {
+    destroy_pool(tmp_pool);
+    return NULL;
+  }
+
+  mr = sql_dispatch(sql_make_execute_cmd(cmd->tmp_pool, conn_name, query,
+    resolved->params), "sql_execute");
+
+  /* The database may not accept the query with placeholders, e.g. when it
+   * cannot determine a parameter's type from its use.  Run it as text from
+   * now on.  Errors from running the query are returned as they are.
+   */
+  if (sql_is_prepare_error(mr)) {
+    sql_log(DEBUG_WARN, "SQLNamedQuery %s cannot be prepared (%s), "
+      "using text query instead", name, mr->mr_message ? mr->mr_message :
+      "unknown error");
+
+    sql_set_unbindable_query(name);
+    destroy_pool(tmp_pool);
+    return NULL;
+  }
+
+  /* The results are allocated out of cmd->tmp_pool, not our pool. */
+  destroy_pool(tmp_pool);
+  return mr;
+}
+
 static modret_t *process_named_query(cmd_rec *cmd, char *name, int flags) {
   config_rec *c;
   char *conn_name, *query = NULL;
@@ -2800,6 +3581,17 @@ static modret_t *process_named_query(cmd_rec *cmd, char *name, int flags) {
   conn_name = get_query_named_conn(c);
   set_named_conn_backend(conn_name);
 
+  mr = execute_named_query(cmd, c, name, conn_name, flags);
+  if (mr != NULL) {
+    if (strcasecmp(c->argv[0], SQL_SELECT_C) == 0) {
+      trace_named_query_results(name, mr);
+    }
+
+    set_named_conn_backend(NULL);
+    sql_log(DEBUG_FUNC, "<<< process_named_query '%s'", name);
+    return mr;
+  }
+
   tmp_pool = make_sub_pool(cmd->tmp_pool);
   jot_ctx = pcalloc(tmp_pool, sizeof(pr_jot_ctx_t));
   resolved = pcalloc(tmp_pool, sizeof(struct sql_resolved));
@@ -2850,28 +3642,7 @@ static modret_t *process_named_query(cmd_rec *cmd, char *name, int flags) {
     mr = sql_dispatch(sql_make_cmd(cmd->tmp_pool, 2, conn_name, stmt),
       "sql_select");
 
-    if (MODRET_ISHANDLED(mr) &&
-        MODRET_HASDATA(mr) &&
-        pr_trace_get_level(trace_channel) >= 9) {
-      register unsigned long i, idx;
-      sql_data_t *sd;
-
-      sd = mr->data;
-
-      pr_trace_msg(trace_channel, 9, "SQLNamedQuery %s results:", name);
-      pr_trace_msg(trace_channel, 9, "  row count: %lu", sd->rnum);
-      pr_trace_msg(trace_channel, 9, "  col count: %lu", sd->fnum);
-
-      for (i = 0, idx = 0; i < sd->rnum; i++) {
-        register unsigned long j;
-
-        pr_trace_msg(trace_channel, 9, "    row #%lu:", i+1);
-        for (j = 0; j < sd->fnum; j++) {
-          pr_trace_msg(trace_channel, 9, "      col #%lu: '%s'", j+1,
-            sd->data[idx++]);
-        }
-      }
-    }
+    trace_named_query_results(name, mr);
 
   } else {
     mr = PR_ERROR_MSG(cmd, MOD_SQL_VERSION, "unknown NamedQuery type");
@@ -2967,6 +3738,12 @@ MODRET log_master(cmd_rec *cmd) {
   config_rec *c = NULL;
   modret_t *mr = NULL;
 
+  /* The command has been handled, so nothing still uses any data evicted
+   * from the caches while handling it.
+   */
+  cache_release(passwd_cache);
+  cache_release(group_cache);
+
   if (!(cmap.engine & SQL_ENGINE_FL_LOG)) {
     return PR_DECLINED(cmd);
   }
@@ -3050,6 +3827,12 @@ MODRET err_master(cmd_rec *cmd) {
   config_rec *c = NULL;
   modret_t *mr = NULL;
 
+  /* The command has been handled, so nothing still uses any data evicted
+   * from the caches while handling it.
+   */
+  cache_release(passwd_cache);
+  cache_release(group_cache);
+
   if (!(cmap.engine & SQL_ENGINE_FL_LOG)) {
     return PR_DECLINED(cmd);
   }
@@ -3667,13 +4450,23 @@ MODRET sql_auth_setpwent(cmd_rec *cmd) {
 
   sql_log(DEBUG_FUNC, "%s", ">>> cmd_setpwent");
 
-  /* if we've already filled the passwd cache, just reset the curr_passwd */
+  /* if we've already filled the passwd cache, just reset the curr_passwd,
+   * unless entries have since been evicted or expired.
+   */
   if (cmap.passwd_cache_filled) {
-    cmap.curr_passwd = passwd_name_cache->head;
-    sql_log(DEBUG_FUNC, "%s", "<<< cmd_setpwent");
-    return PR_DECLINED(cmd);
+    (void) cache_expire(passwd_cache);
+
+    if (passwd_cache->complete) {
+      cmap.curr_passwd = passwd_cache->head;
+      sql_log(DEBUG_FUNC, "%s", "<<< cmd_setpwent");
+      return PR_DECLINED(cmd);
+    }
+
+    sql_log(DEBUG_INFO, "%s", "passwd cache no longer complete, refilling");
   }
 
+  passwd_cache->complete = TRUE;
+
   /* single select or not? */
   if (SQL_FASTUSERS) {
     /* retrieve our list of users */
@@ -3834,8 +4627,13 @@ MODRET sql_auth_setpwent(cmd_rec *cmd) {
     }
   }
   
+  if (!passwd_cache->complete) {
+    sql_log(DEBUG_WARN, "SQLCacheLimits too small to hold all passwd entries, "
+      "getpwent results will be incomplete");
+  }
+
   cmap.passwd_cache_filled = 1;
-  cmap.curr_passwd = passwd_name_cache->head;
+  cmap.curr_passwd = passwd_cache->head;
 
   sql_log(DEBUG_FUNC, "%s", "<<< cmd_setpwent");
   return PR_DECLINED(cmd);
@@ -3876,7 +4674,7 @@ MODRET sql_auth_getpwent(cmd_rec *cmd) {
       pw->pw_uid == (uid_t) -1)
     return PR_DECLINED(cmd);
 
-  return mod_create_data(cmd, (void *) pw);
+  return mod_create_data(cmd, (void *) sql_dup_passwd(cmd->pool, pw));
 }
 
 MODRET sql_auth_endpwent(cmd_rec *cmd) {
@@ -3913,13 +4711,23 @@ MODRET sql_auth_setgrent(cmd_rec *cmd) {
 
   sql_log(DEBUG_FUNC, "%s", ">>> cmd_setgrent");
 
-  /* if we've already filled the passwd group, just reset curr_group */
+  /* if we've already filled the group cache, just reset curr_group, unless
+   * entries have since been evicted or expired.
+   */
   if (cmap.group_cache_filled) {
-    cmap.curr_group = group_name_cache->head;
-    sql_log(DEBUG_FUNC, "%s", "<<< cmd_setgrent");
-    return PR_DECLINED(cmd);
+    (void) cache_expire(group_cache);
+
+    if (group_cache->complete) {
+      cmap.curr_group = group_cache->head;
+      sql_log(DEBUG_FUNC, "%s", "<<< cmd_setgrent");
+      return PR_DECLINED(cmd);
+    }
+
+    sql_log(DEBUG_INFO, "%s", "group cache no longer complete, refilling");
   }
 
+  group_cache->complete = TRUE;
+
   if (SQL_FASTGROUPS) {
     /* retrieve our list of groups */
 
@@ -4033,8 +4841,13 @@ MODRET sql_auth_setgrent(cmd_rec *cmd) {
     }
   }
   
+  if (!group_cache->complete) {
+    sql_log(DEBUG_WARN, "SQLCacheLimits too small to hold all group entries, "
+      "getgrent results will be incomplete");
+  }
+
   cmap.group_cache_filled = 1;
-  cmap.curr_group = group_name_cache->head;
+  cmap.curr_group = group_cache->head;
 
   sql_log(DEBUG_FUNC, "%s", "<<< cmd_setgrent");
   return PR_DECLINED(cmd);
@@ -4076,7 +4889,7 @@ MODRET sql_auth_getgrent(cmd_rec *cmd) {
     return PR_DECLINED(cmd);
   }
 
-  return mod_create_data(cmd, (void *) gr);
+  return mod_create_data(cmd, (void *) sql_dup_group(cmd->pool, gr));
 }
 
 MODRET sql_auth_endgrent(cmd_rec *cmd) {
@@ -4116,7 +4929,7 @@ MODRET sql_auth_getpwnam(cmd_rec *cmd) {
   }
 
   sql_log(DEBUG_FUNC, "%s", "<<< cmd_getpwnam");
-  return mod_create_data(cmd, pw);
+  return mod_create_data(cmd, sql_dup_passwd(cmd->pool, pw));
 }
 
 MODRET sql_auth_getpwuid(cmd_rec *cmd) {
@@ -4141,7 +4954,7 @@ MODRET sql_auth_getpwuid(cmd_rec *cmd) {
   }
 
   sql_log(DEBUG_FUNC, "%s", "<<< cmd_getpwuid");
-  return mod_create_data(cmd, pw);
+  return mod_create_data(cmd, sql_dup_passwd(cmd->pool, pw));
 }
 
 MODRET sql_auth_getgrnam(cmd_rec *cmd) {
@@ -4166,7 +4979,7 @@ MODRET sql_auth_getgrnam(cmd_rec *cmd) {
   }
 
   sql_log(DEBUG_FUNC, "%s", "<<< cmd_getgrnam");
-  return mod_create_data(cmd, gr);
+  return mod_create_data(cmd, sql_dup_group(cmd->pool, gr));
 }
 
 MODRET sql_auth_getgrgid(cmd_rec *cmd) {
@@ -4190,7 +5003,7 @@ MODRET sql_auth_getgrgid(cmd_rec *cmd) {
   }
 
   sql_log(DEBUG_FUNC, "%s", "<<< cmd_getgrgid");
-  return mod_create_data(cmd, gr);
+  return mod_create_data(cmd, sql_dup_group(cmd->pool, gr));
 }
 
 MODRET sql_auth_authenticate(cmd_rec *cmd) {
@@ -4297,7 +5110,7 @@ MODRET sql_auth_check(cmd_rec *cmd) {
   }
 
   if (success) {
-    struct passwd lpw;
+    struct passwd lpw, *pw;
 
     /* This and the associated hack in sql_uid2name() are to support
      * UID reuse in the database -- people (for whatever reason) are
@@ -4310,7 +5123,15 @@ MODRET sql_auth_check(cmd_rec *cmd) {
     lpw.pw_uid = -1;
     lpw.pw_gid = -1;
     lpw.pw_name = cmd->argv[1];
-    cmap.authpasswd = sql_getpasswd(cmd, &lpw);
+    pw = sql_getpasswd(cmd, &lpw);
+
+    /* Keep our own copy for the rest of the session. */
+    if (pw != NULL) {
+      cmap.authpasswd = sql_dup_passwd(session.pool, pw);
+
+    } else {
+      cmap.authpasswd = NULL;
+    }
 
     session.auth_mech = "mod_sql.c";
     sql_log(DEBUG_FUNC, "%s", "<<< cmd_check");
@@ -4357,7 +5178,7 @@ MODRET sql_auth_uid2name(cmd_rec *cmd) {
    * the core code.  Handle this case separately.
    */
   if (pw->pw_name) {
-    uid_name = pw->pw_name;
+    uid_name = pstrdup(cmd->pool, pw->pw_name);
 
   } else {
     const char *uidstr = NULL;
@@ -4396,7 +5217,7 @@ MODRET sql_auth_gid2name(cmd_rec *cmd) {
    * the core code.  Handle this case separately.
    */
   if (gr->gr_name) {
-    gid_name = gr->gr_name;
+    gid_name = pstrdup(cmd->pool, gr->gr_name);
 
   } else {
     const char *gidstr = NULL;
@@ -4411,6 +5232,7 @@ MODRET sql_auth_gid2name(cmd_rec *cmd) {
 MODRET sql_auth_name2uid(cmd_rec *cmd) {
   struct passwd *pw;
   struct passwd lpw;
+  uid_t *uid;
 
   if (!SQL_USERS ||
       !(cmap.engine & SQL_ENGINE_FL_AUTH)) {
@@ -4439,13 +5261,17 @@ MODRET sql_auth_name2uid(cmd_rec *cmd) {
     return PR_DECLINED(cmd);
   }
 
+  uid = palloc(cmd->pool, sizeof(uid_t));
+  *uid = pw->pw_uid;
+
   sql_log(DEBUG_FUNC, "%s", "<<< cmd_name2uid");
-  return mod_create_data(cmd, (void *) &pw->pw_uid);
+  return mod_create_data(cmd, (void *) uid);
 }
 
 MODRET sql_auth_name2gid(cmd_rec *cmd) {
   struct group *gr;
   struct group lgr;
+  gid_t *gid;
 
   if (!SQL_GROUPS ||
       !(cmap.engine & SQL_ENGINE_FL_AUTH)) {
@@ -4464,8 +5290,11 @@ MODRET sql_auth_name2gid(cmd_rec *cmd) {
     return PR_DECLINED(cmd);
   }
 
+  gid = palloc(cmd->pool, sizeof(gid_t));
+  *gid = gr->gr_gid;
+
   sql_log(DEBUG_FUNC, "%s", "<<< cmd_name2gid");
-  return mod_create_data(cmd, (void *) &gr->gr_gid);
+  return mod_create_data(cmd, (void *) gid);
 }
 
 MODRET sql_auth_getgroups(cmd_rec *cmd) {
@@ -4647,6 +5476,9 @@ MODRET set_sqloptions(cmd_rec *cmd) {
     } else if (strcasecmp(cmd->argv[i], "IgnoreConfigFile") == 0) {
       opts |= SQL_OPT_IGNORE_CONFIG_FILE;
 
+    } else if (strcasecmp(cmd->argv[i], "UsePreparedStatements") == 0) {
+      opts |= SQL_OPT_USE_PREPARED_STATEMENTS;
+
     } else {
       CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown SQLOption '",
         cmd->argv[i], "'", NULL));
@@ -5542,6 +6374,69 @@ static int sql_openlog(void) {
   return res;
 }
 
+/* usage: SQLCacheLimits [maxsize bytes [units]] [ttl duration] */
+MODRET set_sqlcachelimits(cmd_rec *cmd) {
+  register unsigned int i;
+  config_rec *c;
+  size_t max_datasz = 0;
+  int ttl = 0;
+
+  if (cmd->argc < 3) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  for (i = 1; i < cmd->argc; i++) {
+    if (strcasecmp(cmd->argv[i], "maxsize") == 0) {
+      const char *units = NULL;
+      off_t nbytes = 0;
+
+      if (i + 1 >= cmd->argc) {
+        CONF_ERROR(cmd, "missing maxsize value");
+      }
+
+      /* The size may be followed by units, e.g. "maxsize 16 MB". */
+      if (i + 2 < cmd->argc &&
+          strcasecmp(cmd->argv[i+2], "ttl") != 0) {
+        units = cmd->argv[i+2];
+      }
+
+      if (pr_str_get_nbytes(cmd->argv[i+1], units, &nbytes) < 0) {
+        CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "invalid maxsize value: ",
+          cmd->argv[i+1], units ? " " : "", units ? units : "", NULL));
+      }
+
+      max_datasz = (size_t) nbytes;
+      i += (units != NULL ? 2 : 1);
+
+    } else if (strcasecmp(cmd->argv[i], "ttl") == 0) {
+      if (i + 1 >= cmd->argc) {
+        CONF_ERROR(cmd, "missing ttl value");
+      }
+
+      if (pr_str_get_duration(cmd->argv[i+1], &ttl) < 0) {
+        CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "invalid ttl value: ",
+          cmd->argv[i+1], NULL));
+      }
+
+      i++;
+
+    } else {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown parameter: ",
+        cmd->argv[i], NULL));
+    }
+  }
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(size_t));
+  *((size_t *) c->argv[0]) = max_datasz;
+  c->argv[1] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[1]) = ttl;
+
+  return PR_HANDLED(cmd);
+}
+
 /* usage: SQLConnectInfo info [user [pass [policy]]]
  *          [ssl-cert:<path>] [ssl-key:<path>] [ssl-ca:/path] [ssl-ciphers:str]
  */
@@ -5887,6 +6782,9 @@ static void sql_exit_ev(const void *event_data, void *user_data) {
   cmd_rec *cmd;
   modret_t *mr;
 
+  cache_log_stats(passwd_cache);
+  cache_log_stats(group_cache);
+
   if (cmap.engine == 0) {
     return;
   }
@@ -5923,6 +6821,8 @@ static void sql_mod_unload_ev(const void *event_data, void *user_data) {
 
   destroy_pool(sql_pool);
   sql_pool = NULL;
+  group_cache = NULL;
+  passwd_cache = NULL;
   sql_backends = NULL;
   sql_auth_list = NULL;
 
@@ -6045,7 +6945,8 @@ static int sql_sess_init(void) {
   cmd_rec *cmd = NULL;
   modret_t *mr = NULL;
   sql_data_t *sd = NULL;
-  int engine = 0, res = 0;
+  int engine = 0, res = 0, cache_ttl = 0;
+  size_t cache_max_datasz = 0;
   char *fieldset = NULL;
   pool *tmp_pool = NULL;
 
@@ -6130,10 +7031,24 @@ static int sql_sess_init(void) {
     pr_pool_tag(sql_pool, MOD_SQL_VERSION);
   }
 
-  group_name_cache = make_cache(sql_pool, _group_name, _groupcmp);
-  passwd_name_cache = make_cache(sql_pool, _passwd_name, _passwdcmp);
-  group_gid_cache = make_cache(sql_pool, _group_gid, _groupcmp);
-  passwd_uid_cache = make_cache(sql_pool, _passwd_uid, _passwdcmp);
+  c = find_config(main_server->conf, CONF_PARAM, "SQLCacheLimits", FALSE);
+  if (c != NULL) {
+    cache_max_datasz = *((size_t *) c->argv[0]);
+    cache_ttl = *((int *) c->argv[1]);
+  }
+
+  if (group_cache != NULL) {
+    destroy_pool(group_cache->pool);
+  }
+
+  if (passwd_cache != NULL) {
+    destroy_pool(passwd_cache->pool);
+  }
+
+  group_cache = make_cache(sql_pool, "group", _group_name, _group_gid,
+    _groupcmp, cache_max_datasz, cache_ttl);
+  passwd_cache = make_cache(sql_pool, "passwd", _passwd_name, _passwd_uid,
+    _passwdcmp, cache_max_datasz, cache_ttl);
 
   cmap.group_cache_filled = 0;
   cmap.passwd_cache_filled = 0;
@@ -6594,6 +7509,9 @@ static int sql_sess_init(void) {
   }
 
   sql_log(DEBUG_INFO, "negative_cache     : %s", cmap.negative_cache ? "on" : "off");
+  sql_log(DEBUG_INFO, "cache maxsize      : %lu",
+    (unsigned long) passwd_cache->max_datasz);
+  sql_log(DEBUG_INFO, "cache ttl          : %d", passwd_cache->ttl);
 
   authstr = "";
 
@@ -6712,6 +7630,7 @@ static conftable sql_conftab[] = {
   { "SQLAuthenticate",		set_sqlauthenticate,		NULL },
   { "SQLAuthTypes",		set_sqlauthtypes,		NULL },
   { "SQLBackend",		set_sqlbackend,			NULL },
+  { "SQLCacheLimits",		set_sqlcachelimits,		NULL },
   { "SQLConnectInfo",	 	set_sqlconnectinfo,		NULL },
   { "SQLDefaultGID",		set_sqldefaultgid,		NULL },
   { "SQLDefaultHomedir",	set_sqldefaulthomedir,		NULL },
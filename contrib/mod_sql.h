@@ -83,6 +83,26 @@ typedef struct sql_data_struct sql_data_t;
  */
 #define MOD_SQL_API_V2 "mod_sql_api_v2"
 
+/* Backends may optionally implement cmd_execute ("sql_execute"), which runs
+ * a complete statement containing $1, $2, ... placeholders, with the values
+ * for those placeholders given as separate, unescaped arguments:
+ *
+ *  cmd->argv[0]: connection name
+ *  cmd->argv[1]: statement text
+ *  cmd->argv[2..]: parameter values
+ *
+ * Backends are expected to prepare each distinct statement text once per
+ * connection, and to reuse the prepared statement on later calls.  mod_sql
+ * only uses this command when the SQLOptions UsePreparedStatements option
+ * is configured.
+ *
+ * If the statement cannot be prepared, or the values cannot be bound to its
+ * placeholders, the backend returns an error whose numeric code is
+ * MOD_SQL_PREPARE_ERROR; mod_sql then runs the query as text instead.  Any
+ * other error, from running the statement, is returned as for cmd_select.
+ */
+#define MOD_SQL_PREPARE_ERROR		"prepare"
+
 /* SQLOption values */
 extern unsigned long pr_sql_opts;
 
@@ -90,6 +110,7 @@ extern unsigned long pr_sql_opts;
 #define SQL_OPT_USE_NORMALIZED_GROUP_SCHEMA     0x0002
 #define SQL_OPT_NO_RECONNECT                    0x0004
 #define SQL_OPT_IGNORE_CONFIG_FILE		0x0008
+#define SQL_OPT_USE_PREPARED_STATEMENTS		0x0010
 
 /* SQL connection policy */
 extern unsigned int pr_sql_conn_policy;
@@ -96,10 +96,22 @@ struct db_conn_struct {
 
   PGconn *postgres;
   PGresult *result;
+
+  /* Prepared statements on this connection. */
+  pool *stmt_pool;
+  array_header *stmts;
 };
 
 typedef struct db_conn_struct db_conn_t;
 
+/* A statement prepared on a connection, by its text. */
+struct db_stmt_struct {
+  const char *text;
+  const char *name;
+};
+
+typedef struct db_stmt_struct db_stmt_t;
+
 /* This struct is a wrapper for whatever backend data is needed to access
  * the database, and supports named connections, connection counting, and 
  * timer handling.  
@@ -120,6 +132,11 @@ typedef struct conn_entry_struct conn_entry_t;
 
 #define DEF_CONN_POOL_SIZE 10
 
+/* Maximum number of prepared statements kept per connection; statements
+ * beyond this are still prepared and executed, just not kept.
+ */
+#define SQL_POSTGRES_MAX_PREPARED_STMTS	64
+
 static pool *conn_pool = NULL;
 static array_header *conn_cache = NULL;
 
@@ -221,6 +238,18 @@ static int sql_timer_cb(CALLBACK_FRAME) {
   return 0;
 }
 
+/* Prepared statements belong to the server session; forget ours whenever
+ * that session is closed or reset.
+ */
+static void clear_stmts(db_conn_t *conn) {
+  if (conn->stmt_pool != NULL) {
+    destroy_pool(conn->stmt_pool);
+    conn->stmt_pool = NULL;
+  }
+
+  conn->stmts = NULL;
+}
+
 /* build_error: constructs a modret_t filled with error information;
  *  mod_sql_postgres calls this function and returns the resulting modret_t
  *  whenever a call to the database results in an error.
@@ -421,6 +450,7 @@ MODRET cmd_open(cmd_rec *cmd) {
        */
       if (!(pr_sql_opts & SQL_OPT_NO_RECONNECT)) {
         PQreset(conn->postgres);
+        clear_stmts(conn);
 
         if (PQstatus(conn->postgres) == CONNECTION_OK) {
           entry->connections++;
@@ -639,6 +669,7 @@ MODRET cmd_close(cmd_rec *cmd) {
       PQfinish(conn->postgres);
       conn->postgres = NULL;
     }
+    clear_stmts(conn);
     entry->connections = 0;
 
     if (entry->timer) {
@@ -1413,6 +1444,221 @@ MODRET cmd_query(cmd_rec *cmd) {
   return dmr;
 }
 
+static const char *get_stmt(db_conn_t *conn, const char *text) {
+  register unsigned int i;
+  db_stmt_t *stmts;
+
+  if (conn->stmts == NULL) {
+    return NULL;
+  }
+
+  stmts = conn->stmts->elts;
+  for (i = 0; i < conn->stmts->nelts; i++) {
+    if (strcmp(stmts[i].text, text) == 0) {
+      return stmts[i].name;
+    }
+  }
+
+  return NULL;
+}
+
+static const char *prepare_stmt(db_conn_t *conn, const char *text,
+    int nparams) {
+  char name[32];
+  PGresult *result;
+  db_stmt_t *stmt;
+
+  if (conn->stmts == NULL) {
+    conn->stmt_pool = make_sub_pool(conn_pool);
+    pr_pool_tag(conn->stmt_pool, "Postgres prepared statements");
+
+    conn->stmts = make_array(conn->stmt_pool, 8, sizeof(db_stmt_t));
+  }
+
+  memset(name, '\0', sizeof(name));
+
+  /* Once we keep as many statements as we may, use the unnamed statement,
+   * which each preparation replaces.
+   */
+  if (conn->stmts->nelts < SQL_POSTGRES_MAX_PREPARED_STMTS) {
+    pr_snprintf(name, sizeof(name)-1, "proftpd_stmt_%u",
+      conn->stmts->nelts + 1);
+  }
+
+  result = PQprepare(conn->postgres, name, text, nparams, NULL);
+  if (result == NULL ||
+      PQresultStatus(result) != PGRES_COMMAND_OK) {
+    if (result != NULL) {
+      PQclear(result);
+    }
+
+    errno = EINVAL;
+    return NULL;
+  }
+
+  PQclear(result);
+
+  if (*name == '\0') {
+    return "";
+  }
+
+  stmt = push_array(conn->stmts);
+  stmt->text = pstrdup(conn->stmt_pool, text);
+  stmt->name = pstrdup(conn->stmt_pool, name);
+
+  sql_log(DEBUG_INFO, "prepared statement %s: \"%s\"", stmt->name, text);
+  return stmt->name;
+}
+
+/* Whether the failed execution of a prepared statement was due to binding
+ * its parameters (e.g. their number not matching its placeholders, which
+ * is a protocol violation), or to the prepared statement having been lost
+ * by the server, rather than to running it.
+ */
+static int is_bind_error(PGresult *result) {
+  const char *state;
+
+  state = PQresultErrorField(result, PG_DIAG_SQLSTATE);
+  if (state != NULL &&
+      (strcmp(state, "08P01") == 0 ||
+       strcmp(state, "26000") == 0)) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/*
+ * cmd_execute: executes a statement containing $1, $2, ... placeholders,
+ *  using the given parameter values.  Each distinct statement is prepared
+ *  once per connection, and the prepared statement reused thereafter.
+ *
+ * Inputs:
+ *  cmd->argv[0]: connection name
+ *  cmd->argv[1]: statement text
+ *  cmd->argv[2..]: parameter values, unescaped
+ *
+ * Returns:
+ *  depending on the statement type, returns a modret_t with data, a
+ *  non-error modret_t, or a properly filled error modret_t if the
+ *  statement failed.  Failures to prepare the statement, or to bind the
+ *  parameters to it, have MOD_SQL_PREPARE_ERROR as their numeric code.
+ *
+ * Notes:
+ *  Once SQL_POSTGRES_MAX_PREPARED_STMTS statements have been prepared on
+ *  a connection, further statements are prepared as the unnamed statement
+ *  each time.
+ */
+MODRET cmd_execute(cmd_rec *cmd) {
+  conn_entry_t *entry = NULL;
+  db_conn_t *conn = NULL;
+  modret_t *cmr = NULL;
+  modret_t *dmr = NULL;
+  const char *query = NULL, *stmt_name = NULL;
+  const char * const *params;
+  int nparams;
+  cmd_rec *close_cmd;
+
+  sql_log(DEBUG_FUNC, "%s", "entering \tpostgres cmd_execute");
+
+  sql_check_cmd(cmd, "cmd_execute");
+
+  if (cmd->argc < 2) {
+    sql_log(DEBUG_FUNC, "%s", "exiting \tpostgres cmd_execute");
+    return PR_ERROR_MSG(cmd, MOD_SQL_POSTGRES_VERSION, "badly formed request");
+  }
+
+  entry = sql_get_connection(cmd->argv[0]);
+  if (entry == NULL) {
+    sql_log(DEBUG_FUNC, "%s", "exiting \tpostgres cmd_execute");
+    return PR_ERROR_MSG(cmd, MOD_SQL_POSTGRES_VERSION,
+      pstrcat(cmd->tmp_pool, "unknown named connection: ", cmd->argv[0], NULL));
+  }
+
+  conn = (db_conn_t *) entry->data;
+
+  cmr = cmd_open(cmd);
+  if (MODRET_ERROR(cmr)) {
+    sql_log(DEBUG_FUNC, "%s", "exiting \tpostgres cmd_execute");
+    return cmr;
+  }
+
+  query = cmd->argv[1];
+  nparams = cmd->argc - 2;
+  params = (const char * const *) &(cmd->argv[2]);
+
+  sql_log(DEBUG_INFO, "query \"%s\" (%d %s)", query, nparams,
+    nparams != 1 ? "parameters" : "parameter");
+
+  stmt_name = get_stmt(conn, query);
+  if (stmt_name == NULL) {
+    stmt_name = prepare_stmt(conn, query, nparams);
+    if (stmt_name == NULL) {
+      /* A lost connection is not a problem with the statement. */
+      if (PQstatus(conn->postgres) == CONNECTION_BAD) {
+        dmr = build_error(cmd, conn);
+
+      } else {
+        dmr = PR_ERROR_MSG(cmd, MOD_SQL_PREPARE_ERROR,
+          pstrdup(cmd->pool, PQerrorMessage(conn->postgres)));
+      }
+
+      close_cmd = sql_make_cmd(cmd->tmp_pool, 1, entry->name);
+      cmd_close(close_cmd);
+      SQL_FREE_CMD(close_cmd);
+
+      sql_log(DEBUG_FUNC, "%s", "exiting \tpostgres cmd_execute");
+      return dmr;
+    }
+  }
+
+  conn->result = PQexecPrepared(conn->postgres, stmt_name, nparams, params,
+    NULL, NULL, 0);
+
+  /* perform the query.  if it doesn't work, log the error, close the
+   * connection then return the error from the query processing.
+   */
+  if (conn->result == NULL ||
+      ((PQresultStatus(conn->result) != PGRES_TUPLES_OK) &&
+       (PQresultStatus(conn->result) != PGRES_COMMAND_OK))) {
+    if (conn->result != NULL &&
+        is_bind_error(conn->result)) {
+      dmr = PR_ERROR_MSG(cmd, MOD_SQL_PREPARE_ERROR,
+        pstrdup(cmd->pool, PQerrorMessage(conn->postgres)));
+
+    } else {
+      dmr = build_error(cmd, conn);
+    }
+
+    if (conn->result != NULL) {
+      PQclear(conn->result);
+    }
+
+    close_cmd = sql_make_cmd(cmd->tmp_pool, 1, entry->name);
+    cmd_close(close_cmd);
+    SQL_FREE_CMD(close_cmd);
+
+    sql_log(DEBUG_FUNC, "%s", "exiting \tpostgres cmd_execute");
+    return dmr;
+  }
+
+  if (PQresultStatus(conn->result) == PGRES_TUPLES_OK) {
+    dmr = build_data(cmd, conn);
+
+  } else {
+    dmr = PR_HANDLED(cmd);
+  }
+
+  PQclear(conn->result);
+
+  close_cmd = sql_make_cmd(cmd->tmp_pool, 1, entry->name);
+  cmd_close(close_cmd);
+  SQL_FREE_CMD(close_cmd);
+
+  sql_log(DEBUG_FUNC, "%s", "exiting \tpostgres cmd_execute");
+  return dmr;
+}
+
 /*
  * cmd_escapestring: certain strings sent to a database should be properly
  *  escaped -- for instance, quotes need to be escaped to insure that 
@@ -1569,6 +1815,7 @@ static cmdtable sql_postgres_cmdtable[] = {
   { CMD, "sql_close",            G_NONE, cmd_close,            FALSE, FALSE },
   { CMD, "sql_defineconnection", G_NONE, cmd_defineconnection, FALSE, FALSE },
   { CMD, "sql_escapestring",     G_NONE, cmd_escapestring,     FALSE, FALSE },
+  { CMD, "sql_execute",          G_NONE, cmd_execute,          FALSE, FALSE },
   { CMD, "sql_exit",             G_NONE, cmd_exit,             FALSE, FALSE },
   { CMD, "sql_identify",         G_NONE, cmd_identify,         FALSE, FALSE },
   { CMD, "sql_insert",           G_NONE, cmd_insert,           FALSE, FALSE },
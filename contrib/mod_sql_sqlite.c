@@ -48,8 +48,24 @@ typedef struct db_conn_struct {
 
   sqlite3 *dbh;
 
+  /* Prepared statements on this connection. */
+  pool *stmt_pool;
+  array_header *stmts;
+
 } db_conn_t;
 
+/* A statement prepared on a connection, by its text. */
+typedef struct db_stmt_struct {
+  const char *text;
+  sqlite3_stmt *stmt;
+
+} db_stmt_t;
+
+/* Maximum number of prepared statements kept per connection; statements
+ * beyond this are prepared, executed, and finalized each time.
+ */
+#define SQL_SQLITE_MAX_PREPARED_STMTS	64
+
 typedef struct conn_entry_struct {
   char *name;
   void *data;
@@ -265,6 +281,137 @@ static int query_finish(cmd_rec *cmd, db_conn_t *conn, char **errstr) {
   return exec_stmt(cmd, conn, pstrdup(cmd->tmp_pool, "COMMIT"), errstr);
 }
 
+static sqlite3_stmt *get_stmt(db_conn_t *conn, const char *text) {
+  register unsigned int i;
+  db_stmt_t *stmts;
+
+  if (conn->stmts == NULL) {
+    return NULL;
+  }
+
+  stmts = conn->stmts->elts;
+  for (i = 0; i < conn->stmts->nelts; i++) {
+    if (strcmp(stmts[i].text, text) == 0) {
+      return stmts[i].stmt;
+    }
+  }
+
+  return NULL;
+}
+
+static int add_stmt(db_conn_t *conn, const char *text, sqlite3_stmt *stmt) {
+  db_stmt_t *db_stmt;
+
+  if (conn->stmts == NULL) {
+    conn->stmt_pool = make_sub_pool(conn_pool);
+    pr_pool_tag(conn->stmt_pool, "SQLite prepared statements");
+
+    conn->stmts = make_array(conn->stmt_pool, 8, sizeof(db_stmt_t));
+  }
+
+  if (conn->stmts->nelts >= SQL_SQLITE_MAX_PREPARED_STMTS) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  db_stmt = push_array(conn->stmts);
+  db_stmt->text = pstrdup(conn->stmt_pool, text);
+  db_stmt->stmt = stmt;
+
+  return 0;
+}
+
+/* Prepared statements must be finalized before the database handle can be
+ * closed.
+ */
+static void finalize_stmts(db_conn_t *conn) {
+  register unsigned int i;
+  db_stmt_t *stmts;
+
+  if (conn->stmts == NULL) {
+    return;
+  }
+
+  stmts = conn->stmts->elts;
+  for (i = 0; i < conn->stmts->nelts; i++) {
+    sqlite3_finalize(stmts[i].stmt);
+  }
+
+  destroy_pool(conn->stmt_pool);
+  conn->stmt_pool = NULL;
+  conn->stmts = NULL;
+}
+
+static int exec_prepared_stmt(cmd_rec *cmd, db_conn_t *conn,
+    sqlite3_stmt *stmt, char **errstr) {
+  int res;
+  unsigned int nretries = 0;
+
+  while (TRUE) {
+    pr_signals_handle();
+
+    PRIVS_ROOT
+    res = sqlite3_step(stmt);
+    PRIVS_RELINQUISH
+
+    if (res == SQLITE_ROW) {
+      register int i;
+      int ncols;
+      char **cols;
+
+      ncols = sqlite3_column_count(stmt);
+      cols = pcalloc(cmd->tmp_pool, sizeof(char *) * (ncols + 1));
+
+      for (i = 0; i < ncols; i++) {
+        cols[i] = (char *) sqlite3_column_text(stmt, i);
+      }
+
+      exec_cb(cmd, ncols, cols, NULL);
+      continue;
+    }
+
+    if (res == SQLITE_DONE) {
+      break;
+    }
+
+    if (res == SQLITE_BUSY) {
+      struct timeval tv;
+
+      /* Discard any partial results, and start over. */
+      sqlite3_reset(stmt);
+      result_ncols = 0;
+      result_list = NULL;
+
+      nretries++;
+      sql_log(DEBUG_FUNC, "attempt #%u, database busy, trying '%s' again",
+        nretries, sqlite3_sql(stmt));
+
+      tv.tv_sec = 0;
+      tv.tv_usec = 500000L;
+
+      if (select(0, NULL, NULL, NULL, &tv) < 0) {
+        if (errno == EINTR) {
+          pr_signals_handle();
+        }
+      }
+
+      continue;
+    }
+
+    *errstr = pstrdup(cmd->pool, sqlite3_errmsg(conn->dbh));
+    sql_log(DEBUG_FUNC, "error executing '%s': (%d) %s", sqlite3_sql(stmt),
+      res, *errstr);
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return -1;
+  }
+
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return 0;
+}
+
 static modret_t *sql_sqlite_get_data(cmd_rec *cmd) {
   register unsigned int i;
   unsigned int count, k = 0;
@@ -478,6 +625,8 @@ MODRET sql_sqlite_close(cmd_rec *cmd) {
   if ((--entry->nconn) == 0 ||
       (cmd->argc == 2 && cmd->argv[1])) {
 
+    finalize_stmts(conn);
+
     if (conn->dbh) {
       if (sqlite3_close(conn->dbh) != SQLITE_OK) {
         sql_log(DEBUG_FUNC, "error closing SQLite database: %s",
@@ -541,7 +690,7 @@ MODRET sql_sqlite_def_conn(cmd_rec *cmd) {
     return PR_ERROR_MSG(cmd, MOD_SQL_SQLITE_VERSION, "uninitialized module");
   }
 
-  conn = (db_conn_t *) palloc(conn_pool, sizeof(db_conn_t));
+  conn = (db_conn_t *) pcalloc(conn_pool, sizeof(db_conn_t));
 
   name = pstrdup(conn_pool, cmd->argv[0]);
   conn->user = pstrdup(conn_pool, cmd->argv[1]);
@@ -1005,6 +1154,156 @@ MODRET sql_sqlite_query(cmd_rec *cmd) {
   return mr;
 }
 
+MODRET sql_sqlite_execute(cmd_rec *cmd) {
+  register int i;
+  conn_entry_t *entry = NULL;
+  db_conn_t *conn = NULL;
+  modret_t *mr = NULL;
+  char *errstr = NULL;
+  const char *query = NULL;
+  sqlite3_stmt *stmt = NULL;
+  int cached = TRUE, nparams, res;
+  cmd_rec *close_cmd;
+
+  sql_log(DEBUG_FUNC, "%s", "entering \tsqlite cmd_execute");
+
+  if (cmd->argc < 2) {
+    sql_log(DEBUG_FUNC, "%s", "exiting \tsqlite cmd_execute");
+    return PR_ERROR_MSG(cmd, MOD_SQL_SQLITE_VERSION, "badly formed request");
+  }
+
+  /* Get the named connection. */
+  entry = sql_sqlite_get_conn(cmd->argv[0]);
+  if (entry == NULL) {
+    sql_log(DEBUG_FUNC, "%s", "exiting \tsqlite cmd_execute");
+    return PR_ERROR_MSG(cmd, MOD_SQL_SQLITE_VERSION,
+      pstrcat(cmd->tmp_pool, "unknown named connection: ", cmd->argv[0], NULL));
+  }
+
+  conn = (db_conn_t *) entry->data;
+
+  mr = sql_sqlite_open(cmd);
+  if (MODRET_ERROR(mr)) {
+    sql_log(DEBUG_FUNC, "%s", "exiting \tsqlite cmd_execute");
+    return mr;
+  }
+
+  query = cmd->argv[1];
+  nparams = cmd->argc - 2;
+
+  /* Log the query string */
+  sql_log(DEBUG_INFO, "query \"%s\" (%d %s)", query, nparams,
+    nparams != 1 ? "parameters" : "parameter");
+
+  stmt = get_stmt(conn, query);
+  if (stmt == NULL) {
+    PRIVS_ROOT
+    res = sqlite3_prepare_v2(conn->dbh, query, -1, &stmt, NULL);
+    PRIVS_RELINQUISH
+
+    if (res != SQLITE_OK) {
+      errstr = pstrdup(cmd->pool, sqlite3_errmsg(conn->dbh));
+      sql_log(DEBUG_FUNC, "error preparing '%s': (%d) %s", query, res, errstr);
+
+      close_cmd = pr_cmd_alloc(cmd->tmp_pool, 1, entry->name);
+      sql_sqlite_close(close_cmd);
+      destroy_pool(close_cmd->pool);
+
+      sql_log(DEBUG_FUNC, "%s", "exiting \tsqlite cmd_execute");
+
+      /* A busy or locked database is not a problem with the statement. */
+      if (res == SQLITE_BUSY ||
+          res == SQLITE_LOCKED) {
+        return PR_ERROR_MSG(cmd, MOD_SQL_SQLITE_VERSION, errstr);
+      }
+
+      return PR_ERROR_MSG(cmd, MOD_SQL_PREPARE_ERROR, errstr);
+    }
+
+    if (add_stmt(conn, query, stmt) < 0) {
+      cached = FALSE;
+
+    } else {
+      sql_log(DEBUG_INFO, "prepared statement \"%s\"", query);
+    }
+  }
+
+  res = SQLITE_OK;
+  if (sqlite3_bind_parameter_count(stmt) != nparams) {
+    char errbuf[128];
+
+    memset(errbuf, '\0', sizeof(errbuf));
+    pr_snprintf(errbuf, sizeof(errbuf)-1,
+      "statement has %d placeholders, but %d parameters given",
+      sqlite3_bind_parameter_count(stmt), nparams);
+    errstr = pstrdup(cmd->pool, errbuf);
+    res = SQLITE_RANGE;
+  }
+
+  for (i = 0; res == SQLITE_OK && i < nparams; i++) {
+    char placeholder[32];
+    int idx;
+
+    memset(placeholder, '\0', sizeof(placeholder));
+    pr_snprintf(placeholder, sizeof(placeholder)-1, "$%d", i+1);
+
+    idx = sqlite3_bind_parameter_index(stmt, placeholder);
+    if (idx == 0) {
+      idx = i+1;
+    }
+
+    res = sqlite3_bind_text(stmt, idx, cmd->argv[i+2], -1, SQLITE_TRANSIENT);
+    if (res != SQLITE_OK) {
+      errstr = pstrdup(cmd->pool, sqlite3_errmsg(conn->dbh));
+    }
+  }
+
+  if (res != SQLITE_OK) {
+    sql_log(DEBUG_FUNC, "error binding parameters for '%s': (%d) %s", query,
+      res, errstr);
+
+    sqlite3_clear_bindings(stmt);
+    if (cached == FALSE) {
+      sqlite3_finalize(stmt);
+    }
+
+    close_cmd = pr_cmd_alloc(cmd->tmp_pool, 1, entry->name);
+    sql_sqlite_close(close_cmd);
+    destroy_pool(close_cmd->pool);
+
+    sql_log(DEBUG_FUNC, "%s", "exiting \tsqlite cmd_execute");
+    return PR_ERROR_MSG(cmd, MOD_SQL_PREPARE_ERROR, errstr);
+  }
+
+  res = exec_prepared_stmt(cmd, conn, stmt, &errstr);
+
+  if (cached == FALSE) {
+    sqlite3_finalize(stmt);
+  }
+
+  if (res < 0) {
+    result_ncols = 0;
+    result_list = NULL;
+
+    close_cmd = pr_cmd_alloc(cmd->tmp_pool, 1, entry->name);
+    sql_sqlite_close(close_cmd);
+    destroy_pool(close_cmd->pool);
+
+    sql_log(DEBUG_FUNC, "%s", "exiting \tsqlite cmd_execute");
+    return PR_ERROR_MSG(cmd, MOD_SQL_SQLITE_VERSION, errstr);
+  }
+
+  mr = sql_sqlite_get_data(cmd);
+
+  /* Close the connection, return the data. */
+  close_cmd = pr_cmd_alloc(cmd->tmp_pool, 1, entry->name);
+  sql_sqlite_close(close_cmd);
+  destroy_pool(close_cmd->pool);
+
+  sql_log(DEBUG_FUNC, "%s", "exiting \tsqlite cmd_execute");
+  return mr;
+}
+
 MODRET sql_sqlite_quote(cmd_rec *cmd) {
   conn_entry_t *entry = NULL;
   modret_t *mr = NULL;
@@ -1067,6 +1366,7 @@ static cmdtable sql_sqlite_cmdtable[] = {
   { CMD, "sql_cleanup",		G_NONE, sql_sqlite_cleanup,	FALSE, FALSE },
   { CMD, "sql_defineconnection",G_NONE, sql_sqlite_def_conn,	FALSE, FALSE },
   { CMD, "sql_escapestring",	G_NONE, sql_sqlite_quote,	FALSE, FALSE },
+  { CMD, "sql_execute",		G_NONE, sql_sqlite_execute,	FALSE, FALSE },
   { CMD, "sql_exit",		G_NONE,	sql_sqlite_exit,	FALSE, FALSE },
   { CMD, "sql_identify",	G_NONE, sql_sqlite_identify,	FALSE, FALSE },
   { CMD, "sql_insert",		G_NONE, sql_sqlite_insert,	FALSE, FALSE },
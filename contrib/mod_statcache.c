@@ -44,7 +44,7 @@
 # include <sys/uio.h>
 #endif
 
-#define MOD_STATCACHE_VERSION			"mod_statcache/0.2"
+#define MOD_STATCACHE_VERSION			"mod_statcache/0.3"
 
 /* Make sure the version of proftpd is as necessary. */
 #if PROFTPD_VERSION_NUMBER < 0x0001030402
@@ -71,6 +71,24 @@
 /* Max number of lock attempts */
 #define STATCACHE_MAX_LOCK_ATTEMPTS	10
 
+/* Number of times a lock-free row read is retried, when it races with a
+ * writer, before it is treated as a cache miss.
+ */
+#define STATCACHE_MAX_READ_ATTEMPTS	3
+
+/* Size of the stats header: six uint32_t counters. */
+#define STATCACHE_STATS_LEN		(6 * sizeof(uint32_t))
+
+/* If the compiler provides the __atomic builtins, lookups read rows without
+ * taking any fcntl(2) locks, using a per-row sequence counter to detect
+ * concurrent writers, and the stats counters are updated atomically.
+ * Writers always serialize on the fcntl(2) row lock, which the kernel
+ * releases should a session process die while holding it.
+ */
+#if defined(__ATOMIC_ACQUIRE)
+# define STATCACHE_USE_ATOMICS
+#endif
+
 /* Subpool size */
 #define STATCACHE_POOL_SIZE		256
 
@@ -107,6 +125,9 @@ struct statcache_entry {
  *      uint32_t expires
  *      uint32_t rejects
  *
+ *    Row sequence counters:
+ *      uint32_t seq[nrows], padded to a multiple of 8 bytes
+ *
  *  Data (entries):
  *    nrows = capacity / STATCACHE_COLS_PER_ROW
  *    row_len = sizeof(struct statcache_entry) * STATCACHE_COLS_PER_ROW
@@ -114,11 +135,15 @@ struct statcache_entry {
  */
 
 static int statcache_engine = FALSE;
+static unsigned long statcache_opts = 0UL;
+#define STATCACHE_OPT_LOCAL_INVALIDATION_ONLY	0x0001
+
 static unsigned int statcache_max_positive_age = STATCACHE_DEFAULT_MAX_AGE;
 static unsigned int statcache_max_negative_age = 1;
 static unsigned int statcache_capacity = STATCACHE_DEFAULT_CAPACITY;
 static unsigned int statcache_nrows = 0;
 static size_t statcache_rowlen = 0;
+static size_t statcache_data_off = 0;
 
 static char *statcache_table_path = NULL;
 static pr_fh_t *statcache_tabfh = NULL;
@@ -126,6 +151,7 @@ static pr_fh_t *statcache_tabfh = NULL;
 static void *statcache_table = NULL;
 static size_t statcache_tablesz = 0;
 static uint32_t *statcache_table_stats = NULL;
+static uint32_t *statcache_table_seqs = NULL;
 static void *statcache_table_data = NULL;
 
 static const char *trace_channel = "statcache";
@@ -289,7 +315,7 @@ static int lock_table(int fd, int lock_type, off_t lock_len) {
   lock.l_type = lock_type;
   lock.l_whence = 0;
   lock.l_start = 0;
-  lock.l_len = (6 * sizeof(uint32_t));
+  lock.l_len = lock_len;
 
   pr_trace_msg(trace_channel, 15,
     "attempt #%u to acquire %s lock on StatCacheTable fd %d (off %lu, len %lu)",
@@ -355,7 +381,7 @@ static int lock_table(int fd, int lock_type, off_t lock_len) {
 
 #if defined(PR_USE_CTRLS)
 static int statcache_rlock_stats(int fd) {
-  return lock_table(fd, F_RDLCK, (6 * sizeof(uint32_t)));
+  return lock_table(fd, F_RDLCK, STATCACHE_STATS_LEN);
 }
 
 static int statcache_rlock_table(int fd) {
@@ -363,18 +389,37 @@ static int statcache_rlock_table(int fd) {
 }
 
 static int statcache_unlock_table(int fd) {
-  return lock_table(fd, F_RDLCK, 0);
+  return lock_table(fd, F_UNLCK, 0);
 }
 #endif /* PR_USE_CTRLS */
 
 static int statcache_wlock_stats(int fd) {
-  return lock_table(fd, F_WRLCK, (6 * sizeof(uint32_t)));
+#if defined(STATCACHE_USE_ATOMICS)
+  /* The counters are updated atomically; no lock is needed. */
+  return 0;
+#else
+  return lock_table(fd, F_WRLCK, STATCACHE_STATS_LEN);
+#endif /* STATCACHE_USE_ATOMICS */
 }
 
 static int statcache_unlock_stats(int fd) {
-  return lock_table(fd, F_UNLCK, (6 * sizeof(uint32_t)));
+#if defined(STATCACHE_USE_ATOMICS)
+  return 0;
+#else
+  return lock_table(fd, F_UNLCK, STATCACHE_STATS_LEN);
+#endif /* STATCACHE_USE_ATOMICS */
 }
 
+#if defined(STATCACHE_USE_ATOMICS)
+# define STATCACHE_STATS_ADD(ptr, n)	__atomic_add_fetch((ptr), (n), \
+  __ATOMIC_RELAXED)
+# define STATCACHE_STATS_SUB(ptr, n)	__atomic_sub_fetch((ptr), (n), \
+  __ATOMIC_RELAXED)
+#else
+# define STATCACHE_STATS_ADD(ptr, n)	(*(ptr) += (n))
+# define STATCACHE_STATS_SUB(ptr, n)	(*(ptr) -= (n))
+#endif /* STATCACHE_USE_ATOMICS */
+
 #if defined(PR_USE_CTRLS)
 static uint32_t statcache_stats_get_count(void) {
   uint32_t *count;
@@ -434,7 +479,7 @@ static int statcache_stats_decr_count(uint32_t decr) {
     *count = 0;
 
   } else {
-    *count -= decr;
+    STATCACHE_STATS_SUB(count, decr);
   }
 
   return 0;
@@ -452,10 +497,11 @@ static int statcache_stats_incr_count(uint32_t incr) {
 
   /* Prevent overflow. */
   if (UINT32_MAX - *count > incr) {
-    *count += incr;
+    uint32_t new_count;
 
-    if (*count > *highest) {
-      *highest = *count;
+    new_count = STATCACHE_STATS_ADD(count, incr);
+    if (new_count > *highest) {
+      *highest = new_count;
     }
   }
 
@@ -473,7 +519,7 @@ static int statcache_stats_incr_hits(uint32_t incr) {
 
   /* Prevent overflow. */
   if (UINT32_MAX - *hits > incr) {
-    *hits += incr;
+    STATCACHE_STATS_ADD(hits, incr);
   }
 
   return 0;
@@ -490,7 +536,7 @@ static int statcache_stats_incr_misses(uint32_t incr) {
 
   /* Prevent overflow. */
   if (UINT32_MAX - *misses > incr) {
-    *misses += incr;
+    STATCACHE_STATS_ADD(misses, incr);
   }
 
   return 0;
@@ -507,7 +553,7 @@ static int statcache_stats_incr_expires(uint32_t incr) {
 
   /* Prevent overflow. */
   if (UINT32_MAX - *expires > incr) {
-    *expires += incr;
+    STATCACHE_STATS_ADD(expires, incr);
   }
 
   return 0;
@@ -524,7 +570,7 @@ static int statcache_stats_incr_rejects(uint32_t incr) {
 
   /* Prevent overflow. */
   if (UINT32_MAX - *rejects > incr) {
-    *rejects += incr;
+    STATCACHE_STATS_ADD(rejects, incr);
   }
 
   return 0;
@@ -536,7 +582,7 @@ static int get_row_range(uint32_t hash, off_t *row_start, off_t *row_len) {
   uint32_t row_idx;
 
   row_idx = hash % statcache_nrows;
-  *row_start = (row_idx * statcache_rowlen);
+  *row_start = statcache_data_off + (row_idx * statcache_rowlen);
   *row_len = statcache_rowlen;
 
   return 0;
@@ -621,6 +667,39 @@ static int statcache_unlock_row(int fd, uint32_t hash) {
   return lock_row(fd, F_UNLCK, hash);
 }
 
+/* Row sequence counters.  A writer, holding the row write lock, makes the
+ * row's counter odd before modifying any entries in that row, and even again
+ * afterward.  A reader which sees an odd counter, or a counter that changed
+ * while it was reading, knows that its copy may be torn.  Should a writer die
+ * mid-update, the next writer for that row restores an even counter.
+ */
+static void statcache_row_write_begin(uint32_t row_idx) {
+#if defined(STATCACHE_USE_ATOMICS)
+  uint32_t *seq, val;
+
+  seq = statcache_table_seqs + row_idx;
+  val = __atomic_load_n(seq, __ATOMIC_RELAXED);
+  __atomic_store_n(seq, val | 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+#endif /* STATCACHE_USE_ATOMICS */
+}
+
+static void statcache_row_write_end(uint32_t row_idx) {
+#if defined(STATCACHE_USE_ATOMICS)
+  uint32_t *seq, val;
+
+  seq = statcache_table_seqs + row_idx;
+  val = __atomic_load_n(seq, __ATOMIC_RELAXED);
+  __atomic_store_n(seq, (val | 1) + 1, __ATOMIC_RELEASE);
+#endif /* STATCACHE_USE_ATOMICS */
+}
+
+static struct statcache_entry *statcache_row_entry(uint32_t row_idx,
+    unsigned int col_idx) {
+  return ((struct statcache_entry *) statcache_table_data) +
+    (row_idx * STATCACHE_COLS_PER_ROW) + col_idx;
+}
+
 /* Table manipulation routines */
 
 /* See http://www.cse.yorku.ca/~oz/hash.html */
@@ -658,12 +737,9 @@ static int statcache_table_add(int fd, const char *path, size_t pathlen,
   row_idx = hash % statcache_nrows;
 
   for (i = 0; i < STATCACHE_COLS_PER_ROW; i++) {
-    uint32_t col_start;
-
     pr_signals_handle();
 
-    col_start = row_idx + i;
-    sce = ((struct statcache_entry *) statcache_table_data) + col_start;
+    sce = statcache_row_entry(row_idx, i);
     if (sce->sce_ts == 0) {
       /* Empty slot */
       found_slot = TRUE;
@@ -724,6 +800,8 @@ static int statcache_table_add(int fd, const char *path, size_t pathlen,
       op == FSIO_FILE_LSTAT ? "LSTAT" : "STAT", xerrno);
   }
 
+  statcache_row_write_begin(row_idx);
+
   sce->sce_hash = hash;
   sce->sce_pathlen = pathlen;
 
@@ -736,6 +814,8 @@ static int statcache_table_add(int fd, const char *path, size_t pathlen,
   sce->sce_ts = now;
   sce->sce_op = op;
 
+  statcache_row_write_end(row_idx);
+
   if (statcache_wlock_stats(fd) < 0) {
     pr_trace_msg(trace_channel, 3,
       "error write-locking shared memory: %s", strerror(errno));
@@ -755,11 +835,77 @@ static int statcache_table_add(int fd, const char *path, size_t pathlen,
   return 0;
 }
 
+/* Look for a usable entry for the path in the given row.  Entries are only
+ * read here, never modified, so that this can be done without holding the
+ * row lock; expired entries are left for statcache_table_add() to reuse.
+ */
+static int statcache_row_find(uint32_t row_idx, const char *path,
+    size_t pathlen, struct stat *st, int *xerrno, uint32_t hash,
+    unsigned char op, time_t now) {
+  register unsigned int i;
+
+  for (i = 0; i < STATCACHE_COLS_PER_ROW; i++) {
+    struct statcache_entry *sce;
+    time_t ts;
+
+    sce = statcache_row_entry(row_idx, i);
+    ts = sce->sce_ts;
+    if (ts == 0 ||
+        sce->sce_hash != hash ||
+        sce->sce_pathlen != pathlen) {
+      continue;
+    }
+
+    /* Include the trailing NUL in the comparison... */
+    if (strncmp(sce->sce_path, path, pathlen + 1) != 0) {
+      continue;
+    }
+
+    /* Check the age.  Note that there are different expiry rules for
+     * negative cache entries (i.e. errors) than for positive cache entries.
+     */
+    if (now > (ts + (sce->sce_errno == 0 ? statcache_max_positive_age :
+        statcache_max_negative_age))) {
+      pr_trace_msg(trace_channel, 17,
+        "skipping expired cache entry for path '%s' (hash %lu) at row %lu, "
+        "col %u: aged %lu secs", path, (unsigned long) hash,
+        (unsigned long) row_idx + 1, i + 1, (unsigned long) (now - ts));
+      continue;
+    }
+
+    /* If the ops match, OR if the entry is from a LSTAT AND the entry
+     * is NOT a symlink, we can use it.
+     */
+    if (sce->sce_op == op ||
+        (sce->sce_op == FSIO_FILE_LSTAT &&
+         S_ISLNK(sce->sce_stat.st_mode) == FALSE)) {
+      *xerrno = sce->sce_errno;
+      if (sce->sce_errno == 0) {
+        memcpy(st, &(sce->sce_stat), sizeof(struct stat));
+      }
+
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+#if !defined(STATCACHE_USE_ATOMICS)
+static int statcache_rlock_row(int fd, uint32_t hash) {
+  return lock_row(fd, F_RDLCK, hash);
+}
+#endif /* STATCACHE_USE_ATOMICS */
+
 static int statcache_table_get(int fd, const char *path, size_t pathlen,
     struct stat *st, int *xerrno, uint32_t hash, unsigned char op) {
-  register unsigned int i;
-  int expired_entries = 0, res = -1;
+  int res = -1;
   uint32_t row_idx;
+  time_t now;
+#if defined(STATCACHE_USE_ATOMICS)
+  register unsigned int i;
+  uint32_t *seq;
+#endif /* STATCACHE_USE_ATOMICS */
 
   if (statcache_table == NULL) {
     errno = EPERM;
@@ -767,77 +913,54 @@ static int statcache_table_get(int fd, const char *path, size_t pathlen,
   }
 
   row_idx = hash % statcache_nrows;
-  /* Find the matching entry for this path. */
-  for (i = 0; i < STATCACHE_COLS_PER_ROW; i++) {
-    uint32_t col_start;
-    struct statcache_entry *sce;
+  now = time(NULL);
 
-    pr_signals_handle();
+#if defined(STATCACHE_USE_ATOMICS)
+  seq = statcache_table_seqs + row_idx;
 
-    col_start = row_idx + i;
-    sce = ((struct statcache_entry *) statcache_table_data) + col_start;
-    if (sce->sce_ts > 0) {
-      if (sce->sce_hash == hash) {
-        /* Possible collision; check paths. */
-        if (sce->sce_pathlen == pathlen) {
+  for (i = 0; i < STATCACHE_MAX_READ_ATTEMPTS; i++) {
+    uint32_t val;
 
-          /* Include the trailing NUL in the comparison... */
-          if (strncmp(sce->sce_path, path, pathlen + 1) == 0) {
-            time_t now;
-
-            now = time(NULL);
-
-            /* Check the age.  If it's aged out, clear it now, for later use. */
-            if (sce->sce_errno == 0) {
-              if (now > (sce->sce_ts + statcache_max_positive_age)) {
-                pr_trace_msg(trace_channel, 17,
-                  "clearing expired cache entry for path '%s' (hash %lu) "
-                  "at row %lu, col %u: aged %lu secs",
-                  sce->sce_path, (unsigned long) hash,
-                  (unsigned long) row_idx + 1, i + 1,
-                  (unsigned long) (now - sce->sce_ts));
-                sce->sce_ts = 0;
-                expired_entries++;
-                continue;
-              }
-
-            } else {
-              if (now > (sce->sce_ts + statcache_max_negative_age)) {
-                pr_trace_msg(trace_channel, 17,
-                  "clearing expired negative cache entry for path '%s' "
-                  "(hash %lu) at row %lu, col %u: aged %lu secs",
-                  sce->sce_path, (unsigned long) hash,
-                  (unsigned long) row_idx + 1, i + 1,
-                  (unsigned long) (now - sce->sce_ts));
-                sce->sce_ts = 0;
-                expired_entries++;
-                continue;
-              }
-            }
-
-            /* If the ops match, OR if the entry is from a LSTAT AND the entry
-             * is NOT a symlink, we can use it.
-             */
-            if (sce->sce_op == op ||
-                (sce->sce_op == FSIO_FILE_LSTAT &&
-                 S_ISLNK(sce->sce_stat.st_mode) == FALSE)) {
-              /* Found matching entry. */
-              pr_trace_msg(trace_channel, 9,
-                "found entry for path '%s' (hash %lu) at row %lu, col %u",
-                path, (unsigned long) hash, (unsigned long) row_idx + 1, i + 1);
-
-              *xerrno = sce->sce_errno;
-              if (sce->sce_errno == 0) {
-                memcpy(st, &(sce->sce_stat), sizeof(struct stat));
-              }
-
-              res = 0;
-              break;
-            }
-          }
-        }
-      }
+    val = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+    if (val & 1) {
+      /* A writer is busy with this row. */
+      continue;
     }
+
+    res = statcache_row_find(row_idx, path, pathlen, st, xerrno, hash, op,
+      now);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(seq, __ATOMIC_RELAXED) == val) {
+      break;
+    }
+
+    res = -1;
+  }
+
+  if (i == STATCACHE_MAX_READ_ATTEMPTS) {
+    pr_trace_msg(trace_channel, 15,
+      "row %lu busy after %u read attempts, treating as miss",
+      (unsigned long) row_idx + 1, i);
+  }
+#else
+  if (statcache_rlock_row(fd, hash) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error read-locking shared memory: %s", strerror(errno));
+  }
+
+  res = statcache_row_find(row_idx, path, pathlen, st, xerrno, hash, op, now);
+
+  if (statcache_unlock_row(fd, hash) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error unlocking shared memory: %s", strerror(errno));
+  }
+#endif /* STATCACHE_USE_ATOMICS */
+
+  if (res == 0) {
+    pr_trace_msg(trace_channel, 9,
+      "found entry for path '%s' (hash %lu) at row %lu", path,
+      (unsigned long) hash, (unsigned long) row_idx + 1);
   }
 
   if (statcache_wlock_stats(fd) < 0) {
@@ -852,11 +975,6 @@ static int statcache_table_get(int fd, const char *path, size_t pathlen,
     statcache_stats_incr_misses(1);
   }
 
-  if (expired_entries > 0) {
-    statcache_stats_decr_count(expired_entries);
-    statcache_stats_incr_expires(expired_entries);
-  }
-
   if (statcache_unlock_stats(fd) < 0) {
     pr_trace_msg(trace_channel, 3,
       "error un-locking shared memory: %s", strerror(errno));
@@ -884,13 +1002,11 @@ static int statcache_table_remove(int fd, const char *path, size_t pathlen,
 
   /* Find the matching entry for this path. */
   for (i = 0; i < STATCACHE_COLS_PER_ROW; i++) {
-    uint32_t col_start;
     struct statcache_entry *sce;
 
     pr_signals_handle();
 
-    col_start = row_idx + i;
-    sce = ((struct statcache_entry *) statcache_table_data) + col_start;
+    sce = statcache_row_entry(row_idx, i);
     if (sce->sce_ts > 0) {
       if (sce->sce_hash == hash) {
         /* Possible collision; check paths. */
@@ -904,7 +1020,9 @@ static int statcache_table_remove(int fd, const char *path, size_t pathlen,
               "removing entry for path '%s' (hash %lu) at row %lu, col %u",
               path, (unsigned long) hash, (unsigned long) row_idx + 1, i + 1);
 
+            statcache_row_write_begin(row_idx);
             sce->sce_ts = 0;
+            statcache_row_write_end(row_idx);
             removed_entries++;
             res = 0;
 
@@ -940,6 +1058,109 @@ static int statcache_table_remove(int fd, const char *path, size_t pathlen,
   return res;
 }
 
+/* Remove any entries for the given canonical path, and for its parent
+ * directory, whose mtime/nlink change when directory entries are created,
+ * removed, or renamed.
+ */
+static void statcache_table_remove_entry(int fd, const char *path,
+    size_t pathlen) {
+  uint32_t hash;
+
+  hash = statcache_hash(path, pathlen);
+
+  if (statcache_wlock_row(fd, hash) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error write-locking shared memory: %s", strerror(errno));
+  }
+
+  (void) statcache_table_remove(fd, path, pathlen, hash);
+
+  if (statcache_unlock_row(fd, hash) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error unlocking shared memory: %s", strerror(errno));
+  }
+}
+
+static void statcache_table_remove_parent(int fd, const char *path,
+    size_t pathlen) {
+  char parent[PR_TUNABLE_PATH_MAX+1];
+  const char *ptr;
+  size_t parentlen;
+
+  ptr = strrchr(path, '/');
+  if (ptr == NULL) {
+    return;
+  }
+
+  parentlen = ptr - path;
+  if (parentlen == 0) {
+    /* The parent is the root directory. */
+    parentlen = 1;
+  }
+
+  if (parentlen >= sizeof(parent) ||
+      parentlen == pathlen) {
+    return;
+  }
+
+  memcpy(parent, path, parentlen);
+  parent[parentlen] = '\0';
+
+  statcache_table_remove_entry(fd, parent, parentlen);
+}
+
+/* Cache entries are shared among all sessions, which may be chrooted to
+ * different directories; prefix the session's chroot path, so that the
+ * key names the same file for everyone.
+ */
+static int statcache_add_chroot(char *buf, size_t bufsz, size_t *buflen) {
+  size_t chroot_len;
+
+  if (session.chroot_path == NULL ||
+      strcmp(session.chroot_path, "/") == 0) {
+    return 0;
+  }
+
+  chroot_len = strlen(session.chroot_path);
+  if (session.chroot_path[chroot_len-1] == '/') {
+    chroot_len--;
+  }
+
+  if (chroot_len + *buflen + 1 > bufsz) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  if (*buflen == 1 &&
+      buf[0] == '/') {
+    /* The chroot directory itself. */
+    *buflen = 0;
+  }
+
+  memmove(buf + chroot_len, buf, *buflen + 1);
+  memcpy(buf, session.chroot_path, chroot_len);
+  *buflen += chroot_len;
+
+  return 0;
+}
+
+static const char *statcache_get_fh_canon_path(pr_fh_t *fh, char *buf,
+    size_t bufsz, size_t *pathlen) {
+
+  if (pr_fs_dircat(buf, bufsz, pr_fs_getcwd(), fh->fh_path) < 0) {
+    *pathlen = strlen(fh->fh_path);
+    return fh->fh_path;
+  }
+
+  *pathlen = strlen(buf);
+  if (statcache_add_chroot(buf, bufsz, pathlen) < 0) {
+    *pathlen = strlen(fh->fh_path);
+    return fh->fh_path;
+  }
+
+  return buf;
+}
+
 static const char *statcache_get_canon_path(pool *p, const char *path,
     size_t *pathlen) {
   int res;
@@ -963,6 +1184,10 @@ static const char *statcache_get_canon_path(pool *p, const char *path,
   }
 
   *pathlen = strlen(canon_path);
+  if (statcache_add_chroot(canon_path, canon_pathlen, pathlen) < 0) {
+    return NULL;
+  }
+
   return canon_path;
 }
 
@@ -991,19 +1216,9 @@ static int statcache_fsio_stat(pr_fs_t *fs, const char *path,
   hash = statcache_hash(canon_path, canon_pathlen);
   tab_fd = statcache_tabfh->fh_fd;
 
-  if (statcache_wlock_row(tab_fd, hash) < 0) {
-    pr_trace_msg(trace_channel, 3,
-      "error write-locking shared memory: %s", strerror(errno));
-  }
-
   res = statcache_table_get(tab_fd, canon_path, canon_pathlen, st, &xerrno,
     hash, FSIO_FILE_STAT);
 
-  if (statcache_unlock_row(tab_fd, hash) < 0) {
-    pr_trace_msg(trace_channel, 3,
-      "error unlocking shared memory: %s", strerror(errno));
-  }
-
   if (res == 0) {
     if (xerrno != 0) {
       res = -1;
@@ -1026,11 +1241,6 @@ static int statcache_fsio_stat(pr_fs_t *fs, const char *path,
       "error write-locking shared memory: %s", strerror(errno));
   }
 
-  if (statcache_wlock_row(tab_fd, hash) < 0) {
-    pr_trace_msg(trace_channel, 3,
-      "error write-locking shared memory: %s", strerror(errno));
-  }
-
   if (res < 0) {
     if (statcache_max_negative_age > 0) {
       /* Negatively cache the failed stat(2). */
@@ -1062,6 +1272,8 @@ static int statcache_fsio_stat(pr_fs_t *fs, const char *path,
 static int statcache_fsio_fstat(pr_fh_t *fh, int fd, struct stat *st) {
   int res, tab_fd, xerrno = 0;
   size_t pathlen = 0;
+  const char *canon_path;
+  char canon_buf[PR_TUNABLE_PATH_MAX+1];
   uint32_t hash;
 
   /* XXX Core FSIO API should have an fh_pathlen member.
@@ -1071,30 +1283,21 @@ static int statcache_fsio_fstat(pr_fh_t *fh, int fd, struct stat *st) {
    * stash it in the table.
    */
 
-  pathlen = strlen(fh->fh_path);
-  hash = statcache_hash(fh->fh_path, pathlen);
+  canon_path = statcache_get_fh_canon_path(fh, canon_buf,
+    sizeof(canon_buf), &pathlen);
+  hash = statcache_hash(canon_path, pathlen);
   tab_fd = statcache_tabfh->fh_fd;
 
-  if (statcache_wlock_row(tab_fd, hash) < 0) {
-    pr_trace_msg(trace_channel, 3,
-      "error write-locking shared memory: %s", strerror(errno));
-  }
-
-  res = statcache_table_get(tab_fd, fh->fh_path, pathlen, st, &xerrno, hash,
+  res = statcache_table_get(tab_fd, canon_path, pathlen, st, &xerrno, hash,
     FSIO_FILE_STAT);
 
-  if (statcache_unlock_row(tab_fd, hash) < 0) {
-    pr_trace_msg(trace_channel, 3,
-      "error unlocking shared memory: %s", strerror(errno));
-  }
-
   if (res == 0) {
     if (xerrno != 0) {
       res = -1;
 
     } else {
       pr_trace_msg(trace_channel, 11,
-        "using cached stat for path '%s'", fh->fh_path);
+        "using cached stat for path '%s'", canon_path);
     }
 
     errno = xerrno;
@@ -1112,18 +1315,18 @@ static int statcache_fsio_fstat(pr_fh_t *fh, int fd, struct stat *st) {
   if (res < 0) {
     if (statcache_max_negative_age > 0) {
       /* Negatively cache the failed fstat(2). */
-      if (statcache_table_add(tab_fd, fh->fh_path, pathlen, NULL, xerrno,
+      if (statcache_table_add(tab_fd, canon_path, pathlen, NULL, xerrno,
           hash, FSIO_FILE_STAT) < 0) {
         pr_trace_msg(trace_channel, 3, "error adding entry for path '%s': %s",
-          fh->fh_path, strerror(errno));
+          canon_path, strerror(errno));
       }
     }
 
   } else {
-    if (statcache_table_add(tab_fd, fh->fh_path, pathlen, st, 0, hash,
+    if (statcache_table_add(tab_fd, canon_path, pathlen, st, 0, hash,
         FSIO_FILE_STAT) < 0) {
       pr_trace_msg(trace_channel, 3, "error adding entry for path '%s': %s",
-        fh->fh_path, strerror(errno));
+        canon_path, strerror(errno));
     }
   }
 
@@ -1158,19 +1361,9 @@ static int statcache_fsio_lstat(pr_fs_t *fs, const char *path,
   hash = statcache_hash(canon_path, canon_pathlen);
   tab_fd = statcache_tabfh->fh_fd;
 
-  if (statcache_wlock_row(tab_fd, hash) < 0) {
-    pr_trace_msg(trace_channel, 3,
-      "error write-locking shared memory: %s", strerror(errno));
-  }
-
   res = statcache_table_get(tab_fd, canon_path, canon_pathlen, st, &xerrno,
     hash, FSIO_FILE_LSTAT);
 
-  if (statcache_unlock_row(tab_fd, hash) < 0) {
-    pr_trace_msg(trace_channel, 3,
-      "error unlocking shared memory: %s", strerror(errno));
-  }
-
   if (res == 0) {
     if (xerrno != 0) {
       res = -1;
@@ -1284,6 +1477,9 @@ static int statcache_fsio_rename(pr_fs_t *fs, const char *rnfm,
         "error unlocking shared memory: %s", strerror(errno));
     }
 
+    statcache_table_remove_parent(tab_fd, canon_rnfm, canon_rnfmlen);
+    statcache_table_remove_parent(tab_fd, canon_rnto, canon_rntolen);
+
     destroy_pool(p);
   }
 
@@ -1330,6 +1526,7 @@ static int statcache_fsio_unlink(pr_fs_t *fs, const char *path) {
         "error unlocking shared memory: %s", strerror(errno));
     }
 
+    statcache_table_remove_parent(tab_fd, canon_path, canon_pathlen);
     destroy_pool(p);
   }
 
@@ -1383,6 +1580,10 @@ static int statcache_fsio_open(pr_fh_t *fh, const char *path, int flags) {
           "error unlocking shared memory: %s", strerror(errno));
       }
 
+      if (flags & O_CREAT) {
+        statcache_table_remove_parent(tab_fd, canon_path, canon_pathlen);
+      }
+
       destroy_pool(p);
     }
   } 
@@ -1391,6 +1592,63 @@ static int statcache_fsio_open(pr_fh_t *fh, const char *path, int flags) {
   return res;
 }
 
+static int statcache_fsio_mkdir(pr_fs_t *fs, const char *path, mode_t mode) {
+  int res, xerrno;
+
+  res = mkdir(path, mode);
+  xerrno = errno;
+
+  if (res == 0) {
+    const char *canon_path = NULL;
+    size_t canon_pathlen = 0;
+    pool *p;
+
+    p = make_sub_pool(statcache_pool);
+    pr_pool_tag(p, "statcache_fsio_mkdir sub-pool");
+    canon_path = statcache_get_canon_path(p, path, &canon_pathlen);
+    if (canon_path != NULL) {
+      /* Clear any negative cache entry for the new directory. */
+      statcache_table_remove_entry(statcache_tabfh->fh_fd, canon_path,
+        canon_pathlen);
+      statcache_table_remove_parent(statcache_tabfh->fh_fd, canon_path,
+        canon_pathlen);
+    }
+
+    destroy_pool(p);
+  }
+
+  errno = xerrno;
+  return res;
+}
+
+static int statcache_fsio_rmdir(pr_fs_t *fs, const char *path) {
+  int res, xerrno;
+
+  res = rmdir(path);
+  xerrno = errno;
+
+  if (res == 0) {
+    const char *canon_path = NULL;
+    size_t canon_pathlen = 0;
+    pool *p;
+
+    p = make_sub_pool(statcache_pool);
+    pr_pool_tag(p, "statcache_fsio_rmdir sub-pool");
+    canon_path = statcache_get_canon_path(p, path, &canon_pathlen);
+    if (canon_path != NULL) {
+      statcache_table_remove_entry(statcache_tabfh->fh_fd, canon_path,
+        canon_pathlen);
+      statcache_table_remove_parent(statcache_tabfh->fh_fd, canon_path,
+        canon_pathlen);
+    }
+
+    destroy_pool(p);
+  }
+
+  errno = xerrno;
+  return res;
+}
+
 static int statcache_fsio_write(pr_fh_t *fh, int fd, const char *buf,
     size_t buflen) {
   int res, xerrno;
@@ -1401,10 +1659,13 @@ static int statcache_fsio_write(pr_fh_t *fh, int fd, const char *buf,
   if (res > 0) {
     int tab_fd;
     size_t pathlen = 0;
+    const char *canon_path;
+    char canon_buf[PR_TUNABLE_PATH_MAX+1];
     uint32_t hash;
 
-    pathlen = strlen(fh->fh_path);
-    hash = statcache_hash(fh->fh_path, pathlen);
+    canon_path = statcache_get_fh_canon_path(fh, canon_buf,
+      sizeof(canon_buf), &pathlen);
+    hash = statcache_hash(canon_path, pathlen);
     tab_fd = statcache_tabfh->fh_fd;
  
     if (statcache_wlock_row(tab_fd, hash) < 0) {
@@ -1412,7 +1673,7 @@ static int statcache_fsio_write(pr_fh_t *fh, int fd, const char *buf,
         "error write-locking shared memory: %s", strerror(errno));
     }
   
-    (void) statcache_table_remove(tab_fd, fh->fh_path, pathlen, hash);
+    (void) statcache_table_remove(tab_fd, canon_path, pathlen, hash);
 
     if (statcache_unlock_row(tab_fd, hash) < 0) {
       pr_trace_msg(trace_channel, 3,
@@ -1479,10 +1740,13 @@ static int statcache_fsio_ftruncate(pr_fh_t *fh, int fd, off_t len) {
   if (res == 0) {
     int tab_fd;
     size_t pathlen = 0;
+    const char *canon_path;
+    char canon_buf[PR_TUNABLE_PATH_MAX+1];
     uint32_t hash;
 
-    pathlen = strlen(fh->fh_path);
-    hash = statcache_hash(fh->fh_path, pathlen);
+    canon_path = statcache_get_fh_canon_path(fh, canon_buf,
+      sizeof(canon_buf), &pathlen);
+    hash = statcache_hash(canon_path, pathlen);
     tab_fd = statcache_tabfh->fh_fd;
 
     if (statcache_wlock_row(tab_fd, hash) < 0) {
@@ -1490,7 +1754,7 @@ static int statcache_fsio_ftruncate(pr_fh_t *fh, int fd, off_t len) {
         "error write-locking shared memory: %s", strerror(errno));
     }
  
-    (void) statcache_table_remove(tab_fd, fh->fh_path, pathlen, hash);
+    (void) statcache_table_remove(tab_fd, canon_path, pathlen, hash);
 
     if (statcache_unlock_row(tab_fd, hash) < 0) {
       pr_trace_msg(trace_channel, 3,
@@ -1557,10 +1821,13 @@ static int statcache_fsio_fchmod(pr_fh_t *fh, int fd, mode_t mode) {
   if (res == 0) {
     int tab_fd;
     size_t pathlen = 0;
+    const char *canon_path;
+    char canon_buf[PR_TUNABLE_PATH_MAX+1];
     uint32_t hash;
 
-    pathlen = strlen(fh->fh_path);
-    hash = statcache_hash(fh->fh_path, pathlen);
+    canon_path = statcache_get_fh_canon_path(fh, canon_buf,
+      sizeof(canon_buf), &pathlen);
+    hash = statcache_hash(canon_path, pathlen);
     tab_fd = statcache_tabfh->fh_fd;
 
     if (statcache_wlock_row(tab_fd, hash) < 0) {
@@ -1568,7 +1835,7 @@ static int statcache_fsio_fchmod(pr_fh_t *fh, int fd, mode_t mode) {
         "error write-locking shared memory: %s", strerror(errno));
     }
  
-    (void) statcache_table_remove(tab_fd, fh->fh_path, pathlen, hash);
+    (void) statcache_table_remove(tab_fd, canon_path, pathlen, hash);
 
     if (statcache_unlock_row(tab_fd, hash) < 0) {
       pr_trace_msg(trace_channel, 3,
@@ -1636,10 +1903,13 @@ static int statcache_fsio_fchown(pr_fh_t *fh, int fd, uid_t uid, gid_t gid) {
   if (res == 0) {
     int tab_fd;
     size_t pathlen = 0;
+    const char *canon_path;
+    char canon_buf[PR_TUNABLE_PATH_MAX+1];
     uint32_t hash;
 
-    pathlen = strlen(fh->fh_path);
-    hash = statcache_hash(fh->fh_path, pathlen);
+    canon_path = statcache_get_fh_canon_path(fh, canon_buf,
+      sizeof(canon_buf), &pathlen);
+    hash = statcache_hash(canon_path, pathlen);
     tab_fd = statcache_tabfh->fh_fd;
 
     if (statcache_wlock_row(tab_fd, hash) < 0) {
@@ -1647,7 +1917,7 @@ static int statcache_fsio_fchown(pr_fh_t *fh, int fd, uid_t uid, gid_t gid) {
         "error write-locking shared memory: %s", strerror(errno));
     }
  
-    (void) statcache_table_remove(tab_fd, fh->fh_path, pathlen, hash);
+    (void) statcache_table_remove(tab_fd, canon_path, pathlen, hash);
 
     if (statcache_unlock_row(tab_fd, hash) < 0) {
       pr_trace_msg(trace_channel, 3,
@@ -1774,10 +2044,13 @@ static int statcache_fsio_futimes(pr_fh_t *fh, int fd, struct timeval *tvs) {
   if (res == 0) {
     int tab_fd;
     size_t pathlen = 0;
+    const char *canon_path;
+    char canon_buf[PR_TUNABLE_PATH_MAX+1];
     uint32_t hash;
 
-    pathlen = strlen(fh->fh_path);
-    hash = statcache_hash(fh->fh_path, pathlen);
+    canon_path = statcache_get_fh_canon_path(fh, canon_buf,
+      sizeof(canon_buf), &pathlen);
+    hash = statcache_hash(canon_path, pathlen);
     tab_fd = statcache_tabfh->fh_fd;
 
     if (statcache_wlock_row(tab_fd, hash) < 0) {
@@ -1785,7 +2058,7 @@ static int statcache_fsio_futimes(pr_fh_t *fh, int fd, struct timeval *tvs) {
         "error write-locking shared memory: %s", strerror(errno));
     }
  
-    (void) statcache_table_remove(tab_fd, fh->fh_path, pathlen, hash);
+    (void) statcache_table_remove(tab_fd, canon_path, pathlen, hash);
 
     if (statcache_unlock_row(tab_fd, hash) < 0) {
       pr_trace_msg(trace_channel, 3,
@@ -1888,19 +2161,15 @@ static int statcache_handle_statcache(pr_ctrls_t *ctrl, int reqargc,
 
     for (i = 0; i < statcache_nrows; i++) {
       register unsigned int j;
-      unsigned long row_start;
 
       pr_ctrls_add_response(ctrl, "  Row %u:", i + 1);
-      row_start = i;
 
       for (j = 0; j < STATCACHE_COLS_PER_ROW; j++) {
-        unsigned long col_start;
         struct statcache_entry *sce;
 
         pr_signals_handle();
 
-        col_start = row_start + j;
-        sce = ((struct statcache_entry *) statcache_table_data) + col_start;
+        sce = statcache_row_entry(i, j);
         if (sce->sce_ts > 0) {
           if (sce->sce_errno == 0) {
             pr_ctrls_add_response(ctrl, "    Col %u: '%s' (%u secs old)",
@@ -2023,6 +2292,36 @@ MODRET set_statcacheengine(cmd_rec *cmd) {
   return PR_HANDLED(cmd);
 }
 
+/* usage: StatCacheOptions opt1 ... */
+MODRET set_statcacheoptions(cmd_rec *cmd) {
+  config_rec *c = NULL;
+  register unsigned int i = 0;
+  unsigned long opts = 0UL;
+
+  if (cmd->argc-1 == 0) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+
+  for (i = 1; i < cmd->argc; i++) {
+    if (strcmp(cmd->argv[i], "LocalInvalidationOnly") == 0) {
+      opts |= STATCACHE_OPT_LOCAL_INVALIDATION_ONLY;
+
+    } else {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, ": unknown StatCacheOption '",
+        cmd->argv[i], "'", NULL));
+    }
+  }
+
+  c->argv[0] = pcalloc(c->pool, sizeof(unsigned long));
+  *((unsigned long *) c->argv[0]) = opts;
+
+  return PR_HANDLED(cmd);
+}
+
 /* usage: StatCacheMaxAge secs */
 MODRET set_statcachemaxage(cmd_rec *cmd) {
   int positive_age;
@@ -2100,7 +2399,9 @@ MODRET statcache_post_pass(cmd_rec *cmd) {
   fs->lstat = statcache_fsio_lstat;
   fs->rename = statcache_fsio_rename;
   fs->unlink = statcache_fsio_unlink;
-  fs->open = statcache_fsio_open;;
+  fs->open = statcache_fsio_open;
+  fs->mkdir = statcache_fsio_mkdir;
+  fs->rmdir = statcache_fsio_rmdir;
   fs->truncate = statcache_fsio_truncate;
   fs->ftruncate = statcache_fsio_ftruncate;
   fs->write = statcache_fsio_write;
@@ -2117,8 +2418,16 @@ MODRET statcache_post_pass(cmd_rec *cmd) {
   pr_fs_setcwd(pr_fs_getvwd());
   pr_fs_clear_cache();
 
-  pr_event_register(&statcache_module, "fs.statcache.clear",
-    statcache_fs_statcache_clear_ev, NULL);
+  /* Other modules ask for a path's cached stat data to be cleared when they
+   * want fresh data for their own session (e.g. mod_ls, for every entry of a
+   * listing).  Honoring these would mean that a listing never benefits from
+   * the entries cached by other sessions; with LocalInvalidationOnly, entries
+   * are only removed by our own write callbacks, or by aging out.
+   */
+  if (!(statcache_opts & STATCACHE_OPT_LOCAL_INVALIDATION_ONLY)) {
+    pr_event_register(&statcache_module, "fs.statcache.clear",
+      statcache_fs_statcache_clear_ev, NULL);
+  }
 
   /* If we are handling an SSH2 session, then we need to disable all
    * negative caching; something about ProFTPD's stat caching interacting
@@ -2210,6 +2519,7 @@ static void statcache_sess_reinit_ev(const void *event_data, void *user_data) {
 
   /* Restore defaults */
   statcache_engine = FALSE;
+  statcache_opts = 0UL;
 
   res = statcache_sess_init();
   if (res < 0) {
@@ -2351,15 +2661,21 @@ static void statcache_postparse_ev(const void *event_data, void *user_data) {
 
   /* The size of the table, in bytes, is:
    *
-   *  sizeof(header) + sizeof(data)
+   *  sizeof(header) + sizeof(row seqs) + sizeof(data)
    *
    * thus:
    *
    *  header = 6 * sizeof(uint32_t)
+   *  row seqs = nrows * sizeof(uint32_t), padded to a multiple of 8
    *  data = capacity * sizeof(struct statcache_entry)
    */
 
-  tablesz = (6 * sizeof(uint32_t)) +
+  statcache_nrows = (statcache_capacity / STATCACHE_COLS_PER_ROW);
+  statcache_rowlen = (STATCACHE_COLS_PER_ROW * sizeof(struct statcache_entry));
+  statcache_data_off = STATCACHE_STATS_LEN +
+    (((statcache_nrows * sizeof(uint32_t)) + 7) & ~((size_t) 7));
+
+  tablesz = statcache_data_off +
     (statcache_capacity * sizeof(struct statcache_entry));
 
   /* Get the shm for storing all of our stat info. */
@@ -2379,10 +2695,8 @@ static void statcache_postparse_ev(const void *event_data, void *user_data) {
   statcache_table = table;
   statcache_tablesz = tablesz;
   statcache_table_stats = statcache_table;
-  statcache_table_data = ((uint32_t *) statcache_table + 6);
-
-  statcache_nrows = (statcache_capacity / STATCACHE_COLS_PER_ROW);
-  statcache_rowlen = (STATCACHE_COLS_PER_ROW * sizeof(struct statcache_entry));
+  statcache_table_seqs = ((uint32_t *) statcache_table + 6);
+  statcache_table_data = ((char *) statcache_table + statcache_data_off);
 
   return;
 }
@@ -2476,6 +2790,18 @@ static int statcache_sess_init(void) {
     statcache_engine = *((int *) c->argv[0]);
   }
 
+  c = find_config(main_server->conf, CONF_PARAM, "StatCacheOptions", FALSE);
+  while (c != NULL) {
+    unsigned long opts = 0;
+
+    pr_signals_handle();
+
+    opts = *((unsigned long *) c->argv[0]);
+    statcache_opts |= opts;
+
+    c = find_config_next(c, c->next, CONF_PARAM, "StatCacheOptions", FALSE);
+  }
+
   return 0;
 }
 
@@ -2498,6 +2824,7 @@ static conftable statcache_conftab[] = {
   { "StatCacheControlsACLs",	set_statcachectrlsacls,	NULL },
   { "StatCacheEngine",		set_statcacheengine,	NULL },
   { "StatCacheMaxAge",		set_statcachemaxage,	NULL },
+  { "StatCacheOptions",		set_statcacheoptions,	NULL },
   { "StatCacheTable",		set_statcachetable,	NULL },
   { NULL }
 };
@@ -7573,6 +7573,22 @@ static int tls_compare_session_ids(SSL_SESSION *ctrl_sess,
   return res;
 }
 
+/* Record the duration of the control connection handshake, for the
+ * session and its scoreboard entry.
+ */
+static void tls_set_handshake_ms(uint64_t start_ms) {
+  uint64_t finish_ms;
+
+  if (pr_gettimeofday_millis(&finish_ms) < 0) {
+    return;
+  }
+
+  session.handshake_ms = (unsigned long) (finish_ms - start_ms);
+  pr_scoreboard_entry_update(session.pid,
+    PR_SCORE_HANDSHAKE_MS, session.handshake_ms,
+    NULL);
+}
+
 static int tls_accept(conn_t *conn, unsigned char on_data) {
   static unsigned char logged_data = FALSE;
   int blocking, res = 0, xerrno = 0;
@@ -13028,9 +13044,7 @@ MODRET tls_auth(cmd_rec *cmd) {
     pr_response_send(R_234, _("AUTH %s successful"), (char *) cmd->argv[1]);
     tls_log("%s", "TLS/TLS-C requested, starting TLS handshake");
 
-    if (pr_trace_get_level(timing_channel) > 0) {
-      pr_gettimeofday_millis(&start_ms);
-    }
+    pr_gettimeofday_millis(&start_ms);
 
     pr_event_generate("mod_tls.ctrl-handshake", session.c);
     if (tls_accept(session.c, FALSE) < 0) {
@@ -13059,6 +13073,7 @@ MODRET tls_auth(cmd_rec *cmd) {
 #endif
 
     tls_flags |= TLS_SESS_ON_CTRL;
+    tls_set_handshake_ms(start_ms);
 
     if (pr_trace_get_level(timing_channel) >= 4) {
       unsigned long elapsed_ms;
@@ -13082,9 +13097,7 @@ MODRET tls_auth(cmd_rec *cmd) {
     pr_response_send(R_234, _("AUTH %s successful"), (char *) cmd->argv[1]);
     tls_log("%s", "SSL/TLS-P requested, starting TLS handshake");
 
-    if (pr_trace_get_level(timing_channel) > 0) {
-      pr_gettimeofday_millis(&start_ms);
-    }
+    pr_gettimeofday_millis(&start_ms);
 
     if (tls_accept(session.c, FALSE) < 0) {
       tls_log("%s", "SSL/TLS-P negotiation failed on control channel");
@@ -13113,6 +13126,7 @@ MODRET tls_auth(cmd_rec *cmd) {
 
     tls_flags |= TLS_SESS_ON_CTRL;
     tls_flags |= TLS_SESS_NEED_DATA_PROT;
+    tls_set_handshake_ms(start_ms);
 
     if (pr_trace_get_level(timing_channel) >= 4) {
       unsigned long elapsed_ms;
@@ -18964,9 +18978,7 @@ static int tls_sess_init(void) {
     tls_log("%s", "TLSOption UseImplicitSSL in effect, starting SSL/TLS "
       "handshake");
 
-    if (pr_trace_get_level(timing_channel) > 0) {
-      pr_gettimeofday_millis(&start_ms);
-    }
+    pr_gettimeofday_millis(&start_ms);
 
     if (tls_accept(session.c, FALSE) < 0) {
       tls_log("%s", "implicit SSL/TLS negotiation failed on control channel");
@@ -18980,6 +18992,7 @@ static int tls_sess_init(void) {
     }
 
     tls_flags |= TLS_SESS_ON_CTRL;
+    tls_set_handshake_ms(start_ms);
 
     if (tls_required_on_data != -1) {
       tls_flags |= TLS_SESS_NEED_DATA_PROT;
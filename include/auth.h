@@ -160,6 +160,55 @@ int pr_auth_cache_set(int enable, unsigned int flags);
    PR_AUTH_CACHE_FL_BAD_NAME2UID|\
    PR_AUTH_CACHE_FL_BAD_NAME2GID)
 
+/* Shared cache of getpwnam and getgroups results, for use by all of the
+ * session processes of the standalone daemon which creates it.  Positive
+ * results are kept for the given TTL, in seconds, and negative results for
+ * the given negative TTL; a TTL of zero disables caching of those results.
+ * Returns -1 with ENOSYS if the shared cache is not supported on this
+ * platform.  Only the creating process writes the cache, and only it
+ * removes the cache when freeing it.
+ */
+int pr_auth_shared_cache_init(unsigned int nentries, int ttl,
+  int negative_ttl);
+int pr_auth_shared_cache_free(void);
+
+/* Called by each session process, before its first lookup.  The session
+ * keeps read-only access to the cache; the results it looks up itself are
+ * sent to the daemon, which stores them.
+ */
+int pr_auth_shared_cache_sess_init(void);
+
+/* Notes that this session process has logged in; it sends no more results
+ * to the daemon, and, if it still could, no longer writes the cache.
+ */
+int pr_auth_shared_cache_login(void);
+
+/* Stores the results sent by session processes, after checking them.  The
+ * daemon calls this periodically.  Returns the number of results stored.
+ */
+int pr_auth_shared_cache_update(void);
+
+/* Removes any shared cache entries for the given user, or all entries if
+ * the user is NULL.  Returns the number of entries removed.  Only the
+ * daemon may do this.
+ */
+int pr_auth_shared_cache_remove(const char *user);
+
+typedef struct {
+  unsigned int nentries;
+  unsigned int used;
+  int ttl;
+  int negative_ttl;
+
+  uint64_t hits;
+  uint64_t negative_hits;
+  uint64_t misses;
+  uint64_t stores;
+  uint64_t evictions;
+} pr_auth_shared_cache_stats_t;
+
+int pr_auth_shared_cache_get_stats(pr_auth_shared_cache_stats_t *stats);
+
 /* Wrapper function for retrieving the user's home directory.  This handles
  * any possible RewriteHome configuration.
  */
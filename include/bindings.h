@@ -139,6 +139,24 @@ server_rec *pr_ipbind_get_server(const pr_netaddr_t *addr, unsigned int port);
  */
 int pr_ipbind_listen(fd_set *readfds);
 
+#ifdef PR_USE_EPOLL
+/* Like pr_ipbind_listen(), except that the listening fds are registered,
+ * edge-triggered, with an epoll(7) fd, which is returned.  The epoll fd is
+ * created, and the listeners registered, only once; it is closed by
+ * free_bindings() and pr_ipbind_close_listeners().  Returns -1 on error.
+ */
+int pr_ipbind_listen_epoll(void);
+
+/* Accepts all of the pending connections on the listeners which are reported
+ * ready by the epoll fd, calling the given callback for each accepted fd and
+ * its listener.  If accept(2) fails, e.g. with EMFILE, the listeners are
+ * re-armed after PR_TUNABLE_ACCEPT_RETRY_INTERVAL seconds, so that their
+ * pending connections are reported again.  Returns the number of connections
+ * accepted.
+ */
+int pr_ipbind_accept_conns(int (*cb)(int, conn_t *, void *), void *user_data);
+#endif /* PR_USE_EPOLL */
+
 /* Prepares the IP-based binding associated with the given server for listening.
  * Returns 0 on success, -1 on failure.
  */
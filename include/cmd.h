@@ -127,6 +127,38 @@ int pr_cmd_is_ssh2(cmd_rec *cmd);
 int pr_cmd_set_errno(cmd_rec *cmd, int xerrno);
 int pr_cmd_set_name(cmd_rec *cmd, const char *name);
 
+/* Command latency statistics.  Histograms of how long each command spends
+ * in each dispatch phase are kept in memory shared by the daemon and its
+ * session processes, once pr_cmd_stats_init() has been called.
+ */
+typedef struct {
+  uint64_t count;
+  uint64_t p50_usecs;
+  uint64_t p99_usecs;
+  uint64_t p999_usecs;
+  uint64_t max_usecs;
+} pr_cmd_stats_t;
+
+int pr_cmd_stats_init(void);
+int pr_cmd_stats_free(void);
+
+/* Records that the given command spent the given number of microseconds
+ * in the given phase (PRE_CMD, CMD, POST_CMD, LOG_CMD, or their _ERR
+ * variants, which are counted with their non-error phase).  Commands are
+ * only tracked if they are known FTP commands, or are handled by some
+ * module.
+ */
+int pr_cmd_stats_record(cmd_rec *cmd, int phase, uint64_t usecs);
+
+/* Returns the names of the commands for which statistics have been
+ * recorded, and the statistics for a given command and phase.  Reported
+ * latencies are the upper bounds of the histogram buckets holding them,
+ * which are within 25% of the actual values.
+ */
+array_header *pr_cmd_stats_get_cmds(pool *p);
+int pr_cmd_stats_get(const char *cmd_name, int phase, pr_cmd_stats_t *stats);
+int pr_cmd_stats_reset(void);
+
 /* Implemented in main.c */
 int pr_cmd_read(cmd_rec **cmd);
 int pr_cmd_dispatch(cmd_rec *cmd);
@@ -34,6 +34,12 @@
  */
 int pr_data_ignore_ascii(int);
 
+/* Toggles whether the data transfer buffer size is adapted, during the
+ * transfer, to the TCP metrics (RTT, congestion window) of the data
+ * connection.  Returns the previous setting.
+ */
+int pr_data_adaptive_bufsz(int);
+
 void pr_data_init(char *, int);
 void pr_data_cleanup(void);
 int pr_data_open(char *, char *, int, off_t);
@@ -77,4 +83,12 @@ typedef ssize_t pr_sendfile_t;
 
 pr_sendfile_t pr_data_sendfile(int retr_fd, off_t *offset, off_t count);
 
+/* Moves up to count bytes of uploaded data from the data connection directly
+ * into stor_fd, using splice(2) where available.  Returns the number of bytes
+ * stored, 0 on EOF, or -1 on error.  If the error was writing to stor_fd,
+ * stor_errno is set to that error.  ENOSYS means that splicing cannot be
+ * used, and that pr_data_xfer() should be used instead.
+ */
+int pr_data_splice(int stor_fd, size_t count, int *stor_errno);
+
 #endif /* PR_DATA_H */
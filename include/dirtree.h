@@ -219,10 +219,91 @@ int pr_config_get_server_xfer_bufsz(int);
 
 config_rec *dir_match_path(pool *, char *);
 void build_dyn_config(pool *, const char *, struct stat *, unsigned char);
+
+/* Checks for the .ftpaccess file at the given path, for the directory
+ * whose absolute path is given, reusing this session's previous check of
+ * that directory for up to PR_TUNABLE_DYN_CONFIG_MAX_AGE seconds.  Returns
+ * 0 and fills in the stat(2) data if the file exists, otherwise -1 with
+ * errno set.
+ */
+int pr_ftpaccess_stat(const char *dir_name, const char *path, struct stat *st);
+
+/* Returns TRUE if neither the directory's .ftpaccess file, as of its last
+ * check, nor any .ftpaccess config has changed since the directory's config
+ * was last marked as current, FALSE otherwise.
+ */
+int pr_ftpaccess_is_current(const char *dir_name);
+void pr_ftpaccess_set_current(const char *dir_name);
+
+/* Notes that some .ftpaccess config has been added, removed, or parsed. */
+void pr_ftpaccess_changed(void);
+
+/* Discards this session's .ftpaccess checks. */
+void pr_ftpaccess_clear(void);
+
+/* Results of matching a path against a <Directory> section. */
+#define DIR_MATCH_NONE		0
+#define DIR_MATCH_EXACT		1
+#define DIR_MATCH_GLOB		2
+
+/* Checks whether the given <Directory> section matches the path, returning
+ * one of the DIR_MATCH_ values.
+ */
+int pr_dir_match_entry(pool *p, config_rec *c, const char *path);
+
+/* Returns TRUE if the given section's path is a parent directory of the
+ * path, as far as reordering the sections is concerned.
+ */
+int pr_dir_is_parent(config_rec *c, const char *path, size_t pathlen);
+
+/* Index of the <Directory> sections in a large config set, kept by the set
+ * itself.
+ */
+typedef struct dir_index_rec pr_dir_index_t;
+
+/* Returns the set's index, building it if needed, or NULL (with errno set
+ * to ENOENT) if the set has fewer than PR_TUNABLE_DIR_INDEX_MIN sections.
+ */
+pr_dir_index_t *pr_dir_index_get(xaset_t *set);
+
+/* Returns the set's index only if it is current, otherwise NULL (with
+ * errno set to ENOENT).
+ */
+pr_dir_index_t *pr_dir_index_lookup(xaset_t *set);
+
+/* Finds the first <Directory> section in the indexed set matching the path,
+ * i.e. the same section as would be found by checking each section in turn,
+ * setting the DIR_MATCH_ value.
+ */
+config_rec *pr_dir_index_match_path(pool *p, pr_dir_index_t *idx,
+  const char *path, int *match);
+
+/* Returns the <Directory> sections in the indexed set which are parent
+ * directories of the path, in set order.
+ */
+array_header *pr_dir_index_get_parents(pool *p, pr_dir_index_t *idx,
+  char *path, size_t pathlen);
+
+/* Keep an index current, after the given section has been removed from its
+ * set, or inserted at the head of its set.  These must be called right
+ * after the set has changed; an index which cannot be updated is left to be
+ * rebuilt.
+ */
+void pr_dir_index_remove(pr_dir_index_t *idx, config_rec *c);
+void pr_dir_index_insert_head(pr_dir_index_t *idx, config_rec *c);
+
 unsigned char dir_hide_file(const char *);
 int dir_check_full(pool *, cmd_rec *, const char *, const char *, int *);
 int dir_check_limits(cmd_rec *, config_rec *, const char *, int);
 int dir_check(pool *, cmd_rec *, const char *, const char *, int *);
+
+/* Same as dir_check(), except that the caller provides the stat(2) data for
+ * the path, e.g. as already obtained while scanning its directory, rather
+ * than having it looked up again.  If the given struct stat is NULL, this
+ * behaves exactly like dir_check().
+ */
+int dir_check2(pool *, cmd_rec *, const char *, const char *, struct stat *,
+  int *);
 int dir_check_canon(pool *, cmd_rec *, const char *, const char *, int *);
 int is_dotdir(const char *);
 int login_check_limits(xaset_t *, int, int, int *);
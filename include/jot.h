@@ -183,6 +183,27 @@ int pr_jot_resolve_logfmt(pool *p, cmd_rec *cmd, pr_jot_filters_t *filters,
   int (*on_default)(pool *, pr_jot_ctx_t *, unsigned char),
   int (*on_other)(pool *, pr_jot_ctx_t *, unsigned char *, size_t));
 
+/* This opaque structure holds a LogFormat buffer compiled by
+ * pr_jot_compile_logfmt().
+ */
+typedef struct jot_compiled_rec pr_jot_compiled_t;
+
+/* Compiles the given LogFormat buffer, e.g. at configuration time, into a
+ * list of text and variable instructions, allocated from the given pool.
+ * Resolving a compiled LogFormat does not need to scan the buffer, or copy
+ * out variable arguments, for every event.
+ */
+pr_jot_compiled_t *pr_jot_compile_logfmt(pool *p, unsigned char *logfmt,
+  int flags);
+
+/* Same as pr_jot_resolve_logfmt(), for a compiled LogFormat. */
+int pr_jot_resolve_compiled_logfmt(pool *p, cmd_rec *cmd,
+  pr_jot_filters_t *filters, pr_jot_compiled_t *compiled, pr_jot_ctx_t *ctx,
+  int (*on_meta)(pool *, pr_jot_ctx_t *, unsigned char, const char *,
+    const void *),
+  int (*on_default)(pool *, pr_jot_ctx_t *, unsigned char),
+  int (*on_other)(pool *, pr_jot_ctx_t *, unsigned char *, size_t));
+
 /* Canned `on_meta` callback to use when resolving LogFormat strings into
  * JSON objects.
  */
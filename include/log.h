@@ -126,6 +126,24 @@ int pr_log_writefile(int, const char *, const char *, ...)
  */
 int pr_log_vwritefile(int, const char *, const char *, va_list ap);
 
+/* Writes the given, already formatted, log data to the fd.  If the Buffered
+ * LogOption is in effect, the data may instead be buffered, to be written
+ * out later along with other data for the same fd; see pr_log_flush().
+ * Callers using this function MUST flush the fd before closing it.
+ */
+int pr_log_writebuf(int fd, const char *buf, size_t buflen);
+
+/* Writes out any buffered log data for the given fd, or for all fds if
+ * the fd is -1.
+ */
+int pr_log_flush(int fd);
+
+/* Enables or disables the buffering done by pr_log_writebuf(), as per the
+ * Buffered LogOption.  Disabling buffering writes out any buffered data.
+ * Returns the previous setting.
+ */
+int pr_log_set_buffering(int enable);
+
 /* syslog-based logging functions.  Note that the open/close functions are
  * not part of the public API; use the pr_log_pri() function to log via
  * syslog.
@@ -223,12 +241,16 @@ int pr_log_event_listening(unsigned int log_type);
  */
 void pr_log_stacktrace(int fd, const char *name);
 
-/* Set options that affect the format of the logged messages. */
+/* Set options that affect the format of the logged messages, and how
+ * they are written.
+ */
 int pr_log_set_options(unsigned long log_opts);
+unsigned long pr_log_get_options(void);
 #define PR_LOG_OPT_USE_TIMESTAMP			0x0001
 #define PR_LOG_OPT_USE_HOSTNAME				0x0002
 #define PR_LOG_OPT_USE_VHOST				0x0004
 #define PR_LOG_OPT_USE_ROLE_BASED_PROCESS_LABELS	0x0008
+#define PR_LOG_OPT_USE_BUFFERING			0x0010
 #define PR_LOG_OPT_DEFAULT		(PR_LOG_OPT_USE_TIMESTAMP|PR_LOG_OPT_USE_HOSTNAME|PR_LOG_OPT_USE_VHOST)
 
 #endif /* PR_LOG_H */
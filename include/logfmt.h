@@ -93,4 +93,141 @@
 #define LOGFMT_META_ARG_END		254
 #define LOGFMT_META_START		255
 
+/* Binary LogFormat records.  A binary log starts with a header: the
+ * LOGFMT_BIN_MAGIC bytes, followed by the one-byte format version.  The
+ * header starts with a zero byte, and a record never has a length of zero,
+ * so readers can recognize a (repeated) header at any record boundary.
+ *
+ * Each record is a varint length, followed by that many bytes: a varint
+ * timestamp, in microseconds since the epoch, then any number of fields.
+ * Each field is a varint key, i.e. (LOGFMT_META_ ID << 3) | wire type,
+ * followed by its value as per the wire type.  Varints are unsigned,
+ * little-endian base-128 numbers.
+ */
+#define LOGFMT_BIN_MAGIC		"\0PRLOG"
+#define LOGFMT_BIN_MAGIC_LEN		6
+#define LOGFMT_BIN_VERSION		1
+
+/* A varint. */
+#define LOGFMT_BIN_WIRE_VARINT		0
+
+/* An IEEE 754 double, as 8 little-endian bytes. */
+#define LOGFMT_BIN_WIRE_DOUBLE		1
+
+/* A varint length, followed by that many bytes of text. */
+#define LOGFMT_BIN_WIRE_STRING		2
+
+/* Two strings, as above: the name (e.g. "ENV:HOME"), then the value. */
+#define LOGFMT_BIN_WIRE_NAMED_STRING	3
+
+/* No valid record can be larger than this. */
+#define LOGFMT_BIN_MAX_RECORD_SIZE	(1024 * 1024)
+
+#define LOGFMT_BIN_MAX_FIELDS		256
+
+/* The most bytes needed for the length of a record. */
+#define LOGFMT_BIN_LEN_RESERVE		3
+
+typedef struct {
+  unsigned char logfmt_id;
+  unsigned int wire_type;
+
+  /* For VARINT fields, both num and dbl are set; for DOUBLE fields, only
+   * dbl.  For string fields, text (and, for NAMED_STRING fields, name)
+   * point into the decoded data, and are not NUL-terminated.
+   */
+  uint64_t num;
+  double dbl;
+  const char *name;
+  size_t namelen;
+  const char *text;
+  size_t textlen;
+} pr_logfmt_field_t;
+
+typedef struct {
+  uint64_t usecs;
+  unsigned int nfields;
+  pr_logfmt_field_t fields[LOGFMT_BIN_MAX_FIELDS];
+} pr_logfmt_record_t;
+
+/* State for reading records from a binary log; zero it before the first
+ * read, and use pr_logfmt_bin_reader_free() once done.
+ */
+typedef struct {
+  FILE *fp;
+  int have_header;
+  unsigned char version;
+  unsigned char *buf;
+  size_t bufsz;
+} pr_logfmt_reader_t;
+
+/* Append the encoded value to the buffer, advancing the buffer pointer and
+ * reducing the remaining length.  Each value is appended in full, or not at
+ * all, in which case -1 is returned with errno set to ENOSPC.
+ */
+int pr_logfmt_bin_append_varint(char **buf, size_t *buflen, uint64_t num);
+int pr_logfmt_bin_append_key(char **buf, size_t *buflen,
+  unsigned char logfmt_id, unsigned int wire_type);
+int pr_logfmt_bin_append_string(char **buf, size_t *buflen, const char *text,
+  size_t text_len);
+
+/* Appends the key and value of a numeric field; integral non-negative
+ * values are written as VARINT fields, all others as DOUBLE fields.
+ */
+int pr_logfmt_bin_append_number(char **buf, size_t *buflen,
+  unsigned char logfmt_id, double num);
+int pr_logfmt_bin_append_header(char **buf, size_t *buflen);
+
+/* Writes the length of the record, encoded from reclen bytes at rec, into
+ * the room immediately before it; at least LOGFMT_BIN_LEN_RESERVE bytes
+ * must be available there.  Returns the start of the framed record, and
+ * its total length in framelen, or NULL (with errno set to EINVAL) if the
+ * record is empty or larger than LOGFMT_BIN_MAX_RECORD_SIZE.
+ */
+char *pr_logfmt_bin_frame_record(char *rec, size_t reclen, size_t *framelen);
+
+/* Decodes a varint from the given data, advancing the data pointer and
+ * reducing the remaining length.  Returns -1, with errno set to EBADMSG, if
+ * the varint is truncated or too long.
+ */
+int pr_logfmt_bin_decode_varint(const unsigned char **data, size_t *datalen,
+  uint64_t *num);
+
+/* Decodes the record data, i.e. that following the record length, into the
+ * given record.  Returns -1, with errno set to EBADMSG, if the data is
+ * malformed or truncated.
+ */
+int pr_logfmt_bin_decode_record(const unsigned char *data, size_t datalen,
+  pr_logfmt_record_t *rec);
+
+/* Returns the first field with the given ID, or NULL (with errno set to
+ * ENOENT) if the record has no such field.
+ */
+const pr_logfmt_field_t *pr_logfmt_bin_get_field(
+  const pr_logfmt_record_t *rec, unsigned char logfmt_id);
+
+/* Reads the next record, skipping any headers.  Returns 1 if a record was
+ * read, 0 at the end of the file, and -1 on error, with errno set to:
+ *
+ *  EINVAL   the file is not a binary log
+ *  ENOTSUP  the file uses a newer format version
+ *  E2BIG    the record length is corrupted
+ *  EIO      the last record is truncated, e.g. still being written
+ *  EBADMSG  the record is malformed; the next record can still be read
+ *  ENOMEM   the record buffer could not be allocated
+ */
+int pr_logfmt_bin_read_record(pr_logfmt_reader_t *reader,
+  pr_logfmt_record_t *rec);
+void pr_logfmt_bin_reader_free(pr_logfmt_reader_t *reader);
+
+/* Writes the record as a line of JSON, using the same keys as the Jot API. */
+int pr_logfmt_bin_write_json(FILE *outf, const pr_logfmt_record_t *rec);
+
+/* Writes the record as an xferlog(5) line.  Only transfers (and deletes) can
+ * be written this way; the record needs at least the %m (method) field for
+ * this, otherwise -1 is returned with errno set to ENOENT.  Missing fields
+ * get the values that the TransferLog would use.
+ */
+int pr_logfmt_bin_write_xferlog(FILE *outf, const pr_logfmt_record_t *rec);
+
 #endif /* PR_LOGFMT_H */
@@ -39,6 +39,22 @@
 
 #define PR_TUNABLE_SELECT_TIMEOUT	30
 
+/* The maximum number of idle session processes which the master daemon will
+ * spawn at once, when PreforkChildren is used and the pool of idle children
+ * has fallen below the configured minimum.
+ */
+#ifndef PR_TUNABLE_PREFORK_MAX_SPAWN
+# define PR_TUNABLE_PREFORK_MAX_SPAWN	32
+#endif /* PR_TUNABLE_PREFORK_MAX_SPAWN */
+
+/* The number of seconds the master daemon waits before trying again to
+ * accept connections on its listening sockets, after accept(2) has failed
+ * with an error such as EMFILE or ENFILE.  Only used with --enable-epoll.
+ */
+#ifndef PR_TUNABLE_ACCEPT_RETRY_INTERVAL
+# define PR_TUNABLE_ACCEPT_RETRY_INTERVAL	1
+#endif /* PR_TUNABLE_ACCEPT_RETRY_INTERVAL */
+
 /* Hash table size is the number of items in the module hash tables.
  */
 
@@ -102,6 +118,23 @@
 # define PR_TUNABLE_XFER_BUFFER_SIZE	PR_TUNABLE_BUFFER_SIZE
 #endif
 
+/* When adaptive transfer buffer sizing is enabled (see the
+ * "AdaptiveBufferSize" TransferOption), the data transfer buffer is resized
+ * within these bounds, based on the TCP_INFO metrics of the data connection
+ * sampled every PR_TUNABLE_XFER_BUFFER_SAMPLE_INTERVAL buffers.
+ */
+#ifndef PR_TUNABLE_XFER_BUFFER_MIN_SIZE
+# define PR_TUNABLE_XFER_BUFFER_MIN_SIZE	(4 * 1024)
+#endif
+
+#ifndef PR_TUNABLE_XFER_BUFFER_MAX_SIZE
+# define PR_TUNABLE_XFER_BUFFER_MAX_SIZE	(1024 * 1024)
+#endif
+
+#ifndef PR_TUNABLE_XFER_BUFFER_SAMPLE_INTERVAL
+# define PR_TUNABLE_XFER_BUFFER_SAMPLE_INTERVAL	16
+#endif
+
 /* Maximum FTP command size.  For details on this size of 512KB, see
  * the Bug#4014 discussion.
  */
@@ -167,6 +200,25 @@
 # define PR_TUNABLE_NEW_POOL_SIZE	512
 #endif
 
+/* Maximum number of bytes of freed pool blocks kept on the free lists for
+ * reuse.  Blocks freed beyond this limit are returned to the system, which
+ * keeps the memory footprint of long-lived session processes down.  Zero
+ * means no limit.
+ */
+
+#ifndef PR_TUNABLE_POOL_FREELIST_MAX_SIZE
+# define PR_TUNABLE_POOL_FREELIST_MAX_SIZE	(4 * 1024 * 1024)
+#endif
+
+/* Maximum number of distinct pool tags for which allocation counts are
+ * kept, across the pools created and destroyed over the life of a process.
+ * Pools with further tags are counted under "<other>".
+ */
+
+#ifndef PR_TUNABLE_POOL_TAG_STATS_MAX
+# define PR_TUNABLE_POOL_TAG_STATS_MAX	128
+#endif
+
 /* Number of bytes in certain scoreboard fields, usually for reporting
  * the full command received from the connected client, or the current
  * working directory for the session.
@@ -184,6 +236,25 @@
 # define PR_TUNABLE_SCOREBOARD_SCRUB_TIMER	30
 #endif
 
+/* Number of empty slots appended to the scoreboard file when a new session
+ * finds no free slot to claim.  Growing the file is the only time a session
+ * takes the ScoreboardMutex; slots are otherwise claimed and updated without
+ * locking.
+ */
+
+#ifndef PR_TUNABLE_SCOREBOARD_GROW_SLOTS
+# define PR_TUNABLE_SCOREBOARD_GROW_SLOTS	32
+#endif
+
+/* Number of distinct commands for which dispatch latency histograms are
+ * kept, in memory shared by the daemon and its sessions, for reporting via
+ * "ftpdctl stats".  Each command uses a few KB.
+ */
+
+#ifndef PR_TUNABLE_CMD_STATS_MAX_CMDS
+# define PR_TUNABLE_CMD_STATS_MAX_CMDS	128
+#endif
+
 /* Maximum number of attempted updates to the scoreboard during a
  * file transfer before an actual write is done.  This is to allow
  * an optimization where the scoreboard is not updated on every loop
@@ -194,6 +265,15 @@
 # define PR_TUNABLE_XFER_SCOREBOARD_UPDATES	10
 #endif
 
+/* Number of transfer buffers' worth of file data which mod_xfer asks the
+ * kernel to read ahead, asynchronously, while the current buffer is being
+ * written to the data connection for downloads which do not use sendfile(2).
+ * Set this to zero to disable the read-ahead.
+ */
+#ifndef PR_TUNABLE_XFER_READAHEAD_BUFFERS
+# define PR_TUNABLE_XFER_READAHEAD_BUFFERS	8
+#endif
+
 #ifndef PR_TUNABLE_CALLER_DEPTH
 /* Max depth of call stack if stacktrace support is enabled. */
 # define PR_TUNABLE_CALLER_DEPTH	32
@@ -254,4 +334,71 @@
 # define PR_TUNABLE_FS_STATCACHE_MAX_AGE	3
 #endif
 
+/* Config lookup index tuning.  Configuration sets with at least this many
+ * <Directory> sections, or this many entries, have an index built for
+ * matching paths and for finding directives by name, respectively, rather
+ * than being scanned linearly.
+ */
+#if !defined(PR_TUNABLE_DIR_INDEX_MIN)
+# define PR_TUNABLE_DIR_INDEX_MIN		16
+#endif
+
+#if !defined(PR_TUNABLE_CONFIG_INDEX_MIN)
+# define PR_TUNABLE_CONFIG_INDEX_MIN		32
+#endif
+
+/* .ftpaccess lookup tuning.  Within a session, the results of checking a
+ * directory for an .ftpaccess file, including there being none, are reused
+ * for this many seconds, and for at most this many directories.  Changes to
+ * an .ftpaccess file made outside of the session may thus not be seen for up
+ * to the max age.  A max age of zero disables this.
+ */
+#if !defined(PR_TUNABLE_DYN_CONFIG_MAX_AGE)
+# define PR_TUNABLE_DYN_CONFIG_MAX_AGE		3
+#endif
+
+#if !defined(PR_TUNABLE_DYN_CONFIG_MAX_DIRS)
+# define PR_TUNABLE_DYN_CONFIG_MAX_DIRS		1024
+#endif
+
+/* Buffered logging tuning.  With "LogOptions +Buffered", a session buffers
+ * up to this many bytes per log file, and writes out its buffered lines at
+ * least this often, in seconds.
+ */
+#if !defined(PR_TUNABLE_LOG_BUFFER_SIZE)
+# define PR_TUNABLE_LOG_BUFFER_SIZE		32768
+#endif
+
+#if !defined(PR_TUNABLE_LOG_BUFFER_FLUSH_INTERVAL)
+# define PR_TUNABLE_LOG_BUFFER_FLUSH_INTERVAL	1
+#endif
+
+/* mod_auth_file index tuning.  The daemon checks this often, in seconds,
+ * whether any indexed AuthUserFile/AuthGroupFile has changed and needs to be
+ * re-indexed.
+ */
+#if !defined(PR_TUNABLE_AUTH_FILE_INDEX_CHECK_INTERVAL)
+# define PR_TUNABLE_AUTH_FILE_INDEX_CHECK_INTERVAL	10
+#endif
+
+/* Number of bytes, for the key and the cached data, in each entry of the
+ * shared auth cache (see AuthSharedCache).  Results which do not fit, such as
+ * those for users with very many groups, are not shared.
+ */
+#if !defined(PR_TUNABLE_AUTH_SHARED_CACHE_ENTRY_SIZE)
+# define PR_TUNABLE_AUTH_SHARED_CACHE_ENTRY_SIZE	1024
+#endif
+
+/* How often, in seconds, the daemon stores the results which its sessions
+ * have sent for the shared auth cache.
+ */
+#if !defined(PR_TUNABLE_AUTH_SHARED_CACHE_UPDATE_INTERVAL)
+# define PR_TUNABLE_AUTH_SHARED_CACHE_UPDATE_INTERVAL	1
+#endif
+
+/* Default number of entries in the shared auth cache. */
+#if !defined(PR_TUNABLE_AUTH_SHARED_CACHE_SIZE)
+# define PR_TUNABLE_AUTH_SHARED_CACHE_SIZE	4096
+#endif
+
 #endif /* PR_OPTIONS_H */
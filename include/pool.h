@@ -45,6 +45,14 @@ typedef struct {
   unsigned long block_count;
   unsigned int subpool_count;
   unsigned long level;
+  unsigned long alloc_count;
+  unsigned long alloc_byte_count;
+
+  /* Per tag, for all pools with that tag, whether destroyed or not; uses
+   * the tag, alloc_count and alloc_byte_count fields as well.
+   */
+  int have_tag_info;
+  unsigned long pool_count;
 
   /* Free list */
   int have_freelist_info;
@@ -56,6 +64,7 @@ typedef struct {
   unsigned long total_byte_count;
   unsigned long total_blocks_allocated;
   unsigned long total_blocks_reused;
+  unsigned long total_blocks_released;
 } pr_pool_info_t;
 
 extern pool *permanent_pool;
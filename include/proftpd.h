@@ -209,6 +209,23 @@ typedef struct {
   /* Start/connect time of the session, in milliseconds since epoch. */
   uint64_t connect_time_ms;
 
+  /* Number of commands handled in this session, and the total time spent
+   * handling them, in milliseconds.
+   */
+  unsigned long total_cmds;
+  uint64_t total_cmd_ms;
+
+  /* Duration of the TLS/SSH handshake for the session, in milliseconds. */
+  unsigned long handshake_ms;
+
+  /* Time spent by data transfers in this session waiting on disk I/O,
+   * on network I/O, and sleeping for TransferRate throttling, in
+   * microseconds.
+   */
+  uint64_t total_disk_usecs;
+  uint64_t total_net_usecs;
+  uint64_t total_throttle_usecs;
+
 } session_t;
 
 /* Daemon identity values, defined in main.c */
@@ -29,7 +29,7 @@
 
 /* PR_SCOREBOARD_VERSION is used for checking for scoreboard compatibility
  */
-#define PR_SCOREBOARD_VERSION        		0x01040003
+#define PR_SCOREBOARD_VERSION        		0x01040005
 
 /* Structure used as a header for scoreboard files.
  */
@@ -55,6 +55,14 @@ typedef struct {
  */
 
 typedef struct {
+
+  /* Sequence counter for the entry.  The owning session process increments
+   * it before and after writing the slot, so that an odd value means the
+   * slot is being written; readers re-read the entry until they see the
+   * same even value on both sides of their copy.
+   */
+  unsigned long sce_seq;
+
   pid_t	sce_pid;
   uid_t sce_uid;
   gid_t sce_gid;
@@ -97,6 +105,20 @@ typedef struct {
   off_t sce_xfer_len;
   unsigned long sce_xfer_elapsed;
 
+  /* Cumulative counters for the session: bytes uploaded and downloaded,
+   * commands handled and the total time (in ms) spent handling them, the
+   * TLS/SSH handshake time, and the time (in ms) data transfers have spent
+   * waiting on disk I/O, on network I/O, and in TransferRate throttling.
+   */
+  off_t sce_bytes_in;
+  off_t sce_bytes_out;
+  unsigned long sce_cmd_count;
+  unsigned long sce_cmd_ms;
+  unsigned long sce_handshake_ms;
+  unsigned long sce_xfer_disk_ms;
+  unsigned long sce_xfer_net_ms;
+  unsigned long sce_xfer_throttle_ms;
+
 } pr_scoreboard_entry_t;
 
 /* Scoreboard mode */
@@ -120,6 +142,14 @@ typedef struct {
 #define PR_SCORE_XFER_LEN	15
 #define PR_SCORE_XFER_ELAPSED	16
 #define PR_SCORE_PROTOCOL	17
+#define PR_SCORE_BYTES_IN	18
+#define PR_SCORE_BYTES_OUT	19
+#define PR_SCORE_CMD_COUNT	20
+#define PR_SCORE_CMD_MS		21
+#define PR_SCORE_HANDSHAKE_MS	22
+#define PR_SCORE_XFER_DISK_MS	23
+#define PR_SCORE_XFER_NET_MS	24
+#define PR_SCORE_XFER_THROTTLE_MS	25
 
 /* Scoreboard error values */
 #define PR_SCORE_ERR_BAD_MAGIC		-2
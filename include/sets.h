@@ -34,6 +34,13 @@ typedef struct XAset xaset_t;
 typedef int (*XASET_COMPARE)(xasetmember_t *v1, xasetmember_t *v2);
 typedef xasetmember_t* (*XASET_MCOPY)(xasetmember_t *mem);
 
+/* Slots in a set's xas_indexes, for the indexes of its members which are
+ * built, for large sets, by the config and directory lookups.
+ */
+#define XASET_INDEX_CONFIG	0
+#define XASET_INDEX_DIR		1
+#define XASET_NINDEXES		2
+
 struct XAsetmember {
   xasetmember_t	*next, *prev;
 };
@@ -42,6 +49,18 @@ struct XAset {
   xasetmember_t *xas_list;
   struct pool_rec *pool;
   XASET_COMPARE xas_compare;
+
+  /* Stamp which changes whenever a member is inserted or removed.  Stamps
+   * are unique across all sets, so that callers caching data derived from a
+   * set can tell whether that data is still current.
+   */
+  unsigned long xas_gen;
+
+  /* Indexes of this set's members, owned by whoever built them.  Each index
+   * is allocated from a subpool of the set's pool, and so is freed along
+   * with the set; it is only current while xas_gen is unchanged.
+   */
+  void *xas_indexes[XASET_NINDEXES];
 };
 
 /* Prototypes */
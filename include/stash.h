@@ -51,6 +51,14 @@ int pr_stash_remove_cmd(const char *cmd_name, module *m,
 int pr_stash_remove_auth(const char *api_name, module *m);
 int pr_stash_remove_hook(const char *hook_name, module *m);
 
+/* Provides the CMD symbols registered for the given command and phase
+ * (cmd_type), in dispatch order.  If cmd_id is greater than zero, it MUST be
+ * the ID of cmd_name, as returned by pr_cmd_get_id().  The returned list is
+ * only valid until a CMD symbol is next added or removed.
+ */
+int pr_stash_get_cmd_handlers(const char *cmd_name, int cmd_id,
+  unsigned char cmd_type, cmdtable ***handlers, unsigned int *nhandlers);
+
 void pr_stash_dump(void (*)(const char *, ...));
 
 /* Internal use only */
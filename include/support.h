@@ -111,6 +111,11 @@ const char *pr_strtime2(time_t, int);
 const char *pr_strtime3(pool *, time_t, int);
 
 int pr_gettimeofday_millis(uint64_t *);
+
+/* Returns the current time in microseconds, e.g. for timing I/O calls which
+ * often take less than a millisecond.
+ */
+int pr_gettimeofday_micros(uint64_t *);
 int pr_timeval2millis(struct timeval *, uint64_t *);
 
 /* Wrappers around snprintf(3)/vsnprintf(3) which carefully check the
@@ -215,6 +215,26 @@ int pr_table_set(pr_table_t *tab, const char *key_data,
  *    Sets the maximum number of entries the table can hold.  Attempts to
  *    insert entries above this maximum result in an ENOSPC error value.
  *    The default maximum number of entries is currently 8192.
+ *
+ *  PR_TABLE_CTL_SET_BACKEND
+ *    Sets how the table stores its entries.  The arg parameter must be a
+ *    pointer to an int with one of the following values:
+ *
+ *      PR_TABLE_BACKEND_CHAINED
+ *        The default.  Entries are kept in a fixed number of chains (see
+ *        PR_TABLE_CTL_SET_NCHAINS), which get longer as the table grows.
+ *
+ *      PR_TABLE_BACKEND_OPEN_ADDR
+ *        Keys are kept in an array of slots using open addressing (Robin Hood
+ *        hashing), which is doubled in size as the table grows.  Entries
+ *        and keys are allocated in batches.  This backend is better suited
+ *        for tables which may hold many entries, e.g. for the lifetime of
+ *        a session.  The number of chains is used as the initial number of
+ *        slots.
+ *
+ *    Note that the ENT_INSERT and ENT_REMOVE callbacks are still used for
+ *    the open addressing backend, but the chains on which they operate
+ *    only hold the entries for a single key.
  */
 int pr_table_ctl(pr_table_t *tab, int cmd, void *arg);
 #define PR_TABLE_CTL_SET_ENT_INSERT	1
@@ -224,6 +244,11 @@ int pr_table_ctl(pr_table_t *tab, int cmd, void *arg);
 #define PR_TABLE_CTL_SET_KEY_HASH	5
 #define PR_TABLE_CTL_SET_NCHAINS	6
 #define PR_TABLE_CTL_SET_MAX_ENTS	7
+#define PR_TABLE_CTL_SET_BACKEND	8
+
+/* Table backends, for use with PR_TABLE_CTL_SET_BACKEND. */
+#define PR_TABLE_BACKEND_CHAINED	0
+#define PR_TABLE_BACKEND_OPEN_ADDR	1
 
 /* Returns the table "load", which is the ratio between the number of
  * entries in the table (e.g. via pr_table_count()) and the number of chains
@@ -60,6 +60,8 @@ static int TimeoutSession = 0;
 static int saw_first_user_cmd = FALSE;
 static const char *timing_channel = "timing";
 
+static int auth_shared_cache_timer_id = -1;
+
 static int auth_count_scoreboard(cmd_rec *, const char *);
 static int auth_scan_scoreboard(void);
 static int auth_sess_init(void);
@@ -112,6 +114,13 @@ static int auth_login_timeout_cb(CALLBACK_FRAME) {
   return 0;
 }
 
+static int auth_shared_cache_update_cb(CALLBACK_FRAME) {
+  (void) pr_auth_shared_cache_update();
+
+  /* Always restart the timer. */
+  return 1;
+}
+
 static int auth_session_timeout_cb(CALLBACK_FRAME) {
   pr_event_generate("core.timeout-session", NULL);
   pr_response_send_async(R_421,
@@ -136,6 +145,53 @@ static void auth_exit_ev(const void *event_data, void *user_data) {
   (void) pr_close_scoreboard(FALSE);
 }
 
+static void auth_postparse_ev(const void *event_data, void *user_data) {
+  config_rec *c;
+  unsigned int nentries;
+  int ttl, negative_ttl;
+
+  c = find_config(main_server->conf, CONF_PARAM, "AuthSharedCache", FALSE);
+  if (c == NULL ||
+      *((int *) c->argv[0]) == FALSE) {
+    return;
+  }
+
+  /* The cache is kept by the daemon; inetd-run sessions have none. */
+  if (ServerType != SERVER_STANDALONE) {
+    pr_log_debug(DEBUG3,
+      "AuthSharedCache only applies to 'ServerType standalone', ignoring");
+    return;
+  }
+
+  ttl = *((int *) c->argv[1]);
+  negative_ttl = *((int *) c->argv[2]);
+  nentries = *((unsigned int *) c->argv[3]);
+
+  if (pr_auth_shared_cache_init(nentries, ttl, negative_ttl) < 0) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "notice: unable to enable AuthSharedCache: %s", strerror(errno));
+    return;
+  }
+
+  auth_shared_cache_timer_id = pr_timer_add(
+    PR_TUNABLE_AUTH_SHARED_CACHE_UPDATE_INTERVAL, -1, &auth_module,
+    auth_shared_cache_update_cb, "AuthSharedCache update");
+}
+
+static void auth_restart_ev(const void *event_data, void *user_data) {
+  if (auth_shared_cache_timer_id != -1) {
+    pr_timer_remove(auth_shared_cache_timer_id, &auth_module);
+    auth_shared_cache_timer_id = -1;
+  }
+
+  (void) pr_auth_shared_cache_free();
+}
+
+static void auth_shutdown_ev(const void *event_data, void *user_data) {
+  /* Removes the shared cache, when the daemon exits. */
+  (void) pr_auth_shared_cache_free();
+}
+
 static void auth_sess_reinit_ev(const void *event_data, void *user_data) {
   int res;
 
@@ -177,6 +233,10 @@ static int auth_init(void) {
   /* By default, enable auth checking */
   set_auth_check(auth_cmd_chk_cb);
 
+  pr_event_register(&auth_module, "core.postparse", auth_postparse_ev, NULL);
+  pr_event_register(&auth_module, "core.restart", auth_restart_ev, NULL);
+  pr_event_register(&auth_module, "core.shutdown", auth_shutdown_ev, NULL);
+
   return 0;
 }
 
@@ -187,6 +247,16 @@ static int auth_sess_init(void) {
   pr_event_register(&auth_module, "core.session-reinit", auth_sess_reinit_ev,
     NULL);
 
+  /* Only the daemon stores shared cache results; the session only reads the
+   * cache, and sends its own results to the daemon.
+   */
+  if (auth_shared_cache_timer_id != -1) {
+    pr_timer_remove(auth_shared_cache_timer_id, &auth_module);
+    auth_shared_cache_timer_id = -1;
+  }
+
+  (void) pr_auth_shared_cache_sess_init();
+
   /* Check for any MaxPasswordSize. */
   c = find_config(main_server->conf, CONF_PARAM, "MaxPasswordSize", FALSE);
   if (c != NULL) {
@@ -261,6 +331,7 @@ static int auth_sess_init(void) {
         PR_SCORE_CLASS, session.conn_class ? session.conn_class->cls_name : "",
         PR_SCORE_PROTOCOL, "ftp",
         PR_SCORE_BEGIN_SESSION, time(NULL),
+        PR_SCORE_HANDSHAKE_MS, session.handshake_ms,
         NULL);
     }
 
@@ -1942,6 +2013,9 @@ static int setup_env(pool *p, cmd_rec *cmd, const char *user, char *pass) {
   /* Resolve any deferred-resolution paths in the FS layer */
   pr_resolve_fs_map();
 
+  /* From now on, this session no longer sends results to the shared cache. */
+  (void) pr_auth_shared_cache_login();
+
   return 1;
 
 auth_failure:
@@ -3150,6 +3224,72 @@ MODRET set_authaliasonly(cmd_rec *cmd) {
   return PR_HANDLED(cmd);
 }
 
+/* usage: AuthSharedCache on|off [ttl secs] [negative-ttl secs]
+ *          [size entries]
+ */
+MODRET set_authsharedcache(cmd_rec *cmd) {
+  register unsigned int i;
+  int enabled = -1, ttl = 60, negative_ttl = 10;
+  unsigned int nentries = PR_TUNABLE_AUTH_SHARED_CACHE_SIZE;
+  config_rec *c;
+
+  if (cmd->argc < 2 ||
+      (cmd->argc % 2) != 0) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  enabled = get_boolean(cmd, 1);
+  if (enabled == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
+
+  for (i = 2; i < cmd->argc; i += 2) {
+    char *ptr = NULL;
+    long val;
+
+    val = strtol(cmd->argv[i+1], &ptr, 10);
+    if (ptr == NULL ||
+        *ptr != '\0' ||
+        val < 0 ||
+        val > INT_MAX) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "invalid ", cmd->argv[i],
+        " value: ", cmd->argv[i+1], NULL));
+    }
+
+    if (strcasecmp(cmd->argv[i], "ttl") == 0) {
+      ttl = (int) val;
+
+    } else if (strcasecmp(cmd->argv[i], "negative-ttl") == 0) {
+      negative_ttl = (int) val;
+
+    } else if (strcasecmp(cmd->argv[i], "size") == 0) {
+      if (val == 0) {
+        CONF_ERROR(cmd, "size must be greater than zero");
+      }
+
+      nentries = (unsigned int) val;
+
+    } else {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown parameter: ",
+        cmd->argv[i], NULL));
+    }
+  }
+
+  c = add_config_param(cmd->argv[0], 4, NULL, NULL, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = enabled;
+  c->argv[1] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[1]) = ttl;
+  c->argv[2] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[2]) = negative_ttl;
+  c->argv[3] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[3]) = nentries;
+
+  return PR_HANDLED(cmd);
+}
+
 MODRET set_authusingalias(cmd_rec *cmd) {
   int bool = -1;
   config_rec *c = NULL;
@@ -4148,6 +4288,7 @@ static conftable auth_conftab[] = {
   { "AnonRequirePassword",	set_anonrequirepassword,	NULL },
   { "AnonRejectPasswords",	set_anonrejectpasswords,	NULL },
   { "AuthAliasOnly",		set_authaliasonly,		NULL },
+  { "AuthSharedCache",		set_authsharedcache,		NULL },
   { "AuthUsingAlias",		set_authusingalias,		NULL },
   { "CreateHome",		set_createhome,			NULL },
   { "DefaultChdir",		add_defaultchdir,		NULL },
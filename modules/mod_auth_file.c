@@ -26,6 +26,15 @@
 #include "conf.h"
 #include "privs.h"
 
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif /* HAVE_SYS_MMAN_H */
+
+#if defined(MAP_ANON) && \
+    !defined(MAP_ANONYMOUS)
+# define MAP_ANONYMOUS	MAP_ANON
+#endif
+
 /* AIX has some rather stupid function prototype inconsistencies between
  * their crypt.h and stdlib.h's setkey() declarations.
  */
@@ -40,6 +49,8 @@
 # error "ProFTPD 1.2.7rc2 or later required"
 #endif
 
+extern xaset_t *server_list;
+
 module auth_file_module;
 
 typedef union {
@@ -48,6 +59,62 @@ typedef union {
 
 } authfile_id_t;
 
+/* Indexed snapshot of an AuthUserFile/AuthGroupFile.  The entries, their
+ * strings, and the hash chains (by name, by ID, and for groups by member
+ * name) all live in a single anonymous mapping; chains are linked by entry
+ * index, in file order, and terminated by -1.
+ */
+struct af_index_pwent {
+  struct passwd pwd;
+  int name_next;
+  int id_next;
+};
+
+struct af_index_grent {
+  struct group grp;
+  int name_next;
+  int id_next;
+};
+
+struct af_index_member {
+  const char *name;
+  int grent_idx;
+  int next;
+};
+
+#define AF_INDEX_TYPE_USER	1
+#define AF_INDEX_TYPE_GROUP	2
+
+typedef struct index_rec {
+  struct index_rec *next;
+  int type;
+  const char *path;
+
+  /* The file as it was when indexed, for noticing changes. */
+  dev_t af_dev;
+  ino_t af_ino;
+  off_t af_size;
+  time_t af_mtime;
+
+  void *map;
+  size_t maplen;
+
+  unsigned int nbuckets;
+  int *name_buckets;
+  int *id_buckets;
+  int *member_buckets;
+
+  struct af_index_pwent *pwents;
+  unsigned int npwents;
+
+  struct af_index_grent *grents;
+  unsigned int ngrents;
+
+  struct af_index_member *members;
+  unsigned int nmembers;
+
+} authfile_index_t;
+
 typedef struct file_rec {
   char *af_path;
   pr_fh_t *af_file_fh;
@@ -71,6 +138,9 @@ typedef struct file_rec {
 
 #endif /* regex support */
 
+  /* The shared snapshot of this file, if any. */
+  authfile_index_t *af_index;
+
 } authfile_file_t;
 
 /* List of server-specific AuthFiles */
@@ -88,6 +158,15 @@ static unsigned long auth_file_opts = 0UL;
  */
 #define AUTH_FILE_OPT_SYNTAX_CHECK		0x0002
 
+/* Tell mod_auth_file not to index the configured files, and instead to read
+ * through them for every lookup.
+ */
+#define AUTH_FILE_OPT_NO_INDEX			0x0004
+
+static pool *af_index_pool = NULL;
+static authfile_index_t *af_indexes = NULL;
+static int af_index_timer_id = -1;
+
 static int handle_empty_salt = FALSE;
 
 static int authfile_sess_init(void);
@@ -485,6 +564,9 @@ static struct group *af_parse_grp(const char *buf, unsigned int lineno,
     *cp = '\0';
   }
 
+  /* A line with no member list must not see a previous line's. */
+  memset(grpfields, 0, sizeof(grpfields));
+
   for (cp = grpbuf, i = 0; i < NGRPFIELDS && cp; i++) {
     grpfields[i] = cp;
 
@@ -537,6 +619,466 @@ static struct group *af_parse_grp(const char *buf, unsigned int lineno,
   return &grent;
 }
 
+/* Indexed lookups.  Rather than reading through the AuthUserFile and
+ * AuthGroupFile for every lookup, the daemon parses each configured file
+ * once into an indexed snapshot.  Session processes inherit the snapshot
+ * copy-on-write, and since they only ever read it, its pages stay shared.
+ * A snapshot whose file has since changed is rebuilt, periodically by the
+ * daemon, and by a session process (for itself) on its next lookup.
+ */
+
+static unsigned int af_index_hash(const char *name) {
+  unsigned int hash = 5381;
+
+  while (*name) {
+    hash = ((hash << 5) + hash) + (unsigned char) *name++;
+  }
+
+  return hash;
+}
+
+static char *af_index_strdup(char **strs, const char *str) {
+  char *res;
+  size_t len;
+
+  len = strlen(str) + 1;
+  res = *strs;
+  memcpy(res, str, len);
+  *strs += len;
+
+  return res;
+}
+
+static void *af_index_map(size_t len) {
+  void *map;
+
+#if defined(HAVE_SYS_MMAN_H) && \
+    defined(MAP_ANONYMOUS)
+  map = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1,
+    0);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+#else
+  map = calloc(1, len);
+#endif /* HAVE_SYS_MMAN_H and MAP_ANONYMOUS */
+
+  return map;
+}
+
+static void af_index_unmap(authfile_index_t *idx) {
+  if (idx->map == NULL) {
+    return;
+  }
+
+#if defined(HAVE_SYS_MMAN_H) && \
+    defined(MAP_ANONYMOUS)
+  (void) munmap(idx->map, idx->maplen);
+#else
+  free(idx->map);
+#endif /* HAVE_SYS_MMAN_H and MAP_ANONYMOUS */
+
+  idx->map = NULL;
+  idx->maplen = 0;
+  idx->name_buckets = idx->id_buckets = idx->member_buckets = NULL;
+  idx->pwents = NULL;
+  idx->npwents = 0;
+  idx->grents = NULL;
+  idx->ngrents = 0;
+  idx->members = NULL;
+  idx->nmembers = 0;
+}
+
+/* Round up to the alignment needed for the next array in the mapping. */
+#define AF_INDEX_ALIGN(n)	(((n) + 15) & ~((size_t) 15))
+
+static char *af_index_read(authfile_index_t *idx, struct stat *st,
+    size_t *datalen) {
+  pr_fh_t *fh;
+  char *data;
+  size_t len = 0;
+  int xerrno;
+
+  PRIVS_ROOT
+  fh = pr_fsio_open(idx->path, O_RDONLY);
+  xerrno = errno;
+  PRIVS_RELINQUISH
+
+  if (fh == NULL) {
+    pr_trace_msg(trace_channel, 3, "unable to open '%s' for indexing: %s",
+      idx->path, strerror(xerrno));
+    errno = xerrno;
+    return NULL;
+  }
+
+  if (pr_fsio_fstat(fh, st) < 0) {
+    xerrno = errno;
+    pr_fsio_close(fh);
+    errno = xerrno;
+    return NULL;
+  }
+
+  data = malloc((size_t) st->st_size + 1);
+  if (data == NULL) {
+    pr_log_pri(PR_LOG_ALERT, "Out of memory!");
+    _exit(1);
+  }
+
+  while (len < (size_t) st->st_size) {
+    int res;
+
+    res = pr_fsio_read(fh, data + len, (size_t) st->st_size - len);
+    if (res < 0) {
+      xerrno = errno;
+
+      if (xerrno == EINTR) {
+        pr_signals_handle();
+        continue;
+      }
+
+      pr_fsio_close(fh);
+      free(data);
+      errno = xerrno;
+      return NULL;
+    }
+
+    if (res == 0) {
+      break;
+    }
+
+    len += res;
+  }
+
+  pr_fsio_close(fh);
+
+  data[len] = '\0';
+  *datalen = len;
+  return data;
+}
+
+static int af_index_build(authfile_index_t *idx) {
+  register unsigned int i;
+  struct stat st;
+  char *data, *line, *end, *map, *strs;
+  size_t datalen = 0, maplen, nlines = 1, ncommas = 0, off;
+  unsigned int lineno = 0, nbuckets = 16;
+  int flags = PR_AUTH_FILE_FL_USE_TRACE_LOG;
+  char **gr_mems = NULL;
+
+  data = af_index_read(idx, &st, &datalen);
+  if (data == NULL) {
+    return -1;
+  }
+
+  /* Size the mapping for the worst case: every line an entry, and every
+   * comma in a group file separating members.
+   */
+  for (i = 0; i < datalen; i++) {
+    if (data[i] == '\n') {
+      nlines++;
+
+    } else if (data[i] == ',') {
+      ncommas++;
+    }
+  }
+
+  while (nbuckets < nlines) {
+    nbuckets <<= 1;
+  }
+
+  if (idx->type == AF_INDEX_TYPE_USER) {
+    maplen = AF_INDEX_ALIGN(nlines * sizeof(struct af_index_pwent)) +
+      AF_INDEX_ALIGN(2 * nbuckets * sizeof(int));
+
+  } else {
+    maplen = AF_INDEX_ALIGN(nlines * sizeof(struct af_index_grent)) +
+      AF_INDEX_ALIGN((ncommas + nlines) * sizeof(struct af_index_member)) +
+      AF_INDEX_ALIGN((ncommas + (2 * nlines)) * sizeof(char *)) +
+      AF_INDEX_ALIGN(3 * nbuckets * sizeof(int));
+  }
+
+  maplen += datalen + (2 * nlines);
+
+  map = af_index_map(maplen);
+  if (map == NULL) {
+    int xerrno = errno;
+
+    pr_log_pri(PR_LOG_NOTICE, MOD_AUTH_FILE_VERSION
+      ": unable to map %lu bytes for indexing '%s': %s",
+      (unsigned long) maplen, idx->path, strerror(xerrno));
+    free(data);
+
+    errno = xerrno;
+    return -1;
+  }
+
+  af_index_unmap(idx);
+  idx->map = map;
+  idx->maplen = maplen;
+  idx->nbuckets = nbuckets;
+  idx->af_dev = st.st_dev;
+  idx->af_ino = st.st_ino;
+  idx->af_size = st.st_size;
+  idx->af_mtime = st.st_mtime;
+
+  off = 0;
+  if (idx->type == AF_INDEX_TYPE_USER) {
+    idx->pwents = (struct af_index_pwent *) map;
+    off += AF_INDEX_ALIGN(nlines * sizeof(struct af_index_pwent));
+
+    idx->name_buckets = (int *) (map + off);
+    idx->id_buckets = idx->name_buckets + nbuckets;
+    off += AF_INDEX_ALIGN(2 * nbuckets * sizeof(int));
+
+  } else {
+    idx->grents = (struct af_index_grent *) map;
+    off += AF_INDEX_ALIGN(nlines * sizeof(struct af_index_grent));
+
+    idx->members = (struct af_index_member *) (map + off);
+    off += AF_INDEX_ALIGN((ncommas + nlines) * sizeof(struct af_index_member));
+
+    gr_mems = (char **) (map + off);
+    off += AF_INDEX_ALIGN((ncommas + (2 * nlines)) * sizeof(char *));
+
+    idx->name_buckets = (int *) (map + off);
+    idx->id_buckets = idx->name_buckets + nbuckets;
+    idx->member_buckets = idx->id_buckets + nbuckets;
+    off += AF_INDEX_ALIGN(3 * nbuckets * sizeof(int));
+  }
+
+  strs = map + off;
+
+  end = data + datalen;
+  line = data;
+  while (line < end) {
+    char *eol;
+
+    pr_signals_handle();
+
+    eol = memchr(line, '\n', end - line);
+    if (eol != NULL) {
+      *eol = '\0';
+    }
+
+    lineno++;
+
+    /* Ignore empty and comment lines */
+    if (line[0] != '\0' &&
+        line[0] != '#') {
+
+      if (idx->type == AF_INDEX_TYPE_USER) {
+        struct passwd *pwd;
+
+        pwd = af_parse_passwd(line, lineno, flags);
+        if (pwd != NULL) {
+          struct passwd *ent;
+
+          ent = &(idx->pwents[idx->npwents++].pwd);
+          ent->pw_name = af_index_strdup(&strs, pwd->pw_name);
+          ent->pw_passwd = af_index_strdup(&strs, pwd->pw_passwd);
+          ent->pw_uid = pwd->pw_uid;
+          ent->pw_gid = pwd->pw_gid;
+          ent->pw_gecos = af_index_strdup(&strs, pwd->pw_gecos);
+          ent->pw_dir = af_index_strdup(&strs, pwd->pw_dir);
+          ent->pw_shell = af_index_strdup(&strs, pwd->pw_shell);
+        }
+
+      } else {
+        struct group *grp;
+
+        grp = af_parse_grp(line, lineno, flags);
+        if (grp != NULL) {
+          struct group *ent;
+          char **mems;
+
+          ent = &(idx->grents[idx->ngrents].grp);
+          ent->gr_name = af_index_strdup(&strs, grp->gr_name);
+          ent->gr_passwd = af_index_strdup(&strs,
+            grp->gr_passwd ? grp->gr_passwd : "");
+          ent->gr_gid = grp->gr_gid;
+          ent->gr_mem = gr_mems;
+
+          for (mems = grp->gr_mem; *mems; mems++) {
+            struct af_index_member *member;
+
+            member = &(idx->members[idx->nmembers++]);
+            member->name = *gr_mems = af_index_strdup(&strs, *mems);
+            member->grent_idx = idx->ngrents;
+            gr_mems++;
+          }
+
+          *gr_mems++ = NULL;
+          idx->ngrents++;
+        }
+      }
+    }
+
+    if (eol == NULL) {
+      break;
+    }
+
+    line = eol + 1;
+  }
+
+  free(data);
+
+  /* Link the hash chains, back to front, so that each chain lists its
+   * entries in file order, as a scan of the file would find them.
+   */
+  for (i = 0; i < nbuckets; i++) {
+    idx->name_buckets[i] = idx->id_buckets[i] = -1;
+    if (idx->member_buckets != NULL) {
+      idx->member_buckets[i] = -1;
+    }
+  }
+
+  if (idx->type == AF_INDEX_TYPE_USER) {
+    for (i = idx->npwents; i > 0; i--) {
+      struct af_index_pwent *ent;
+      unsigned int bucket;
+
+      ent = &(idx->pwents[i-1]);
+
+      bucket = af_index_hash(ent->pwd.pw_name) & (nbuckets - 1);
+      ent->name_next = idx->name_buckets[bucket];
+      idx->name_buckets[bucket] = i-1;
+
+      bucket = ((unsigned int) ent->pwd.pw_uid) & (nbuckets - 1);
+      ent->id_next = idx->id_buckets[bucket];
+      idx->id_buckets[bucket] = i-1;
+    }
+
+    pr_trace_msg(trace_channel, 8, "indexed %u users from AuthUserFile '%s'",
+      idx->npwents, idx->path);
+
+  } else {
+    for (i = idx->ngrents; i > 0; i--) {
+      struct af_index_grent *ent;
+      unsigned int bucket;
+
+      ent = &(idx->grents[i-1]);
+
+      bucket = af_index_hash(ent->grp.gr_name) & (nbuckets - 1);
+      ent->name_next = idx->name_buckets[bucket];
+      idx->name_buckets[bucket] = i-1;
+
+      bucket = ((unsigned int) ent->grp.gr_gid) & (nbuckets - 1);
+      ent->id_next = idx->id_buckets[bucket];
+      idx->id_buckets[bucket] = i-1;
+    }
+
+    for (i = idx->nmembers; i > 0; i--) {
+      struct af_index_member *member;
+      unsigned int bucket;
+
+      member = &(idx->members[i-1]);
+
+      bucket = af_index_hash(member->name) & (nbuckets - 1);
+      member->next = idx->member_buckets[bucket];
+      idx->member_buckets[bucket] = i-1;
+    }
+
+    pr_trace_msg(trace_channel, 8,
+      "indexed %u groups (%u memberships) from AuthGroupFile '%s'",
+      idx->ngrents, idx->nmembers, idx->path);
+  }
+
+  return 0;
+}
+
+/* Returns TRUE if the indexed file has been changed (or removed) since it
+ * was indexed.
+ */
+static int af_index_changed(authfile_index_t *idx) {
+  struct stat st;
+
+  if (pr_fsio_stat(idx->path, &st) < 0) {
+    return (errno == ENOENT);
+  }
+
+  if (st.st_dev != idx->af_dev ||
+      st.st_ino != idx->af_ino ||
+      st.st_size != idx->af_size ||
+      st.st_mtime != idx->af_mtime) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Returns the usable snapshot for the given file, if any.  Once chrooted,
+ * the configured path no longer names the indexed file, so the snapshot is
+ * used as is.
+ */
+static authfile_index_t *af_index_get(authfile_file_t *file) {
+  authfile_index_t *idx;
+
+  if (file == NULL ||
+      file->af_index == NULL) {
+    return NULL;
+  }
+
+  idx = file->af_index;
+
+  if (session.chroot_path == NULL &&
+      af_index_changed(idx) == TRUE) {
+    pr_trace_msg(trace_channel, 5, "'%s' has changed, re-indexing",
+      idx->path);
+
+    if (af_index_build(idx) < 0) {
+      af_index_unmap(idx);
+    }
+  }
+
+  if (idx->map == NULL) {
+    return NULL;
+  }
+
+  return idx;
+}
+
+static authfile_index_t *af_index_add(int type, const char *path) {
+  authfile_index_t *idx;
+
+  for (idx = af_indexes; idx; idx = idx->next) {
+    if (idx->type == type &&
+        strcmp(idx->path, path) == 0) {
+      return idx;
+    }
+  }
+
+  idx = pcalloc(af_index_pool, sizeof(authfile_index_t));
+  idx->type = type;
+  idx->path = pstrdup(af_index_pool, path);
+
+  if (af_index_build(idx) < 0) {
+    pr_log_debug(DEBUG3, MOD_AUTH_FILE_VERSION
+      ": unable to index '%s', reading it for each lookup instead: %s", path,
+      strerror(errno));
+    return NULL;
+  }
+
+  idx->next = af_indexes;
+  af_indexes = idx;
+
+  return idx;
+}
+
+static void af_index_clear(void) {
+  authfile_index_t *idx;
+
+  for (idx = af_indexes; idx; idx = idx->next) {
+    af_index_unmap(idx);
+  }
+
+  af_indexes = NULL;
+
+  if (af_index_pool != NULL) {
+    destroy_pool(af_index_pool);
+    af_index_pool = NULL;
+  }
+}
+
 static int af_allow_grent(pool *p, struct group *grp) {
   if (af_group_file == NULL) {
     errno = EPERM;
@@ -681,6 +1223,25 @@ static struct group *af_getgrent(pool *p, int flags,
 static struct group *af_getgrnam(pool *p, const char *name) {
   struct group *grp = NULL;
   int flags = PR_AUTH_FILE_FL_USE_TRACE_LOG;
+  authfile_index_t *idx;
+
+  idx = af_index_get(af_group_file);
+  if (idx != NULL) {
+    int i;
+
+    i = idx->name_buckets[af_index_hash(name) & (idx->nbuckets - 1)];
+    for (; i >= 0; i = idx->grents[i].name_next) {
+      grp = &(idx->grents[i].grp);
+
+      if (strcmp(name, grp->gr_name) == 0 &&
+          af_allow_grent(p, grp) == 0) {
+        grent = *grp;
+        return &grent;
+      }
+    }
+
+    return NULL;
+  }
 
   if (af_setgrent(p) < 0) {
     return NULL;
@@ -704,6 +1265,25 @@ static struct group *af_getgrnam(pool *p, const char *name) {
 static struct group *af_getgrgid(pool *p, gid_t gid) {
   struct group *grp = NULL;
   int flags = PR_AUTH_FILE_FL_USE_TRACE_LOG;
+  authfile_index_t *idx;
+
+  idx = af_index_get(af_group_file);
+  if (idx != NULL) {
+    int i;
+
+    i = idx->id_buckets[((unsigned int) gid) & (idx->nbuckets - 1)];
+    for (; i >= 0; i = idx->grents[i].id_next) {
+      grp = &(idx->grents[i].grp);
+
+      if (grp->gr_gid == gid &&
+          af_allow_grent(p, grp) == 0) {
+        grent = *grp;
+        return &grent;
+      }
+    }
+
+    return NULL;
+  }
 
   if (af_setgrent(p) < 0) {
     return NULL;
@@ -942,6 +1522,25 @@ static struct passwd *af_getpwent(pool *p, int flags,
 static struct passwd *af_getpwnam(pool *p, const char *name) {
   struct passwd *pwd = NULL;
   int flags = PR_AUTH_FILE_FL_USE_TRACE_LOG;
+  authfile_index_t *idx;
+
+  idx = af_index_get(af_user_file);
+  if (idx != NULL) {
+    int i;
+
+    i = idx->name_buckets[af_index_hash(name) & (idx->nbuckets - 1)];
+    for (; i >= 0; i = idx->pwents[i].name_next) {
+      pwd = &(idx->pwents[i].pwd);
+
+      if (strcmp(name, pwd->pw_name) == 0 &&
+          af_allow_pwent(p, pwd) == 0) {
+        pwent = *pwd;
+        return &pwent;
+      }
+    }
+
+    return NULL;
+  }
 
   if (af_setpwent(p) < 0) {
     return NULL;
@@ -970,6 +1569,25 @@ static char *af_getpwpass(pool *p, const char *name) {
 static struct passwd *af_getpwuid(pool *p, uid_t uid) {
   struct passwd *pwd = NULL;
   int flags = PR_AUTH_FILE_FL_USE_TRACE_LOG;
+  authfile_index_t *idx;
+
+  idx = af_index_get(af_user_file);
+  if (idx != NULL) {
+    int i;
+
+    i = idx->id_buckets[((unsigned int) uid) & (idx->nbuckets - 1)];
+    for (; i >= 0; i = idx->pwents[i].id_next) {
+      pwd = &(idx->pwents[i].pwd);
+
+      if (pwd->pw_uid == uid &&
+          af_allow_pwent(p, pwd) == 0) {
+        pwent = *pwd;
+        return &pwent;
+      }
+    }
+
+    return NULL;
+  }
 
   if (af_setpwent(p) < 0) {
     return NULL;
@@ -1169,24 +1787,8 @@ MODRET authfile_getpwent(cmd_rec *cmd) {
 MODRET authfile_getpwnam(cmd_rec *cmd) {
   struct passwd *pwd = NULL;
   const char *name = cmd->argv[0];
-  int flags = PR_AUTH_FILE_FL_USE_TRACE_LOG;
 
-  if (af_setpwent(cmd->tmp_pool) < 0) {
-    return PR_DECLINED(cmd);
-  }
-
-  /* Ugly -- we iterate through the file.  Time-consuming. */
-  pwd = af_getpwent(cmd->tmp_pool, flags, NULL);
-  while (pwd != NULL) {
-    pr_signals_handle();
-
-    if (strcmp(name, pwd->pw_name) == 0) {
-      /* Found the requested name */
-      break;
-    }
-
-    pwd = af_getpwent(cmd->tmp_pool, flags, NULL);
-  }
+  pwd = af_getpwnam(cmd->tmp_pool, name);
 
   return pwd ? mod_create_data(cmd, pwd) : PR_DECLINED(cmd);
 }
@@ -1195,10 +1797,6 @@ MODRET authfile_getpwuid(cmd_rec *cmd) {
   struct passwd *pwd = NULL;
   uid_t uid = *((uid_t *) cmd->argv[0]);
 
-  if (af_setpwent(cmd->tmp_pool) < 0) {
-    return PR_DECLINED(cmd);
-  }
-
   pwd = af_getpwuid(cmd->tmp_pool, uid);
 
   return pwd ? mod_create_data(cmd, pwd) : PR_DECLINED(cmd);
@@ -1207,10 +1805,6 @@ MODRET authfile_getpwuid(cmd_rec *cmd) {
 MODRET authfile_name2uid(cmd_rec *cmd) {
   struct passwd *pwd = NULL;
 
-  if (af_setpwent(cmd->tmp_pool) < 0) {
-    return PR_DECLINED(cmd);
-  }
-
   pwd = af_getpwnam(cmd->tmp_pool, cmd->argv[0]);
 
   return pwd ? mod_create_data(cmd, (void *) &pwd->pw_uid) : PR_DECLINED(cmd);
@@ -1227,10 +1821,6 @@ MODRET authfile_setpwent(cmd_rec *cmd) {
 MODRET authfile_uid2name(cmd_rec *cmd) {
   struct passwd *pwd = NULL;
 
-  if (af_setpwent(cmd->tmp_pool) < 0) {
-    return PR_DECLINED(cmd);
-  }
-
   pwd = af_getpwuid(cmd->tmp_pool, *((uid_t *) cmd->argv[0]));
 
   return pwd ? mod_create_data(cmd, pwd->pw_name) : PR_DECLINED(cmd);
@@ -1254,10 +1844,6 @@ MODRET authfile_getgrgid(cmd_rec *cmd) {
   struct group *grp = NULL;
   gid_t gid = *((gid_t *) cmd->argv[0]);
 
-  if (af_setgrent(cmd->tmp_pool) < 0) {
-    return PR_DECLINED(cmd);
-  }
-
   grp = af_getgrgid(cmd->tmp_pool, gid);
 
   return grp ? mod_create_data(cmd, grp) : PR_DECLINED(cmd);
@@ -1266,25 +1852,9 @@ MODRET authfile_getgrgid(cmd_rec *cmd) {
 MODRET authfile_getgrnam(cmd_rec *cmd) {
   struct group *grp = NULL;
   const char *name;
-  int flags = PR_AUTH_FILE_FL_USE_TRACE_LOG;
-
-  if (af_setgrent(cmd->tmp_pool) < 0) {
-    return PR_DECLINED(cmd);
-  }
 
   name = cmd->argv[0];
-
-  grp = af_getgrent(cmd->tmp_pool, flags, NULL);
-  while (grp != NULL) {
-    pr_signals_handle();
-
-    if (strcmp(name, grp->gr_name) == 0) {
-      /* Found the name requested */
-      break;
-    }
-
-    grp = af_getgrent(cmd->tmp_pool, flags, NULL);
-  }
+  grp = af_getgrnam(cmd->tmp_pool, name);
 
   return grp ? mod_create_data(cmd, grp) : PR_DECLINED(cmd);
 }
@@ -1295,16 +1865,14 @@ MODRET authfile_getgroups(cmd_rec *cmd) {
   array_header *gids = NULL, *groups = NULL;
   char *name = cmd->argv[0];
   int flags = PR_AUTH_FILE_FL_USE_TRACE_LOG;
+  authfile_index_t *idx;
 
   if (name == NULL) {
     return PR_DECLINED(cmd);
   }
 
-  if (af_setpwent(cmd->tmp_pool) < 0) {
-    return PR_DECLINED(cmd);
-  }
-
-  if (af_setgrent(cmd->tmp_pool) < 0) {
+  if (af_index_get(af_group_file) == NULL &&
+      af_setgrent(cmd->tmp_pool) < 0) {
     return PR_DECLINED(cmd);
   }
 
@@ -1336,12 +1904,43 @@ MODRET authfile_getgroups(cmd_rec *cmd) {
     }
   }
 
-  (void) af_setgrent(cmd->tmp_pool);
+  idx = af_index_get(af_group_file);
+  if (idx != NULL) {
+    int i;
+
+    i = idx->member_buckets[af_index_hash(pwd->pw_name) & (idx->nbuckets - 1)];
+    for (; i >= 0; i = idx->members[i].next) {
+      pr_signals_handle();
+
+      if (strcmp(idx->members[i].name, pwd->pw_name) != 0) {
+        continue;
+      }
+
+      grp = &(idx->grents[idx->members[i].grent_idx].grp);
+      if (af_allow_grent(cmd->tmp_pool, grp) < 0) {
+        continue;
+      }
+
+      if (gids != NULL) {
+        *((gid_t *) push_array(gids)) = grp->gr_gid;
+      }
+
+      if (groups != NULL) {
+        *((char **) push_array(groups)) = pstrdup(session.pool, grp->gr_name);
+      }
+    }
+
+    grp = NULL;
+
+  } else {
+    (void) af_setgrent(cmd->tmp_pool);
+
+    /* This is where things get slow, expensive, and ugly.  Loop through
+     * everything, checking to make sure we haven't already added it.
+     */
+    grp = af_getgrent(cmd->tmp_pool, flags, NULL);
+  }
 
-  /* This is where things get slow, expensive, and ugly.  Loop through
-   * everything, checking to make sure we haven't already added it.
-   */
-  grp = af_getgrent(cmd->tmp_pool, flags, NULL);
   while (grp != NULL &&
          grp->gr_mem) {
     char **gr_mems = NULL;
@@ -1384,10 +1983,6 @@ MODRET authfile_getgroups(cmd_rec *cmd) {
 MODRET authfile_gid2name(cmd_rec *cmd) {
   struct group *grp = NULL;
 
-  if (af_setgrent(cmd->tmp_pool) < 0) {
-    return PR_DECLINED(cmd);
-  }
-
   grp = af_getgrgid(cmd->tmp_pool, *((gid_t *) cmd->argv[0]));
 
   return grp ? mod_create_data(cmd, grp->gr_name) : PR_DECLINED(cmd);
@@ -1396,10 +1991,6 @@ MODRET authfile_gid2name(cmd_rec *cmd) {
 MODRET authfile_name2gid(cmd_rec *cmd) {
   struct group *grp = NULL;
 
-  if (af_setgrent(cmd->tmp_pool) < 0) {
-    return PR_DECLINED(cmd);
-  }
-
   grp = af_getgrnam(cmd->tmp_pool, cmd->argv[0]);
 
   return grp ? mod_create_data(cmd, (void *) &grp->gr_gid) : PR_DECLINED(cmd);
@@ -1417,10 +2008,6 @@ MODRET authfile_auth(cmd_rec *cmd) {
   char *tmp = NULL, *cleartxt_pass = NULL;
   const char *name = cmd->argv[0];
 
-  if (af_setpwent(cmd->tmp_pool) < 0) {
-    return PR_DECLINED(cmd);
-  }
-
   /* Lookup the cleartxt password for this user. */
   tmp = af_getpwpass(cmd->tmp_pool, name);
   if (tmp == NULL) {
@@ -1626,6 +2213,12 @@ MODRET set_authfileoptions(cmd_rec *cmd) {
        */
       auth_file_opts |= AUTH_FILE_OPT_INSECURE_PERMS;
 
+    } else if (strcmp(cmd->argv[i], "NoIndex") == 0) {
+      /* The files are indexed once the configuration has been parsed, so
+       * this option is also global.
+       */
+      auth_file_opts |= AUTH_FILE_OPT_NO_INDEX;
+
     } else if (strcmp(cmd->argv[i], "SyntaxCheck") == 0) {
 
       /* Note that this option enables some parse-time checks, so we need
@@ -1972,6 +2565,90 @@ static void authfile_sess_reinit_ev(const void *event_data, void *user_data) {
   }
 }
 
+static int authfile_index_refresh_cb(CALLBACK_FRAME) {
+  authfile_index_t *idx;
+
+  for (idx = af_indexes; idx; idx = idx->next) {
+    pr_signals_handle();
+
+    if (af_index_changed(idx) == TRUE) {
+      pr_log_debug(DEBUG5, MOD_AUTH_FILE_VERSION ": re-indexing '%s'",
+        idx->path);
+
+      if (af_index_build(idx) < 0) {
+        pr_log_debug(DEBUG3, MOD_AUTH_FILE_VERSION
+          ": unable to re-index '%s': %s", idx->path, strerror(errno));
+        af_index_unmap(idx);
+      }
+    }
+  }
+
+  return 1;
+}
+
+#if defined(PR_SHARED_MODULE)
+static void authfile_mod_unload_ev(const void *event_data, void *user_data) {
+  if (strcmp("mod_auth_file.c", (const char *) event_data) == 0) {
+    pr_event_unregister(&auth_file_module, NULL, NULL);
+
+    if (af_index_timer_id != -1) {
+      pr_timer_remove(af_index_timer_id, &auth_file_module);
+      af_index_timer_id = -1;
+    }
+
+    af_index_clear();
+  }
+}
+#endif /* PR_SHARED_MODULE */
+
+static void authfile_postparse_ev(const void *event_data, void *user_data) {
+  server_rec *s;
+
+  if (auth_file_opts & AUTH_FILE_OPT_NO_INDEX) {
+    return;
+  }
+
+  if (af_index_pool == NULL) {
+    af_index_pool = make_sub_pool(permanent_pool);
+    pr_pool_tag(af_index_pool, MOD_AUTH_FILE_VERSION);
+  }
+
+  for (s = (server_rec *) server_list->xas_list; s; s = s->next) {
+    config_rec *c;
+    authfile_file_t *file;
+
+    c = find_config(s->conf, CONF_PARAM, "AuthUserFile", FALSE);
+    if (c != NULL) {
+      file = c->argv[0];
+      file->af_index = af_index_add(AF_INDEX_TYPE_USER, file->af_path);
+    }
+
+    c = find_config(s->conf, CONF_PARAM, "AuthGroupFile", FALSE);
+    if (c != NULL) {
+      file = c->argv[0];
+      file->af_index = af_index_add(AF_INDEX_TYPE_GROUP, file->af_path);
+    }
+  }
+
+  if (af_indexes != NULL) {
+    af_index_timer_id = pr_timer_add(PR_TUNABLE_AUTH_FILE_INDEX_CHECK_INTERVAL,
+      -1, &auth_file_module, authfile_index_refresh_cb,
+      "AuthUserFile/AuthGroupFile index refresh");
+  }
+}
+
+static void authfile_restart_ev(const void *event_data, void *user_data) {
+  if (af_index_timer_id != -1) {
+    pr_timer_remove(af_index_timer_id, &auth_file_module);
+    af_index_timer_id = -1;
+  }
+
+  af_index_clear();
+
+  /* The options are re-read from the new configuration. */
+  auth_file_opts = 0UL;
+}
+
 /* Initialization routines
  */
 
@@ -2002,12 +2679,29 @@ static int authfile_init(void) {
     }
   }
 
+#if defined(PR_SHARED_MODULE)
+  pr_event_register(&auth_file_module, "core.module-unload",
+    authfile_mod_unload_ev, NULL);
+#endif /* PR_SHARED_MODULE */
+  pr_event_register(&auth_file_module, "core.postparse",
+    authfile_postparse_ev, NULL);
+  pr_event_register(&auth_file_module, "core.restart", authfile_restart_ev,
+    NULL);
+
   return 0;
 }
 
 static int authfile_sess_init(void) {
   config_rec *c = NULL;
 
+  /* Only the daemon process refreshes the indexes on a timer; a session
+   * notices changes on its own lookups.
+   */
+  if (af_index_timer_id != -1) {
+    pr_timer_remove(af_index_timer_id, &auth_file_module);
+    af_index_timer_id = -1;
+  }
+
   pr_event_register(&auth_file_module, "core.session-reinit",
     authfile_sess_reinit_ev, NULL);
 
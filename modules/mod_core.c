@@ -39,6 +39,8 @@ extern xaset_t *server_list;
 /* From src/main.c */
 extern unsigned long max_connects;
 extern unsigned int max_connect_interval;
+extern unsigned int prefork_min_spare;
+extern unsigned int prefork_max_spare;
 
 /* From modules/mod_site.c */
 extern modret_t *site_dispatch(cmd_rec*);
@@ -1084,6 +1086,46 @@ MODRET set_maxconnrate(cmd_rec *cmd) {
   return PR_HANDLED(cmd);
 }
 
+/* usage: PreforkChildren "off"|min-spare [max-spare] */
+MODRET set_preforkchildren(cmd_rec *cmd) {
+  int min_spare = 0, max_spare = 0;
+  char *endp = NULL;
+
+  if (cmd->argc-1 < 1 ||
+      cmd->argc-1 > 2) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  if (cmd->argc-1 == 1 &&
+      strcasecmp(cmd->argv[1], "off") == 0) {
+    prefork_min_spare = prefork_max_spare = 0;
+    return PR_HANDLED(cmd);
+  }
+
+  min_spare = strtol(cmd->argv[1], &endp, 10);
+  if ((endp && *endp) ||
+      min_spare < 1) {
+    CONF_ERROR(cmd, "min-spare must be 'off' or a number greater than 0");
+  }
+
+  max_spare = min_spare;
+
+  /* If the optional max-spare parameter is given, parse it. */
+  if (cmd->argc-1 == 2) {
+    max_spare = strtol(cmd->argv[2], &endp, 10);
+    if ((endp && *endp) ||
+        max_spare < min_spare) {
+      CONF_ERROR(cmd, "max-spare must be a number not less than min-spare");
+    }
+  }
+
+  prefork_min_spare = min_spare;
+  prefork_max_spare = max_spare;
+
+  return PR_HANDLED(cmd);
+}
+
 MODRET set_timeoutidle(cmd_rec *cmd) {
   int timeout = -1;
   config_rec *c = NULL;
@@ -7409,6 +7451,7 @@ static conftable core_conftab[] = {
   { "PathAllowFilter",		set_pathallowfilter,		NULL },
   { "PathDenyFilter",		set_pathdenyfilter,		NULL },
   { "PidFile",			set_pidfile,	 		NULL },
+  { "PreforkChildren",		set_preforkchildren,		NULL },
   { "Port",			set_port, 			NULL },
   { "ProcessTitles",		set_processtitles,		NULL },
   { "Protocols",		set_protocols,			NULL },
@@ -49,8 +49,15 @@ struct logformat_struc {
 
   char *lf_fmt_name;
   unsigned char	*lf_format;
+  pr_jot_compiled_t *lf_jot_format;
+  unsigned long lf_flags;
 };
 
+/* Write records using the binary format from include/logfmt.h, rather than
+ * as text.
+ */
+#define LOGFORMAT_FL_BINARY	0x0001
+
 struct logfile_struc {
   logfile_t		*next, *prev;
 
@@ -137,7 +144,7 @@ static int log_sess_init(void);
 static void log_xfer_stalled_ev(const void *, void *);
 
 static void parse_logformat(const char *directive, char *fmt_name,
-    char *fmt_text) {
+    char *fmt_text, unsigned long fmt_flags) {
   int res;
   pool *tmp_pool;
   pr_jot_ctx_t *jot_ctx;
@@ -173,10 +180,14 @@ static void parse_logformat(const char *directive, char *fmt_name,
 
   lf = (logformat_t *) pcalloc(log_pool, sizeof(logformat_t));
   lf->lf_fmt_name = pstrdup(log_pool, fmt_name);
+  lf->lf_flags = fmt_flags;
   lf->lf_format = palloc(log_pool, fmt_len + 1);
   memcpy(lf->lf_format, format_buf, fmt_len);
   lf->lf_format[fmt_len] = '\0';
 
+  /* Compile the format now, rather than scanning it for every event. */
+  lf->lf_jot_format = pr_jot_compile_logfmt(log_pool, lf->lf_format, 0);
+
   if (format_set == NULL) {
     format_set = xaset_create(log_pool, NULL);
   }
@@ -203,16 +214,32 @@ static void parse_logformat(const char *directive, char *fmt_name,
   destroy_pool(tmp_pool);
 }
 
-/* Syntax: LogFormat name "format string" */
+/* Syntax: LogFormat name "format string" [text|binary] */
 MODRET set_logformat(cmd_rec *cmd) {
-  CHECK_ARGS(cmd, 2);
+  unsigned long fmt_flags = 0;
+
+  if (cmd->argc < 3 ||
+      cmd->argc > 4) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
   CHECK_CONF(cmd, CONF_ROOT|CONF_GLOBAL);
 
   if (strlen(cmd->argv[1]) == 0) {
     CONF_ERROR(cmd, "missing required name parameter");
   }
 
-  parse_logformat(cmd->argv[0], cmd->argv[1], cmd->argv[2]);
+  if (cmd->argc == 4) {
+    if (strcasecmp(cmd->argv[3], "binary") == 0) {
+      fmt_flags |= LOGFORMAT_FL_BINARY;
+
+    } else if (strcasecmp(cmd->argv[3], "text") != 0) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unknown LogFormat mode: ",
+        (char *) cmd->argv[3], NULL));
+    }
+  }
+
+  parse_logformat(cmd->argv[0], cmd->argv[1], cmd->argv[2], fmt_flags);
   return PR_HANDLED(cmd);
 }
 
@@ -276,6 +303,17 @@ MODRET set_logoptions(cmd_rec *cmd) {
           break;
       }
 
+    } else if (strcasecmp(opt, "Buffered") == 0) {
+      switch (action) {
+        case '-':
+          log_opts &= ~PR_LOG_OPT_USE_BUFFERING;
+          break;
+
+        case '+':
+          log_opts |= PR_LOG_OPT_USE_BUFFERING;
+          break;
+      }
+
     } else if (strcasecmp(opt, "RoleBasedProcessLabels") == 0) {
       switch (action) {
         case '-':
@@ -731,32 +769,202 @@ static int resolve_on_other(pool *p, pr_jot_ctx_t *jot_ctx,
   return 0;
 }
 
+/* Binary LogFormat records; see include/logfmt.h for the layout, and
+ * src/logfmt.c for the encoding.  Each field is encoded in full, or not at
+ * all; fields which do not fit are dropped.
+ */
+static int resolve_on_meta_binary(pool *p, pr_jot_ctx_t *jot_ctx,
+    unsigned char logfmt_id, const char *jot_hint, const void *val) {
+  int res;
+  struct extlog_buffer *log;
+  char *start;
+  size_t startlen;
+
+  log = jot_ctx->log;
+  start = log->buf;
+  startlen = log->buflen;
+
+  switch (logfmt_id) {
+    case LOGFMT_META_BYTES_SENT:
+    case LOGFMT_META_EPOCH:
+    case LOGFMT_META_FILE_OFFSET:
+    case LOGFMT_META_FILE_SIZE:
+    case LOGFMT_META_GID:
+    case LOGFMT_META_LOCAL_PORT:
+    case LOGFMT_META_MICROSECS:
+    case LOGFMT_META_MILLISECS:
+    case LOGFMT_META_PID:
+    case LOGFMT_META_RAW_BYTES_IN:
+    case LOGFMT_META_RAW_BYTES_OUT:
+    case LOGFMT_META_REMOTE_PORT:
+    case LOGFMT_META_RESPONSE_CODE:
+    case LOGFMT_META_RESPONSE_MS:
+    case LOGFMT_META_SECONDS:
+    case LOGFMT_META_UID:
+    case LOGFMT_META_XFER_MS:
+    case LOGFMT_META_XFER_PORT:
+      res = pr_logfmt_bin_append_number(&(log->buf), &(log->buflen),
+        logfmt_id, *((double *) val));
+      break;
+
+    case LOGFMT_META_CONNECT:
+    case LOGFMT_META_DISCONNECT:
+    case LOGFMT_META_FILE_MODIFIED:
+      res = pr_logfmt_bin_append_key(&(log->buf), &(log->buflen), logfmt_id,
+        LOGFMT_BIN_WIRE_VARINT);
+      if (res == 0) {
+        res = pr_logfmt_bin_append_varint(&(log->buf), &(log->buflen),
+          *((int *) val) ? 1 : 0);
+      }
+      break;
+
+    default: {
+      const char *text;
+
+      text = val;
+      if (jot_hint != NULL) {
+        res = pr_logfmt_bin_append_key(&(log->buf), &(log->buflen),
+          logfmt_id, LOGFMT_BIN_WIRE_NAMED_STRING);
+        if (res == 0) {
+          res = pr_logfmt_bin_append_string(&(log->buf), &(log->buflen),
+            jot_hint, strlen(jot_hint));
+        }
+
+      } else {
+        res = pr_logfmt_bin_append_key(&(log->buf), &(log->buflen),
+          logfmt_id, LOGFMT_BIN_WIRE_STRING);
+      }
+
+      if (res == 0) {
+        res = pr_logfmt_bin_append_string(&(log->buf), &(log->buflen), text,
+          strlen(text));
+      }
+      break;
+    }
+  }
+
+  if (res < 0) {
+    pr_trace_msg(trace_channel, 9,
+      "dropping %s field from binary record: buffer full",
+      pr_jot_get_logfmt_id_name(logfmt_id));
+    log->buf = start;
+    log->buflen = startlen;
+  }
+
+  return 0;
+}
+
+/* Binary records omit missing values, and literal format text, entirely. */
+static int resolve_on_default_binary(pool *p, pr_jot_ctx_t *jot_ctx,
+    unsigned char logfmt_id) {
+  return 0;
+}
+
+static int resolve_on_other_binary(pool *p, pr_jot_ctx_t *jot_ctx,
+    unsigned char *text, size_t text_len) {
+  return 0;
+}
+
+static void log_event_binary(cmd_rec *cmd, logfile_t *lf) {
+  int res;
+  char logbuf[EXTENDED_LOG_BUFFER_SIZE];
+  logformat_t *fmt;
+  pool *tmp_pool;
+  pr_jot_ctx_t jot_ctx;
+  struct extlog_buffer log;
+  struct timeval tv;
+  uint64_t now_usecs;
+  size_t framelen;
+  char *frame;
+
+  fmt = lf->lf_format;
+
+  /* Leave room at the front of the buffer for the record length varint. */
+  tmp_pool = make_sub_pool(cmd->tmp_pool);
+  memset(&jot_ctx, 0, sizeof(jot_ctx));
+  log.bufsz = log.buflen = sizeof(logbuf) - LOGFMT_BIN_LEN_RESERVE;
+  log.ptr = log.buf = logbuf + LOGFMT_BIN_LEN_RESERVE;
+
+  jot_ctx.log = &log;
+
+  (void) gettimeofday(&tv, NULL);
+  now_usecs = ((uint64_t) tv.tv_sec * 1000000) + tv.tv_usec;
+  (void) pr_logfmt_bin_append_varint(&(log.buf), &(log.buflen), now_usecs);
+
+  if (fmt->lf_jot_format != NULL) {
+    res = pr_jot_resolve_compiled_logfmt(tmp_pool, cmd, lf->lf_jot_filters,
+      fmt->lf_jot_format, &jot_ctx, resolve_on_meta_binary,
+      resolve_on_default_binary, resolve_on_other_binary);
+
+  } else {
+    res = pr_jot_resolve_logfmt(tmp_pool, cmd, lf->lf_jot_filters,
+      fmt->lf_format, &jot_ctx, resolve_on_meta_binary,
+      resolve_on_default_binary, resolve_on_other_binary);
+  }
+
+  if (res < 0) {
+    if (errno != EPERM) {
+      pr_log_pri(PR_LOG_NOTICE, MOD_LOG_VERSION
+        ": error formatting ExtendedLog record: %s", strerror(errno));
+    }
+
+    destroy_pool(tmp_pool);
+    return;
+  }
+
+  frame = pr_logfmt_bin_frame_record(log.ptr, log.bufsz - log.buflen,
+    &framelen);
+  if (frame == NULL) {
+    pr_log_pri(PR_LOG_NOTICE, MOD_LOG_VERSION
+      ": error framing ExtendedLog record: %s", strerror(errno));
+    destroy_pool(tmp_pool);
+    return;
+  }
+
+  if (pr_log_writebuf(lf->lf_fd, frame, framelen) < 0) {
+    pr_log_pri(PR_LOG_ALERT, "error: cannot write ExtendedLog '%s': %s",
+      lf->lf_filename, strerror(errno));
+  }
+
+  destroy_pool(tmp_pool);
+}
+
 /* from src/log.c */
 extern int syslog_sockfd;
 
 static void log_event(cmd_rec *cmd, logfile_t *lf) {
   int res;
-  unsigned char *f = NULL;
-  char logbuf[EXTENDED_LOG_BUFFER_SIZE] = {'\0'};
+  char logbuf[EXTENDED_LOG_BUFFER_SIZE];
   logformat_t *fmt = NULL;
   size_t logbuflen;
   pool *tmp_pool;
-  pr_jot_ctx_t *jot_ctx;
-  struct extlog_buffer *log;
+  pr_jot_ctx_t jot_ctx;
+  struct extlog_buffer log;
 
   fmt = lf->lf_format;
-  f = fmt->lf_format;
+  if (fmt->lf_flags & LOGFORMAT_FL_BINARY) {
+    log_event_binary(cmd, lf);
+    return;
+  }
 
   tmp_pool = make_sub_pool(cmd->tmp_pool);
-  jot_ctx = pcalloc(tmp_pool, sizeof(pr_jot_ctx_t));
-  log = pcalloc(tmp_pool, sizeof(struct extlog_buffer));
-  log->bufsz = log->buflen = sizeof(logbuf) - 1;
-  log->ptr = log->buf = logbuf;
+  memset(&jot_ctx, 0, sizeof(jot_ctx));
+  log.bufsz = log.buflen = sizeof(logbuf) - 1;
+  log.ptr = log.buf = logbuf;
+
+  jot_ctx.log = &log;
 
-  jot_ctx->log = log;
+  if (fmt->lf_jot_format != NULL) {
+    res = pr_jot_resolve_compiled_logfmt(tmp_pool, cmd, lf->lf_jot_filters,
+      fmt->lf_jot_format, &jot_ctx, resolve_on_meta, resolve_on_default,
+      resolve_on_other);
+
+  } else {
+    res = pr_jot_resolve_logfmt(tmp_pool, cmd, lf->lf_jot_filters,
+      fmt->lf_format, &jot_ctx, resolve_on_meta, resolve_on_default,
+      resolve_on_other);
+  }
 
-  res = pr_jot_resolve_logfmt(tmp_pool, cmd, lf->lf_jot_filters, f, jot_ctx,
-    resolve_on_meta, resolve_on_default, resolve_on_other);
   if (res < 0) {
     /* EPERM indicates that the event was filtered, thus is not necessarily
      * an unexpected condition.
@@ -770,14 +978,14 @@ static void log_event(cmd_rec *cmd, logfile_t *lf) {
     return;
   }
 
-  extlog_buffer_append(log, "\n", 1);
-  logbuflen = (log->bufsz - log->buflen);
+  extlog_buffer_append(&log, "\n", 1);
+  logbuflen = (log.bufsz - log.buflen);
+  logbuf[logbuflen] = '\0';
 
   if (lf->lf_fd != EXTENDED_LOG_SYSLOG) {
     pr_log_event_generate(PR_LOG_TYPE_EXTLOG, lf->lf_fd, -1, logbuf, logbuflen);
 
-    /* What about short writes? */
-    if (write(lf->lf_fd, logbuf, logbuflen) < 0) {
+    if (pr_log_writebuf(lf->lf_fd, logbuf, logbuflen) < 0) {
       pr_log_pri(PR_LOG_ALERT, "error: cannot write ExtendedLog '%s': %s",
         lf->lf_filename, strerror(errno));
     }
@@ -909,7 +1117,7 @@ static void log_restart_ev(const void *event_data, void *user_data) {
   log_pool = make_sub_pool(permanent_pool);
   pr_pool_tag(log_pool, "mod_log pool");
 
-  parse_logformat(NULL, "", "%h %l %u %t \"%r\" %s %b");
+  parse_logformat(NULL, "", "%h %l %u %t \"%r\" %s %b", 0);
 }
 
 static void log_sess_reinit_ev(const void *event_data, void *user_data) {
@@ -929,6 +1137,7 @@ static void log_sess_reinit_ev(const void *event_data, void *user_data) {
     if (lf->lf_fd > -1) {
       /* No need to close the special EXTENDED_LOG_SYSLOG (i.e. fake) fd. */
       if (lf->lf_fd != EXTENDED_LOG_SYSLOG) {
+        (void) pr_log_flush(lf->lf_fd);
         (void) close(lf->lf_fd);
       }
 
@@ -964,7 +1173,7 @@ static int log_init(void) {
   pr_pool_tag(log_pool, "mod_log pool");
 
   /* Add the "default" extendedlog format */
-  parse_logformat(NULL, "", "%h %l %u %t \"%r\" %s %b");
+  parse_logformat(NULL, "", "%h %l %u %t \"%r\" %s %b", 0);
 
   pr_event_register(&log_module, "core.postparse", log_postparse_ev, NULL);
   pr_event_register(&log_module, "core.restart", log_restart_ev, NULL);
@@ -1111,6 +1320,7 @@ MODRET log_post_pass(cmd_rec *cmd) {
           lf->lf_conf->config_type == CONF_ANON) {
         pr_log_debug(DEBUG7, "mod_log: closing ExtendedLog '%s' (fd %d)",
           lf->lf_filename, lf->lf_fd);
+        (void) pr_log_flush(lf->lf_fd);
         (void) close(lf->lf_fd);
         lf->lf_fd = -1;
       }
@@ -1127,6 +1337,7 @@ MODRET log_post_pass(cmd_rec *cmd) {
           lf->lf_conf != session.anon_config) {
         pr_log_debug(DEBUG7, "mod_log: closing ExtendedLog '%s' (fd %d)",
           lf->lf_filename, lf->lf_fd);
+        (void) pr_log_flush(lf->lf_fd);
         (void) close(lf->lf_fd);
         lf->lf_fd = -1;
       }
@@ -1150,6 +1361,7 @@ MODRET log_post_pass(cmd_rec *cmd) {
               strcmp(lfi->lf_filename, lf->lf_filename) == 0) {
             pr_log_debug(DEBUG7, "mod_log: closing ExtendedLog '%s' (fd %d)",
               lf->lf_filename, lfi->lf_fd);
+            (void) pr_log_flush(lfi->lf_fd);
             (void) close(lfi->lf_fd);
             lfi->lf_fd = -1;
           }
@@ -1159,6 +1371,7 @@ MODRET log_post_pass(cmd_rec *cmd) {
         if (lf->lf_fd != -1 &&
             lf->lf_fd != EXTENDED_LOG_SYSLOG &&
             pr_jot_filters_include_classes(lf->lf_jot_filters, CL_NONE) == TRUE) {
+          (void) pr_log_flush(lf->lf_fd);
           (void) close(lf->lf_fd);
           lf->lf_fd = -1;
         }
@@ -1169,6 +1382,30 @@ MODRET log_post_pass(cmd_rec *cmd) {
   return PR_DECLINED(cmd);
 }
 
+/* New (empty) binary logs start with the file header; appending to an
+ * existing log simply continues it.
+ */
+static void log_write_binary_header(logfile_t *lf) {
+  struct stat st;
+  char hdr[LOGFMT_BIN_MAGIC_LEN + 1], *ptr;
+  size_t hdrlen;
+
+  if (fstat(lf->lf_fd, &st) < 0 ||
+      !S_ISREG(st.st_mode) ||
+      st.st_size > 0) {
+    return;
+  }
+
+  ptr = hdr;
+  hdrlen = sizeof(hdr);
+  (void) pr_logfmt_bin_append_header(&ptr, &hdrlen);
+
+  if (write(lf->lf_fd, hdr, sizeof(hdr)) < 0) {
+    pr_log_pri(PR_LOG_NOTICE, "error writing header to ExtendedLog '%s': %s",
+      lf->lf_filename, strerror(errno));
+  }
+}
+
 /* Open all the log files */
 static int dispatched_connect = FALSE;
 
@@ -1306,8 +1543,16 @@ static int log_sess_init(void) {
             pr_log_pri(PR_LOG_WARNING, "unable to open ExtendedLog '%s': "
               "%s is a symbolic link", lf->lf_filename, lf->lf_filename);
           }
+
+        } else if (lf->lf_format->lf_flags & LOGFORMAT_FL_BINARY) {
+          log_write_binary_header(lf);
         }
 
+      } else if (lf->lf_format->lf_flags & LOGFORMAT_FL_BINARY) {
+        pr_log_pri(PR_LOG_NOTICE, "ExtendedLog '%s' cannot use binary "
+          "LogFormat '%s', ignoring", lf->lf_filename,
+          lf->lf_format->lf_fmt_name);
+
       } else {
         char *tmp = strchr(lf->lf_filename, ':');
 
@@ -28,6 +28,14 @@
 
 #include "conf.h"
 
+#if defined(LINUX) && defined(HAVE_STATX)
+# include <sys/syscall.h>
+# include <sys/sysmacros.h>
+# if defined(SYS_getdents64) && defined(STATX_BASIC_STATS)
+#  define LS_USE_STATX_SCAN
+# endif
+#endif /* LINUX and HAVE_STATX */
+
 #ifndef GLOB_ABORTED
 #define GLOB_ABORTED GLOB_ABEND
 #endif
@@ -41,7 +49,21 @@
 static void addfile(cmd_rec *, const char *, const char *, time_t, off_t);
 static int outputfiles(cmd_rec *);
 
-static int listfile(cmd_rec *, pool *, const char *, const char *);
+/* A directory entry, as read by sreaddir(), along with the lstat(2) data
+ * gathered for it during the same scan, so that the listing, hiding, and
+ * permission checks need not look up each entry again.
+ */
+struct ls_dirent {
+  struct stat st;
+
+  /* Zero if st holds the lstat(2) data for the entry, -1 if not. */
+  int st_res;
+
+  char *name;
+};
+
+static int listfile(cmd_rec *, pool *, const char *, const char *,
+  struct stat *);
 static int listdir(cmd_rec *, pool *, const char *, const char *);
 
 static int sendline(int flags, char *fmt, ...)
@@ -57,6 +79,7 @@ static int sendline(int flags, char *fmt, ...)
 #define LS_FL_NLST_ONLY			0x0004
 #define LS_FL_ADJUSTED_SYMLINKS		0x0008
 #define LS_FL_SORTED_NLST		0x0010
+#define LS_FL_UNSORTED_LIST		0x0020
 static unsigned long list_flags = 0UL;
 
 #define LS_LIST_STYLE_UNIX		1
@@ -68,6 +91,11 @@ static int list_style = LS_LIST_STYLE_UNIX;
  */
 #define LS_MAX_DSIZE			(1024 * 1024 * 8)
 
+/* Size of the buffer into which directory entries are read, in batches, when
+ * scanning a directory using getdents64(2).
+ */
+#define LS_SCAN_BUFSZ			(1024 * 64)
+
 static unsigned char list_strict_opts = FALSE;
 static char *list_options = NULL;
 static unsigned char list_show_symlinks = TRUE, list_times_gmt = TRUE;
@@ -270,7 +298,11 @@ static int ls_perms_full(pool *p, cmd_rec *cmd, const char *path, int *hidden) {
   return res;
 }
 
-static int ls_perms(pool *p, cmd_rec *cmd, const char *path, int *hidden) {
+/* The given struct stat, if not NULL, is the stat(2) data for the path,
+ * as already gathered by sreaddir().
+ */
+static int ls_perms(pool *p, cmd_rec *cmd, const char *path, struct stat *st,
+    int *hidden) {
   int res = 0;
   char fullpath[PR_TUNABLE_PATH_MAX + 1] = {'\0'};
   mode_t *fake_mode = NULL;
@@ -292,7 +324,7 @@ static int ls_perms(pool *p, cmd_rec *cmd, const char *path, int *hidden) {
     pr_fs_clean_path(path, fullpath, PR_TUNABLE_PATH_MAX);
   }
 
-  res = dir_check(p, cmd, cmd->group, fullpath, hidden);
+  res = dir_check2(p, cmd, cmd->group, fullpath, st, hidden);
 
   if (session.dir_config) {
     unsigned char *ptr;
@@ -463,10 +495,13 @@ static char months[12][4] =
   { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
     "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
 
+/* The given struct stat, if not NULL, is the lstat(2) data for the name
+ * already gathered by sreaddir().
+ */
 static int listfile(cmd_rec *cmd, pool *p, const char *resp_code,
-    const char *name) {
+    const char *name, struct stat *pst) {
   register unsigned int i;
-  int rval = 0, len;
+  int rval = 0, len, res;
   time_t sort_time;
   char m[PR_TUNABLE_PATH_MAX+1] = {'\0'}, l[PR_TUNABLE_PATH_MAX+1] = {'\0'}, s[16] = {'\0'};
   struct stat st;
@@ -514,8 +549,16 @@ static int listfile(cmd_rec *cmd, pool *p, const char *resp_code,
     p = cmd->tmp_pool;
   }
 
-  pr_fs_clear_cache2(name);
-  if (pr_fsio_lstat(name, &st) == 0) {
+  if (pst != NULL) {
+    memcpy(&st, pst, sizeof(struct stat));
+    res = 0;
+
+  } else {
+    pr_fs_clear_cache2(name);
+    res = pr_fsio_lstat(name, &st);
+  }
+
+  if (res == 0) {
     char *display_name = NULL;
 
     suffix[0] = suffix[1] = '\0';
@@ -616,7 +659,7 @@ static int listfile(cmd_rec *cmd, pool *p, const char *resp_code,
       /* First see if the symlink itself is hidden e.g. by HideFiles
        * (see Bug#3924).
        */
-      if (!ls_perms(p, cmd, name, &hidden)) {
+      if (!ls_perms(p, cmd, name, NULL, &hidden)) {
         return 0;
       }
 
@@ -651,7 +694,7 @@ static int listfile(cmd_rec *cmd, pool *p, const char *resp_code,
         return 0;
       }
 
-    } else if (!ls_perms(p, cmd, name, &hidden)) {
+    } else if (!ls_perms(p, cmd, name, pst, &hidden)) {
       return 0;
     }
 
@@ -1217,19 +1260,334 @@ static void discard_output(void) {
 }
 
 static int dircmp(const void *a, const void *b) {
+  const struct ls_dirent *ent1, *ent2;
+
+  ent1 = *((const struct ls_dirent **) a);
+  ent2 = *((const struct ls_dirent **) b);
+
 #if defined(PR_USE_NLS) && defined(HAVE_STRCOLL)
-  return strcoll(*(const char **)a, *(const char **)b);
+  return strcoll(ent1->name, ent2->name);
 #else
-  return strcmp(*(const char **)a, *(const char **)b);
+  return strcmp(ent1->name, ent2->name);
 #endif /* !PR_USE_NLS or !HAVE_STRCOLL */
 }
 
-static char **sreaddir(const char *dirname, const int sort) {
-  DIR *d;
+/* Appends a copy of the given entry to the list being built, growing the
+ * list as necessary.
+ */
+static void add_dirent(struct ls_dirent ***dir, size_t *dsize, size_t count,
+    const struct ls_dirent *src) {
+  struct ls_dirent *ent;
+  size_t namelen;
+
+  if (count >= *dsize - 1) {
+    struct ls_dirent **newp;
+
+    /* The test above goes off one item early in case this is the last item
+     * in the directory and thus next time we will want to NULL-terminate
+     * the array.
+     */
+    pr_log_debug(DEBUG0, "Reallocating sreaddir buffer from %lu entries to "
+      "%lu entries", (unsigned long) *dsize, (unsigned long) *dsize * 2);
+
+    /* Allocate bigger array for pointers to entries */
+    pr_trace_msg("data", 8, "allocating readdir buffer of %lu bytes",
+      (unsigned long) (2 * *dsize * sizeof(struct ls_dirent *)));
+
+    newp = (struct ls_dirent **) realloc(*dir,
+      2 * *dsize * sizeof(struct ls_dirent *));
+    if (newp == NULL) {
+      pr_log_pri(PR_LOG_ALERT, "Out of memory!");
+      exit(1);
+    }
+    *dir = newp;
+    *dsize *= 2;
+  }
+
+  namelen = strlen(src->name);
+  ent = calloc(1, sizeof(struct ls_dirent) + namelen + 1);
+  if (ent == NULL) {
+    pr_log_pri(PR_LOG_ALERT, "Out of memory!");
+    exit(1);
+  }
+
+  memcpy(&(ent->st), &(src->st), sizeof(struct stat));
+  ent->st_res = src->st_res;
+  ent->name = (char *) (ent + 1);
+  memcpy(ent->name, src->name, namelen);
+
+  (*dir)[count] = ent;
+}
+
+/* Returns TRUE if the metadata for the given entry will be needed, i.e. if
+ * listdir()/nlstdir() will not skip the entry outright as a dotfile.
+ */
+static int want_dirent_stat(const char *name) {
+  if (*name == '.' &&
+      !opt_a &&
+      (!opt_A || is_dotdir(name))) {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* State for reading the entries of a directory, one at a time. */
+struct ls_dirscan {
+  const char *dirname;
+
+  /* The current entry, as returned by next_dirent(). */
+  struct ls_dirent ent;
+
+  /* For reading the directory via the FSIO API. */
+  void *dirh;
+
+#ifdef LS_USE_STATX_SCAN
+  /* For reading the directory directly, via getdents64(2)/statx(2). */
+  int dir_fd;
+  char *buf;
+  long buflen, bufoff;
+  unsigned int mask;
+#endif /* LS_USE_STATX_SCAN */
+
+  unsigned long nents, nstats;
+  int xerrno;
+};
+
+#ifdef LS_USE_STATX_SCAN
+struct ls_linux_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+/* The statx(2) fields needed for the listing options in effect.  The mode,
+ * owner and group are always needed, for the HideNoAccess/HideUser/HideGroup
+ * and <Limit> checks.
+ */
+static unsigned int scan_statx_mask(void) {
+  unsigned int mask = STATX_TYPE|STATX_MODE|STATX_UID|STATX_GID;
+
+  if (opt_l ||
+      list_style == LS_LIST_STYLE_WINDOWS) {
+    return mask|STATX_BASIC_STATS;
+  }
+
+  if (opt_S) {
+    mask |= STATX_SIZE;
+  }
+
+  if (opt_t) {
+    switch (ls_sort_by) {
+      case LS_SORT_BY_CTIME:
+        mask |= STATX_CTIME;
+        break;
+
+      case LS_SORT_BY_ATIME:
+        mask |= STATX_ATIME;
+        break;
+
+      default:
+        mask |= STATX_MTIME;
+        break;
+    }
+  }
+
+  return mask;
+}
+
+static void statx2stat(const struct statx *stx, struct stat *st) {
+  memset(st, 0, sizeof(struct stat));
+  st->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+  st->st_ino = stx->stx_ino;
+  st->st_mode = stx->stx_mode;
+  st->st_nlink = stx->stx_nlink;
+  st->st_uid = stx->stx_uid;
+  st->st_gid = stx->stx_gid;
+  st->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+  st->st_size = stx->stx_size;
+  st->st_blksize = stx->stx_blksize;
+  st->st_blocks = stx->stx_blocks;
+  st->st_atime = stx->stx_atime.tv_sec;
+  st->st_mtime = stx->stx_mtime.tv_sec;
+  st->st_ctime = stx->stx_ctime.tv_sec;
+}
+
+/* Returns TRUE if the directory is handled by the system FS, i.e. no module
+ * has registered an FS which would provide its entries or their metadata;
+ * only then can the directory be scanned using the syscalls directly.
+ */
+static int can_scan_dir(const char *dirname) {
+  pr_fs_t *fs;
+
+  fs = pr_get_fs(dirname, NULL);
+  while (fs != NULL &&
+         fs->fs_next != NULL &&
+         fs->opendir == NULL &&
+         fs->readdir == NULL &&
+         fs->stat == NULL &&
+         fs->lstat == NULL) {
+    fs = fs->fs_next;
+  }
+
+  if (fs == NULL ||
+      strcmp(fs->fs_name, "system") != 0) {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+#endif /* LS_USE_STATX_SCAN */
+
+/* Opens the given directory for reading its entries, one at a time, via
+ * next_dirent().  If allowed (and possible), the directory is read directly,
+ * in large batches using getdents64(2), and the metadata for each entry is
+ * obtained using statx(2) relative to the directory, asking for only those
+ * fields that the listing needs.  Otherwise, the FSIO API is used.
+ */
+static int open_dirscan(struct ls_dirscan *scan, const char *dirname,
+    int direct) {
+  memset(scan, 0, sizeof(struct ls_dirscan));
+  scan->dirname = dirname;
+
+#ifdef LS_USE_STATX_SCAN
+  scan->dir_fd = -1;
+
+  if (direct == TRUE &&
+      can_scan_dir(pr_fs_getcwd()) == TRUE) {
+    scan->dir_fd = open(dirname, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if (scan->dir_fd >= 0) {
+      scan->buf = malloc(LS_SCAN_BUFSZ);
+      if (scan->buf == NULL) {
+        pr_log_pri(PR_LOG_ALERT, "Out of memory!");
+        exit(1);
+      }
+
+      scan->mask = scan_statx_mask();
+      return 0;
+    }
+
+    pr_trace_msg("fsio", 9, "error opening '%s' for scanning: %s; "
+      "using readdir(3)", dirname, strerror(errno));
+  }
+#endif /* LS_USE_STATX_SCAN */
+
+  scan->dirh = pr_fsio_opendir(dirname);
+  if (scan->dirh == NULL) {
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Returns the next entry of the directory, or NULL if there are no more
+ * entries, or if there was an error (in which case scan->xerrno is set).
+ * The returned entry is only valid until the next call.
+ */
+static struct ls_dirent *next_dirent(struct ls_dirscan *scan) {
+  struct ls_dirent *ent;
   struct dirent *de;
+
+  ent = &(scan->ent);
+  ent->st_res = -1;
+
+#ifdef LS_USE_STATX_SCAN
+  if (scan->dir_fd >= 0) {
+    struct ls_linux_dirent64 *lde;
+    struct statx stx;
+
+    while (scan->bufoff >= scan->buflen) {
+      long nread;
+
+      pr_signals_handle();
+
+      nread = syscall(SYS_getdents64, scan->dir_fd, scan->buf, LS_SCAN_BUFSZ);
+      if (nread < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        scan->xerrno = errno;
+        return NULL;
+      }
+
+      if (nread == 0) {
+        return NULL;
+      }
+
+      scan->buflen = nread;
+      scan->bufoff = 0;
+    }
+
+    lde = (struct ls_linux_dirent64 *) (scan->buf + scan->bufoff);
+    scan->bufoff += lde->d_reclen;
+    scan->nents++;
+
+    ent->name = lde->d_name;
+
+    if (want_dirent_stat(ent->name) == TRUE &&
+        statx(scan->dir_fd, ent->name, AT_SYMLINK_NOFOLLOW|AT_NO_AUTOMOUNT,
+          scan->mask, &stx) == 0) {
+      statx2stat(&stx, &(ent->st));
+      ent->st_res = 0;
+      scan->nstats++;
+    }
+
+    return ent;
+  }
+#endif /* LS_USE_STATX_SCAN */
+
+  de = pr_fsio_readdir(scan->dirh);
+  if (de == NULL) {
+    return NULL;
+  }
+
+  scan->nents++;
+  ent->name = de->d_name;
+
+  if (want_dirent_stat(ent->name) == TRUE) {
+    pr_fs_clear_cache2(ent->name);
+    ent->st_res = pr_fsio_lstat(ent->name, &(ent->st));
+    if (ent->st_res == 0) {
+      scan->nstats++;
+    }
+  }
+
+  return ent;
+}
+
+static void close_dirscan(struct ls_dirscan *scan) {
+#ifdef LS_USE_STATX_SCAN
+  if (scan->dir_fd >= 0) {
+    free(scan->buf);
+    scan->buf = NULL;
+
+    (void) close(scan->dir_fd);
+    scan->dir_fd = -1;
+  }
+#endif /* LS_USE_STATX_SCAN */
+
+  if (scan->dirh != NULL) {
+    pr_fsio_closedir(scan->dirh);
+    scan->dirh = NULL;
+  }
+
+  pr_trace_msg("fsio", 9, "read %lu %s (%lu stat) in '%s'", scan->nents,
+    scan->nents != 1 ? "entries" : "entry", scan->nstats, scan->dirname);
+}
+
+/* Reads the entries of the given directory, along with their lstat(2) data,
+ * into a NULL-terminated list, sorted by name if requested.  Each entry,
+ * including its name, is a single allocation.
+ */
+static struct ls_dirent **sreaddir(const char *dirname, const int sort) {
+  struct ls_dirscan scan;
+  struct ls_dirent *ent;
   struct stat st;
-  int i;
-  char **p;
+  int i = 0, direct = TRUE;
+  struct ls_dirent **p;
   size_t dsize;
 
   pr_fs_clear_cache2(dirname);
@@ -1242,11 +1600,6 @@ static char **sreaddir(const char *dirname, const int sort) {
     return NULL;
   }
 
-  d = pr_fsio_opendir(dirname);
-  if (d == NULL) {
-    return NULL;
-  }
-
   /* It doesn't matter if the following guesses are wrong, but it slows
    * the system a bit and wastes some memory if they are wrong, so
    * don't guess *too* naively!
@@ -1260,75 +1613,138 @@ static char **sreaddir(const char *dirname, const int sort) {
     dsize = LS_MAX_DSIZE;
   }
 
-  /* Allocate first block for holding filenames.  Yes, we are explicitly using
+  /* Allocate first block for holding entries.  Yes, we are explicitly using
    * malloc (and realloc, and calloc, later) rather than the memory pools.
    * Recursive directory listings would eat up a lot of pool memory that is
    * only freed when the _entire_ directory structure has been parsed.  Also,
    * this helps to keep the memory footprint a little smaller.
    */
   pr_trace_msg("data", 8, "allocating readdir buffer of %lu bytes",
-    (unsigned long) (dsize * sizeof(char *)));
+    (unsigned long) (dsize * sizeof(struct ls_dirent *)));
 
-  p = malloc(dsize * sizeof(char *));
+  p = malloc(dsize * sizeof(struct ls_dirent *));
   if (p == NULL) {
     pr_log_pri(PR_LOG_ALERT, "Out of memory!");
     exit(1);
   }
 
-  i = 0;
-
-  while ((de = pr_fsio_readdir(d)) != NULL) {
-    pr_signals_handle();
+  while (TRUE) {
+    if (open_dirscan(&scan, dirname, direct) < 0) {
+      int xerrno = errno;
 
-    if ((size_t) i >= dsize - 1) {
-      char **newp;
+      free(p);
+      errno = xerrno;
+      return NULL;
+    }
 
-      /* The test above goes off one item early in case this is the last item
-       * in the directory and thus next time we will want to NULL-terminate
-       * the array.
-       */
-      pr_log_debug(DEBUG0, "Reallocating sreaddir buffer from %lu entries to "
-        "%lu entries", (unsigned long) dsize, (unsigned long) dsize * 2);
+    while ((ent = next_dirent(&scan)) != NULL) {
+      pr_signals_handle();
+      add_dirent(&p, &dsize, i++, ent);
+    }
 
-      /* Allocate bigger array for pointers to filenames */
-      pr_trace_msg("data", 8, "allocating readdir buffer of %lu bytes",
-        (unsigned long) (2 * dsize * sizeof(char *)));
+    close_dirscan(&scan);
 
-      newp = (char **) realloc(p, 2 * dsize * sizeof(char *));
-      if (newp == NULL) {
-        pr_log_pri(PR_LOG_ALERT, "Out of memory!");
-        exit(1);
-      }
-      p = newp;
-      dsize *= 2;
+    if (scan.xerrno == 0 ||
+        direct == FALSE) {
+      break;
     }
 
-    /* Append the filename to the block. */
-    p[i] = (char *) calloc(strlen(de->d_name) + 1, sizeof(char));
-    if (p[i] == NULL) {
-      pr_log_pri(PR_LOG_ALERT, "Out of memory!");
-      exit(1);
+    /* Reading the directory directly failed part way through; discard what
+     * was read, and start over using the FSIO API.
+     */
+    pr_trace_msg("fsio", 9, "error scanning '%s': %s; using readdir(3)",
+      dirname, strerror(scan.xerrno));
+
+    while (i > 0) {
+      free(p[--i]);
     }
-    sstrncpy(p[i++], de->d_name, strlen(de->d_name) + 1);
-  }
 
-  pr_fsio_closedir(d);
+    direct = FALSE;
+  }
 
   /* This is correct, since the above is off by one element.
    */
   p[i] = NULL;
 
   if (sort) {
-    PR_DEVEL_CLOCK(qsort(p, i, sizeof(char *), dircmp));
+    PR_DEVEL_CLOCK(qsort(p, i, sizeof(struct ls_dirent *), dircmp));
   }
 
   return p;
 }
 
+/* Lists the entries of the current directory as they are read, in directory
+ * order, rather than reading them all in first; memory use thus does not
+ * depend on the size of the directory.  Returns a NULL-terminated list of
+ * the subdirectories listed, for -R, or NULL on error.
+ */
+static struct ls_dirent **streamdir(cmd_rec *cmd, pool *workp,
+    const char *resp_code) {
+  struct ls_dirscan scan;
+  struct ls_dirent *ent, **subdirs;
+  size_t dsize = 16;
+  int i = 0;
+  pool *tmp_pool;
+
+  if (open_dirscan(&scan, ".", TRUE) < 0) {
+    return NULL;
+  }
+
+  subdirs = malloc(dsize * sizeof(struct ls_dirent *));
+  if (subdirs == NULL) {
+    pr_log_pri(PR_LOG_ALERT, "Out of memory!");
+    exit(1);
+  }
+
+  tmp_pool = cmd->tmp_pool;
+
+  while ((ent = next_dirent(&scan)) != NULL) {
+    int d;
+    pool *ent_pool;
+
+    pr_signals_handle();
+
+    if (*ent->name == '.' &&
+        !opt_a &&
+        (!opt_A || is_dotdir(ent->name))) {
+      continue;
+    }
+
+    /* Everything allocated while listing this entry, including from the
+     * command's tmp_pool, goes into a pool which is destroyed afterward.
+     */
+    ent_pool = make_sub_pool(workp);
+    pr_pool_tag(ent_pool, "mod_ls: streamdir(): ent_pool");
+    cmd->tmp_pool = ent_pool;
+
+    d = listfile(cmd, ent_pool, resp_code, ent->name,
+      ent->st_res == 0 ? &(ent->st) : NULL);
+
+    cmd->tmp_pool = tmp_pool;
+    destroy_pool(ent_pool);
+
+    if (d == 2 ||
+        XFER_ABORTED) {
+      break;
+    }
+
+    if (opt_R &&
+        d == 1 &&
+        !is_dotdir(ent->name)) {
+      add_dirent(&subdirs, &dsize, i++, ent);
+    }
+  }
+
+  close_dirscan(&scan);
+  subdirs[i] = NULL;
+
+  return subdirs;
+}
+
 /* This listdir() requires a chdir() first. */
 static int listdir(cmd_rec *cmd, pool *workp, const char *resp_code,
     const char *name) {
-  char **dir;
+  struct ls_dirent **dir;
   int dest_workp = 0;
   register unsigned int i = 0;
 
@@ -1372,27 +1788,43 @@ static int listdir(cmd_rec *cmd, pool *workp, const char *resp_code,
     dest_workp++;
   }
 
-  PR_DEVEL_CLOCK(dir = sreaddir(".", opt_U ? FALSE : TRUE));
+  if (list_flags & LS_FL_UNSORTED_LIST) {
+    PR_DEVEL_CLOCK(dir = streamdir(cmd, workp, resp_code));
+
+  } else {
+    PR_DEVEL_CLOCK(dir = sreaddir(".", opt_U ? FALSE : TRUE));
+  }
+
   if (dir != NULL) {
-    char **s;
-    char **r;
+    struct ls_dirent **s;
+    struct ls_dirent **r;
 
     int d = 0;
 
     s = dir;
     while (*s) {
+      struct stat *st;
+
       pr_signals_handle();
 
-      if (**s == '.') {
-        if (!opt_a && (!opt_A || is_dotdir(*s))) {
+      if (list_flags & LS_FL_UNSORTED_LIST) {
+        /* Already listed by streamdir(); only the subdirectories remain. */
+        s++;
+        continue;
+      }
+
+      st = (*s)->st_res == 0 ? &((*s)->st) : NULL;
+
+      if (*(*s)->name == '.') {
+        if (!opt_a && (!opt_A || is_dotdir((*s)->name))) {
           d = 0;
 
         } else {
-          d = listfile(cmd, workp, resp_code, *s);
+          d = listfile(cmd, workp, resp_code, (*s)->name, st);
         }
 
       } else {
-        d = listfile(cmd, workp, resp_code, *s);
+        d = listfile(cmd, workp, resp_code, (*s)->name, st);
       }
 
       if (opt_R && d == 0) {
@@ -1402,8 +1834,8 @@ static int listdir(cmd_rec *cmd, pool *workp, const char *resp_code,
          * this file again by changing the first character of the path
          * to ".".  Such files are skipped later.
          */
-        **s = '.';
-        *(*s + 1) = '\0';
+        (*s)->name[0] = '.';
+        (*s)->name[1] = '\0';
 
       } else if (d == 2) {
         break;
@@ -1435,7 +1867,8 @@ static int listdir(cmd_rec *cmd, pool *workp, const char *resp_code,
       char cwd_buf[PR_TUNABLE_PATH_MAX + 1] = {'\0'};
       unsigned char symhold;
 
-      if (*r && (strcmp(*r, ".") == 0 || strcmp(*r, "..") == 0)) {
+      if (*r && (strcmp((*r)->name, ".") == 0 ||
+                 strcmp((*r)->name, "..") == 0)) {
         r++;
         continue;
       }
@@ -1471,16 +1904,16 @@ static int listdir(cmd_rec *cmd, pool *workp, const char *resp_code,
 
       push_cwd(cwd_buf, &symhold);
 
-      if (*r && ls_perms_full(workp, cmd, (char *) *r, NULL) &&
-          !pr_fsio_chdir_canon(*r, !opt_L && list_show_symlinks)) {
+      if (*r && ls_perms_full(workp, cmd, (*r)->name, NULL) &&
+          !pr_fsio_chdir_canon((*r)->name, !opt_L && list_show_symlinks)) {
         char *subdir;
         int res = 0;
 
         if (strcmp(name, ".") == 0) {
-          subdir = *r;
+          subdir = (*r)->name;
 
         } else {
-          subdir = pdircat(workp, name, *r, NULL);
+          subdir = pdircat(workp, name, (*r)->name, NULL);
         }
 
         if (opt_STAT) {
@@ -1898,7 +2331,7 @@ static int dolist(cmd_rec *cmd, const char *opt, const char *resp_code,
 
   if (clear_flags) {
     opt_1 = opt_A = opt_a = opt_B = opt_C = opt_d = opt_F = opt_h = opt_n =
-      opt_r = opt_R = opt_S = opt_t = opt_STAT = opt_L = 0;
+      opt_r = opt_R = opt_S = opt_t = opt_STAT = opt_L = opt_U = 0;
   }
 
   if (have_options(cmd, arg)) {
@@ -1963,6 +2396,14 @@ static int dolist(cmd_rec *cmd, const char *opt, const char *resp_code,
     parse_list_opts(&list_options, &glob_flags, TRUE);
   }
 
+  if (list_flags & LS_FL_UNSORTED_LIST) {
+    /* Directory entries are sent as they are read; there is nothing to sort
+     * them by.
+     */
+    opt_U = 1;
+    opt_c = opt_S = opt_t = 0;
+  }
+
   if (arg && *arg) {
     int justone = 1;
     glob_t g;
@@ -2114,7 +2555,7 @@ static int dolist(cmd_rec *cmd, const char *opt, const char *resp_code,
               !(S_ISDIR(target_mode)) ||
               (!opt_R && S_ISDIR(target_mode) && strcmp(*path, target) != 0)) {
 
-            if (listfile(cmd, cmd->tmp_pool, resp_code, *path) < 0) {
+            if (listfile(cmd, cmd->tmp_pool, resp_code, *path, NULL) < 0) {
               ls_terminate();
               if (use_globbing && globbed) {
                 pr_fs_globfree(&g);
@@ -2258,7 +2699,7 @@ static int dolist(cmd_rec *cmd, const char *opt, const char *resp_code,
     if (ls_perms_full(cmd->tmp_pool, cmd, ".", NULL)) {
 
       if (opt_d) {
-        if (listfile(cmd, NULL, resp_code, ".") < 0) {
+        if (listfile(cmd, NULL, resp_code, ".", NULL) < 0) {
           ls_terminate();
           return -1;
         }
@@ -2380,7 +2821,9 @@ static int nlstfile(cmd_rec *cmd, const char *file) {
  * error returned if data conn cannot be opened or is aborted.
  */
 static int nlstdir(cmd_rec *cmd, const char *dir) {
-  char **list, *p, *f,
+  struct ls_dirent **list, *ent;
+  struct stat *st;
+  char *p, *f,
        file[PR_TUNABLE_PATH_MAX + 1] = {'\0'};
   char cwd_buf[PR_TUNABLE_PATH_MAX + 1] = {'\0'};
   pool *workp;
@@ -2470,7 +2913,8 @@ static int nlstdir(cmd_rec *cmd, const char *dir) {
 
   j = 0;
   while (list[j] && count >= 0) {
-    p = list[j++];
+    ent = list[j++];
+    p = ent->name;
 
     pr_signals_handle();
 
@@ -2485,7 +2929,17 @@ static int nlstdir(cmd_rec *cmd, const char *dir) {
       }
     }
 
-    if (list_flags & LS_FL_ADJUSTED_SYMLINKS) {
+    st = NULL;
+
+    if (ent->st_res == 0 &&
+        !S_ISLNK(ent->st.st_mode)) {
+      /* No need to ask for the target of a non-symlink, whose lstat(2) data
+       * is also its stat(2) data.
+       */
+      st = &(ent->st);
+      i = -1;
+
+    } else if (list_flags & LS_FL_ADJUSTED_SYMLINKS) {
       i = dir_readlink(cmd->tmp_pool, p, file, sizeof(file) - 1,
         PR_DIR_READLINK_FL_HANDLE_REL_PATH);
 
@@ -2505,12 +2959,12 @@ static int nlstdir(cmd_rec *cmd, const char *dir) {
       f = p;
     }
 
-    if (ls_perms(workp, cmd, dir_best_path(cmd->tmp_pool, f), &hidden)) {
+    if (ls_perms(workp, cmd, dir_best_path(cmd->tmp_pool, f), st, &hidden)) {
       if (hidden) {
         continue;
       }
 
-      mode = file_mode2(cmd->tmp_pool, f);
+      mode = st != NULL ? st->st_mode : file_mode2(cmd->tmp_pool, f);
       if (mode == 0) {
         continue;
       }
@@ -3232,7 +3686,7 @@ MODRET ls_nlst(cmd_rec *cmd) {
           }
 
         } else if (S_ISREG(st.st_mode) &&
-            ls_perms(cmd->tmp_pool, cmd, p, &hidden)) {
+            ls_perms(cmd->tmp_pool, cmd, p, NULL, &hidden)) {
           /* Don't display hidden files */
           if (hidden) {
             continue;
@@ -3607,6 +4061,9 @@ MODRET set_listoptions(cmd_rec *cmd) {
       } else if (strcasecmp(cmd->argv[i], "SortedNLST") == 0) {
         flags |= LS_FL_SORTED_NLST;
 
+      } else if (strcasecmp(cmd->argv[i], "UnsortedLIST") == 0) {
+        flags |= LS_FL_UNSORTED_LIST;
+
       } else {
         CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, ": unknown keyword: '",
           (char *) cmd->argv[i], "'", NULL));
@@ -416,7 +416,7 @@ static void log_event(pr_redis_t *redis, config_rec *c, cmd_rec *cmd) {
   const char *fmt_name = NULL;
   char *payload = NULL;
   size_t payload_len = 0;
-  unsigned char *log_fmt, *key_fmt;
+  pr_jot_compiled_t *log_fmt, *key_fmt;
 
   jot_filters = c->argv[0];
   fmt_name = c->argv[1];
@@ -435,8 +435,8 @@ static void log_event(pr_redis_t *redis, config_rec *c, cmd_rec *cmd) {
   jot_ctx->log = json;
   jot_ctx->user_data = jot_logfmt2json;
 
-  res = pr_jot_resolve_logfmt(tmp_pool, cmd, jot_filters, log_fmt, jot_ctx,
-    pr_jot_on_json, NULL, NULL);
+  res = pr_jot_resolve_compiled_logfmt(tmp_pool, cmd, jot_filters, log_fmt,
+    jot_ctx, pr_jot_on_json, NULL, NULL);
   if (res == 0) {
     json = add_log_fmt_extras(tmp_pool, json, fmt_name, cmd, jot_ctx);
 
@@ -471,8 +471,8 @@ static void log_event(pr_redis_t *redis, config_rec *c, cmd_rec *cmd) {
 
       jot_ctx->log = rb;
 
-      res = pr_jot_resolve_logfmt(tmp_pool, cmd, NULL, key_fmt, jot_ctx,
-        resolve_on_meta, NULL, resolve_on_other);
+      res = pr_jot_resolve_compiled_logfmt(tmp_pool, cmd, NULL, key_fmt,
+        jot_ctx, resolve_on_meta, NULL, resolve_on_other);
       if (res == 0) {
         size_t key_buflen;
 
@@ -698,8 +698,10 @@ MODRET set_redislogoncommand(cmd_rec *cmd) {
 
   c->argv[0] = jot_filters;
   c->argv[1] = pstrdup(c->pool, fmt_name);
-  c->argv[2] = log_fmt;
-  c->argv[3] = key_fmt;
+  c->argv[2] = pr_jot_compile_logfmt(c->pool, log_fmt, 0);
+  if (key_fmt != NULL) {
+    c->argv[3] = pr_jot_compile_logfmt(c->pool, key_fmt, 0);
+  }
 
   c->flags |= CF_MERGEDOWN_MULTI;
   return PR_HANDLED(cmd);
@@ -782,8 +784,10 @@ MODRET set_redislogonevent(cmd_rec *cmd) {
 
   c->argv[0] = jot_filters;
   c->argv[1] = pstrdup(c->pool, fmt_name);
-  c->argv[2] = log_fmt;
-  c->argv[3] = key_fmt;
+  c->argv[2] = pr_jot_compile_logfmt(c->pool, log_fmt, 0);
+  if (key_fmt != NULL) {
+    c->argv[3] = pr_jot_compile_logfmt(c->pool, key_fmt, 0);
+  }
 
   c->flags |= CF_MERGEDOWN_MULTI;
   return PR_HANDLED(cmd);
@@ -49,6 +49,9 @@ extern pid_t mpid;
 
 /* Variables for this module */
 static pr_fh_t *retr_fh = NULL;
+static off_t retr_read_offset = 0;
+static off_t retr_readahead_offset = 0;
+static off_t retr_readahead_end = 0;
 static pr_fh_t *stor_fh = NULL;
 static pr_fh_t *displayfilexfer_fh = NULL;
 
@@ -65,6 +68,7 @@ static int xfer_check_limit(cmd_rec *);
 #define PR_XFER_OPT_HANDLE_ALLO			0x0001
 #define PR_XFER_OPT_IGNORE_ASCII		0x0002
 #define PR_XFER_OPT_ALLOW_SYMLINK_UPLOAD	0x0004
+#define PR_XFER_OPT_ADAPTIVE_BUFSZ		0x0008
 static unsigned long xfer_opts = PR_XFER_OPT_HANDLE_ALLO;
 
 static void xfer_exit_ev(const void *, void *);
@@ -524,11 +528,103 @@ static int xfer_parse_cmdlist(const char *name, config_rec *c,
   return 0;
 }
 
+static void retr_readahead_init(off_t offset, off_t len) {
+  retr_read_offset = retr_readahead_offset = offset;
+  retr_readahead_end = offset + len;
+}
+
+/* Keep a window of upcoming file data being read in by the kernel, so that
+ * the next pr_fsio_read() is served from the page cache while the current
+ * buffer is still being written to the client.  The hint is only renewed
+ * once half of the window has been consumed, to avoid a syscall per buffer.
+ */
+static void retr_readahead(size_t bufsz) {
+#if defined(HAVE_POSIX_FADVISE) && \
+    PR_TUNABLE_XFER_READAHEAD_BUFFERS > 0
+  int res;
+  off_t window, ahead_len;
+
+  if (retr_fh == NULL ||
+      PR_FH_FD(retr_fh) < 0) {
+    return;
+  }
+
+  window = (off_t) bufsz * PR_TUNABLE_XFER_READAHEAD_BUFFERS;
+  if (retr_readahead_offset < retr_read_offset) {
+    retr_readahead_offset = retr_read_offset;
+  }
+
+  if (retr_readahead_offset >= retr_readahead_end ||
+      (retr_readahead_offset - retr_read_offset) > (window / 2)) {
+    return;
+  }
+
+  ahead_len = (retr_read_offset + window) - retr_readahead_offset;
+  if (retr_readahead_offset + ahead_len > retr_readahead_end) {
+    ahead_len = retr_readahead_end - retr_readahead_offset;
+  }
+
+  pr_trace_msg(trace_channel, 19, "reading ahead %" PR_LU " bytes at offset "
+    "%" PR_LU " of '%s'", (pr_off_t) ahead_len,
+    (pr_off_t) retr_readahead_offset, retr_fh->fh_path);
+  res = posix_fadvise(PR_FH_FD(retr_fh), retr_readahead_offset, ahead_len,
+    POSIX_FADV_WILLNEED);
+  if (res != 0) {
+    pr_trace_msg(trace_channel, 9, "error reading ahead in '%s': %s",
+      retr_fh->fh_path, strerror(res));
+  }
+
+  retr_readahead_offset += ahead_len;
+#endif /* HAVE_POSIX_FADVISE and PR_TUNABLE_XFER_READAHEAD_BUFFERS */
+}
+
+/* With adaptive buffer sizing, follow the current size of the data
+ * transfer buffer, reallocating our buffer only when it needs to grow.
+ */
+static size_t xfer_adapt_bufsz(pool *p, char **buf, size_t bufsz,
+    size_t *bufcap) {
+  size_t xfer_bufsz;
+
+  if (!(xfer_opts & PR_XFER_OPT_ADAPTIVE_BUFSZ)) {
+    return bufsz;
+  }
+
+  xfer_bufsz = session.xfer.bufsize;
+  if (xfer_bufsz == 0 ||
+      xfer_bufsz == bufsz) {
+    return bufsz;
+  }
+
+  if (xfer_bufsz > *bufcap) {
+    *buf = palloc(p, xfer_bufsz);
+    *bufcap = xfer_bufsz;
+
+    pr_trace_msg("data", 8, "reallocated transfer buffer of %lu bytes",
+      (unsigned long) xfer_bufsz);
+  }
+
+  return xfer_bufsz;
+}
+
+/* Add the time since the given start, in usecs, to the time the session has
+ * spent on disk I/O for data transfers.
+ */
+static void xfer_add_disk_usecs(uint64_t start_usecs) {
+  uint64_t now_usecs = 0;
+
+  if (start_usecs > 0 &&
+      pr_gettimeofday_micros(&now_usecs) == 0 &&
+      now_usecs > start_usecs) {
+    session.total_disk_usecs += (now_usecs - start_usecs);
+  }
+}
+
 static int transmit_normal(pool *p, char *buf, size_t bufsz) {
   int xerrno;
   long nread;
   size_t read_len;
   pr_error_t *err = NULL;
+  uint64_t start_usecs = 0;
 
   read_len = bufsz;
   if (session.range_len > 0) {
@@ -537,6 +633,8 @@ static int transmit_normal(pool *p, char *buf, size_t bufsz) {
     }
   }
 
+  pr_gettimeofday_micros(&start_usecs);
+
   nread = pr_fsio_read_with_error(p, retr_fh, buf, read_len, &err);
   xerrno = errno;
 
@@ -551,7 +649,9 @@ static int transmit_normal(pool *p, char *buf, size_t bufsz) {
       continue;
     }
 
-    pr_error_set_where(err, &xfer_module, __FILE__, __LINE__ - 4);
+    xfer_add_disk_usecs(start_usecs);
+
+    pr_error_set_where(err, &xfer_module, __FILE__, __LINE__ - 6);
     pr_error_set_why(err, pstrcat(p, "normal download of '", retr_fh->fh_path,
       "'", NULL));
 
@@ -570,10 +670,15 @@ static int transmit_normal(pool *p, char *buf, size_t bufsz) {
     return -1;
   }
 
+  xfer_add_disk_usecs(start_usecs);
+
   if (nread == 0) {
     return 0;
   }
 
+  retr_read_offset += nread;
+  retr_readahead(bufsz);
+
   return pr_data_xfer(buf, nread);
 }
 
@@ -714,6 +819,83 @@ static int transmit_sendfile(off_t data_len, off_t *data_offset,
 }
 #endif /* HAVE_SENDFILE */
 
+#ifdef HAVE_SPLICE
+static int stor_use_splice(int have_limit) {
+  const char *reason = NULL;
+
+  /* We don't splice(2) uploaded data directly into the file if:
+   * - We're storing an ASCII file.
+   * - We're using RFC2228 data channel protection, MODE Z compression,
+   *   or any other NetIO for the data connection.
+   * - The file is not on the native filesystem.
+   * - We're using bandwidth throttling, MaxStoreFileSize, or a byte range.
+   * - A module wants to see the data read from the network.
+   */
+  if (session.sf_flags & (SF_ASCII|SF_ASCII_OVERRIDE)) {
+    reason = "for ASCII data";
+
+  } else if (have_rfc2228_data) {
+    reason = "due to RFC2228 data channel protections";
+
+  } else if (have_zmode) {
+    reason = "due to MODE Z restrictions";
+
+  } else if (pr_get_netio(PR_NETIO_STRM_DATA) != NULL) {
+    reason = "due to data connection NetIO";
+
+  } else if (strcmp(stor_fh->fh_fs->fs_name, "system") != 0) {
+    reason = pstrcat(session.xfer.p, "due to '", stor_fh->fh_fs->fs_name,
+      "' FS", NULL);
+
+  } else if (pr_throttle_have_rate()) {
+    reason = "due to TransferRate restrictions";
+
+  } else if (have_limit) {
+    reason = "due to MaxStoreFileSize restrictions";
+
+  } else if (session.range_len > 0) {
+    reason = "for byte range transfers";
+
+  } else if (pr_event_listening("core.data-read") > 0) {
+    reason = "due to 'core.data-read' event listeners";
+  }
+
+  if (reason != NULL) {
+    pr_log_debug(DEBUG10, "declining use of splice %s", reason);
+    return FALSE;
+  }
+
+  pr_log_debug(DEBUG10, "using splice capability for storing data");
+  return TRUE;
+}
+#endif /* HAVE_SPLICE */
+
+/* Reads the next chunk of uploaded data into buf.  If use_splice is TRUE,
+ * the data are instead stored directly into stor_fh, and buf is not used;
+ * use_splice is set to FALSE if splicing turns out not to be possible.
+ */
+static int stor_read_data(char *buf, size_t bufsz, int *use_splice,
+    int *stor_errno) {
+
+#ifdef HAVE_SPLICE
+  if (*use_splice) {
+    int len;
+
+    len = pr_data_splice(PR_FH_FD(stor_fh), bufsz, stor_errno);
+    if (len >= 0 ||
+        errno != ENOSYS) {
+      return len;
+    }
+
+    pr_log_debug(DEBUG10, "use of splice(2) not possible, falling back to "
+      "normal data transfer");
+    *use_splice = FALSE;
+  }
+#endif /* HAVE_SPLICE */
+
+  return pr_data_xfer(buf, bufsz);
+}
+
 /* Note: the data_len and data_offset arguments are only for the benefit of
  * transmit_sendfile(), if sendfile support is enabled.  The transmit_normal()
  * function only needs/uses buf and bufsz.
@@ -1835,7 +2017,8 @@ MODRET xfer_pre_appe(cmd_rec *cmd) {
 MODRET xfer_stor(cmd_rec *cmd) {
   const char *path;
   char *lbuf;
-  int bufsz, len, xerrno = 0;
+  int bufsz, len, xerrno = 0, use_splice = FALSE, stor_errno = 0;
+  size_t lbufsz;
   off_t nbytes_stored, nbytes_max_store = 0;
   unsigned char have_limit = FALSE;
   struct stat st;
@@ -2109,10 +2292,15 @@ MODRET xfer_stor(cmd_rec *cmd) {
 
   bufsz = pr_config_get_server_xfer_bufsz(PR_NETIO_IO_RD);
   lbuf = (char *) palloc(cmd->tmp_pool, bufsz);
+  lbufsz = bufsz;
   pr_trace_msg("data", 8, "allocated upload buffer of %lu bytes",
     (unsigned long) bufsz);
 
-  while ((len = pr_data_xfer(lbuf, bufsz)) > 0) {
+#ifdef HAVE_SPLICE
+  use_splice = stor_use_splice(have_limit);
+#endif /* HAVE_SPLICE */
+
+  while ((len = stor_read_data(lbuf, bufsz, &use_splice, &stor_errno)) > 0) {
     int res;
 
     pr_signals_handle();
@@ -2150,22 +2338,34 @@ MODRET xfer_stor(cmd_rec *cmd) {
       return PR_ERROR(cmd);
     }
 
-    /* XXX Need to handle short writes better here.  It is possible that
-     * the underlying filesystem (e.g. a network-mounted filesystem) could
-     * be doing short writes, and we ideally should be more resilient/graceful
-     * in the face of such things.
-     */
-    res = pr_fsio_write_with_error(cmd->pool, stor_fh, lbuf, len, &err);
-    xerrno = errno;
+    if (use_splice) {
+      /* The data have already been stored in the file. */
+      res = len;
 
-    while (res < 0 &&
-           xerrno == EINTR) {
-      /* Interrupted by signal; handle it, and try again. */
-      errno = EINTR;
-      pr_signals_handle();
+    } else {
+      uint64_t start_usecs = 0;
+
+      /* XXX Need to handle short writes better here.  It is possible that
+       * the underlying filesystem (e.g. a network-mounted filesystem) could
+       * be doing short writes, and we ideally should be more
+       * resilient/graceful in the face of such things.
+       */
+      pr_gettimeofday_micros(&start_usecs);
 
       res = pr_fsio_write_with_error(cmd->pool, stor_fh, lbuf, len, &err);
       xerrno = errno;
+
+      while (res < 0 &&
+             xerrno == EINTR) {
+        /* Interrupted by signal; handle it, and try again. */
+        errno = EINTR;
+        pr_signals_handle();
+
+        res = pr_fsio_write_with_error(cmd->pool, stor_fh, lbuf, len, &err);
+        xerrno = errno;
+      }
+
+      xfer_add_disk_usecs(start_usecs);
     }
 
     if (res != len) {
@@ -2223,6 +2423,8 @@ MODRET xfer_stor(cmd_rec *cmd) {
         return PR_ERROR(cmd);
       }
     }
+
+    bufsz = (int) xfer_adapt_bufsz(cmd->tmp_pool, &lbuf, bufsz, &lbufsz);
   }
 
   if (XFER_ABORTED) {
@@ -2234,6 +2436,25 @@ MODRET xfer_stor(cmd_rec *cmd) {
     return PR_ERROR(cmd);
   }
 
+  if (len < 0 &&
+      stor_errno != 0) {
+    /* Splicing the data into the file failed. */
+    xerrno = stor_errno;
+
+    (void) pr_trace_msg("fileperms", 1, "%s, user '%s' (UID %s, GID %s): "
+      "error writing to '%s': %s", (char *) cmd->argv[0], session.user,
+      pr_uid2str(cmd->tmp_pool, session.uid),
+      pr_gid2str(cmd->tmp_pool, session.gid), stor_fh->fh_path,
+      strerror(xerrno));
+
+    stor_abort(cmd->pool);
+    pr_data_abort(xerrno, FALSE);
+
+    pr_cmd_set_errno(cmd, xerrno);
+    errno = xerrno;
+    return PR_ERROR(cmd);
+  }
+
   if (len < 0) {
     /* Default abort errno, in case session.d et al has already gone away */
     xerrno = ECONNABORTED;
@@ -2691,6 +2912,7 @@ MODRET xfer_retr(cmd_rec *cmd) {
   off_t nbytes_max_retrieve = 0;
   unsigned char have_limit = FALSE;
   long bufsz, len = 0;
+  size_t lbufsz;
   off_t start_offset = 0, download_len = 0;
   off_t curr_offset, curr_pos = 0, nbytes_sent = 0, cnt_steps = 0, cnt_next = 0;
   pr_error_t *err = NULL;
@@ -2887,6 +3109,8 @@ MODRET xfer_retr(cmd_rec *cmd) {
     download_len = st.st_size - curr_pos;
   }
 
+  retr_readahead_init(curr_pos, download_len);
+
   if (pr_data_open(cmd->arg, NULL, PR_NETIO_IO_WR, download_len) < 0) {
     xerrno = errno;
 
@@ -2931,6 +3155,7 @@ MODRET xfer_retr(cmd_rec *cmd) {
 
   bufsz = pr_config_get_server_xfer_bufsz(PR_NETIO_IO_WR);
   lbuf = (char *) palloc(cmd->tmp_pool, bufsz);
+  lbufsz = bufsz;
   pr_trace_msg("data", 8, "allocated download buffer of %lu bytes",
     (unsigned long) bufsz);
 
@@ -2952,6 +3177,10 @@ MODRET xfer_retr(cmd_rec *cmd) {
       break;
     }
 
+    if (session.range_len == 0) {
+      bufsz = (long) xfer_adapt_bufsz(cmd->tmp_pool, &lbuf, bufsz, &lbufsz);
+    }
+
     len = transmit_data(cmd->pool, curr_offset, &curr_pos, lbuf, bufsz);
     if (len == 0) {
       break;
@@ -3487,6 +3716,11 @@ MODRET xfer_post_pass(cmd_rec *cmd) {
     pr_data_ignore_ascii(TRUE);
   }
 
+  if (xfer_opts & PR_XFER_OPT_ADAPTIVE_BUFSZ) {
+    pr_log_debug(DEBUG8, "Adapting transfer buffer size for this session");
+    pr_data_adaptive_bufsz(TRUE);
+  }
+
   /* If we are chrooted, then skip actually processing the ALLO command
    * (Bug#3996).
    */
@@ -3936,7 +4170,10 @@ MODRET set_transferoptions(cmd_rec *cmd) {
   c = add_config_param(cmd->argv[0], 1, NULL);
 
   for (i = 1; i < cmd->argc; i++) {
-    if (strcasecmp(cmd->argv[i], "IgnoreASCII") == 0) {
+    if (strcasecmp(cmd->argv[i], "AdaptiveBufferSize") == 0) {
+      opts |= PR_XFER_OPT_ADAPTIVE_BUFSZ;
+
+    } else if (strcasecmp(cmd->argv[i], "IgnoreASCII") == 0) {
       opts |= PR_XFER_OPT_IGNORE_ASCII;
 
     } else if (strcasecmp(cmd->argv[i], "AllowSymlinkUpload") == 0 ||
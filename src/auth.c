@@ -31,6 +31,21 @@
 #include "error.h"
 #include "openbsd-blowfish.h"
 
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif /* HAVE_SYS_MMAN_H */
+
+#include <stddef.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+extern xaset_t *server_list;
+
+#if defined(MAP_ANON) && \
+    !defined(MAP_ANONYMOUS)
+# define MAP_ANONYMOUS	MAP_ANON
+#endif
+
 static pool *auth_pool = NULL;
 static size_t auth_max_passwd_len = PR_TUNABLE_PASSWORD_MAX;
 static pr_table_t *auth_tab = NULL, *uid_tab = NULL, *user_tab = NULL,
@@ -355,6 +370,1075 @@ static int groupcache_get(const char *name, gid_t *gid) {
   return -1;
 }
 
+/* Shared cache of lookup results.  The standalone daemon creates a table of
+ * fixed-size entries, in a SysV shared memory segment, so that the results
+ * of getpwnam and getgroups lookups made by one session can be used by the
+ * others, for a while, rather than each new session asking the (possibly
+ * remote) backends again.
+ *
+ * Only the daemon writes the table.  Each session process attaches it
+ * read-only, and sends any result which it had to look up to the daemon,
+ * as a datagram; the daemon checks, and then stores, those results
+ * periodically.  A session stops sending results once it has logged in, so
+ * that nothing done as the logged-in user reaches the table.
+ *
+ * The table is set-associative: a key hashes to a set of
+ * AUTH_SHCACHE_WAYS entries.  Each entry is guarded by a sequence number,
+ * odd while the daemon is writing the entry; readers copy an entry out, and
+ * only use the copy if the sequence number has not changed meanwhile, and
+ * the copied data are well-formed.  Clearing the whole cache simply bumps
+ * the table generation.
+ */
+
+#define AUTH_SHCACHE_TYPE_PWNAM		1
+#define AUTH_SHCACHE_TYPE_GROUPS	2
+
+#define AUTH_SHCACHE_WAYS		4
+#define AUTH_SHCACHE_DATA_SZ		PR_TUNABLE_AUTH_SHARED_CACHE_ENTRY_SIZE
+
+struct auth_shcache_entry {
+  unsigned int seqno;
+  unsigned int generation;
+  unsigned int hash;
+  unsigned int type;
+  unsigned int sid;
+  int negative;
+  time_t expires;
+  size_t keylen;
+  size_t datalen;
+
+  /* The key, followed by the cached data. */
+  char data[AUTH_SHCACHE_DATA_SZ];
+};
+
+struct auth_shcache {
+  unsigned int generation;
+
+  struct auth_shcache_entry entries[1];
+};
+
+/* The counters are kept apart from the table, since every session process
+ * updates them.
+ */
+struct auth_shcache_stats {
+  uint64_t hits;
+  uint64_t negative_hits;
+  uint64_t misses;
+  uint64_t stores;
+  uint64_t evictions;
+};
+
+/* A result sent by a session process to the daemon. */
+struct auth_shcache_msg {
+  unsigned int type;
+  unsigned int sid;
+  int negative;
+  unsigned int keylen;
+  unsigned int datalen;
+
+  /* The key, followed by the data. */
+  char data[AUTH_SHCACHE_DATA_SZ];
+};
+
+#define AUTH_SHCACHE_MSG_HDR_SZ		offsetof(struct auth_shcache_msg, data)
+
+static struct auth_shcache *auth_shcache = NULL;
+static struct auth_shcache_stats *auth_shcache_stats = NULL;
+static int auth_shcache_shmid = -1;
+static int auth_shcache_writable = FALSE;
+static unsigned int auth_shcache_nsets = 0;
+static int auth_shcache_ttl = 0;
+static int auth_shcache_negative_ttl = 0;
+
+/* The process which created the table, and thus may write it. */
+static pid_t auth_shcache_pid = 0;
+
+/* The daemon receives results on the first descriptor; sessions send them
+ * on the second.
+ */
+static int auth_shcache_fds[2] = { -1, -1 };
+
+#if defined(__ATOMIC_RELAXED)
+# define AUTH_SHCACHE_LOAD(ptr)		__atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+# define AUTH_SHCACHE_STORE(ptr, val)	\
+  __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+# define AUTH_SHCACHE_INCR(ptr)		\
+  (void) __atomic_fetch_add((ptr), 1, __ATOMIC_RELAXED)
+#else
+# define AUTH_SHCACHE_LOAD(ptr)		(*(ptr))
+# define AUTH_SHCACHE_STORE(ptr, val)	(*(ptr)) = (val)
+# define AUTH_SHCACHE_INCR(ptr)		(*(ptr))++
+#endif /* __ATOMIC_RELAXED */
+
+static unsigned int auth_shcache_hash(unsigned int type, const char *key,
+    size_t keylen) {
+  register unsigned int i;
+  unsigned int hash = 5381 + type;
+
+  for (i = 0; i < keylen; i++) {
+    hash = ((hash << 5) + hash) + (unsigned char) key[i];
+  }
+
+  return hash;
+}
+
+static int auth_shcache_is_writer(void) {
+  if (auth_shcache_writable == FALSE ||
+      getpid() != auth_shcache_pid) {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Checks that the given data are well-formed for their type; see
+ * auth_shcache_set_pwnam() and auth_shcache_set_groups() for the layouts.
+ */
+static int auth_shcache_check_data(unsigned int type, const char *data,
+    size_t datalen) {
+  register unsigned int i;
+  unsigned int nstrs;
+  size_t len;
+
+  switch (type) {
+    case AUTH_SHCACHE_TYPE_PWNAM:
+      len = sizeof(uid_t) + sizeof(gid_t);
+      if (datalen < len) {
+        errno = EINVAL;
+        return -1;
+      }
+
+      nstrs = 5;
+      break;
+
+    case AUTH_SHCACHE_TYPE_GROUPS:
+      len = sizeof(int) + sizeof(unsigned int);
+      if (datalen < len) {
+        errno = EINVAL;
+        return -1;
+      }
+
+      memcpy(&nstrs, data + sizeof(int), sizeof(unsigned int));
+      if (nstrs > (datalen - len) / sizeof(gid_t)) {
+        errno = EINVAL;
+        return -1;
+      }
+
+      len += (nstrs * sizeof(gid_t));
+      break;
+
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+
+  for (i = 0; i < nstrs; i++) {
+    size_t slen;
+
+    slen = strnlen(data + len, datalen - len);
+    if (slen == datalen - len) {
+      errno = EINVAL;
+      return -1;
+    }
+
+    len += (slen + 1);
+  }
+
+  if (len != datalen) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Copies out the cached data for the given key, if present and fresh.
+ * Returns the length of that data, or -1 if not cached (ENOENT) or if the
+ * data do not fit into the given buffer (ENOSPC).  A cached negative result
+ * is returned as zero length, with negative set to TRUE.
+ */
+static int auth_shcache_get(unsigned int type, const char *key, char *buf,
+    size_t bufsz, int *negative) {
+  register unsigned int i;
+  unsigned int hash, generation;
+  size_t keylen;
+  struct auth_shcache_entry *set;
+  time_t now;
+
+  if (auth_shcache == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  keylen = strlen(key);
+  hash = auth_shcache_hash(type, key, keylen);
+  set = &(auth_shcache->entries[(hash % auth_shcache_nsets) *
+    AUTH_SHCACHE_WAYS]);
+  generation = AUTH_SHCACHE_LOAD(&(auth_shcache->generation));
+  now = time(NULL);
+
+  for (i = 0; i < AUTH_SHCACHE_WAYS; i++) {
+    struct auth_shcache_entry *entry;
+    unsigned int seqno;
+    size_t datalen;
+    time_t expires;
+    int is_negative;
+
+    entry = &(set[i]);
+
+    seqno = AUTH_SHCACHE_LOAD(&(entry->seqno));
+    if (seqno & 1) {
+      continue;
+    }
+
+    if (entry->generation != generation ||
+        entry->hash != hash ||
+        entry->type != type ||
+        entry->sid != main_server->sid ||
+        entry->keylen != keylen ||
+        memcmp(entry->data, key, keylen) != 0) {
+      continue;
+    }
+
+    expires = entry->expires;
+    is_negative = entry->negative;
+    datalen = entry->datalen;
+
+    if (datalen > bufsz ||
+        keylen + datalen > AUTH_SHCACHE_DATA_SZ) {
+      continue;
+    }
+
+    memcpy(buf, entry->data + keylen, datalen);
+
+#if defined(__ATOMIC_RELAXED)
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif /* __ATOMIC_RELAXED */
+    if (AUTH_SHCACHE_LOAD(&(entry->seqno)) != seqno) {
+      /* Changed while we were reading it; treat it as absent. */
+      continue;
+    }
+
+    if (expires <= now) {
+      break;
+    }
+
+    if (is_negative) {
+      if (datalen != 0) {
+        continue;
+      }
+
+    } else if (auth_shcache_check_data(type, buf, datalen) < 0) {
+      pr_trace_msg(trace_channel, 3,
+        "ignoring malformed shared cache entry for '%s'", key);
+      continue;
+    }
+
+    if (is_negative) {
+      AUTH_SHCACHE_INCR(&(auth_shcache_stats->negative_hits));
+
+    } else {
+      AUTH_SHCACHE_INCR(&(auth_shcache_stats->hits));
+    }
+
+    pr_trace_msg(trace_channel, 17, "using %s shared cache entry for '%s'",
+      is_negative ? "negative" : "positive", key);
+    *negative = is_negative;
+    return (int) datalen;
+  }
+
+  AUTH_SHCACHE_INCR(&(auth_shcache_stats->misses));
+  errno = ENOENT;
+  return -1;
+}
+
+/* Writes an entry into the table; only the daemon does this. */
+static void auth_shcache_store(unsigned int type, unsigned int sid,
+    const char *key, size_t keylen, const char *data, size_t datalen,
+    int negative) {
+  register unsigned int i;
+  unsigned int hash, generation, seqno;
+  struct auth_shcache_entry *set, *entry = NULL;
+  time_t now;
+  int ttl, evicting = FALSE;
+
+  ttl = negative ? auth_shcache_negative_ttl : auth_shcache_ttl;
+  if (ttl <= 0) {
+    return;
+  }
+
+  hash = auth_shcache_hash(type, key, keylen);
+  set = &(auth_shcache->entries[(hash % auth_shcache_nsets) *
+    AUTH_SHCACHE_WAYS]);
+  generation = auth_shcache->generation;
+  now = time(NULL);
+
+  /* Prefer the entry already holding this key, then an unused or expired
+   * entry, then the entry expiring soonest.
+   */
+  for (i = 0; i < AUTH_SHCACHE_WAYS; i++) {
+    struct auth_shcache_entry *e;
+
+    e = &(set[i]);
+
+    if (e->generation == generation &&
+        e->hash == hash &&
+        e->type == type &&
+        e->sid == sid &&
+        e->keylen == keylen &&
+        memcmp(e->data, key, keylen) == 0) {
+      entry = e;
+      evicting = FALSE;
+      break;
+    }
+
+    if (e->generation != generation ||
+        e->expires <= now) {
+      if (entry == NULL ||
+          evicting) {
+        entry = e;
+        evicting = FALSE;
+      }
+
+      continue;
+    }
+
+    if (entry == NULL ||
+        (evicting && e->expires < entry->expires)) {
+      entry = e;
+      evicting = TRUE;
+    }
+  }
+
+  seqno = entry->seqno;
+  AUTH_SHCACHE_STORE(&(entry->seqno), seqno + 1);
+#if defined(__ATOMIC_RELAXED)
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+#endif /* __ATOMIC_RELAXED */
+
+  entry->generation = generation;
+  entry->hash = hash;
+  entry->type = type;
+  entry->sid = sid;
+  entry->negative = negative;
+  entry->expires = now + ttl;
+  entry->keylen = keylen;
+  entry->datalen = datalen;
+  memcpy(entry->data, key, keylen);
+  if (datalen > 0) {
+    memcpy(entry->data + keylen, data, datalen);
+  }
+
+  AUTH_SHCACHE_STORE(&(entry->seqno), seqno + 2);
+
+  AUTH_SHCACHE_INCR(&(auth_shcache_stats->stores));
+  if (evicting) {
+    AUTH_SHCACHE_INCR(&(auth_shcache_stats->evictions));
+  }
+
+  pr_trace_msg(trace_channel, 17, "stashed %s shared cache entry for '%.*s'",
+    negative ? "negative" : "positive", (int) keylen, key);
+}
+
+/* Stores the given result, if this is the daemon, or sends it to the daemon
+ * to store, if this is a session which has not yet logged in.
+ */
+static int auth_shcache_set(unsigned int type, const char *key,
+    const char *data, size_t datalen, int negative) {
+  struct auth_shcache_msg msg;
+  size_t keylen;
+
+  if (auth_shcache == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  if ((negative ? auth_shcache_negative_ttl : auth_shcache_ttl) <= 0) {
+    return 0;
+  }
+
+  keylen = strlen(key);
+  if (keylen == 0 ||
+      keylen + datalen > AUTH_SHCACHE_DATA_SZ) {
+    pr_trace_msg(trace_channel, 9,
+      "result for '%s' too large (%lu bytes) for the shared cache", key,
+      (unsigned long) datalen);
+    errno = ENOSPC;
+    return -1;
+  }
+
+  if (auth_shcache_is_writer()) {
+    auth_shcache_store(type, main_server->sid, key, keylen, data, datalen,
+      negative);
+    return 0;
+  }
+
+  if (auth_shcache_fds[1] < 0) {
+    return 0;
+  }
+
+  msg.type = type;
+  msg.sid = main_server->sid;
+  msg.negative = negative;
+  msg.keylen = keylen;
+  msg.datalen = datalen;
+  memcpy(msg.data, key, keylen);
+  if (datalen > 0) {
+    memcpy(msg.data + keylen, data, datalen);
+  }
+
+  /* If the daemon has not kept up, the result is simply not shared. */
+  if (send(auth_shcache_fds[1], &msg, AUTH_SHCACHE_MSG_HDR_SZ + keylen +
+      datalen, 0) < 0) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 9,
+      "error sending result for '%s' to the shared cache: %s", key,
+      strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Checks a result sent by a session, before the daemon stores it. */
+static int auth_shcache_check_msg(struct auth_shcache_msg *msg, size_t len) {
+  server_rec *s;
+
+  if (len < AUTH_SHCACHE_MSG_HDR_SZ ||
+      msg->keylen == 0 ||
+      msg->keylen > AUTH_SHCACHE_DATA_SZ ||
+      msg->datalen > AUTH_SHCACHE_DATA_SZ - msg->keylen ||
+      len != AUTH_SHCACHE_MSG_HDR_SZ + msg->keylen + msg->datalen) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (memchr(msg->data, '\0', msg->keylen) != NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (msg->negative == TRUE) {
+    if (msg->datalen != 0 ||
+        (msg->type != AUTH_SHCACHE_TYPE_PWNAM &&
+         msg->type != AUTH_SHCACHE_TYPE_GROUPS)) {
+      errno = EINVAL;
+      return -1;
+    }
+
+  } else if (msg->negative != FALSE ||
+             auth_shcache_check_data(msg->type, msg->data + msg->keylen,
+               msg->datalen) < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (server_list != NULL) {
+    for (s = (server_rec *) server_list->xas_list; s; s = s->next) {
+      if (s->sid == msg->sid) {
+        return 0;
+      }
+    }
+  }
+
+  errno = EINVAL;
+  return -1;
+}
+
+/* Gives up write access to the table, by attaching it read-only in place of
+ * the writable attachment.
+ */
+static int auth_shcache_attach_readonly(void) {
+  void *shm;
+  int xerrno;
+
+  if (auth_shcache_writable == FALSE) {
+    return 0;
+  }
+
+  PRIVS_ROOT
+  shm = shmat(auth_shcache_shmid, NULL, SHM_RDONLY);
+  xerrno = errno;
+  PRIVS_RELINQUISH
+
+  (void) shmdt((void *) auth_shcache);
+  auth_shcache_writable = FALSE;
+
+  if (shm == (void *) -1) {
+    pr_trace_msg(trace_channel, 1,
+      "error attaching shared auth cache read-only: %s", strerror(xerrno));
+    auth_shcache = NULL;
+
+    errno = xerrno;
+    return -1;
+  }
+
+  auth_shcache = shm;
+  return 0;
+}
+
+static void auth_shcache_close_fd(int idx) {
+  if (auth_shcache_fds[idx] >= 0) {
+    (void) close(auth_shcache_fds[idx]);
+    auth_shcache_fds[idx] = -1;
+  }
+}
+
+int pr_auth_shared_cache_init(unsigned int nentries, int ttl,
+    int negative_ttl) {
+#if defined(HAVE_SYS_MMAN_H) && \
+    defined(MAP_ANONYMOUS) && \
+    defined(__ATOMIC_RELAXED)
+  register unsigned int i;
+  void *shm, *map;
+  size_t shm_len;
+  unsigned int nsets;
+  int shmid, xerrno;
+
+  if (nentries == 0 ||
+      ttl < 0 ||
+      negative_ttl < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (auth_shcache != NULL) {
+    errno = EEXIST;
+    return -1;
+  }
+
+  nsets = (nentries + AUTH_SHCACHE_WAYS - 1) / AUTH_SHCACHE_WAYS;
+  shm_len = sizeof(struct auth_shcache) +
+    (((nsets * AUTH_SHCACHE_WAYS) - 1) * sizeof(struct auth_shcache_entry));
+
+  /* The segment belongs to root, so that sessions, once they no longer
+   * run as root, cannot attach it for writing.
+   */
+  PRIVS_ROOT
+  shmid = shmget(IPC_PRIVATE, shm_len, IPC_CREAT|0600);
+  xerrno = errno;
+  PRIVS_RELINQUISH
+
+  if (shmid < 0) {
+    pr_trace_msg(trace_channel, 1, "error creating %lu bytes of shared "
+      "memory for the shared auth cache: %s", (unsigned long) shm_len,
+      strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  auth_shcache_shmid = shmid;
+  auth_shcache_pid = getpid();
+
+  shm = shmat(shmid, NULL, 0);
+  if (shm == (void *) -1) {
+    xerrno = errno;
+
+    pr_trace_msg(trace_channel, 1, "error attaching shared auth cache: %s",
+      strerror(xerrno));
+    (void) pr_auth_shared_cache_free();
+
+    errno = xerrno;
+    return -1;
+  }
+
+  auth_shcache = shm;
+  auth_shcache_writable = TRUE;
+
+  map = mmap(NULL, sizeof(struct auth_shcache_stats), PROT_READ|PROT_WRITE,
+    MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) {
+    xerrno = errno;
+
+    pr_trace_msg(trace_channel, 1, "error mapping shared auth cache "
+      "counters: %s", strerror(xerrno));
+    (void) pr_auth_shared_cache_free();
+
+    errno = xerrno;
+    return -1;
+  }
+
+  auth_shcache_stats = map;
+
+  if (socketpair(AF_UNIX, SOCK_DGRAM, 0, auth_shcache_fds) < 0) {
+    xerrno = errno;
+
+    pr_trace_msg(trace_channel, 1, "error creating shared auth cache "
+      "sockets: %s", strerror(xerrno));
+    auth_shcache_fds[0] = auth_shcache_fds[1] = -1;
+    (void) pr_auth_shared_cache_free();
+
+    errno = xerrno;
+    return -1;
+  }
+
+  for (i = 0; i < 2; i++) {
+    int flags;
+
+    flags = fcntl(auth_shcache_fds[i], F_GETFL);
+    (void) fcntl(auth_shcache_fds[i], F_SETFL, flags|O_NONBLOCK);
+    (void) fcntl(auth_shcache_fds[i], F_SETFD, FD_CLOEXEC);
+  }
+
+  auth_shcache_nsets = nsets;
+  auth_shcache_ttl = ttl;
+  auth_shcache_negative_ttl = negative_ttl;
+
+  pr_trace_msg(trace_channel, 7, "shared auth cache enabled: %u entries, "
+    "TTL %d secs, negative TTL %d secs", nsets * AUTH_SHCACHE_WAYS, ttl,
+    negative_ttl);
+  return 0;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif /* HAVE_SYS_MMAN_H and MAP_ANONYMOUS and __ATOMIC_RELAXED */
+}
+
+int pr_auth_shared_cache_free(void) {
+  if (auth_shcache != NULL) {
+    (void) shmdt((void *) auth_shcache);
+    auth_shcache = NULL;
+  }
+
+  /* Only the daemon removes the segment; sessions merely detach it. */
+  if (auth_shcache_shmid >= 0 &&
+      getpid() == auth_shcache_pid) {
+    int res, xerrno;
+
+    PRIVS_ROOT
+    res = shmctl(auth_shcache_shmid, IPC_RMID, NULL);
+    xerrno = errno;
+    PRIVS_RELINQUISH
+
+    if (res < 0) {
+      pr_trace_msg(trace_channel, 1,
+        "error removing shared auth cache shmid %d: %s", auth_shcache_shmid,
+        strerror(xerrno));
+    }
+  }
+
+#if defined(HAVE_SYS_MMAN_H)
+  if (auth_shcache_stats != NULL) {
+    (void) munmap((void *) auth_shcache_stats,
+      sizeof(struct auth_shcache_stats));
+  }
+#endif /* HAVE_SYS_MMAN_H */
+
+  auth_shcache_close_fd(0);
+  auth_shcache_close_fd(1);
+
+  auth_shcache_stats = NULL;
+  auth_shcache_shmid = -1;
+  auth_shcache_pid = 0;
+  auth_shcache_writable = FALSE;
+  auth_shcache_nsets = 0;
+  return 0;
+}
+
+int pr_auth_shared_cache_sess_init(void) {
+  if (auth_shcache == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  auth_shcache_close_fd(0);
+  return auth_shcache_attach_readonly();
+}
+
+int pr_auth_shared_cache_login(void) {
+  if (auth_shcache == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  auth_shcache_close_fd(0);
+  auth_shcache_close_fd(1);
+  return auth_shcache_attach_readonly();
+}
+
+int pr_auth_shared_cache_update(void) {
+  char buf[sizeof(struct auth_shcache_msg) + 1];
+  struct auth_shcache_msg msg;
+  int count = 0;
+
+  if (auth_shcache == NULL ||
+      auth_shcache_is_writer() == FALSE) {
+    errno = EPERM;
+    return -1;
+  }
+
+  while (TRUE) {
+    ssize_t len;
+
+    pr_signals_handle();
+
+    /* Any longer message is read into the extra byte, and rejected. */
+    len = recv(auth_shcache_fds[0], buf, sizeof(buf), 0);
+    if (len < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      break;
+    }
+
+    if ((size_t) len > sizeof(msg)) {
+      pr_trace_msg(trace_channel, 3,
+        "ignoring oversized shared auth cache update");
+      continue;
+    }
+
+    memcpy(&msg, buf, len);
+    if (auth_shcache_check_msg(&msg, len) < 0) {
+      pr_trace_msg(trace_channel, 3,
+        "ignoring malformed shared auth cache update (%ld bytes)", (long) len);
+      continue;
+    }
+
+    auth_shcache_store(msg.type, msg.sid, msg.data, msg.keylen,
+      msg.data + msg.keylen, msg.datalen, msg.negative);
+    count++;
+  }
+
+  return count;
+}
+
+/* Invalidates the entry for the given key, for any server, if cached. */
+static int auth_shcache_remove_key(unsigned int type, const char *key) {
+  register unsigned int i;
+  unsigned int hash;
+  size_t keylen;
+  struct auth_shcache_entry *set;
+  int count = 0;
+
+  keylen = strlen(key);
+  hash = auth_shcache_hash(type, key, keylen);
+  set = &(auth_shcache->entries[(hash % auth_shcache_nsets) *
+    AUTH_SHCACHE_WAYS]);
+
+  for (i = 0; i < AUTH_SHCACHE_WAYS; i++) {
+    struct auth_shcache_entry *entry;
+    unsigned int seqno;
+
+    entry = &(set[i]);
+
+    if (entry->hash != hash ||
+        entry->type != type ||
+        entry->keylen != keylen ||
+        memcmp(entry->data, key, keylen) != 0) {
+      continue;
+    }
+
+    seqno = entry->seqno;
+    AUTH_SHCACHE_STORE(&(entry->seqno), seqno + 1);
+    entry->expires = 0;
+    AUTH_SHCACHE_STORE(&(entry->seqno), seqno + 2);
+
+    count++;
+  }
+
+  return count;
+}
+
+int pr_auth_shared_cache_remove(const char *user) {
+  int count;
+
+  if (auth_shcache == NULL ||
+      auth_shcache_is_writer() == FALSE) {
+    errno = EPERM;
+    return -1;
+  }
+
+  if (user == NULL) {
+    unsigned int nentries;
+
+    nentries = auth_shcache_nsets * AUTH_SHCACHE_WAYS;
+    AUTH_SHCACHE_INCR(&(auth_shcache->generation));
+
+    pr_trace_msg(trace_channel, 7, "cleared shared auth cache");
+    return (int) nentries;
+  }
+
+  count = auth_shcache_remove_key(AUTH_SHCACHE_TYPE_PWNAM, user);
+  count += auth_shcache_remove_key(AUTH_SHCACHE_TYPE_GROUPS, user);
+
+  pr_trace_msg(trace_channel, 7,
+    "removed %d shared auth cache %s for user '%s'", count,
+    count != 1 ? "entries" : "entry", user);
+  return count;
+}
+
+int pr_auth_shared_cache_get_stats(pr_auth_shared_cache_stats_t *stats) {
+  register unsigned int i;
+  unsigned int generation, nentries;
+  time_t now;
+
+  if (stats == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (auth_shcache == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  memset(stats, 0, sizeof(pr_auth_shared_cache_stats_t));
+
+  nentries = auth_shcache_nsets * AUTH_SHCACHE_WAYS;
+  generation = AUTH_SHCACHE_LOAD(&(auth_shcache->generation));
+  now = time(NULL);
+
+  for (i = 0; i < nentries; i++) {
+    struct auth_shcache_entry *entry;
+
+    entry = &(auth_shcache->entries[i]);
+    if (entry->generation == generation &&
+        entry->expires > now) {
+      stats->used++;
+    }
+  }
+
+  stats->nentries = nentries;
+  stats->ttl = auth_shcache_ttl;
+  stats->negative_ttl = auth_shcache_negative_ttl;
+  stats->hits = AUTH_SHCACHE_LOAD(&(auth_shcache_stats->hits));
+  stats->negative_hits = AUTH_SHCACHE_LOAD(&(auth_shcache_stats->negative_hits));
+  stats->misses = AUTH_SHCACHE_LOAD(&(auth_shcache_stats->misses));
+  stats->stores = AUTH_SHCACHE_LOAD(&(auth_shcache_stats->stores));
+  stats->evictions = AUTH_SHCACHE_LOAD(&(auth_shcache_stats->evictions));
+
+  return 0;
+}
+
+/* A cached getpwnam result is the UID and GID, followed by the NUL-terminated
+ * name of the module which provided it, and the name, gecos, home directory
+ * (as provided, before any RewriteHome) and shell.  The password is not
+ * cached.
+ */
+static int auth_shcache_set_pwnam(const char *name, struct passwd *pw,
+    module *m) {
+  char buf[AUTH_SHCACHE_DATA_SZ], *ptr;
+  const char *fields[5];
+  register unsigned int i;
+  size_t buflen;
+
+  if (auth_shcache == NULL) {
+    return 0;
+  }
+
+  if (pw == NULL) {
+    return auth_shcache_set(AUTH_SHCACHE_TYPE_PWNAM, name, NULL, 0, TRUE);
+  }
+
+  fields[0] = m != NULL ? m->name : "";
+  fields[1] = pw->pw_name != NULL ? pw->pw_name : name;
+  fields[2] = pw->pw_gecos != NULL ? pw->pw_gecos : "";
+  fields[3] = pw->pw_dir != NULL ? pw->pw_dir : "";
+  fields[4] = pw->pw_shell != NULL ? pw->pw_shell : "";
+
+  ptr = buf;
+  memcpy(ptr, &(pw->pw_uid), sizeof(uid_t));
+  ptr += sizeof(uid_t);
+  memcpy(ptr, &(pw->pw_gid), sizeof(gid_t));
+  ptr += sizeof(gid_t);
+  buflen = sizeof(uid_t) + sizeof(gid_t);
+
+  for (i = 0; i < 5; i++) {
+    size_t len;
+
+    len = strlen(fields[i]) + 1;
+    if (buflen + len > sizeof(buf)) {
+      errno = ENOSPC;
+      return -1;
+    }
+
+    memcpy(ptr, fields[i], len);
+    ptr += len;
+    buflen += len;
+  }
+
+  return auth_shcache_set(AUTH_SHCACHE_TYPE_PWNAM, name, buf, buflen, FALSE);
+}
+
+static struct passwd *auth_shcache_get_pwnam(pool *p, const char *name,
+    module **m, int *negative) {
+  char buf[AUTH_SHCACHE_DATA_SZ], *ptr, *fields[5];
+  register unsigned int i;
+  struct passwd *pw;
+  int buflen;
+  size_t len;
+
+  buflen = auth_shcache_get(AUTH_SHCACHE_TYPE_PWNAM, name, buf, sizeof(buf),
+    negative);
+  if (buflen < 0 ||
+      *negative) {
+    return NULL;
+  }
+
+  if ((size_t) buflen < sizeof(uid_t) + sizeof(gid_t)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  pw = pcalloc(p, sizeof(struct passwd));
+  memcpy(&(pw->pw_uid), buf, sizeof(uid_t));
+  memcpy(&(pw->pw_gid), buf + sizeof(uid_t), sizeof(gid_t));
+
+  ptr = buf + sizeof(uid_t) + sizeof(gid_t);
+  len = buflen - (sizeof(uid_t) + sizeof(gid_t));
+
+  for (i = 0; i < 5; i++) {
+    size_t fieldlen;
+
+    fieldlen = strnlen(ptr, len);
+    if (fieldlen == len) {
+      errno = EINVAL;
+      return NULL;
+    }
+
+    fields[i] = pstrndup(p, ptr, fieldlen);
+    ptr += (fieldlen + 1);
+    len -= (fieldlen + 1);
+  }
+
+  pw->pw_name = fields[1];
+  pw->pw_passwd = pstrdup(p, "*");
+  pw->pw_gecos = fields[2];
+  pw->pw_dir = fields[3];
+  pw->pw_shell = fields[4];
+
+  if (*fields[0] != '\0') {
+    *m = pr_module_get(pstrcat(p, "mod_", fields[0], ".c", NULL));
+  }
+
+  return pw;
+}
+
+/* A cached getgroups result is the result code and the number of groups,
+ * followed by the GIDs and then the NUL-terminated group names.
+ */
+static int auth_shcache_set_groups(const char *name, int res,
+    array_header *group_ids, array_header *group_names) {
+  char buf[AUTH_SHCACHE_DATA_SZ], *ptr;
+  register unsigned int i;
+  unsigned int ngroups;
+  size_t buflen;
+  char **names;
+
+  if (auth_shcache == NULL) {
+    return 0;
+  }
+
+  if (res < 0) {
+    return auth_shcache_set(AUTH_SHCACHE_TYPE_GROUPS, name, NULL, 0, TRUE);
+  }
+
+  ngroups = group_ids->nelts;
+  if (group_names->nelts != ngroups) {
+    /* We cannot rebuild these arrays faithfully, so do not cache them. */
+    return 0;
+  }
+
+  buflen = sizeof(int) + sizeof(unsigned int) + (ngroups * sizeof(gid_t));
+  if (buflen > sizeof(buf)) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  ptr = buf;
+  memcpy(ptr, &res, sizeof(int));
+  ptr += sizeof(int);
+  memcpy(ptr, &ngroups, sizeof(unsigned int));
+  ptr += sizeof(unsigned int);
+  if (ngroups > 0) {
+    memcpy(ptr, group_ids->elts, ngroups * sizeof(gid_t));
+    ptr += (ngroups * sizeof(gid_t));
+  }
+
+  names = group_names->elts;
+  for (i = 0; i < ngroups; i++) {
+    size_t len;
+
+    len = strlen(names[i] != NULL ? names[i] : "") + 1;
+    if (buflen + len > sizeof(buf)) {
+      errno = ENOSPC;
+      return -1;
+    }
+
+    memcpy(ptr, names[i] != NULL ? names[i] : "", len);
+    ptr += len;
+    buflen += len;
+  }
+
+  return auth_shcache_set(AUTH_SHCACHE_TYPE_GROUPS, name, buf, buflen, FALSE);
+}
+
+static int auth_shcache_get_groups(const char *name, array_header *group_ids,
+    array_header *group_names, int *negative) {
+  char buf[AUTH_SHCACHE_DATA_SZ], *ptr;
+  register unsigned int i;
+  unsigned int ngroups;
+  pool *names_pool;
+  int buflen, res;
+  size_t len;
+
+  buflen = auth_shcache_get(AUTH_SHCACHE_TYPE_GROUPS, name, buf, sizeof(buf),
+    negative);
+  if (buflen < 0) {
+    return -1;
+  }
+
+  if (*negative) {
+    return 0;
+  }
+
+  if ((size_t) buflen < sizeof(int) + sizeof(unsigned int)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memcpy(&res, buf, sizeof(int));
+  memcpy(&ngroups, buf + sizeof(int), sizeof(unsigned int));
+
+  len = buflen - (sizeof(int) + sizeof(unsigned int));
+  if (len < ngroups * sizeof(gid_t)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ptr = buf + sizeof(int) + sizeof(unsigned int);
+  for (i = 0; i < ngroups; i++) {
+    memcpy(push_array(group_ids), ptr, sizeof(gid_t));
+    ptr += sizeof(gid_t);
+  }
+  len -= (ngroups * sizeof(gid_t));
+
+  /* Group names are allocated as the auth modules allocate them. */
+  names_pool = session.pool != NULL ? session.pool : permanent_pool;
+
+  for (i = 0; i < ngroups; i++) {
+    size_t namelen;
+
+    namelen = strnlen(ptr, len);
+    if (namelen == len) {
+      group_ids->nelts = group_names->nelts = 0;
+      errno = EINVAL;
+      return -1;
+    }
+
+    *((char **) push_array(group_names)) = pstrndup(names_pool, ptr, namelen);
+    ptr += (namelen + 1);
+    len -= (namelen + 1);
+  }
+
+  return res;
+}
+
 /* The difference between this function, and pr_cmd_alloc(), is that this
  * allocates the cmd_rec directly from the given pool, whereas pr_cmd_alloc()
  * will allocate a subpool from the given pool, and allocate its cmd_rec
@@ -620,6 +1704,7 @@ struct passwd *pr_auth_getpwnam(pool *p, const char *name) {
   modret_t *mr = NULL;
   struct passwd *res = NULL;
   module *m = NULL;
+  int negative = FALSE;
 
   if (p == NULL ||
       name == NULL) {
@@ -627,17 +1712,31 @@ struct passwd *pr_auth_getpwnam(pool *p, const char *name) {
     return NULL;
   }
 
-  cmd = make_cmd(p, 1, name);
-  mr = dispatch_auth(cmd, "getpwnam", &m);
+  res = auth_shcache_get_pwnam(p, name, &m, &negative);
+  if (res == NULL) {
+    if (negative) {
+      errno = ENOENT;
+      return NULL;
+    }
 
-  if (MODRET_ISHANDLED(mr) &&
-      MODRET_HASDATA(mr)) {
-    res = mr->data;
-  }
+    cmd = make_cmd(p, 1, name);
+    mr = dispatch_auth(cmd, "getpwnam", &m);
 
-  if (cmd->tmp_pool) {
-    destroy_pool(cmd->tmp_pool);
-    cmd->tmp_pool = NULL;
+    if (MODRET_ISHANDLED(mr) &&
+        MODRET_HASDATA(mr)) {
+      res = mr->data;
+    }
+
+    if (res == NULL ||
+        (res->pw_uid != (uid_t) -1 &&
+         res->pw_gid != (gid_t) -1)) {
+      (void) auth_shcache_set_pwnam(name, res, m);
+    }
+
+    if (cmd->tmp_pool) {
+      destroy_pool(cmd->tmp_pool);
+      cmd->tmp_pool = NULL;
+    }
   }
 
   /* Sanity check */
@@ -1479,6 +2578,26 @@ int pr_auth_getgroups(pool *p, const char *name, array_header **group_ids,
     *group_names = make_array(permanent_pool, 2, sizeof(char *));
   }
 
+  /* Only lookups for both GIDs and names are shared, since only those can
+   * answer any later lookup.
+   */
+  if (group_ids != NULL &&
+      group_names != NULL) {
+    int negative = FALSE;
+
+    res = auth_shcache_get_groups(name, *group_ids, *group_names, &negative);
+    if (negative) {
+      errno = ENOENT;
+      return -1;
+    }
+
+    if (res >= 0) {
+      return res;
+    }
+
+    res = -1;
+  }
+
   cmd = make_cmd(p, 3, name, group_ids ? *group_ids : NULL,
     group_names ? *group_names : NULL);
 
@@ -1527,6 +2646,11 @@ int pr_auth_getgroups(pool *p, const char *name, array_header **group_ids,
     }
   }
 
+  if (group_ids != NULL &&
+      group_names != NULL) {
+    (void) auth_shcache_set_groups(name, res, *group_ids, *group_names);
+  }
+
   if (cmd->tmp_pool) {
     destroy_pool(cmd->tmp_pool);
     cmd->tmp_pool = NULL;
@@ -26,6 +26,10 @@
 
 #include "conf.h"
 
+#ifdef PR_USE_EPOLL
+# include <sys/epoll.h>
+#endif /* PR_USE_EPOLL */
+
 /* From src/dirtree.c */
 extern xaset_t *server_list;
 extern server_rec *main_server;
@@ -195,6 +199,98 @@ conn_t *pr_ipbind_get_listening_conn(server_rec *server,
 
 static array_header *listener_list = NULL;
 
+#ifdef PR_USE_EPOLL
+static int listener_epfd = -1;
+
+/* Statistics on the number of connections accepted per wakeup. */
+static unsigned long accept_nwakeups = 0UL, accept_nconns = 0UL;
+static unsigned int accept_max_batch = 0;
+
+/* Timer for re-arming the listeners after a failed accept(2). */
+static int accept_retry_pending = FALSE;
+static int accept_retry_timerno = -1;
+
+static int accept_retry_cb(CALLBACK_FRAME) {
+  conn_t **listeners;
+  register unsigned int i = 0;
+
+  accept_retry_pending = FALSE;
+  accept_retry_timerno = -1;
+
+  if (listener_epfd == -1 ||
+      listener_list == NULL) {
+    return 0;
+  }
+
+  listeners = listener_list->elts;
+  for (i = 0; i < listener_list->nelts; i++) {
+    conn_t *listener = listeners[i];
+    struct epoll_event ev;
+
+    if (listener->listen_fd == -1) {
+      continue;
+    }
+
+    /* Modifying the registration makes epoll check the listener anew, and
+     * report it as ready again if it still has connections pending.
+     */
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN|EPOLLET;
+    ev.data.ptr = listener;
+
+    if (epoll_ctl(listener_epfd, EPOLL_CTL_MOD, listener->listen_fd,
+        &ev) < 0) {
+      pr_trace_msg(trace_channel, 3,
+        "error re-arming listener fd %d using epoll: %s", listener->listen_fd,
+        strerror(errno));
+    }
+  }
+
+  pr_trace_msg(trace_channel, 9, "re-armed %u %s for accepting",
+    listener_list->nelts, listener_list->nelts != 1 ? "listeners" : "listener");
+
+  /* Stop the timer. */
+  return 0;
+}
+
+/* An edge-triggered listener whose accept(2) failed is not reported again
+ * until another connection arrives, leaving its pending connections waiting.
+ * Thus we re-arm the listeners after a while, rather than spinning on an
+ * error like EMFILE which will not clear at once.
+ */
+static void accept_retry_later(void) {
+  int timerno;
+
+  if (accept_retry_pending == TRUE) {
+    return;
+  }
+
+  /* Note that pr_timer_add() may invoke the callback before returning. */
+  accept_retry_pending = TRUE;
+  timerno = pr_timer_add(PR_TUNABLE_ACCEPT_RETRY_INTERVAL, -1, NULL,
+    accept_retry_cb, "accept retry");
+  if (timerno < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "error adding timer for retrying accept: %s", strerror(errno));
+    accept_retry_pending = FALSE;
+    return;
+  }
+
+  if (accept_retry_pending == TRUE) {
+    accept_retry_timerno = timerno;
+  }
+}
+
+static void accept_retry_clear(void) {
+  if (accept_retry_timerno != -1) {
+    (void) pr_timer_remove(accept_retry_timerno, ANY_MODULE);
+    accept_retry_timerno = -1;
+  }
+
+  accept_retry_pending = FALSE;
+}
+#endif /* PR_USE_EPOLL */
+
 conn_t *pr_ipbind_accept_conn(fd_set *readfds, int *listenfd) {
   conn_t **listeners = listener_list->elts;
   register unsigned int i = 0;
@@ -474,6 +570,15 @@ int pr_ipbind_close_listeners(void) {
     }
   }
 
+#ifdef PR_USE_EPOLL
+  accept_retry_clear();
+
+  if (listener_epfd != -1) {
+    (void) close(listener_epfd);
+    listener_epfd = -1;
+  }
+#endif /* PR_USE_EPOLL */
+
   return 0;
 }
 
@@ -853,6 +958,185 @@ int pr_ipbind_listen(fd_set *readfds) {
   return maxfd;
 }
 
+#ifdef PR_USE_EPOLL
+int pr_ipbind_listen_epoll(void) {
+  int listen_flags = PR_INET_LISTEN_FL_FATAL_ON_ERROR;
+  register unsigned int i = 0;
+
+  if (listener_epfd != -1) {
+    return listener_epfd;
+  }
+
+  if (binding_pool == NULL) {
+    binding_pool = make_sub_pool(permanent_pool);
+    pr_pool_tag(binding_pool, "Bindings Pool");
+  }
+
+  if (listener_list == NULL) {
+    listener_list = make_array(binding_pool, 1, sizeof(conn_t *));
+
+  } else {
+    listener_list->nelts = 0;
+  }
+
+  listener_epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (listener_epfd < 0) {
+    int xerrno = errno;
+
+    pr_log_pri(PR_LOG_WARNING, "unable to create epoll fd: %s",
+      strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  for (i = 0; i < PR_BINDINGS_TABLE_SIZE; i++) {
+    pr_ipbind_t *ipbind = NULL;
+
+    for (ipbind = ipbind_table[i]; ipbind; ipbind = ipbind->ib_next) {
+      conn_t *listener;
+      struct epoll_event ev;
+
+      pr_signals_handle();
+
+      /* Skip inactive bindings, but only if SocketBindTight is in effect. */
+      if (SocketBindTight &&
+          ipbind->ib_isactive == FALSE) {
+        continue;
+      }
+
+      listener = ipbind->ib_listener;
+      if (listener == NULL) {
+        continue;
+      }
+
+      if (listener->mode == CM_NONE) {
+        pr_inet_listen(listener->pool, listener, tcpBackLog, listen_flags);
+      }
+
+      if (listener->mode == CM_ACCEPT) {
+        listener->mode = CM_LISTEN;
+      }
+
+      if (listener->mode != CM_LISTEN) {
+        continue;
+      }
+
+      /* Edge-triggered notification requires that we accept until the
+       * listener would block.
+       */
+      if (pr_inet_set_nonblock(listener->pool, listener) < 0) {
+        pr_trace_msg(trace_channel, 3,
+          "error making %s#%u nonblocking: %s",
+          pr_netaddr_get_ipstr(ipbind->ib_addr), ipbind->ib_port,
+          strerror(errno));
+      }
+
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN|EPOLLET;
+      ev.data.ptr = listener;
+
+      if (epoll_ctl(listener_epfd, EPOLL_CTL_ADD, listener->listen_fd,
+          &ev) < 0) {
+        pr_log_pri(PR_LOG_WARNING, "unable to watch %s#%u using epoll: %s",
+          pr_netaddr_get_ipstr(ipbind->ib_addr), ipbind->ib_port,
+          strerror(errno));
+        continue;
+      }
+
+      *((conn_t **) push_array(listener_list)) = listener;
+    }
+  }
+
+  pr_trace_msg(trace_channel, 9, "watching %u %s using epoll fd %d",
+    listener_list->nelts, listener_list->nelts != 1 ? "listeners" : "listener",
+    listener_epfd);
+  return listener_epfd;
+}
+
+int pr_ipbind_accept_conns(int (*cb)(int, conn_t *, void *),
+    void *user_data) {
+  struct epoll_event events[64];
+  register int i;
+  int nevents;
+  unsigned int naccepted = 0;
+
+  if (cb == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (listener_epfd == -1) {
+    errno = EPERM;
+    return -1;
+  }
+
+  nevents = epoll_wait(listener_epfd, events,
+    sizeof(events) / sizeof(events[0]), 0);
+  if (nevents < 0) {
+    return -1;
+  }
+
+  for (i = 0; i < nevents; i++) {
+    conn_t *listener;
+
+    listener = events[i].data.ptr;
+
+    while (listener->listen_fd != -1) {
+      int fd, xerrno;
+
+      pr_signals_handle();
+
+#ifdef HAVE_ACCEPT4
+      /* The session process dup(2)s the fd onto stdin/stdout, which clears
+       * the close-on-exec flag for it there.
+       */
+      fd = accept4(listener->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+#else
+      fd = accept(listener->listen_fd, NULL, NULL);
+#endif /* HAVE_ACCEPT4 */
+      xerrno = errno;
+
+      if (fd < 0) {
+        if (xerrno == EINTR ||
+            xerrno == ECONNABORTED) {
+          /* Ignore ECONNABORTED, as they tend to be health checks/probes by
+           * e.g. load balancers and other naive TCP clients.
+           */
+          continue;
+        }
+
+        if (xerrno != EAGAIN &&
+            xerrno != EWOULDBLOCK) {
+          pr_log_pri(PR_LOG_ERR, "error: unable to accept an incoming "
+            "connection: %s", strerror(xerrno));
+          accept_retry_later();
+        }
+
+        break;
+      }
+
+      naccepted++;
+      (void) (cb)(fd, listener, user_data);
+    }
+  }
+
+  accept_nwakeups++;
+  accept_nconns += naccepted;
+  if (naccepted > accept_max_batch) {
+    accept_max_batch = naccepted;
+  }
+
+  pr_trace_msg(trace_channel, 17,
+    "accepted %u %s on %d %s (max %u per wakeup, %lu over %lu wakeups)",
+    naccepted, naccepted != 1 ? "connections" : "connection", nevents,
+    nevents != 1 ? "listeners" : "listener", accept_max_batch, accept_nconns,
+    accept_nwakeups);
+
+  return (int) naccepted;
+}
+#endif /* PR_USE_EPOLL */
+
 int pr_ipbind_open(const pr_netaddr_t *addr, unsigned int port,
     conn_t *listen_conn, unsigned char isdefault, unsigned char islocalhost,
     unsigned char open_namebinds) {
@@ -1244,6 +1528,15 @@ int pr_namebind_open(const char *name, const pr_netaddr_t *addr,
 }
 
 void free_bindings(void) {
+#ifdef PR_USE_EPOLL
+  accept_retry_clear();
+
+  if (listener_epfd != -1) {
+    (void) close(listener_epfd);
+    listener_epfd = -1;
+  }
+#endif /* PR_USE_EPOLL */
+
   if (binding_pool) {
     destroy_pool(binding_pool);
     binding_pool = NULL;
@@ -24,6 +24,15 @@
 
 #include "conf.h"
 
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif /* HAVE_SYS_MMAN_H */
+
+#if defined(MAP_ANON) && \
+    !defined(MAP_ANONYMOUS)
+# define MAP_ANONYMOUS	MAP_ANON
+#endif
+
 /* This struct and the list of such structs are used to try to reduce
  * the use of the following idiom to identify which command a given
  * cmd_rec is:
@@ -533,3 +542,422 @@ int pr_cmd_is_ssh2(cmd_rec *cmd) {
 
   return FALSE;
 }
+
+/* Command latency statistics.
+ *
+ * Each tracked command has a slot in a table mapped, shared and anonymous,
+ * by the daemon before it forks any sessions; sessions update it using
+ * atomic increments, and the daemon reads it when asked.  Slots are never
+ * released; resetting only zeroes the histograms.
+ *
+ * The histograms are log-bucketed: values below 4 usecs have a bucket
+ * each, and every power of two above that is split into 4 buckets, for a
+ * worst-case error of 25%.  Values of 2^CMD_STATS_MAX_MSB usecs or more
+ * (about 19 hours) share the last bucket.
+ */
+
+#define CMD_STATS_NPHASES	4
+#define CMD_STATS_MAX_MSB	35
+#define CMD_STATS_NBUCKETS	(4 + ((CMD_STATS_MAX_MSB - 1) * 4))
+#define CMD_STATS_NAME_SZ	16
+
+/* Slot states */
+#define CMD_STATS_SLOT_FREE	0
+#define CMD_STATS_SLOT_CLAIMED	1
+#define CMD_STATS_SLOT_READY	2
+
+struct cmd_stats_hist {
+  uint64_t counts[CMD_STATS_NBUCKETS];
+  uint64_t max_usecs;
+};
+
+struct cmd_stats_slot {
+  int state;
+  char cmd_name[CMD_STATS_NAME_SZ];
+  struct cmd_stats_hist phases[CMD_STATS_NPHASES];
+};
+
+static struct cmd_stats_slot *cmd_stats = NULL;
+static size_t cmd_stats_len = 0;
+
+/* Per-process cache of the slots for the known command IDs, as slot
+ * index + 1.
+ */
+static int cmd_stats_id_slots[PR_CMD_CSID_ID + 1];
+
+#if defined(__ATOMIC_RELAXED)
+# define CMD_STATS_LOAD(ptr)		__atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+# define CMD_STATS_INCR(ptr)		\
+  (void) __atomic_fetch_add((ptr), 1, __ATOMIC_RELAXED)
+#else
+# define CMD_STATS_LOAD(ptr)		(*(ptr))
+# define CMD_STATS_INCR(ptr)		(*(ptr))++
+#endif /* __ATOMIC_RELAXED */
+
+static int cmd_stats_phase_idx(int phase) {
+  switch (phase) {
+    case PRE_CMD:
+      return 0;
+
+    case CMD:
+      return 1;
+
+    case POST_CMD:
+    case POST_CMD_ERR:
+      return 2;
+
+    case LOG_CMD:
+    case LOG_CMD_ERR:
+      return 3;
+  }
+
+  return -1;
+}
+
+static unsigned int cmd_stats_bucket(uint64_t usecs) {
+  unsigned int msb = 2;
+
+  if (usecs < 4) {
+    return (unsigned int) usecs;
+  }
+
+  while ((usecs >> (msb + 1)) != 0) {
+    msb++;
+  }
+
+  if (msb >= CMD_STATS_MAX_MSB) {
+    return CMD_STATS_NBUCKETS - 1;
+  }
+
+  return 4 + ((msb - 2) * 4) + (unsigned int) ((usecs >> (msb - 2)) & 3);
+}
+
+/* Returns the largest value which falls into the given bucket. */
+static uint64_t cmd_stats_bucket_max(unsigned int bucket) {
+  unsigned int msb, sub;
+
+  if (bucket < 4) {
+    return bucket;
+  }
+
+  msb = ((bucket - 4) / 4) + 2;
+  sub = (bucket - 4) % 4;
+  return (((uint64_t) (4 + sub + 1)) << (msb - 2)) - 1;
+}
+
+int pr_cmd_stats_init(void) {
+#if defined(HAVE_SYS_MMAN_H) && \
+    defined(MAP_ANONYMOUS)
+  void *map;
+  size_t map_len;
+
+  if (cmd_stats != NULL) {
+    return 0;
+  }
+
+  map_len = sizeof(struct cmd_stats_slot) * PR_TUNABLE_CMD_STATS_MAX_CMDS;
+  map = mmap(NULL, map_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS,
+    -1, 0);
+  if (map == MAP_FAILED) {
+    int xerrno = errno;
+
+    pr_trace_msg("command", 1, "error mapping %lu bytes for command "
+      "statistics: %s", (unsigned long) map_len, strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  cmd_stats = map;
+  cmd_stats_len = map_len;
+  memset(cmd_stats_id_slots, 0, sizeof(cmd_stats_id_slots));
+  return 0;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif /* HAVE_SYS_MMAN_H and MAP_ANONYMOUS */
+}
+
+int pr_cmd_stats_free(void) {
+  if (cmd_stats == NULL) {
+    return 0;
+  }
+
+#if defined(HAVE_SYS_MMAN_H)
+  (void) munmap((void *) cmd_stats, cmd_stats_len);
+#endif /* HAVE_SYS_MMAN_H */
+
+  cmd_stats = NULL;
+  cmd_stats_len = 0;
+  memset(cmd_stats_id_slots, 0, sizeof(cmd_stats_id_slots));
+  return 0;
+}
+
+static struct cmd_stats_slot *cmd_stats_find_slot(const char *cmd_name) {
+  register unsigned int i;
+
+  for (i = 0; i < PR_TUNABLE_CMD_STATS_MAX_CMDS; i++) {
+    int state;
+
+    state = CMD_STATS_LOAD(&(cmd_stats[i].state));
+    if (state == CMD_STATS_SLOT_FREE) {
+      break;
+    }
+
+    if (state == CMD_STATS_SLOT_READY &&
+        strcmp(cmd_stats[i].cmd_name, cmd_name) == 0) {
+      return &(cmd_stats[i]);
+    }
+  }
+
+  return NULL;
+}
+
+static struct cmd_stats_slot *cmd_stats_claim_slot(const char *cmd_name) {
+  register unsigned int i;
+
+  for (i = 0; i < PR_TUNABLE_CMD_STATS_MAX_CMDS; i++) {
+    int state;
+
+    state = CMD_STATS_LOAD(&(cmd_stats[i].state));
+    if (state == CMD_STATS_SLOT_FREE) {
+#if defined(__ATOMIC_RELAXED)
+      if (__atomic_compare_exchange_n(&(cmd_stats[i].state), &state,
+          CMD_STATS_SLOT_CLAIMED, FALSE, __ATOMIC_ACQUIRE,
+          __ATOMIC_RELAXED)) {
+        sstrncpy(cmd_stats[i].cmd_name, cmd_name, CMD_STATS_NAME_SZ);
+        __atomic_store_n(&(cmd_stats[i].state), CMD_STATS_SLOT_READY,
+          __ATOMIC_RELEASE);
+        return &(cmd_stats[i]);
+      }
+#else
+      sstrncpy(cmd_stats[i].cmd_name, cmd_name, CMD_STATS_NAME_SZ);
+      cmd_stats[i].state = CMD_STATS_SLOT_READY;
+      return &(cmd_stats[i]);
+#endif /* __ATOMIC_RELAXED */
+    }
+
+    /* Another process may be claiming this slot, possibly for this same
+     * command; wait for it to finish.
+     */
+    while (state == CMD_STATS_SLOT_CLAIMED) {
+      state = CMD_STATS_LOAD(&(cmd_stats[i].state));
+    }
+
+    if (strcmp(cmd_stats[i].cmd_name, cmd_name) == 0) {
+      return &(cmd_stats[i]);
+    }
+  }
+
+  return NULL;
+}
+
+int pr_cmd_stats_record(cmd_rec *cmd, int phase, uint64_t usecs) {
+  const char *cmd_name;
+  struct cmd_stats_slot *slot = NULL;
+  struct cmd_stats_hist *hist;
+  int idx;
+
+  if (cmd == NULL ||
+      cmd->argv == NULL ||
+      cmd->argv[0] == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  idx = cmd_stats_phase_idx(phase);
+  if (idx < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (cmd_stats == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  cmd_name = cmd->argv[0];
+  if (cmd->cmd_id == 0) {
+    cmd->cmd_id = pr_cmd_get_id(cmd_name);
+  }
+
+  if (cmd->cmd_id > 0 &&
+      cmd->cmd_id <= PR_CMD_CSID_ID &&
+      cmd_stats_id_slots[cmd->cmd_id] > 0) {
+    slot = &(cmd_stats[cmd_stats_id_slots[cmd->cmd_id] - 1]);
+
+  } else {
+    if (strlen(cmd_name) >= CMD_STATS_NAME_SZ) {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+
+    slot = cmd_stats_find_slot(cmd_name);
+    if (slot == NULL) {
+      /* Do not let arbitrary client input use up the table. */
+      if (cmd->cmd_id <= 0 &&
+          pr_stash_get_symbol2(PR_SYM_CMD, cmd_name, NULL, NULL,
+            NULL) == NULL) {
+        errno = ENOENT;
+        return -1;
+      }
+
+      slot = cmd_stats_claim_slot(cmd_name);
+      if (slot == NULL) {
+        errno = ENOSPC;
+        return -1;
+      }
+    }
+
+    if (cmd->cmd_id > 0 &&
+        cmd->cmd_id <= PR_CMD_CSID_ID) {
+      cmd_stats_id_slots[cmd->cmd_id] = (slot - cmd_stats) + 1;
+    }
+  }
+
+  hist = &(slot->phases[idx]);
+  CMD_STATS_INCR(&(hist->counts[cmd_stats_bucket(usecs)]));
+
+#if defined(__ATOMIC_RELAXED)
+  {
+    uint64_t max_usecs;
+
+    max_usecs = __atomic_load_n(&(hist->max_usecs), __ATOMIC_RELAXED);
+    while (usecs > max_usecs &&
+           !__atomic_compare_exchange_n(&(hist->max_usecs), &max_usecs, usecs,
+             TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+  }
+#else
+  if (usecs > hist->max_usecs) {
+    hist->max_usecs = usecs;
+  }
+#endif /* __ATOMIC_RELAXED */
+
+  return 0;
+}
+
+array_header *pr_cmd_stats_get_cmds(pool *p) {
+  register unsigned int i;
+  array_header *cmds;
+
+  if (p == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (cmd_stats == NULL) {
+    errno = EPERM;
+    return NULL;
+  }
+
+  cmds = make_array(p, 0, sizeof(char *));
+  for (i = 0; i < PR_TUNABLE_CMD_STATS_MAX_CMDS; i++) {
+    int state;
+
+    state = CMD_STATS_LOAD(&(cmd_stats[i].state));
+    if (state == CMD_STATS_SLOT_FREE) {
+      break;
+    }
+
+    if (state == CMD_STATS_SLOT_READY) {
+      *((char **) push_array(cmds)) = pstrdup(p, cmd_stats[i].cmd_name);
+    }
+  }
+
+  return cmds;
+}
+
+static uint64_t cmd_stats_percentile(uint64_t *counts, uint64_t total,
+    uint64_t max_usecs, double percentile) {
+  register unsigned int i;
+  uint64_t rank, seen = 0;
+
+  /* The rank of the value, i.e. ceil(total * percentile). */
+  rank = (uint64_t) (total * percentile);
+  if ((double) rank < (total * percentile) ||
+      rank == 0) {
+    rank++;
+  }
+
+  for (i = 0; i < CMD_STATS_NBUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      uint64_t usecs;
+
+      usecs = cmd_stats_bucket_max(i);
+      return usecs < max_usecs ? usecs : max_usecs;
+    }
+  }
+
+  return max_usecs;
+}
+
+int pr_cmd_stats_get(const char *cmd_name, int phase, pr_cmd_stats_t *stats) {
+  register unsigned int i;
+  struct cmd_stats_slot *slot;
+  uint64_t counts[CMD_STATS_NBUCKETS], total = 0, max_usecs;
+  int idx;
+
+  if (cmd_name == NULL ||
+      stats == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  idx = cmd_stats_phase_idx(phase);
+  if (idx < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (cmd_stats == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  slot = cmd_stats_find_slot(cmd_name);
+  if (slot == NULL) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  /* Take a snapshot of the histogram, since sessions may be updating it. */
+  for (i = 0; i < CMD_STATS_NBUCKETS; i++) {
+    counts[i] = CMD_STATS_LOAD(&(slot->phases[idx].counts[i]));
+    total += counts[i];
+  }
+  max_usecs = CMD_STATS_LOAD(&(slot->phases[idx].max_usecs));
+
+  memset(stats, 0, sizeof(pr_cmd_stats_t));
+  stats->count = total;
+  stats->max_usecs = max_usecs;
+
+  if (total > 0) {
+    stats->p50_usecs = cmd_stats_percentile(counts, total, max_usecs, 0.5);
+    stats->p99_usecs = cmd_stats_percentile(counts, total, max_usecs, 0.99);
+    stats->p999_usecs = cmd_stats_percentile(counts, total, max_usecs,
+      0.999);
+  }
+
+  return 0;
+}
+
+int pr_cmd_stats_reset(void) {
+  register unsigned int i;
+
+  if (cmd_stats == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  for (i = 0; i < PR_TUNABLE_CMD_STATS_MAX_CMDS; i++) {
+    if (CMD_STATS_LOAD(&(cmd_stats[i].state)) == CMD_STATS_SLOT_FREE) {
+      break;
+    }
+
+    memset(cmd_stats[i].phases, 0, sizeof(cmd_stats[i].phases));
+  }
+
+  return 0;
+}
@@ -45,6 +45,31 @@ static pool *config_tab_pool = NULL;
 static pr_table_t *config_tab = NULL;
 static unsigned int config_id = 0;
 
+/* Index of the config_recs in a large set by config ID, used for the common
+ * non-recursive lookups of directives by name (e.g. get_param_ptr()).  Each
+ * set keeps its own index, in its XASET_INDEX_CONFIG slot, which is rebuilt
+ * once the set has changed.
+ */
+struct config_index_ent {
+  unsigned int id;
+  config_rec *c;
+
+  /* The next entry in the same hash bucket. */
+  struct config_index_ent *hnext;
+
+  /* The next/last entry with the same ID, in set order. */
+  struct config_index_ent *next, *last;
+};
+
+struct config_index {
+  pool *pool;
+  unsigned long gen;
+
+  /* NULL if the set cannot be indexed. */
+  struct config_index_ent **buckets;
+  unsigned int nbuckets;
+};
+
 static const char *trace_channel = "config";
 
 config_rec *pr_config_alloc(pool *p, const char *name, int config_type) {
@@ -486,6 +511,117 @@ void pr_config_merge_down(xaset_t *s, int dynamic) {
   }
 }
 
+static struct config_index *config_index_build(xaset_t *set,
+    unsigned int count) {
+  pool *index_pool;
+  struct config_index *idx;
+  struct config_index_ent *ents;
+  config_rec *c;
+  unsigned int i = 0;
+
+  index_pool = make_sub_pool(set->pool);
+  pr_pool_tag(index_pool, "config index pool");
+
+  idx = pcalloc(index_pool, sizeof(struct config_index));
+  idx->pool = index_pool;
+  idx->gen = set->xas_gen;
+
+  idx->nbuckets = 1;
+  while (idx->nbuckets < count) {
+    idx->nbuckets <<= 1;
+  }
+
+  idx->buckets = pcalloc(index_pool,
+    idx->nbuckets * sizeof(struct config_index_ent *));
+  ents = pcalloc(index_pool, count * sizeof(struct config_index_ent));
+
+  for (c = (config_rec *) set->xas_list; c; c = c->next) {
+    struct config_index_ent *ent, *head;
+    unsigned int bucket;
+
+    if (c->config_id == 0) {
+      /* Without an ID, this config_rec can only be found by its name. */
+      pr_trace_msg(trace_channel, 17,
+        "unable to index set %p: '%s' has no config ID", set,
+        c->name ? c->name : "(null)");
+      idx->buckets = NULL;
+      break;
+    }
+
+    ent = &(ents[i++]);
+    ent->id = c->config_id;
+    ent->c = c;
+
+    bucket = c->config_id & (idx->nbuckets - 1);
+    for (head = idx->buckets[bucket]; head; head = head->hnext) {
+      if (head->id == ent->id) {
+        break;
+      }
+    }
+
+    if (head == NULL) {
+      ent->last = ent;
+      ent->hnext = idx->buckets[bucket];
+      idx->buckets[bucket] = ent;
+
+    } else {
+      head->last->next = ent;
+      head->last = ent;
+    }
+  }
+
+  pr_trace_msg(trace_channel, 15, "indexed %u config entries for set %p",
+    count, set);
+  return idx;
+}
+
+static struct config_index *config_index_get(xaset_t *set) {
+  struct config_index *idx;
+  unsigned int count = 0;
+  config_rec *c;
+
+  idx = set->xas_indexes[XASET_INDEX_CONFIG];
+  if (idx != NULL &&
+      idx->gen == set->xas_gen) {
+    return idx->buckets != NULL ? idx : NULL;
+  }
+
+  for (c = (config_rec *) set->xas_list; c; c = c->next) {
+    count++;
+  }
+
+  if (count < PR_TUNABLE_CONFIG_INDEX_MIN) {
+    return NULL;
+  }
+
+  if (idx != NULL) {
+    destroy_pool(idx->pool);
+  }
+
+  idx = set->xas_indexes[XASET_INDEX_CONFIG] = config_index_build(set, count);
+  return idx->buckets != NULL ? idx : NULL;
+}
+
+static config_rec *config_index_find(struct config_index *idx,
+    unsigned int cid, int type) {
+  struct config_index_ent *ent;
+
+  for (ent = idx->buckets[cid & (idx->nbuckets - 1)]; ent; ent = ent->hnext) {
+    if (ent->id == cid) {
+      break;
+    }
+  }
+
+  for (; ent; ent = ent->next) {
+    if (ent->c->config_type == type) {
+      return ent->c;
+    }
+  }
+
+  errno = ENOENT;
+  return NULL;
+}
+
 config_rec *find_config_next2(config_rec *prev, config_rec *c, int type,
     const char *name, int recurse, unsigned long flags) {
   config_rec *top = c;
@@ -526,6 +662,25 @@ config_rec *find_config_next2(config_rec *prev, config_rec *c, int type,
     namelen = strlen(name);
   }
 
+  /* Searching a large set for a directive, starting at the head of the set,
+   * is a lookup in that set's index.  Only CONF_PARAM lookups use the index;
+   * unlike the names of other config_recs (e.g. <Directory> paths), these
+   * names never change, and so always correspond to the config ID.
+   */
+  if (recurse == 0 &&
+      type == CONF_PARAM &&
+      cid != 0 &&
+      c != NULL &&
+      c->set != NULL &&
+      c->set->xas_list == (xasetmember_t *) c) {
+    struct config_index *idx;
+
+    idx = config_index_get(c->set);
+    if (idx != NULL) {
+      return config_index_find(idx, cid, type);
+    }
+  }
+
   do {
     if (recurse) {
       config_rec *res = NULL;
@@ -40,6 +40,7 @@ static const char *trace_channel = "data";
 static const char *timing_channel = "timing";
 
 #define PR_DATA_OPT_IGNORE_ASCII	0x0001
+#define PR_DATA_OPT_ADAPTIVE_BUFSZ	0x0002
 static unsigned long data_opts = 0UL;
 static uint64_t data_start_ms = 0L;
 static int data_first_byte_read = FALSE;
@@ -61,6 +62,22 @@ static int timeout_idle = PR_TUNABLE_TIMEOUTIDLE;
 static int timeout_noxfer = PR_TUNABLE_TIMEOUTNOXFER;
 static int timeout_stalled = PR_TUNABLE_TIMEOUTSTALLED;
 
+/* For adaptive buffer sizing: the number of pr_data_xfer() calls since the
+ * socket metrics were last sampled, and the subpool holding the current
+ * (resized) transfer buffer.
+ */
+static unsigned int bufsz_nsamples = 0;
+static pool *bufsz_pool = NULL;
+
+#if defined(HAVE_SPLICE)
+/* The pipe through which uploaded data are spliced into files, created
+ * on first use and kept for the rest of the session.
+ */
+static int splice_pipe[2] = { -1, -1 };
+static size_t splice_pipesz = 0;
+static int splice_disabled = FALSE;
+#endif /* HAVE_SPLICE */
+
 /* Called if the "Stalled" timer goes off
  */
 static int stalled_timeout_cb(CALLBACK_FRAME) {
@@ -94,6 +111,10 @@ static RETSIGTYPE data_urgent(int signo) {
 static void data_new_xfer(char *filename, int direction) {
   pr_data_clear_xfer_pool();
 
+#if defined(HAVE_SPLICE)
+  splice_disabled = FALSE;
+#endif /* HAVE_SPLICE */
+
   session.xfer.p = make_sub_pool(session.pool);
   pr_pool_tag(session.xfer.p, "Data Transfer pool");
 
@@ -105,6 +126,131 @@ static void data_new_xfer(char *filename, int direction) {
     (unsigned long) session.xfer.bufsize);
   session.xfer.buf++;	/* leave room for ascii translation */
   session.xfer.buflen = 0;
+
+  bufsz_nsamples = 0;
+  bufsz_pool = NULL;
+}
+
+/* Returns the transfer buffer size suggested by the kernel's view of the
+ * data connection, i.e. its estimate of the bandwidth-delay product, or
+ * zero if no suggestion can be made.
+ */
+static size_t data_get_suggested_bufsz(int fd, int direction) {
+#if defined(LINUX) && defined(TCP_INFO)
+  struct tcp_info info;
+  socklen_t infolen;
+  size_t bdp = 0, bufsz;
+
+  infolen = sizeof(info);
+  memset(&info, 0, sizeof(info));
+  if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &infolen) < 0) {
+    pr_trace_msg(trace_channel, 9, "error obtaining TCP_INFO for fd %d: %s",
+      fd, strerror(errno));
+    return 0;
+  }
+
+  if (direction == PR_NETIO_IO_WR) {
+    /* The congestion window, plus whatever is still unacknowledged, is how
+     * much the kernel is willing to have in flight for us.
+     */
+    bdp = ((size_t) info.tcpi_snd_cwnd + info.tcpi_unacked) *
+      info.tcpi_snd_mss;
+
+  } else {
+    /* For receiving, the kernel's receive window autotuning already tracks
+     * the amount of data arriving per RTT.
+     */
+    bdp = (size_t) info.tcpi_rcv_space;
+  }
+
+  if (bdp == 0) {
+    return 0;
+  }
+
+  bufsz = PR_TUNABLE_XFER_BUFFER_MIN_SIZE;
+  while (bufsz < bdp &&
+         bufsz < PR_TUNABLE_XFER_BUFFER_MAX_SIZE) {
+    bufsz <<= 1;
+  }
+
+  if (bufsz > PR_TUNABLE_XFER_BUFFER_MAX_SIZE) {
+    bufsz = PR_TUNABLE_XFER_BUFFER_MAX_SIZE;
+  }
+
+  pr_trace_msg(trace_channel, 17, "TCP_INFO for fd %d: rtt %u us, "
+    "rttvar %u us, snd_cwnd %u, snd_mss %u, unacked %u, rcv_space %u "
+    "(suggests %lu byte buffer)", fd, info.tcpi_rtt, info.tcpi_rttvar,
+    info.tcpi_snd_cwnd, info.tcpi_snd_mss, info.tcpi_unacked,
+    info.tcpi_rcv_space, (unsigned long) bufsz);
+
+  return bufsz;
+#else
+  return 0;
+#endif /* LINUX and TCP_INFO */
+}
+
+/* Grow or shrink session.xfer.buf, periodically, to fit the socket metrics
+ * of the data connection.
+ */
+static void data_adapt_bufsz(void) {
+  pr_netio_stream_t *strm;
+  size_t bufsz;
+  pool *buf_pool;
+  char *buf;
+
+  if (!(data_opts & PR_DATA_OPT_ADAPTIVE_BUFSZ)) {
+    return;
+  }
+
+  bufsz_nsamples++;
+  if (bufsz_nsamples < PR_TUNABLE_XFER_BUFFER_SAMPLE_INTERVAL) {
+    return;
+  }
+  bufsz_nsamples = 0;
+
+  strm = (session.xfer.direction == PR_NETIO_IO_RD) ? session.d->instrm :
+    session.d->outstrm;
+  if (strm == NULL) {
+    return;
+  }
+
+  bufsz = data_get_suggested_bufsz(PR_NETIO_FD(strm), session.xfer.direction);
+  if (bufsz == 0 ||
+      bufsz == session.xfer.bufsize) {
+    return;
+  }
+
+  /* Any not-yet-translated ASCII upload data must fit in the new buffer. */
+  if (session.xfer.direction == PR_NETIO_IO_RD &&
+      (size_t) session.xfer.buflen > bufsz) {
+    return;
+  }
+
+  /* The buffer lives in its own subpool, so that the previous buffer's
+   * memory is released on every resize.
+   */
+  buf_pool = make_sub_pool(session.xfer.p);
+  pr_pool_tag(buf_pool, "Data Transfer buffer pool");
+
+  buf = pcalloc(buf_pool, bufsz + 1);
+  buf++;	/* leave room for ascii translation */
+
+  if (session.xfer.direction == PR_NETIO_IO_RD &&
+      session.xfer.buflen > 0) {
+    memcpy(buf, session.xfer.buf, session.xfer.buflen);
+  }
+
+  pr_trace_msg(trace_channel, 8, "%s data transfer buffer from %lu to %lu "
+    "bytes", bufsz > session.xfer.bufsize ? "growing" : "shrinking",
+    (unsigned long) session.xfer.bufsize, (unsigned long) bufsz);
+
+  session.xfer.buf = buf;
+  session.xfer.bufsize = bufsz;
+
+  if (bufsz_pool != NULL) {
+    destroy_pool(bufsz_pool);
+  }
+  bufsz_pool = buf_pool;
 }
 
 static int data_passive_open(const char *reason, off_t size) {
@@ -457,6 +603,9 @@ void pr_data_clear_xfer_pool(void) {
 
   memset(&session.xfer, 0, sizeof(session.xfer));
   session.xfer.xfer_type = xfer_type;  
+
+  /* The buffer subpool, if any, was a child of the destroyed pool. */
+  bufsz_pool = NULL;
 }
 
 void pr_data_reset(void) {
@@ -499,6 +648,33 @@ int pr_data_ignore_ascii(int ignore_ascii) {
   return res;
 }
 
+int pr_data_adaptive_bufsz(int adaptive_bufsz) {
+  int res;
+
+  if (adaptive_bufsz != TRUE &&
+      adaptive_bufsz != FALSE) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (data_opts & PR_DATA_OPT_ADAPTIVE_BUFSZ) {
+    if (!adaptive_bufsz) {
+      data_opts &= ~PR_DATA_OPT_ADAPTIVE_BUFSZ;
+    }
+
+    res = TRUE;
+
+  } else {
+    if (adaptive_bufsz) {
+      data_opts |= PR_DATA_OPT_ADAPTIVE_BUFSZ;
+    }
+
+    res = FALSE;
+  }
+
+  return res;
+}
+
 void pr_data_init(char *filename, int direction) {
   if (session.xfer.p == NULL) {
     data_new_xfer(filename, direction);
@@ -1208,6 +1384,19 @@ static void poll_ctrl(void) {
   }
 }
 
+/* Add the time since the given start, in usecs, to the time the session has
+ * spent on network I/O for data transfers.
+ */
+static void data_add_net_usecs(uint64_t start_usecs) {
+  uint64_t now_usecs = 0;
+
+  if (start_usecs > 0 &&
+      pr_gettimeofday_micros(&now_usecs) == 0 &&
+      now_usecs > start_usecs) {
+    session.total_net_usecs += (now_usecs - start_usecs);
+  }
+}
+
 /* pr_data_xfer() actually transfers the data on the data connection.  ASCII
  * translation is performed if necessary.  `direction' is set when the data
  * connection was opened.
@@ -1220,6 +1409,7 @@ int pr_data_xfer(char *cl_buf, size_t cl_size) {
   int total = 0;
   int res = 0;
   pool *tmp_pool = NULL;
+  uint64_t start_usecs = 0;
 
   if (cl_buf == NULL ||
       cl_size == 0) {
@@ -1257,6 +1447,9 @@ int pr_data_xfer(char *cl_buf, size_t cl_size) {
     return -1;
   }
 
+  data_adapt_bufsz();
+  pr_gettimeofday_micros(&start_usecs);
+
   if (session.xfer.direction == PR_NETIO_IO_RD) {
     char *buf;
 
@@ -1457,7 +1650,15 @@ int pr_data_xfer(char *cl_buf, size_t cl_size) {
 
       pr_signals_handle();
 
-      if (buflen > pr_config_get_server_xfer_bufsz(PR_NETIO_IO_WR)) {
+      if (session.xfer.bufsize > 0) {
+        /* Note that the buffer size may have been adapted for this
+         * transfer.
+         */
+        if ((size_t) buflen > session.xfer.bufsize) {
+          buflen = session.xfer.bufsize;
+        }
+
+      } else if (buflen > pr_config_get_server_xfer_bufsz(PR_NETIO_IO_WR)) {
         buflen = pr_config_get_server_xfer_bufsz(PR_NETIO_IO_WR);
       }
 
@@ -1582,10 +1783,328 @@ int pr_data_xfer(char *cl_buf, size_t cl_size) {
     session.total_bytes_out += total;
   }
 
+  data_add_net_usecs(start_usecs);
+
   destroy_pool(tmp_pool);
   return (len < 0 ? -1 : len);
 }
 
+#if defined(HAVE_SPLICE)
+static int splice_open_pipe(size_t count) {
+  int res;
+
+  if (pipe2(splice_pipe, O_CLOEXEC) < 0) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 3, "error creating splice pipe: %s",
+      strerror(xerrno));
+    splice_pipe[0] = splice_pipe[1] = -1;
+
+    errno = xerrno;
+    return -1;
+  }
+
+# if defined(F_SETPIPE_SZ)
+  /* Try to make the pipe big enough to hold a full transfer buffer. */
+  if (fcntl(splice_pipe[1], F_SETPIPE_SZ, (int) count) < 0) {
+    pr_trace_msg(trace_channel, 9, "unable to set splice pipe size to %lu: %s",
+      (unsigned long) count, strerror(errno));
+  }
+# endif /* F_SETPIPE_SZ */
+
+  res = -1;
+# if defined(F_GETPIPE_SZ)
+  res = fcntl(splice_pipe[1], F_GETPIPE_SZ);
+# endif /* F_GETPIPE_SZ */
+
+  splice_pipesz = (res > 0 ? (size_t) res : 4096);
+  pr_trace_msg(trace_channel, 9, "created splice pipe of %lu bytes",
+    (unsigned long) splice_pipesz);
+  return 0;
+}
+
+/* Copies any data left in the splice pipe into the given fd the usual way,
+ * for when splicing into that fd is not supported.
+ */
+static int splice_drain_pipe(int fd, size_t len) {
+  while (len > 0) {
+    ssize_t nread, nwritten, off;
+
+    nread = read(splice_pipe[0], session.xfer.buf,
+      len < session.xfer.bufsize ? len : session.xfer.bufsize);
+    if (nread < 0) {
+      if (errno == EINTR) {
+        pr_signals_handle();
+        continue;
+      }
+
+      return -1;
+    }
+
+    if (nread == 0) {
+      break;
+    }
+
+    off = 0;
+    while (off < nread) {
+      nwritten = write(fd, session.xfer.buf + off, nread - off);
+      if (nwritten < 0) {
+        if (errno == EINTR) {
+          pr_signals_handle();
+          continue;
+        }
+
+        return -1;
+      }
+
+      off += nwritten;
+    }
+
+    len -= nread;
+  }
+
+  return 0;
+}
+
+/* Discards any data left in the splice pipe, e.g. after a failed write,
+ * so that the pipe is empty for the next transfer.
+ */
+static void splice_clear_pipe(size_t len) {
+  char buf[4096];
+
+  while (len > 0) {
+    ssize_t nread;
+
+    nread = read(splice_pipe[0], buf, len < sizeof(buf) ? len : sizeof(buf));
+    if (nread <= 0) {
+      if (nread < 0 &&
+          errno == EINTR) {
+        continue;
+      }
+
+      break;
+    }
+
+    len -= nread;
+  }
+}
+
+/* pr_data_splice() moves uploaded data from the data connection directly
+ * into the given file descriptor, using splice(2) through a pipe, without
+ * copying the data through user space.  ASCII translation is not performed.
+ * Returns the number of bytes stored, 0 if the data connection closes, or
+ * -1 if error.  If writing to stor_fd failed, stor_errno is set to the
+ * error.  An ENOSYS error means that splicing is not possible here, and that
+ * no data were read; the caller should use pr_data_xfer() instead.
+ */
+int pr_data_splice(int stor_fd, size_t count, int *stor_errno) {
+  int fd;
+  ssize_t len, remaining;
+  uint64_t start_usecs = 0;
+
+  if (stor_fd < 0 ||
+      count == 0 ||
+      stor_errno == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  *stor_errno = 0;
+
+  if (session.xfer.direction != PR_NETIO_IO_RD) {
+    errno = EPERM;
+    return -1;
+  }
+
+  if (splice_disabled) {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  if (splice_pipe[0] < 0) {
+    if (splice_open_pipe(count) < 0) {
+      splice_disabled = TRUE;
+
+      errno = ENOSYS;
+      return -1;
+    }
+  }
+
+  /* Poll the control channel for any commands we should handle, like
+   * QUIT or ABOR.
+   */
+  poll_ctrl();
+
+  if (session.d == NULL) {
+    int xerrno;
+
+#if defined(ECONNABORTED)
+    xerrno = ECONNABORTED;
+#elif defined(ENOTCONN)
+    xerrno = ENOTCONN;
+#else
+    xerrno = EIO;
+#endif
+
+    pr_trace_msg(trace_channel, 1,
+      "data connection is null prior to data transfer (possibly from "
+      "aborted transfer), returning '%s' error", strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  if (count > splice_pipesz) {
+    count = splice_pipesz;
+  }
+
+  fd = PR_NETIO_FD(session.d->instrm);
+  pr_gettimeofday_micros(&start_usecs);
+
+  while (TRUE) {
+    int res;
+
+    /* Wait for data, honoring the usual timeouts and aborts. */
+    res = pr_netio_poll(session.d->instrm);
+    if (res != 0) {
+      if (res > 0) {
+        errno = EINTR;
+      }
+
+      return -1;
+    }
+
+    if (XFER_ABORTED) {
+      errno = EINTR;
+      return -1;
+    }
+
+    len = splice(fd, NULL, splice_pipe[1], NULL, count,
+      SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+    if (len < 0) {
+      int xerrno = errno;
+
+      if (xerrno == EAGAIN ||
+          xerrno == EINTR) {
+        errno = EINTR;
+        pr_signals_handle();
+        continue;
+      }
+
+      if (xerrno == EINVAL ||
+          xerrno == ENOSYS) {
+        pr_trace_msg(trace_channel, 3,
+          "unable to splice from data connection: %s", strerror(xerrno));
+        splice_disabled = TRUE;
+
+        errno = ENOSYS;
+        return -1;
+      }
+
+      session.d->instrm->strm_errno = xerrno;
+      errno = xerrno;
+      return -1;
+    }
+
+    break;
+  }
+
+  if (len == 0) {
+    /* EOF */
+    return 0;
+  }
+
+  pr_trace_msg(trace_channel, 19, "spliced %ld %s from network", (long) len,
+    len != 1 ? "bytes" : "byte");
+
+  if (data_first_byte_read == FALSE) {
+    if (pr_trace_get_level(timing_channel)) {
+      unsigned long elapsed_ms;
+      uint64_t read_ms;
+
+      pr_gettimeofday_millis(&read_ms);
+      elapsed_ms = (unsigned long) (read_ms - data_start_ms);
+
+      pr_trace_msg(timing_channel, 7,
+        "Time for first data byte read: %lu ms", elapsed_ms);
+    }
+
+    data_first_byte_read = TRUE;
+  }
+
+  if (timeout_stalled) {
+    pr_timer_reset(PR_TIMER_STALLED, ANY_MODULE);
+  }
+
+  /* Now move everything from the pipe into the file. */
+  remaining = len;
+  while (remaining > 0) {
+    ssize_t res;
+
+    res = splice(splice_pipe[0], NULL, stor_fd, NULL, remaining,
+      SPLICE_F_MOVE);
+    if (res < 0) {
+      int xerrno = errno;
+
+      if (xerrno == EINTR) {
+        pr_signals_handle();
+        continue;
+      }
+
+      if (xerrno == EINVAL ||
+          xerrno == ENOSYS) {
+        /* This file does not support splicing; write out what we have
+         * already read the usual way, and stop splicing.
+         */
+        pr_trace_msg(trace_channel, 3,
+          "unable to splice into fd %d: %s, falling back to write(2)",
+          stor_fd, strerror(xerrno));
+        splice_disabled = TRUE;
+
+        if (splice_drain_pipe(stor_fd, remaining) < 0) {
+          xerrno = errno;
+
+          splice_clear_pipe(remaining);
+          *stor_errno = xerrno;
+          errno = xerrno;
+          return -1;
+        }
+
+        break;
+      }
+
+      splice_clear_pipe(remaining);
+      *stor_errno = xerrno;
+      errno = xerrno;
+      return -1;
+    }
+
+    remaining -= res;
+  }
+
+  if (timeout_idle) {
+    pr_timer_reset(PR_TIMER_IDLE, ANY_MODULE);
+  }
+
+  session.xfer.total_bytes += len;
+  session.total_bytes += len;
+  session.total_bytes_in += len;
+  session.total_raw_in += len;
+
+  /* The kernel writes the spliced data to the file as well; all of that
+   * time is counted as network time.
+   */
+  data_add_net_usecs(start_usecs);
+
+  return (int) len;
+}
+#else
+int pr_data_splice(int stor_fd, size_t count, int *stor_errno) {
+  errno = ENOSYS;
+  return -1;
+}
+#endif /* HAVE_SPLICE */
+
 #if defined(HAVE_SENDFILE)
 /* pr_data_sendfile() actually transfers the data on the data connection.
  * ASCII translation is not performed.
@@ -1594,6 +2113,7 @@ int pr_data_xfer(char *cl_buf, size_t cl_size) {
 pr_sendfile_t pr_data_sendfile(int retr_fd, off_t *offset, off_t count) {
   int flags, error;
   pr_sendfile_t len = 0, total = 0;
+  uint64_t start_usecs = 0;
 # if defined(HAVE_AIX_SENDFILE)
   struct sf_parms parms;
   int rc;
@@ -1627,6 +2147,11 @@ pr_sendfile_t pr_data_sendfile(int retr_fd, off_t *offset, off_t count) {
     }
   }
 
+  /* The kernel reads the file for sendfile() as well; all of that time is
+   * counted as network time.
+   */
+  pr_gettimeofday_micros(&start_usecs);
+
   for (;;) {
 # if defined(HAVE_LINUX_SENDFILE) || defined(HAVE_SOLARIS_SENDFILE)
     off_t orig_offset = *offset;
@@ -1872,6 +2397,7 @@ pr_sendfile_t pr_data_sendfile(int retr_fd, off_t *offset, off_t count) {
   session.total_raw_out += len;
   total += len;
 
+  data_add_net_usecs(start_usecs);
   return total;
 }
 #else
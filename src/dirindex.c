@@ -0,0 +1,723 @@
+/*
+ * ProFTPD - FTP server daemon
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* <Directory> section matching, and the index of the <Directory> sections
+ * in large config sets.
+ */
+
+#include "conf.h"
+
+/* Index of the <Directory> sections in a large config set.  Each section is
+ * keyed, by the components of its path, in two tries: one for the literal
+ * paths matched by dir_match_path(), and one for the paths compared by
+ * find_best_dir() when reordering the sections.  Sections which cannot be
+ * keyed this way (e.g. globs, deferred paths) are kept in lists, and are
+ * checked as before.  Each set keeps its own index, in its XASET_INDEX_DIR
+ * slot, which is rebuilt once the set has changed.
+ */
+
+struct dir_index_ent {
+  config_rec *c;
+
+  /* The position of this section in the set. */
+  long pos;
+
+  /* TRUE once this section has been moved out of the set. */
+  int dead;
+
+  /* The next sections, in set order, with the same key (or in the same
+   * list of unkeyed sections).
+   */
+  struct dir_index_ent *match_next, *best_next;
+};
+
+struct dir_trie_node {
+  const char *comp;
+  size_t complen;
+
+  /* Child nodes, sorted by path component. */
+  struct dir_trie_node **kids;
+  unsigned int nkids, kidsz;
+
+  /* The sections whose key ends at this node. */
+  struct dir_index_ent *ents;
+};
+
+struct dir_index_rec {
+  pool *pool;
+  xaset_t *set;
+  unsigned long gen;
+
+  /* The position given to the next section inserted at the head of the
+   * set.
+   */
+  long head_pos;
+
+  struct dir_trie_node *match_root, *best_root;
+  struct dir_index_ent *match_others, *best_others;
+};
+
+static int dir_trie_cmp(const char *a, size_t alen, const char *b,
+    size_t blen) {
+  int res;
+
+  res = memcmp(a, b, alen < blen ? alen : blen);
+  if (res != 0 ||
+      alen == blen) {
+    return res;
+  }
+
+  return alen < blen ? -1 : 1;
+}
+
+static struct dir_trie_node *dir_trie_get_kid(struct dir_trie_node *node,
+    const char *comp, size_t complen, unsigned int *at) {
+  unsigned int lo = 0, hi = node->nkids;
+
+  while (lo < hi) {
+    unsigned int mid;
+    int res;
+
+    mid = lo + ((hi - lo) / 2);
+    res = dir_trie_cmp(comp, complen, node->kids[mid]->comp,
+      node->kids[mid]->complen);
+    if (res == 0) {
+      return node->kids[mid];
+    }
+
+    if (res < 0) {
+      hi = mid;
+
+    } else {
+      lo = mid + 1;
+    }
+  }
+
+  if (at != NULL) {
+    *at = lo;
+  }
+
+  return NULL;
+}
+
+static struct dir_trie_node *dir_trie_add_kid(pool *p,
+    struct dir_trie_node *node, const char *comp, size_t complen) {
+  struct dir_trie_node *kid;
+  unsigned int at = 0;
+
+  kid = dir_trie_get_kid(node, comp, complen, &at);
+  if (kid != NULL) {
+    return kid;
+  }
+
+  if (node->nkids == node->kidsz) {
+    struct dir_trie_node **kids;
+
+    node->kidsz = node->kidsz ? node->kidsz * 2 : 4;
+    kids = palloc(p, node->kidsz * sizeof(struct dir_trie_node *));
+    if (node->nkids > 0) {
+      memcpy(kids, node->kids, node->nkids * sizeof(struct dir_trie_node *));
+    }
+
+    node->kids = kids;
+  }
+
+  memmove(&(node->kids[at+1]), &(node->kids[at]),
+    (node->nkids - at) * sizeof(struct dir_trie_node *));
+
+  kid = pcalloc(p, sizeof(struct dir_trie_node));
+  kid->comp = pstrndup(p, comp, complen);
+  kid->complen = complen;
+  node->kids[at] = kid;
+  node->nkids++;
+
+  return kid;
+}
+
+/* Returns the node for the given key, splitting the key on '/'.  Note that
+ * empty path components (e.g. before a leading '/') are components too.  If
+ * a pool is given, any missing nodes are added.
+ */
+static struct dir_trie_node *dir_trie_get_node(pool *p,
+    struct dir_trie_node *root, const char *key, size_t keylen) {
+  struct dir_trie_node *node = root;
+
+  while (node != NULL) {
+    const char *end;
+    size_t complen;
+
+    end = memchr(key, '/', keylen);
+    complen = end ? (size_t) (end - key) : keylen;
+
+    if (p != NULL) {
+      node = dir_trie_add_kid(p, node, key, complen);
+
+    } else {
+      node = dir_trie_get_kid(node, key, complen, NULL);
+    }
+
+    if (end == NULL) {
+      break;
+    }
+
+    keylen -= (complen + 1);
+    key = end + 1;
+  }
+
+  return node;
+}
+
+/* Returns the length of the key under which dir_match_path() would match
+ * the given section, or -1 if the section's path is not a plain absolute
+ * path.
+ */
+static int dir_index_match_key(config_rec *c, size_t *keylen) {
+  size_t namelen;
+
+  if (c->argv[1] != NULL ||
+      (c->flags & CF_DEFER) ||
+      c->name == NULL ||
+      *c->name != '/' ||
+      strpbrk(c->name, "*?[\\") != NULL) {
+    return -1;
+  }
+
+  namelen = strlen(c->name);
+  if (namelen == 1) {
+    /* A path of just '/' matches every absolute path, i.e. every path
+     * starting with an empty component.
+     */
+    *keylen = 0;
+    return 0;
+  }
+
+  if (c->name[namelen-1] == '/') {
+    if (c->name[namelen-2] == '/') {
+      return -1;
+    }
+
+    /* Leave off the trailing path separator, as pr_dir_match_entry() would
+     * when checking this section.
+     */
+    namelen--;
+  }
+
+  *keylen = namelen;
+  return 0;
+}
+
+/* Returns the length of the key under which find_best_dir() compares the
+ * given section, or -1 if the section's path may yet change.
+ */
+static int dir_index_best_key(config_rec *c, size_t *keylen) {
+  size_t namelen;
+
+  if ((c->flags & CF_DEFER) ||
+      c->name == NULL) {
+    return -1;
+  }
+
+  namelen = strlen(c->name);
+  while (namelen > 0 &&
+         (c->name[namelen-1] == '*' || c->name[namelen-1] == '/')) {
+    namelen--;
+  }
+
+  *keylen = namelen;
+  return 0;
+}
+
+/* Sections are always added ahead of those already indexed; the index is
+ * built starting from the end of the set.
+ */
+static void dir_index_add(pr_dir_index_t *idx, struct dir_index_ent *ent) {
+  struct dir_trie_node *node;
+  size_t keylen = 0;
+
+  if (dir_index_match_key(ent->c, &keylen) == 0) {
+    node = dir_trie_get_node(idx->pool, idx->match_root, ent->c->name, keylen);
+    ent->match_next = node->ents;
+    node->ents = ent;
+
+  } else {
+    ent->match_next = idx->match_others;
+    idx->match_others = ent;
+  }
+
+  if (dir_index_best_key(ent->c, &keylen) == 0) {
+    node = dir_trie_get_node(idx->pool, idx->best_root, ent->c->name, keylen);
+    ent->best_next = node->ents;
+    node->ents = ent;
+
+  } else {
+    ent->best_next = idx->best_others;
+    idx->best_others = ent;
+  }
+}
+
+static pr_dir_index_t *dir_index_build(xaset_t *set, unsigned int count) {
+  pool *index_pool;
+  pr_dir_index_t *idx;
+  config_rec *c, **dirs;
+  unsigned int i = 0;
+
+  index_pool = make_sub_pool(set->pool);
+  pr_pool_tag(index_pool, "directory index pool");
+
+  idx = pcalloc(index_pool, sizeof(pr_dir_index_t));
+  idx->pool = index_pool;
+  idx->set = set;
+  idx->gen = set->xas_gen;
+  idx->match_root = pcalloc(index_pool, sizeof(struct dir_trie_node));
+  idx->best_root = pcalloc(index_pool, sizeof(struct dir_trie_node));
+
+  dirs = palloc(index_pool, count * sizeof(config_rec *));
+  for (c = (config_rec *) set->xas_list; c; c = c->next) {
+    if (c->config_type == CONF_DIR ||
+        c->config_type == CONF_DYNDIR) {
+      dirs[i++] = c;
+    }
+  }
+
+  while (i > 0) {
+    struct dir_index_ent *ent;
+
+    i--;
+    ent = pcalloc(index_pool, sizeof(struct dir_index_ent));
+    ent->c = dirs[i];
+    ent->pos = i;
+    dir_index_add(idx, ent);
+  }
+
+  pr_trace_msg("directory", 15, "indexed %u <Directory> sections for set %p",
+    count, set);
+  return idx;
+}
+
+pr_dir_index_t *pr_dir_index_lookup(xaset_t *set) {
+  pr_dir_index_t *idx;
+
+  if (set == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  idx = set->xas_indexes[XASET_INDEX_DIR];
+  if (idx != NULL &&
+      idx->gen == set->xas_gen) {
+    return idx;
+  }
+
+  errno = ENOENT;
+  return NULL;
+}
+
+pr_dir_index_t *pr_dir_index_get(xaset_t *set) {
+  pr_dir_index_t *idx;
+  unsigned int count = 0;
+  config_rec *c;
+
+  if (set == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  idx = pr_dir_index_lookup(set);
+  if (idx != NULL) {
+    return idx;
+  }
+
+  for (c = (config_rec *) set->xas_list; c; c = c->next) {
+    if (c->config_type == CONF_DIR ||
+        c->config_type == CONF_DYNDIR) {
+      count++;
+    }
+  }
+
+  if (count < PR_TUNABLE_DIR_INDEX_MIN) {
+    errno = ENOENT;
+    return NULL;
+  }
+
+  idx = set->xas_indexes[XASET_INDEX_DIR];
+  if (idx != NULL) {
+    destroy_pool(idx->pool);
+  }
+
+  idx = set->xas_indexes[XASET_INDEX_DIR] = dir_index_build(set, count);
+  return idx;
+}
+
+void pr_dir_index_remove(pr_dir_index_t *idx, config_rec *c) {
+  struct dir_index_ent *ent = NULL;
+  size_t keylen = 0;
+
+  if (idx == NULL ||
+      c == NULL) {
+    return;
+  }
+
+  if (dir_index_best_key(c, &keylen) == 0) {
+    struct dir_trie_node *node;
+
+    node = dir_trie_get_node(NULL, idx->best_root, c->name, keylen);
+    if (node != NULL) {
+      for (ent = node->ents; ent; ent = ent->best_next) {
+        if (ent->c == c) {
+          break;
+        }
+      }
+    }
+  }
+
+  if (ent == NULL) {
+    /* The section's path may have been resolved since it was indexed. */
+    for (ent = idx->best_others; ent; ent = ent->best_next) {
+      if (ent->c == c) {
+        break;
+      }
+    }
+  }
+
+  if (ent == NULL) {
+    /* Leave the index to be rebuilt. */
+    return;
+  }
+
+  ent->dead = TRUE;
+  idx->gen = idx->set->xas_gen;
+}
+
+void pr_dir_index_insert_head(pr_dir_index_t *idx, config_rec *c) {
+  struct dir_index_ent *ent;
+
+  if (idx == NULL ||
+      c == NULL) {
+    return;
+  }
+
+  ent = pcalloc(idx->pool, sizeof(struct dir_index_ent));
+  ent->c = c;
+  ent->pos = --idx->head_pos;
+  dir_index_add(idx, ent);
+
+  idx->gen = idx->set->xas_gen;
+}
+
+int pr_dir_match_entry(pool *p, config_rec *c, const char *path) {
+  char *suffixed_path = NULL, *tmp_path = NULL;
+  size_t path_len;
+
+  tmp_path = c->name;
+
+  if (c->argv[1]) {
+    if (*(char *)(c->argv[1]) == '~') {
+      c->argv[1] = dir_canonical_path(c->pool, (char *) c->argv[1]);
+    }
+
+    tmp_path = pdircat(p, (char *) c->argv[1], tmp_path, NULL);
+  }
+
+  /* Exact path match */
+  if (strcmp(tmp_path, path) == 0) {
+    return DIR_MATCH_EXACT;
+  }
+
+  /* Bug#3146 occurred because using strstr(3) works well for paths
+   * which DO NOT contain the glob sequence, i.e. we used to do:
+   *
+   *  if (strstr(tmp_path, slash_star) == NULL) {
+   *
+   * But what if they do, just not at the end of the path?
+   *
+   * The fix is to explicitly check the last two characters of the path
+   * for '/' and '*', rather than using strstr(3).  (Again, I wish there
+   * was a strrstr(3) libc function.)
+   */
+  path_len = strlen(tmp_path);
+  if (path_len >= 2 &&
+      !(tmp_path[path_len-2] == '/' && tmp_path[path_len-1] == '*')) {
+
+    /* Trim a trailing path separator, if present. */
+    if (*tmp_path &&
+        *(tmp_path + path_len - 1) == '/') {
+      *(tmp_path + path_len - 1) = '\0';
+      path_len--;
+
+      if (strcmp(tmp_path, path) == 0) {
+        return DIR_MATCH_EXACT;
+      }
+    }
+
+    suffixed_path = pdircat(p, tmp_path, "*", NULL);
+
+  } else if (path_len == 1) {
+    /* We still need to append the "*" if the path is just '/'. */
+    suffixed_path = pstrcat(p, tmp_path, "*", NULL);
+  }
+
+  if (suffixed_path == NULL) {
+    /* Default to treating the given path as the suffixed path */
+    suffixed_path = tmp_path;
+  }
+
+  pr_trace_msg("directory", 9,
+    "checking if <Directory %s> is a glob match for %s", tmp_path, path);
+
+  /* The flags argument here needs to include PR_FNM_PATHNAME in order
+   * to prevent globs from matching the '/' character.
+   *
+   * As per Bug#3491, we need to check if either a) the automatically
+   * suffixed path (i.e. with the slash-star pattern) is a pattern match,
+   * OR if b) the given path, as is, is a pattern match.
+   */
+
+  if (pr_fnmatch(suffixed_path, path, 0) == 0 ||
+      (pr_str_is_fnmatch(tmp_path) &&
+       pr_fnmatch(tmp_path, path, 0) == 0)) {
+    pr_trace_msg("directory", 8,
+      "<Directory %s> is a glob match for '%s'", tmp_path, path);
+    return DIR_MATCH_GLOB;
+  }
+
+  return DIR_MATCH_NONE;
+}
+
+config_rec *pr_dir_index_match_path(pool *p, pr_dir_index_t *idx,
+    const char *path, int *match) {
+  struct dir_index_ent *best = NULL, *ent;
+  struct dir_trie_node *node;
+  const char *ptr = path;
+  size_t keylen = 0, pathlen;
+
+  if (p == NULL ||
+      idx == NULL ||
+      path == NULL ||
+      match == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  node = idx->match_root;
+
+  /* Every section whose key is a prefix, by component, of the path is a
+   * match; we want the first of them in the set.
+   */
+  pathlen = strlen(path);
+  while (node != NULL) {
+    const char *end;
+    size_t complen;
+
+    end = memchr(ptr, '/', pathlen);
+    complen = end ? (size_t) (end - ptr) : pathlen;
+
+    node = dir_trie_get_kid(node, ptr, complen, NULL);
+    if (node == NULL) {
+      break;
+    }
+
+    for (ent = node->ents; ent; ent = ent->match_next) {
+      if (ent->dead == FALSE &&
+          ent->c->config_type == CONF_DIR) {
+        if (best == NULL ||
+            ent->pos < best->pos) {
+          best = ent;
+        }
+
+        break;
+      }
+    }
+
+    if (end == NULL) {
+      break;
+    }
+
+    pathlen -= (complen + 1);
+    ptr = end + 1;
+  }
+
+  /* Any unkeyed section ahead of that match still needs to be checked. */
+  for (ent = idx->match_others; ent; ent = ent->match_next) {
+    pr_signals_handle();
+
+    if (best != NULL &&
+        ent->pos > best->pos) {
+      break;
+    }
+
+    if (ent->dead == FALSE &&
+        ent->c->config_type == CONF_DIR) {
+      *match = pr_dir_match_entry(p, ent->c, path);
+      if (*match != DIR_MATCH_NONE) {
+        return ent->c;
+      }
+    }
+  }
+
+  if (best == NULL) {
+    *match = DIR_MATCH_NONE;
+    errno = ENOENT;
+    return NULL;
+  }
+
+  /* The key may leave off a trailing path separator from the name. */
+  (void) dir_index_match_key(best->c, &keylen);
+  if (strcmp(best->c->name, path) == 0 ||
+      (strncmp(best->c->name, path, keylen) == 0 &&
+       path[keylen] == '\0' &&
+       keylen > 0)) {
+    *match = DIR_MATCH_EXACT;
+
+  } else {
+    pr_trace_msg("directory", 8,
+      "<Directory %s> is a glob match for '%s'", best->c->name, path);
+    *match = DIR_MATCH_GLOB;
+  }
+
+  return best->c;
+}
+
+
+int pr_dir_is_parent(config_rec *c, const char *path, size_t pathlen) {
+  size_t len;
+
+  len = strlen(c->name);
+
+  /* Do NOT change the zero here to a one; the expression IS correct. */
+  while (len > 0 &&
+         (*(c->name+len-1) == '*' || *(c->name+len-1) == '/')) {
+    len--;
+  }
+
+  /* Just a partial match on the pathname does not mean that the longer
+   * path is the subdirectory of the other -- they might just be sharing
+   * the last path component!
+   * /var/www/.1
+   * /var/www/.14
+   *            ^ -- not /, not subdir
+   * /var/www/.1
+   * /var/www/.1/images
+   *            ^ -- /, is subdir
+   *
+   * And then there are glob considerations, e.g.:
+   *
+   *   /var/www/<glob>/dir2
+   *   /var/www/dir1/dir2
+   *
+   * In these cases, we need to make sure that the glob path appears
+   * BEFORE the exact path.  Right?
+   */
+  if (pathlen > len &&
+      path[len] != '/') {
+    return FALSE;
+  }
+
+  if (len < pathlen &&
+      strncmp(c->name, path, len) == 0) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+
+array_header *pr_dir_index_get_parents(pool *p, pr_dir_index_t *idx,
+    char *path, size_t pathlen) {
+  array_header *ents, *dirs;
+  struct dir_index_ent *ent;
+  struct dir_trie_node *node;
+  const char *ptr = path;
+  register unsigned int i;
+
+  if (p == NULL ||
+      idx == NULL ||
+      path == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  node = idx->best_root;
+  ents = make_array(p, 0, sizeof(struct dir_index_ent *));
+
+  /* Every section whose key is a proper prefix, by component, of the path
+   * is a parent.
+   */
+  while (node != NULL) {
+    const char *end;
+    size_t complen;
+
+    end = memchr(ptr, '/', pathlen);
+    if (end == NULL) {
+      break;
+    }
+
+    complen = end - ptr;
+    node = dir_trie_get_kid(node, ptr, complen, NULL);
+    if (node == NULL) {
+      break;
+    }
+
+    for (ent = node->ents; ent; ent = ent->best_next) {
+      if (ent->dead == FALSE &&
+          ent->c->config_type == CONF_DIR &&
+          ent->c->name != path) {
+        *((struct dir_index_ent **) push_array(ents)) = ent;
+      }
+    }
+
+    pathlen -= (complen + 1);
+    ptr = end + 1;
+  }
+
+  for (ent = idx->best_others; ent; ent = ent->best_next) {
+    if (ent->dead == FALSE &&
+        ent->c->config_type == CONF_DIR &&
+        ent->c->name != path &&
+        pr_dir_is_parent(ent->c, path, strlen(path)) == TRUE) {
+      *((struct dir_index_ent **) push_array(ents)) = ent;
+    }
+  }
+
+  /* There are only ever a few parents; sort them back into set order. */
+  for (i = 1; i < ents->nelts; i++) {
+    struct dir_index_ent **elts = ents->elts;
+    register unsigned int j;
+
+    ent = elts[i];
+    for (j = i; j > 0 && elts[j-1]->pos > ent->pos; j--) {
+      elts[j] = elts[j-1];
+    }
+
+    elts[j] = ent;
+  }
+
+  dirs = make_array(p, ents->nelts, sizeof(config_rec *));
+  for (i = 0; i < ents->nelts; i++) {
+    ent = ((struct dir_index_ent **) ents->elts)[i];
+    *((config_rec **) push_array(dirs)) = ent->c;
+  }
+
+  return dirs;
+}
+
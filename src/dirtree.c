@@ -448,114 +448,57 @@ static size_t _strmatch(register char *s1, register char *s2) {
 }
 
 static config_rec *recur_match_path(pool *p, xaset_t *s, char *path) {
-  char *suffixed_path = NULL, *tmp_path = NULL;
+  pr_dir_index_t *idx;
   config_rec *c = NULL, *res = NULL;
+  int match = DIR_MATCH_NONE;
 
   if (!s) {
     errno = EINVAL;
     return NULL;
   }
 
-  for (c = (config_rec *) s->xas_list; c; c = c->next) {
-    if (c->config_type == CONF_DIR) {
-      size_t path_len;
-
-      tmp_path = c->name;
-
-      if (c->argv[1]) {
-        if (*(char *)(c->argv[1]) == '~') {
-          c->argv[1] = dir_canonical_path(c->pool, (char *) c->argv[1]);
-        }
-
-        tmp_path = pdircat(p, (char *) c->argv[1], tmp_path, NULL);
-      }
+  idx = pr_dir_index_get(s);
+  if (idx != NULL) {
+    c = pr_dir_index_match_path(p, idx, path, &match);
 
-      /* Exact path match */
-      if (strcmp(tmp_path, path) == 0) {
-        pr_trace_msg("directory", 8,
-          "<Directory %s> is an exact path match for '%s'", c->name, path);
-        return c;
-      }
-
-      /* Bug#3146 occurred because using strstr(3) works well for paths
-       * which DO NOT contain the glob sequence, i.e. we used to do:
-       *
-       *  if (strstr(tmp_path, slash_star) == NULL) {
-       *
-       * But what if they do, just not at the end of the path?
-       *
-       * The fix is to explicitly check the last two characters of the path
-       * for '/' and '*', rather than using strstr(3).  (Again, I wish there
-       * was a strrstr(3) libc function.)
-       */
-      path_len = strlen(tmp_path);
-      if (path_len >= 2 &&
-          !(tmp_path[path_len-2] == '/' && tmp_path[path_len-1] == '*')) {
-
-        /* Trim a trailing path separator, if present. */
-        if (*tmp_path &&
-            *(tmp_path + path_len - 1) == '/') {
-          *(tmp_path + path_len - 1) = '\0';
-          path_len--;
-
-          if (strcmp(tmp_path, path) == 0) {
-            pr_trace_msg("directory", 8,
-              "<Directory %s> is an exact path match for '%s'", c->name, path);
-            return c;
-          }
+  } else {
+    for (c = (config_rec *) s->xas_list; c; c = c->next) {
+      if (c->config_type == CONF_DIR) {
+        match = pr_dir_match_entry(p, c, path);
+        if (match != DIR_MATCH_NONE) {
+          break;
         }
-
-        suffixed_path = pdircat(p, tmp_path, "*", NULL);
-
-      } else if (path_len == 1) {
-        /* We still need to append the "*" if the path is just '/'. */
-        suffixed_path = pstrcat(p, tmp_path, "*", NULL);
-      }
-
-      if (suffixed_path == NULL) {
-        /* Default to treating the given path as the suffixed path */
-        suffixed_path = tmp_path;
       }
+    }
+  }
 
-      pr_trace_msg("directory", 9,
-        "checking if <Directory %s> is a glob match for %s", tmp_path, path);
-
-      /* The flags argument here needs to include PR_FNM_PATHNAME in order
-       * to prevent globs from matching the '/' character.
-       *
-       * As per Bug#3491, we need to check if either a) the automatically
-       * suffixed path (i.e. with the slash-star pattern) is a pattern match,
-       * OR if b) the given path, as is, is a pattern match.
-       */
-
-      if (pr_fnmatch(suffixed_path, path, 0) == 0 ||
-          (pr_str_is_fnmatch(tmp_path) &&
-           pr_fnmatch(tmp_path, path, 0) == 0)) {
-        pr_trace_msg("directory", 8,
-          "<Directory %s> is a glob match for '%s'", tmp_path, path);
+  if (c == NULL) {
+    errno = ENOENT;
+    return NULL;
+  }
 
-        if (c->subset) {
-          /* If there's a subset config, check to see if there's a closer
-           * match there.
-           */
-          res = recur_match_path(p, c->subset, path);
-          if (res) {
-            pr_trace_msg("directory", 8,
-              "found closer matching <Directory %s> for '%s' in <Directory %s> "
-              "sub-config", res->name, path, tmp_path);
-            return res;
-          }
-        }
+  if (match == DIR_MATCH_EXACT) {
+    pr_trace_msg("directory", 8,
+      "<Directory %s> is an exact path match for '%s'", c->name, path);
+    return c;
+  }
 
-        pr_trace_msg("directory", 8, "found <Directory %s> for '%s'",
-          c->name, path);
-        return c;
-      }
+  if (c->subset) {
+    /* If there's a subset config, check to see if there's a closer
+     * match there.
+     */
+    res = recur_match_path(p, c->subset, path);
+    if (res) {
+      pr_trace_msg("directory", 8,
+        "found closer matching <Directory %s> for '%s' in <Directory %s> "
+        "sub-config", res->name, path, c->name);
+      return res;
     }
   }
 
-  errno = ENOENT;
-  return NULL;
+  pr_trace_msg("directory", 8, "found <Directory %s> for '%s'",
+    c->name, path);
+  return c;
 }
 
 config_rec *dir_match_path(pool *p, char *path) {
@@ -1472,6 +1415,39 @@ int dir_check_limits(cmd_rec *cmd, config_rec *c, const char *cmd_name,
   return res;
 }
 
+/* Returns the parent directory of the given directory path, modifying the
+ * path, or NULL once the top has been reached.
+ */
+static char *dyn_config_parent_dir(char *curr_dir_path) {
+  char *ptr;
+
+  /* Remove the last path component of current directory path. */
+  ptr = strrchr(curr_dir_path, '/');
+  if (ptr != NULL) {
+    /* We need to handle the case where path might be "/path".  We
+     * can't just set *ptr to '\0', as that would result in the empty
+     * string.  Thus check if ptr is the same value as curr_dir_path, i.e.
+     * that ptr points to the start of the string.  If so, by definition
+     * we know that we are dealing with the "/path" case.
+     */
+    if (ptr == curr_dir_path) {
+      if (strcmp(curr_dir_path, "/") == 0) {
+        /* We've reached the top; stop scanning. */
+        return NULL;
+      }
+
+      *(ptr+1) = '\0';
+
+    } else {
+      *ptr = '\0';
+    }
+
+    return curr_dir_path;
+  }
+
+  return NULL;
+}
+
 /* Manage .ftpaccess dynamic directory sections
  *
  * build_dyn_config() is called to check for and then handle .ftpaccess 
@@ -1610,12 +1586,27 @@ void build_dyn_config(pool *p, const char *_path, struct stat *stp,
     if (ftpaccess_path != NULL) {
       pr_trace_msg("ftpaccess", 6, "checking for .ftpaccess file '%s'",
         ftpaccess_path);
-      isfile = pr_fsio_stat(ftpaccess_path, &st);
+      isfile = pr_ftpaccess_stat(ftpaccess_name, ftpaccess_path, &st);
 
     } else {
       isfile = -1;
     }
 
+    if (pr_ftpaccess_is_current(ftpaccess_name) == TRUE) {
+      /* Neither this .ftpaccess file, nor any .ftpaccess config, has changed
+       * since this directory was last checked.
+       */
+      pr_trace_msg("ftpaccess", 9, "no changes to config for '%s'",
+        ftpaccess_name);
+
+      if (!recurse) {
+        break;
+      }
+
+      curr_dir_path = dyn_config_parent_dir(curr_dir_path);
+      continue;
+    }
+
     d = dir_match_path(p, ftpaccess_name);
 
     if (!d &&
@@ -1630,6 +1621,7 @@ void build_dyn_config(pool *p, const char *_path, struct stat *stp,
       d->config_type = CONF_DIR;
       d->argc = 1;
       d->argv = pcalloc(d->pool, 2 * sizeof (void *));
+      pr_ftpaccess_changed();
 
     } else if (d) {
       config_rec *newd, *dnext;
@@ -1648,6 +1640,7 @@ void build_dyn_config(pool *p, const char *_path, struct stat *stp,
 	newd->parent = d;
 
         d = newd;
+        pr_ftpaccess_changed();
 
       } else if (strcmp(d->name, ftpaccess_name) == 0 &&
           (isfile == -1 ||
@@ -1665,6 +1658,7 @@ void build_dyn_config(pool *p, const char *_path, struct stat *stp,
             if (newd->flags & CF_DYNAMIC) {
               xaset_remove(d->subset, (xasetmember_t *) newd);
               removed++;
+              pr_ftpaccess_changed();
             }
           }
 	}
@@ -1674,6 +1668,7 @@ void build_dyn_config(pool *p, const char *_path, struct stat *stp,
           destroy_pool(d->subset->pool);
           d->subset = NULL;
           d->argv[0] = NULL;
+          pr_ftpaccess_changed();
 
 	  /* If the file has been removed and no entries exist in this
            * dynamic entry, remove it completely.
@@ -1694,6 +1689,7 @@ void build_dyn_config(pool *p, const char *_path, struct stat *stp,
       /* File has been modified or not loaded yet */
       d->argv[0] = pcalloc(d->pool, sizeof(time_t));
       *((time_t *) d->argv[0]) = st.st_mtime;
+      pr_ftpaccess_changed();
 
       d->config_type = CONF_DYNDIR;
 
@@ -1729,35 +1725,13 @@ void build_dyn_config(pool *p, const char *_path, struct stat *stp,
       pr_config_merge_down(*set, FALSE);
     }
 
+    pr_ftpaccess_set_current(ftpaccess_name);
+
     if (!recurse) {
       break;
     }
 
-    /* Remove the last path component of current directory path. */
-    ptr = strrchr(curr_dir_path, '/');
-    if (ptr != NULL) {
-      /* We need to handle the case where path might be "/path".  We
-       * can't just set *ptr to '\0', as that would result in the empty
-       * string.  Thus check if ptr is the same value as curr_dir_path, i.e.
-       * that ptr points to the start of the string.  If so, by definition
-       * we know that we are dealing with the "/path" case.
-       */
-      if (ptr == curr_dir_path) {
-        if (strcmp(curr_dir_path, "/") == 0) {
-          /* We've reached the top; stop scanning. */
-          curr_dir_path = NULL;
-
-        } else {
-          *(ptr+1) = '\0';
-        }
-
-      } else {
-        *ptr = '\0';
-      }
-
-    } else {
-      curr_dir_path = NULL;
-    }
+    curr_dir_path = dyn_config_parent_dir(curr_dir_path);
   }
 }
 
@@ -1774,8 +1748,8 @@ void build_dyn_config(pool *p, const char *_path, struct stat *stp,
  * .dotfile".
  */
 
-int dir_check_full(pool *pp, cmd_rec *cmd, const char *group, const char *path,
-    int *hidden) {
+static int check_dir_full(pool *pp, cmd_rec *cmd, const char *group,
+    const char *path, struct stat *pst, int *hidden) {
   char *fullpath, *owner;
   config_rec *c;
   struct stat st;
@@ -1805,9 +1779,15 @@ int dir_check_full(pool *pp, cmd_rec *cmd, const char *group, const char *path,
   }
 
   /* Check and build all appropriate dynamic configuration entries */
-  isfile = pr_fsio_stat(path, &st);
-  if (isfile < 0) {
-    memset(&st, '\0', sizeof(st));
+  if (pst != NULL) {
+    memcpy(&st, pst, sizeof(struct stat));
+    isfile = 0;
+
+  } else {
+    isfile = pr_fsio_stat(path, &st);
+    if (isfile < 0) {
+      memset(&st, '\0', sizeof(st));
+    }
   }
 
   build_dyn_config(p, path, &st, TRUE);
@@ -1942,6 +1922,11 @@ int dir_check_full(pool *pp, cmd_rec *cmd, const char *group, const char *path,
   return res;
 }
 
+int dir_check_full(pool *pp, cmd_rec *cmd, const char *group, const char *path,
+    int *hidden) {
+  return check_dir_full(pp, cmd, group, path, NULL, hidden);
+}
+
 /* dir_check() checks the current dir configuration against the path,
  * if it matches (partially), a search is done only in the subconfig,
  * otherwise handed off to dir_check_full
@@ -1949,6 +1934,11 @@ int dir_check_full(pool *pp, cmd_rec *cmd, const char *group, const char *path,
 
 int dir_check(pool *pp, cmd_rec *cmd, const char *group, const char *path,
     int *hidden) {
+  return dir_check2(pp, cmd, group, path, NULL, hidden);
+}
+
+int dir_check2(pool *pp, cmd_rec *cmd, const char *group, const char *path,
+    struct stat *pst, int *hidden) {
   char *fullpath, *owner;
   config_rec *c;
   struct stat st;
@@ -1977,13 +1967,19 @@ int dir_check(pool *pp, cmd_rec *cmd, const char *group, const char *path,
   if (c == NULL ||
       strncmp(c->name, fullpath, strlen(c->name)) != 0) {
     destroy_pool(p);
-    return dir_check_full(pp, cmd, group, path, hidden);
+    return check_dir_full(pp, cmd, group, path, pst, hidden);
   }
 
   /* Check and build all appropriate dynamic configuration entries */
-  isfile = pr_fsio_stat(path, &st);
-  if (isfile < 0) {
-    memset(&st, 0, sizeof(st));
+  if (pst != NULL) {
+    memcpy(&st, pst, sizeof(struct stat));
+    isfile = 0;
+
+  } else {
+    isfile = pr_fsio_stat(path, &st);
+    if (isfile < 0) {
+      memset(&st, 0, sizeof(st));
+    }
   }
 
   build_dyn_config(p, path, &st, FALSE);
@@ -2144,12 +2140,33 @@ static void reparent_all(config_rec *newparent, xaset_t *set) {
   }
 }
 
+static config_rec *find_best_dir(xaset_t *, char *, size_t *);
+
+static void best_dir_check(config_rec *c, char *path, config_rec **res,
+    size_t *matchlen) {
+  config_rec *rres;
+  size_t imatchlen, tmatchlen;
+
+  rres = find_best_dir(c->subset ,path, &imatchlen);
+  tmatchlen = _strmatch(path, c->name);
+  if (!rres &&
+      tmatchlen > *matchlen) {
+    *res = c;
+    *matchlen = tmatchlen;
+
+  } else if (imatchlen > *matchlen) {
+    *res = rres;
+    *matchlen = imatchlen;
+  }
+}
+
 /* Recursively find the most appropriate place to move a CONF_DIR
  * directive to.
  */
 static config_rec *find_best_dir(xaset_t *set, char *path, size_t *matchlen) {
-  config_rec *c, *res = NULL, *rres;
-  size_t len, pathlen, imatchlen, tmatchlen;
+  config_rec *c, *res = NULL;
+  pr_dir_index_t *idx;
+  size_t pathlen;
 
   *matchlen = 0;
 
@@ -2161,6 +2178,27 @@ static config_rec *find_best_dir(xaset_t *set, char *path, size_t *matchlen) {
 
   pathlen = strlen(path);
 
+  idx = pr_dir_index_get(set);
+  if (idx != NULL) {
+    pool *tmp_pool;
+    array_header *dirs;
+    register unsigned int i;
+
+    tmp_pool = make_sub_pool(set->pool);
+    pr_pool_tag(tmp_pool, "find_best_dir() pool");
+
+    dirs = pr_dir_index_get_parents(tmp_pool, idx, path, pathlen);
+    for (i = 0; i < dirs->nelts; i++) {
+      pr_signals_handle();
+
+      c = ((config_rec **) dirs->elts)[i];
+      best_dir_check(c, path, &res, matchlen);
+    }
+
+    destroy_pool(tmp_pool);
+    return res;
+  }
+
   for (c = (config_rec *) set->xas_list; c; c = c->next) {
     pr_signals_handle();
 
@@ -2179,50 +2217,8 @@ static config_rec *find_best_dir(xaset_t *set, char *path, size_t *matchlen) {
         continue;
       }
 
-      len = strlen(c->name);
-
-      /* Do NOT change the zero here to a one; the expression IS correct. */
-      while (len > 0 &&
-             (*(c->name+len-1) == '*' || *(c->name+len-1) == '/')) {
-        len--;
-      }
-
-      /* Just a partial match on the pathname does not mean that the longer
-       * path is the subdirectory of the other -- they might just be sharing
-       * the last path component!
-       * /var/www/.1
-       * /var/www/.14
-       *            ^ -- not /, not subdir
-       * /var/www/.1
-       * /var/www/.1/images
-       *            ^ -- /, is subdir
-       *
-       * And then there are glob considerations, e.g.:
-       *
-       *   /var/www/<glob>/dir2
-       *   /var/www/dir1/dir2
-       *
-       * In these cases, we need to make sure that the glob path appears
-       * BEFORE the exact path.  Right?
-       */
-      if (pathlen > len &&
-          path[len] != '/') {
-        continue;
-      }
-
-      if (len < pathlen &&
-          strncmp(c->name, path, len) == 0) {
-        rres = find_best_dir(c->subset ,path, &imatchlen);
-        tmatchlen = _strmatch(path, c->name);
-        if (!rres &&
-            tmatchlen > *matchlen) {
-          res = c;
-          *matchlen = tmatchlen;
-
-        } else if (imatchlen > *matchlen) {
-          res = rres;
-          *matchlen = imatchlen;
-        }
+      if (pr_dir_is_parent(c, path, pathlen) == TRUE) {
+        best_dir_check(c, path, &res, matchlen);
       }
     }
   }
@@ -2236,6 +2232,7 @@ static config_rec *find_best_dir(xaset_t *set, char *path, size_t *matchlen) {
 
 static void reorder_dirs(xaset_t *set, int flags) {
   config_rec *c = NULL, *cnext = NULL, *newparent = NULL;
+  pr_dir_index_t *idx;
   int defer = 0;
   size_t tmp;
 
@@ -2285,8 +2282,21 @@ static void reorder_dirs(xaset_t *set, int flags) {
             newparent->subset = xaset_create(newparent->pool, NULL);
           }
 
+          /* Keep any indexes of these sets current, rather than having them
+           * rebuilt for every section moved.
+           */
+          idx = pr_dir_index_lookup(c->set);
           xaset_remove(c->set, (xasetmember_t *) c);
+          if (idx != NULL) {
+            pr_dir_index_remove(idx, c);
+          }
+
+          idx = pr_dir_index_lookup(newparent->subset);
           xaset_insert(newparent->subset, (xasetmember_t *) c);
+          if (idx != NULL) {
+            pr_dir_index_insert_head(idx, c);
+          }
+
           c->set = newparent->subset;
           c->parent = newparent;
         }
@@ -2530,6 +2540,9 @@ void fixup_dirs(server_rec *s, int flags) {
   /* Merge mergeable configuration items down. */
   pr_config_merge_down(s->conf, FALSE);
 
+  /* Index the <Directory> sections now, rather than in each session. */
+  (void) pr_dir_index_get(s->conf);
+
   if (!(flags & CF_SILENT)) {
     pr_log_debug(DEBUG5, "%s", "");
     pr_log_debug(DEBUG5, "Config for %s:", s->ServerName);
@@ -2816,6 +2829,8 @@ void init_dirtree(void) {
   pool *dirtree_pool = make_sub_pool(permanent_pool);
   pr_pool_tag(dirtree_pool, "Dirtree Pool");
 
+  pr_ftpaccess_clear();
+
   if (server_list) {
     server_rec *s, *s_next;
 
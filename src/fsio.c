@@ -1220,6 +1220,19 @@ static xaset_t *lstat_statcache_set = NULL;
 #define fs_cache_lstat(f, p, s) cache_stat((f), (p), (s), FSIO_FILE_LSTAT)
 #define fs_cache_stat(f, p, s) cache_stat((f), (p), (s), FSIO_FILE_STAT)
 
+static pr_table_t *fs_statcache_alloc_tab(void) {
+  pr_table_t *cache_tab;
+  int backend = PR_TABLE_BACKEND_OPEN_ADDR;
+
+  /* The statcache can hold many paths over a long session; use the backend
+   * which grows with it.
+   */
+  cache_tab = pr_table_alloc(statcache_pool, 0);
+  (void) pr_table_ctl(cache_tab, PR_TABLE_CTL_SET_BACKEND, &backend);
+
+  return cache_tab;
+}
+
 static const struct fs_statcache *fs_statcache_get(pr_table_t *cache_tab,
     xaset_t *cache_set, const char *path, size_t path_len, time_t now) {
   const struct fs_statcache *sc = NULL;
@@ -1693,10 +1706,10 @@ void pr_fs_statcache_reset(void) {
     pr_pool_tag(statcache_pool, "FS Statcache Pool");
   }
 
-  stat_statcache_tab = pr_table_alloc(statcache_pool, 0);
+  stat_statcache_tab = fs_statcache_alloc_tab();
   stat_statcache_set = xaset_create(statcache_pool, NULL);
 
-  lstat_statcache_tab = pr_table_alloc(statcache_pool, 0);
+  lstat_statcache_tab = fs_statcache_alloc_tab();
   lstat_statcache_set = xaset_create(statcache_pool, NULL);
 }
 
@@ -7421,9 +7434,9 @@ int init_fs(void) {
   /* Prepare the stat cache as well. */
   statcache_pool = make_sub_pool(permanent_pool);
   pr_pool_tag(statcache_pool, "FS Statcache Pool");
-  stat_statcache_tab = pr_table_alloc(statcache_pool, 0);
+  stat_statcache_tab = fs_statcache_alloc_tab();
   stat_statcache_set = xaset_create(statcache_pool, NULL);
-  lstat_statcache_tab = pr_table_alloc(statcache_pool, 0);
+  lstat_statcache_tab = fs_statcache_alloc_tab();
   lstat_statcache_set = xaset_create(statcache_pool, NULL);
 
   return 0;
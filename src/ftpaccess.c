@@ -0,0 +1,223 @@
+/*
+ * ProFTPD - FTP server daemon
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* Per-session record of .ftpaccess checks. */
+
+#include "conf.h"
+
+/* Per-session record of the checks for an .ftpaccess file in a directory,
+ * keyed by the directory's absolute path.  Within PR_TUNABLE_DYN_CONFIG_MAX_AGE
+ * seconds, the stat(2) of the .ftpaccess file is reused; after that, the
+ * file is checked again, and only if its device, inode, mtime or size (or
+ * its existence) changed does the directory's config need updating.
+ *
+ * Note that this means that changes made to an .ftpaccess file by anything
+ * other than this session (e.g. another session, or a shell user) may not
+ * be seen for up to PR_TUNABLE_DYN_CONFIG_MAX_AGE seconds.  Changes made by
+ * this session are seen at once, via the fs.statcache.clear event.
+ */
+struct dyn_config_dir {
+  time_t checked;
+  int present;
+  struct stat st;
+
+  /* The dyn_config_gen value once this directory's config was up to date,
+   * or zero if it needs updating.
+   */
+  unsigned long config_gen;
+};
+
+static pool *dyn_config_pool = NULL;
+static pr_table_t *dyn_config_tab = NULL;
+static const config_rec *dyn_config_anon = NULL;
+
+/* Changes whenever any .ftpaccess config is added, removed, or parsed. */
+static unsigned long dyn_config_gen = 1;
+
+static const char *trace_channel = "ftpaccess";
+
+static void dyn_config_clear_ev(const void *event_data, void *user_data) {
+  const char *path, *name;
+
+  if (dyn_config_tab == NULL) {
+    return;
+  }
+
+  /* Of the paths changed in this session, only .ftpaccess files matter. */
+  path = event_data;
+  if (path != NULL) {
+    name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+
+    if (strcmp(name, ".ftpaccess") != 0) {
+      return;
+    }
+  }
+
+  pr_trace_msg(trace_channel, 9, "clearing .ftpaccess checks for '%s'",
+    path ? path : "(all)");
+  pr_ftpaccess_clear();
+}
+
+static void dyn_config_cleanup_cb(void *data) {
+  dyn_config_pool = NULL;
+  dyn_config_tab = NULL;
+  dyn_config_anon = NULL;
+}
+
+static struct dyn_config_dir *dyn_config_get_dir(const char *name) {
+  static int registered_ev = FALSE;
+  struct dyn_config_dir *dir;
+
+  if (PR_TUNABLE_DYN_CONFIG_MAX_AGE == 0) {
+    return NULL;
+  }
+
+  if (dyn_config_tab != NULL &&
+      (dyn_config_anon != session.anon_config ||
+       pr_table_count(dyn_config_tab) >= PR_TUNABLE_DYN_CONFIG_MAX_DIRS)) {
+    pr_ftpaccess_clear();
+  }
+
+  if (dyn_config_tab == NULL) {
+    dyn_config_pool = make_sub_pool(permanent_pool);
+    pr_pool_tag(dyn_config_pool, ".ftpaccess Check Pool");
+    register_cleanup2(dyn_config_pool, NULL, dyn_config_cleanup_cb);
+
+    dyn_config_tab = pr_table_alloc(dyn_config_pool, 0);
+    dyn_config_anon = session.anon_config;
+
+    if (registered_ev == FALSE) {
+      pr_event_register(NULL, "fs.statcache.clear", dyn_config_clear_ev,
+        NULL);
+      registered_ev = TRUE;
+    }
+  }
+
+  dir = (struct dyn_config_dir *) pr_table_get(dyn_config_tab, name, NULL);
+  if (dir == NULL) {
+    dir = pcalloc(dyn_config_pool, sizeof(struct dyn_config_dir));
+    if (pr_table_add(dyn_config_tab, pstrdup(dyn_config_pool, name), dir,
+        sizeof(struct dyn_config_dir *)) < 0) {
+      return NULL;
+    }
+  }
+
+  return dir;
+}
+
+int pr_ftpaccess_stat(const char *dir_name, const char *path,
+    struct stat *st) {
+  struct dyn_config_dir *dir;
+  time_t now;
+  int res, present;
+
+  if (dir_name == NULL ||
+      path == NULL ||
+      st == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  dir = dyn_config_get_dir(dir_name);
+
+  time(&now);
+
+  if (dir != NULL &&
+      dir->checked > 0 &&
+      (now - dir->checked) < PR_TUNABLE_DYN_CONFIG_MAX_AGE) {
+    if (dir->present == FALSE) {
+      errno = ENOENT;
+      return -1;
+    }
+
+    memcpy(st, &(dir->st), sizeof(struct stat));
+    return 0;
+  }
+
+  res = pr_fsio_stat(path, st);
+  if (dir == NULL) {
+    return res;
+  }
+
+  present = (res == 0);
+  if (present != dir->present ||
+      (present &&
+       (st->st_dev != dir->st.st_dev ||
+        st->st_ino != dir->st.st_ino ||
+        st->st_mtime != dir->st.st_mtime ||
+        st->st_size != dir->st.st_size))) {
+    dir->present = present;
+    if (present) {
+      memcpy(&(dir->st), st, sizeof(struct stat));
+    }
+
+    dir->config_gen = 0;
+  }
+
+  dir->checked = now;
+  return res;
+}
+
+int pr_ftpaccess_is_current(const char *dir_name) {
+  struct dyn_config_dir *dir;
+
+  if (dir_name == NULL ||
+      dyn_config_tab == NULL) {
+    return FALSE;
+  }
+
+  dir = (struct dyn_config_dir *) pr_table_get(dyn_config_tab, dir_name,
+    NULL);
+  if (dir == NULL) {
+    return FALSE;
+  }
+
+  return (dir->config_gen == dyn_config_gen);
+}
+
+void pr_ftpaccess_set_current(const char *dir_name) {
+  struct dyn_config_dir *dir;
+
+  if (dir_name == NULL ||
+      dyn_config_tab == NULL) {
+    return;
+  }
+
+  dir = (struct dyn_config_dir *) pr_table_get(dyn_config_tab, dir_name,
+    NULL);
+  if (dir != NULL) {
+    dir->config_gen = dyn_config_gen;
+  }
+}
+
+void pr_ftpaccess_changed(void) {
+  dyn_config_gen++;
+}
+
+void pr_ftpaccess_clear(void) {
+  if (dyn_config_pool != NULL) {
+    destroy_pool(dyn_config_pool);
+  }
+}
@@ -167,6 +167,12 @@ int pr_table_set(pr_table_t *tab, const char *k, const void *v, size_t sz) {
   return -1;
 }
 
+int pr_timer_add(int secs, int timerno, module *m, callback_t cb,
+    const char *desc) {
+  errno = ENOSYS;
+  return -1;
+}
+
 int pr_trace_msg(const char *channel, int level, const char *fmt, ...) {
   errno = ENOSYS;
   return -1;
@@ -35,6 +35,26 @@ struct jot_filters_rec {
   array_header *cmd_ids;
 };
 
+/* A LogFormat, compiled into a flat list of literal text and variable
+ * instructions.
+ */
+struct jot_instr {
+  /* The LogFormat ID of a variable, or zero for literal text. */
+  unsigned char logfmt_id;
+
+  /* The literal text, or the variable's (NUL-terminated) argument. */
+  const char *data;
+  size_t datalen;
+
+  /* Precomputed key hint for the variable, if any. */
+  const char *hint;
+};
+
+struct jot_compiled_rec {
+  struct jot_instr *instrs;
+  unsigned int ninstrs;
+};
+
 /* For tracking the size of deleted files. */
 static off_t jot_deleted_filesz = 0;
 
@@ -1096,7 +1116,8 @@ static const char *get_meta_transfer_type(cmd_rec *cmd) {
 }
 
 static int resolve_logfmt_id(pool *p, unsigned char logfmt_id,
-    const char *logfmt_data, pr_jot_ctx_t *ctx, cmd_rec *cmd,
+    const char *logfmt_data, const char *logfmt_hint, pr_jot_ctx_t *ctx,
+    cmd_rec *cmd,
     int (*on_meta)(pool *, pr_jot_ctx_t *, unsigned char,
       const char *, const void *),
     int (*on_default)(pool *, pr_jot_ctx_t *, unsigned char)) {
@@ -1233,9 +1254,13 @@ static int resolve_logfmt_id(pool *p, unsigned char logfmt_id,
         key = logfmt_data;
         env = pr_env_get(p, key);
         if (env != NULL) {
-          char *field_name;
+          const char *field_name;
+
+          field_name = logfmt_hint;
+          if (field_name == NULL) {
+            field_name = pstrcat(p, PR_JOT_LOGFMT_ENV_VAR_KEY, key, NULL);
+          }
 
-          field_name = pstrcat(p, PR_JOT_LOGFMT_ENV_VAR_KEY, key, NULL);
           res = (on_meta)(p, ctx, logfmt_id, field_name, env);
 
         } else {
@@ -1984,7 +2009,7 @@ static int resolve_meta(pool *p, unsigned char **logfmt, pr_jot_ctx_t *ctx,
    */
   logfmt_data = pstrndup(p, logfmt_data, logfmt_datalen);
 
-  res = resolve_logfmt_id(p, logfmt_id, logfmt_data, ctx, cmd, on_meta,
+  res = resolve_logfmt_id(p, logfmt_id, logfmt_data, NULL, ctx, cmd, on_meta,
     on_default);
   if (res < 0) {
     return -1;
@@ -2159,7 +2184,7 @@ int pr_jot_resolve_logfmt_id(pool *p, cmd_rec *cmd, pr_jot_filters_t *filters,
       break;
   }
 
-  res = resolve_logfmt_id(p, logfmt_id, logfmt_data, ctx, cmd, on_meta,
+  res = resolve_logfmt_id(p, logfmt_id, logfmt_data, NULL, ctx, cmd, on_meta,
     on_default);
   return res;
 }
@@ -2273,6 +2298,176 @@ int pr_jot_resolve_logfmt(pool *p, cmd_rec *cmd, pr_jot_filters_t *filters,
   return 0;
 }
 
+pr_jot_compiled_t *pr_jot_compile_logfmt(pool *p, unsigned char *logfmt,
+    int flags) {
+  pr_jot_compiled_t *compiled;
+  array_header *instrs;
+  unsigned char *ptr;
+
+  (void) flags;
+
+  if (p == NULL ||
+      logfmt == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  instrs = make_array(p, 8, sizeof(struct jot_instr));
+  ptr = logfmt;
+
+  while (*ptr) {
+    struct jot_instr *instr;
+
+    pr_signals_handle();
+
+    instr = push_array(instrs);
+    memset(instr, 0, sizeof(struct jot_instr));
+
+    if (*ptr != LOGFMT_META_START) {
+      unsigned char *text;
+
+      text = ptr;
+      while (*ptr &&
+             *ptr != LOGFMT_META_START) {
+        ptr++;
+      }
+
+      instr->data = pstrndup(p, (char *) text, ptr - text);
+      instr->datalen = ptr - text;
+      continue;
+    }
+
+    /* Skip past the META_START. */
+    ptr++;
+    instr->logfmt_id = *ptr;
+
+    switch (instr->logfmt_id) {
+      case LOGFMT_META_CUSTOM:
+      case LOGFMT_META_ENV_VAR:
+      case LOGFMT_META_NOTE_VAR:
+      case LOGFMT_META_TIME:
+        if (*(ptr + 1) == LOGFMT_META_START &&
+            *(ptr + 2) == LOGFMT_META_ARG) {
+          unsigned char *arg;
+
+          arg = ptr + 3;
+          while (*arg &&
+                 *arg != LOGFMT_META_ARG_END) {
+            arg++;
+          }
+
+          instr->datalen = arg - (ptr + 3);
+          instr->data = pstrndup(p, (char *) (ptr + 3), instr->datalen);
+
+          /* Skip past the META_START, META_ARG, and the data, to the
+           * META_ARG_END.
+           */
+          ptr = (*arg ? arg : arg - 1);
+
+          if (instr->logfmt_id == LOGFMT_META_ENV_VAR) {
+            instr->hint = pstrcat(p, PR_JOT_LOGFMT_ENV_VAR_KEY, instr->data,
+              NULL);
+          }
+        }
+        break;
+
+      default:
+        break;
+    }
+
+    /* Skip past the LogFormat ID. */
+    ptr++;
+  }
+
+  compiled = pcalloc(p, sizeof(pr_jot_compiled_t));
+  compiled->instrs = instrs->elts;
+  compiled->ninstrs = instrs->nelts;
+
+  pr_trace_msg(trace_channel, 19, "compiled LogFormat into %u %s",
+    compiled->ninstrs, compiled->ninstrs != 1 ? "instructions" : "instruction");
+  return compiled;
+}
+
+int pr_jot_resolve_compiled_logfmt(pool *p, cmd_rec *cmd,
+    pr_jot_filters_t *filters, pr_jot_compiled_t *compiled, pr_jot_ctx_t *ctx,
+    int (*on_meta)(pool *, pr_jot_ctx_t *, unsigned char, const char *,
+      const void *),
+    int (*on_default)(pool *, pr_jot_ctx_t *, unsigned char),
+    int (*on_other)(pool *, pr_jot_ctx_t *, unsigned char *, size_t)) {
+  register unsigned int i;
+  int jottable = FALSE;
+
+  if (p == NULL ||
+      cmd == NULL ||
+      compiled == NULL ||
+      on_meta == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  jottable = is_jottable(p, cmd, filters);
+  if (jottable == FALSE) {
+    pr_trace_msg(trace_channel, 17, "ignoring filtered event '%s'",
+      (const char *) cmd->argv[0]);
+    errno = EPERM;
+    return -1;
+  }
+
+  if (on_default == NULL) {
+    on_default = jot_resolve_on_default;
+  }
+
+  if (on_other == NULL) {
+    on_other = jot_resolve_on_other;
+  }
+
+  for (i = 0; i < compiled->ninstrs; i++) {
+    struct jot_instr *instr;
+    int res = 0;
+
+    pr_signals_handle();
+
+    instr = &(compiled->instrs[i]);
+
+    switch (instr->logfmt_id) {
+      case 0:
+        res = (on_other)(p, ctx, (unsigned char *) instr->data,
+          instr->datalen);
+        break;
+
+      /* Special handling for the CONNECT/DISCONNECT meta. */
+      case LOGFMT_META_CONNECT:
+      case LOGFMT_META_DISCONNECT: {
+        int cmd_class;
+
+        cmd_class = (instr->logfmt_id == LOGFMT_META_CONNECT ?
+          CL_CONNECT : CL_DISCONNECT);
+        if (cmd->cmd_class == cmd_class) {
+          int val = TRUE;
+
+          pr_trace_msg(trace_channel, 17, "resolving LogFormat ID %u (%s)",
+            (unsigned int) instr->logfmt_id,
+            pr_jot_get_logfmt_id_name(instr->logfmt_id));
+          res = (on_meta)(p, ctx, instr->logfmt_id, NULL, &val);
+        }
+
+        break;
+      }
+
+      default:
+        res = resolve_logfmt_id(p, instr->logfmt_id, instr->data, instr->hint,
+          ctx, cmd, on_meta, on_default);
+        break;
+    }
+
+    if (res < 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
 static int jot_parse_on_unknown(pool *p, pr_jot_ctx_t *ctx, const char *text,
     size_t text_len) {
   return 0;
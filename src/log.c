@@ -390,6 +390,9 @@ int pr_log_vwritefile(int logfd, const char *ident, const char *fmt,
   pr_log_event_generate(PR_LOG_TYPE_UNSPEC, logfd, -1, buf, buflen);
   destroy_pool(tmp_pool);
 
+  /* Module logs are not buffered; modules close their log fds without
+   * flushing them.
+   */
   while (write(logfd, buf, buflen) < 0) {
     if (errno == EINTR) {
       pr_signals_handle();
@@ -468,6 +471,10 @@ int log_opensyslog(const char *fn) {
 }
 
 void log_closesyslog(void) {
+  if (systemlog_fd >= 0) {
+    (void) pr_log_flush(systemlog_fd);
+  }
+
   (void) close(systemlog_fd);
   systemlog_fd = -1;
 
@@ -717,15 +724,7 @@ static void log_write(int priority, int f, char *s, int discard) {
       return;
     }
 
-    while (write(systemlog_fd, buf, buflen) < 0) {
-      if (errno == EINTR) {
-        pr_signals_handle();
-        continue;
-      }
-
-      break;
-    }
-
+    (void) pr_log_writebuf(systemlog_fd, buf, buflen);
     return;
   }
 
@@ -820,10 +819,16 @@ int pr_log_setdefaultlevel(int level) {
 }
 
 int pr_log_set_options(unsigned long opts) {
+  (void) pr_log_set_buffering(opts & PR_LOG_OPT_USE_BUFFERING ? TRUE : FALSE);
+
   log_opts = opts;
   return 0;
 }
 
+unsigned long pr_log_get_options(void) {
+  return log_opts;
+}
+
 /* Convert a string into the matching syslog level value.  Return -1
  * if no matching level is found.
  */
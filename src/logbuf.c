@@ -0,0 +1,340 @@
+/*
+ * ProFTPD - FTP server daemon
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* Buffered log writing. */
+
+#include "conf.h"
+
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif /* HAVE_SYS_UIO_H */
+
+/* When the Buffered LogOption is in effect, session processes append the
+ * lines written via pr_log_writebuf() to a per-fd ring buffer.  A buffer is
+ * written out, using writev(2), when the next line would not fit, when the
+ * flush timer fires, when its fd is flushed before being closed, and when
+ * the session ends; lines for the same fd are thus always written in order.
+ * Once written out, a buffer is released, so that the fd may be reused.
+ */
+#define LOG_BUFFER_MAX_FDS	16
+
+struct log_buffer {
+  int fd;
+  dev_t dev;
+  ino_t ino;
+  pid_t pid;
+  char *data;
+  size_t start, len;
+};
+
+static pool *log_buffer_pool = NULL;
+static struct log_buffer log_buffers[LOG_BUFFER_MAX_FDS];
+static unsigned int log_nbuffers = 0;
+static int log_buffer_flush_scheduled = FALSE;
+static int log_buffering = FALSE;
+
+static const char *trace_channel = "log";
+
+static int log_buffer_write(struct log_buffer *lb) {
+  while (lb->len > 0) {
+    struct iovec iov[2];
+    int iovcnt = 1;
+    size_t datalen;
+    ssize_t res;
+
+    /* The buffered data may wrap around the end of the ring, in which case
+     * it is written out as two chunks in a single writev(2).
+     */
+    datalen = PR_TUNABLE_LOG_BUFFER_SIZE - lb->start;
+    if (datalen > lb->len) {
+      datalen = lb->len;
+    }
+
+    iov[0].iov_base = lb->data + lb->start;
+    iov[0].iov_len = datalen;
+
+    if (datalen < lb->len) {
+      iov[1].iov_base = lb->data;
+      iov[1].iov_len = lb->len - datalen;
+      iovcnt = 2;
+    }
+
+    res = writev(lb->fd, iov, iovcnt);
+    if (res < 0) {
+      int xerrno = errno;
+
+      /* Note that we deliberately do not handle any pending signals here;
+       * their handlers may log, and thus modify this buffer.
+       */
+      if (xerrno == EINTR) {
+        continue;
+      }
+
+      pr_trace_msg(trace_channel, 3, "error writing %lu buffered bytes to "
+        "fd %d: %s", (unsigned long) lb->len, lb->fd, strerror(xerrno));
+      lb->start = lb->len = 0;
+
+      errno = xerrno;
+      return -1;
+    }
+
+    lb->start = (lb->start + res) % PR_TUNABLE_LOG_BUFFER_SIZE;
+    lb->len -= res;
+  }
+
+  lb->start = 0;
+  return 0;
+}
+
+static int log_buffer_flush(struct log_buffer *lb) {
+  struct stat st;
+  int res;
+
+  if (lb->len == 0) {
+    lb->fd = -1;
+    return 0;
+  }
+
+  /* Lines buffered by the process we were forked from are that process'
+   * to write.
+   */
+  if (lb->pid != getpid()) {
+    lb->fd = -1;
+    lb->start = lb->len = 0;
+    return 0;
+  }
+
+  /* Make sure that the fd still refers to the file for which these lines
+   * were buffered, i.e. that it was not closed and reused in the meantime.
+   */
+  if (fstat(lb->fd, &st) < 0 ||
+      st.st_dev != lb->dev ||
+      st.st_ino != lb->ino) {
+    pr_trace_msg(trace_channel, 3, "discarding %lu bytes buffered for fd %d: "
+      "fd no longer refers to the same file", (unsigned long) lb->len,
+      lb->fd);
+    lb->fd = -1;
+    lb->start = lb->len = 0;
+
+    errno = EBADF;
+    return -1;
+  }
+
+  res = log_buffer_write(lb);
+  lb->fd = -1;
+
+  return res;
+}
+
+static void log_buffer_cleanup_cb(void *data) {
+  log_buffer_pool = NULL;
+  log_nbuffers = 0;
+  log_buffer_flush_scheduled = FALSE;
+}
+
+static struct log_buffer *log_buffer_get(int fd) {
+  register unsigned int i;
+  struct log_buffer *lb = NULL;
+  struct stat st;
+
+  for (i = 0; i < log_nbuffers; i++) {
+    if (log_buffers[i].fd == fd) {
+      return &(log_buffers[i]);
+    }
+
+    if (lb == NULL &&
+        log_buffers[i].fd < 0) {
+      lb = &(log_buffers[i]);
+    }
+  }
+
+  if (lb == NULL) {
+    if (log_nbuffers == LOG_BUFFER_MAX_FDS) {
+      return NULL;
+    }
+
+    lb = &(log_buffers[log_nbuffers++]);
+    lb->fd = -1;
+    lb->data = NULL;
+  }
+
+  if (fstat(fd, &st) < 0) {
+    return NULL;
+  }
+
+  if (lb->data == NULL) {
+    if (log_buffer_pool == NULL) {
+      log_buffer_pool = make_sub_pool(permanent_pool);
+      pr_pool_tag(log_buffer_pool, "Log buffer pool");
+
+      register_cleanup2(log_buffer_pool, NULL, log_buffer_cleanup_cb);
+    }
+
+    lb->data = palloc(log_buffer_pool, PR_TUNABLE_LOG_BUFFER_SIZE);
+  }
+
+  lb->fd = fd;
+  lb->dev = st.st_dev;
+  lb->ino = st.st_ino;
+  lb->pid = getpid();
+  lb->start = lb->len = 0;
+
+  pr_trace_msg(trace_channel, 17, "buffering log lines for fd %d", fd);
+  return lb;
+}
+
+static int log_buffer_flush_cb(CALLBACK_FRAME) {
+  log_buffer_flush_scheduled = FALSE;
+  (void) pr_log_flush(-1);
+
+  /* The timer is scheduled again when the next line is buffered. */
+  return 0;
+}
+
+static void log_buffer_schedule_flush(void) {
+  if (log_buffer_flush_scheduled == TRUE) {
+    return;
+  }
+
+  /* Set the flag first; adding a timer may itself log. */
+  log_buffer_flush_scheduled = TRUE;
+  if (pr_timer_add(PR_TUNABLE_LOG_BUFFER_FLUSH_INTERVAL, -1, NULL,
+      log_buffer_flush_cb, "Log buffer flush") < 0) {
+    pr_trace_msg(trace_channel, 3, "error scheduling log buffer flush: %s",
+      strerror(errno));
+    log_buffer_flush_scheduled = FALSE;
+  }
+}
+
+int pr_log_writebuf(int fd, const char *buf, size_t buflen) {
+  struct log_buffer *lb = NULL;
+
+  if (fd < 0 ||
+      buf == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (buflen == 0) {
+    return 0;
+  }
+
+  /* Only session processes buffer their logging; the daemon process logs
+   * comparatively little, and must not leave buffered lines to be inherited
+   * by its children.
+   */
+  if (log_buffering == TRUE &&
+      session.pid != 0) {
+    lb = log_buffer_get(fd);
+  }
+
+  if (lb != NULL) {
+    size_t offset, datalen;
+
+    if (buflen > PR_TUNABLE_LOG_BUFFER_SIZE - lb->len) {
+      if (log_buffer_flush(lb) < 0) {
+        lb = NULL;
+
+      } else {
+        /* Flushing released the buffer; get it back for this line. */
+        lb = log_buffer_get(fd);
+      }
+    }
+
+    if (lb != NULL &&
+        buflen <= PR_TUNABLE_LOG_BUFFER_SIZE - lb->len) {
+      offset = (lb->start + lb->len) % PR_TUNABLE_LOG_BUFFER_SIZE;
+
+      datalen = PR_TUNABLE_LOG_BUFFER_SIZE - offset;
+      if (datalen > buflen) {
+        datalen = buflen;
+      }
+
+      memcpy(lb->data + offset, buf, datalen);
+      if (datalen < buflen) {
+        memcpy(lb->data, buf + datalen, buflen - datalen);
+      }
+
+      lb->len += buflen;
+
+      log_buffer_schedule_flush();
+      return 0;
+    }
+
+    /* Lines longer than the buffer are written out directly; the buffer
+     * for this fd is empty at this point, so ordering is preserved.
+     */
+  }
+
+  while (write(fd, buf, buflen) < 0) {
+    if (errno == EINTR) {
+      pr_signals_handle();
+      continue;
+    }
+
+    return -1;
+  }
+
+  return 0;
+}
+
+int pr_log_flush(int fd) {
+  register unsigned int i;
+  int res = 0, xerrno = 0;
+
+  for (i = 0; i < log_nbuffers; i++) {
+    struct log_buffer *lb;
+
+    lb = &(log_buffers[i]);
+    if (lb->fd < 0) {
+      continue;
+    }
+
+    if (fd >= 0 &&
+        lb->fd != fd) {
+      continue;
+    }
+
+    if (log_buffer_flush(lb) < 0) {
+      xerrno = errno;
+      res = -1;
+    }
+  }
+
+  errno = xerrno;
+  return res;
+}
+
+int pr_log_set_buffering(int enable) {
+  int prev;
+
+  prev = log_buffering;
+  if (log_buffering == TRUE &&
+      enable == FALSE) {
+    (void) pr_log_flush(-1);
+  }
+
+  log_buffering = enable;
+  return prev;
+}
@@ -0,0 +1,771 @@
+/*
+ * ProFTPD - FTP server daemon
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* Binary LogFormat records, as written by mod_log and read by ftplogconv.
+ *
+ * Note that this code is also linked into the ftplogconv utility, and so
+ * must only use the C library; no pools, logging, or tracing.
+ */
+
+#include "conf.h"
+#include "logfmt.h"
+#include "jot.h"
+
+/* These match the JSON keys used by the Jot API, for e.g. mod_log's JSON
+ * output, so that converted logs look the same.
+ */
+static const struct {
+  unsigned char logfmt_id;
+  const char *key;
+} json_keys[] = {
+  { LOGFMT_META_ANON_PASS,	PR_JOT_LOGFMT_ANON_PASSWD_KEY },
+  { LOGFMT_META_BASENAME,	PR_JOT_LOGFMT_BASENAME_KEY },
+  { LOGFMT_META_BYTES_SENT,	PR_JOT_LOGFMT_BYTES_SENT_KEY },
+  { LOGFMT_META_CLASS,		PR_JOT_LOGFMT_CLASS_KEY },
+  { LOGFMT_META_CMD_PARAMS,	PR_JOT_LOGFMT_CMD_PARAMS_KEY },
+  { LOGFMT_META_COMMAND,	PR_JOT_LOGFMT_COMMAND_KEY },
+  { LOGFMT_META_CONNECT,	PR_JOT_LOGFMT_CONNECT_KEY },
+  { LOGFMT_META_DIR_NAME,	PR_JOT_LOGFMT_DIR_NAME_KEY },
+  { LOGFMT_META_DIR_PATH,	PR_JOT_LOGFMT_DIR_PATH_KEY },
+  { LOGFMT_META_DISCONNECT,	PR_JOT_LOGFMT_DISCONNECT_KEY },
+  { LOGFMT_META_EOS_REASON,	PR_JOT_LOGFMT_EOS_REASON_KEY },
+  { LOGFMT_META_EPOCH,		PR_JOT_LOGFMT_EPOCH_KEY },
+  { LOGFMT_META_FILENAME,	PR_JOT_LOGFMT_FILENAME_KEY },
+  { LOGFMT_META_FILE_MODIFIED,	PR_JOT_LOGFMT_FILE_MODIFIED_KEY },
+  { LOGFMT_META_FILE_OFFSET,	PR_JOT_LOGFMT_FILE_OFFSET_KEY },
+  { LOGFMT_META_FILE_SIZE,	PR_JOT_LOGFMT_FILE_SIZE_KEY },
+  { LOGFMT_META_GID,		PR_JOT_LOGFMT_GID_KEY },
+  { LOGFMT_META_GROUP,		PR_JOT_LOGFMT_GROUP_KEY },
+  { LOGFMT_META_IDENT_USER,	PR_JOT_LOGFMT_IDENT_USER_KEY },
+  { LOGFMT_META_ISO8601,	PR_JOT_LOGFMT_ISO8601_KEY },
+  { LOGFMT_META_LOCAL_FQDN,	PR_JOT_LOGFMT_LOCAL_FQDN_KEY },
+  { LOGFMT_META_LOCAL_IP,	PR_JOT_LOGFMT_LOCAL_IP_KEY },
+  { LOGFMT_META_LOCAL_NAME,	PR_JOT_LOGFMT_LOCAL_NAME_KEY },
+  { LOGFMT_META_LOCAL_PORT,	PR_JOT_LOGFMT_LOCAL_PORT_KEY },
+  { LOGFMT_META_METHOD,		PR_JOT_LOGFMT_METHOD_KEY },
+  { LOGFMT_META_MICROSECS,	PR_JOT_LOGFMT_MICROSECS_KEY },
+  { LOGFMT_META_MILLISECS,	PR_JOT_LOGFMT_MILLISECS_KEY },
+  { LOGFMT_META_ORIGINAL_USER,	PR_JOT_LOGFMT_ORIG_USER_KEY },
+  { LOGFMT_META_PID,		PR_JOT_LOGFMT_PID_KEY },
+  { LOGFMT_META_PROTOCOL,	PR_JOT_LOGFMT_PROTOCOL_KEY },
+  { LOGFMT_META_RAW_BYTES_IN,	PR_JOT_LOGFMT_RAW_BYTES_IN_KEY },
+  { LOGFMT_META_RAW_BYTES_OUT,	PR_JOT_LOGFMT_RAW_BYTES_OUT_KEY },
+  { LOGFMT_META_REMOTE_HOST,	PR_JOT_LOGFMT_REMOTE_HOST_KEY },
+  { LOGFMT_META_REMOTE_IP,	PR_JOT_LOGFMT_REMOTE_IP_KEY },
+  { LOGFMT_META_REMOTE_PORT,	PR_JOT_LOGFMT_REMOTE_PORT_KEY },
+  { LOGFMT_META_RENAME_FROM,	PR_JOT_LOGFMT_RENAME_FROM_KEY },
+  { LOGFMT_META_RESPONSE_CODE,	PR_JOT_LOGFMT_RESPONSE_CODE_KEY },
+  { LOGFMT_META_RESPONSE_MS,	PR_JOT_LOGFMT_RESPONSE_MS_KEY },
+  { LOGFMT_META_RESPONSE_STR,	PR_JOT_LOGFMT_RESPONSE_MSG_KEY },
+  { LOGFMT_META_SECONDS,	PR_JOT_LOGFMT_SECONDS_KEY },
+  { LOGFMT_META_TIME,		PR_JOT_LOGFMT_TIME_KEY },
+  { LOGFMT_META_UID,		PR_JOT_LOGFMT_UID_KEY },
+  { LOGFMT_META_USER,		PR_JOT_LOGFMT_USER_KEY },
+  { LOGFMT_META_VERSION,	PR_JOT_LOGFMT_VERSION_KEY },
+  { LOGFMT_META_VHOST_IP,	PR_JOT_LOGFMT_VHOST_IP_KEY },
+  { LOGFMT_META_XFER_FAILURE,	PR_JOT_LOGFMT_XFER_FAILURE_KEY },
+  { LOGFMT_META_XFER_MS,	PR_JOT_LOGFMT_XFER_MS_KEY },
+  { LOGFMT_META_XFER_PATH,	PR_JOT_LOGFMT_XFER_PATH_KEY },
+  { LOGFMT_META_XFER_PORT,	PR_JOT_LOGFMT_XFER_PORT_KEY },
+  { LOGFMT_META_XFER_STATUS,	PR_JOT_LOGFMT_XFER_STATUS_KEY },
+  { LOGFMT_META_XFER_TYPE,	PR_JOT_LOGFMT_XFER_TYPE_KEY },
+  { 0, NULL }
+};
+
+/* Encoding.  Each call appends its data in full, or not at all. */
+
+static int bin_append(char **buf, size_t *buflen, const void *data,
+    size_t datalen) {
+  if (datalen > *buflen) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  memcpy(*buf, data, datalen);
+  *buf += datalen;
+  *buflen -= datalen;
+  return 0;
+}
+
+int pr_logfmt_bin_append_varint(char **buf, size_t *buflen, uint64_t num) {
+  unsigned char data[10];
+  size_t datalen = 0;
+
+  if (buf == NULL ||
+      *buf == NULL ||
+      buflen == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  do {
+    data[datalen] = num & 0x7f;
+    num >>= 7;
+    if (num > 0) {
+      data[datalen] |= 0x80;
+    }
+
+    datalen++;
+  } while (num > 0);
+
+  return bin_append(buf, buflen, data, datalen);
+}
+
+int pr_logfmt_bin_append_key(char **buf, size_t *buflen,
+    unsigned char logfmt_id, unsigned int wire_type) {
+  return pr_logfmt_bin_append_varint(buf, buflen,
+    (((uint64_t) logfmt_id) << 3)|(wire_type & 0x07));
+}
+
+int pr_logfmt_bin_append_string(char **buf, size_t *buflen, const char *text,
+    size_t text_len) {
+  char *start;
+  size_t startlen;
+
+  if (buf == NULL ||
+      *buf == NULL ||
+      buflen == NULL ||
+      (text == NULL && text_len > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  start = *buf;
+  startlen = *buflen;
+
+  if (pr_logfmt_bin_append_varint(buf, buflen, text_len) < 0 ||
+      bin_append(buf, buflen, text, text_len) < 0) {
+    *buf = start;
+    *buflen = startlen;
+    return -1;
+  }
+
+  return 0;
+}
+
+int pr_logfmt_bin_append_number(char **buf, size_t *buflen,
+    unsigned char logfmt_id, double num) {
+  register unsigned int i;
+  unsigned char data[8];
+  uint64_t bits;
+  char *start;
+  size_t startlen;
+
+  if (buf == NULL ||
+      *buf == NULL ||
+      buflen == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  start = *buf;
+  startlen = *buflen;
+
+  if (num >= 0.0 &&
+      num < 18446744073709551616.0 &&
+      num == (double) ((uint64_t) num)) {
+    if (pr_logfmt_bin_append_key(buf, buflen, logfmt_id,
+          LOGFMT_BIN_WIRE_VARINT) < 0 ||
+        pr_logfmt_bin_append_varint(buf, buflen, (uint64_t) num) < 0) {
+      *buf = start;
+      *buflen = startlen;
+      return -1;
+    }
+
+    return 0;
+  }
+
+  memcpy(&bits, &num, sizeof(bits));
+  for (i = 0; i < sizeof(data); i++) {
+    data[i] = (unsigned char) (bits >> (i * 8));
+  }
+
+  if (pr_logfmt_bin_append_key(buf, buflen, logfmt_id,
+        LOGFMT_BIN_WIRE_DOUBLE) < 0 ||
+      bin_append(buf, buflen, data, sizeof(data)) < 0) {
+    *buf = start;
+    *buflen = startlen;
+    return -1;
+  }
+
+  return 0;
+}
+
+int pr_logfmt_bin_append_header(char **buf, size_t *buflen) {
+  unsigned char hdr[LOGFMT_BIN_MAGIC_LEN + 1];
+
+  if (buf == NULL ||
+      *buf == NULL ||
+      buflen == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memcpy(hdr, LOGFMT_BIN_MAGIC, LOGFMT_BIN_MAGIC_LEN);
+  hdr[LOGFMT_BIN_MAGIC_LEN] = LOGFMT_BIN_VERSION;
+
+  return bin_append(buf, buflen, hdr, sizeof(hdr));
+}
+
+char *pr_logfmt_bin_frame_record(char *rec, size_t reclen, size_t *framelen) {
+  char *hdr, *ptr;
+  size_t hdrlen, len;
+
+  if (rec == NULL ||
+      reclen == 0 ||
+      reclen > LOGFMT_BIN_MAX_RECORD_SIZE ||
+      framelen == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  hdrlen = 1;
+  for (len = reclen; len >= 0x80; len >>= 7) {
+    hdrlen++;
+  }
+
+  /* Right-align the length varint against the record. */
+  hdr = ptr = rec - hdrlen;
+  len = hdrlen;
+  (void) pr_logfmt_bin_append_varint(&ptr, &len, reclen);
+
+  *framelen = hdrlen + reclen;
+  return hdr;
+}
+
+/* Decoding. */
+
+static int bin_decode_varint(const unsigned char **ptr,
+    const unsigned char *end, uint64_t *num) {
+  register unsigned int i;
+
+  *num = 0;
+  for (i = 0; i < 10 && *ptr < end; i++) {
+    unsigned char c;
+
+    c = *(*ptr)++;
+    *num |= ((uint64_t) (c & 0x7f)) << (i * 7);
+    if (!(c & 0x80)) {
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+static int bin_decode_string(const unsigned char **ptr,
+    const unsigned char *end, const char **text, size_t *textlen) {
+  uint64_t len;
+
+  if (bin_decode_varint(ptr, end, &len) < 0 ||
+      len > (uint64_t) (end - *ptr)) {
+    return -1;
+  }
+
+  *text = (const char *) *ptr;
+  *textlen = (size_t) len;
+  *ptr += len;
+  return 0;
+}
+
+int pr_logfmt_bin_decode_varint(const unsigned char **data, size_t *datalen,
+    uint64_t *num) {
+  const unsigned char *ptr;
+
+  if (data == NULL ||
+      *data == NULL ||
+      datalen == NULL ||
+      num == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ptr = *data;
+  if (bin_decode_varint(&ptr, *data + *datalen, num) < 0) {
+    errno = EBADMSG;
+    return -1;
+  }
+
+  *datalen -= (ptr - *data);
+  *data = ptr;
+  return 0;
+}
+
+int pr_logfmt_bin_decode_record(const unsigned char *data, size_t datalen,
+    pr_logfmt_record_t *rec) {
+  const unsigned char *ptr, *end;
+
+  if (data == NULL ||
+      rec == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ptr = data;
+  end = data + datalen;
+  rec->nfields = 0;
+
+  if (bin_decode_varint(&ptr, end, &(rec->usecs)) < 0) {
+    errno = EBADMSG;
+    return -1;
+  }
+
+  while (ptr < end) {
+    pr_logfmt_field_t *field;
+    uint64_t key;
+
+    if (bin_decode_varint(&ptr, end, &key) < 0 ||
+        rec->nfields == LOGFMT_BIN_MAX_FIELDS) {
+      errno = EBADMSG;
+      return -1;
+    }
+
+    field = &(rec->fields[rec->nfields]);
+    memset(field, 0, sizeof(pr_logfmt_field_t));
+    field->logfmt_id = (unsigned char) (key >> 3);
+    field->wire_type = key & 0x07;
+
+    switch (field->wire_type) {
+      case LOGFMT_BIN_WIRE_VARINT:
+        if (bin_decode_varint(&ptr, end, &(field->num)) < 0) {
+          errno = EBADMSG;
+          return -1;
+        }
+        field->dbl = (double) field->num;
+        break;
+
+      case LOGFMT_BIN_WIRE_DOUBLE: {
+        register unsigned int i;
+        uint64_t bits = 0;
+
+        if (end - ptr < 8) {
+          errno = EBADMSG;
+          return -1;
+        }
+
+        for (i = 0; i < 8; i++) {
+          bits |= ((uint64_t) ptr[i]) << (i * 8);
+        }
+        ptr += 8;
+
+        memcpy(&(field->dbl), &bits, sizeof(field->dbl));
+        break;
+      }
+
+      case LOGFMT_BIN_WIRE_NAMED_STRING:
+        if (bin_decode_string(&ptr, end, &(field->name),
+            &(field->namelen)) < 0) {
+          errno = EBADMSG;
+          return -1;
+        }
+
+        /* Fall through - the value follows the name. */
+
+      case LOGFMT_BIN_WIRE_STRING:
+        if (bin_decode_string(&ptr, end, &(field->text),
+            &(field->textlen)) < 0) {
+          errno = EBADMSG;
+          return -1;
+        }
+        break;
+
+      default:
+        /* Unknown wire types cannot be skipped safely. */
+        errno = EBADMSG;
+        return -1;
+    }
+
+    rec->nfields++;
+  }
+
+  return 0;
+}
+
+const pr_logfmt_field_t *pr_logfmt_bin_get_field(
+    const pr_logfmt_record_t *rec, unsigned char logfmt_id) {
+  register unsigned int i;
+
+  if (rec == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  for (i = 0; i < rec->nfields; i++) {
+    if (rec->fields[i].logfmt_id == logfmt_id) {
+      return &(rec->fields[i]);
+    }
+  }
+
+  errno = ENOENT;
+  return NULL;
+}
+
+/* Returns 1 on success, 0 on a clean EOF, and -1 on a truncated or
+ * malformed varint.
+ */
+static int bin_read_varint(FILE *fp, uint64_t *num) {
+  register unsigned int i;
+
+  *num = 0;
+  for (i = 0; i < 10; i++) {
+    int c;
+
+    c = getc(fp);
+    if (c == EOF) {
+      return i == 0 ? 0 : -1;
+    }
+
+    *num |= ((uint64_t) (c & 0x7f)) << (i * 7);
+    if (!(c & 0x80)) {
+      return 1;
+    }
+  }
+
+  return -1;
+}
+
+int pr_logfmt_bin_read_record(pr_logfmt_reader_t *reader,
+    pr_logfmt_record_t *rec) {
+  if (reader == NULL ||
+      reader->fp == NULL ||
+      rec == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  while (TRUE) {
+    uint64_t reclen;
+    int c;
+
+    c = getc(reader->fp);
+    if (c == EOF) {
+      return 0;
+    }
+
+    if (c == 0) {
+      unsigned char hdr[LOGFMT_BIN_MAGIC_LEN + 1];
+
+      /* A file header, possibly repeated (e.g. by concatenated logs). */
+      hdr[0] = 0;
+      if (fread(hdr + 1, 1, sizeof(hdr) - 1, reader->fp) != sizeof(hdr) - 1 ||
+          memcmp(hdr, LOGFMT_BIN_MAGIC, LOGFMT_BIN_MAGIC_LEN) != 0) {
+        errno = EINVAL;
+        return -1;
+      }
+
+      reader->version = hdr[LOGFMT_BIN_MAGIC_LEN];
+      if (reader->version > LOGFMT_BIN_VERSION) {
+        errno = ENOTSUP;
+        return -1;
+      }
+
+      reader->have_header = TRUE;
+      continue;
+    }
+
+    if (reader->have_header == FALSE) {
+      errno = EINVAL;
+      return -1;
+    }
+
+    ungetc(c, reader->fp);
+    if (bin_read_varint(reader->fp, &reclen) != 1 ||
+        reclen > LOGFMT_BIN_MAX_RECORD_SIZE) {
+      errno = E2BIG;
+      return -1;
+    }
+
+    if (reclen > reader->bufsz) {
+      unsigned char *ptr;
+
+      ptr = realloc(reader->buf, reclen);
+      if (ptr == NULL) {
+        errno = ENOMEM;
+        return -1;
+      }
+
+      reader->buf = ptr;
+      reader->bufsz = reclen;
+    }
+
+    if (fread(reader->buf, 1, reclen, reader->fp) != reclen) {
+      errno = EIO;
+      return -1;
+    }
+
+    if (pr_logfmt_bin_decode_record(reader->buf, reclen, rec) < 0) {
+      return -1;
+    }
+
+    return 1;
+  }
+}
+
+void pr_logfmt_bin_reader_free(pr_logfmt_reader_t *reader) {
+  if (reader == NULL) {
+    return;
+  }
+
+  free(reader->buf);
+  reader->buf = NULL;
+  reader->bufsz = 0;
+}
+
+/* Conversion. */
+
+static int bin_field_is(const pr_logfmt_field_t *field, const char *text) {
+  return (field != NULL &&
+    field->text != NULL &&
+    field->textlen == strlen(text) &&
+    strncasecmp(field->text, text, field->textlen) == 0);
+}
+
+static void bin_write_json_string(FILE *outf, const char *text,
+    size_t textlen) {
+  register unsigned int i;
+
+  fputc('"', outf);
+  for (i = 0; i < textlen; i++) {
+    unsigned char c = text[i];
+
+    switch (c) {
+      case '"':
+        fputs("\\\"", outf);
+        break;
+
+      case '\\':
+        fputs("\\\\", outf);
+        break;
+
+      case '\n':
+        fputs("\\n", outf);
+        break;
+
+      case '\r':
+        fputs("\\r", outf);
+        break;
+
+      case '\t':
+        fputs("\\t", outf);
+        break;
+
+      default:
+        if (c < 0x20) {
+          fprintf(outf, "\\u%04x", c);
+
+        } else {
+          fputc(c, outf);
+        }
+    }
+  }
+  fputc('"', outf);
+}
+
+int pr_logfmt_bin_write_json(FILE *outf, const pr_logfmt_record_t *rec) {
+  register unsigned int i;
+
+  if (outf == NULL ||
+      rec == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  fprintf(outf, "{\"record_usecs\":%llu", (unsigned long long) rec->usecs);
+
+  for (i = 0; i < rec->nfields; i++) {
+    register unsigned int j;
+    const pr_logfmt_field_t *field;
+    const char *key = NULL;
+
+    field = &(rec->fields[i]);
+    fputc(',', outf);
+
+    if (field->name != NULL) {
+      bin_write_json_string(outf, field->name, field->namelen);
+
+    } else {
+      for (j = 0; json_keys[j].key != NULL; j++) {
+        if (json_keys[j].logfmt_id == field->logfmt_id) {
+          key = json_keys[j].key;
+          break;
+        }
+      }
+
+      if (key != NULL) {
+        fprintf(outf, "\"%s\"", key);
+
+      } else {
+        fprintf(outf, "\"field%u\"", field->logfmt_id);
+      }
+    }
+
+    fputc(':', outf);
+
+    switch (field->wire_type) {
+      case LOGFMT_BIN_WIRE_VARINT:
+        if (field->logfmt_id == LOGFMT_META_CONNECT ||
+            field->logfmt_id == LOGFMT_META_DISCONNECT ||
+            field->logfmt_id == LOGFMT_META_FILE_MODIFIED) {
+          fputs(field->num ? "true" : "false", outf);
+
+        } else {
+          fprintf(outf, "%llu", (unsigned long long) field->num);
+        }
+        break;
+
+      case LOGFMT_BIN_WIRE_DOUBLE:
+        fprintf(outf, "%.15g", field->dbl);
+        break;
+
+      default:
+        bin_write_json_string(outf, field->text, field->textlen);
+        break;
+    }
+  }
+
+  fputs("}\n", outf);
+  return 0;
+}
+
+int pr_logfmt_bin_write_xferlog(FILE *outf, const pr_logfmt_record_t *rec) {
+  register unsigned int i;
+  const pr_logfmt_field_t *field;
+  char direction, timestr[64];
+  const char *remhost = "-", *user = "-", *proto = "ftp", *ident = "*";
+  const char *fname = "-";
+  size_t remhostlen = 1, userlen = 1, protolen = 3, identlen = 1, fnamelen = 1;
+  unsigned long long fsize = 0;
+  long xfertime = 0;
+  time_t now;
+  struct tm *tm;
+
+  if (outf == NULL ||
+      rec == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_METHOD);
+  if (bin_field_is(field, C_RETR)) {
+    direction = 'o';
+
+  } else if (bin_field_is(field, C_STOR) ||
+             bin_field_is(field, C_STOU) ||
+             bin_field_is(field, C_APPE)) {
+    direction = 'i';
+
+  } else if (bin_field_is(field, C_DELE)) {
+    direction = 'd';
+
+  } else {
+    errno = ENOENT;
+    return -1;
+  }
+
+  now = (time_t) (rec->usecs / 1000000);
+  tm = localtime(&now);
+  if (tm == NULL ||
+      strftime(timestr, sizeof(timestr), "%a %b %d %H:%M:%S %Y", tm) == 0) {
+    snprintf(timestr, sizeof(timestr), "%lu", (unsigned long) now);
+  }
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_SECONDS);
+  if (field != NULL &&
+      field->text == NULL) {
+    xfertime = (long) (field->dbl + 0.5);
+  }
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_REMOTE_HOST);
+  if (field == NULL) {
+    field = pr_logfmt_bin_get_field(rec, LOGFMT_META_REMOTE_IP);
+  }
+
+  if (field != NULL &&
+      field->text != NULL) {
+    remhost = field->text;
+    remhostlen = field->textlen;
+  }
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_BYTES_SENT);
+  if (field != NULL &&
+      field->text == NULL) {
+    fsize = (unsigned long long) field->dbl;
+  }
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_FILENAME);
+  if (field == NULL) {
+    field = pr_logfmt_bin_get_field(rec, LOGFMT_META_XFER_PATH);
+  }
+
+  if (field != NULL &&
+      field->text != NULL &&
+      field->textlen > 0) {
+    fname = field->text;
+    fnamelen = field->textlen;
+  }
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_USER);
+  if (field != NULL &&
+      field->text != NULL) {
+    user = field->text;
+    userlen = field->textlen;
+  }
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_PROTOCOL);
+  if (field != NULL &&
+      field->text != NULL) {
+    proto = field->text;
+    protolen = field->textlen;
+  }
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_IDENT_USER);
+  if (field != NULL &&
+      field->text != NULL &&
+      !bin_field_is(field, "UNKNOWN")) {
+    ident = field->text;
+    identlen = field->textlen;
+  }
+
+  fprintf(outf, "%s %ld %.*s %llu ", timestr, xfertime, (int) remhostlen,
+    remhost, fsize);
+
+  for (i = 0; i < fnamelen; i++) {
+    fputc((PR_ISSPACE(fname[i]) || PR_ISCNTRL(fname[i])) ? '_' : fname[i],
+      outf);
+  }
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_XFER_STATUS);
+  fprintf(outf, " %c _ %c %c %.*s %.*s %c %.*s %c\n",
+    bin_field_is(pr_logfmt_bin_get_field(rec, LOGFMT_META_XFER_TYPE),
+      "ASCII") ? 'a' : 'b',
+    direction,
+    pr_logfmt_bin_get_field(rec, LOGFMT_META_ANON_PASS) != NULL ? 'a' : 'r',
+    (int) userlen, user,
+    (int) protolen, proto,
+    ident[0] != '*' ? '1' : '0',
+    (int) identlen, ident,
+    (field == NULL || bin_field_is(field, "success")) ? 'c' : 'i');
+
+  return 0;
+}
@@ -40,6 +40,10 @@
 # include <sys/utsname.h>
 #endif
 
+#ifdef PR_USE_EPOLL
+# include <poll.h>
+#endif /* PR_USE_EPOLL */
+
 #include "privs.h"
 
 #ifdef PR_USE_OPENSSL
@@ -58,6 +62,12 @@ extern xaset_t *server_list;
 unsigned long max_connects = 0UL;
 unsigned int max_connect_interval = 1;
 
+/* Number of idle, pre-forked session processes to keep waiting for
+ * connections; zero disables the pre-fork mode.
+ */
+unsigned int prefork_min_spare = 0;
+unsigned int prefork_max_spare = 0;
+
 session_t session;
 
 /* Is this process the master standalone daemon process? */
@@ -90,6 +100,9 @@ static int syntax_check = 0;
 
 /* Command handling */
 static void cmd_loop(server_rec *s, conn_t *conn);
+#ifndef PR_DEVEL_NO_FORK
+static void prefork_close_pod(void);
+#endif /* PR_DEVEL_NO_FORK */
 
 static cmd_rec *make_ftp_cmd(pool *p, char *buf, size_t buflen, int flags);
 
@@ -115,6 +128,74 @@ static int semaphore_fds(fd_set *rfd, int maxfd) {
   return maxfd;
 }
 
+#ifdef PR_USE_EPOLL
+/* When using epoll, the daemon waits on the epoll fd and on the child
+ * semaphore pipes using poll(2), which, unlike select(2), does not limit the
+ * fd numbers to FD_SETSIZE.
+ */
+static pool *daemon_poll_pool = NULL;
+static struct pollfd *daemon_pollfds = NULL;
+static unsigned int daemon_npollfds = 0, daemon_pollfdsz = 0;
+
+static void daemon_poll_add(int fd) {
+  if (daemon_npollfds == daemon_pollfdsz) {
+    pool *tmp_pool;
+    struct pollfd *pollfds;
+    unsigned int pollfdsz;
+
+    pollfdsz = (daemon_pollfdsz > 0 ? daemon_pollfdsz * 2 : 32);
+
+    tmp_pool = make_sub_pool(permanent_pool);
+    pr_pool_tag(tmp_pool, "Daemon pollfds pool");
+
+    pollfds = palloc(tmp_pool, pollfdsz * sizeof(struct pollfd));
+    if (daemon_npollfds > 0) {
+      memcpy(pollfds, daemon_pollfds, daemon_npollfds * sizeof(struct pollfd));
+    }
+
+    if (daemon_poll_pool != NULL) {
+      destroy_pool(daemon_poll_pool);
+    }
+
+    daemon_poll_pool = tmp_pool;
+    daemon_pollfds = pollfds;
+    daemon_pollfdsz = pollfdsz;
+  }
+
+  daemon_pollfds[daemon_npollfds].fd = fd;
+  daemon_pollfds[daemon_npollfds].events = POLLIN;
+  daemon_pollfds[daemon_npollfds].revents = 0;
+  daemon_npollfds++;
+}
+
+static int daemon_poll_isset(int fd) {
+  register unsigned int i;
+
+  for (i = 0; i < daemon_npollfds; i++) {
+    if (daemon_pollfds[i].fd == fd) {
+      return (daemon_pollfds[i].revents != 0);
+    }
+  }
+
+  return FALSE;
+}
+
+/* Add child semaphore fds into the daemon's pollfds */
+static void semaphore_pollfds(void) {
+  if (child_count()) {
+    pr_child_t *ch;
+
+    for (ch = child_get(NULL); ch; ch = child_get(ch)) {
+      pr_signals_handle();
+
+      if (ch->ch_pipefd != -1) {
+        daemon_poll_add(ch->ch_pipefd);
+      }
+    }
+  }
+}
+#endif /* PR_USE_EPOLL */
+
 void set_auth_check(int (*chk)(cmd_rec*)) {
   cmd_auth_chk = chk;
 }
@@ -230,40 +311,43 @@ static int get_command_class(const char *name) {
 }
 
 static int _dispatch(cmd_rec *cmd, int cmd_type, int validate, char *match) {
+  register unsigned int i;
   const char *cmdargstr = NULL;
-  cmdtable *c;
+  cmdtable *c, **handlers = NULL;
+  unsigned int nhandlers = 0;
   modret_t *mr;
-  int success = 0, xerrno = 0;
+  int cmd_id = 0, success = 0, xerrno = 0;
   int send_error = 0;
-  static int match_index_cache = -1;
-  static unsigned int match_hash_cache = 0;
-  static char *last_match = NULL;
-  int *index_cache = NULL;
-  unsigned int *hash_cache = NULL;
 
   send_error = (cmd_type == PRE_CMD || cmd_type == CMD ||
     cmd_type == POST_CMD_ERR);
 
   if (!match) {
     match = cmd->argv[0];
-    index_cache = &cmd->stash_index;
-    hash_cache = &cmd->stash_hash;
-
-  } else {
-    if (last_match != match) {
-      match_index_cache = -1;
-      last_match = match;
-    }
+    cmd_id = cmd->cmd_id;
+  }
 
-    index_cache = &match_index_cache;
-    hash_cache = &match_hash_cache;
+  if (pr_stash_get_cmd_handlers(match, cmd_id, cmd_type, &handlers,
+      &nhandlers) < 0) {
+    nhandlers = 0;
   }
 
-  c = pr_stash_get_symbol2(PR_SYM_CMD, match, NULL, index_cache, hash_cache);
+  /* The stash discards its list of handlers whenever a CMD symbol is added
+   * or removed, e.g. by a handler which loads or unloads a module.  Work
+   * from our own copy of that list, if we need it after the first handler.
+   */
+  if (nhandlers > 1) {
+    cmdtable **copy;
 
-  while (c && !success) {
+    copy = palloc(cmd->pool, nhandlers * sizeof(cmdtable *));
+    memcpy(copy, handlers, nhandlers * sizeof(cmdtable *));
+    handlers = copy;
+  }
+
+  for (i = 0; i < nhandlers && !success; i++) {
     size_t cmdargstrlen = 0;
 
+    c = handlers[i];
     pr_signals_handle();
 
     session.curr_cmd = cmd->argv[0];
@@ -271,162 +355,155 @@ static int _dispatch(cmd_rec *cmd, int cmd_type, int validate, char *match) {
     session.curr_cmd_rec = cmd;
     session.curr_phase = cmd_type;
 
-    if (c->cmd_type == cmd_type) {
-      if (c->group) {
-        cmd->group = pstrdup(cmd->pool, c->group);
-      }
-
-      if (c->requires_auth &&
-          cmd_auth_chk &&
-          !cmd_auth_chk(cmd)) {
-        pr_trace_msg("command", 8,
-          "command '%s' failed 'requires_auth' check for mod_%s.c",
-          (char *) cmd->argv[0], c->m->name);
-        errno = EACCES;
-        return -1;
-      }
-
-      if (cmd->tmp_pool == NULL) {
-        cmd->tmp_pool = make_sub_pool(cmd->pool);
-        pr_pool_tag(cmd->tmp_pool, "cmd_rec tmp pool");
-      }
-
-      cmdargstr = pr_cmd_get_displayable_str(cmd, &cmdargstrlen);
+    if (c->group) {
+      cmd->group = pstrdup(cmd->pool, c->group);
+    }
 
-      if (cmd_type == CMD) {
+    if (c->requires_auth &&
+        cmd_auth_chk &&
+        !cmd_auth_chk(cmd)) {
+      pr_trace_msg("command", 8,
+        "command '%s' failed 'requires_auth' check for mod_%s.c",
+        (char *) cmd->argv[0], c->m->name);
+      errno = EACCES;
+      return -1;
+    }
 
-        /* The client has successfully authenticated... */
-        if (session.user) {
-          char *args = NULL;
+    if (cmd->tmp_pool == NULL) {
+      cmd->tmp_pool = make_sub_pool(cmd->pool);
+      pr_pool_tag(cmd->tmp_pool, "cmd_rec tmp pool");
+    }
 
-          /* Be defensive, and check whether cmdargstrlen has a value.
-           * If it's zero, assume we need to use strchr(3), rather than
-           * memchr(2); see Bug#3714.
-           */
-          if (cmdargstrlen > 0) {
-            args = memchr(cmdargstr, ' ', cmdargstrlen);
+    cmdargstr = pr_cmd_get_displayable_str(cmd, &cmdargstrlen);
 
-          } else {
-            args = strchr(cmdargstr, ' ');
-          }
+    if (cmd_type == CMD) {
 
-          pr_scoreboard_entry_update(session.pid,
-            PR_SCORE_CMD, "%s", cmd->argv[0], NULL, NULL);
-          pr_scoreboard_entry_update(session.pid,
-            PR_SCORE_CMD_ARG, "%s", args ? (args + 1) : "", NULL, NULL);
+      /* The client has successfully authenticated... */
+      if (session.user) {
+        char *args = NULL;
 
-          pr_proctitle_set("%s - %s: %s", session.user, session.proc_prefix,
-            cmdargstr);
+        /* Be defensive, and check whether cmdargstrlen has a value.
+         * If it's zero, assume we need to use strchr(3), rather than
+         * memchr(2); see Bug#3714.
+         */
+        if (cmdargstrlen > 0) {
+          args = memchr(cmdargstr, ' ', cmdargstrlen);
 
-        /* ...else the client has not yet authenticated */
         } else {
-          pr_proctitle_set("%s:%d: %s", session.c->remote_addr ?
-            pr_netaddr_get_ipstr(session.c->remote_addr) : "?",
-            session.c->remote_port ? session.c->remote_port : 0, cmdargstr);
+          args = strchr(cmdargstr, ' ');
         }
-      }
 
-      /* Skip logging the internal CONNECT/DISCONNECT commands. */
-      if (!(cmd->cmd_class & CL_CONNECT) &&
-          !(cmd->cmd_class & CL_DISCONNECT)) {
-
-        pr_log_debug(DEBUG4, "dispatching %s command '%s' to mod_%s",
-          (cmd_type == PRE_CMD ? "PRE_CMD" :
-           cmd_type == CMD ? "CMD" :
-           cmd_type == POST_CMD ? "POST_CMD" :
-           cmd_type == POST_CMD_ERR ? "POST_CMD_ERR" :
-           cmd_type == LOG_CMD ? "LOG_CMD" :
-           cmd_type == LOG_CMD_ERR ? "LOG_CMD_ERR" :
-           "(unknown)"),
-          cmdargstr, c->m->name);
-
-        pr_trace_msg("command", 7, "dispatching %s command '%s' to mod_%s.c",
-          (cmd_type == PRE_CMD ? "PRE_CMD" :
-           cmd_type == CMD ? "CMD" :
-           cmd_type == POST_CMD ? "POST_CMD" :
-           cmd_type == POST_CMD_ERR ? "POST_CMD_ERR" :
-           cmd_type == LOG_CMD ? "LOG_CMD" :
-           cmd_type == LOG_CMD_ERR ? "LOG_CMD_ERR" :
-           "(unknown)"),
-          cmdargstr, c->m->name);
+        pr_scoreboard_entry_update(session.pid,
+          PR_SCORE_CMD, "%s", cmd->argv[0], NULL, NULL);
+        pr_scoreboard_entry_update(session.pid,
+          PR_SCORE_CMD_ARG, "%s", args ? (args + 1) : "", NULL, NULL);
+
+        pr_proctitle_set("%s - %s: %s", session.user, session.proc_prefix,
+          cmdargstr);
+
+      /* ...else the client has not yet authenticated */
+      } else {
+        pr_proctitle_set("%s:%d: %s", session.c->remote_addr ?
+          pr_netaddr_get_ipstr(session.c->remote_addr) : "?",
+          session.c->remote_port ? session.c->remote_port : 0, cmdargstr);
       }
+    }
 
-      cmd->cmd_class |= c->cmd_class;
+    /* Skip logging the internal CONNECT/DISCONNECT commands. */
+    if (!(cmd->cmd_class & CL_CONNECT) &&
+        !(cmd->cmd_class & CL_DISCONNECT)) {
 
-      /* KLUDGE: disable umask() for not G_WRITE operations.  Config/
-       * Directory walking code will be completely redesigned in 1.3,
-       * this is only necessary for performance reasons in 1.1/1.2
-       */
+      pr_log_debug(DEBUG4, "dispatching %s command '%s' to mod_%s",
+        (cmd_type == PRE_CMD ? "PRE_CMD" :
+         cmd_type == CMD ? "CMD" :
+         cmd_type == POST_CMD ? "POST_CMD" :
+         cmd_type == POST_CMD_ERR ? "POST_CMD_ERR" :
+         cmd_type == LOG_CMD ? "LOG_CMD" :
+         cmd_type == LOG_CMD_ERR ? "LOG_CMD_ERR" :
+         "(unknown)"),
+        cmdargstr, c->m->name);
+
+      pr_trace_msg("command", 7, "dispatching %s command '%s' to mod_%s.c",
+        (cmd_type == PRE_CMD ? "PRE_CMD" :
+         cmd_type == CMD ? "CMD" :
+         cmd_type == POST_CMD ? "POST_CMD" :
+         cmd_type == POST_CMD_ERR ? "POST_CMD_ERR" :
+         cmd_type == LOG_CMD ? "LOG_CMD" :
+         cmd_type == LOG_CMD_ERR ? "LOG_CMD_ERR" :
+         "(unknown)"),
+        cmdargstr, c->m->name);
+    }
 
-      if (c->group == NULL ||
-          strcmp(c->group, G_WRITE) != 0) {
-        kludge_disable_umask();
-      }
+    cmd->cmd_class |= c->cmd_class;
 
-      mr = pr_module_call(c->m, c->handler, cmd);
-      kludge_enable_umask();
+    /* KLUDGE: disable umask() for not G_WRITE operations.  Config/
+     * Directory walking code will be completely redesigned in 1.3,
+     * this is only necessary for performance reasons in 1.1/1.2
+     */
 
-      if (MODRET_ISHANDLED(mr)) {
-        success = 1;
+    if (c->group == NULL ||
+        strcmp(c->group, G_WRITE) != 0) {
+      kludge_disable_umask();
+    }
 
-      } else if (MODRET_ISERROR(mr)) {
-        xerrno = errno;
-        success = -1;
+    mr = pr_module_call(c->m, c->handler, cmd);
+    kludge_enable_umask();
 
-        if (cmd_type == POST_CMD ||
-            cmd_type == LOG_CMD ||
-            cmd_type == LOG_CMD_ERR) {
-          if (MODRET_ERRMSG(mr)) {
-            pr_log_pri(PR_LOG_NOTICE, "%s", MODRET_ERRMSG(mr));
-          }
+    if (MODRET_ISHANDLED(mr)) {
+      success = 1;
 
-          /* Even though we normally want to return a negative value
-           * for success (indicating lack of success), for
-           * LOG_CMD/LOG_CMD_ERR handlers, we always want to handle
-           * errors as a success value of zero (meaning "keep looking").
-           *
-           * This will allow the cmd_rec to continue to be dispatched to
-           * the other interested handlers (Bug#3633).
-           */
-          if (cmd_type == LOG_CMD || 
-              cmd_type == LOG_CMD_ERR) {
-            success = 0;
-          }
+    } else if (MODRET_ISERROR(mr)) {
+      xerrno = errno;
+      success = -1;
 
-        } else if (send_error) {
-          if (MODRET_ERRNUM(mr) &&
-              MODRET_ERRMSG(mr)) {
-            pr_response_add_err(MODRET_ERRNUM(mr), "%s", MODRET_ERRMSG(mr));
+      if (cmd_type == POST_CMD ||
+          cmd_type == LOG_CMD ||
+          cmd_type == LOG_CMD_ERR) {
+        if (MODRET_ERRMSG(mr)) {
+          pr_log_pri(PR_LOG_NOTICE, "%s", MODRET_ERRMSG(mr));
+        }
 
-          } else if (MODRET_ERRMSG(mr)) {
-            pr_response_send_raw("%s", MODRET_ERRMSG(mr));
-          }
+        /* Even though we normally want to return a negative value
+         * for success (indicating lack of success), for
+         * LOG_CMD/LOG_CMD_ERR handlers, we always want to handle
+         * errors as a success value of zero (meaning "keep looking").
+         *
+         * This will allow the cmd_rec to continue to be dispatched to
+         * the other interested handlers (Bug#3633).
+         */
+        if (cmd_type == LOG_CMD || 
+            cmd_type == LOG_CMD_ERR) {
+          success = 0;
         }
 
-        errno = xerrno;
-      }
+      } else if (send_error) {
+        if (MODRET_ERRNUM(mr) &&
+            MODRET_ERRMSG(mr)) {
+          pr_response_add_err(MODRET_ERRNUM(mr), "%s", MODRET_ERRMSG(mr));
 
-      if (session.user &&
-          !(session.sf_flags & SF_XFER) &&
-          cmd_type == CMD) {
-        pr_session_set_idle();
+        } else if (MODRET_ERRMSG(mr)) {
+          pr_response_send_raw("%s", MODRET_ERRMSG(mr));
+        }
       }
 
-      destroy_pool(cmd->tmp_pool);
-      cmd->tmp_pool = NULL;
+      errno = xerrno;
     }
 
-    if (!success) {
-      c = pr_stash_get_symbol2(PR_SYM_CMD, match, c, index_cache, hash_cache);
+    if (session.user &&
+        !(session.sf_flags & SF_XFER) &&
+        cmd_type == CMD) {
+      pr_session_set_idle();
     }
+
+    destroy_pool(cmd->tmp_pool);
+    cmd->tmp_pool = NULL;
   }
 
   /* Note: validate is only TRUE for the CMD phase, for specific handlers
    * (as opposed to any C_ANY handlers).
    */
 
-  if (!c &&
-      !success &&
+  if (!success &&
       validate) {
     char *method;
 
@@ -618,10 +695,34 @@ static int set_cmd_start_ms(cmd_rec *cmd) {
   return pr_table_add(cmd->notes, "start_ms", v, sizeof(uint64_t));
 }
 
+/* Records the time spent in a dispatch phase, for the command latency
+ * statistics, and returns the start time of the next phase.
+ */
+static uint64_t record_cmd_phase(cmd_rec *cmd, int phase,
+    uint64_t start_usecs) {
+  struct timeval tv;
+  uint64_t now_usecs;
+  int xerrno;
+
+  /* Preserve errno, as set by the handlers, for our caller. */
+  xerrno = errno;
+  (void) gettimeofday(&tv, NULL);
+  now_usecs = ((uint64_t) tv.tv_sec * 1000000) + tv.tv_usec;
+
+  if (start_usecs > 0) {
+    (void) pr_cmd_stats_record(cmd, phase,
+      now_usecs > start_usecs ? now_usecs - start_usecs : 0);
+  }
+
+  errno = xerrno;
+  return now_usecs;
+}
+
 int pr_cmd_dispatch_phase(cmd_rec *cmd, int phase, int flags) {
   char *cp = NULL;
   int success = 0, xerrno = 0;
   pool *resp_pool = NULL;
+  uint64_t phase_usecs;
 
   if (cmd == NULL) {
     errno = EINVAL;
@@ -669,6 +770,7 @@ int pr_cmd_dispatch_phase(cmd_rec *cmd, int phase, int flags) {
   }
 
   set_cmd_start_ms(cmd);
+  phase_usecs = record_cmd_phase(cmd, phase, 0);
 
   if (phase == 0) {
     /* First, dispatch to wildcard PRE_CMD handlers. */
@@ -677,15 +779,18 @@ int pr_cmd_dispatch_phase(cmd_rec *cmd, int phase, int flags) {
       /* No success yet?  Run other PRE_CMD phase handlers. */
       success = _dispatch(cmd, PRE_CMD, FALSE, NULL);
     }
+    phase_usecs = record_cmd_phase(cmd, PRE_CMD, phase_usecs);
 
     if (success < 0) {
       /* Dispatch to POST_CMD_ERR handlers as well. */
 
       _dispatch(cmd, POST_CMD_ERR, FALSE, C_ANY);
       _dispatch(cmd, POST_CMD_ERR, FALSE, NULL);
+      phase_usecs = record_cmd_phase(cmd, POST_CMD_ERR, phase_usecs);
 
       _dispatch(cmd, LOG_CMD_ERR, FALSE, C_ANY);
       _dispatch(cmd, LOG_CMD_ERR, FALSE, NULL);
+      (void) record_cmd_phase(cmd, LOG_CMD_ERR, phase_usecs);
 
       xerrno = errno;
       pr_trace_msg("response", 9, "flushing error response list for '%s'",
@@ -703,15 +808,18 @@ int pr_cmd_dispatch_phase(cmd_rec *cmd, int phase, int flags) {
     if (success == 0) {
       success = _dispatch(cmd, CMD, TRUE, NULL);
     }
+    phase_usecs = record_cmd_phase(cmd, CMD, phase_usecs);
 
     if (success == 1) {
       success = _dispatch(cmd, POST_CMD, FALSE, C_ANY);
       if (success == 0) {
         success = _dispatch(cmd, POST_CMD, FALSE, NULL);
       }
+      phase_usecs = record_cmd_phase(cmd, POST_CMD, phase_usecs);
 
       _dispatch(cmd, LOG_CMD, FALSE, C_ANY);
       _dispatch(cmd, LOG_CMD, FALSE, NULL);
+      (void) record_cmd_phase(cmd, LOG_CMD, phase_usecs);
 
       xerrno = errno;
       pr_trace_msg("response", 9, "flushing response list for '%s'",
@@ -727,9 +835,11 @@ int pr_cmd_dispatch_phase(cmd_rec *cmd, int phase, int flags) {
       if (success == 0) {
         success = _dispatch(cmd, POST_CMD_ERR, FALSE, NULL);
       }
+      phase_usecs = record_cmd_phase(cmd, POST_CMD_ERR, phase_usecs);
 
       _dispatch(cmd, LOG_CMD_ERR, FALSE, C_ANY);
       _dispatch(cmd, LOG_CMD_ERR, FALSE, NULL);
+      (void) record_cmd_phase(cmd, LOG_CMD_ERR, phase_usecs);
 
       xerrno = errno;
       pr_trace_msg("response", 9, "flushing error response list for '%s'",
@@ -771,6 +881,7 @@ int pr_cmd_dispatch_phase(cmd_rec *cmd, int phase, int flags) {
         errno = EINVAL;
         return -1;
     }
+    (void) record_cmd_phase(cmd, phase, phase_usecs);
 
     if (flags & PR_CMD_DISPATCH_FL_SEND_RESPONSE) {
       xerrno = errno;
@@ -899,6 +1010,34 @@ static cmd_rec *make_ftp_cmd(pool *p, char *buf, size_t buflen, int flags) {
   return cmd;
 }
 
+/* Count the dispatched command, and the time taken to handle it, in the
+ * session's scoreboard entry.
+ */
+static void cmd_update_stats(cmd_rec *cmd) {
+  const uint64_t *start_ms;
+  uint64_t finish_ms;
+
+  if (cmd->notes == NULL) {
+    return;
+  }
+
+  start_ms = pr_table_get(cmd->notes, "start_ms", NULL);
+  if (start_ms == NULL ||
+      pr_gettimeofday_millis(&finish_ms) < 0) {
+    return;
+  }
+
+  session.total_cmds++;
+  if (finish_ms > *start_ms) {
+    session.total_cmd_ms += (finish_ms - *start_ms);
+  }
+
+  pr_scoreboard_entry_update(session.pid,
+    PR_SCORE_CMD_COUNT, session.total_cmds,
+    PR_SCORE_CMD_MS, (unsigned long) session.total_cmd_ms,
+    NULL);
+}
+
 static void cmd_loop(server_rec *server, conn_t *c) {
 
   while (TRUE) {
@@ -942,6 +1081,7 @@ static void cmd_loop(server_rec *server, conn_t *c) {
       }
  
       pr_cmd_dispatch(cmd);
+      cmd_update_stats(cmd);
       destroy_pool(cmd->pool);
       session.curr_cmd = NULL;
       session.curr_cmd_id = 0;
@@ -975,6 +1115,14 @@ void restart_daemon(void *d1, void *d2, void *d3, void *d4) {
 
   gettimeofday(&restart_start, NULL);
 
+#ifndef PR_DEVEL_NO_FORK
+  /* Idle pre-forked children hold the old listening sockets; closing the
+   * pipe of death tells them all to exit.
+   */
+  prefork_close_pod();
+  prefork_min_spare = prefork_max_spare = 0;
+#endif /* PR_DEVEL_NO_FORK */
+
   /* Make sure none of our children haven't completed start up */
   FD_ZERO(&childfds);
   maxfd = -1;
@@ -1116,108 +1264,138 @@ static void set_server_privs(void) {
   }
 }
 
-static void fork_server(int fd, conn_t *l, unsigned char no_fork) {
-  conn_t *conn = NULL;
-  int i, rev;
-  int semfds[2] = { -1, -1 };
-  int xerrno = 0;
-
 #ifndef PR_DEVEL_NO_FORK
+/* Forks a new child process.  A race condition exists on heavily loaded
+ * servers where the parent catches SIGHUP and attempts to close/re-open the
+ * main listening socket(s), however the children haven't finished closing
+ * them (EADDRINUSE).  We use a semaphore pipe here to flag the parent once
+ * the child has closed all former listening sockets; the child receives the
+ * write side of that pipe in semfd.
+ *
+ * Returns the PID of the child in the parent, zero in the child, and -1 if
+ * there was an error.
+ */
+static pid_t fork_child(int *semfd) {
   pid_t pid;
   sigset_t sig_set;
+  int semfds[2] = { -1, -1 };
+  int xerrno = 0;
 
-  if (no_fork == FALSE) {
+  if (pipe(semfds) == -1) {
+    pr_log_pri(PR_LOG_ALERT, "pipe(2) failed: %s", strerror(errno));
+    return -1;
+  }
 
-    /* A race condition exists on heavily loaded servers where the parent
-     * catches SIGHUP and attempts to close/re-open the main listening
-     * socket(s), however the children haven't finished closing them
-     * (EADDRINUSE).  We use a semaphore pipe here to flag the parent once
-     * the child has closed all former listening sockets.
-     */
+  /* Need to make sure the child (writer) end of the pipe isn't
+   * < 2 (stdio/stdout/stderr) as this will cause problems later.
+   */
+  semfds[1] = pr_fs_get_usable_fd(semfds[1]);
 
-    if (pipe(semfds) == -1) {
-      pr_log_pri(PR_LOG_ALERT, "pipe(2) failed: %s", strerror(errno));
-      (void) close(fd);
-      return;
-    }
+  /* Make sure we set the close-on-exec flag for the parent's read side
+   * of the pipe.
+   */
+  (void) fcntl(semfds[0], F_SETFD, FD_CLOEXEC);
 
-    /* Need to make sure the child (writer) end of the pipe isn't
-     * < 2 (stdio/stdout/stderr) as this will cause problems later.
-     */
-    semfds[1] = pr_fs_get_usable_fd(semfds[1]);
+  /* We block SIGCHLD to prevent a race condition if the child
+   * dies before we can record it's pid.  Also block SIGTERM to
+   * prevent sig_terminate() from examining the child list
+   */
 
-    /* Make sure we set the close-on-exec flag for the parent's read side
-     * of the pipe.
-     */
-    (void) fcntl(semfds[0], F_SETFD, FD_CLOEXEC);
+  sigemptyset(&sig_set);
+  sigaddset(&sig_set, SIGTERM);
+  sigaddset(&sig_set, SIGCHLD);
+  sigaddset(&sig_set, SIGUSR1);
+  sigaddset(&sig_set, SIGUSR2);
 
-    /* We block SIGCHLD to prevent a race condition if the child
-     * dies before we can record it's pid.  Also block SIGTERM to
-     * prevent sig_terminate() from examining the child list
-     */
+  if (sigprocmask(SIG_BLOCK, &sig_set, NULL) < 0) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to block signal set: %s", strerror(errno));
+  }
 
-    sigemptyset(&sig_set);
-    sigaddset(&sig_set, SIGTERM);
-    sigaddset(&sig_set, SIGCHLD);
-    sigaddset(&sig_set, SIGUSR1);
-    sigaddset(&sig_set, SIGUSR2);
+  pid = fork();
+  xerrno = errno;
 
-    if (sigprocmask(SIG_BLOCK, &sig_set, NULL) < 0) {
+  switch (pid) {
+
+  case 0: /* child */
+    /* No longer the master process. */
+    is_master = FALSE;
+    if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
       pr_log_pri(PR_LOG_NOTICE,
-        "unable to block signal set: %s", strerror(errno));
+        "unable to unblock signal set: %s", strerror(errno));
     }
 
-    pid = fork();
-    xerrno = errno;
-
-    switch (pid) {
+    /* No longer need the read side of the semaphore pipe. */
+    (void) close(semfds[0]);
+    *semfd = semfds[1];
+    break;
 
-    case 0: /* child */
-      /* No longer the master process. */
-      is_master = FALSE;
-      if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
-        pr_log_pri(PR_LOG_NOTICE,
-          "unable to unblock signal set: %s", strerror(errno));
-      }
+  case -1:
+    if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
+      pr_log_pri(PR_LOG_NOTICE,
+        "unable to unblock signal set: %s", strerror(errno));
+    }
 
-      /* No longer need the read side of the semaphore pipe. */
-      (void) close(semfds[0]);
-      break;
+    pr_log_pri(PR_LOG_ALERT, "unable to fork(): %s", strerror(xerrno));
 
-    case -1:
-      if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
-        pr_log_pri(PR_LOG_NOTICE,
-          "unable to unblock signal set: %s", strerror(errno));
-      }
+    (void) close(semfds[0]);
+    (void) close(semfds[1]);
+    break;
 
-      pr_log_pri(PR_LOG_ALERT, "unable to fork(): %s", strerror(xerrno));
+  default: /* parent */
+    child_add(pid, semfds[0]);
+    (void) close(semfds[1]);
 
-      /* The parent doesn't need the socket open. */
-      (void) close(fd);
-      (void) close(semfds[0]);
-      (void) close(semfds[1]);
+    /* Unblock the signals now as sig_child() will catch
+     * an "immediate" death and remove the pid from the children list
+     */
+    if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
+      pr_log_pri(PR_LOG_NOTICE,
+        "unable to unblock signal set: %s", strerror(errno));
+    }
+    break;
+  }
 
-      return;
+  return pid;
+}
+#endif /* PR_DEVEL_NO_FORK */
 
-    default: /* parent */
-      /* The parent doesn't need the socket open */
-      (void) close(fd);
+static void set_session_signals(void) {
+  if (signal(SIGUSR1, pr_signals_handle_disconnect) == SIG_ERR) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to install SIGUSR1 (signal %d) handler: %s", SIGUSR1,
+      strerror(errno));
+  }
 
-      child_add(pid, semfds[0]);
-      (void) close(semfds[1]);
+  if (signal(SIGUSR2, pr_signals_handle_event) == SIG_ERR) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to install SIGUSR2 (signal %d) handler: %s", SIGUSR2,
+      strerror(errno));
+  }
 
-      /* Unblock the signals now as sig_child() will catch
-       * an "immediate" death and remove the pid from the children list
-       */
-      if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
-        pr_log_pri(PR_LOG_NOTICE,
-          "unable to unblock signal set: %s", strerror(errno));
-      }
+  if (signal(SIGCHLD, SIG_DFL) == SIG_ERR) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to install SIGCHLD (signal %d) handler: %s", SIGCHLD,
+      strerror(errno));
+  }
 
-      return;
-    }
+  if (signal(SIGHUP, SIG_IGN) == SIG_ERR) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to install SIGHUP (signal %d) handler: %s", SIGHUP,
+      strerror(errno));
   }
+}
+
+/* Handles the accepted connection fd, on listener l, in the session process.
+ * The semfd is the write side of the semaphore pipe, if any, which is closed
+ * once the former listening sockets have been closed.
+ */
+static void start_session(int fd, conn_t *l, int semfd) {
+  conn_t *conn = NULL;
+  int i, rev;
+  int xerrno = 0;
 
+#ifndef PR_DEVEL_NO_FORK
   session.pid = getpid();
 
   /* No longer need any listening fds. */
@@ -1247,29 +1425,7 @@ static void fork_server(int fd, conn_t *l, unsigned char no_fork) {
 #endif /* PR_DEVEL_NO_FORK */
 
   /* Child is running here */
-  if (signal(SIGUSR1, pr_signals_handle_disconnect) == SIG_ERR) {
-    pr_log_pri(PR_LOG_NOTICE,
-      "unable to install SIGUSR1 (signal %d) handler: %s", SIGUSR1,
-      strerror(errno));
-  }
-
-  if (signal(SIGUSR2, pr_signals_handle_event) == SIG_ERR) {
-    pr_log_pri(PR_LOG_NOTICE,
-      "unable to install SIGUSR2 (signal %d) handler: %s", SIGUSR2,
-      strerror(errno));
-  }
-
-  if (signal(SIGCHLD, SIG_DFL) == SIG_ERR) {
-    pr_log_pri(PR_LOG_NOTICE,
-      "unable to install SIGCHLD (signal %d) handler: %s", SIGCHLD,
-      strerror(errno));
-  }
-
-  if (signal(SIGHUP, SIG_IGN) == SIG_ERR) {
-    pr_log_pri(PR_LOG_NOTICE,
-      "unable to install SIGHUP (signal %d) handler: %s", SIGHUP,
-      strerror(errno));
-  }
+  set_session_signals();
 
   /* From this point on, syslog stays open. We close it first so that the
    * logger will pick up our new PID.
@@ -1368,7 +1524,13 @@ static void fork_server(int fd, conn_t *l, unsigned char no_fork) {
    * we are all grown up and have finished housekeeping (closing
    * former listen sockets).
    */
-  (void) close(semfds[1]);
+  if (semfd != -1) {
+    /* Writing a byte first lets the parent tell this apart from a child
+     * which exited without handling a connection.
+     */
+    (void) write(semfd, "+", 1);
+    (void) close(semfd);
+  }
 
   /* Now perform reverse DNS lookups. */
   if (ServerUseReverseDNS) {
@@ -1479,11 +1641,19 @@ static void fork_server(int fd, conn_t *l, unsigned char no_fork) {
       "Blocked by <Limit LOGIN>");
   }
 
-  /* Create a table for modules to use. */
+  /* Create a table for modules to use.  Modules may stash many notes over
+   * the lifetime of a session, thus we use the backend which grows as
+   * needed.
+   */
   session.notes = pr_table_alloc(session.pool, 0);
   if (session.notes == NULL) {
     pr_log_debug(DEBUG3, "error creating session.notes table: %s",
       strerror(errno));
+
+  } else {
+    int backend = PR_TABLE_BACKEND_OPEN_ADDR;
+
+    (void) pr_table_ctl(session.notes, PR_TABLE_CTL_SET_BACKEND, &backend);
   }
 
   /* Prepare the Timers API. */
@@ -1527,6 +1697,283 @@ static void fork_server(int fd, conn_t *l, unsigned char no_fork) {
 #endif /* PR_DEVEL_NO_DAEMON */
 }
 
+static void fork_server(int fd, conn_t *l, unsigned char no_fork) {
+  int semfd = -1;
+
+#ifndef PR_DEVEL_NO_FORK
+  if (no_fork == FALSE) {
+    pid_t pid;
+
+    pid = fork_child(&semfd);
+    if (pid != 0) {
+      /* The parent doesn't need the socket open. */
+      (void) close(fd);
+      return;
+    }
+  }
+#endif /* PR_DEVEL_NO_FORK */
+
+  start_session(fd, l, semfd);
+}
+
+#ifndef PR_DEVEL_NO_FORK
+/* Pre-forked session processes.
+ *
+ * When PreforkChildren is configured, the master daemon does not accept
+ * connections itself.  Instead, it keeps a pool of idle children which wait
+ * on the shared listening sockets; the first idle child to accept a
+ * connection becomes the session process for it.  The child then closes its
+ * semaphore pipe, just like a freshly forked session process, which is how
+ * the master tells idle children from busy ones.
+ *
+ * To shrink the pool, the master writes one byte per excess child into the
+ * "pipe of death"; the idle child which reads a byte exits.  Closing the
+ * pipe (e.g. on restart) makes every idle child exit.
+ */
+static int prefork_podfds[2] = { -1, -1 };
+
+/* The number of idle children currently wanted, between the configured
+ * min-spare and max-spare, and the number of connections accepted by idle
+ * children since the last pass of prefork_maintain().
+ */
+static unsigned int prefork_target = 0;
+static unsigned long prefork_naccepts = 0;
+
+static void prefork_close_pod(void) {
+  if (prefork_podfds[0] != -1) {
+    (void) close(prefork_podfds[0]);
+    prefork_podfds[0] = -1;
+  }
+
+  if (prefork_podfds[1] != -1) {
+    (void) close(prefork_podfds[1]);
+    prefork_podfds[1] = -1;
+  }
+}
+
+static int prefork_open_pod(void) {
+  if (pipe(prefork_podfds) < 0) {
+    int xerrno = errno;
+
+    pr_log_pri(PR_LOG_ALERT, "pipe(2) failed: %s", strerror(xerrno));
+    prefork_podfds[0] = prefork_podfds[1] = -1;
+
+    errno = xerrno;
+    return -1;
+  }
+
+  /* Idle children race to read from the pipe, and the master must never
+   * block writing to it.
+   */
+  (void) fcntl(prefork_podfds[0], F_SETFL,
+    fcntl(prefork_podfds[0], F_GETFL) | O_NONBLOCK);
+  (void) fcntl(prefork_podfds[1], F_SETFL,
+    fcntl(prefork_podfds[1], F_GETFL) | O_NONBLOCK);
+  (void) fcntl(prefork_podfds[0], F_SETFD, FD_CLOEXEC);
+  (void) fcntl(prefork_podfds[1], F_SETFD, FD_CLOEXEC);
+
+  return 0;
+}
+
+/* The idle loop of a pre-forked child; only returns by way of exit(). */
+static void prefork_child(int semfd) {
+  int fd = -1, podfd;
+  conn_t *listen_conn = NULL;
+
+  podfd = prefork_podfds[0];
+  (void) close(prefork_podfds[1]);
+  prefork_podfds[1] = -1;
+
+  set_session_signals();
+  pr_proctitle_set("(idle, waiting for connection)");
+
+  while (TRUE) {
+    fd_set listenfds;
+    int maxfd, res;
+
+    maxfd = pr_ipbind_listen(&listenfds);
+
+    FD_SET(podfd, &listenfds);
+    if (podfd > maxfd) {
+      maxfd = podfd;
+    }
+
+    res = select(maxfd + 1, &listenfds, NULL, NULL, NULL);
+    if (res < 0) {
+      int xerrno = errno;
+
+      if (xerrno == EINTR) {
+        pr_signals_handle();
+        continue;
+      }
+
+      pr_log_pri(PR_LOG_WARNING, "select(2) failed in idle child: %s",
+        strerror(xerrno));
+      exit(1);
+    }
+
+    if (FD_ISSET(podfd, &listenfds)) {
+      char buf;
+
+      /* Either we won the byte written by the master, or the master closed
+       * the pipe; both mean that this child is no longer wanted.  EAGAIN
+       * means that another idle child took the byte.
+       */
+      res = read(podfd, &buf, 1);
+      if (res >= 0) {
+        pr_trace_msg("prefork", 9, "idle child (PID %lu) exiting",
+          (unsigned long) getpid());
+        exit(0);
+      }
+    }
+
+    listen_conn = pr_ipbind_accept_conn(&listenfds, &fd);
+    if (listen_conn != NULL &&
+        fd >= 0) {
+      break;
+    }
+  }
+
+  (void) close(podfd);
+  prefork_podfds[0] = -1;
+
+  /* The shutdown message state was inherited from the master when this child
+   * was forked, and may be stale by now.
+   */
+  switch (check_shutmsg(permanent_pool, PR_SHUTMSG_PATH, &shut, &deny,
+      &disc, shutmsg, sizeof(shutmsg))) {
+    case 1:
+      shutting_down = TRUE;
+      break;
+
+    default:
+      shutting_down = FALSE;
+      deny = disc = (time_t) 0;
+      break;
+  }
+
+  start_session(fd, listen_conn, semfd);
+
+  /* The session is over; idle children are never reused. */
+  exit(0);
+}
+
+static unsigned long prefork_idle_count(void) {
+  unsigned long idle = 0;
+
+  if (child_count()) {
+    pr_child_t *ch;
+
+    for (ch = child_get(NULL); ch; ch = child_get(ch)) {
+      if (ch->ch_dead == FALSE &&
+          ch->ch_pipefd != -1) {
+        idle++;
+      }
+    }
+  }
+
+  return idle;
+}
+
+/* Grows or shrinks the pool of idle children, as needed. */
+static void prefork_maintain(void) {
+  unsigned long idle, pending = 0;
+  int navail = 0;
+
+  if (prefork_podfds[0] == -1 &&
+      prefork_open_pod() < 0) {
+    return;
+  }
+
+  /* Bytes not yet read from the pipe of death represent idle children which
+   * are already on their way out.
+   */
+  if (ioctl(prefork_podfds[0], FIONREAD, &navail) == 0 &&
+      navail > 0) {
+    pending = navail;
+  }
+
+  idle = prefork_idle_count();
+  idle = (idle > pending) ? (idle - pending) : 0;
+
+  /* Grow the wanted number of idle children by the number of connections
+   * taken since the last pass, up to max-spare, and let it decay back towards
+   * min-spare, one child per pass, once connections stop arriving.
+   */
+  if (prefork_target < prefork_min_spare) {
+    prefork_target = prefork_min_spare;
+  }
+
+  if (prefork_naccepts > 0) {
+    if (prefork_target + prefork_naccepts > prefork_max_spare) {
+      prefork_target = prefork_max_spare;
+
+    } else {
+      prefork_target += prefork_naccepts;
+    }
+
+    prefork_naccepts = 0;
+
+  } else if (prefork_target > prefork_min_spare) {
+    prefork_target--;
+  }
+
+  if (prefork_target > prefork_max_spare) {
+    prefork_target = prefork_max_spare;
+  }
+
+  if (idle < prefork_target) {
+    register unsigned int i;
+    unsigned long nspawn;
+
+    nspawn = prefork_target - idle;
+    if (nspawn > PR_TUNABLE_PREFORK_MAX_SPAWN) {
+      nspawn = PR_TUNABLE_PREFORK_MAX_SPAWN;
+    }
+
+    pr_trace_msg("prefork", 12, "%lu idle %s (want %u), spawning %lu",
+      idle, idle != 1 ? "children" : "child", prefork_target, nspawn);
+
+    for (i = 0; i < nspawn; i++) {
+      int semfd = -1;
+      pid_t pid;
+
+      /* Idle children count against MaxInstances as well. */
+      if (ServerMaxInstances > 0 &&
+          child_count() >= ServerMaxInstances) {
+        pr_trace_msg("prefork", 9,
+          "MaxInstances (%lu) reached, not spawning idle children",
+          ServerMaxInstances);
+        break;
+      }
+
+      pid = fork_child(&semfd);
+      if (pid == 0) {
+        prefork_child(semfd);
+      }
+
+      if (pid < 0) {
+        break;
+      }
+    }
+
+  } else if (idle > prefork_target) {
+    unsigned long nexit;
+
+    nexit = idle - prefork_target;
+
+    pr_trace_msg("prefork", 12, "%lu idle %s (want %u), retiring %lu",
+      idle, idle != 1 ? "children" : "child", prefork_target, nexit);
+
+    while (nexit-- > 0) {
+      if (write(prefork_podfds[1], "!", 1) != 1) {
+        break;
+      }
+    }
+  }
+}
+#endif /* PR_DEVEL_NO_FORK */
+
 static void disc_children(void) {
 
   if (disc && disc <= time(NULL) && child_count()) {
@@ -1554,10 +2001,59 @@ static void disc_children(void) {
   }
 }
 
+/* Hands a newly accepted connection off to a session process, unless the
+ * MaxInstances or MaxConnectionRate limits have been reached.
+ */
+static void handle_accepted_conn(int fd, conn_t *listen_conn,
+    unsigned long nconnects) {
+
+  /* Check for exceeded MaxInstances. */
+  if (ServerMaxInstances > 0 &&
+      child_count() >= ServerMaxInstances) {
+    pr_event_generate("core.max-instances", NULL);
+    
+    pr_log_pri(PR_LOG_WARNING,
+      "MaxInstances (%lu) reached, new connection denied",
+      ServerMaxInstances);
+    close(fd);
+
+  /* Check for exceeded MaxConnectionRate. */
+  } else if (max_connects && (nconnects > max_connects)) {
+    pr_event_generate("core.max-connection-rate", NULL);
+
+    pr_log_pri(PR_LOG_WARNING,
+      "MaxConnectionRate (%lu/%u secs) reached, new connection denied",
+      max_connects, max_connect_interval);
+    close(fd);
+
+  /* Fork off a child to handle the connection. */
+  } else {
+    PR_DEVEL_CLOCK(fork_server(fd, listen_conn, no_forking));
+  }
+}
+
+#ifdef PR_USE_EPOLL
+static int accept_conn_cb(int fd, conn_t *listen_conn, void *user_data) {
+  unsigned long *nconnects;
+
+  nconnects = user_data;
+  handle_accepted_conn(fd, listen_conn, *nconnects);
+
+  /* Each connection in this batch counts towards MaxConnectionRate. */
+  (*nconnects)++;
+  return 0;
+}
+#endif /* PR_USE_EPOLL */
+
 static void daemon_loop(void) {
+#ifdef PR_USE_EPOLL
+  int epfd = -1;
+#else
   fd_set listenfds;
   conn_t *listen_conn;
-  int i, err_count = 0, fd, xerrno = 0;
+  int fd;
+#endif /* PR_USE_EPOLL */
+  int i, err_count = 0, xerrno = 0;
   unsigned long nconnects = 0UL;
   time_t last_error;
   struct timeval tv;
@@ -1568,15 +2064,52 @@ static void daemon_loop(void) {
   time(&last_error);
 
   while (TRUE) {
+#ifndef PR_USE_EPOLL
     int maxfd;
+#endif /* PR_USE_EPOLL */
+    unsigned char accepting = TRUE;
 
     run_schedule();
 
+#ifdef PR_USE_EPOLL
+    daemon_npollfds = 0;
+    epfd = pr_ipbind_listen_epoll();
+#else
     FD_ZERO(&listenfds);
     maxfd = pr_ipbind_listen(&listenfds);
+#endif /* PR_USE_EPOLL */
+
+#ifndef PR_DEVEL_NO_FORK
+    if (prefork_min_spare > 0 &&
+        no_forking == FALSE) {
+      /* The idle children accept the connections; we only watch their
+       * semaphore pipes, to learn when they become busy.
+       */
+#ifndef PR_USE_EPOLL
+      FD_ZERO(&listenfds);
+      maxfd = 0;
+#endif /* PR_USE_EPOLL */
+      accepting = FALSE;
+
+      prefork_maintain();
+
+    } else {
+      prefork_close_pod();
+    }
+#endif /* PR_DEVEL_NO_FORK */
+
+#ifdef PR_USE_EPOLL
+    if (accepting == TRUE &&
+        epfd != -1) {
+      daemon_poll_add(epfd);
+    }
 
+    /* Monitor children pipes */
+    semaphore_pollfds();
+#else
     /* Monitor children pipes */
     maxfd = semaphore_fds(&listenfds, maxfd);
+#endif /* PR_USE_EPOLL */
 
     /* Check for ftp shutdown message file */
     switch (check_shutmsg(permanent_pool, PR_SHUTMSG_PATH, &shut, &deny,
@@ -1641,7 +2174,12 @@ static void daemon_loop(void) {
     running = 1;
     xerrno = errno = 0;
 
+#ifdef PR_USE_EPOLL
+    PR_DEVEL_CLOCK(i = poll(daemon_pollfds, daemon_npollfds,
+      (int) (tv.tv_sec * 1000)));
+#else
     PR_DEVEL_CLOCK(i = select(maxfd + 1, &listenfds, NULL, NULL, &tv));
+#endif /* PR_USE_EPOLL */
     if (i < 0) {
       xerrno = errno;
     }
@@ -1714,7 +2252,22 @@ static void daemon_loop(void) {
 
       for (ch = child_get(NULL); ch; ch = child_get(ch)) {
 	if (ch->ch_pipefd != -1 &&
+#ifdef PR_USE_EPOLL
+            daemon_poll_isset(ch->ch_pipefd)) {
+#else
             FD_ISSET(ch->ch_pipefd, &listenfds)) {
+#endif /* PR_USE_EPOLL */
+#ifndef PR_DEVEL_NO_FORK
+          if (prefork_min_spare > 0) {
+            char buf;
+
+            /* Did an idle child take a connection, or simply exit? */
+            if (read(ch->ch_pipefd, &buf, 1) == 1) {
+              prefork_naccepts++;
+            }
+          }
+#endif /* PR_DEVEL_NO_FORK */
+
 	  (void) close(ch->ch_pipefd);
 	  ch->ch_pipefd = -1;
 	}
@@ -1730,44 +2283,29 @@ static void daemon_loop(void) {
 
     pr_signals_handle();
 
-    if (i < 0) {
+    if (i < 0 ||
+        accepting == FALSE) {
       continue;
     }
 
-    /* Accept the connection. */
-    listen_conn = pr_ipbind_accept_conn(&listenfds, &fd);
-
     /* Fork off servers to handle each connection our job is to get back to
      * answering connections ASAP, so leave the work of determining which
      * server the connection is for to our child.
      */
 
+#ifdef PR_USE_EPOLL
+    /* Accept all of the pending connections. */
+    if (epfd != -1 &&
+        daemon_poll_isset(epfd)) {
+      (void) pr_ipbind_accept_conns(accept_conn_cb, &nconnects);
+    }
+#else
+    /* Accept the connection. */
+    listen_conn = pr_ipbind_accept_conn(&listenfds, &fd);
     if (listen_conn != NULL) {
-
-      /* Check for exceeded MaxInstances. */
-      if (ServerMaxInstances > 0 &&
-          child_count() >= ServerMaxInstances) {
-        pr_event_generate("core.max-instances", NULL);
-        
-        pr_log_pri(PR_LOG_WARNING,
-          "MaxInstances (%lu) reached, new connection denied",
-          ServerMaxInstances);
-        close(fd);
-
-      /* Check for exceeded MaxConnectionRate. */
-      } else if (max_connects && (nconnects > max_connects)) {
-        pr_event_generate("core.max-connection-rate", NULL);
-
-        pr_log_pri(PR_LOG_WARNING,
-          "MaxConnectionRate (%lu/%u secs) reached, new connection denied",
-          max_connects, max_connect_interval);
-        close(fd);
-
-      /* Fork off a child to handle the connection. */
-      } else {
-        PR_DEVEL_CLOCK(fork_server(fd, listen_conn, no_forking));
-      }
+      handle_accepted_conn(fd, listen_conn, nconnects);
     }
+#endif /* PR_USE_EPOLL */
 #ifdef PR_DEVEL_NO_DAEMON
     /* Do not continue the while() loop here if not daemonizing. */
     break;
@@ -1923,6 +2461,14 @@ static void standalone_main(void) {
     }
   }
 
+  /* Set up the command latency statistics before any sessions are forked,
+   * so that they all share them with the daemon.
+   */
+  if (pr_cmd_stats_init() < 0) {
+    pr_log_debug(DEBUG3, "unable to track command statistics: %s",
+      strerror(errno));
+  }
+
   PRIVS_ROOT
   pr_delete_scoreboard();
   res = pr_open_scoreboard(O_RDWR);
@@ -2191,6 +2737,12 @@ static void show_settings(void) {
   printf("%s", "    - DSO support\n");
 #endif /* PR_USE_DSO */
 
+#ifdef PR_USE_EPOLL
+  printf("%s", "    + Epoll support\n");
+#else
+  printf("%s", "    - Epoll support\n");
+#endif /* PR_USE_EPOLL */
+
 #ifdef PR_USE_IPV6
   printf("%s", "    + IPv6 support\n");
 #else
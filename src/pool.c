@@ -56,11 +56,41 @@ union block_hdr {
   } h;
 };
 
-static union block_hdr *block_freelist = NULL;
+/* Free blocks are kept on size-classed lists: list i holds the blocks whose
+ * usable size is at least 2^i bytes, but less than 2^(i+1) bytes.
+ */
+#define POOL_FREELIST_COUNT	32
+
+static union block_hdr *block_freelists[POOL_FREELIST_COUNT];
+static size_t block_freelist_bytes = 0;
 
 /* Statistics */
 static unsigned int stat_malloc = 0;	/* incr when malloc required */
 static unsigned int stat_freehit = 0;	/* incr when freelist used */
+static unsigned int stat_release = 0;	/* incr when freelist is full */
+
+/* Allocation counts per pool tag.  Each pool's counts are added to those
+ * of its tag when it is destroyed; the tags are copied, as they may well
+ * have been allocated from the pool itself.
+ */
+#define POOL_TAG_STATS_TAGSZ	64
+
+struct pool_tag_stats {
+  char tag[POOL_TAG_STATS_TAGSZ];
+  unsigned long pool_count;
+  unsigned long alloc_count;
+  unsigned long alloc_bytes;
+};
+
+/* Open addressing table of tags; once full, any further tags are counted
+ * together.
+ */
+struct pool_tag_table {
+  struct pool_tag_stats slots[PR_TUNABLE_POOL_TAG_STATS_MAX];
+  struct pool_tag_stats other;
+};
+
+static struct pool_tag_table pool_tag_stats;
 
 static const char *trace_channel = "pool";
 
@@ -133,6 +163,24 @@ static union block_hdr *malloc_block(size_t size) {
   return blok;
 }
 
+#define BLOCK_SIZE(blok) \
+  ((size_t) ((char *) (blok)->h.endp - (char *) ((blok) + 1)))
+
+/* Returns the index of the free list for blocks of the given size, i.e. the
+ * floor of log2(sz).
+ */
+static unsigned int freelist_index(size_t sz) {
+  unsigned int idx = 0;
+
+  while (sz > 1 &&
+         idx < (POOL_FREELIST_COUNT - 1)) {
+    sz >>= 1;
+    idx++;
+  }
+
+  return idx;
+}
+
 static void chk_on_blk_list(union block_hdr *blok, union block_hdr *free_blk,
     const char *pool_tag) {
 
@@ -155,30 +203,48 @@ static void chk_on_blk_list(union block_hdr *blok, union block_hdr *free_blk,
 /* Free a chain of blocks -- _must_ call with alarms blocked. */
 
 static void free_blocks(union block_hdr *blok, const char *pool_tag) {
-  /* Puts new blocks at head of block list, point next pointer of
-   * last block in chain to free blocks we already had.
+  /* Puts each block at the head of the free list for its size, or hands it
+   * back to the system if the free lists already hold as much memory as
+   * we are willing to keep.
    */
 
-  union block_hdr *old_free_list = block_freelist;
+  while (blok != NULL) {
+    union block_hdr *next;
+    unsigned int idx;
+    size_t blok_sz;
 
-  if (blok == NULL) {
-    /* Don't free an empty pool. */
-    return;
-  }
+    next = blok->h.next;
+    blok_sz = BLOCK_SIZE(blok);
+    idx = freelist_index(blok_sz);
 
-  block_freelist = blok;
+    chk_on_blk_list(blok, block_freelists[idx], pool_tag);
 
-  /* Adjust first_avail pointers */
+    if (PR_TUNABLE_POOL_FREELIST_MAX_SIZE > 0 &&
+        block_freelist_bytes + blok_sz > PR_TUNABLE_POOL_FREELIST_MAX_SIZE) {
+      stat_release++;
+      free(blok);
 
-  while (blok->h.next) {
-    chk_on_blk_list(blok, old_free_list, pool_tag);
-    blok->h.first_avail = (char *) (blok + 1);
-    blok = blok->h.next;
+    } else {
+      blok->h.first_avail = (char *) (blok + 1);
+      blok->h.next = block_freelists[idx];
+      block_freelists[idx] = blok;
+      block_freelist_bytes += blok_sz;
+    }
+
+    blok = next;
   }
+}
 
-  chk_on_blk_list(blok, old_free_list, pool_tag);
-  blok->h.first_avail = (char *) (blok + 1);
-  blok->h.next = old_free_list;
+static union block_hdr *take_free_block(unsigned int idx) {
+  union block_hdr *blok;
+
+  blok = block_freelists[idx];
+  block_freelists[idx] = blok->h.next;
+  blok->h.next = NULL;
+  block_freelist_bytes -= BLOCK_SIZE(blok);
+
+  stat_freehit++;
+  return blok;
 }
 
 /* Get a new block, from the free list if possible, otherwise malloc a new
@@ -191,27 +257,30 @@ static void free_blocks(union block_hdr *blok, const char *pool_tag) {
  */
 
 static union block_hdr *new_block(int minsz, int exact) {
-  union block_hdr **lastptr = &block_freelist;
-  union block_hdr *blok = block_freelist;
+  register unsigned int i;
+  unsigned int idx;
 
   if (!exact) {
     minsz = 1 + ((minsz - 1) / BLOCK_MINFREE);
     minsz *= BLOCK_MINFREE;
   }
 
-  /* Check if we have anything of the requested size on our free list first...
+  /* Check if we have anything of the requested size on our free lists
+   * first.  The list for minsz itself may hold blocks which are too small,
+   * so only its head is considered; any block on the larger lists will do.
    */
-  while (blok) {
-    if (minsz <= ((char *) blok->h.endp - (char *) blok->h.first_avail)) {
-      *lastptr = blok->h.next;
-      blok->h.next = NULL;
+  idx = freelist_index(minsz);
 
-      stat_freehit++;
-      return blok;
-    }
+  if (block_freelists[idx] != NULL &&
+      (size_t) minsz <= BLOCK_SIZE(block_freelists[idx])) {
+    return take_free_block(idx);
+  }
 
-    lastptr = &blok->h.next;
-    blok = blok->h.next;
+  for (i = idx + 1; i < POOL_FREELIST_COUNT; i++) {
+    if (block_freelists[i] != NULL &&
+        (size_t) minsz <= BLOCK_SIZE(block_freelists[i])) {
+      return take_free_block(i);
+    }
   }
 
   /* Nope...damn.  Have to malloc() a new one. */
@@ -235,6 +304,10 @@ struct pool_rec {
   struct pool_rec *parent;
   char *free_first_avail;
   const char *tag;
+
+  /* Statistics */
+  unsigned long alloc_count;
+  unsigned long alloc_bytes;
 };
 
 pool *permanent_pool = NULL;
@@ -270,6 +343,58 @@ static unsigned long bytes_in_block_list(union block_hdr *blok) {
   return size;
 }
 
+/* Finds the entry for the given tag in the table, adding it if need be. */
+static struct pool_tag_stats *tag_stats_get(struct pool_tag_table *tab,
+    const char *tag) {
+  register unsigned int i;
+  unsigned int h = 2166136261U, idx;
+
+  if (tag == NULL) {
+    tag = "<unnamed>";
+  }
+
+  for (i = 0; i < POOL_TAG_STATS_TAGSZ-1 && tag[i] != '\0'; i++) {
+    h = (h ^ (unsigned char) tag[i]) * 16777619U;
+  }
+
+  for (i = 0; i < PR_TUNABLE_POOL_TAG_STATS_MAX; i++) {
+    struct pool_tag_stats *stats;
+
+    idx = (h + i) % PR_TUNABLE_POOL_TAG_STATS_MAX;
+    stats = &(tab->slots[idx]);
+
+    if (stats->tag[0] == '\0') {
+      sstrncpy(stats->tag, tag, sizeof(stats->tag));
+      return stats;
+    }
+
+    if (strncmp(stats->tag, tag, POOL_TAG_STATS_TAGSZ-1) == 0) {
+      return stats;
+    }
+  }
+
+  return &(tab->other);
+}
+
+static void tag_stats_add(struct pool_tag_table *tab, pool *p) {
+  struct pool_tag_stats *stats;
+
+  stats = tag_stats_get(tab, p->tag);
+  stats->pool_count++;
+  stats->alloc_count += p->alloc_count;
+  stats->alloc_bytes += p->alloc_bytes;
+}
+
+static void tag_stats_add_pools(struct pool_tag_table *tab, pool *p) {
+  for (; p; p = p->sub_next) {
+    tag_stats_add(tab, p);
+
+    if (p->sub_pools != NULL) {
+      tag_stats_add_pools(tab, p->sub_pools);
+    }
+  }
+}
+
 static unsigned int subpools_in_pool(pool *p) {
   unsigned int count = 0;
   pool *iter;
@@ -316,6 +441,8 @@ static unsigned long visit_pools(pool *p, unsigned long level,
     pinfo.block_count = block_count;
     pinfo.subpool_count = subpool_count;
     pinfo.level = level;
+    pinfo.alloc_count = p->alloc_count;
+    pinfo.alloc_byte_count = p->alloc_bytes;
 
     visit(&pinfo, user_data);
 
@@ -349,16 +476,18 @@ static void pool_visitf(const pr_pool_info_t *pinfo, void *user_data) {
 
     /* The emitted message is:
      *
-     *  <pool-tag> [pool-ptr] (n B, m L, r P)
+     *  <pool-tag> [pool-ptr] (n B, m L, r P, a A/b B)
      *
      * where n is the number of bytes (B), m is the number of allocated blocks
-     * in the pool list (L), and r is the number of sub-pools (P).
+     * in the pool list (L), r is the number of sub-pools (P), and a is the
+     * number of allocations (A) made from the pool, for b requested bytes.
      */
 
     if (pinfo->level == 0) {
-      debugf("%s [%p] (%lu B, %lu L, %u P)",
+      debugf("%s [%p] (%lu B, %lu L, %u P, %lu A/%lu B)",
         pinfo->tag ? pinfo->tag : "<unnamed>", pinfo->ptr,
-        pinfo->byte_count, pinfo->block_count, pinfo->subpool_count);
+        pinfo->byte_count, pinfo->block_count, pinfo->subpool_count,
+        pinfo->alloc_count, pinfo->alloc_byte_count);
 
     } else {
       char indent_text[80] = "";
@@ -374,20 +503,29 @@ static void pool_visitf(const pr_pool_info_t *pinfo, void *user_data) {
         }
       }
 
-      debugf("%s + %s [%p] (%lu B, %lu L, %u P)", indent_text,
+      debugf("%s + %s [%p] (%lu B, %lu L, %u P, %lu A/%lu B)", indent_text,
         pinfo->tag ? pinfo->tag : "<unnamed>", pinfo->ptr,
-        pinfo->byte_count, pinfo->block_count, pinfo->subpool_count);
+        pinfo->byte_count, pinfo->block_count, pinfo->subpool_count,
+        pinfo->alloc_count, pinfo->alloc_byte_count);
     }
   }
 
+  if (pinfo->have_tag_info) {
+    debugf("Tag '%s': %lu %s, %lu A/%lu B", pinfo->tag, pinfo->pool_count,
+      pinfo->pool_count != 1 ? "pools" : "pool", pinfo->alloc_count,
+      pinfo->alloc_byte_count);
+  }
+
   if (pinfo->have_freelist_info) {
-    debugf("Free block list: %lu bytes", pinfo->freelist_byte_count);
+    debugf("Free block list: %lu bytes (%lu blocks)",
+      pinfo->freelist_byte_count, pinfo->freelist_block_count);
   }
 
   if (pinfo->have_total_info) {
     debugf("Total %lu bytes allocated", pinfo->total_byte_count);
     debugf("%lu blocks allocated", pinfo->total_blocks_allocated);
     debugf("%lu blocks reused", pinfo->total_blocks_reused);
+    debugf("%lu blocks released", pinfo->total_blocks_released);
   }
 }
 
@@ -402,6 +540,8 @@ void pr_pool_debug_memory(void (*debugf)(const char *, ...)) {
 
 void pr_pool_debug_memory2(void (*visit)(const pr_pool_info_t *, void *),
     void *user_data) {
+  static struct pool_tag_table tag_stats;
+  register unsigned int i;
   unsigned long freelist_byte_count = 0, freelist_block_count = 0,
     total_byte_count = 0;
   pr_pool_info_t pinfo;
@@ -413,10 +553,37 @@ void pr_pool_debug_memory2(void (*visit)(const pr_pool_info_t *, void *),
   /* Per pool */
   total_byte_count = visit_pools(permanent_pool, 0, visit, user_data);
 
-  /* Free list */
-  if (block_freelist) {
-    freelist_byte_count = bytes_in_block_list(block_freelist);
-    freelist_block_count = blocks_in_block_list(block_freelist);
+  /* Per tag: the destroyed pools, plus the current ones. */
+  memcpy(&tag_stats, &pool_tag_stats, sizeof(tag_stats));
+  tag_stats_add_pools(&tag_stats, permanent_pool);
+
+  sstrncpy(tag_stats.other.tag, "<other>", sizeof(tag_stats.other.tag));
+
+  for (i = 0; i <= PR_TUNABLE_POOL_TAG_STATS_MAX; i++) {
+    struct pool_tag_stats *stats;
+
+    stats = i < PR_TUNABLE_POOL_TAG_STATS_MAX ? &(tag_stats.slots[i]) :
+      &(tag_stats.other);
+    if (stats->pool_count == 0) {
+      continue;
+    }
+
+    memset(&pinfo, 0, sizeof(pinfo));
+    pinfo.have_tag_info = TRUE;
+    pinfo.tag = stats->tag;
+    pinfo.pool_count = stats->pool_count;
+    pinfo.alloc_count = stats->alloc_count;
+    pinfo.alloc_byte_count = stats->alloc_bytes;
+
+    visit(&pinfo, user_data);
+  }
+
+  /* Free lists */
+  for (i = 0; i < POOL_FREELIST_COUNT; i++) {
+    if (block_freelists[i] != NULL) {
+      freelist_byte_count += bytes_in_block_list(block_freelists[i]);
+      freelist_block_count += blocks_in_block_list(block_freelists[i]);
+    }
   }
 
   memset(&pinfo, 0, sizeof(pinfo));
@@ -432,6 +599,7 @@ void pr_pool_debug_memory2(void (*visit)(const pr_pool_info_t *, void *),
   pinfo.total_byte_count = total_byte_count;
   pinfo.total_blocks_allocated = stat_malloc;
   pinfo.total_blocks_reused = stat_freehit;
+  pinfo.total_blocks_released = stat_release;
 
   visit(&pinfo, user_data);
 }
@@ -466,15 +634,21 @@ const char *pr_pool_get_tag(pool *p) {
 
 /* Release the entire free block list */
 static void pool_release_free_block_list(void) {
+  register unsigned int i;
   union block_hdr *blok = NULL, *next = NULL;
 
   pr_alarms_block();
 
-  for (blok = block_freelist; blok; blok = next) {
-    next = blok->h.next;
-    free(blok);
+  for (i = 0; i < POOL_FREELIST_COUNT; i++) {
+    for (blok = block_freelists[i]; blok; blok = next) {
+      next = blok->h.next;
+      free(blok);
+    }
+
+    block_freelists[i] = NULL;
   }
-  block_freelist = NULL;
+
+  block_freelist_bytes = 0;
 
   pr_alarms_unblock();
 }
@@ -608,6 +782,8 @@ void destroy_pool(pool *p) {
     }
   }
 
+  tag_stats_add(&pool_tag_stats, p);
+
   clear_pool(p);
   free_blocks(p->first, p->tag);
 
@@ -659,6 +835,9 @@ static void *alloc_pool(struct pool_rec *p, size_t reqsz, int exact) {
     return NULL;
   }
 
+  p->alloc_count++;
+  p->alloc_bytes += reqsz;
+
   new_first_avail = first_avail + sz;
 
   if (new_first_avail <= (char *) blok->h.endp) {
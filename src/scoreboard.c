@@ -27,6 +27,20 @@
 #include "conf.h"
 #include "privs.h"
 
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif /* HAVE_SYS_MMAN_H */
+
+/* Sessions claim their slots by swapping their PID into a free slot, and
+ * then write their slot through a shared mapping of the scoreboard file;
+ * this needs both mmap(2) and the compiler's atomic builtins.  Otherwise,
+ * slots are claimed under the ScoreboardMutex and written using pwrite(2).
+ */
+#if defined(HAVE_SYS_MMAN_H) && \
+    defined(__ATOMIC_ACQUIRE)
+# define SCOREBOARD_USE_MMAP
+#endif
+
 /* From src/dirtree.c */
 extern char ServerType;
 
@@ -45,14 +59,25 @@ static pr_scoreboard_entry_t entry;
 static int have_entry = FALSE;
 static struct flock entry_lock;
 
-static unsigned char scoreboard_read_locked = FALSE;
 static unsigned char scoreboard_write_locked = FALSE;
 
+/* Our slot in the scoreboard, when mapped into memory. */
+static pr_scoreboard_entry_t *entry_slot = NULL;
+static void *entry_slot_map = NULL;
+static size_t entry_slot_maplen = 0;
+
 /* Max number of attempts for lock requests */
 #define SCOREBOARD_MAX_LOCK_ATTEMPTS	10
 
+/* Max number of attempts to read a consistent copy of an entry which is
+ * being updated concurrently.
+ */
+#define SCOREBOARD_MAX_READ_ATTEMPTS	10
+
 static const char *trace_channel = "scoreboard";
 
+static int scoreboard_valid_pid(pid_t pid, pid_t curr_pgrp);
+
 /* Internal routines */
 
 static char *handle_score_str(const char *fmt, va_list cmdap) {
@@ -222,17 +247,6 @@ int pr_lock_scoreboard(int mutex_fd, int lock_type) {
   return 0;
 }
 
-static int rlock_scoreboard(void) {
-  int res;
-
-  res = pr_lock_scoreboard(scoreboard_mutex_fd, F_RDLCK);
-  if (res == 0) {
-    scoreboard_read_locked = TRUE;
-  }
-
-  return res;
-}
-
 static int wlock_scoreboard(void) {
   int res;
 
@@ -249,7 +263,7 @@ static int unlock_scoreboard(void) {
 
   res = pr_lock_scoreboard(scoreboard_mutex_fd, F_UNLCK);
   if (res == 0) {
-    scoreboard_read_locked = scoreboard_write_locked = FALSE;
+    scoreboard_write_locked = FALSE;
   }
 
   return res;
@@ -335,6 +349,15 @@ static int write_entry(int fd) {
     return -1;
   }
 
+  /* Unlike publish_entry(), this does not mark the entry odd while writing
+   * it; the sequence number simply advances along with the rest of the
+   * entry, in a single write.  That write is not atomic with respect to
+   * readers, so a reader may see a partially written entry; it re-checks the
+   * sequence number afterwards (see entry_seq_changed()), which catches
+   * most, but not all, such torn reads.
+   */
+  entry.sce_seq += 2;
+
 #if !defined(HAVE_PWRITE)
   if (lseek(fd, entry_lock.l_start, SEEK_SET) < 0) {
     return -1;
@@ -380,6 +403,278 @@ static int write_entry(int fd) {
   return 0;
 }
 
+static size_t scoreboard_nslots(off_t len) {
+  if (len < (off_t) sizeof(pr_scoreboard_header_t)) {
+    return 0;
+  }
+
+  return (len - sizeof(pr_scoreboard_header_t)) / sizeof(pr_scoreboard_entry_t);
+}
+
+/* Reports whether the entry read from the given offset, with the given
+ * sequence number, may have been changed while it was being read.
+ */
+static int entry_seq_changed(int fd, off_t offset, unsigned long seq) {
+#if defined(HAVE_PREAD)
+  unsigned long curr_seq = 0;
+  ssize_t res;
+
+  if (seq % 2 != 0) {
+    /* The entry was being written when we read it. */
+    return TRUE;
+  }
+
+  res = pread(fd, &curr_seq, sizeof(curr_seq), offset);
+  while (res < 0 &&
+         errno == EINTR) {
+    pr_signals_handle();
+    res = pread(fd, &curr_seq, sizeof(curr_seq), offset);
+  }
+
+  if (res != sizeof(curr_seq)) {
+    return FALSE;
+  }
+
+  return curr_seq != seq ? TRUE : FALSE;
+#else
+  return FALSE;
+#endif /* HAVE_PREAD */
+}
+
+#if defined(SCOREBOARD_USE_MMAP)
+/* Copy the given entry into the slot.  Only the process which owns the slot
+ * (i.e. whose PID the slot holds) may call this.
+ */
+static void publish_entry(pr_scoreboard_entry_t *slot,
+    const pr_scoreboard_entry_t *sce) {
+  unsigned long seq;
+
+  seq = __atomic_load_n(&(slot->sce_seq), __ATOMIC_RELAXED);
+
+  /* An odd sequence number tells readers that the slot is being written. */
+  __atomic_store_n(&(slot->sce_seq), seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  memcpy(((char *) slot) + sizeof(slot->sce_seq),
+    ((const char *) sce) + sizeof(sce->sce_seq),
+    sizeof(pr_scoreboard_entry_t) - sizeof(sce->sce_seq));
+
+  __atomic_store_n(&(slot->sce_seq), seq + 2, __ATOMIC_RELEASE);
+}
+
+static int map_entry_slot(int fd, off_t offset) {
+  long pagesz;
+  off_t map_offset;
+  size_t map_len;
+  void *map;
+
+  pagesz = sysconf(_SC_PAGESIZE);
+  if (pagesz <= 0) {
+    pagesz = 4096;
+  }
+
+  map_offset = offset - (offset % pagesz);
+  map_len = (size_t) (offset - map_offset) + sizeof(pr_scoreboard_entry_t);
+
+  map = mmap(NULL, map_len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, map_offset);
+  if (map == MAP_FAILED) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 3, "error mapping scoreboard slot "
+      "(offset %" PR_LU "): %s", (pr_off_t) offset, strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  entry_slot_map = map;
+  entry_slot_maplen = map_len;
+  entry_slot = (pr_scoreboard_entry_t *) (((char *) map) +
+    (offset - map_offset));
+
+  return 0;
+}
+
+static void unmap_entry_slot(void) {
+  if (entry_slot_map != NULL) {
+    (void) munmap(entry_slot_map, entry_slot_maplen);
+  }
+
+  entry_slot = NULL;
+  entry_slot_map = NULL;
+  entry_slot_maplen = 0;
+}
+
+/* Claim a free slot for the given PID, by swapping the PID into the first
+ * slot found holding zero.  The ScoreboardMutex is only needed when there
+ * are no free slots, in order to append more empty slots to the file.
+ *
+ * Returns 0 once a slot is claimed, with entry_lock.l_start set to the
+ * slot offset; the slot is then mapped, if possible.
+ */
+static int claim_entry_slot(int fd, pid_t pid) {
+  unsigned int nattempts;
+
+  for (nattempts = 1; nattempts <= SCOREBOARD_MAX_LOCK_ATTEMPTS; nattempts++) {
+    register unsigned int i;
+    struct stat st;
+    size_t nslots, map_len;
+    off_t offset = -1;
+
+    pr_signals_handle();
+
+    if (fstat(fd, &st) < 0) {
+      return -1;
+    }
+
+    nslots = scoreboard_nslots(st.st_size);
+    if (nslots > 0) {
+      pr_scoreboard_entry_t *slots;
+      void *map;
+
+      map_len = sizeof(pr_scoreboard_header_t) +
+        (nslots * sizeof(pr_scoreboard_entry_t));
+      map = mmap(NULL, map_len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+      if (map == MAP_FAILED) {
+        return -1;
+      }
+
+      slots = (pr_scoreboard_entry_t *) (((char *) map) +
+        sizeof(pr_scoreboard_header_t));
+
+      for (i = 0; i < nslots; i++) {
+        pid_t slot_pid = 0;
+
+        if (__atomic_load_n(&(slots[i].sce_pid), __ATOMIC_RELAXED) != 0) {
+          continue;
+        }
+
+        if (__atomic_compare_exchange_n(&(slots[i].sce_pid), &slot_pid, pid,
+            FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+          offset = sizeof(pr_scoreboard_header_t) +
+            (i * sizeof(pr_scoreboard_entry_t));
+          break;
+        }
+      }
+
+      (void) munmap(map, map_len);
+
+      if (offset >= 0) {
+        pr_trace_msg(trace_channel, 9, "claimed scoreboard slot %u "
+          "(offset %" PR_LU ") after %u %s", i, (pr_off_t) offset, nattempts,
+          nattempts != 1 ? "attempts" : "attempt");
+        entry_lock.l_start = offset;
+
+        /* If the slot cannot be mapped, we can still write it using
+         * pwrite(2).
+         */
+        (void) map_entry_slot(fd, offset);
+        return 0;
+      }
+    }
+
+    /* No free slots; append some more.  Another process might have done so
+     * already, while we were looking.
+     */
+    if (wlock_scoreboard() < 0) {
+      return -1;
+    }
+
+    if (fstat(fd, &st) == 0 &&
+        scoreboard_nslots(st.st_size) == nslots) {
+      off_t len;
+
+      len = sizeof(pr_scoreboard_header_t) +
+        ((nslots + PR_TUNABLE_SCOREBOARD_GROW_SLOTS) *
+          sizeof(pr_scoreboard_entry_t));
+
+      pr_trace_msg(trace_channel, 9, "growing scoreboard from %lu to %lu "
+        "slots", (unsigned long) nslots,
+        (unsigned long) (nslots + PR_TUNABLE_SCOREBOARD_GROW_SLOTS));
+
+      if (ftruncate(fd, len) < 0) {
+        int xerrno = errno;
+
+        unlock_scoreboard();
+
+        errno = xerrno;
+        return -1;
+      }
+    }
+
+    unlock_scoreboard();
+  }
+
+  errno = EAGAIN;
+  return -1;
+}
+
+/* Scrub the scoreboard in place.  A slot for an invalid PID is reserved by
+ * swapping the PID for -1 (which readers and claimants both skip), then
+ * cleared and released.
+ */
+static int scrub_mapped_slots(int fd, pid_t curr_pgrp) {
+  register unsigned int i;
+  struct stat st;
+  size_t nslots, map_len;
+  pr_scoreboard_entry_t *slots, sce;
+  void *map;
+
+  if (fstat(fd, &st) < 0) {
+    return -1;
+  }
+
+  nslots = scoreboard_nslots(st.st_size);
+  if (nslots == 0) {
+    return 0;
+  }
+
+  map_len = sizeof(pr_scoreboard_header_t) +
+    (nslots * sizeof(pr_scoreboard_entry_t));
+  map = mmap(NULL, map_len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    return -1;
+  }
+
+  slots = (pr_scoreboard_entry_t *) (((char *) map) +
+    sizeof(pr_scoreboard_header_t));
+
+  PRIVS_ROOT
+
+  for (i = 0; i < nslots; i++) {
+    pid_t slot_pid;
+
+    pr_signals_handle();
+
+    slot_pid = __atomic_load_n(&(slots[i].sce_pid), __ATOMIC_ACQUIRE);
+    if (slot_pid <= 0 ||
+        scoreboard_valid_pid(slot_pid, curr_pgrp) == 0) {
+      continue;
+    }
+
+    if (!__atomic_compare_exchange_n(&(slots[i].sce_pid), &slot_pid, -1,
+        FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+      /* The slot changed hands in the meantime. */
+      continue;
+    }
+
+    pr_log_debug(DEBUG9, "scrubbing scoreboard entry for PID %lu",
+      (unsigned long) slot_pid);
+
+    memset(&sce, 0, sizeof(sce));
+    sce.sce_pid = -1;
+    publish_entry(&(slots[i]), &sce);
+
+    __atomic_store_n(&(slots[i].sce_pid), 0, __ATOMIC_RELEASE);
+  }
+
+  PRIVS_RELINQUISH
+
+  (void) munmap(map, map_len);
+  return 0;
+}
+#endif /* SCOREBOARD_USE_MMAP */
+
 /* Public routines */
 
 int pr_close_scoreboard(int keep_mutex) {
@@ -391,8 +686,7 @@ int pr_close_scoreboard(int keep_mutex) {
     return 0;
   }
 
-  if (scoreboard_read_locked ||
-      scoreboard_write_locked) {
+  if (scoreboard_write_locked) {
     unlock_scoreboard();
   }
 
@@ -812,7 +1106,12 @@ int pr_set_scoreboard_mutex(const char *path) {
 
 int pr_scoreboard_entry_add(void) {
   int res;
+#if defined(SCOREBOARD_USE_MMAP)
+  int xerrno;
+  pid_t slot_pid;
+#else
   unsigned char found_slot = FALSE;
+#endif /* SCOREBOARD_USE_MMAP */
 
   if (scoreboard_engine == FALSE) {
     return 0;
@@ -832,6 +1131,44 @@ int pr_scoreboard_entry_add(void) {
 
   pr_trace_msg(trace_channel, 3, "adding new scoreboard entry");
 
+#if defined(SCOREBOARD_USE_MMAP)
+  slot_pid = session.pid ? session.pid : getpid();
+
+  PR_DEVEL_CLOCK(res = claim_entry_slot(scoreboard_fd, slot_pid));
+  if (res == 0) {
+    memset(&entry, '\0', sizeof(entry));
+
+    entry.sce_pid = slot_pid;
+    entry.sce_uid = geteuid();
+    entry.sce_gid = getegid();
+
+    if (entry_slot != NULL) {
+      publish_entry(entry_slot, &entry);
+
+    } else {
+      res = write_entry(scoreboard_fd);
+      if (res < 0) {
+        pr_log_pri(PR_LOG_NOTICE, "error writing scoreboard entry: %s",
+          strerror(errno));
+        return -1;
+      }
+    }
+
+    have_entry = TRUE;
+    return 0;
+  }
+
+  /* Do not fall back to the locked scan here: other processes claim their
+   * slots without taking the scoreboard lock, so the scan could pick a slot
+   * which one of them is claiming at the same time.
+   */
+  xerrno = errno;
+  pr_trace_msg(trace_channel, 3, "unable to claim scoreboard slot: %s",
+    strerror(xerrno));
+
+  errno = xerrno;
+  return -1;
+#else
   /* Write-lock the scoreboard file. */
   PR_DEVEL_CLOCK(res = wlock_scoreboard());
   if (res < 0) {
@@ -889,6 +1226,7 @@ int pr_scoreboard_entry_add(void) {
   unlock_scoreboard();
 
   return res;
+#endif /* SCOREBOARD_USE_MMAP */
 }
 
 int pr_scoreboard_entry_del(unsigned char verbose) {
@@ -908,6 +1246,28 @@ int pr_scoreboard_entry_del(unsigned char verbose) {
 
   pr_trace_msg(trace_channel, 3, "deleting scoreboard entry");
 
+#if defined(SCOREBOARD_USE_MMAP)
+  if (entry_slot != NULL) {
+    /* Clear the entry first, and only then release the slot by zeroing its
+     * PID, so that a new session cannot claim the slot while we are still
+     * writing to it.
+     */
+    pid_t slot_pid;
+
+    slot_pid = entry.sce_pid;
+    memset(&entry, '\0', sizeof(entry));
+    entry.sce_pid = slot_pid;
+    publish_entry(entry_slot, &entry);
+
+    __atomic_store_n(&(entry_slot->sce_pid), 0, __ATOMIC_RELEASE);
+    entry.sce_pid = 0;
+
+    unmap_entry_slot();
+    have_entry = FALSE;
+    return 0;
+  }
+#endif /* SCOREBOARD_USE_MMAP */
+
   memset(&entry, '\0', sizeof(entry));
 
   /* Write-lock this entry */
@@ -950,6 +1310,7 @@ time_t pr_scoreboard_get_daemon_uptime(void) {
 pr_scoreboard_entry_t *pr_scoreboard_entry_read(void) {
   static pr_scoreboard_entry_t scan_entry;
   int res = 0;
+  unsigned int nattempts = 1;
 
   if (scoreboard_engine == FALSE) {
     return NULL;
@@ -960,22 +1321,20 @@ pr_scoreboard_entry_t *pr_scoreboard_entry_read(void) {
     return NULL;
   }
 
-  /* Make sure the scoreboard file is read-locked. */
-  if (!scoreboard_read_locked) {
-
-    /* Do not proceed if we cannot lock the scoreboard. */
-    res = rlock_scoreboard();
-    if (res < 0) {
-      return NULL; 
-    }
-  }
+  /* Entries are read without locking; the slot owners never block on
+   * readers.  Instead, the entry's sequence number is checked after reading
+   * it, and the read is retried if the entry was changed in the meantime.
+   */
 
   pr_trace_msg(trace_channel, 5, "reading scoreboard entry");
 
   memset(&scan_entry, '\0', sizeof(scan_entry));
 
-  /* NOTE: use readv(2), pread(2)? */
   while (TRUE) {
+    off_t offset;
+
+    offset = lseek(scoreboard_fd, (off_t) 0, SEEK_CUR);
+
     while ((res = read(scoreboard_fd, &scan_entry, sizeof(scan_entry))) <= 0) {
       int xerrno = errno;
 
@@ -985,15 +1344,30 @@ pr_scoreboard_entry_t *pr_scoreboard_entry_read(void) {
         continue;
       }
 
-      unlock_scoreboard();
       errno = xerrno;
       return NULL;
     }
 
-    if (scan_entry.sce_pid) {
-      unlock_scoreboard();
-      return &scan_entry;
+    /* Skip free slots, and slots being scrubbed. */
+    if (scan_entry.sce_pid <= 0) {
+      nattempts = 1;
+      continue;
+    }
+
+    if (offset >= 0 &&
+        nattempts < SCOREBOARD_MAX_READ_ATTEMPTS &&
+        entry_seq_changed(scoreboard_fd, offset, scan_entry.sce_seq) == TRUE) {
+      pr_trace_msg(trace_channel, 15, "scoreboard entry (offset %" PR_LU ") "
+        "changed while being read, rereading (attempt #%u)",
+        (pr_off_t) offset, nattempts);
+
+      if (lseek(scoreboard_fd, offset, SEEK_SET) == offset) {
+        nattempts++;
+        continue;
+      }
     }
+
+    return &scan_entry;
   }
 
   /* Technically we never reach this. */
@@ -1339,6 +1713,54 @@ int pr_scoreboard_entry_update(pid_t pid, ...) {
           "'%s'", entry.sce_protocol);
         break;
 
+      case PR_SCORE_BYTES_IN:
+        entry.sce_bytes_in = va_arg(ap, off_t);
+        pr_trace_msg(trace_channel, 15, "updated scoreboard entry bytes in "
+          "to %" PR_LU " bytes", (pr_off_t) entry.sce_bytes_in);
+        break;
+
+      case PR_SCORE_BYTES_OUT:
+        entry.sce_bytes_out = va_arg(ap, off_t);
+        pr_trace_msg(trace_channel, 15, "updated scoreboard entry bytes out "
+          "to %" PR_LU " bytes", (pr_off_t) entry.sce_bytes_out);
+        break;
+
+      case PR_SCORE_CMD_COUNT:
+        entry.sce_cmd_count = va_arg(ap, unsigned long);
+        pr_trace_msg(trace_channel, 15, "updated scoreboard entry command "
+          "count to %lu", entry.sce_cmd_count);
+        break;
+
+      case PR_SCORE_CMD_MS:
+        entry.sce_cmd_ms = va_arg(ap, unsigned long);
+        pr_trace_msg(trace_channel, 15, "updated scoreboard entry command "
+          "time to %lu ms", entry.sce_cmd_ms);
+        break;
+
+      case PR_SCORE_HANDSHAKE_MS:
+        entry.sce_handshake_ms = va_arg(ap, unsigned long);
+        pr_trace_msg(trace_channel, 15, "updated scoreboard entry handshake "
+          "time to %lu ms", entry.sce_handshake_ms);
+        break;
+
+      case PR_SCORE_XFER_DISK_MS:
+        entry.sce_xfer_disk_ms = va_arg(ap, unsigned long);
+        pr_trace_msg(trace_channel, 15, "updated scoreboard entry transfer "
+          "disk time to %lu ms", entry.sce_xfer_disk_ms);
+        break;
+
+      case PR_SCORE_XFER_NET_MS:
+        entry.sce_xfer_net_ms = va_arg(ap, unsigned long);
+        pr_trace_msg(trace_channel, 15, "updated scoreboard entry transfer "
+          "network time to %lu ms", entry.sce_xfer_net_ms);
+        break;
+
+      case PR_SCORE_XFER_THROTTLE_MS:
+        entry.sce_xfer_throttle_ms = va_arg(ap, unsigned long);
+        pr_trace_msg(trace_channel, 15, "updated scoreboard entry transfer "
+          "throttle time to %lu ms", entry.sce_xfer_throttle_ms);
+        break;
+
       default:
         va_end(ap);
         errno = ENOENT;
@@ -1348,6 +1770,15 @@ int pr_scoreboard_entry_update(pid_t pid, ...) {
 
   va_end(ap);
 
+#if defined(SCOREBOARD_USE_MMAP)
+  if (entry_slot != NULL) {
+    publish_entry(entry_slot, &entry);
+
+    pr_trace_msg(trace_channel, 3, "finished updating scoreboard entry");
+    return 0;
+  }
+#endif /* SCOREBOARD_USE_MMAP */
+
   /* Write-lock this entry */
   wlock_entry(scoreboard_fd);
   if (write_entry(scoreboard_fd) < 0) {
@@ -1421,6 +1852,22 @@ int pr_scoreboard_scrub(void) {
     return -1;
   }
 
+#ifdef HAVE_GETPGRP
+  curr_pgrp = getpgrp();
+#elif HAVE_GETPGID
+  curr_pgrp = getpgid(0);
+#endif /* !HAVE_GETPGRP and !HAVE_GETPGID */
+
+#if defined(SCOREBOARD_USE_MMAP)
+  if (scrub_mapped_slots(fd, curr_pgrp) == 0) {
+    (void) close(fd);
+
+    pr_log_debug(DEBUG9, "finished scrubbing scoreboard");
+    pr_trace_msg(trace_channel, 9, "%s", "finished scrubbing scoreboard");
+    return 0;
+  }
+#endif /* SCOREBOARD_USE_MMAP */
+
   /* Write-lock the scoreboard file. */
   PR_DEVEL_CLOCK(res = wlock_scoreboard());
   if (res < 0) {
@@ -1431,12 +1878,6 @@ int pr_scoreboard_scrub(void) {
     errno = xerrno;
     return -1;
   }
-
-#ifdef HAVE_GETPGRP
-  curr_pgrp = getpgrp();
-#elif HAVE_GETPGID
-  curr_pgrp = getpgid(0);
-#endif /* !HAVE_GETPGRP and !HAVE_GETPGID */
  
   /* Skip past the scoreboard header. */
   curr_offset = lseek(fd, (off_t) sizeof(pr_scoreboard_header_t), SEEK_SET);
@@ -1491,7 +1932,7 @@ int pr_scoreboard_scrub(void) {
       /* Check to see if the PID in this entry is valid.  If not, erase
        * the slot.
        */
-      if (sce.sce_pid &&
+      if (sce.sce_pid > 0 &&
           scoreboard_valid_pid(sce.sce_pid, curr_pgrp) < 0) {
         pid_t slot_pid;
 
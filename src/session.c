@@ -82,6 +82,11 @@ static void sess_cleanup(int flags) {
     session.c = NULL;
   }
 
+  /* Write out any buffered log lines, and stop buffering; the exit handlers
+   * may log, and then close their log fds.
+   */
+  (void) pr_log_set_options(pr_log_get_options() & ~PR_LOG_OPT_USE_BUFFERING);
+
   /* Run all the exit handlers */
   pr_event_generate("core.exit", NULL);
 
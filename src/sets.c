@@ -27,6 +27,8 @@
 
 #include "conf.h"
 
+static unsigned long xaset_gen = 0;
+
 /* Create a new set, cmpfunc is a pointer to the function used to to compare
  * members of the set ... it should return 1, 0, or -1 after the fashion of
  * strcmp.  Returns NULL if memory allocation fails.
@@ -51,6 +53,8 @@ xaset_t *xaset_create(pool *p, XASET_COMPARE cmpfunc) {
   new_set->xas_list = NULL;
   new_set->pool = p;
   new_set->xas_compare = cmpfunc;
+  new_set->xas_gen = ++xaset_gen;
+  memset(new_set->xas_indexes, 0, sizeof(new_set->xas_indexes));
 
   return new_set;
 }
@@ -73,6 +77,7 @@ int xaset_insert(xaset_t *set, xasetmember_t *member) {
   }
 
   set->xas_list = member;
+  set->xas_gen = ++xaset_gen;
   return 0;
 }
 
@@ -98,6 +103,7 @@ int xaset_insert_end(xaset_t *set, xasetmember_t *member) {
     prev->next = member;
   }
 
+  set->xas_gen = ++xaset_gen;
   return 0;
 }
 
@@ -141,6 +147,7 @@ int xaset_insert_sort(xaset_t *set, xasetmember_t *member, int dups_allowed) {
   member->next = *setp;
   *setp = member;
 
+  set->xas_gen = ++xaset_gen;
   return 0;
 }
 
@@ -181,6 +188,7 @@ int xaset_remove(xaset_t *set, xasetmember_t *member) {
   }
 
   member->next = member->prev = NULL;
+  set->xas_gen = ++xaset_gen;
   return 0;
 }
 
@@ -236,5 +244,7 @@ xaset_t *xaset_copy(pool *p, xaset_t *set, size_t msize, XASET_MCOPY copyfunc) {
     *pos = n;
   }
 
+  new_set->xas_gen = ++xaset_gen;
+  memset(new_set->xas_indexes, 0, sizeof(new_set->xas_indexes));
   return new_set;
 }
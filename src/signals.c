@@ -217,6 +217,11 @@ static void handle_stacktrace_signal(int signo, siginfo_t *info, void *ptr) {
 #endif /* HAVE_BACKTRACE */
   pr_log_pri(PR_LOG_ERR, "-----END STACK TRACE-----");
 
+  /* Make sure the stacktrace is written out, should we not make it as far
+   * as the session cleanup.
+   */
+  (void) pr_log_flush(-1);
+
   sig_terminate(signo);
   finish_terminate(signo);
 }
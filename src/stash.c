@@ -64,8 +64,35 @@ static struct stash *auth_curr_sym = NULL;
 static xaset_t *hook_symbol_table[PR_TUNABLE_HASH_TABLE_SIZE];
 static struct stash *hook_curr_sym = NULL;
 
+/* Per-command dispatch lists: for each command, the CMD symbols of each
+ * phase, in the order in which they are found in the stash.  Commands with
+ * a known ID are indexed by that ID; others (e.g. C_ANY, or the SFTP
+ * requests) by name.  The lists are built on first use, and discarded
+ * whenever a CMD symbol is added or removed.
+ */
+#define STASH_CMD_MAX_PHASE		LOG_CMD_ERR
+
+struct stash_cmd_handlers {
+  cmdtable **handlers[STASH_CMD_MAX_PHASE + 1];
+  unsigned int nhandlers[STASH_CMD_MAX_PHASE + 1];
+};
+
+static pool *cmd_handlers_pool = NULL;
+static struct stash_cmd_handlers *cmd_handlers_by_id[PR_CMD_CSID_ID + 1];
+static pr_table_t *cmd_handlers_by_name = NULL;
+
 /* Symbol stash lookup code and management */
 
+static void clear_cmd_handlers(void) {
+  if (cmd_handlers_pool != NULL) {
+    destroy_pool(cmd_handlers_pool);
+    cmd_handlers_pool = NULL;
+  }
+
+  memset(cmd_handlers_by_id, 0, sizeof(cmd_handlers_by_id));
+  cmd_handlers_by_name = NULL;
+}
+
 static struct stash *sym_alloc(void) {
   pool *sub_pool;
   struct stash *sym;
@@ -299,6 +326,11 @@ int pr_stash_add_symbol(pr_stash_type_t sym_type, void *data) {
   }
 
   xaset_insert_sort(symbol_table[idx], (xasetmember_t *) sym, TRUE);
+
+  if (sym_type == PR_SYM_CMD) {
+    clear_cmd_handlers();
+  }
+
   return 0;
 }
 
@@ -704,9 +736,118 @@ int pr_stash_remove_cmd(const char *cmd_name, module *m,
     tab = pr_stash_get_symbol2(PR_SYM_CMD, cmd_name, tab, &prev_idx, &hash);
   }
 
+  if (count > 0) {
+    clear_cmd_handlers();
+  }
+
   return count;
 }
 
+static struct stash_cmd_handlers *get_cmd_handlers(const char *cmd_name) {
+  register unsigned int i;
+  struct stash_cmd_handlers *ch;
+  unsigned int counts[STASH_CMD_MAX_PHASE + 1], total = 0;
+  cmdtable *tab;
+  int idx = -1;
+  unsigned int hash = 0;
+
+  memset(counts, 0, sizeof(counts));
+
+  tab = pr_stash_get_symbol2(PR_SYM_CMD, cmd_name, NULL, &idx, &hash);
+  while (tab != NULL) {
+    pr_signals_handle();
+
+    if (tab->cmd_type > 0 &&
+        tab->cmd_type <= STASH_CMD_MAX_PHASE) {
+      counts[tab->cmd_type]++;
+      total++;
+    }
+
+    tab = pr_stash_get_symbol2(PR_SYM_CMD, cmd_name, tab, &idx, &hash);
+  }
+
+  /* Nothing handles this command; don't let arbitrary client-provided
+   * names take up space.
+   */
+  if (total == 0) {
+    return NULL;
+  }
+
+  ch = pcalloc(cmd_handlers_pool, sizeof(struct stash_cmd_handlers));
+  for (i = 1; i <= STASH_CMD_MAX_PHASE; i++) {
+    if (counts[i] > 0) {
+      ch->handlers[i] = pcalloc(cmd_handlers_pool,
+        counts[i] * sizeof(cmdtable *));
+    }
+  }
+
+  idx = -1;
+  hash = 0;
+
+  tab = pr_stash_get_symbol2(PR_SYM_CMD, cmd_name, NULL, &idx, &hash);
+  while (tab != NULL) {
+    if (tab->cmd_type > 0 &&
+        tab->cmd_type <= STASH_CMD_MAX_PHASE) {
+      ch->handlers[tab->cmd_type][ch->nhandlers[tab->cmd_type]++] = tab;
+    }
+
+    tab = pr_stash_get_symbol2(PR_SYM_CMD, cmd_name, tab, &idx, &hash);
+  }
+
+  return ch;
+}
+
+int pr_stash_get_cmd_handlers(const char *cmd_name, int cmd_id,
+    unsigned char cmd_type, cmdtable ***handlers, unsigned int *nhandlers) {
+  struct stash_cmd_handlers *ch = NULL;
+
+  if (cmd_name == NULL ||
+      cmd_type == 0 ||
+      cmd_type > STASH_CMD_MAX_PHASE ||
+      handlers == NULL ||
+      nhandlers == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (cmd_handlers_pool == NULL) {
+    cmd_handlers_pool = make_sub_pool(symbol_pool);
+    pr_pool_tag(cmd_handlers_pool, "Stash CMD Handlers Pool");
+
+    cmd_handlers_by_name = pr_table_alloc(cmd_handlers_pool, 0);
+  }
+
+  if (cmd_id > 0 &&
+      cmd_id <= PR_CMD_CSID_ID) {
+    ch = cmd_handlers_by_id[cmd_id];
+    if (ch == NULL) {
+      ch = get_cmd_handlers(cmd_name);
+      cmd_handlers_by_id[cmd_id] = ch;
+    }
+
+  } else {
+    ch = (struct stash_cmd_handlers *) pr_table_get(cmd_handlers_by_name,
+      cmd_name, NULL);
+    if (ch == NULL) {
+      ch = get_cmd_handlers(cmd_name);
+      if (ch != NULL) {
+        (void) pr_table_add(cmd_handlers_by_name,
+          pstrdup(cmd_handlers_pool, cmd_name), ch, sizeof(ch));
+      }
+    }
+  }
+
+  if (ch == NULL) {
+    *handlers = NULL;
+    *nhandlers = 0;
+    return 0;
+  }
+
+  *handlers = ch->handlers[cmd_type];
+  *nhandlers = ch->nhandlers[cmd_type];
+  return 0;
+}
+
 int pr_stash_remove_auth(const char *api_name, module *m) {
   int count = 0, prev_idx, symtab_idx = 0;
   size_t api_namelen = 0;
@@ -902,6 +1043,8 @@ void pr_stash_dump(void (*dumpf)(const char *, ...)) {
 }
 
 int init_stash(void) {
+  clear_cmd_handlers();
+
   if (symbol_pool != NULL) {
     destroy_pool(symbol_pool);
   }
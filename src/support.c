@@ -1217,6 +1217,22 @@ int pr_gettimeofday_millis(uint64_t *millis) {
   return 0;
 }
 
+int pr_gettimeofday_micros(uint64_t *micros) {
+  struct timeval tv;
+
+  if (micros == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (gettimeofday(&tv, NULL) < 0) {
+    return -1;
+  }
+
+  *micros = (tv.tv_sec * (uint64_t) 1000000) + tv.tv_usec;
+  return 0;
+}
+
 int pr_vsnprintfl(const char *file, int lineno, char *buf, size_t bufsz,
     const char *fmt, va_list msg) {
   int res, xerrno = 0;
@@ -34,6 +34,25 @@
 #define PR_TABLE_DEFAULT_MAX_ENTS	8192
 #define PR_TABLE_ENT_POOL_SIZE		64
 
+/* For the open addressing backend: the minimum number of slots, the
+ * maximum load (as a percentage of used slots) before the slot array is
+ * doubled, and the number of entries/keys allocated at a time.
+ */
+#define PR_TABLE_MIN_NSLOTS		16
+#define PR_TABLE_MAX_LOAD_PCT		75
+#define PR_TABLE_ARENA_NENTS		32
+
+/* A slot in the open addressing backend.  Each used slot holds a unique
+ * key, as the list of entries (values) stored under that key.  The probe
+ * distance is one plus the distance of the slot from the key's "home"
+ * slot; zero indicates an unused slot.
+ */
+struct table_slot {
+  unsigned int hash;
+  unsigned int dist;
+  pr_table_entry_t *head;
+};
+
 struct table_rec {
   pool *pool;
   unsigned long flags;
@@ -68,6 +87,17 @@ struct table_rec {
   unsigned int nchains;
   unsigned int nents;
 
+  /* Which backend stores the entries: separate chaining (the default),
+   * or open addressing using Robin Hood hashing.  For the latter, the slot
+   * array is allocated from its own subpool, so that it can be released
+   * when the table is resized.
+   */
+  int backend;
+  pool *slot_pool;
+  struct table_slot *slots;
+  unsigned int nslots;
+  unsigned int nkeys;
+
   /* List of free structures. */
   pr_table_entry_t *free_ents;
   pr_table_key_t *free_keys;
@@ -207,6 +237,22 @@ static pr_table_key_t *tab_key_alloc(pr_table_t *tab) {
     return k;
   }
 
+  if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+    register unsigned int i;
+    pr_table_key_t *keys;
+
+    /* Allocate a batch of keys at once, keeping them close together in
+     * memory, and hand out the first one.
+     */
+    keys = pcalloc(tab->pool, sizeof(pr_table_key_t) * PR_TABLE_ARENA_NENTS);
+    for (i = 1; i < PR_TABLE_ARENA_NENTS - 1; i++) {
+      keys[i].next = &(keys[i+1]);
+    }
+    tab->free_keys = &(keys[1]);
+
+    return &(keys[0]);
+  }
+
   /* ...otherwise, allocate a new key. */
   k = pcalloc(tab->pool, sizeof(pr_table_key_t));
 
@@ -217,6 +263,13 @@ static void tab_key_free(pr_table_t *tab, pr_table_key_t *k) {
   /* Clear everything from the given key. */
   memset(k, 0, sizeof(pr_table_key_t));
 
+  if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+    /* Order does not matter here, so avoid scanning the list. */
+    k->next = tab->free_keys;
+    tab->free_keys = k;
+    return;
+  }
+
   /* Add this key to the table's free list. */
   if (tab->free_keys) {
     pr_table_key_t *i = tab->free_keys;
@@ -252,6 +305,20 @@ static pr_table_entry_t *tab_entry_alloc(pr_table_t *tab) {
     return e;
   }
 
+  if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+    register unsigned int i;
+    pr_table_entry_t *ents;
+
+    ents = pcalloc(tab->pool,
+      sizeof(pr_table_entry_t) * PR_TABLE_ARENA_NENTS);
+    for (i = 1; i < PR_TABLE_ARENA_NENTS - 1; i++) {
+      ents[i].next = &(ents[i+1]);
+    }
+    tab->free_ents = &(ents[1]);
+
+    return &(ents[0]);
+  }
+
   /* ...otherwise, allocate a new entry. */
   e = pcalloc(tab->pool, sizeof(pr_table_entry_t));
 
@@ -262,6 +329,12 @@ static void tab_entry_free(pr_table_t *tab, pr_table_entry_t *e) {
   /* Clear everything from the given entry. */
   memset(e, 0, sizeof(pr_table_entry_t));
 
+  if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+    e->next = tab->free_ents;
+    tab->free_ents = e;
+    return;
+  }
+
   /* Add this entry to the table's free list. */
   if (tab->free_ents) {
     pr_table_entry_t *i = tab->free_ents;
@@ -282,8 +355,217 @@ static void tab_entry_free(pr_table_t *tab, pr_table_entry_t *e) {
   }
 }
 
+/* Open addressing slot management
+ */
+
+/* The key hashes are not well distributed in their low bits, which are
+ * all that is used for picking a slot; mix in the high bits first.
+ */
+static unsigned int slot_home(pr_table_t *tab, unsigned int h) {
+  h ^= (h >> 16);
+  h *= 0x45d9f3b;
+  h ^= (h >> 16);
+
+  return h & (tab->nslots - 1);
+}
+
+static void slot_set(pr_table_t *tab, unsigned int idx, unsigned int h,
+    unsigned int dist, pr_table_entry_t *head) {
+  pr_table_entry_t *ent;
+
+  tab->slots[idx].hash = h;
+  tab->slots[idx].dist = dist;
+  tab->slots[idx].head = head;
+
+  /* The entries stored under the key need to know their slot. */
+  for (ent = head; ent != NULL; ent = ent->next) {
+    ent->idx = idx;
+  }
+}
+
+/* Returns the slot index holding the given key, or -1 if not present. */
+static int slot_lookup(pr_table_t *tab, unsigned int h, const void *key_data,
+    size_t key_datasz) {
+  unsigned int idx, dist;
+
+  idx = slot_home(tab, h);
+
+  for (dist = 1; ; dist++) {
+    struct table_slot *slot;
+
+    slot = &(tab->slots[idx]);
+
+    /* With Robin Hood hashing, once we find a slot whose key is closer to
+     * its home than we are to ours, we know our key is not present.
+     */
+    if (slot->dist < dist) {
+      return -1;
+    }
+
+    if (slot->hash == h &&
+        tab->keycmp(slot->head->key->key_data, slot->head->key->key_datasz,
+          key_data, key_datasz) == 0) {
+      return (int) idx;
+    }
+
+    idx = (idx + 1) & (tab->nslots - 1);
+  }
+
+  /* Not reached. */
+  return -1;
+}
+
+/* Stores a new key, whose entries start at head, into the slot array.
+ * Keys which are further from their home slot displace keys which are
+ * closer to theirs, keeping the probe sequences short.
+ */
+static void slot_insert(pr_table_t *tab, unsigned int h,
+    pr_table_entry_t *head) {
+  unsigned int idx, dist;
+
+  idx = slot_home(tab, h);
+  dist = 1;
+
+  while (tab->slots[idx].dist != 0) {
+    struct table_slot *slot;
+
+    slot = &(tab->slots[idx]);
+    if (slot->dist < dist) {
+      struct table_slot displaced;
+
+      displaced = *slot;
+      slot_set(tab, idx, h, dist, head);
+
+      h = displaced.hash;
+      dist = displaced.dist;
+      head = displaced.head;
+    }
+
+    idx = (idx + 1) & (tab->nslots - 1);
+    dist++;
+  }
+
+  slot_set(tab, idx, h, dist, head);
+}
+
+/* Clears the given slot, shifting any following keys which are not in
+ * their home slots back by one.
+ */
+static void slot_delete(pr_table_t *tab, unsigned int idx) {
+  while (TRUE) {
+    unsigned int next_idx;
+    struct table_slot *next_slot;
+
+    next_idx = (idx + 1) & (tab->nslots - 1);
+    next_slot = &(tab->slots[next_idx]);
+
+    if (next_slot->dist <= 1) {
+      break;
+    }
+
+    slot_set(tab, idx, next_slot->hash, next_slot->dist - 1, next_slot->head);
+    idx = next_idx;
+  }
+
+  memset(&(tab->slots[idx]), 0, sizeof(struct table_slot));
+}
+
+static int slot_alloc(pr_table_t *tab, unsigned int nslots) {
+  register unsigned int i;
+  pool *slot_pool, *old_slot_pool;
+  struct table_slot *slots, *old_slots;
+  unsigned int old_nslots;
+
+  /* Use a power of two, so that slot indices can be masked, not divided. */
+  if (nslots < PR_TABLE_MIN_NSLOTS) {
+    nslots = PR_TABLE_MIN_NSLOTS;
+  }
+
+  nslots--;
+  nslots |= (nslots >> 1);
+  nslots |= (nslots >> 2);
+  nslots |= (nslots >> 4);
+  nslots |= (nslots >> 8);
+  nslots |= (nslots >> 16);
+  nslots++;
+
+  if (nslots == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  slot_pool = make_sub_pool(tab->pool);
+  pr_pool_tag(slot_pool, "table slot pool");
+  slots = pcalloc(slot_pool, sizeof(struct table_slot) * nslots);
+
+  old_slot_pool = tab->slot_pool;
+  old_slots = tab->slots;
+  old_nslots = tab->nslots;
+
+  tab->slot_pool = slot_pool;
+  tab->slots = slots;
+  tab->nslots = nslots;
+
+  /* Rehash any existing keys into the new slots. */
+  for (i = 0; i < old_nslots; i++) {
+    if (old_slots[i].dist != 0) {
+      slot_insert(tab, old_slots[i].hash, old_slots[i].head);
+    }
+  }
+
+  if (old_slot_pool != NULL) {
+    destroy_pool(old_slot_pool);
+  }
+
+  if (old_nslots > 0) {
+    pr_trace_msg(trace_channel, 17,
+      "resized table %p from %u to %u slots (%u keys)", tab, old_nslots,
+      nslots, tab->nkeys);
+  }
+
+  return 0;
+}
+
+/* Returns the number of chains/slots in which entries are stored. */
+static unsigned int tab_nbuckets(pr_table_t *tab) {
+  if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+    return tab->nslots;
+  }
+
+  return tab->nchains;
+}
+
+/* Returns the first entry in the given chain/slot. */
+static pr_table_entry_t *tab_bucket(pr_table_t *tab, unsigned int idx) {
+  if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+    return tab->slots[idx].head;
+  }
+
+  return tab->chains[idx];
+}
+
+/* Returns the first entry of the chain/slot where the given key would be
+ * stored.  Note that for chaining, the chain may hold entries for other keys.
+ */
+static pr_table_entry_t *tab_find_head(pr_table_t *tab, unsigned int h,
+    const void *key_data, size_t key_datasz) {
+
+  if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+    int idx;
+
+    idx = slot_lookup(tab, h, key_data, key_datasz);
+    if (idx < 0) {
+      return NULL;
+    }
+
+    return tab->slots[idx].head;
+  }
+
+  return tab->chains[h % tab->nchains];
+}
+
 static void tab_entry_insert(pr_table_t *tab, pr_table_entry_t *e) {
-  pr_table_entry_t *h = tab->chains[e->idx];
+  pr_table_entry_t *h = tab_bucket(tab, e->idx);
 
   if (h &&
       h != e) {
@@ -293,7 +575,13 @@ static void tab_entry_insert(pr_table_t *tab, pr_table_entry_t *e) {
      * is the head of a new chain.
      */
     tab->entinsert(&h, e);
-    tab->chains[e->idx] = h;
+
+    if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+      tab->slots[e->idx].head = h;
+
+    } else {
+      tab->chains[e->idx] = h;
+    }
   }
 
   e->key->nents++;
@@ -315,9 +603,9 @@ static pr_table_entry_t *tab_entry_next(pr_table_t *tab) {
       ent = NULL;
 
       /* Skip to the next populated chain. */
-      for (i = tab->tab_iter_ent->idx + 1; i < tab->nchains; i++) {
-        if (tab->chains[i]) {
-          ent = tab->chains[i];
+      for (i = tab->tab_iter_ent->idx + 1; i < tab_nbuckets(tab); i++) {
+        if (tab_bucket(tab, i)) {
+          ent = tab_bucket(tab, i);
           break;
         }
       }
@@ -327,9 +615,9 @@ static pr_table_entry_t *tab_entry_next(pr_table_t *tab) {
     register unsigned int i;
 
     /* Find the first non-empty chain. */
-    for (i = 0; i < tab->nchains; i++) {
-      if (tab->chains[i]) {
-        ent = tab->chains[i];
+    for (i = 0; i < tab_nbuckets(tab); i++) {
+      if (tab_bucket(tab, i)) {
+        ent = tab_bucket(tab, i);
         break;
       }
     }
@@ -342,9 +630,22 @@ static pr_table_entry_t *tab_entry_next(pr_table_t *tab) {
 static void tab_entry_remove(pr_table_t *tab, pr_table_entry_t *e) {
   pr_table_entry_t *h = NULL;
 
-  h = tab->chains[e->idx];
+  h = tab_bucket(tab, e->idx);
   tab->entremove(&h, e);
-  tab->chains[e->idx] = h;
+
+  if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+    if (h != NULL) {
+      tab->slots[e->idx].head = h;
+
+    } else {
+      /* That was the last entry for this key; free up its slot. */
+      slot_delete(tab, e->idx);
+      tab->nkeys--;
+    }
+
+  } else {
+    tab->chains[e->idx] = h;
+  }
 
   e->key->nents--;
   if (e->key->nents == 0) {
@@ -388,6 +689,63 @@ static unsigned int tab_get_seed(void) {
   return seed;
 }
 
+static pr_table_key_t *tab_key_new(pr_table_t *tab, unsigned int h,
+    const void *key_data, size_t key_datasz) {
+  pr_table_key_t *k;
+
+  k = tab_key_alloc(tab);
+
+  k->key_data = (void *) key_data;
+  k->key_datasz = key_datasz;
+  k->hash = h;
+  k->nents = 0;
+
+  return k;
+}
+
+static int tab_oa_add(pr_table_t *tab, unsigned int h, const void *key_data,
+    size_t key_datasz, const void *value_data, size_t value_datasz) {
+  int idx;
+  pr_table_entry_t *n;
+
+  idx = slot_lookup(tab, h, key_data, key_datasz);
+  if (idx >= 0 &&
+      !(tab->flags & PR_TABLE_FL_MULTI_VALUE)) {
+    errno = EEXIST;
+    return -1;
+  }
+
+  n = tab_entry_alloc(tab);
+  n->value_data = value_data;
+  n->value_datasz = value_datasz;
+
+  if (idx >= 0) {
+    /* Another value for an existing key. */
+    n->key = tab->slots[idx].head->key;
+    n->idx = idx;
+
+  } else {
+    /* Make room for the new key first, if need be. */
+    if (((tab->nkeys + 1) * 100) > (tab->nslots * PR_TABLE_MAX_LOAD_PCT)) {
+      if (slot_alloc(tab, tab->nslots * 2) < 0) {
+        int xerrno = errno;
+
+        tab_entry_free(tab, n);
+
+        errno = xerrno;
+        return -1;
+      }
+    }
+
+    n->key = tab_key_new(tab, h, key_data, key_datasz);
+    slot_insert(tab, h, n);
+    tab->nkeys++;
+  }
+
+  tab_entry_insert(tab, n);
+  return 0;
+}
+
 /* Public Table API
  */
 
@@ -412,6 +770,10 @@ int pr_table_kadd(pr_table_t *tab, const void *key_data, size_t key_datasz,
   /* Don't forget to add in the random seed data. */
   h = tab->keyhash(key_data, key_datasz) + tab->seed;
 
+  if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+    return tab_oa_add(tab, h, key_data, key_datasz, value_data, value_datasz);
+  }
+
   /* The index of the chain to use is the hash value modulo the number
    * of chains.
    */
@@ -462,17 +824,8 @@ int pr_table_kadd(pr_table_t *tab, const void *key_data, size_t key_datasz,
   }
 
   if (!n->key) {
-    pr_table_key_t *k;
-
     /* Allocate a new key. */
-    k = tab_key_alloc(tab);
-
-    k->key_data = (void *) key_data;
-    k->key_datasz = key_datasz;
-    k->hash = h;
-    k->nents = 0;
-
-    n->key = k;
+    n->key = tab_key_new(tab, h, key_data, key_datasz);
   }
 
   tab_entry_insert(tab, n);
@@ -480,7 +833,7 @@ int pr_table_kadd(pr_table_t *tab, const void *key_data, size_t key_datasz,
 }
 
 int pr_table_kexists(pr_table_t *tab, const void *key_data, size_t key_datasz) {
-  unsigned int h, idx;
+  unsigned int h;
   pr_table_entry_t *head, *ent;
 
   if (tab == NULL ||
@@ -508,8 +861,7 @@ int pr_table_kexists(pr_table_t *tab, const void *key_data, size_t key_datasz) {
   /* Don't forget to add in the random seed data. */
   h = tab->keyhash(key_data, key_datasz) + tab->seed;
 
-  idx = h % tab->nchains;
-  head = tab->chains[idx];
+  head = tab_find_head(tab, h, key_data, key_datasz);
   if (head == NULL) {
     tab->cache_ent = NULL;
     return 0;
@@ -585,8 +937,7 @@ const void *pr_table_kget(pr_table_t *tab, const void *key_data,
      head = tab->cache_ent->next;
 
   } else {
-    unsigned int idx = h % tab->nchains;
-    head = tab->chains[idx];
+    head = tab_find_head(tab, h, key_data, key_datasz);
   }
 
   if (head == NULL) {
@@ -632,7 +983,7 @@ const void *pr_table_kget(pr_table_t *tab, const void *key_data,
 
 const void *pr_table_kremove(pr_table_t *tab, const void *key_data,
     size_t key_datasz, size_t *value_datasz) {
-  unsigned int h = 0, idx = 0;
+  unsigned int h = 0;
   pr_table_entry_t *head = NULL, *ent = NULL;
 
   if (tab == NULL ||
@@ -670,8 +1021,7 @@ const void *pr_table_kremove(pr_table_t *tab, const void *key_data,
   /* Don't forget to add in the random seed data. */
   h = tab->keyhash(key_data, key_datasz) + tab->seed;
 
-  idx = h % tab->nchains;
-  head = tab->chains[idx];
+  head = tab_find_head(tab, h, key_data, key_datasz);
   if (head == NULL) {
     tab->cache_ent = NULL;
 
@@ -747,8 +1097,7 @@ int pr_table_kset(pr_table_t *tab, const void *key_data, size_t key_datasz,
      head = tab->cache_ent->next;
 
   } else {
-    unsigned int idx = h % tab->nchains;
-    head = tab->chains[idx];
+    head = tab_find_head(tab, h, key_data, key_datasz);
   }
 
   if (head == NULL) {
@@ -903,10 +1252,10 @@ int pr_table_do(pr_table_t *tab, int (*cb)(const void *key_data,
     return 0;
   }
 
-  for (i = 0; i < tab->nchains; i++) {
+  for (i = 0; i < tab_nbuckets(tab); i++) {
     pr_table_entry_t *ent;
 
-    ent = tab->chains[i];
+    ent = tab_bucket(tab, i);
     while (ent != NULL) {
       pr_table_entry_t *next_ent;
       int res;
@@ -944,10 +1293,13 @@ int pr_table_empty(pr_table_t *tab) {
     return 0;
   }
 
-  for (i = 0; i < tab->nchains; i++) {
+  for (i = 0; i < tab_nbuckets(tab); i++) {
     pr_table_entry_t *e;
 
-    e = tab->chains[i];
+    /* Note that for open addressing, removing the last entry for a key
+     * may shift another key into this slot; keep going until it is empty.
+     */
+    e = tab_bucket(tab, i);
     while (e != NULL) {
       if (!handling_signal) {
         pr_signals_handle();
@@ -956,10 +1308,12 @@ int pr_table_empty(pr_table_t *tab) {
       tab_entry_remove(tab, e);
       tab_entry_free(tab, e);
 
-      e = tab->chains[i];
+      e = tab_bucket(tab, i);
     }
 
-    tab->chains[i] = NULL;
+    if (tab->backend != PR_TABLE_BACKEND_OPEN_ADDR) {
+      tab->chains[i] = NULL;
+    }
   }
 
   return 0;
@@ -1149,6 +1503,18 @@ int pr_table_ctl(pr_table_t *tab, int cmd, void *arg) {
         return -1;
       }
 
+      if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+        /* For open addressing, the number of chains is only a hint of how
+         * many keys to expect; the slots grow as needed.
+         */
+        if (slot_alloc(tab, new_nchains) < 0) {
+          return -1;
+        }
+
+        tab->nchains = new_nchains;
+        return 0;
+      }
+
       tab->nchains = new_nchains;
       
       /* Note: by not freeing the memory of the previously allocated
@@ -1159,6 +1525,50 @@ int pr_table_ctl(pr_table_t *tab, int cmd, void *arg) {
       return 0;
     }
 
+    case PR_TABLE_CTL_SET_BACKEND: {
+      int backend;
+
+      if (arg == NULL) {
+        errno = EINVAL;
+        return -1;
+      }
+
+      backend = *((int *) arg);
+      switch (backend) {
+        case PR_TABLE_BACKEND_CHAINED:
+          if (tab->slot_pool != NULL) {
+            destroy_pool(tab->slot_pool);
+            tab->slot_pool = NULL;
+          }
+
+          tab->slots = NULL;
+          tab->nslots = 0;
+          break;
+
+        case PR_TABLE_BACKEND_OPEN_ADDR:
+          if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+            return 0;
+          }
+
+          if (slot_alloc(tab, tab->nchains) < 0) {
+            return -1;
+          }
+          break;
+
+        default:
+          errno = EINVAL;
+          return -1;
+      }
+
+      /* Start with fresh free lists, so that the allocation of entries and
+       * keys matches the backend.
+       */
+      tab->free_ents = NULL;
+      tab->free_keys = NULL;
+      tab->backend = backend;
+      return 0;
+    }
+
     case PR_TABLE_CTL_SET_MAX_ENTS: {
       unsigned int nmaxents;
 
@@ -1220,6 +1630,11 @@ float pr_table_load(pr_table_t *tab) {
     return -1.0;
   }
 
+  if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+    load_factor = ((float) tab->nkeys / tab->nslots);
+    return load_factor;
+  }
+
   load_factor = (tab->nents / tab->nchains);
   return load_factor;
 }
@@ -1260,18 +1675,26 @@ void pr_table_dump(void (*dumpf)(const char *fmt, ...), pr_table_t *tab) {
   }
 
   dumpf("[table count]: %u", tab->nents);
-  for (i = 0; i < tab->nchains; i++) {
+  for (i = 0; i < tab_nbuckets(tab); i++) {
     register unsigned int j = 0;
-    pr_table_entry_t *ent = tab->chains[i];
+    pr_table_entry_t *ent = tab_bucket(tab, i);
 
     while (ent) {
       if (!handling_signal) {
         pr_signals_handle();
       }
 
-      dumpf("[hash %u (%u chains) chain %u#%u] '%s' => '%s' (%u)",
-        ent->key->hash, tab->nchains, i, j++, ent->key->key_data,
-        ent->value_data, ent->value_datasz);
+      if (tab->backend == PR_TABLE_BACKEND_OPEN_ADDR) {
+        dumpf("[hash %u (%u slots) slot %u#%u, distance %u] '%s' => '%s' (%u)",
+          ent->key->hash, tab->nslots, i, j++, tab->slots[i].dist - 1,
+          ent->key->key_data, ent->value_data, ent->value_datasz);
+
+      } else {
+        dumpf("[hash %u (%u chains) chain %u#%u] '%s' => '%s' (%u)",
+          ent->key->hash, tab->nchains, i, j++, ent->key->key_data,
+          ent->value_data, ent->value_datasz);
+      }
+
       ent = ent->next;
     }
   }
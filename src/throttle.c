@@ -209,6 +209,22 @@ void pr_throttle_init(cmd_rec *cmd) {
   }
 }
 
+/* Update the current transfer progress in the scoreboard, along with the
+ * session's cumulative transfer counters.
+ */
+static void xfer_rate_update_scoreboard(off_t xferlen, long elapsed) {
+  pr_scoreboard_entry_update(session.pid,
+    PR_SCORE_XFER_LEN, xferlen,
+    PR_SCORE_XFER_ELAPSED, (unsigned long) elapsed,
+    PR_SCORE_BYTES_IN, session.total_bytes_in,
+    PR_SCORE_BYTES_OUT, session.total_bytes_out,
+    PR_SCORE_XFER_DISK_MS, (unsigned long) (session.total_disk_usecs / 1000),
+    PR_SCORE_XFER_NET_MS, (unsigned long) (session.total_net_usecs / 1000),
+    PR_SCORE_XFER_THROTTLE_MS,
+      (unsigned long) (session.total_throttle_usecs / 1000),
+    NULL);
+}
+
 void pr_throttle_pause(off_t xferlen, int xfer_ending) {
   long ideal = 0, elapsed = 0;
   off_t orig_xferlen = xferlen;
@@ -227,10 +243,7 @@ void pr_throttle_pause(off_t xferlen, int xfer_ending) {
     if (xfer_ending ||
         xfer_rate_scoreboard_updates % PR_TUNABLE_XFER_SCOREBOARD_UPDATES == 0) {
       /* Update the scoreboard. */
-      pr_scoreboard_entry_update(session.pid,
-        PR_SCORE_XFER_LEN, orig_xferlen,
-        PR_SCORE_XFER_ELAPSED, (unsigned long) elapsed,
-        NULL);
+      xfer_rate_update_scoreboard(orig_xferlen, elapsed);
 
       xfer_rate_scoreboard_updates = 0;
     }
@@ -257,10 +270,7 @@ void pr_throttle_pause(off_t xferlen, int xfer_ending) {
 
       if (xfer_ending ||
           xfer_rate_scoreboard_updates % PR_TUNABLE_XFER_SCOREBOARD_UPDATES == 0) {
-        pr_scoreboard_entry_update(session.pid,
-          PR_SCORE_XFER_LEN, orig_xferlen,
-          PR_SCORE_XFER_ELAPSED, (unsigned long) elapsed,
-          NULL);
+        xfer_rate_update_scoreboard(orig_xferlen, elapsed);
 
         xfer_rate_scoreboard_updates = 0;
       }
@@ -272,7 +282,9 @@ void pr_throttle_pause(off_t xferlen, int xfer_ending) {
   ideal = xferlen * 1000L / xfer_rate_bps;
 
   if (ideal > elapsed) {
+    int res, xerrno;
     struct timeval tv;
+    uint64_t sleep_start_usecs = 0, sleep_end_usecs = 0;
 
     /* Setup for the select.  We use select() instead of usleep() because it
      * seems to be far more portable across platforms.
@@ -290,9 +302,16 @@ void pr_throttle_pause(off_t xferlen, int xfer_ending) {
     /* No interruptions, please... */
     xfer_rate_sigmask(TRUE);
 
-    if (select(0, NULL, NULL, NULL, &tv) < 0) {
-      int xerrno = errno;
+    pr_gettimeofday_micros(&sleep_start_usecs);
+    res = select(0, NULL, NULL, NULL, &tv);
+    xerrno = errno;
+
+    if (pr_gettimeofday_micros(&sleep_end_usecs) == 0 &&
+        sleep_end_usecs > sleep_start_usecs) {
+      session.total_throttle_usecs += (sleep_end_usecs - sleep_start_usecs);
+    }
 
+    if (res < 0) {
       if (XFER_ABORTED) {
         pr_log_pri(PR_LOG_NOTICE, "throttling interrupted, transfer aborted");
         xfer_rate_sigmask(FALSE);
@@ -312,16 +331,10 @@ void pr_throttle_pause(off_t xferlen, int xfer_ending) {
     pr_signals_handle();
 
     /* Update the scoreboard. */
-    pr_scoreboard_entry_update(session.pid,
-      PR_SCORE_XFER_LEN, orig_xferlen,
-      PR_SCORE_XFER_ELAPSED, (unsigned long) ideal,
-      NULL);
+    xfer_rate_update_scoreboard(orig_xferlen, ideal);
 
   } else {
     /* Update the scoreboard. */
-    pr_scoreboard_entry_update(session.pid,
-      PR_SCORE_XFER_LEN, orig_xferlen,
-      PR_SCORE_XFER_ELAPSED, (unsigned long) elapsed,
-      NULL);
+    xfer_rate_update_scoreboard(orig_xferlen, elapsed);
   }
 }
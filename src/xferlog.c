@@ -32,6 +32,7 @@ static int xferlogfd = -1;
 
 void xferlog_close(void) {
   if (xferlogfd != -1) {
+    (void) pr_log_flush(xferlogfd);
     (void) close(xferlogfd);
   }
 
@@ -131,5 +132,9 @@ int xferlog_write(long xfertime, const char *remhost, off_t fsize,
   pr_log_event_generate(PR_LOG_TYPE_XFERLOG, xferlogfd, -1, buf, len);
   destroy_pool(tmp_pool);
 
-  return write(xferlogfd, buf, len);
+  if (pr_log_writebuf(xferlogfd, buf, len) < 0) {
+    return -1;
+  }
+
+  return len;
 }
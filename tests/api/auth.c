@@ -26,6 +26,8 @@
 
 #include "tests.h"
 
+extern xaset_t *server_list;
+
 #define PR_TEST_AUTH_NAME		"testsuite_user"
 #define PR_TEST_AUTH_NOBODY		"testsuite_nobody"
 #define PR_TEST_AUTH_NOBODY2		"testsuite_nobody2"
@@ -1431,6 +1433,179 @@ START_TEST (auth_cache_set_test) {
 }
 END_TEST
 
+START_TEST (auth_shared_cache_test) {
+  int res, status;
+  pid_t pid;
+  struct passwd *pw;
+  authtable authtab;
+  pr_auth_shared_cache_stats_t stats;
+  char *sym_name = "getpwnam";
+
+  res = pr_auth_shared_cache_get_stats(NULL);
+  ck_assert_msg(res < 0, "Failed to handle null stats");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_auth_shared_cache_get_stats(&stats);
+  ck_assert_msg(res < 0, "Failed to handle missing shared cache");
+  ck_assert_msg(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  res = pr_auth_shared_cache_login();
+  ck_assert_msg(res < 0, "Failed to handle missing shared cache");
+  ck_assert_msg(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  res = pr_auth_shared_cache_sess_init();
+  ck_assert_msg(res < 0, "Failed to handle missing shared cache");
+  ck_assert_msg(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  res = pr_auth_shared_cache_update();
+  ck_assert_msg(res < 0, "Failed to handle missing shared cache");
+  ck_assert_msg(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  res = pr_auth_shared_cache_init(0, 60, 10);
+  ck_assert_msg(res < 0, "Failed to handle zero entries");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_auth_shared_cache_init(16, 60, 10);
+  if (res < 0 &&
+      errno == ENOSYS) {
+    return;
+  }
+
+  ck_assert_msg(res == 0, "Failed to create shared cache: %s",
+    strerror(errno));
+
+  memset(&authtab, 0, sizeof(authtab));
+  authtab.name = sym_name;
+  authtab.handler = handle_getpwnam;
+  authtab.m = &testsuite_module;
+  res = pr_stash_add_symbol(PR_SYM_AUTH, &authtab);
+  ck_assert_msg(res == 0, "Failed to add '%s' AUTH symbol: %s", sym_name,
+    strerror(errno));
+
+  server_list = xaset_create(p, NULL);
+  xaset_insert(server_list, (xasetmember_t *) test_server);
+
+  /* The daemon stores its own results directly. */
+  pw = pr_auth_getpwnam(p, PR_TEST_AUTH_NAME);
+  ck_assert_msg(pw != NULL, "Failed to find user '%s': %s", PR_TEST_AUTH_NAME,
+    strerror(errno));
+  pw = pr_auth_getpwnam(p, PR_TEST_AUTH_NAME);
+  ck_assert_msg(pw != NULL, "Failed to find user '%s': %s", PR_TEST_AUTH_NAME,
+    strerror(errno));
+  ck_assert_msg(pw->pw_uid == PR_TEST_AUTH_UID, "Expected UID %lu, got %lu",
+    (unsigned long) PR_TEST_AUTH_UID, (unsigned long) pw->pw_uid);
+  ck_assert_msg(strcmp(pw->pw_shell, PR_TEST_AUTH_SHELL) == 0,
+    "Expected shell '%s', got '%s'", PR_TEST_AUTH_SHELL, pw->pw_shell);
+  ck_assert_msg(getpwnam_count == 1, "Expected call count 1, got %u",
+    getpwnam_count);
+
+  pw = pr_auth_getpwnam(p, "other");
+  ck_assert_msg(pw == NULL, "Found user 'other' unexpectedly");
+  pw = pr_auth_getpwnam(p, "other");
+  ck_assert_msg(pw == NULL, "Found user 'other' unexpectedly");
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+  ck_assert_msg(getpwnam_count == 2, "Expected call count 2, got %u",
+    getpwnam_count);
+
+  res = pr_auth_shared_cache_get_stats(&stats);
+  ck_assert_msg(res == 0, "Failed to get shared cache stats: %s",
+    strerror(errno));
+  ck_assert_msg(stats.hits == 1, "Expected 1 hit, got %lu",
+    (unsigned long) stats.hits);
+  ck_assert_msg(stats.negative_hits == 1, "Expected 1 negative hit, got %lu",
+    (unsigned long) stats.negative_hits);
+  ck_assert_msg(stats.used == 2, "Expected 2 used entries, got %u",
+    stats.used);
+
+  res = pr_auth_shared_cache_remove(PR_TEST_AUTH_NAME);
+  ck_assert_msg(res == 1, "Expected 1 removed entry, got %d", res);
+
+  /* A session reads the cache, but cannot write it; it sends its results to
+   * the daemon instead, until it logs in.
+   */
+  pid = fork();
+  ck_assert_msg(pid >= 0, "Failed to fork: %s", strerror(errno));
+
+  if (pid == 0) {
+    int exit_code = 0;
+
+    if (pr_auth_shared_cache_sess_init() < 0) {
+      exit_code = 1;
+
+    } else if (pr_auth_shared_cache_remove(NULL) >= 0 ||
+               errno != EPERM) {
+      exit_code = 2;
+
+    } else if (pr_auth_getpwnam(p, PR_TEST_AUTH_NAME) == NULL ||
+               pr_auth_getpwnam(p, "other") != NULL ||
+               getpwnam_count != 3) {
+      exit_code = 3;
+
+    } else if (pr_auth_shared_cache_login() < 0 ||
+               pr_auth_getpwnam(p, "third") != NULL) {
+      exit_code = 4;
+    }
+
+    _exit(exit_code);
+  }
+
+  res = waitpid(pid, &status, 0);
+  ck_assert_msg(res == pid, "Failed to wait for child: %s", strerror(errno));
+  ck_assert_msg(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+    "Child failed with status %d", status);
+
+  res = pr_auth_shared_cache_update();
+  ck_assert_msg(res == 1, "Expected 1 stored result, got %d", res);
+
+  pw = pr_auth_getpwnam(p, PR_TEST_AUTH_NAME);
+  ck_assert_msg(pw != NULL, "Failed to find user '%s': %s", PR_TEST_AUTH_NAME,
+    strerror(errno));
+  ck_assert_msg(strcmp(pw->pw_dir, PR_TEST_AUTH_HOME) == 0,
+    "Expected home '%s', got '%s'", PR_TEST_AUTH_HOME, pw->pw_dir);
+  ck_assert_msg(getpwnam_count == 2, "Expected call count 2, got %u",
+    getpwnam_count);
+
+  res = pr_auth_shared_cache_remove(NULL);
+  ck_assert_msg(res >= 0, "Failed to clear shared cache: %s",
+    strerror(errno));
+
+  pw = pr_auth_getpwnam(p, "other");
+  ck_assert_msg(pw == NULL, "Found user 'other' unexpectedly");
+  ck_assert_msg(getpwnam_count == 3, "Expected call count 3, got %u",
+    getpwnam_count);
+
+  res = pr_auth_shared_cache_init(16, 60, 10);
+  ck_assert_msg(res < 0, "Failed to handle existing shared cache");
+  ck_assert_msg(errno == EEXIST, "Expected EEXIST (%d), got %s (%d)", EEXIST,
+    strerror(errno), errno);
+
+  /* Once logged in, not even the creating process writes the cache. */
+  res = pr_auth_shared_cache_login();
+  ck_assert_msg(res == 0, "Failed to note login: %s", strerror(errno));
+
+  res = pr_auth_shared_cache_update();
+  ck_assert_msg(res < 0, "Failed to handle read-only shared cache");
+  ck_assert_msg(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  res = pr_auth_shared_cache_free();
+  ck_assert_msg(res == 0, "Failed to free shared cache: %s", strerror(errno));
+  server_list = NULL;
+
+  res = pr_auth_shared_cache_remove(NULL);
+  ck_assert_msg(res < 0, "Failed to handle missing shared cache");
+  ck_assert_msg(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+}
+END_TEST
+
 START_TEST (auth_clear_auth_only_module_test) {
   int res;
 
@@ -2246,6 +2421,7 @@ Suite *tests_get_auth_suite(void) {
   tcase_add_test(testcase, auth_cache_name2gid_failed_test);
   tcase_add_test(testcase, auth_cache_clear_test);
   tcase_add_test(testcase, auth_cache_set_test);
+  tcase_add_test(testcase, auth_shared_cache_test);
 
   /* Auth modules */
   tcase_add_test(testcase, auth_clear_auth_only_module_test);
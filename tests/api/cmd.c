@@ -641,6 +641,96 @@ START_TEST (cmd_is_ssh2_test) {
 }
 END_TEST
 
+START_TEST (cmd_stats_test) {
+  register unsigned int i;
+  int res;
+  cmd_rec *cmd;
+  array_header *cmds;
+  pr_cmd_stats_t stats;
+
+  mark_point();
+  cmd = pr_cmd_alloc(p, 1, C_RETR);
+  res = pr_cmd_stats_record(cmd, CMD, 10);
+  ck_assert_msg(res < 0, "Failed to handle uninitialized stats");
+  ck_assert_msg(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  res = pr_cmd_stats_init();
+  ck_assert_msg(res == 0, "Failed to init stats: %s", strerror(errno));
+
+  res = pr_cmd_stats_record(NULL, CMD, 10);
+  ck_assert_msg(res < 0, "Failed to handle null cmd");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_cmd_stats_record(cmd, 0, 10);
+  ck_assert_msg(res < 0, "Failed to handle invalid phase");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  /* 1000 values, from 1 to 1000 usecs. */
+  for (i = 1; i <= 1000; i++) {
+    res = pr_cmd_stats_record(cmd, CMD, i);
+    ck_assert_msg(res == 0, "Failed to record %u usecs: %s", i,
+      strerror(errno));
+  }
+
+  /* Error phases are counted with their non-error phases. */
+  res = pr_cmd_stats_record(cmd, LOG_CMD_ERR, 5);
+  ck_assert_msg(res == 0, "Failed to record LOG_CMD_ERR: %s", strerror(errno));
+
+  /* Unknown commands, without handlers, are not tracked. */
+  mark_point();
+  res = pr_cmd_stats_record(pr_cmd_alloc(p, 1, "FOOBAR"), CMD, 10);
+  ck_assert_msg(res < 0, "Failed to reject unknown command");
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  cmds = pr_cmd_stats_get_cmds(p);
+  ck_assert_msg(cmds != NULL, "Failed to get cmds: %s", strerror(errno));
+  ck_assert_msg(cmds->nelts == 1, "Expected 1 cmd, got %d", cmds->nelts);
+  ck_assert_msg(strcmp(((char **) cmds->elts)[0], C_RETR) == 0,
+    "Expected '%s', got '%s'", C_RETR, ((char **) cmds->elts)[0]);
+
+  res = pr_cmd_stats_get("FOOBAR", CMD, &stats);
+  ck_assert_msg(res < 0, "Failed to handle unknown command");
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  res = pr_cmd_stats_get(C_RETR, CMD, &stats);
+  ck_assert_msg(res == 0, "Failed to get stats: %s", strerror(errno));
+  ck_assert_msg(stats.count == 1000, "Expected count 1000, got %lu",
+    (unsigned long) stats.count);
+  ck_assert_msg(stats.max_usecs == 1000, "Expected max 1000, got %lu",
+    (unsigned long) stats.max_usecs);
+
+  /* Reported values are bucket upper bounds, within 25%. */
+  ck_assert_msg(stats.p50_usecs >= 500 && stats.p50_usecs <= 625,
+    "Expected p50 of about 500, got %lu", (unsigned long) stats.p50_usecs);
+  ck_assert_msg(stats.p99_usecs >= 990 && stats.p99_usecs <= 1000,
+    "Expected p99 of about 990, got %lu", (unsigned long) stats.p99_usecs);
+  ck_assert_msg(stats.p999_usecs == 1000, "Expected p999 of 1000, got %lu",
+    (unsigned long) stats.p999_usecs);
+
+  res = pr_cmd_stats_get(C_RETR, LOG_CMD, &stats);
+  ck_assert_msg(res == 0, "Failed to get stats: %s", strerror(errno));
+  ck_assert_msg(stats.count == 1, "Expected count 1, got %lu",
+    (unsigned long) stats.count);
+  ck_assert_msg(stats.p50_usecs == 5, "Expected p50 5, got %lu",
+    (unsigned long) stats.p50_usecs);
+
+  res = pr_cmd_stats_reset();
+  ck_assert_msg(res == 0, "Failed to reset stats: %s", strerror(errno));
+
+  res = pr_cmd_stats_get(C_RETR, CMD, &stats);
+  ck_assert_msg(res == 0, "Failed to get stats: %s", strerror(errno));
+  ck_assert_msg(stats.count == 0, "Expected count 0, got %lu",
+    (unsigned long) stats.count);
+
+  (void) pr_cmd_stats_free();
+}
+END_TEST
+
 Suite *tests_get_cmd_suite(void) {
   Suite *suite;
   TCase *testcase;
@@ -660,6 +750,7 @@ Suite *tests_get_cmd_suite(void) {
   tcase_add_test(testcase, cmd_is_http_test);
   tcase_add_test(testcase, cmd_is_smtp_test);
   tcase_add_test(testcase, cmd_is_ssh2_test);
+  tcase_add_test(testcase, cmd_stats_test);
 
   suite_add_tcase(suite, testcase);
   return suite;
@@ -413,6 +413,142 @@ START_TEST (config_find_config_test) {
 }
 END_TEST
 
+START_TEST (config_find_config_index_test) {
+  register unsigned int i;
+  int res;
+  config_rec *c;
+  xaset_t *set = NULL;
+  const char *name;
+
+  /* Enough entries that lookups in the set use its index. */
+  for (i = 0; i < 64; i++) {
+    char buf[32];
+
+    memset(buf, '\0', sizeof(buf));
+    snprintf(buf, sizeof(buf)-1, "foo%u", i);
+
+    c = add_config_param_set(&set, buf, 1, "bar");
+    ck_assert_msg(c != NULL, "Failed to add config '%s': %s", buf,
+      strerror(errno));
+  }
+
+  name = "foo";
+  c = add_config_param_set(&set, name, 1, "baz");
+  ck_assert_msg(c != NULL, "Failed to add config '%s': %s", name,
+    strerror(errno));
+
+  c = add_config_param_set(&set, name, 1, "quxx");
+  ck_assert_msg(c != NULL, "Failed to add config '%s': %s", name,
+    strerror(errno));
+
+  mark_point();
+
+  /* We expect to find the first "foo" in the set. */
+  c = find_config(set, CONF_PARAM, name, FALSE);
+  ck_assert_msg(c != NULL, "Failed to find config '%s': %s", name,
+    strerror(errno));
+  ck_assert_msg(strcmp(c->argv[0], "baz") == 0,
+    "Expected 'baz', got '%s'", (char *) c->argv[0]);
+
+  c = find_config_next(c, c->next, CONF_PARAM, name, FALSE);
+  ck_assert_msg(c != NULL, "Failed to find next config '%s': %s", name,
+    strerror(errno));
+  ck_assert_msg(strcmp(c->argv[0], "quxx") == 0,
+    "Expected 'quxx', got '%s'", (char *) c->argv[0]);
+
+  c = find_config(set, CONF_DIR, name, FALSE);
+  ck_assert_msg(c == NULL, "Found config '%s' of wrong type", name);
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  name = "foo63";
+  c = find_config(set, CONF_PARAM, name, FALSE);
+  ck_assert_msg(c != NULL, "Failed to find config '%s': %s", name,
+    strerror(errno));
+
+  name = "bar";
+  c = find_config(set, CONF_PARAM, name, FALSE);
+  ck_assert_msg(c == NULL, "Found config '%s' unexpectedly", name);
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  mark_point();
+
+  /* Changes to the set must be seen by subsequent lookups. */
+  name = "foo";
+  res = remove_config(set, name, FALSE);
+  ck_assert_msg(res > 0, "Failed to remove config '%s': %s", name,
+    strerror(errno));
+
+  c = find_config(set, CONF_PARAM, name, FALSE);
+  ck_assert_msg(c == NULL, "Found config '%s' unexpectedly", name);
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  c = add_config_param_set(&set, name, 1, "bar");
+  ck_assert_msg(c != NULL, "Failed to add config '%s': %s", name,
+    strerror(errno));
+
+  c = find_config(set, CONF_PARAM, name, FALSE);
+  ck_assert_msg(c != NULL, "Failed to find config '%s': %s", name,
+    strerror(errno));
+  ck_assert_msg(strcmp(c->argv[0], "bar") == 0,
+    "Expected 'bar', got '%s'", (char *) c->argv[0]);
+}
+END_TEST
+
+START_TEST (config_find_config_index_many_sets_test) {
+  register unsigned int i, j;
+  config_rec *c;
+  xaset_t *sets[200];
+  void *indexes[200];
+  unsigned int nsets = sizeof(sets) / sizeof(sets[0]);
+
+  /* Many sets, each large enough to be indexed, looked up in turn, as when
+   * checking many <Directory> sections; each set keeps its own index.
+   */
+  memset(sets, 0, sizeof(sets));
+  for (i = 0; i < nsets; i++) {
+    for (j = 0; j < PR_TUNABLE_CONFIG_INDEX_MIN; j++) {
+      char buf[32];
+
+      memset(buf, '\0', sizeof(buf));
+      snprintf(buf, sizeof(buf)-1, "foo%u", j);
+
+      c = add_config_param_set(&(sets[i]), buf, 1, "bar");
+      ck_assert_msg(c != NULL, "Failed to add config '%s': %s", buf,
+        strerror(errno));
+    }
+
+    c = find_config(sets[i], CONF_PARAM, "foo0", FALSE);
+    ck_assert_msg(c != NULL, "Failed to find config 'foo0' in set %u: %s", i,
+      strerror(errno));
+
+    indexes[i] = sets[i]->xas_indexes[XASET_INDEX_CONFIG];
+    ck_assert_msg(indexes[i] != NULL, "Expected index for set %u", i);
+  }
+
+  for (i = 0; i < nsets; i++) {
+    c = find_config(sets[i], CONF_PARAM, "foo1", FALSE);
+    ck_assert_msg(c != NULL, "Failed to find config 'foo1' in set %u: %s", i,
+      strerror(errno));
+    ck_assert_msg(c->set == sets[i], "Found config in wrong set");
+
+    ck_assert_msg(sets[i]->xas_indexes[XASET_INDEX_CONFIG] == indexes[i],
+      "Expected index for set %u to be reused", i);
+  }
+
+  /* A changed set gets a new index. */
+  c = add_config_param_set(&(sets[0]), "foo", 1, "baz");
+  ck_assert_msg(c != NULL, "Failed to add config 'foo': %s", strerror(errno));
+
+  c = find_config(sets[0], CONF_PARAM, "foo", FALSE);
+  ck_assert_msg(c != NULL, "Failed to find config 'foo': %s", strerror(errno));
+  ck_assert_msg(strcmp(c->argv[0], "baz") == 0,
+    "Expected 'baz', got '%s'", (char *) c->argv[0]);
+}
+END_TEST
+
 START_TEST (config_find_config2_test) {
   int res;
   config_rec *c;
@@ -780,6 +916,8 @@ Suite *tests_get_config_suite(void) {
   tcase_add_test(testcase, config_add_config_set_test);
   tcase_add_test(testcase, config_dump_test);
   tcase_add_test(testcase, config_find_config_test);
+  tcase_add_test(testcase, config_find_config_index_test);
+  tcase_add_test(testcase, config_find_config_index_many_sets_test);
   tcase_add_test(testcase, config_find_config2_test);
   tcase_add_test(testcase, config_find_config2_recurse_test);
   tcase_add_test(testcase, config_find_config_set_top_test);
@@ -174,6 +174,28 @@ START_TEST (data_ignore_ascii_test) {
 }
 END_TEST
 
+START_TEST (data_adaptive_bufsz_test) {
+  int res;
+
+  res = pr_data_adaptive_bufsz(-1);
+  ck_assert_msg(res < 0, "Failed to handle invalid argument");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_data_adaptive_bufsz(TRUE);
+  ck_assert_msg(res == FALSE, "Expected FALSE (%d), got %d", FALSE, res);
+
+  res = pr_data_adaptive_bufsz(TRUE);
+  ck_assert_msg(res == TRUE, "Expected TRUE (%d), got %d", TRUE, res);
+
+  res = pr_data_adaptive_bufsz(FALSE);
+  ck_assert_msg(res == TRUE, "Expected TRUE (%d), got %d", TRUE, res);
+
+  res = pr_data_adaptive_bufsz(FALSE);
+  ck_assert_msg(res == FALSE, "Expected FALSE (%d), got %d", FALSE, res);
+}
+END_TEST
+
 static int data_close_cb(pr_netio_stream_t *nstrm) {
   return 0;
 }
@@ -1459,6 +1481,7 @@ Suite *tests_get_data_suite(void) {
   tcase_add_test(testcase, data_get_timeout_test);
   tcase_add_test(testcase, data_set_timeout_test);
   tcase_add_test(testcase, data_ignore_ascii_test);
+  tcase_add_test(testcase, data_adaptive_bufsz_test);
   tcase_add_test(testcase, data_sendfile_test);
 
   tcase_add_test(testcase, data_init_test);
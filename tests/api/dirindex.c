@@ -0,0 +1,416 @@
+/*
+ * ProFTPD - FTP server testsuite
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* <Directory> index API tests. */
+
+#include "tests.h"
+
+static pool *p = NULL;
+
+/* Fixtures */
+
+static void set_up(void) {
+  if (p == NULL) {
+    p = permanent_pool = make_sub_pool(NULL);
+  }
+
+  init_config();
+
+  if (getenv("TEST_VERBOSE") != NULL) {
+    pr_trace_set_levels("directory", 1, 20);
+  }
+}
+
+static void tear_down(void) {
+  if (getenv("TEST_VERBOSE") != NULL) {
+    pr_trace_set_levels("directory", 0, 0);
+  }
+
+  if (p) {
+    destroy_pool(p);
+    p = permanent_pool = NULL;
+  }
+}
+
+static config_rec *add_dir(xaset_t **set, const char *path) {
+  config_rec *c;
+
+  c = add_config_param_set(set, path, 2, NULL, NULL);
+  ck_assert_msg(c != NULL, "Failed to add <Directory %s>: %s", path,
+    strerror(errno));
+  c->config_type = CONF_DIR;
+
+  return c;
+}
+
+/* Adds enough unrelated sections for the set to be indexed. */
+static void add_filler_dirs(xaset_t **set, const char *prefix) {
+  register unsigned int i;
+
+  for (i = 0; i < PR_TUNABLE_DIR_INDEX_MIN; i++) {
+    char buf[64];
+
+    memset(buf, '\0', sizeof(buf));
+    snprintf(buf, sizeof(buf)-1, "%s/filler%u", prefix, i);
+    (void) add_dir(set, buf);
+  }
+}
+
+/* Finds the first matching section by checking each section in turn. */
+static config_rec *scan_match_path(xaset_t *set, const char *path,
+    int *match) {
+  config_rec *c;
+
+  for (c = (config_rec *) set->xas_list; c; c = c->next) {
+    if (c->config_type == CONF_DIR) {
+      *match = pr_dir_match_entry(p, c, path);
+      if (*match != DIR_MATCH_NONE) {
+        return c;
+      }
+    }
+  }
+
+  *match = DIR_MATCH_NONE;
+  return NULL;
+}
+
+/* Tests */
+
+START_TEST (dir_match_entry_test) {
+  int res;
+  xaset_t *set = NULL;
+  config_rec *c;
+
+  c = add_dir(&set, "/var/ftp");
+
+  res = pr_dir_match_entry(p, c, "/var/ftp");
+  ck_assert_msg(res == DIR_MATCH_EXACT, "Expected exact match, got %d", res);
+
+  res = pr_dir_match_entry(p, c, "/var/ftp/pub");
+  ck_assert_msg(res == DIR_MATCH_GLOB, "Expected glob match, got %d", res);
+
+  res = pr_dir_match_entry(p, c, "/var/ftp2");
+  ck_assert_msg(res == DIR_MATCH_NONE, "Expected no match, got %d", res);
+
+  c = add_dir(&set, "/var/www/");
+
+  res = pr_dir_match_entry(p, c, "/var/www");
+  ck_assert_msg(res == DIR_MATCH_EXACT, "Expected exact match, got %d", res);
+
+  c = add_dir(&set, "/home/*/incoming");
+
+  res = pr_dir_match_entry(p, c, "/home/bob/incoming/file.txt");
+  ck_assert_msg(res == DIR_MATCH_GLOB, "Expected glob match, got %d", res);
+
+  res = pr_dir_match_entry(p, c, "/home/bob/outgoing");
+  ck_assert_msg(res == DIR_MATCH_NONE, "Expected no match, got %d", res);
+}
+END_TEST
+
+START_TEST (dir_is_parent_test) {
+  int res;
+  xaset_t *set = NULL;
+  config_rec *c;
+
+  c = add_dir(&set, "/var/www/.1/*");
+
+  res = pr_dir_is_parent(c, "/var/www/.1/images", 18);
+  ck_assert_msg(res == TRUE, "Expected TRUE for subdirectory");
+
+  res = pr_dir_is_parent(c, "/var/www/.14", 12);
+  ck_assert_msg(res == FALSE, "Expected FALSE for shared path prefix");
+
+  res = pr_dir_is_parent(c, "/var/www/.1", 11);
+  ck_assert_msg(res == FALSE, "Expected FALSE for same directory");
+}
+END_TEST
+
+START_TEST (dir_index_get_test) {
+  pr_dir_index_t *idx, *idx2;
+  xaset_t *set = NULL;
+
+  idx = pr_dir_index_get(NULL);
+  ck_assert_msg(idx == NULL, "Failed to handle null set");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  /* Small sets are not indexed. */
+  (void) add_dir(&set, "/var/ftp");
+
+  idx = pr_dir_index_get(set);
+  ck_assert_msg(idx == NULL, "Expected no index for small set");
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  add_filler_dirs(&set, "/srv");
+
+  idx = pr_dir_index_get(set);
+  ck_assert_msg(idx != NULL, "Failed to get index: %s", strerror(errno));
+  ck_assert_msg(set->xas_indexes[XASET_INDEX_DIR] == idx,
+    "Expected index to be kept by the set");
+
+  idx2 = pr_dir_index_lookup(set);
+  ck_assert_msg(idx2 == idx, "Expected current index");
+
+  /* Once the set changes, its index is no longer current, and is rebuilt. */
+  (void) add_dir(&set, "/var/www");
+
+  idx2 = pr_dir_index_lookup(set);
+  ck_assert_msg(idx2 == NULL, "Expected no current index after change");
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  idx = pr_dir_index_get(set);
+  ck_assert_msg(idx != NULL, "Failed to rebuild index: %s", strerror(errno));
+  ck_assert_msg(pr_dir_index_lookup(set) == idx, "Expected current index");
+}
+END_TEST
+
+START_TEST (dir_index_many_sets_test) {
+  register unsigned int i;
+  xaset_t *sets[200];
+  pr_dir_index_t *indexes[200];
+  unsigned int nsets = sizeof(sets) / sizeof(sets[0]);
+
+  /* Many indexed sets, as for many <Directory> sections with nested
+   * sections, used in turn; none of them evicts another's index.
+   */
+  memset(sets, 0, sizeof(sets));
+  for (i = 0; i < nsets; i++) {
+    add_filler_dirs(&(sets[i]), "/srv");
+
+    indexes[i] = pr_dir_index_get(sets[i]);
+    ck_assert_msg(indexes[i] != NULL, "Failed to get index for set %u: %s", i,
+      strerror(errno));
+  }
+
+  for (i = 0; i < nsets; i++) {
+    pr_dir_index_t *idx;
+    config_rec *c;
+    int match = DIR_MATCH_NONE;
+
+    idx = pr_dir_index_lookup(sets[i]);
+    ck_assert_msg(idx == indexes[i], "Expected index for set %u to be kept",
+      i);
+
+    c = pr_dir_index_match_path(p, idx, "/srv/filler3/file.txt", &match);
+    ck_assert_msg(c != NULL, "Failed to match path in set %u: %s", i,
+      strerror(errno));
+    ck_assert_msg(c->set == sets[i], "Matched section in wrong set");
+    ck_assert_msg(strcmp(c->name, "/srv/filler3") == 0,
+      "Expected '/srv/filler3', got '%s'", c->name);
+    ck_assert_msg(match == DIR_MATCH_GLOB, "Expected glob match, got %d",
+      match);
+  }
+}
+END_TEST
+
+START_TEST (dir_index_match_path_test) {
+  register unsigned int i;
+  pr_dir_index_t *idx;
+  xaset_t *set = NULL;
+  config_rec *c, *expected;
+  int match, expected_match;
+  const char *paths[] = {
+    "/",
+    "/var",
+    "/var/ftp",
+    "/var/ftp/",
+    "/var/ftp/pub",
+    "/var/ftp/pub/incoming/a.txt",
+    "/var/ftp2/pub",
+    "/home/bob/incoming",
+    "/home/bob/incoming/file.txt",
+    "/home/bob/outgoing",
+    "/srv/filler3",
+    "/srv/filler30",
+    "/tmp",
+    NULL
+  };
+
+  /* Sections are matched in set order, whether keyed by path (plain paths)
+   * or not (globs).
+   */
+  (void) add_dir(&set, "/var/ftp/pub/incoming");
+  (void) add_dir(&set, "/home/*/incoming");
+  (void) add_dir(&set, "/var/ftp/pub");
+  c = add_dir(&set, "/var/ftp/");
+  add_filler_dirs(&set, "/srv");
+  (void) add_dir(&set, "/home");
+  (void) add_dir(&set, "/");
+
+  idx = pr_dir_index_get(set);
+  ck_assert_msg(idx != NULL, "Failed to get index: %s", strerror(errno));
+
+  /* Indexing a section leaves its name as is. */
+  ck_assert_msg(strcmp(c->name, "/var/ftp/") == 0,
+    "Expected '/var/ftp/', got '%s'", c->name);
+
+  c = pr_dir_index_match_path(p, idx, "/var/ftp", &match);
+  ck_assert_msg(c != NULL, "Failed to match '/var/ftp': %s", strerror(errno));
+  ck_assert_msg(match == DIR_MATCH_EXACT, "Expected exact match, got %d",
+    match);
+
+  c = pr_dir_index_match_path(p, NULL, "/", &match);
+  ck_assert_msg(c == NULL, "Failed to handle null index");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  for (i = 0; paths[i] != NULL; i++) {
+    match = expected_match = DIR_MATCH_NONE;
+
+    expected = scan_match_path(set, paths[i], &expected_match);
+    c = pr_dir_index_match_path(p, idx, paths[i], &match);
+
+    ck_assert_msg(c == expected, "Expected <Directory %s> for '%s', got %s",
+      expected ? expected->name : "(none)", paths[i], c ? c->name : "(none)");
+    ck_assert_msg(match == expected_match,
+      "Expected match %d for '%s', got %d", expected_match, paths[i], match);
+  }
+
+  /* Without a catch-all section, some paths match nothing. */
+  set = NULL;
+  (void) add_dir(&set, "/var/ftp");
+  add_filler_dirs(&set, "/srv");
+
+  idx = pr_dir_index_get(set);
+  ck_assert_msg(idx != NULL, "Failed to get index: %s", strerror(errno));
+
+  c = pr_dir_index_match_path(p, idx, "/tmp", &match);
+  ck_assert_msg(c == NULL, "Expected no match for '/tmp'");
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+  ck_assert_msg(match == DIR_MATCH_NONE, "Expected no match, got %d", match);
+}
+END_TEST
+
+START_TEST (dir_index_get_parents_test) {
+  pr_dir_index_t *idx;
+  xaset_t *set = NULL;
+  config_rec *c, *incoming, *pub, *deferred, *root;
+  array_header *dirs;
+
+  incoming = add_dir(&set, "/var/ftp/pub/incoming");
+
+  /* Deferred sections are not keyed by path. */
+  deferred = add_dir(&set, "/var");
+  deferred->flags |= CF_DEFER;
+
+  add_filler_dirs(&set, "/srv");
+  pub = add_dir(&set, "/var/ftp/pub");
+  root = add_dir(&set, "/var/ftp/*");
+  (void) add_dir(&set, "/var/ftp2");
+
+  idx = pr_dir_index_get(set);
+  ck_assert_msg(idx != NULL, "Failed to get index: %s", strerror(errno));
+
+  dirs = pr_dir_index_get_parents(p, NULL, incoming->name, 0);
+  ck_assert_msg(dirs == NULL, "Failed to handle null index");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  /* The parents come back in set order, keyed or not, and without the
+   * section itself.
+   */
+  dirs = pr_dir_index_get_parents(p, idx, incoming->name,
+    strlen(incoming->name));
+  ck_assert_msg(dirs != NULL, "Failed to get parents: %s", strerror(errno));
+  ck_assert_msg(dirs->nelts == 3, "Expected 3 parents, got %u", dirs->nelts);
+
+  c = ((config_rec **) dirs->elts)[0];
+  ck_assert_msg(c == deferred, "Expected <Directory %s>, got <Directory %s>",
+    deferred->name, c->name);
+
+  c = ((config_rec **) dirs->elts)[1];
+  ck_assert_msg(c == pub, "Expected <Directory %s>, got <Directory %s>",
+    pub->name, c->name);
+
+  c = ((config_rec **) dirs->elts)[2];
+  ck_assert_msg(c == root, "Expected <Directory %s>, got <Directory %s>",
+    root->name, c->name);
+}
+END_TEST
+
+START_TEST (dir_index_update_test) {
+  pr_dir_index_t *idx, *idx2;
+  xaset_t *set = NULL, *set2 = NULL;
+  config_rec *c, *moved;
+  int match = DIR_MATCH_NONE;
+
+  moved = add_dir(&set, "/var/ftp");
+  add_filler_dirs(&set, "/srv");
+  add_filler_dirs(&set2, "/home");
+
+  idx = pr_dir_index_get(set);
+  ck_assert_msg(idx != NULL, "Failed to get index: %s", strerror(errno));
+
+  idx2 = pr_dir_index_get(set2);
+  ck_assert_msg(idx2 != NULL, "Failed to get index: %s", strerror(errno));
+
+  /* Move a section from one set to the head of the other, as reordering the
+   * <Directory> sections does, keeping both indexes current.
+   */
+  xaset_remove(set, (xasetmember_t *) moved);
+  pr_dir_index_remove(idx, moved);
+
+  xaset_insert(set2, (xasetmember_t *) moved);
+  pr_dir_index_insert_head(idx2, moved);
+  moved->set = set2;
+
+  ck_assert_msg(pr_dir_index_lookup(set) == idx,
+    "Expected index to stay current after remove");
+  ck_assert_msg(pr_dir_index_lookup(set2) == idx2,
+    "Expected index to stay current after insert");
+
+  c = pr_dir_index_match_path(p, idx, "/var/ftp/pub", &match);
+  ck_assert_msg(c == NULL, "Expected no match for removed section");
+
+  c = pr_dir_index_match_path(p, idx2, "/var/ftp/pub", &match);
+  ck_assert_msg(c == moved, "Expected match for inserted section, got %s",
+    c ? c->name : "(none)");
+  ck_assert_msg(match == DIR_MATCH_GLOB, "Expected glob match, got %d",
+    match);
+}
+END_TEST
+
+Suite *tests_get_dirindex_suite(void) {
+  Suite *suite;
+  TCase *testcase;
+
+  suite = suite_create("dirindex");
+
+  testcase = tcase_create("base");
+  tcase_add_checked_fixture(testcase, set_up, tear_down);
+
+  tcase_add_test(testcase, dir_match_entry_test);
+  tcase_add_test(testcase, dir_is_parent_test);
+  tcase_add_test(testcase, dir_index_get_test);
+  tcase_add_test(testcase, dir_index_many_sets_test);
+  tcase_add_test(testcase, dir_index_match_path_test);
+  tcase_add_test(testcase, dir_index_get_parents_test);
+  tcase_add_test(testcase, dir_index_update_test);
+
+  suite_add_tcase(suite, testcase);
+  return suite;
+}
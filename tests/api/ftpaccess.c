@@ -0,0 +1,297 @@
+/*
+ * ProFTPD - FTP server testsuite
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* .ftpaccess check API tests. */
+
+#include "tests.h"
+
+static pool *p = NULL;
+static const char *ftpaccess_dir = "/tmp/prt-ftpaccess";
+static const char *ftpaccess_path = "/tmp/prt-ftpaccess/.ftpaccess";
+
+/* Fixtures */
+
+static void set_up(void) {
+  if (p == NULL) {
+    p = permanent_pool = make_sub_pool(NULL);
+  }
+
+  init_fs();
+
+  (void) unlink(ftpaccess_path);
+  (void) rmdir(ftpaccess_dir);
+  (void) mkdir(ftpaccess_dir, 0755);
+
+  session.anon_config = NULL;
+
+  if (getenv("TEST_VERBOSE") != NULL) {
+    pr_trace_set_levels("ftpaccess", 1, 20);
+  }
+}
+
+static void tear_down(void) {
+  pr_ftpaccess_clear();
+  session.anon_config = NULL;
+
+  if (getenv("TEST_VERBOSE") != NULL) {
+    pr_trace_set_levels("ftpaccess", 0, 0);
+  }
+
+  if (p) {
+    destroy_pool(p);
+    p = permanent_pool = NULL;
+  }
+
+  (void) unlink(ftpaccess_path);
+  (void) rmdir(ftpaccess_dir);
+}
+
+static void write_ftpaccess(const char *text) {
+  int fd;
+  ssize_t res;
+
+  fd = open(ftpaccess_path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  ck_assert_msg(fd >= 0, "Failed to open '%s': %s", ftpaccess_path,
+    strerror(errno));
+
+  res = write(fd, text, strlen(text));
+  ck_assert_msg(res == (ssize_t) strlen(text), "Failed to write '%s': %s",
+    ftpaccess_path, strerror(errno));
+  (void) close(fd);
+}
+
+/* Tests */
+
+START_TEST (ftpaccess_stat_test) {
+  int res;
+  struct stat st;
+
+  res = pr_ftpaccess_stat(NULL, NULL, NULL);
+  ck_assert_msg(res < 0, "Failed to handle null arguments");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  ck_assert_msg(res < 0, "Failed to handle missing .ftpaccess file");
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  pr_ftpaccess_clear();
+  write_ftpaccess("Umask 077\n");
+
+  res = pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  ck_assert_msg(res == 0, "Failed to stat '%s': %s", ftpaccess_path,
+    strerror(errno));
+  ck_assert_msg(st.st_size == 10, "Expected size 10, got %lu",
+    (unsigned long) st.st_size);
+}
+END_TEST
+
+START_TEST (ftpaccess_is_current_test) {
+  int res;
+  struct stat st;
+
+  res = pr_ftpaccess_is_current(NULL);
+  ck_assert_msg(res == FALSE, "Expected FALSE, got %d", res);
+
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == FALSE, "Expected FALSE for unchecked directory");
+
+  (void) pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == FALSE, "Expected FALSE before being marked current");
+
+  pr_ftpaccess_set_current(ftpaccess_dir);
+
+#if PR_TUNABLE_DYN_CONFIG_MAX_AGE > 0
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == TRUE, "Expected TRUE once marked current");
+
+  /* Any change to the .ftpaccess config makes every directory stale. */
+  pr_ftpaccess_changed();
+
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == FALSE, "Expected FALSE after config change");
+#else
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == FALSE, "Expected FALSE without .ftpaccess checks");
+#endif /* PR_TUNABLE_DYN_CONFIG_MAX_AGE */
+}
+END_TEST
+
+#if PR_TUNABLE_DYN_CONFIG_MAX_AGE > 0
+START_TEST (ftpaccess_cache_hit_test) {
+  int res;
+  struct stat st;
+
+  write_ftpaccess("Umask 077\n");
+
+  res = pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  ck_assert_msg(res == 0, "Failed to stat '%s': %s", ftpaccess_path,
+    strerror(errno));
+  pr_ftpaccess_set_current(ftpaccess_dir);
+
+  /* Within the max age, the previous check is reused, even though the file
+   * has since changed.
+   */
+  write_ftpaccess("Umask 022\nDirFakeUser on\n");
+
+  res = pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  ck_assert_msg(res == 0, "Failed to stat '%s': %s", ftpaccess_path,
+    strerror(errno));
+  ck_assert_msg(st.st_size == 10, "Expected cached size 10, got %lu",
+    (unsigned long) st.st_size);
+
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == TRUE, "Expected TRUE for cached check");
+
+  /* The same holds for a directory without an .ftpaccess file. */
+  (void) unlink(ftpaccess_path);
+  pr_ftpaccess_clear();
+
+  res = pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  ck_assert_msg(res < 0, "Failed to handle missing .ftpaccess file");
+
+  write_ftpaccess("Umask 077\n");
+
+  res = pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  ck_assert_msg(res < 0, "Expected cached missing .ftpaccess file");
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+}
+END_TEST
+
+START_TEST (ftpaccess_invalidate_test) {
+  int res;
+  struct stat st;
+  config_rec anon;
+
+  write_ftpaccess("Umask 077\n");
+
+  (void) pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  pr_ftpaccess_set_current(ftpaccess_dir);
+
+  /* Changes to other files made by the session leave the checks alone. */
+  (void) pr_fs_clear_cache2("/tmp/prt-ftpaccess/foo.txt");
+
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == TRUE, "Expected TRUE after unrelated change");
+
+  /* Changes to an .ftpaccess file made by the session discard them. */
+  write_ftpaccess("Umask 022\nDirFakeUser on\n");
+  (void) pr_fs_clear_cache2(ftpaccess_path);
+
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == FALSE, "Expected FALSE after .ftpaccess change");
+
+  res = pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  ck_assert_msg(res == 0, "Failed to stat '%s': %s", ftpaccess_path,
+    strerror(errno));
+  ck_assert_msg(st.st_size == 25, "Expected size 25, got %lu",
+    (unsigned long) st.st_size);
+  pr_ftpaccess_set_current(ftpaccess_dir);
+
+  /* As does a change of <Anonymous> context. */
+  memset(&anon, 0, sizeof(anon));
+  session.anon_config = &anon;
+
+  (void) pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == FALSE, "Expected FALSE after <Anonymous> change");
+}
+END_TEST
+
+START_TEST (ftpaccess_expiry_test) {
+  int res;
+  struct stat st;
+
+  write_ftpaccess("Umask 077\n");
+
+  (void) pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  pr_ftpaccess_set_current(ftpaccess_dir);
+
+  write_ftpaccess("Umask 022\nDirFakeUser on\n");
+
+  /* Once the max age has passed, the file is checked again. */
+  sleep(PR_TUNABLE_DYN_CONFIG_MAX_AGE);
+
+  res = pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  ck_assert_msg(res == 0, "Failed to stat '%s': %s", ftpaccess_path,
+    strerror(errno));
+  ck_assert_msg(st.st_size == 25, "Expected size 25, got %lu",
+    (unsigned long) st.st_size);
+
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == FALSE, "Expected FALSE for changed .ftpaccess file");
+
+  pr_ftpaccess_set_current(ftpaccess_dir);
+
+  /* An unchanged file leaves the directory current. */
+  sleep(PR_TUNABLE_DYN_CONFIG_MAX_AGE);
+
+  res = pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  ck_assert_msg(res == 0, "Failed to stat '%s': %s", ftpaccess_path,
+    strerror(errno));
+
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == TRUE, "Expected TRUE for unchanged .ftpaccess file");
+
+  /* A removed file makes it stale again. */
+  (void) unlink(ftpaccess_path);
+  sleep(PR_TUNABLE_DYN_CONFIG_MAX_AGE);
+
+  res = pr_ftpaccess_stat(ftpaccess_dir, ftpaccess_path, &st);
+  ck_assert_msg(res < 0, "Failed to handle removed .ftpaccess file");
+
+  res = pr_ftpaccess_is_current(ftpaccess_dir);
+  ck_assert_msg(res == FALSE, "Expected FALSE for removed .ftpaccess file");
+}
+END_TEST
+#endif /* PR_TUNABLE_DYN_CONFIG_MAX_AGE */
+
+Suite *tests_get_ftpaccess_suite(void) {
+  Suite *suite;
+  TCase *testcase;
+
+  suite = suite_create("ftpaccess");
+
+  testcase = tcase_create("base");
+  tcase_add_checked_fixture(testcase, set_up, tear_down);
+
+  tcase_add_test(testcase, ftpaccess_stat_test);
+  tcase_add_test(testcase, ftpaccess_is_current_test);
+#if PR_TUNABLE_DYN_CONFIG_MAX_AGE > 0
+  tcase_add_test(testcase, ftpaccess_cache_hit_test);
+  tcase_add_test(testcase, ftpaccess_invalidate_test);
+  tcase_add_test(testcase, ftpaccess_expiry_test);
+
+  /* The expiry test waits out the max age several times. */
+  tcase_set_timeout(testcase, (PR_TUNABLE_DYN_CONFIG_MAX_AGE * 3) + 30);
+#endif /* PR_TUNABLE_DYN_CONFIG_MAX_AGE */
+
+  suite_add_tcase(suite, testcase);
+  return suite;
+}
@@ -4904,6 +4904,147 @@ START_TEST (jot_resolve_logfmts_test) {
 }
 END_TEST
 
+static const char *resolve_on_meta_hint = NULL;
+
+static int resolve_on_meta_with_hint(pool *jot_pool, pr_jot_ctx_t *jot_ctx,
+    unsigned char logfmt_id, const char *jot_hint, const void *val) {
+  resolve_on_meta_count++;
+  if (jot_hint != NULL) {
+    resolve_on_meta_hint = jot_hint;
+  }
+
+  return 0;
+}
+
+START_TEST (jot_resolve_compiled_logfmt_test) {
+  register unsigned char i;
+  int res;
+  cmd_rec *cmd;
+  unsigned char logfmt[14];
+  pr_jot_compiled_t *compiled;
+  const char *key, *val;
+
+  mark_point();
+  compiled = pr_jot_compile_logfmt(NULL, NULL, 0);
+  ck_assert_msg(compiled == NULL, "Failed to handle null pool");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  mark_point();
+  compiled = pr_jot_compile_logfmt(p, NULL, 0);
+  ck_assert_msg(compiled == NULL, "Failed to handle null logfmt");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  cmd = pr_cmd_alloc(p, 1, pstrdup(p, "FOO"));
+  cmd->cmd_class = CL_CONNECT;
+
+  logfmt[0] = 'A';
+  logfmt[1] = '!';
+  logfmt[2] = LOGFMT_META_START;
+  logfmt[3] = LOGFMT_META_ENV_VAR;
+  logfmt[4] = LOGFMT_META_START;
+  logfmt[5] = LOGFMT_META_ARG;
+  logfmt[6] = 'k';
+  logfmt[7] = 'e';
+  logfmt[8] = 'y';
+  logfmt[9] = LOGFMT_META_ARG_END;
+  logfmt[10] = LOGFMT_META_START;
+  logfmt[11] = LOGFMT_META_CONNECT;
+  logfmt[12] = 'B';
+  logfmt[13] = 0;
+
+  mark_point();
+  compiled = pr_jot_compile_logfmt(p, logfmt, 0);
+  ck_assert_msg(compiled != NULL, "Failed to compile logfmt: %s",
+    strerror(errno));
+
+  mark_point();
+  res = pr_jot_resolve_compiled_logfmt(NULL, NULL, NULL, NULL, NULL, NULL,
+    NULL, NULL);
+  ck_assert_msg(res < 0, "Failed to handle null arguments");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  mark_point();
+  res = pr_jot_resolve_compiled_logfmt(p, cmd, NULL, NULL, NULL,
+    resolve_on_meta, NULL, NULL);
+  ck_assert_msg(res < 0, "Failed to handle null compiled logfmt");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  key = "key";
+  val = "val";
+  pr_env_set(p, key, val);
+
+  mark_point();
+  resolve_on_meta_count = resolve_on_default_count = resolve_on_other_count = 0;
+  resolve_on_meta_hint = NULL;
+  res = pr_jot_resolve_compiled_logfmt(p, cmd, NULL, compiled, NULL,
+    resolve_on_meta_with_hint, resolve_on_default, resolve_on_other);
+  ck_assert_msg(res == 0, "Failed to handle compiled logfmt: %s",
+    strerror(errno));
+  ck_assert_msg(resolve_on_meta_count == 2,
+    "Expected on_meta count 2, got %u", resolve_on_meta_count);
+  ck_assert_msg(resolve_on_default_count == 0,
+    "Expected on_default count 0, got %u", resolve_on_default_count);
+  ck_assert_msg(resolve_on_other_count == 2,
+    "Expected on_other count 2, got %u", resolve_on_other_count);
+  ck_assert_msg(resolve_on_meta_hint != NULL, "Expected ENV hint, got null");
+  ck_assert_msg(strcmp(resolve_on_meta_hint, "ENV:key") == 0,
+    "Expected 'ENV:key', got '%s'", resolve_on_meta_hint);
+
+  /* The uncompiled LogFormat should resolve the same way. */
+  mark_point();
+  resolve_on_meta_count = resolve_on_default_count = resolve_on_other_count = 0;
+  res = pr_jot_resolve_logfmt(p, cmd, NULL, logfmt, NULL,
+    resolve_on_meta, resolve_on_default, resolve_on_other);
+  ck_assert_msg(res == 0, "Failed to handle logfmt: %s", strerror(errno));
+  ck_assert_msg(resolve_on_meta_count == 2,
+    "Expected on_meta count 2, got %u", resolve_on_meta_count);
+  ck_assert_msg(resolve_on_other_count == 2,
+    "Expected on_other count 2, got %u", resolve_on_other_count);
+  pr_env_unset(p, key);
+
+  /* Filtered events */
+  mark_point();
+  cmd->cmd_class = CL_MISC;
+  res = pr_jot_resolve_compiled_logfmt(p, cmd,
+    pr_jot_filters_create(p, "NONE", PR_JOT_FILTER_TYPE_CLASSES, 0), compiled,
+    NULL, resolve_on_meta, resolve_on_default, resolve_on_other);
+  ck_assert_msg(res < 0, "Failed to handle filtered event");
+  ck_assert_msg(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  /* All of the known LogFormat IDs should resolve as they do uncompiled. */
+  cmd->cmd_class = 0;
+  logfmt[0] = LOGFMT_META_START;
+  logfmt[2] = 0;
+  resolve_on_meta_count = resolve_on_default_count = resolve_on_other_count = 0;
+
+  for (i = 1; i < 54; i++) {
+    logfmt[1] = i;
+
+    mark_point();
+    compiled = pr_jot_compile_logfmt(p, logfmt, 0);
+    ck_assert_msg(compiled != NULL, "Failed to compile logfmt_id %u: %s",
+      logfmt[1], strerror(errno));
+
+    res = pr_jot_resolve_compiled_logfmt(p, cmd, NULL, compiled, NULL,
+      resolve_on_meta, resolve_on_default, resolve_on_other);
+    ck_assert_msg(res == 0, "Failed to handle logfmt_id %u: %s", logfmt[1],
+      strerror(errno));
+  }
+
+  ck_assert_msg(resolve_on_meta_count == 20,
+    "Expected on_meta count 20, got %u", resolve_on_meta_count);
+  ck_assert_msg(resolve_on_default_count == 28,
+    "Expected on_default count 28, got %u", resolve_on_default_count);
+  ck_assert_msg(resolve_on_other_count == 0,
+    "Expected on_other count 0, got %u", resolve_on_other_count);
+}
+END_TEST
+
 static unsigned int scan_on_meta_count = 0;
 
 static int scan_on_meta(pool *jot_pool, pr_jot_ctx_t *jot_ctx,
@@ -5166,6 +5307,7 @@ Suite *tests_get_jot_suite(void) {
   tcase_add_test(testcase, jot_resolve_logfmt_disconnect_test);
   tcase_add_test(testcase, jot_resolve_logfmt_custom_test);
   tcase_add_test(testcase, jot_resolve_logfmts_test);
+  tcase_add_test(testcase, jot_resolve_compiled_logfmt_test);
 
   tcase_add_test(testcase, jot_scan_logfmt_test);
   tcase_add_test(testcase, jot_on_json_test);
@@ -0,0 +1,358 @@
+/*
+ * ProFTPD - FTP server testsuite
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* Buffered log writing API tests. */
+
+#include "tests.h"
+
+static pool *p = NULL;
+static const char *logbuf_path = "/tmp/prt-logbuf.log";
+static const char *logbuf_path2 = "/tmp/prt-logbuf2.log";
+
+/* Fixtures */
+
+static void set_up(void) {
+  if (p == NULL) {
+    p = permanent_pool = make_sub_pool(NULL);
+  }
+
+  (void) unlink(logbuf_path);
+  (void) unlink(logbuf_path2);
+
+  session.pid = getpid();
+
+  if (getenv("TEST_VERBOSE") != NULL) {
+    pr_trace_set_levels("log", 1, 20);
+  }
+}
+
+static void tear_down(void) {
+  (void) pr_log_set_buffering(FALSE);
+  session.pid = 0;
+
+  if (getenv("TEST_VERBOSE") != NULL) {
+    pr_trace_set_levels("log", 0, 0);
+  }
+
+  if (p) {
+    destroy_pool(p);
+    p = permanent_pool = NULL;
+  }
+
+  (void) unlink(logbuf_path);
+  (void) unlink(logbuf_path2);
+}
+
+static int open_log(const char *path) {
+  int fd;
+
+  fd = open(path, O_WRONLY|O_CREAT|O_APPEND, 0600);
+  ck_assert_msg(fd >= 0, "Failed to open '%s': %s", path, strerror(errno));
+  return fd;
+}
+
+static off_t get_size(const char *path) {
+  struct stat st;
+
+  if (stat(path, &st) < 0) {
+    return -1;
+  }
+
+  return st.st_size;
+}
+
+static char *get_text(const char *path) {
+  char buf[256];
+  int fd;
+  ssize_t len;
+
+  fd = open(path, O_RDONLY);
+  ck_assert_msg(fd >= 0, "Failed to open '%s': %s", path, strerror(errno));
+  len = read(fd, buf, sizeof(buf)-1);
+  (void) close(fd);
+
+  ck_assert_msg(len >= 0, "Failed to read '%s': %s", path, strerror(errno));
+  buf[len] = '\0';
+  return pstrdup(p, buf);
+}
+
+/* Tests */
+
+START_TEST (logbuf_writebuf_test) {
+  int fd, res;
+  const char *text;
+
+  res = pr_log_writebuf(-1, NULL, 0);
+  ck_assert_msg(res < 0, "Failed to handle bad fd");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  fd = open_log(logbuf_path);
+
+  res = pr_log_writebuf(fd, NULL, 0);
+  ck_assert_msg(res < 0, "Failed to handle null buffer");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_log_writebuf(fd, "foo\n", 0);
+  ck_assert_msg(res == 0, "Failed to handle empty buffer: %s",
+    strerror(errno));
+
+  /* Without buffering, the data are written immediately. */
+  res = pr_log_writebuf(fd, "foo\n", 4);
+  ck_assert_msg(res == 0, "Failed to write log data: %s", strerror(errno));
+  ck_assert_msg(get_size(logbuf_path) == 4, "Expected 4 bytes, got %ld",
+    (long) get_size(logbuf_path));
+
+  /* Nor does the daemon process buffer. */
+  (void) pr_log_set_buffering(TRUE);
+  session.pid = 0;
+
+  res = pr_log_writebuf(fd, "bar\n", 4);
+  ck_assert_msg(res == 0, "Failed to write log data: %s", strerror(errno));
+  ck_assert_msg(get_size(logbuf_path) == 8, "Expected 8 bytes, got %ld",
+    (long) get_size(logbuf_path));
+
+  (void) close(fd);
+
+  text = get_text(logbuf_path);
+  ck_assert_msg(strcmp(text, "foo\nbar\n") == 0, "Unexpected log text '%s'",
+    text);
+}
+END_TEST
+
+START_TEST (logbuf_flush_test) {
+  int fd, res;
+  const char *text;
+
+  res = pr_log_flush(-1);
+  ck_assert_msg(res == 0, "Failed to flush no buffers: %s", strerror(errno));
+
+  res = pr_log_set_buffering(TRUE);
+  ck_assert_msg(res == FALSE, "Expected buffering to be disabled");
+
+  fd = open_log(logbuf_path);
+
+  res = pr_log_writebuf(fd, "foo\n", 4);
+  ck_assert_msg(res == 0, "Failed to write log data: %s", strerror(errno));
+  res = pr_log_writebuf(fd, "bar\n", 4);
+  ck_assert_msg(res == 0, "Failed to write log data: %s", strerror(errno));
+  ck_assert_msg(get_size(logbuf_path) == 0, "Expected 0 bytes, got %ld",
+    (long) get_size(logbuf_path));
+
+  /* Flushing some other fd leaves our data buffered. */
+  res = pr_log_flush(fd + 1);
+  ck_assert_msg(res == 0, "Failed to flush other fd: %s", strerror(errno));
+  ck_assert_msg(get_size(logbuf_path) == 0, "Expected 0 bytes, got %ld",
+    (long) get_size(logbuf_path));
+
+  res = pr_log_flush(fd);
+  ck_assert_msg(res == 0, "Failed to flush fd %d: %s", fd, strerror(errno));
+  ck_assert_msg(get_size(logbuf_path) == 8, "Expected 8 bytes, got %ld",
+    (long) get_size(logbuf_path));
+
+  /* Disabling buffering writes out any buffered data. */
+  res = pr_log_writebuf(fd, "baz\n", 4);
+  ck_assert_msg(res == 0, "Failed to write log data: %s", strerror(errno));
+  ck_assert_msg(get_size(logbuf_path) == 8, "Expected 8 bytes, got %ld",
+    (long) get_size(logbuf_path));
+
+  res = pr_log_set_buffering(FALSE);
+  ck_assert_msg(res == TRUE, "Expected buffering to be enabled");
+  ck_assert_msg(get_size(logbuf_path) == 12, "Expected 12 bytes, got %ld",
+    (long) get_size(logbuf_path));
+
+  (void) close(fd);
+
+  text = get_text(logbuf_path);
+  ck_assert_msg(strcmp(text, "foo\nbar\nbaz\n") == 0,
+    "Unexpected log text '%s'", text);
+}
+END_TEST
+
+START_TEST (logbuf_large_test) {
+  int fd, res;
+  char *data;
+  size_t datalen;
+
+  (void) pr_log_set_buffering(TRUE);
+  fd = open_log(logbuf_path);
+
+  res = pr_log_writebuf(fd, "foo\n", 4);
+  ck_assert_msg(res == 0, "Failed to write log data: %s", strerror(errno));
+
+  /* Data larger than the buffer are written directly, after any buffered
+   * data.
+   */
+  datalen = PR_TUNABLE_LOG_BUFFER_SIZE + 1;
+  data = palloc(p, datalen);
+  memset(data, 'A', datalen);
+
+  res = pr_log_writebuf(fd, data, datalen);
+  ck_assert_msg(res == 0, "Failed to write log data: %s", strerror(errno));
+  ck_assert_msg(get_size(logbuf_path) == (off_t) (datalen + 4),
+    "Expected %lu bytes, got %ld", (unsigned long) (datalen + 4),
+    (long) get_size(logbuf_path));
+
+  (void) close(fd);
+}
+END_TEST
+
+START_TEST (logbuf_overflow_test) {
+  register unsigned int i;
+  int fd, res;
+  char *data, *expected, line[64];
+  size_t linelen, nlines, datalen;
+  ssize_t len;
+
+  (void) pr_log_set_buffering(TRUE);
+  fd = open_log(logbuf_path);
+
+  /* Enough small lines to overflow the buffer a few times over; none of
+   * them may be lost when the buffer is written out to make room.
+   */
+  linelen = 32;
+  nlines = ((PR_TUNABLE_LOG_BUFFER_SIZE / linelen) * 3) + 5;
+  datalen = nlines * linelen;
+  expected = palloc(p, datalen + 1);
+
+  for (i = 0; i < nlines; i++) {
+    pr_snprintf(line, sizeof(line), "line %026u\n", i);
+    memcpy(expected + (i * linelen), line, linelen);
+
+    res = pr_log_writebuf(fd, line, linelen);
+    ck_assert_msg(res == 0, "Failed to write line %u: %s", i,
+      strerror(errno));
+  }
+
+  ck_assert_msg(get_size(logbuf_path) < (off_t) datalen,
+    "Expected some of the %lu bytes to be buffered, got %ld",
+    (unsigned long) datalen, (long) get_size(logbuf_path));
+
+  res = pr_log_flush(fd);
+  ck_assert_msg(res == 0, "Failed to flush fd %d: %s", fd, strerror(errno));
+  (void) close(fd);
+
+  ck_assert_msg(get_size(logbuf_path) == (off_t) datalen,
+    "Expected %lu bytes, got %ld", (unsigned long) datalen,
+    (long) get_size(logbuf_path));
+
+  data = palloc(p, datalen + 1);
+  fd = open(logbuf_path, O_RDONLY);
+  ck_assert_msg(fd >= 0, "Failed to open '%s': %s", logbuf_path,
+    strerror(errno));
+  len = read(fd, data, datalen + 1);
+  (void) close(fd);
+
+  ck_assert_msg(len == (ssize_t) datalen, "Expected to read %lu bytes, got %ld",
+    (unsigned long) datalen, (long) len);
+  ck_assert_msg(memcmp(data, expected, datalen) == 0,
+    "Unexpected log text");
+}
+END_TEST
+
+START_TEST (logbuf_fd_reuse_test) {
+  int fd, fd2, res;
+  const char *text;
+
+  (void) pr_log_set_buffering(TRUE);
+
+  fd = open_log(logbuf_path);
+  res = pr_log_writebuf(fd, "foo\n", 4);
+  ck_assert_msg(res == 0, "Failed to write log data: %s", strerror(errno));
+  res = pr_log_flush(fd);
+  ck_assert_msg(res == 0, "Failed to flush fd %d: %s", fd, strerror(errno));
+  (void) close(fd);
+
+  /* The same fd, now for a different file, must not be treated as the old
+   * file's buffer.
+   */
+  fd2 = open_log(logbuf_path2);
+  ck_assert_msg(fd2 == fd, "Expected fd %d to be reused, got %d", fd, fd2);
+
+  res = pr_log_writebuf(fd2, "bar\n", 4);
+  ck_assert_msg(res == 0, "Failed to write log data: %s", strerror(errno));
+  res = pr_log_flush(fd2);
+  ck_assert_msg(res == 0, "Failed to flush fd %d: %s", fd2, strerror(errno));
+  (void) close(fd2);
+
+  text = get_text(logbuf_path);
+  ck_assert_msg(strcmp(text, "foo\n") == 0, "Unexpected log text '%s'", text);
+  text = get_text(logbuf_path2);
+  ck_assert_msg(strcmp(text, "bar\n") == 0, "Unexpected log text '%s'", text);
+}
+END_TEST
+
+START_TEST (logbuf_closed_fd_test) {
+  int fd, res;
+
+  (void) pr_log_set_buffering(TRUE);
+
+  /* Data buffered for an fd closed without flushing cannot be written, and
+   * must not be written to whichever file next uses that fd.
+   */
+  fd = open_log(logbuf_path);
+  res = pr_log_writebuf(fd, "foo\n", 4);
+  ck_assert_msg(res == 0, "Failed to write log data: %s", strerror(errno));
+  (void) close(fd);
+
+  fd = open_log(logbuf_path2);
+  res = pr_log_flush(fd);
+  ck_assert_msg(res < 0, "Failed to handle closed fd");
+  ck_assert_msg(errno == EBADF, "Expected EBADF (%d), got %s (%d)", EBADF,
+    strerror(errno), errno);
+  ck_assert_msg(get_size(logbuf_path2) == 0, "Expected 0 bytes, got %ld",
+    (long) get_size(logbuf_path2));
+
+  /* The fd's buffer is usable again afterwards. */
+  res = pr_log_writebuf(fd, "bar\n", 4);
+  ck_assert_msg(res == 0, "Failed to write log data: %s", strerror(errno));
+  res = pr_log_flush(fd);
+  ck_assert_msg(res == 0, "Failed to flush fd %d: %s", fd, strerror(errno));
+  ck_assert_msg(get_size(logbuf_path2) == 4, "Expected 4 bytes, got %ld",
+    (long) get_size(logbuf_path2));
+
+  (void) close(fd);
+}
+END_TEST
+
+Suite *tests_get_logbuf_suite(void) {
+  Suite *suite;
+  TCase *testcase;
+
+  suite = suite_create("logbuf");
+
+  testcase = tcase_create("base");
+  tcase_add_checked_fixture(testcase, set_up, tear_down);
+
+  tcase_add_test(testcase, logbuf_writebuf_test);
+  tcase_add_test(testcase, logbuf_flush_test);
+  tcase_add_test(testcase, logbuf_large_test);
+  tcase_add_test(testcase, logbuf_overflow_test);
+  tcase_add_test(testcase, logbuf_fd_reuse_test);
+  tcase_add_test(testcase, logbuf_closed_fd_test);
+
+  suite_add_tcase(suite, testcase);
+  return suite;
+}
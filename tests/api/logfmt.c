@@ -0,0 +1,686 @@
+/*
+ * ProFTPD - FTP server testsuite
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* Binary LogFormat API tests. */
+
+#include "tests.h"
+#include "logfmt.h"
+
+static pr_logfmt_record_t *rec = NULL;
+
+/* Fixtures */
+
+static void set_up(void) {
+  rec = calloc(1, sizeof(pr_logfmt_record_t));
+}
+
+static void tear_down(void) {
+  free(rec);
+  rec = NULL;
+}
+
+/* Encodes a record as mod_log does, leaving room for the length in front,
+ * and returns the framed record.
+ */
+static char *encode_record(char *buf, size_t bufsz, uint64_t usecs,
+    const char *method, size_t *framelen) {
+  char *ptr, *frame;
+  size_t buflen;
+  int res;
+
+  ptr = buf + LOGFMT_BIN_LEN_RESERVE;
+  buflen = bufsz - LOGFMT_BIN_LEN_RESERVE;
+
+  res = pr_logfmt_bin_append_varint(&ptr, &buflen, usecs);
+  ck_assert_msg(res == 0, "Failed to append timestamp: %s", strerror(errno));
+
+  if (method != NULL) {
+    res = pr_logfmt_bin_append_key(&ptr, &buflen, LOGFMT_META_METHOD,
+      LOGFMT_BIN_WIRE_STRING);
+    ck_assert_msg(res == 0, "Failed to append key: %s", strerror(errno));
+
+    res = pr_logfmt_bin_append_string(&ptr, &buflen, method, strlen(method));
+    ck_assert_msg(res == 0, "Failed to append method: %s", strerror(errno));
+  }
+
+  frame = pr_logfmt_bin_frame_record(buf + LOGFMT_BIN_LEN_RESERVE,
+    ptr - (buf + LOGFMT_BIN_LEN_RESERVE), framelen);
+  ck_assert_msg(frame != NULL, "Failed to frame record: %s", strerror(errno));
+
+  return frame;
+}
+
+static FILE *open_log(const char *data, size_t datalen) {
+  FILE *fp;
+
+  fp = tmpfile();
+  ck_assert_msg(fp != NULL, "Failed to open temporary file: %s",
+    strerror(errno));
+
+  if (datalen > 0) {
+    ck_assert_msg(fwrite(data, 1, datalen, fp) == datalen,
+      "Failed to write temporary file: %s", strerror(errno));
+  }
+
+  rewind(fp);
+  return fp;
+}
+
+static char *read_output(FILE *fp, char *text, size_t textsz) {
+  size_t len;
+
+  rewind(fp);
+  len = fread(text, 1, textsz - 1, fp);
+  text[len] = '\0';
+  return text;
+}
+
+/* Tests */
+
+START_TEST (logfmt_bin_varint_test) {
+  register unsigned int i;
+  int res;
+  char buf[32], *ptr;
+  const unsigned char *data;
+  size_t buflen, datalen;
+  uint64_t num;
+  const struct {
+    uint64_t num;
+    size_t len;
+  } varints[] = {
+    { 0, 1 },
+    { 127, 1 },
+    { 128, 2 },
+    { 16383, 2 },
+    { 16384, 3 },
+    { ((uint64_t) 1) << 32, 5 },
+    { UINT64_MAX, 10 },
+    { 0, 0 }
+  };
+
+  res = pr_logfmt_bin_append_varint(NULL, NULL, 0);
+  ck_assert_msg(res < 0, "Failed to handle null buffer");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  for (i = 0; varints[i].len > 0; i++) {
+    ptr = buf;
+    buflen = sizeof(buf);
+
+    res = pr_logfmt_bin_append_varint(&ptr, &buflen, varints[i].num);
+    ck_assert_msg(res == 0, "Failed to append varint %llu: %s",
+      (unsigned long long) varints[i].num, strerror(errno));
+    ck_assert_msg((size_t) (ptr - buf) == varints[i].len,
+      "Expected %lu bytes for %llu, got %lu", (unsigned long) varints[i].len,
+      (unsigned long long) varints[i].num, (unsigned long) (ptr - buf));
+    ck_assert_msg(buflen == sizeof(buf) - varints[i].len,
+      "Expected %lu bytes remaining, got %lu",
+      (unsigned long) (sizeof(buf) - varints[i].len), (unsigned long) buflen);
+
+    data = (const unsigned char *) buf;
+    datalen = ptr - buf;
+
+    res = pr_logfmt_bin_decode_varint(&data, &datalen, &num);
+    ck_assert_msg(res == 0, "Failed to decode varint %llu: %s",
+      (unsigned long long) varints[i].num, strerror(errno));
+    ck_assert_msg(num == varints[i].num, "Expected %llu, got %llu",
+      (unsigned long long) varints[i].num, (unsigned long long) num);
+    ck_assert_msg(datalen == 0, "Expected all data consumed, got %lu left",
+      (unsigned long) datalen);
+
+    /* Without room for the whole varint, nothing is appended. */
+    ptr = buf;
+    buflen = varints[i].len - 1;
+
+    res = pr_logfmt_bin_append_varint(&ptr, &buflen, varints[i].num);
+    ck_assert_msg(res < 0, "Failed to handle full buffer for %llu",
+      (unsigned long long) varints[i].num);
+    ck_assert_msg(errno == ENOSPC, "Expected ENOSPC (%d), got %s (%d)",
+      ENOSPC, strerror(errno), errno);
+    ck_assert_msg(ptr == buf, "Expected buffer unchanged");
+    ck_assert_msg(buflen == varints[i].len - 1, "Expected length unchanged");
+  }
+
+  /* Truncated varint */
+  buf[0] = (char) 0x80;
+  data = (const unsigned char *) buf;
+  datalen = 1;
+
+  res = pr_logfmt_bin_decode_varint(&data, &datalen, &num);
+  ck_assert_msg(res < 0, "Failed to handle truncated varint");
+  ck_assert_msg(errno == EBADMSG, "Expected EBADMSG (%d), got %s (%d)",
+    EBADMSG, strerror(errno), errno);
+
+  /* Overlong varint */
+  memset(buf, 0xff, 11);
+  buf[11] = 0x01;
+  data = (const unsigned char *) buf;
+  datalen = 12;
+
+  res = pr_logfmt_bin_decode_varint(&data, &datalen, &num);
+  ck_assert_msg(res < 0, "Failed to handle overlong varint");
+  ck_assert_msg(errno == EBADMSG, "Expected EBADMSG (%d), got %s (%d)",
+    EBADMSG, strerror(errno), errno);
+}
+END_TEST
+
+START_TEST (logfmt_bin_number_test) {
+  int res;
+  char buf[64], *ptr;
+  size_t buflen;
+  const pr_logfmt_field_t *field;
+
+  ptr = buf;
+  buflen = sizeof(buf);
+
+  res = pr_logfmt_bin_append_varint(&ptr, &buflen, 1);
+  ck_assert_msg(res == 0, "Failed to append timestamp: %s", strerror(errno));
+
+  res = pr_logfmt_bin_append_number(&ptr, &buflen, LOGFMT_META_BYTES_SENT,
+    4294967296.0);
+  ck_assert_msg(res == 0, "Failed to append number: %s", strerror(errno));
+
+  res = pr_logfmt_bin_append_number(&ptr, &buflen, LOGFMT_META_SECONDS, 1.5);
+  ck_assert_msg(res == 0, "Failed to append number: %s", strerror(errno));
+
+  res = pr_logfmt_bin_append_number(&ptr, &buflen, LOGFMT_META_UID, -3.0);
+  ck_assert_msg(res == 0, "Failed to append number: %s", strerror(errno));
+
+  res = pr_logfmt_bin_decode_record((unsigned char *) buf, ptr - buf, rec);
+  ck_assert_msg(res == 0, "Failed to decode record: %s", strerror(errno));
+  ck_assert_msg(rec->nfields == 3, "Expected 3 fields, got %u",
+    rec->nfields);
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_BYTES_SENT);
+  ck_assert_msg(field != NULL, "Failed to get BYTES_SENT field");
+  ck_assert_msg(field->wire_type == LOGFMT_BIN_WIRE_VARINT,
+    "Expected VARINT wire type, got %u", field->wire_type);
+  ck_assert_msg(field->num == ((uint64_t) 1) << 32, "Expected %llu, got %llu",
+    (unsigned long long) ((uint64_t) 1) << 32,
+    (unsigned long long) field->num);
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_SECONDS);
+  ck_assert_msg(field != NULL, "Failed to get SECONDS field");
+  ck_assert_msg(field->wire_type == LOGFMT_BIN_WIRE_DOUBLE,
+    "Expected DOUBLE wire type, got %u", field->wire_type);
+  ck_assert_msg(field->dbl == 1.5, "Expected 1.5, got %f", field->dbl);
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_UID);
+  ck_assert_msg(field != NULL, "Failed to get UID field");
+  ck_assert_msg(field->wire_type == LOGFMT_BIN_WIRE_DOUBLE,
+    "Expected DOUBLE wire type, got %u", field->wire_type);
+  ck_assert_msg(field->dbl == -3.0, "Expected -3.0, got %f", field->dbl);
+
+  /* A number which does not fit leaves no partial field behind. */
+  ptr = buf;
+  buflen = 3;
+
+  res = pr_logfmt_bin_append_number(&ptr, &buflen, LOGFMT_META_SECONDS, 1.5);
+  ck_assert_msg(res < 0, "Failed to handle full buffer");
+  ck_assert_msg(errno == ENOSPC, "Expected ENOSPC (%d), got %s (%d)", ENOSPC,
+    strerror(errno), errno);
+  ck_assert_msg(ptr == buf, "Expected buffer unchanged");
+  ck_assert_msg(buflen == 3, "Expected length unchanged, got %lu",
+    (unsigned long) buflen);
+}
+END_TEST
+
+START_TEST (logfmt_bin_string_test) {
+  int res;
+  char buf[64], *ptr;
+  size_t buflen;
+  const pr_logfmt_field_t *field;
+
+  ptr = buf;
+  buflen = sizeof(buf);
+
+  res = pr_logfmt_bin_append_string(&ptr, &buflen, NULL, 1);
+  ck_assert_msg(res < 0, "Failed to handle null text");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  (void) pr_logfmt_bin_append_varint(&ptr, &buflen, 1);
+
+  (void) pr_logfmt_bin_append_key(&ptr, &buflen, LOGFMT_META_USER,
+    LOGFMT_BIN_WIRE_STRING);
+  res = pr_logfmt_bin_append_string(&ptr, &buflen, "ftp", 3);
+  ck_assert_msg(res == 0, "Failed to append string: %s", strerror(errno));
+
+  (void) pr_logfmt_bin_append_key(&ptr, &buflen, LOGFMT_META_ENV_VAR,
+    LOGFMT_BIN_WIRE_NAMED_STRING);
+  (void) pr_logfmt_bin_append_string(&ptr, &buflen, "ENV:HOME", 8);
+  res = pr_logfmt_bin_append_string(&ptr, &buflen, "/home/ftp", 9);
+  ck_assert_msg(res == 0, "Failed to append string: %s", strerror(errno));
+
+  (void) pr_logfmt_bin_append_key(&ptr, &buflen, LOGFMT_META_CMD_PARAMS,
+    LOGFMT_BIN_WIRE_STRING);
+  res = pr_logfmt_bin_append_string(&ptr, &buflen, "", 0);
+  ck_assert_msg(res == 0, "Failed to append empty string: %s",
+    strerror(errno));
+
+  res = pr_logfmt_bin_decode_record((unsigned char *) buf, ptr - buf, rec);
+  ck_assert_msg(res == 0, "Failed to decode record: %s", strerror(errno));
+  ck_assert_msg(rec->nfields == 3, "Expected 3 fields, got %u",
+    rec->nfields);
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_USER);
+  ck_assert_msg(field != NULL, "Failed to get USER field");
+  ck_assert_msg(field->name == NULL, "Expected no name");
+  ck_assert_msg(field->textlen == 3 &&
+    strncmp(field->text, "ftp", 3) == 0, "Expected 'ftp', got '%.*s'",
+    (int) field->textlen, field->text);
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_ENV_VAR);
+  ck_assert_msg(field != NULL, "Failed to get ENV_VAR field");
+  ck_assert_msg(field->namelen == 8 &&
+    strncmp(field->name, "ENV:HOME", 8) == 0,
+    "Expected 'ENV:HOME', got '%.*s'", (int) field->namelen, field->name);
+  ck_assert_msg(field->textlen == 9 &&
+    strncmp(field->text, "/home/ftp", 9) == 0,
+    "Expected '/home/ftp', got '%.*s'", (int) field->textlen, field->text);
+
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_CMD_PARAMS);
+  ck_assert_msg(field != NULL, "Failed to get CMD_PARAMS field");
+  ck_assert_msg(field->textlen == 0, "Expected empty string, got %lu bytes",
+    (unsigned long) field->textlen);
+
+  /* A string which does not fit leaves no partial length behind. */
+  ptr = buf;
+  buflen = 4;
+
+  res = pr_logfmt_bin_append_string(&ptr, &buflen, "ftp", 4);
+  ck_assert_msg(res < 0, "Failed to handle full buffer");
+  ck_assert_msg(errno == ENOSPC, "Expected ENOSPC (%d), got %s (%d)", ENOSPC,
+    strerror(errno), errno);
+  ck_assert_msg(ptr == buf, "Expected buffer unchanged");
+  ck_assert_msg(buflen == 4, "Expected length unchanged, got %lu",
+    (unsigned long) buflen);
+}
+END_TEST
+
+START_TEST (logfmt_bin_frame_record_test) {
+  char *buf, *frame;
+  const unsigned char *data;
+  size_t framelen, datalen;
+  uint64_t num;
+
+  frame = pr_logfmt_bin_frame_record(NULL, 0, NULL);
+  ck_assert_msg(frame == NULL, "Failed to handle null arguments");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  buf = calloc(1, LOGFMT_BIN_MAX_RECORD_SIZE + LOGFMT_BIN_LEN_RESERVE + 1);
+
+  frame = pr_logfmt_bin_frame_record(buf + LOGFMT_BIN_LEN_RESERVE, 0,
+    &framelen);
+  ck_assert_msg(frame == NULL, "Failed to handle empty record");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  frame = pr_logfmt_bin_frame_record(buf + LOGFMT_BIN_LEN_RESERVE,
+    LOGFMT_BIN_MAX_RECORD_SIZE + 1, &framelen);
+  ck_assert_msg(frame == NULL, "Failed to handle oversized record");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  /* The length is right-aligned against the record. */
+  frame = pr_logfmt_bin_frame_record(buf + LOGFMT_BIN_LEN_RESERVE, 127,
+    &framelen);
+  ck_assert_msg(frame == buf + 2, "Expected 1-byte length");
+  ck_assert_msg(framelen == 128, "Expected frame length 128, got %lu",
+    (unsigned long) framelen);
+
+  frame = pr_logfmt_bin_frame_record(buf + LOGFMT_BIN_LEN_RESERVE, 128,
+    &framelen);
+  ck_assert_msg(frame == buf + 1, "Expected 2-byte length");
+
+  frame = pr_logfmt_bin_frame_record(buf + LOGFMT_BIN_LEN_RESERVE,
+    LOGFMT_BIN_MAX_RECORD_SIZE, &framelen);
+  ck_assert_msg(frame == buf, "Expected 3-byte length");
+  ck_assert_msg(framelen == LOGFMT_BIN_MAX_RECORD_SIZE + 3,
+    "Expected frame length %lu, got %lu",
+    (unsigned long) LOGFMT_BIN_MAX_RECORD_SIZE + 3, (unsigned long) framelen);
+
+  data = (const unsigned char *) frame;
+  datalen = framelen;
+  (void) pr_logfmt_bin_decode_varint(&data, &datalen, &num);
+  ck_assert_msg(num == LOGFMT_BIN_MAX_RECORD_SIZE, "Expected %lu, got %llu",
+    (unsigned long) LOGFMT_BIN_MAX_RECORD_SIZE, (unsigned long long) num);
+  ck_assert_msg(data == (unsigned char *) buf + LOGFMT_BIN_LEN_RESERVE,
+    "Expected record to follow its length");
+
+  free(buf);
+}
+END_TEST
+
+START_TEST (logfmt_bin_read_record_test) {
+  int res;
+  char buf[64], hdr[LOGFMT_BIN_MAGIC_LEN + 1], log[256], *ptr, *frame;
+  size_t buflen, framelen, loglen = 0;
+  pr_logfmt_reader_t reader;
+  const pr_logfmt_field_t *field;
+  FILE *fp;
+
+  res = pr_logfmt_bin_read_record(NULL, NULL);
+  ck_assert_msg(res < 0, "Failed to handle null reader");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  ptr = hdr;
+  buflen = sizeof(hdr);
+  res = pr_logfmt_bin_append_header(&ptr, &buflen);
+  ck_assert_msg(res == 0, "Failed to append header: %s", strerror(errno));
+
+  /* Header, two records, a repeated header (as when logs are concatenated),
+   * and a third record.
+   */
+  memcpy(log + loglen, hdr, sizeof(hdr));
+  loglen += sizeof(hdr);
+
+  frame = encode_record(buf, sizeof(buf), 1000001, C_RETR, &framelen);
+  memcpy(log + loglen, frame, framelen);
+  loglen += framelen;
+
+  frame = encode_record(buf, sizeof(buf), 1000002, C_STOR, &framelen);
+  memcpy(log + loglen, frame, framelen);
+  loglen += framelen;
+
+  memcpy(log + loglen, hdr, sizeof(hdr));
+  loglen += sizeof(hdr);
+
+  frame = encode_record(buf, sizeof(buf), 1000003, NULL, &framelen);
+  memcpy(log + loglen, frame, framelen);
+  loglen += framelen;
+
+  fp = open_log(log, loglen);
+  memset(&reader, 0, sizeof(reader));
+  reader.fp = fp;
+
+  res = pr_logfmt_bin_read_record(&reader, rec);
+  ck_assert_msg(res == 1, "Failed to read first record: %s", strerror(errno));
+  ck_assert_msg(rec->usecs == 1000001, "Expected usecs 1000001, got %llu",
+    (unsigned long long) rec->usecs);
+  field = pr_logfmt_bin_get_field(rec, LOGFMT_META_METHOD);
+  ck_assert_msg(field != NULL && field->textlen == 4 &&
+    strncmp(field->text, C_RETR, 4) == 0, "Expected RETR method");
+
+  res = pr_logfmt_bin_read_record(&reader, rec);
+  ck_assert_msg(res == 1, "Failed to read second record: %s",
+    strerror(errno));
+  ck_assert_msg(rec->usecs == 1000002, "Expected usecs 1000002, got %llu",
+    (unsigned long long) rec->usecs);
+
+  res = pr_logfmt_bin_read_record(&reader, rec);
+  ck_assert_msg(res == 1, "Failed to read third record: %s", strerror(errno));
+  ck_assert_msg(rec->usecs == 1000003, "Expected usecs 1000003, got %llu",
+    (unsigned long long) rec->usecs);
+  ck_assert_msg(rec->nfields == 0, "Expected no fields, got %u",
+    rec->nfields);
+
+  res = pr_logfmt_bin_read_record(&reader, rec);
+  ck_assert_msg(res == 0, "Expected EOF, got %d", res);
+
+  pr_logfmt_bin_reader_free(&reader);
+  fclose(fp);
+
+  /* Not a binary log */
+  fp = open_log("hello\n", 6);
+  memset(&reader, 0, sizeof(reader));
+  reader.fp = fp;
+
+  res = pr_logfmt_bin_read_record(&reader, rec);
+  ck_assert_msg(res < 0, "Failed to handle text file");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+  fclose(fp);
+
+  /* Newer format version */
+  hdr[LOGFMT_BIN_MAGIC_LEN] = LOGFMT_BIN_VERSION + 1;
+  fp = open_log(hdr, sizeof(hdr));
+  memset(&reader, 0, sizeof(reader));
+  reader.fp = fp;
+
+  res = pr_logfmt_bin_read_record(&reader, rec);
+  ck_assert_msg(res < 0, "Failed to handle newer version");
+  ck_assert_msg(errno == ENOTSUP, "Expected ENOTSUP (%d), got %s (%d)",
+    ENOTSUP, strerror(errno), errno);
+  ck_assert_msg(reader.version == LOGFMT_BIN_VERSION + 1,
+    "Expected version %u, got %u", LOGFMT_BIN_VERSION + 1, reader.version);
+  fclose(fp);
+}
+END_TEST
+
+START_TEST (logfmt_bin_truncated_record_test) {
+  register unsigned int i;
+  int res;
+  char buf[64], log[256], *frame;
+  size_t framelen, loglen, reclen;
+  pr_logfmt_reader_t reader;
+  FILE *fp;
+
+  frame = encode_record(buf, sizeof(buf), 1000001, C_RETR, &framelen);
+
+  /* Every truncation of the record data is rejected, except for the one
+   * which ends right after the (3-byte) timestamp, which leaves a valid
+   * record without fields.
+   */
+  reclen = framelen - 1;
+  for (i = 0; i < reclen; i++) {
+    res = pr_logfmt_bin_decode_record((unsigned char *) frame + 1, i, rec);
+    if (i == 3) {
+      ck_assert_msg(res == 0, "Failed to decode timestamp-only record: %s",
+        strerror(errno));
+      ck_assert_msg(rec->nfields == 0, "Expected no fields, got %u",
+        rec->nfields);
+      continue;
+    }
+
+    ck_assert_msg(res < 0, "Failed to handle record truncated to %u bytes",
+      i);
+    ck_assert_msg(errno == EBADMSG, "Expected EBADMSG (%d), got %s (%d)",
+      EBADMSG, strerror(errno), errno);
+  }
+
+  res = pr_logfmt_bin_decode_record((unsigned char *) frame + 1, reclen, rec);
+  ck_assert_msg(res == 0, "Failed to decode record: %s", strerror(errno));
+  ck_assert_msg(rec->nfields == 1, "Expected 1 field, got %u", rec->nfields);
+
+  /* A last record which is still being written */
+  loglen = 0;
+  memcpy(log, LOGFMT_BIN_MAGIC, LOGFMT_BIN_MAGIC_LEN);
+  log[LOGFMT_BIN_MAGIC_LEN] = LOGFMT_BIN_VERSION;
+  loglen += LOGFMT_BIN_MAGIC_LEN + 1;
+
+  memcpy(log + loglen, frame, framelen);
+  loglen += framelen;
+  memcpy(log + loglen, frame, framelen - 2);
+  loglen += framelen - 2;
+
+  fp = open_log(log, loglen);
+  memset(&reader, 0, sizeof(reader));
+  reader.fp = fp;
+
+  res = pr_logfmt_bin_read_record(&reader, rec);
+  ck_assert_msg(res == 1, "Failed to read complete record: %s",
+    strerror(errno));
+
+  res = pr_logfmt_bin_read_record(&reader, rec);
+  ck_assert_msg(res < 0, "Failed to handle truncated record");
+  ck_assert_msg(errno == EIO, "Expected EIO (%d), got %s (%d)", EIO,
+    strerror(errno), errno);
+
+  pr_logfmt_bin_reader_free(&reader);
+  fclose(fp);
+
+  /* A malformed record can be skipped. */
+  loglen = LOGFMT_BIN_MAGIC_LEN + 1;
+  log[loglen++] = 2;
+  log[loglen++] = 1;
+  log[loglen++] = (char) ((LOGFMT_META_USER << 3)|0x07);
+  memcpy(log + loglen, frame, framelen);
+  loglen += framelen;
+
+  fp = open_log(log, loglen);
+  memset(&reader, 0, sizeof(reader));
+  reader.fp = fp;
+
+  res = pr_logfmt_bin_read_record(&reader, rec);
+  ck_assert_msg(res < 0, "Failed to handle unknown wire type");
+  ck_assert_msg(errno == EBADMSG, "Expected EBADMSG (%d), got %s (%d)",
+    EBADMSG, strerror(errno), errno);
+
+  res = pr_logfmt_bin_read_record(&reader, rec);
+  ck_assert_msg(res == 1, "Failed to read record after malformed one: %s",
+    strerror(errno));
+  ck_assert_msg(rec->usecs == 1000001, "Expected usecs 1000001, got %llu",
+    (unsigned long long) rec->usecs);
+
+  pr_logfmt_bin_reader_free(&reader);
+  fclose(fp);
+
+  /* A corrupted record length */
+  loglen = LOGFMT_BIN_MAGIC_LEN + 1;
+  memset(log + loglen, 0xff, 11);
+  loglen += 11;
+
+  fp = open_log(log, loglen);
+  memset(&reader, 0, sizeof(reader));
+  reader.fp = fp;
+
+  res = pr_logfmt_bin_read_record(&reader, rec);
+  ck_assert_msg(res < 0, "Failed to handle corrupted length");
+  ck_assert_msg(errno == E2BIG, "Expected E2BIG (%d), got %s (%d)", E2BIG,
+    strerror(errno), errno);
+
+  pr_logfmt_bin_reader_free(&reader);
+  fclose(fp);
+}
+END_TEST
+
+START_TEST (logfmt_bin_write_json_test) {
+  int res;
+  char buf[64], text[256], *ptr;
+  size_t buflen;
+  FILE *fp;
+
+  res = pr_logfmt_bin_write_json(NULL, NULL);
+  ck_assert_msg(res < 0, "Failed to handle null arguments");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  ptr = buf;
+  buflen = sizeof(buf);
+  (void) pr_logfmt_bin_append_varint(&ptr, &buflen, 42);
+  (void) pr_logfmt_bin_append_key(&ptr, &buflen, LOGFMT_META_USER,
+    LOGFMT_BIN_WIRE_STRING);
+  (void) pr_logfmt_bin_append_string(&ptr, &buflen, "a\"b", 3);
+  (void) pr_logfmt_bin_append_number(&ptr, &buflen, LOGFMT_META_PID, 7);
+  (void) pr_logfmt_bin_append_key(&ptr, &buflen, LOGFMT_META_CONNECT,
+    LOGFMT_BIN_WIRE_VARINT);
+  (void) pr_logfmt_bin_append_varint(&ptr, &buflen, 1);
+
+  res = pr_logfmt_bin_decode_record((unsigned char *) buf, ptr - buf, rec);
+  ck_assert_msg(res == 0, "Failed to decode record: %s", strerror(errno));
+
+  fp = open_log(NULL, 0);
+  res = pr_logfmt_bin_write_json(fp, rec);
+  ck_assert_msg(res == 0, "Failed to write JSON: %s", strerror(errno));
+
+  read_output(fp, text, sizeof(text));
+  ck_assert_msg(strcmp(text, "{\"record_usecs\":42,\"user\":\"a\\\"b\","
+    "\"pid\":7,\"connecting\":true}\n") == 0, "Unexpected JSON: %s", text);
+  fclose(fp);
+}
+END_TEST
+
+START_TEST (logfmt_bin_write_xferlog_test) {
+  int res;
+  char buf[64], text[256], *ptr;
+  size_t buflen;
+  FILE *fp;
+
+  res = pr_logfmt_bin_write_xferlog(NULL, NULL);
+  ck_assert_msg(res < 0, "Failed to handle null arguments");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  fp = open_log(NULL, 0);
+
+  /* Records without a method are not transfers. */
+  ptr = buf;
+  buflen = sizeof(buf);
+  (void) pr_logfmt_bin_append_varint(&ptr, &buflen, 42);
+  (void) pr_logfmt_bin_decode_record((unsigned char *) buf, ptr - buf, rec);
+
+  ck_assert_msg(pr_logfmt_bin_get_field(rec, LOGFMT_META_METHOD) == NULL,
+    "Expected no METHOD field");
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  res = pr_logfmt_bin_write_xferlog(fp, rec);
+  ck_assert_msg(res < 0, "Failed to handle record without method");
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  /* Only the method: every other field gets its TransferLog default. */
+  (void) pr_logfmt_bin_append_key(&ptr, &buflen, LOGFMT_META_METHOD,
+    LOGFMT_BIN_WIRE_STRING);
+  (void) pr_logfmt_bin_append_string(&ptr, &buflen, C_RETR, 4);
+  (void) pr_logfmt_bin_decode_record((unsigned char *) buf, ptr - buf, rec);
+
+  res = pr_logfmt_bin_write_xferlog(fp, rec);
+  ck_assert_msg(res == 0, "Failed to write xferlog: %s", strerror(errno));
+
+  /* Skip the timestamp, which depends on the local timezone. */
+  read_output(fp, text, sizeof(text));
+  ptr = strstr(text, " 0 - 0 - ");
+  ck_assert_msg(ptr != NULL, "Unexpected xferlog line: %s", text);
+  ck_assert_msg(strcmp(ptr, " 0 - 0 - b _ o r - ftp 0 * c\n") == 0,
+    "Unexpected xferlog fields: %s", ptr);
+
+  fclose(fp);
+}
+END_TEST
+
+Suite *tests_get_logfmt_suite(void) {
+  Suite *suite;
+  TCase *testcase;
+
+  suite = suite_create("logfmt");
+
+  testcase = tcase_create("base");
+  tcase_add_checked_fixture(testcase, set_up, tear_down);
+
+  tcase_add_test(testcase, logfmt_bin_varint_test);
+  tcase_add_test(testcase, logfmt_bin_number_test);
+  tcase_add_test(testcase, logfmt_bin_string_test);
+  tcase_add_test(testcase, logfmt_bin_frame_record_test);
+  tcase_add_test(testcase, logfmt_bin_read_record_test);
+  tcase_add_test(testcase, logfmt_bin_truncated_record_test);
+  tcase_add_test(testcase, logfmt_bin_write_json_test);
+  tcase_add_test(testcase, logfmt_bin_write_xferlog_test);
+
+  suite_add_tcase(suite, testcase);
+  return suite;
+}
@@ -1256,6 +1256,27 @@ START_TEST (gettimeofday_millis_test) {
 }
 END_TEST
 
+START_TEST (gettimeofday_micros_test) {
+  int res;
+  uint64_t ms, us;
+
+  res = pr_gettimeofday_micros(NULL);
+  ck_assert_msg(res < 0, "Failed to handle null argument");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  ms = us = 0;
+  res = pr_gettimeofday_millis(&ms);
+  ck_assert_msg(res == 0, "Failed to get current time ms: %s", strerror(errno));
+
+  res = pr_gettimeofday_micros(&us);
+  ck_assert_msg(res == 0, "Failed to get current time usecs: %s",
+    strerror(errno));
+  ck_assert_msg(us / 1000 >= ms, "Expected >= %lu ms, got %lu us",
+    (unsigned long) ms, (unsigned long) us);
+}
+END_TEST
+
 START_TEST (snprintf_test) {
   char *buf;
   size_t bufsz;
@@ -1484,6 +1505,7 @@ Suite *tests_get_misc_suite(void) {
   tcase_add_test(testcase, strtime3_test);
   tcase_add_test(testcase, timeval2millis_test);
   tcase_add_test(testcase, gettimeofday_millis_test);
+  tcase_add_test(testcase, gettimeofday_micros_test);
   tcase_add_test(testcase, snprintf_test);
   tcase_add_test(testcase, snprintfl_test);
   tcase_add_test(testcase, path_subst_uservar_test);
@@ -0,0 +1,322 @@
+/*
+ * ProFTPD - FTP server testsuite
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* mod_auth_file tests */
+
+#include "tests.h"
+
+extern module auth_file_module;
+extern xaset_t *server_list;
+
+static pool *p = NULL;
+static const char *user_path = "/tmp/prt-mod_auth_file.passwd";
+static const char *group_path = "/tmp/prt-mod_auth_file.group";
+
+/* Fixtures */
+
+static void set_up(void) {
+  if (p == NULL) {
+    p = permanent_pool = make_sub_pool(NULL);
+  }
+
+  (void) unlink(user_path);
+  (void) unlink(group_path);
+
+  init_fs();
+  init_stash();
+  init_auth();
+  (void) pr_auth_cache_set(FALSE, PR_AUTH_CACHE_FL_DEFAULT);
+
+  server_list = xaset_create(p, NULL);
+  pr_parser_prepare(p, NULL);
+  tests_stubs_set_main_server(pr_parser_server_ctxt_open("127.0.0.1"));
+
+  if (getenv("TEST_VERBOSE") != NULL) {
+    pr_trace_set_levels("auth.file", 1, 20);
+  }
+}
+
+static void tear_down(void) {
+  pr_event_generate("core.restart", NULL);
+  (void) pr_module_unload(&auth_file_module);
+
+  if (getenv("TEST_VERBOSE") != NULL) {
+    pr_trace_set_levels("auth.file", 0, 0);
+  }
+
+  (void) pr_parser_server_ctxt_close();
+  tests_stubs_set_main_server(NULL);
+  server_list = NULL;
+
+  if (p != NULL) {
+    destroy_pool(p);
+    p = permanent_pool = NULL;
+  }
+
+  (void) unlink(user_path);
+  (void) unlink(group_path);
+}
+
+static void write_file(const char *path, const char *text) {
+  int fd;
+  ssize_t len;
+
+  fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+  ck_assert_msg(fd >= 0, "Failed to open '%s': %s", path, strerror(errno));
+
+  len = write(fd, text, strlen(text));
+  ck_assert_msg(len == (ssize_t) strlen(text), "Failed to write '%s': %s",
+    path, strerror(errno));
+  (void) close(fd);
+}
+
+static void set_directive(const char *name, const char *arg,
+    const char *arg2) {
+  cmd_rec *cmd;
+  conftable *c;
+  modret_t *mr;
+
+  c = pr_stash_get_symbol2(PR_SYM_CONF, name, NULL, NULL, NULL);
+  ck_assert_msg(c != NULL, "Failed to find '%s' directive", name);
+
+  if (arg2 != NULL) {
+    cmd = pr_cmd_alloc(p, 3, name, arg, arg2);
+
+  } else {
+    cmd = pr_cmd_alloc(p, 2, name, arg);
+  }
+
+  cmd->server = main_server;
+  cmd->tmp_pool = make_sub_pool(p);
+
+  mr = pr_module_call(c->m, c->handler, cmd);
+  ck_assert_msg(MODRET_ISHANDLED(mr), "Failed to handle '%s %s': %s", name,
+    arg, MODRET_ERRMSG(mr) ? MODRET_ERRMSG(mr) : "(unknown)");
+}
+
+/* Loads the module with the test files, and any additional AuthFileOptions,
+ * builds the indexes as the daemon would once the configuration has been
+ * parsed, and starts a session.
+ */
+static void start_session(const char *opt) {
+  int res;
+
+  res = pr_module_load(&auth_file_module);
+  ck_assert_msg(res == 0, "Failed to load module: %s", strerror(errno));
+
+  /* The test files live in a world-writable directory. */
+  set_directive("AuthFileOptions", "InsecurePerms", opt);
+  set_directive("AuthUserFile", user_path, NULL);
+  set_directive("AuthGroupFile", group_path, NULL);
+
+  pr_event_generate("core.postparse", NULL);
+
+  res = (auth_file_module.sess_init)();
+  ck_assert_msg(res == 0, "Failed to initialize session: %s",
+    strerror(errno));
+}
+
+/* Tests */
+
+START_TEST (auth_file_getpwnam_test) {
+  register unsigned int i;
+  char *text = "";
+  struct passwd *pw;
+
+  /* Enough users to share the index's hash chains. */
+  for (i = 0; i < 500; i++) {
+    text = pstrcat(p, text, "user", pr_uid2str(p, 1000 + i),
+      ":x:", pr_uid2str(p, 1000 + i), ":100::/home/user:/bin/sh\n", NULL);
+  }
+
+  write_file(user_path, text);
+  write_file(group_path, "ftp:x:100:\n");
+  start_session(NULL);
+
+  for (i = 0; i < 500; i++) {
+    const char *name;
+
+    name = pstrcat(p, "user", pr_uid2str(p, 1000 + i), NULL);
+    pw = pr_auth_getpwnam(p, name);
+    ck_assert_msg(pw != NULL, "Failed to find user '%s': %s", name,
+      strerror(errno));
+    ck_assert_msg(pw->pw_uid == (uid_t) (1000 + i),
+      "Expected UID %u for '%s', got %lu", 1000 + i, name,
+      (unsigned long) pw->pw_uid);
+
+    pw = pr_auth_getpwuid(p, 1000 + i);
+    ck_assert_msg(pw != NULL, "Failed to find UID %u: %s", 1000 + i,
+      strerror(errno));
+    ck_assert_msg(strcmp(pw->pw_name, name) == 0,
+      "Expected '%s' for UID %u, got '%s'", name, 1000 + i, pw->pw_name);
+  }
+
+  pw = pr_auth_getpwnam(p, "nobody-here");
+  ck_assert_msg(pw == NULL, "Unexpectedly found user 'nobody-here'");
+  ck_assert_msg(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+}
+END_TEST
+
+START_TEST (auth_file_duplicate_names_test) {
+  struct passwd *pw;
+  struct group *gr;
+
+  /* As with a scan of the file, the first of several entries wins. */
+  write_file(user_path,
+    "alice:x:1001:100::/home/alice:/bin/sh\n"
+    "bob:x:1001:100::/home/bob:/bin/sh\n"
+    "alice:x:1002:100::/home/alice2:/bin/sh\n");
+  write_file(group_path,
+    "ftp:x:100:alice\n"
+    "ftp:x:101:bob\n");
+  start_session(NULL);
+
+  pw = pr_auth_getpwnam(p, "alice");
+  ck_assert_msg(pw != NULL, "Failed to find user 'alice': %s",
+    strerror(errno));
+  ck_assert_msg(pw->pw_uid == 1001, "Expected UID 1001, got %lu",
+    (unsigned long) pw->pw_uid);
+  ck_assert_msg(strcmp(pw->pw_dir, "/home/alice") == 0,
+    "Expected home '/home/alice', got '%s'", pw->pw_dir);
+
+  pw = pr_auth_getpwuid(p, 1001);
+  ck_assert_msg(pw != NULL, "Failed to find UID 1001: %s", strerror(errno));
+  ck_assert_msg(strcmp(pw->pw_name, "alice") == 0,
+    "Expected 'alice' for UID 1001, got '%s'", pw->pw_name);
+
+  gr = pr_auth_getgrnam(p, "ftp");
+  ck_assert_msg(gr != NULL, "Failed to find group 'ftp': %s",
+    strerror(errno));
+  ck_assert_msg(gr->gr_gid == 100, "Expected GID 100, got %lu",
+    (unsigned long) gr->gr_gid);
+}
+END_TEST
+
+START_TEST (auth_file_getgroups_test) {
+  int res;
+  array_header *gids = NULL, *names = NULL;
+  struct group *gr;
+
+  write_file(user_path, "alice:x:1001:100::/home/alice:/bin/sh\n");
+  write_file(group_path,
+    "ftp:x:100:\n"
+    "staff:x:200:bob,alice\n"
+    "empty:x:300:\n"
+    "wheel:x:400:alice\n");
+  start_session(NULL);
+
+  res = pr_auth_getgroups(p, "alice", &gids, &names);
+  ck_assert_msg(res == 3, "Expected 3 groups, got %d", res);
+  ck_assert_msg(((gid_t *) gids->elts)[0] == 100, "Expected GID 100, got %lu",
+    (unsigned long) ((gid_t *) gids->elts)[0]);
+  ck_assert_msg(((gid_t *) gids->elts)[1] == 200, "Expected GID 200, got %lu",
+    (unsigned long) ((gid_t *) gids->elts)[1]);
+  ck_assert_msg(((gid_t *) gids->elts)[2] == 400, "Expected GID 400, got %lu",
+    (unsigned long) ((gid_t *) gids->elts)[2]);
+
+  /* A group without members does not inherit those of the line before. */
+  gr = pr_auth_getgrgid(p, 300);
+  ck_assert_msg(gr != NULL, "Failed to find GID 300: %s", strerror(errno));
+  ck_assert_msg(gr->gr_mem == NULL || gr->gr_mem[0] == NULL,
+    "Expected no members for group 'empty', got '%s'",
+    gr->gr_mem ? gr->gr_mem[0] : "");
+}
+END_TEST
+
+START_TEST (auth_file_changed_test) {
+  struct passwd *pw;
+
+  write_file(user_path, "alice:x:1001:100::/home/alice:/bin/sh\n");
+  write_file(group_path, "ftp:x:100:\n");
+  start_session(NULL);
+
+  pw = pr_auth_getpwnam(p, "alice");
+  ck_assert_msg(pw != NULL, "Failed to find user 'alice': %s",
+    strerror(errno));
+  pw = pr_auth_getpwnam(p, "bob");
+  ck_assert_msg(pw == NULL, "Unexpectedly found user 'bob'");
+
+  /* Lookups after the file changes see the new contents. */
+  write_file(user_path,
+    "bob:x:1002:100::/home/bob:/bin/sh\n"
+    "alice:x:1003:100::/home/alice:/bin/sh\n");
+
+  pw = pr_auth_getpwnam(p, "bob");
+  ck_assert_msg(pw != NULL, "Failed to find user 'bob': %s", strerror(errno));
+  ck_assert_msg(pw->pw_uid == 1002, "Expected UID 1002, got %lu",
+    (unsigned long) pw->pw_uid);
+
+  pw = pr_auth_getpwnam(p, "alice");
+  ck_assert_msg(pw != NULL, "Failed to find user 'alice': %s",
+    strerror(errno));
+  ck_assert_msg(pw->pw_uid == 1003, "Expected UID 1003, got %lu",
+    (unsigned long) pw->pw_uid);
+
+  pw = pr_auth_getpwuid(p, 1001);
+  ck_assert_msg(pw == NULL, "Unexpectedly found UID 1001");
+
+  /* Nor is a removed file's index used any further. */
+  (void) unlink(user_path);
+
+  pw = pr_auth_getpwnam(p, "bob");
+  ck_assert_msg(pw == NULL, "Unexpectedly found user 'bob'");
+}
+END_TEST
+
+START_TEST (auth_file_no_index_test) {
+  struct passwd *pw;
+
+  write_file(user_path,
+    "alice:x:1001:100::/home/alice:/bin/sh\n"
+    "alice:x:1002:100::/home/alice2:/bin/sh\n");
+  write_file(group_path, "ftp:x:100:\n");
+  start_session("NoIndex");
+
+  pw = pr_auth_getpwnam(p, "alice");
+  ck_assert_msg(pw != NULL, "Failed to find user 'alice': %s",
+    strerror(errno));
+  ck_assert_msg(pw->pw_uid == 1001, "Expected UID 1001, got %lu",
+    (unsigned long) pw->pw_uid);
+}
+END_TEST
+
+Suite *tests_get_mod_auth_file_suite(void) {
+  Suite *suite;
+  TCase *testcase;
+
+  suite = suite_create("mod_auth_file");
+
+  testcase = tcase_create("base");
+  tcase_add_checked_fixture(testcase, set_up, tear_down);
+
+  tcase_add_test(testcase, auth_file_getpwnam_test);
+  tcase_add_test(testcase, auth_file_duplicate_names_test);
+  tcase_add_test(testcase, auth_file_getgroups_test);
+  tcase_add_test(testcase, auth_file_changed_test);
+  tcase_add_test(testcase, auth_file_no_index_test);
+
+  suite_add_tcase(suite, testcase);
+  return suite;
+}
@@ -396,6 +396,118 @@ START_TEST (pool_debug_memory2_test) {
 }
 END_TEST
 
+static void test_alloc_visitf(const pr_pool_info_t *pinfo, void *user_data) {
+  pr_pool_info_t *info;
+
+  info = user_data;
+
+  if (pinfo->have_pool_info &&
+      pinfo->tag != NULL &&
+      strcmp(pinfo->tag, "alloc-stats") == 0) {
+    info->alloc_count = pinfo->alloc_count;
+    info->alloc_byte_count = pinfo->alloc_byte_count;
+  }
+
+  if (pinfo->have_total_info) {
+    info->total_blocks_allocated = pinfo->total_blocks_allocated;
+    info->total_blocks_reused = pinfo->total_blocks_reused;
+  }
+}
+
+START_TEST (pool_debug_memory2_alloc_stats_test) {
+  pool *p;
+  pr_pool_info_t info;
+  unsigned long nallocated, nreused;
+
+  p = make_sub_pool(permanent_pool);
+  pr_pool_tag(p, "alloc-stats");
+
+  (void) palloc(p, 16);
+  (void) pcalloc(p, 1024);
+  (void) pstrdup(p, "foo");
+
+  memset(&info, 0, sizeof(info));
+  pr_pool_debug_memory2(test_alloc_visitf, &info);
+  ck_assert_msg(info.alloc_count == 3, "Expected 3 allocations, got %lu",
+    info.alloc_count);
+  ck_assert_msg(info.alloc_byte_count == 1044,
+    "Expected 1044 allocated bytes, got %lu", info.alloc_byte_count);
+
+  nallocated = info.total_blocks_allocated;
+  nreused = info.total_blocks_reused;
+  destroy_pool(p);
+
+  /* A pool of the same size should reuse the blocks just freed, rather
+   * than allocating new ones.
+   */
+  p = make_sub_pool(permanent_pool);
+  (void) palloc(p, 16);
+
+  memset(&info, 0, sizeof(info));
+  pr_pool_debug_memory2(test_alloc_visitf, &info);
+  ck_assert_msg(info.total_blocks_allocated == nallocated,
+    "Expected %lu allocated blocks, got %lu", nallocated,
+    info.total_blocks_allocated);
+  ck_assert_msg(info.total_blocks_reused > nreused,
+    "Expected more than %lu reused blocks, got %lu", nreused,
+    info.total_blocks_reused);
+
+  destroy_pool(p);
+}
+END_TEST
+
+static void test_tag_visitf(const pr_pool_info_t *pinfo, void *user_data) {
+  pr_pool_info_t *info;
+
+  info = user_data;
+
+  if (pinfo->have_tag_info &&
+      strcmp(pinfo->tag, "tag-stats") == 0) {
+    info->pool_count = pinfo->pool_count;
+    info->alloc_count = pinfo->alloc_count;
+    info->alloc_byte_count = pinfo->alloc_byte_count;
+  }
+}
+
+START_TEST (pool_debug_memory2_tag_stats_test) {
+  register unsigned int i;
+  pool *p;
+  pr_pool_info_t info;
+
+  /* Three destroyed pools, and one still around, all with the same tag. */
+  for (i = 0; i < 3; i++) {
+    p = make_sub_pool(permanent_pool);
+    pr_pool_tag(p, "tag-stats");
+    (void) palloc(p, 8);
+    (void) palloc(p, 24);
+    destroy_pool(p);
+  }
+
+  p = make_sub_pool(permanent_pool);
+  pr_pool_tag(p, "tag-stats");
+  (void) palloc(p, 100);
+
+  memset(&info, 0, sizeof(info));
+  pr_pool_debug_memory2(test_tag_visitf, &info);
+  ck_assert_msg(info.pool_count == 4, "Expected 4 pools, got %lu",
+    info.pool_count);
+  ck_assert_msg(info.alloc_count == 7, "Expected 7 allocations, got %lu",
+    info.alloc_count);
+  ck_assert_msg(info.alloc_byte_count == 196,
+    "Expected 196 allocated bytes, got %lu", info.alloc_byte_count);
+
+  destroy_pool(p);
+
+  /* The destroyed pool is still counted, exactly once. */
+  memset(&info, 0, sizeof(info));
+  pr_pool_debug_memory2(test_tag_visitf, &info);
+  ck_assert_msg(info.pool_count == 4, "Expected 4 pools, got %lu",
+    info.pool_count);
+  ck_assert_msg(info.alloc_byte_count == 196,
+    "Expected 196 allocated bytes, got %lu", info.alloc_byte_count);
+}
+END_TEST
+
 static unsigned int pool_cleanup_count = 0;
 
 static void cleanup_cb(void *data) {
@@ -505,6 +617,8 @@ Suite *tests_get_pool_suite(void) {
   tcase_add_test(testcase, pool_debug_flags_test);
   tcase_add_test(testcase, pool_debug_memory_test);
   tcase_add_test(testcase, pool_debug_memory2_test);
+  tcase_add_test(testcase, pool_debug_memory2_alloc_stats_test);
+  tcase_add_test(testcase, pool_debug_memory2_tag_stats_test);
   tcase_add_test(testcase, pool_register_cleanup_test);
   tcase_add_test(testcase, pool_register_cleanup2_test);
   tcase_add_test(testcase, pool_unregister_cleanup_test);
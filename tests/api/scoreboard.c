@@ -817,6 +817,86 @@ START_TEST (scoreboard_entry_read_test) {
 }
 END_TEST
 
+START_TEST (scoreboard_entry_seq_test) {
+  int res;
+  unsigned long seq;
+  pr_scoreboard_entry_t *score;
+
+  res = mkdir(test_dir, 0775);
+  ck_assert_msg(res == 0, "Failed to create directory '%s': %s", test_dir,
+    strerror(errno));
+
+  res = chmod(test_dir, 0775);
+  ck_assert_msg(res == 0, "Failed to set perms on '%s' to 0775': %s", test_dir,
+    strerror(errno));
+
+  res = pr_set_scoreboard(test_file);
+  ck_assert_msg(res == 0, "Failed to set scoreboard to '%s': %s", test_file,
+    strerror(errno));
+
+  res = pr_open_scoreboard(O_RDWR);
+  ck_assert_msg(res == 0, "Failed to open scoreboard: %s", strerror(errno));
+
+  res = pr_scoreboard_entry_add();
+  ck_assert_msg(res == 0, "Failed to add entry to scoreboard: %s",
+    strerror(errno));
+
+  score = pr_scoreboard_entry_read();
+  ck_assert_msg(score != NULL, "Failed to read scoreboard entry: %s",
+    strerror(errno));
+  ck_assert_msg(score->sce_seq % 2 == 0,
+    "Expected even entry sequence number, got %lu", score->sce_seq);
+  seq = score->sce_seq;
+
+  res = pr_scoreboard_entry_update(getpid(), PR_SCORE_CMD, "%s", "RETR",
+    NULL, NULL);
+  ck_assert_msg(res == 0, "Failed to update PR_SCORE_CMD: %s", strerror(errno));
+
+  res = pr_rewind_scoreboard();
+  ck_assert_msg(res == 0, "Failed to rewind scoreboard: %s", strerror(errno));
+
+  score = pr_scoreboard_entry_read();
+  ck_assert_msg(score != NULL, "Failed to read scoreboard entry: %s",
+    strerror(errno));
+  ck_assert_msg(score->sce_seq % 2 == 0,
+    "Expected even entry sequence number, got %lu", score->sce_seq);
+  ck_assert_msg(score->sce_seq > seq,
+    "Expected entry sequence number greater than %lu, got %lu", seq,
+    score->sce_seq);
+  ck_assert_msg(strcmp(score->sce_cmd, "RETR") == 0,
+    "Expected command 'RETR', got '%s'", score->sce_cmd);
+
+  res = pr_scoreboard_entry_del(FALSE);
+  ck_assert_msg(res == 0, "Failed to delete entry from scoreboard: %s",
+    strerror(errno));
+
+  /* The freed slot should be skipped by readers. */
+  res = pr_rewind_scoreboard();
+  ck_assert_msg(res == 0, "Failed to rewind scoreboard: %s", strerror(errno));
+
+  score = pr_scoreboard_entry_read();
+  ck_assert_msg(score == NULL, "Unexpectedly read scoreboard entry");
+
+  /* And reused by the next entry. */
+  res = pr_scoreboard_entry_add();
+  ck_assert_msg(res == 0, "Failed to add entry to scoreboard: %s",
+    strerror(errno));
+
+  res = pr_rewind_scoreboard();
+  ck_assert_msg(res == 0, "Failed to rewind scoreboard: %s", strerror(errno));
+
+  score = pr_scoreboard_entry_read();
+  ck_assert_msg(score != NULL, "Failed to read scoreboard entry: %s",
+    strerror(errno));
+  ck_assert_msg(score->sce_cmd[0] == '\0',
+    "Expected empty command, got '%s'", score->sce_cmd);
+
+  (void) unlink(test_mutex);
+  (void) unlink(test_file);
+  (void) rmdir(test_dir);
+}
+END_TEST
+
 START_TEST (scoreboard_entry_get_test) {
   register unsigned int i;
   int res;
@@ -882,6 +962,7 @@ END_TEST
 START_TEST (scoreboard_entry_update_test) {
   int num, res;
   const char *val;
+  pr_scoreboard_entry_t *score;
   pid_t pid = getpid();
   const pr_netaddr_t *addr;
   time_t now;
@@ -1011,6 +1092,43 @@ START_TEST (scoreboard_entry_update_test) {
   ck_assert_msg(res == 0, "Failed to update PR_SCORE_PROTOCOL: %s",
     strerror(errno));
 
+  len = 10;
+  res = pr_scoreboard_entry_update(pid, PR_SCORE_BYTES_IN, len,
+    PR_SCORE_BYTES_OUT, len * 2, NULL);
+  ck_assert_msg(res == 0, "Failed to update PR_SCORE_BYTES_IN/OUT: %s",
+    strerror(errno));
+
+  res = pr_scoreboard_entry_update(pid, PR_SCORE_CMD_COUNT, 3UL,
+    PR_SCORE_CMD_MS, 12UL, PR_SCORE_HANDSHAKE_MS, 5UL, NULL);
+  ck_assert_msg(res == 0, "Failed to update PR_SCORE_CMD_COUNT/MS: %s",
+    strerror(errno));
+
+  res = pr_scoreboard_entry_update(pid, PR_SCORE_XFER_DISK_MS, 6UL,
+    PR_SCORE_XFER_NET_MS, 7UL, PR_SCORE_XFER_THROTTLE_MS, 8UL, NULL);
+  ck_assert_msg(res == 0, "Failed to update PR_SCORE_XFER_DISK/NET/THROTTLE_MS: "
+    "%s", strerror(errno));
+
+  res = pr_rewind_scoreboard();
+  ck_assert_msg(res == 0, "Failed to rewind scoreboard: %s", strerror(errno));
+
+  score = pr_scoreboard_entry_read();
+  ck_assert_msg(score != NULL, "Failed to read scoreboard entry: %s",
+    strerror(errno));
+  ck_assert_msg(score->sce_bytes_in == 10 && score->sce_bytes_out == 20,
+    "Expected 10/20 bytes in/out, got %lu/%lu",
+    (unsigned long) score->sce_bytes_in, (unsigned long) score->sce_bytes_out);
+  ck_assert_msg(score->sce_cmd_count == 3 && score->sce_cmd_ms == 12,
+    "Expected 3 commands in 12 ms, got %lu in %lu ms", score->sce_cmd_count,
+    score->sce_cmd_ms);
+  ck_assert_msg(score->sce_handshake_ms == 5,
+    "Expected handshake 5 ms, got %lu", score->sce_handshake_ms);
+  ck_assert_msg(score->sce_xfer_disk_ms == 6 &&
+    score->sce_xfer_net_ms == 7 &&
+    score->sce_xfer_throttle_ms == 8,
+    "Expected disk/net/throttle 6/7/8 ms, got %lu/%lu/%lu",
+    score->sce_xfer_disk_ms, score->sce_xfer_net_ms,
+    score->sce_xfer_throttle_ms);
+
   (void) unlink(test_mutex);
   (void) unlink(test_file);
   (void) rmdir(test_dir);
@@ -1199,6 +1317,7 @@ Suite *tests_get_scoreboard_suite(void) {
   tcase_add_test(testcase, scoreboard_entry_add_test);
   tcase_add_test(testcase, scoreboard_entry_del_test);
   tcase_add_test(testcase, scoreboard_entry_read_test);
+  tcase_add_test(testcase, scoreboard_entry_seq_test);
   tcase_add_test(testcase, scoreboard_entry_get_test);
   tcase_add_test(testcase, scoreboard_entry_update_test);
   tcase_add_test(testcase, scoreboard_entry_kill_test);
@@ -396,6 +396,39 @@ START_TEST (set_remove_test) {
 }
 END_TEST
 
+START_TEST (set_gen_test) {
+  int res;
+  unsigned long gen;
+  xaset_t *set, *set2;
+  struct test_item *item;
+
+  set = xaset_create(p, NULL);
+  ck_assert_msg(set != NULL, "Failed to create set: %s", strerror(errno));
+
+  set2 = xaset_create(p, NULL);
+  ck_assert_msg(set2 != NULL, "Failed to create set: %s", strerror(errno));
+  ck_assert_msg(set->xas_gen != set2->xas_gen,
+    "Expected different stamps for different sets");
+
+  item = pcalloc(p, sizeof(struct test_item));
+  item->num = 7;
+
+  gen = set->xas_gen;
+  res = xaset_insert(set, (xasetmember_t *) item);
+  ck_assert_msg(res == 0, "Failed to insert item");
+  ck_assert_msg(set->xas_gen != gen, "Expected stamp to change on insert");
+
+  gen = set->xas_gen;
+  res = xaset_remove(set2, (xasetmember_t *) item);
+  ck_assert_msg(res == -1, "Failed to handle non-included item properly");
+  ck_assert_msg(set->xas_gen == gen, "Expected stamp to be unchanged");
+
+  res = xaset_remove(set, (xasetmember_t *) item);
+  ck_assert_msg(res == 0, "Failed to remove item");
+  ck_assert_msg(set->xas_gen != gen, "Expected stamp to change on remove");
+}
+END_TEST
+
 START_TEST (set_copy_test) {
   xaset_t *res, *set;
   struct test_item *item1, *item2;
@@ -462,6 +495,7 @@ Suite *tests_get_sets_suite(void) {
   tcase_add_test(testcase, set_insert_sort_test);
   tcase_add_test(testcase, set_remove_test);
   tcase_add_test(testcase, set_copy_test);
+  tcase_add_test(testcase, set_gen_test);
 
   suite_add_tcase(suite, testcase);
   return suite;
@@ -533,6 +533,101 @@ START_TEST (stash_remove_cmd_test) {
 }
 END_TEST
 
+START_TEST (stash_get_cmd_handlers_test) {
+  int res;
+  cmdtable cmdtab, cmdtab2, cmdtab3, **handlers = NULL;
+  unsigned int nhandlers = 0;
+
+  res = pr_stash_get_cmd_handlers(NULL, 0, 0, NULL, NULL);
+  ck_assert_msg(res == -1, "Failed to handle null arguments");
+  ck_assert_msg(errno == EINVAL, "Failed to set errno to EINVAL, got %d (%s)",
+    errno, strerror(errno));
+
+  res = pr_stash_get_cmd_handlers("foo", 0, LOG_CMD_ERR + 1, &handlers,
+    &nhandlers);
+  ck_assert_msg(res == -1, "Failed to handle invalid phase");
+  ck_assert_msg(errno == EINVAL, "Failed to set errno to EINVAL, got %d (%s)",
+    errno, strerror(errno));
+
+  mark_point();
+  res = pr_stash_get_cmd_handlers("foo", 0, CMD, &handlers, &nhandlers);
+  ck_assert_msg(res == 0, "Failed to get handlers: %s", strerror(errno));
+  ck_assert_msg(nhandlers == 0, "Expected 0 handlers, got %u", nhandlers);
+
+  memset(&cmdtab, 0, sizeof(cmdtab));
+  cmdtab.command = pstrdup(p, "foo");
+  cmdtab.cmd_type = CMD;
+  res = pr_stash_add_symbol(PR_SYM_CMD, &cmdtab);
+  ck_assert_msg(res == 0, "Failed to add CMD symbol: %s", strerror(errno));
+
+  memset(&cmdtab2, 0, sizeof(cmdtab2));
+  cmdtab2.command = pstrdup(p, "foo");
+  cmdtab2.cmd_type = PRE_CMD;
+  res = pr_stash_add_symbol(PR_SYM_CMD, &cmdtab2);
+  ck_assert_msg(res == 0, "Failed to add CMD symbol: %s", strerror(errno));
+
+  mark_point();
+  res = pr_stash_get_cmd_handlers("foo", 0, CMD, &handlers, &nhandlers);
+  ck_assert_msg(res == 0, "Failed to get handlers: %s", strerror(errno));
+  ck_assert_msg(nhandlers == 1, "Expected 1 handler, got %u", nhandlers);
+  ck_assert_msg(handlers[0] == &cmdtab, "Expected CMD handler %p, got %p",
+    &cmdtab, handlers[0]);
+
+  res = pr_stash_get_cmd_handlers("foo", 0, POST_CMD, &handlers, &nhandlers);
+  ck_assert_msg(res == 0, "Failed to get handlers: %s", strerror(errno));
+  ck_assert_msg(nhandlers == 0, "Expected 0 handlers, got %u", nhandlers);
+
+  /* Adding a symbol must be reflected in the cached lists. */
+  mark_point();
+  memset(&cmdtab3, 0, sizeof(cmdtab3));
+  cmdtab3.command = pstrdup(p, "foo");
+  cmdtab3.cmd_type = CMD;
+  res = pr_stash_add_symbol(PR_SYM_CMD, &cmdtab3);
+  ck_assert_msg(res == 0, "Failed to add CMD symbol: %s", strerror(errno));
+
+  res = pr_stash_get_cmd_handlers("foo", 0, CMD, &handlers, &nhandlers);
+  ck_assert_msg(res == 0, "Failed to get handlers: %s", strerror(errno));
+  ck_assert_msg(nhandlers == 2, "Expected 2 handlers, got %u", nhandlers);
+
+  /* As must removing one. */
+  mark_point();
+  res = pr_stash_remove_cmd("foo", NULL, CMD, NULL, -1);
+  ck_assert_msg(res == 2, "Expected %d, got %d", 2, res);
+
+  res = pr_stash_get_cmd_handlers("foo", 0, CMD, &handlers, &nhandlers);
+  ck_assert_msg(res == 0, "Failed to get handlers: %s", strerror(errno));
+  ck_assert_msg(nhandlers == 0, "Expected 0 handlers, got %u", nhandlers);
+
+  res = pr_stash_get_cmd_handlers("foo", 0, PRE_CMD, &handlers, &nhandlers);
+  ck_assert_msg(res == 0, "Failed to get handlers: %s", strerror(errno));
+  ck_assert_msg(nhandlers == 1, "Expected 1 handler, got %u", nhandlers);
+  ck_assert_msg(handlers[0] == &cmdtab2, "Expected PRE_CMD handler %p, got %p",
+    &cmdtab2, handlers[0]);
+  (void) pr_stash_remove_symbol(PR_SYM_CMD, "foo", NULL);
+
+  /* Commands with known IDs */
+  mark_point();
+  memset(&cmdtab, 0, sizeof(cmdtab));
+  cmdtab.command = pstrdup(p, C_RETR);
+  cmdtab.cmd_type = LOG_CMD;
+  res = pr_stash_add_symbol(PR_SYM_CMD, &cmdtab);
+  ck_assert_msg(res == 0, "Failed to add CMD symbol: %s", strerror(errno));
+
+  res = pr_stash_get_cmd_handlers(C_RETR, PR_CMD_RETR_ID, LOG_CMD, &handlers,
+    &nhandlers);
+  ck_assert_msg(res == 0, "Failed to get handlers: %s", strerror(errno));
+  ck_assert_msg(nhandlers == 1, "Expected 1 handler, got %u", nhandlers);
+  ck_assert_msg(handlers[0] == &cmdtab, "Expected LOG_CMD handler %p, got %p",
+    &cmdtab, handlers[0]);
+
+  (void) pr_stash_remove_symbol(PR_SYM_CMD, C_RETR, NULL);
+  res = pr_stash_get_cmd_handlers(C_RETR, PR_CMD_RETR_ID, LOG_CMD, &handlers,
+    &nhandlers);
+  ck_assert_msg(res == 0, "Failed to get handlers: %s", strerror(errno));
+  ck_assert_msg(nhandlers == 0, "Expected 0 handlers, got %u", nhandlers);
+}
+END_TEST
+
 START_TEST (stash_remove_auth_test) {
   int res;
   authtable authtab;
@@ -596,6 +691,7 @@ Suite *tests_get_stash_suite(void) {
   tcase_add_test(testcase, stash_get_symbol_test);
   tcase_add_test(testcase, stash_get_symbol2_test);
   tcase_add_test(testcase, stash_remove_symbol_test);
+  tcase_add_test(testcase, stash_get_cmd_handlers_test);
 #ifdef PR_USE_DEVEL
   tcase_add_test(testcase, stash_dump_test);
 #endif /* PR_USE_DEVEL */
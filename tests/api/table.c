@@ -734,6 +734,244 @@ START_TEST (table_ctl_test) {
 }
 END_TEST
 
+START_TEST (table_ctl_set_backend_test) {
+  int backend, res;
+  pr_table_t *tab;
+
+  tab = pr_table_alloc(p, 0);
+
+  res = pr_table_ctl(tab, PR_TABLE_CTL_SET_BACKEND, NULL);
+  ck_assert_msg(res == -1, "Failed to handle SET_BACKEND, null args");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  backend = -1;
+  res = pr_table_ctl(tab, PR_TABLE_CTL_SET_BACKEND, &backend);
+  ck_assert_msg(res == -1, "Failed to handle unknown backend");
+  ck_assert_msg(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  backend = PR_TABLE_BACKEND_OPEN_ADDR;
+  res = pr_table_ctl(tab, PR_TABLE_CTL_SET_BACKEND, &backend);
+  ck_assert_msg(res == 0, "Failed to set open addressing backend: %s",
+    strerror(errno));
+
+  res = pr_table_add(tab, "foo", "bar", 0);
+  ck_assert_msg(res == 0, "Failed to add 'foo' to table: %s", strerror(errno));
+
+  backend = PR_TABLE_BACKEND_CHAINED;
+  res = pr_table_ctl(tab, PR_TABLE_CTL_SET_BACKEND, &backend);
+  ck_assert_msg(res == -1, "Failed to handle SET_BACKEND on non-empty table");
+  ck_assert_msg(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  res = pr_table_empty(tab);
+  ck_assert_msg(res == 0, "Failed to empty table: %s", strerror(errno));
+
+  res = pr_table_ctl(tab, PR_TABLE_CTL_SET_BACKEND, &backend);
+  ck_assert_msg(res == 0, "Failed to set chained backend: %s",
+    strerror(errno));
+
+  res = pr_table_add(tab, "foo", "bar", 0);
+  ck_assert_msg(res == 0, "Failed to add 'foo' to table: %s", strerror(errno));
+
+  res = pr_table_exists(tab, "foo");
+  ck_assert_msg(res == 1, "Expected 1, got %d", res);
+}
+END_TEST
+
+static pr_table_t *make_backend_table(int backend, int flags) {
+  pr_table_t *tab;
+
+  tab = pr_table_alloc(p, flags);
+  (void) pr_table_ctl(tab, PR_TABLE_CTL_SET_BACKEND, &backend);
+
+  return tab;
+}
+
+static char **make_keys(unsigned int nkeys) {
+  register unsigned int i;
+  char **keys;
+
+  keys = pcalloc(p, sizeof(char *) * nkeys);
+  for (i = 0; i < nkeys; i++) {
+    char buf[32];
+
+    pr_snprintf(buf, sizeof(buf)-1, "key%u", i);
+    keys[i] = pstrdup(p, buf);
+  }
+
+  return keys;
+}
+
+START_TEST (table_open_addr_test) {
+  register unsigned int i;
+  int res;
+  unsigned int nkeys = 4000;
+  pr_table_t *tab;
+  char **keys;
+  const void *key, *val;
+  float load;
+
+  keys = make_keys(nkeys);
+  tab = make_backend_table(PR_TABLE_BACKEND_OPEN_ADDR,
+    PR_TABLE_FL_MULTI_VALUE);
+
+  /* Enough keys to force several resizes. */
+  for (i = 0; i < nkeys; i++) {
+    res = pr_table_add(tab, keys[i], keys[i], 0);
+    ck_assert_msg(res == 0, "Failed to add '%s': %s", keys[i],
+      strerror(errno));
+  }
+
+  res = pr_table_count(tab);
+  ck_assert_msg(res == (int) nkeys, "Expected %u entries, got %d", nkeys, res);
+
+  load = pr_table_load(tab);
+  ck_assert_msg(load > 0.0 && load <= 0.75,
+    "Expected load in (0, 0.75], got %0.3f", load);
+
+  for (i = 0; i < nkeys; i++) {
+    val = pr_table_get(tab, keys[i], NULL);
+    ck_assert_msg(val == keys[i], "Wrong value for '%s'", keys[i]);
+  }
+
+  /* Multiple values for a key are returned in insertion order. */
+  res = pr_table_add(tab, keys[0], "second", 0);
+  ck_assert_msg(res == 0, "Failed to add second value: %s", strerror(errno));
+
+  res = pr_table_exists(tab, keys[0]);
+  ck_assert_msg(res == 2, "Expected 2 values, got %d", res);
+
+  val = pr_table_get(tab, keys[0], NULL);
+  ck_assert_msg(val == keys[0], "Wrong first value for '%s'", keys[0]);
+  val = pr_table_get(tab, keys[0], NULL);
+  ck_assert_msg(val != NULL && strcmp(val, "second") == 0,
+    "Wrong second value for '%s'", keys[0]);
+  (void) pr_table_get(tab, NULL, NULL);
+
+  res = pr_table_exists(tab, "missing");
+  ck_assert_msg(res == 0, "Expected 0, got %d", res);
+
+  /* Iterating visits each key once. */
+  pr_table_rewind(tab);
+  i = 0;
+  key = pr_table_next(tab);
+  while (key != NULL) {
+    i++;
+    key = pr_table_next(tab);
+  }
+  ck_assert_msg(i == nkeys, "Expected to iterate over %u keys, got %u",
+    nkeys, i);
+
+  /* Remove every other key; the rest must still be found. */
+  for (i = 0; i < nkeys; i += 2) {
+    val = pr_table_remove(tab, keys[i], NULL);
+    ck_assert_msg(val != NULL, "Failed to remove '%s': %s", keys[i],
+      strerror(errno));
+  }
+
+  for (i = 0; i < nkeys; i++) {
+    val = pr_table_get(tab, keys[i], NULL);
+
+    if (i == 0) {
+      /* The second value for this key is still there. */
+      ck_assert_msg(val != NULL && strcmp(val, "second") == 0,
+        "Wrong remaining value for '%s'", keys[i]);
+
+    } else if (i % 2 == 0) {
+      ck_assert_msg(val == NULL, "Found removed key '%s'", keys[i]);
+
+    } else {
+      ck_assert_msg(val == keys[i], "Wrong value for '%s'", keys[i]);
+    }
+  }
+
+  res = pr_table_empty(tab);
+  ck_assert_msg(res == 0, "Failed to empty table: %s", strerror(errno));
+
+  res = pr_table_count(tab);
+  ck_assert_msg(res == 0, "Expected 0 entries, got %d", res);
+
+  key = pr_table_next(tab);
+  ck_assert_msg(key == NULL, "Expected no keys in empty table");
+
+  res = pr_table_add(tab, keys[1], keys[1], 0);
+  ck_assert_msg(res == 0, "Failed to add '%s': %s", keys[1], strerror(errno));
+
+  res = pr_table_add(tab, keys[1], keys[1], 0);
+  ck_assert_msg(res == 0, "Failed to add '%s': %s", keys[1], strerror(errno));
+
+  res = pr_table_free(tab);
+  ck_assert_msg(res == -1, "Freed non-empty table unexpectedly");
+}
+END_TEST
+
+static unsigned long bench_backend(int backend, char **keys,
+    unsigned int nkeys, unsigned int nrounds) {
+  register unsigned int i, j;
+  pr_table_t *tab;
+  struct timeval start, end;
+
+  tab = make_backend_table(backend, 0);
+
+  gettimeofday(&start, NULL);
+
+  for (j = 0; j < nrounds; j++) {
+    for (i = 0; i < nkeys; i++) {
+      ck_assert_msg(pr_table_add(tab, keys[i], keys[i], 0) == 0,
+        "Failed to add '%s': %s", keys[i], strerror(errno));
+    }
+
+    for (i = 0; i < nkeys; i++) {
+      ck_assert_msg(pr_table_get(tab, keys[i], NULL) == keys[i],
+        "Wrong value for '%s'", keys[i]);
+    }
+
+    for (i = 0; i < nkeys; i++) {
+      ck_assert_msg(pr_table_remove(tab, keys[i], NULL) == keys[i],
+        "Failed to remove '%s'", keys[i]);
+    }
+  }
+
+  gettimeofday(&end, NULL);
+
+  return ((end.tv_sec - start.tv_sec) * 1000000UL) +
+    (end.tv_usec - start.tv_usec);
+}
+
+START_TEST (table_backend_benchmark_test) {
+  register unsigned int i;
+  unsigned int nkeys[] = { 16, 512, 8000, 0 };
+
+  /* Compares the time taken to add, look up and remove the same keys using
+   * each backend.  Set TEST_VERBOSE to see the results.
+   */
+  for (i = 0; nkeys[i] > 0; i++) {
+    char **keys;
+    unsigned int nrounds;
+    unsigned long chained_usecs, open_addr_usecs;
+
+    keys = make_keys(nkeys[i]);
+    nrounds = 16000 / nkeys[i];
+    if (nrounds == 0) {
+      nrounds = 1;
+    }
+
+    chained_usecs = bench_backend(PR_TABLE_BACKEND_CHAINED, keys, nkeys[i],
+      nrounds);
+    open_addr_usecs = bench_backend(PR_TABLE_BACKEND_OPEN_ADDR, keys,
+      nkeys[i], nrounds);
+
+    if (getenv("TEST_VERBOSE") != NULL) {
+      fprintf(stderr, "table benchmark: %u keys x %u rounds: "
+        "chained %lu usecs, open addressing %lu usecs\n", nkeys[i], nrounds,
+        chained_usecs, open_addr_usecs);
+    }
+  }
+}
+END_TEST
+
 START_TEST (table_load_test) {
   pr_table_t *tab = NULL;
   float load;
@@ -812,6 +1050,9 @@ Suite *tests_get_table_suite(void) {
   tcase_add_test(testcase, table_do_test);
   tcase_add_test(testcase, table_do_with_remove_test);
   tcase_add_test(testcase, table_ctl_test);
+  tcase_add_test(testcase, table_ctl_set_backend_test);
+  tcase_add_test(testcase, table_open_addr_test);
+  tcase_add_test(testcase, table_backend_benchmark_test);
   tcase_add_test(testcase, table_load_test);
   tcase_add_test(testcase, table_dump_test);
   tcase_add_test(testcase, table_pcalloc_test);
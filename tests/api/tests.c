@@ -74,6 +74,11 @@ static struct testsuite_info suites[] = {
   { "jot",		tests_get_jot_suite },
   { "redis",		tests_get_redis_suite },
   { "error",		tests_get_error_suite },
+  { "dirindex",		tests_get_dirindex_suite },
+  { "ftpaccess",	tests_get_ftpaccess_suite },
+  { "logfmt",		tests_get_logfmt_suite },
+  { "logbuf",		tests_get_logbuf_suite },
+  { "mod_auth_file",	tests_get_mod_auth_file_suite },
 
   { NULL, NULL }
 };
@@ -84,6 +84,11 @@ Suite *tests_get_json_suite(void);
 Suite *tests_get_jot_suite(void);
 Suite *tests_get_redis_suite(void);
 Suite *tests_get_error_suite(void);
+Suite *tests_get_dirindex_suite(void);
+Suite *tests_get_ftpaccess_suite(void);
+Suite *tests_get_logfmt_suite(void);
+Suite *tests_get_logbuf_suite(void);
+Suite *tests_get_mod_auth_file_suite(void);
 
 /* Temporary hack/placement (in stubs.c) for this variable,
  * until we get to testing the Signals API.
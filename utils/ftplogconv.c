@@ -0,0 +1,185 @@
+/*
+ * ProFTPD - FTP server daemon
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* Simple utility for converting binary ExtendedLog files (i.e. those using
+ * a "binary" LogFormat) into xferlog(5) or JSON text.
+ */
+
+#include "conf.h"
+#include "logfmt.h"
+
+#define FTPLOGCONV_FMT_JSON		1
+#define FTPLOGCONV_FMT_XFERLOG		2
+
+static const char *program = "ftplogconv";
+
+static void show_usage(int exit_code) {
+  printf("usage: %s [ -f json|xferlog ] [ file ... ]\n", program);
+  printf("\nReads binary ExtendedLog files (or stdin), writing the records to "
+    "stdout\nas JSON (the default), or as xferlog(5) lines.\n");
+
+  exit(exit_code);
+}
+
+static int convert_log(FILE *fp, const char *path, int fmt, FILE *outf) {
+  pr_logfmt_reader_t reader;
+  pr_logfmt_record_t *rec;
+  int res = 0;
+
+  rec = malloc(sizeof(pr_logfmt_record_t));
+  if (rec == NULL) {
+    fprintf(stderr, "%s: out of memory\n", program);
+    return -1;
+  }
+
+  memset(&reader, 0, sizeof(reader));
+  reader.fp = fp;
+
+  while (TRUE) {
+    int xerrno;
+
+    res = pr_logfmt_bin_read_record(&reader, rec);
+    if (res == 0) {
+      break;
+    }
+
+    if (res < 0) {
+      xerrno = errno;
+
+      if (xerrno == EBADMSG) {
+        fprintf(stderr, "%s: %s: malformed record, skipping\n", program,
+          path);
+        res = 0;
+        continue;
+      }
+
+      if (xerrno == EIO) {
+        /* Most likely the server was still writing this last record. */
+        fprintf(stderr, "%s: %s: truncated last record, ignoring\n", program,
+          path);
+        res = 0;
+        break;
+      }
+
+      switch (xerrno) {
+        case EINVAL:
+          fprintf(stderr, "%s: %s: not a binary ExtendedLog\n", program,
+            path);
+          break;
+
+        case ENOTSUP:
+          fprintf(stderr, "%s: %s: unsupported format version %u\n", program,
+            path, reader.version);
+          break;
+
+        case E2BIG:
+          fprintf(stderr, "%s: %s: corrupted record length\n", program, path);
+          break;
+
+        default:
+          fprintf(stderr, "%s: %s\n", program, strerror(xerrno));
+          break;
+      }
+
+      break;
+    }
+
+    if (fmt == FTPLOGCONV_FMT_XFERLOG) {
+      /* Records other than transfers have no xferlog line. */
+      (void) pr_logfmt_bin_write_xferlog(outf, rec);
+
+    } else {
+      (void) pr_logfmt_bin_write_json(outf, rec);
+    }
+  }
+
+  pr_logfmt_bin_reader_free(&reader);
+  free(rec);
+  return res;
+}
+
+int main(int argc, char *argv[]) {
+  int c, fmt = FTPLOGCONV_FMT_JSON, res = 0;
+  const char *opts = "f:h";
+
+  if (argv[0] != NULL) {
+    char *ptr;
+
+    ptr = strrchr(argv[0], '/');
+    program = ptr != NULL ? ptr + 1 : argv[0];
+  }
+
+  opterr = 0;
+  while ((c = getopt(argc, argv, opts)) != -1) {
+    switch (c) {
+      case 'f':
+        if (strcasecmp(optarg, "json") == 0) {
+          fmt = FTPLOGCONV_FMT_JSON;
+
+        } else if (strcasecmp(optarg, "xferlog") == 0) {
+          fmt = FTPLOGCONV_FMT_XFERLOG;
+
+        } else {
+          fprintf(stderr, "%s: unknown output format '%s'\n", program,
+            optarg);
+          show_usage(1);
+        }
+        break;
+
+      case 'h':
+        show_usage(0);
+
+      case '?':
+        fprintf(stderr, "%s: unknown option: %c\n", program, (char) optopt);
+        show_usage(1);
+    }
+  }
+
+  if (optind >= argc) {
+    if (convert_log(stdin, "(stdin)", fmt, stdout) < 0) {
+      res = 1;
+    }
+
+  } else {
+    for (; optind < argc; optind++) {
+      FILE *fp;
+
+      fp = fopen(argv[optind], "rb");
+      if (fp == NULL) {
+        fprintf(stderr, "%s: unable to open %s: %s\n", program, argv[optind],
+          strerror(errno));
+        res = 1;
+        continue;
+      }
+
+      if (convert_log(fp, argv[optind], fmt, stdout) < 0) {
+        res = 1;
+      }
+
+      fclose(fp);
+    }
+  }
+
+  return res;
+}
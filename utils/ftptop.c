@@ -73,6 +73,14 @@ static const char *program = "ftptop";
 #define FTPTOP_XFER_HEADER_FMT	"%-5s %s %-8s %-44s %-10s %-*s\n"
 #define FTPTOP_XFER_DISPLAY_FMT	"%-5u %s %-*.*s %-*.*s %-10.2f %-*.*s\n"
 
+/* These are for displaying session statistics:
+ * "PID S USER KB-IN KB-OUT CMDS AVG-MS HS-MS DISK-S NET-S THRTL-S"
+ */
+#define FTPTOP_STATS_HEADER_FMT	\
+  "%-5s %s %-8s %8s %8s %5s %6s %5s %7s %7s %7s\n"
+#define FTPTOP_STATS_DISPLAY_FMT \
+  "%-5u %s %-*.*s %8.0f %8.0f %5lu %6lu %5lu %7.1f %7.1f %7.1f\n"
+
 #define FTPTOP_REG_ARG_MIN_SIZE		20
 #define FTPTOP_XFER_DONE_MIN_SIZE	6
 #define FTPTOP_REG_ARG_SIZE	\
@@ -89,6 +97,11 @@ static const char *program = "ftptop";
 #define	FTPTOP_SHOW_REG \
   (FTPTOP_SHOW_DOWNLOAD|FTPTOP_SHOW_UPLOAD|FTPTOP_SHOW_IDLE)
 #define FTPTOP_SHOW_RATES		0x0010
+#define FTPTOP_SHOW_STATS		0x0020
+
+/* The transfer speed and statistics modes show all sessions. */
+#define FTPTOP_SHOW_ALL(mode) \
+  ((mode) == FTPTOP_SHOW_RATES || (mode) == FTPTOP_SHOW_STATS)
 
 static int delay = 2;
 static unsigned int display_mode = FTPTOP_SHOW_REG;
@@ -295,7 +308,7 @@ static const char *show_ftpd_uptime(void) {
 
 static void process_opts(int argc, char *argv[]) {
   int optc = 0;
-  const char *prgopts = "AabDS:d:f:hIin:UV";
+  const char *prgopts = "AabDS:d:f:hIin:sUV";
 
   while ((optc = getopt(argc, argv, prgopts)) != -1) {
     switch (optc) {
@@ -369,6 +382,10 @@ static void process_opts(int argc, char *argv[]) {
         break;
       }
 
+      case 's':
+        display_mode = FTPTOP_SHOW_STATS;
+        break;
+
       case 'S':
         if (server_name != NULL) {
           free(server_name);
@@ -456,7 +473,7 @@ static void read_scoreboard(void) {
         status = "I";
         ftp_nidles++;
 
-        if (display_mode != FTPTOP_SHOW_RATES &&
+        if (!FTPTOP_SHOW_ALL(display_mode) &&
             !(display_mode & FTPTOP_SHOW_IDLE)) {
           continue;
         }
@@ -467,7 +484,7 @@ static void read_scoreboard(void) {
         status = "D";
         ftp_ndownloads++;
 
-        if (display_mode != FTPTOP_SHOW_RATES &&
+        if (!FTPTOP_SHOW_ALL(display_mode) &&
             !(display_mode & FTPTOP_SHOW_DOWNLOAD)) {
           continue;
         }
@@ -480,7 +497,7 @@ static void read_scoreboard(void) {
         status = "U";
         ftp_nuploads++;
 
-        if (display_mode != FTPTOP_SHOW_RATES &&
+        if (!FTPTOP_SHOW_ALL(display_mode) &&
             !(display_mode & FTPTOP_SHOW_UPLOAD)) {
           continue;
         }
@@ -500,7 +517,25 @@ static void read_scoreboard(void) {
       util_sstrncpy(score->sce_cmd, "(authenticating)", sizeof(score->sce_cmd));
     }
 
-    if (display_mode != FTPTOP_SHOW_RATES) {
+    if (display_mode == FTPTOP_SHOW_STATS) {
+      int user_namelen;
+
+      user_namelen = str_getscreenlen(score->sce_user, 8);
+
+      snprintf(buf, sizeof(buf), FTPTOP_STATS_DISPLAY_FMT,
+        (unsigned int) score->sce_pid, status,
+        user_namelen, user_namelen, score->sce_user,
+        score->sce_bytes_in / 1024.0, score->sce_bytes_out / 1024.0,
+        score->sce_cmd_count,
+        score->sce_cmd_count > 0 ?
+          score->sce_cmd_ms / score->sce_cmd_count : 0UL,
+        score->sce_handshake_ms,
+        score->sce_xfer_disk_ms / 1000.0,
+        score->sce_xfer_net_ms / 1000.0,
+        score->sce_xfer_throttle_ms / 1000.0);
+      buf[sizeof(buf)-1] = '\0';
+
+    } else if (display_mode != FTPTOP_SHOW_RATES) {
       int user_namelen, client_namelen, cmd_arglen;
 
       user_namelen = str_getscreenlen(score->sce_user, 8);
@@ -647,7 +682,11 @@ static void show_sessions(int use_attributes) {
     attron(A_REVERSE);
   }
 
-  if (display_mode != FTPTOP_SHOW_RATES) {
+  if (display_mode == FTPTOP_SHOW_STATS) {
+    printw(FTPTOP_STATS_HEADER_FMT, "PID", "S", "USER", "KB-IN", "KB-OUT",
+      "CMDS", "AVG-MS", "HS-MS", "DISK-S", "NET-S", "THRTL-S");
+
+  } else if (display_mode != FTPTOP_SHOW_RATES) {
     printw(FTPTOP_REG_HEADER_FMT, "PID", "S", "USER", "CLIENT", "SERVER",
       "TIME", FTPTOP_REG_ARG_SIZE, "COMMAND");
 
@@ -672,14 +711,16 @@ static void show_sessions(int use_attributes) {
   wrefresh(stdscr);
 }
 
-static void toggle_mode(void) {
+static void toggle_mode(unsigned int mode) {
   static unsigned int cached_mode = 0;
 
-  if (cached_mode == 0)
-    cached_mode = display_mode;
+  if (cached_mode == 0) {
+    cached_mode = FTPTOP_SHOW_ALL(display_mode) ? FTPTOP_SHOW_REG :
+      display_mode;
+  }
 
-  if (display_mode != FTPTOP_SHOW_RATES) {
-    display_mode = FTPTOP_SHOW_RATES;
+  if (display_mode != mode) {
+    display_mode = mode;
 
   } else {
     display_mode = cached_mode;
@@ -703,12 +744,14 @@ static void usage(void) {
   fprintf(stdout, "\t-I      \t\tshow only idle connections\n");
   fprintf(stdout, "\t-i      \t\tignores idle connections\n");
   fprintf(stdout, "\t-n <num>\t\tnumber of iterations\n");
+  fprintf(stdout, "\t-s      \t\tstart in session statistics display mode\n");
   fprintf(stdout, "\t-S      \t\tshow only sessions for this ServerName\n");
   fprintf(stdout, "\t-U      \t\tshow only uploading sessions\n");
   fprintf(stdout, "\t-V      \t\tshows version\n");
   fprintf(stdout, "\n");
   fprintf(stdout, "  Use the 't' key to toggle between \"regular\" and \"transfer speed\"\n");
-  fprintf(stdout, "  display modes. Use the 'q' key to quit.\n\n");
+  fprintf(stdout, "  display modes, and the 's' key to toggle the \"session statistics\"\n");
+  fprintf(stdout, "  display mode. Use the 'q' key to quit.\n\n");
   exit(0);
 }
 
@@ -777,7 +820,11 @@ int main(int argc, char *argv[]) {
         }
 
         if (tolower(c) == 't') {
-          toggle_mode();
+          toggle_mode(FTPTOP_SHOW_RATES);
+        }
+
+        if (tolower(c) == 's') {
+          toggle_mode(FTPTOP_SHOW_STATS);
         }
       }
     }
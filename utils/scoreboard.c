@@ -26,12 +26,25 @@
 
 #include "utils.h"
 
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif /* HAVE_SYS_MMAN_H */
+
+/* See src/scoreboard.c. */
+#if defined(HAVE_SYS_MMAN_H) && \
+    defined(__ATOMIC_ACQUIRE)
+# define UTIL_SCOREBOARD_USE_MMAP
+#endif
+
 static int util_scoreboard_fd = -1;
 static char util_scoreboard_file[PR_TUNABLE_PATH_MAX] = PR_RUN_DIR "/proftpd.scoreboard";
 
 static pr_scoreboard_header_t util_header;
 
-static unsigned char util_scoreboard_read_locked = FALSE;
+/* Max number of attempts to read a consistent copy of an entry which is
+ * being updated concurrently.
+ */
+#define UTIL_SCOREBOARD_MAX_READ_ATTEMPTS	10
 
 /* Internal routines
  */
@@ -67,52 +80,102 @@ static int read_scoreboard_header(pr_scoreboard_header_t *header) {
   return 0;
 }
 
-static int rlock_scoreboard(void) {
-  struct flock lock;
-
-  lock.l_type = F_RDLCK;
-  lock.l_whence = 0;
-  lock.l_start = 0;
-  lock.l_len = 0;
+/* Reports whether the entry read from the given offset, with the given
+ * sequence number, may have been changed by its session while being read.
+ */
+static int entry_seq_changed(off_t offset, unsigned long seq) {
+#ifdef HAVE_PREAD
+  unsigned long curr_seq = 0;
+  ssize_t res;
 
-  while (fcntl(util_scoreboard_fd, F_SETLKW, &lock) < 0) {
+  if (seq % 2 != 0)
+    return TRUE;
 
-    /* It would be nice to try to restart the fcntl(2) in cases where
-     * it is interrupted.  However, that could possibly lead to a tight
-     * loop which leaves the scoreboard file locked, which in turn causes
-     * problems for the proftpd daemon trying to read that scoreboard.
-     *
-     * Instead, only retry the fcntl(2) on EAGAIN, and NOT on EINTR.
-     */
-    if (errno == EAGAIN)
+  while ((res = pread(util_scoreboard_fd, &curr_seq, sizeof(curr_seq),
+      offset)) < 0) {
+    if (errno == EINTR)
       continue;
 
-    return -1;
+    return FALSE;
   }
 
-  util_scoreboard_read_locked = TRUE;
-  return 0;
+  if (res != sizeof(curr_seq))
+    return FALSE;
+
+  return curr_seq != seq ? TRUE : FALSE;
+#else
+  return FALSE;
+#endif /* HAVE_PREAD */
 }
 
-static int unlock_scoreboard(void) {
-  struct flock lock;
+#ifdef UTIL_SCOREBOARD_USE_MMAP
+/* Scrub the scoreboard in place, the same way the daemon does: reserve the
+ * slot of a dead PID by swapping that PID for -1, clear the slot (bumping
+ * its sequence number around the write), then release it.
+ */
+static int scrub_mapped_slots(int fd, int verbose) {
+  register unsigned int i;
+  struct stat st;
+  size_t nslots, map_len;
+  pr_scoreboard_entry_t *slots;
+  void *map;
 
-  lock.l_type = F_UNLCK;
-  lock.l_whence = 0;
-  lock.l_start = 0;
-  lock.l_len = 0;
+  if (fstat(fd, &st) < 0)
+    return -1;
 
-  util_scoreboard_read_locked = FALSE;
+  if (st.st_size < (off_t) sizeof(pr_scoreboard_header_t))
+    return 0;
 
-  while (fcntl(util_scoreboard_fd, F_SETLK, &lock) < 0) {
-    if (errno == EAGAIN)
-      continue;
+  nslots = (st.st_size - sizeof(pr_scoreboard_header_t)) /
+    sizeof(pr_scoreboard_entry_t);
+  if (nslots == 0)
+    return 0;
 
+  map_len = sizeof(pr_scoreboard_header_t) +
+    (nslots * sizeof(pr_scoreboard_entry_t));
+  map = mmap(NULL, map_len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
     return -1;
+
+  slots = (pr_scoreboard_entry_t *) (((char *) map) +
+    sizeof(pr_scoreboard_header_t));
+
+  for (i = 0; i < nslots; i++) {
+    pid_t slot_pid;
+    unsigned long seq;
+
+    slot_pid = __atomic_load_n(&(slots[i].sce_pid), __ATOMIC_ACQUIRE);
+    if (slot_pid <= 0 ||
+        kill(slot_pid, 0) == 0 ||
+        errno != ESRCH) {
+      continue;
+    }
+
+    if (!__atomic_compare_exchange_n(&(slots[i].sce_pid), &slot_pid, -1,
+        FALSE, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+      continue;
+
+    if (verbose) {
+      fprintf(stdout, "scrubbing scoreboard slot for PID %u\n",
+        (unsigned int) slot_pid);
+    }
+
+    seq = __atomic_load_n(&(slots[i].sce_seq), __ATOMIC_RELAXED);
+    __atomic_store_n(&(slots[i].sce_seq), seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memset(((char *) &(slots[i])) + sizeof(slots[i].sce_seq) +
+      sizeof(slots[i].sce_pid), 0, sizeof(pr_scoreboard_entry_t) -
+      sizeof(slots[i].sce_seq) - sizeof(slots[i].sce_pid));
+
+    __atomic_store_n(&(slots[i].sce_seq), seq + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&(slots[i].sce_pid), 0, __ATOMIC_RELEASE);
   }
 
+  (void) munmap(map, map_len);
   return 0;
 }
+#endif /* UTIL_SCOREBOARD_USE_MMAP */
 
 /* Public routines
  */
@@ -121,10 +184,6 @@ int util_close_scoreboard(void) {
   if (util_scoreboard_fd == -1)
     return 0;
 
-  if (util_scoreboard_read_locked) {
-    unlock_scoreboard();
-  }
-
   (void) close(util_scoreboard_fd);
   util_scoreboard_fd = -1;
 
@@ -218,21 +277,26 @@ time_t util_scoreboard_get_daemon_uptime(void) {
 pr_scoreboard_entry_t *util_scoreboard_entry_read(void) {
   static pr_scoreboard_entry_t scan_entry;
   int res = 0;
+  unsigned int nattempts = 1;
 
   if (util_scoreboard_fd < 0) {
     errno = EINVAL;
     return NULL;
   }
 
-  /* Make sure the scoreboard file is read-locked. */
-  if (!util_scoreboard_read_locked)
-    rlock_scoreboard();
-
+  /* The scoreboard is not locked for reading; sessions update their entries
+   * in place.  An entry whose sequence number changed while it was being
+   * read is read again.
+   */
   memset(&scan_entry, '\0', sizeof(scan_entry));
 
   /* NOTE: use readv(2)? */
   errno = 0;
-  while (scan_entry.sce_pid == 0) {
+  while (TRUE) {
+    off_t offset;
+
+    offset = lseek(util_scoreboard_fd, (off_t) 0, SEEK_CUR);
+
     while ((res = read(util_scoreboard_fd, &scan_entry,
         sizeof(scan_entry))) <= 0) {
 
@@ -241,8 +305,6 @@ pr_scoreboard_entry_t *util_scoreboard_entry_read(void) {
         continue;
  
       } else {
-        unlock_scoreboard();
-
         if (errno) {
           fprintf(stdout, "error reading scoreboard entry: %s\n",
             strerror(errno));
@@ -252,13 +314,24 @@ pr_scoreboard_entry_t *util_scoreboard_entry_read(void) {
       }
     }
 
-    if (scan_entry.sce_pid) {
-      unlock_scoreboard();
-      return &scan_entry;
+    /* Skip free slots, and slots being scrubbed. */
+    if (scan_entry.sce_pid <= 0) {
+      nattempts = 1;
+      continue;
     }
+
+    if (offset >= 0 &&
+        nattempts < UTIL_SCOREBOARD_MAX_READ_ATTEMPTS &&
+        entry_seq_changed(offset, scan_entry.sce_seq) == TRUE &&
+        lseek(util_scoreboard_fd, offset, SEEK_SET) == offset) {
+      nattempts++;
+      continue;
+    }
+
+    return &scan_entry;
   }
 
-  unlock_scoreboard();
+  /* Technically we never reach this. */
   return NULL;
 }
 
@@ -284,6 +357,13 @@ int util_scoreboard_scrub(int verbose) {
     return -1;
   }
 
+#ifdef UTIL_SCOREBOARD_USE_MMAP
+  if (scrub_mapped_slots(fd, verbose) == 0) {
+    (void) close(fd);
+    return 0;
+  }
+#endif /* UTIL_SCOREBOARD_USE_MMAP */
+
   /* Lock the entire scoreboard. */
   lock.l_type = F_WRLCK;
   lock.l_whence = 0;
@@ -335,7 +415,7 @@ int util_scoreboard_scrub(int verbose) {
     /* Check to see if the PID in this entry is valid.  If not, erase
      * the slot.
      */
-    if (sce.sce_pid &&
+    if (sce.sce_pid > 0 &&
         kill(sce.sce_pid, 0) < 0 &&
         errno == ESRCH) {
 
@@ -88,7 +88,7 @@
 
 /* UTIL_SCOREBOARD_VERSION is used for checking for scoreboard compatibility
  */
-#define UTIL_SCOREBOARD_VERSION        0x01040003
+#define UTIL_SCOREBOARD_VERSION        0x01040005
 
 /* Structure used as a header for scoreboard files.
  */
@@ -114,6 +114,10 @@ typedef struct {
  */
 
 typedef struct {
+
+  /* Sequence counter; odd while the owning session is writing the entry. */
+  unsigned long sce_seq;
+
   pid_t	sce_pid;
   uid_t sce_uid;
   gid_t sce_gid;
@@ -141,6 +145,12 @@ typedef struct {
   off_t sce_xfer_size, sce_xfer_done, sce_xfer_len;
   unsigned long sce_xfer_elapsed;
 
+  /* Cumulative session counters; see include/scoreboard.h. */
+  off_t sce_bytes_in, sce_bytes_out;
+  unsigned long sce_cmd_count, sce_cmd_ms;
+  unsigned long sce_handshake_ms;
+  unsigned long sce_xfer_disk_ms, sce_xfer_net_ms, sce_xfer_throttle_ms;
+
 } pr_scoreboard_entry_t;
 
 /* Scoreboard error values */